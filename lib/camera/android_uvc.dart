@@ -1,6 +1,7 @@
 import 'dart:async';
 import 'package:flutter/services.dart';
 import 'camera_interface.dart';
+import 'frame_ring.dart';
 
 class AndroidUVCCamera implements CameraInterface {
   static const MethodChannel _channel = MethodChannel(
@@ -72,6 +73,11 @@ class AndroidUVCCamera implements CameraInterface {
     await _channel.invokeMethod('setContrast', {'value': value});
   }
 
+  @override
+  Future<void> setGamma(double value) async {
+    await _channel.invokeMethod('setGamma', {'value': value});
+  }
+
   @override
   Future<List<CameraResolution>> getSupportedResolutions() async {
     // Android 实现待完成
@@ -87,12 +93,128 @@ class AndroidUVCCamera implements CameraInterface {
     // Android 实现待完成
   }
 
+  @override
+  Future<void> setRawMode(bool enabled, {bool rawYuy2 = false}) async {
+    // Android 实现待完成
+  }
+
+  @override
+  Future<void> setSkipUnconsumedFrames(bool enabled) async {
+    // Android 实现待完成
+  }
+
+  @override
+  Future<void> setMaxPreviewSize(int width, int height) async {
+    // Android 实现待完成
+  }
+
+  @override
+  Future<void> setBurstBuffer(int megabytes,
+      {BurstEviction eviction = BurstEviction.oldest}) async {
+    // Android 实现待完成
+  }
+
+  @override
+  Future<void> setPalette(String palette) async {
+    // Android 实现待完成
+  }
+
+  @override
+  Future<void> setAgcMode(String mode) async {
+    // Android 实现待完成
+  }
+
+  @override
+  Future<void> setTemporalDenoise(bool enabled,
+      {double? minWeight, double? noiseSigma}) async {
+    // Android 实现待完成
+  }
+
+  @override
+  Future<void> setNuc(bool enabled, {bool? shutterless}) async {
+    // Android 实现待完成
+  }
+
+  @override
+  Future<NucResult> captureNucReference(NucReference level,
+      {int frames = 32}) async {
+    // Android 实现待完成
+    throw UnsupportedError('NUC calibration is not supported on Android yet');
+  }
+
+  @override
+  Future<NucResult> computeNuc({String? path}) async {
+    // Android 实现待完成
+    throw UnsupportedError('NUC calibration is not supported on Android yet');
+  }
+
+  @override
+  Future<void> loadNuc(String path) async {
+    // Android 实现待完成
+  }
+
+  @override
+  Future<void> setBadPixels(bool enabled, {String? directory}) async {
+    // Android 实现待完成
+  }
+
+  @override
+  Future<BadPixelScanResult> scanBadPixels(
+      {int frames = 32, double kSigma = 6.0}) async {
+    // Android 实现待完成
+    throw UnsupportedError('Bad-pixel scans are not supported on Android yet');
+  }
+
+  @override
+  Future<void> setRois(List<Roi> rois) async {
+    // Android 实现待完成
+  }
+
+  @override
+  Stream<RoiMeasurement> get roiStream => const Stream.empty();
+
+  @override
+  Future<void> setFrameStream(bool enabled,
+      {int slots = 4,
+      int everyNth = 1,
+      double maxFps = 0,
+      int downscale = 1,
+      bool raw = false}) async {
+    // Android 实现待完成
+  }
+
+  @override
+  Future<FrameRingReader?> getFrameRing() async {
+    // Android 实现待完成
+    return null;
+  }
+
+  @override
+  Future<Map<String, dynamic>> getPipelineStats({bool reset = false}) async {
+    // Android 实现待完成
+    return {};
+  }
+
   @override
   Future<Uint8List?> capturePhoto() async {
     // Android 实现待完成
     return null;
   }
 
+  @override
+  Future<SnapshotResult> captureToFile(String path,
+      {SnapshotFormat format = SnapshotFormat.png}) async {
+    // Android 实现待完成
+    throw UnsupportedError('captureToFile is not supported on Android yet');
+  }
+
+  @override
+  Future<BurstResult> captureBurst(String path,
+      {double preSeconds = 2.0, double postSeconds = 0.0}) async {
+    // Android 实现待完成
+    throw UnsupportedError('captureBurst is not supported on Android yet');
+  }
+
   @override
   Stream<String> get onDeviceChanged => _deviceChangeController.stream;
 
@@ -1,27 +1,69 @@
 import 'dart:typed_data';
 
+import 'frame_ring.dart';
+import 'telemetry_record.dart';
+
 class CameraFrame {
   final Uint8List bytes;
   final int width;
   final int height;
 
-  CameraFrame({required this.bytes, required this.width, required this.height});
+  /// bytes 为 16 位原始计数 (小端) 而非 RGBA
+  final bool raw;
+
+  /// 源帧序号，未知时为 null
+  final int? sequence;
+
+  CameraFrame({
+    required this.bytes,
+    required this.width,
+    required this.height,
+    this.raw = false,
+    this.sequence,
+  });
 }
 
 /// 表示相机支持的分辨率
 class CameraResolution {
   final int width;
   final int height;
+
+  /// 取整后的帧率，用于显示
   final int frameRate;
 
+  /// 原生层为该分辨率协商出的格式（"Y16"、"NV12"、"YUY2"、"MJPG"、
+  /// "RGB32"），未知时为 null
+  final String? subtype;
+
+  /// 精确帧率的分子与分母，例如 30000/1001
+  final int? fpsNumerator;
+  final int? fpsDenominator;
+
   CameraResolution({
     required this.width,
     required this.height,
     this.frameRate = 30,
+    this.subtype,
+    this.fpsNumerator,
+    this.fpsDenominator,
   });
 
+  /// 精确帧率；原生层未提供分数时退回 [frameRate]
+  double get exactFrameRate =>
+      fpsNumerator != null && fpsDenominator != null && fpsDenominator! > 0
+          ? fpsNumerator! / fpsDenominator!
+          : frameRate.toDouble();
+
   String get displayName =>
-      '${width}x$height${frameRate > 0 ? ' @${frameRate}fps' : ''}';
+      '${width}x$height${frameRate > 0 ? ' @${_fpsLabel}fps' : ''}'
+      '${subtype != null ? ' $subtype' : ''}';
+
+  String get _fpsLabel {
+    final double fps = exactFrameRate;
+    return fps == fps.roundToDouble()
+        ? '${fps.round()}'
+        : fps.toStringAsFixed(2);
+  }
 
   @override
   String toString() => displayName;
@@ -37,6 +79,249 @@ class CameraResolution {
   int get hashCode => width.hashCode ^ height.hashCode;
 }
 
+/// captureToFile 写出的文件格式
+enum SnapshotFormat {
+  /// 当前显示的 RGBA 画面
+  png,
+
+  /// 原始 16 位辐射测量计数，仅原始模式下可用
+  tiff,
+}
+
+/// captureToFile 的结果: 文件路径、大小与各阶段耗时 (微秒)
+class SnapshotResult {
+  final String path;
+  final int bytes;
+
+  /// 在后台队列中等待的时间
+  final double queuedUs;
+  final double encodeUs;
+  final double writeUs;
+
+  SnapshotResult({
+    required this.path,
+    required this.bytes,
+    required this.queuedUs,
+    required this.encodeUs,
+    required this.writeUs,
+  });
+
+  factory SnapshotResult.fromMap(Map<dynamic, dynamic> map) => SnapshotResult(
+        path: map['path'] as String,
+        bytes: map['bytes'] as int,
+        queuedUs: (map['queuedUs'] as num).toDouble(),
+        encodeUs: (map['encodeUs'] as num).toDouble(),
+        writeUs: (map['writeUs'] as num).toDouble(),
+      );
+
+  double get totalMs => (queuedUs + encodeUs + writeUs) / 1000;
+}
+
+/// 预触发缓冲区写满后腾出空间的方式
+enum BurstEviction {
+  /// 覆盖最旧的帧: 保留最近一段的全部帧
+  oldest,
+
+  /// 隔帧淘汰较旧的一半: 同样的内存覆盖更长时间，越旧帧率越低
+  thin,
+}
+
+/// captureBurst 的结果: 录像文件 (.uvcrec，可作为 replay 虚拟相机回放)
+/// 及其中各帧相对触发时刻的位置
+class BurstResult {
+  final String path;
+  final int frames;
+
+  /// 触发前的帧数，其余为触发后
+  final int preFrames;
+
+  /// 第一帧与最后一帧相对触发时刻的偏移 (毫秒)
+  final double firstOffsetMs;
+  final double lastOffsetMs;
+
+  /// 窗口超出缓冲区或预览提前停止，录像比请求的短
+  final bool truncated;
+  final double writeUs;
+
+  BurstResult({
+    required this.path,
+    required this.frames,
+    required this.preFrames,
+    required this.firstOffsetMs,
+    required this.lastOffsetMs,
+    required this.truncated,
+    required this.writeUs,
+  });
+
+  factory BurstResult.fromMap(Map<dynamic, dynamic> map) => BurstResult(
+        path: map['path'] as String,
+        frames: map['frames'] as int,
+        preFrames: map['preFrames'] as int,
+        firstOffsetMs: (map['firstOffsetMs'] as num).toDouble(),
+        lastOffsetMs: (map['lastOffsetMs'] as num).toDouble(),
+        truncated: map['truncated'] as bool,
+        writeUs: (map['writeUs'] as num).toDouble(),
+      );
+}
+
+/// 非均匀性校正 (NUC) 的平场参考: 冷、热各一帧组成两点校正，
+/// 单独一帧只刷新偏置 (一点校正)
+enum NucReference { cold, hot }
+
+/// captureNucReference / computeNuc 的结果
+class NucResult {
+  /// 参与平均的参考帧数及其平均计数值 (captureNucReference)
+  final int frames;
+  final double mean;
+
+  /// 计算出的是两点校正表而不是偏置刷新 (computeNuc)
+  final bool twoPoint;
+
+  /// 校正表保存的文件，未保存时为空
+  final String path;
+  final double computeUs;
+
+  NucResult({
+    required this.frames,
+    required this.mean,
+    required this.twoPoint,
+    required this.path,
+    required this.computeUs,
+  });
+
+  factory NucResult.fromMap(Map<dynamic, dynamic> map) => NucResult(
+        frames: map['frames'] as int,
+        mean: (map['mean'] as num).toDouble(),
+        twoPoint: map['twoPoint'] as bool,
+        path: map['path'] as String,
+        computeUs: (map['computeUs'] as num).toDouble(),
+      );
+}
+
+/// scanBadPixels 的结果
+class BadPixelScanResult {
+  /// 检出的坏点数及参与检测的帧数
+  final int count;
+  final int frames;
+
+  /// 坏点表保存的文件，未设置目录时为空
+  final String path;
+  final double detectUs;
+
+  BadPixelScanResult({
+    required this.count,
+    required this.frames,
+    required this.path,
+    required this.detectUs,
+  });
+
+  factory BadPixelScanResult.fromMap(Map<dynamic, dynamic> map) =>
+      BadPixelScanResult(
+        count: map['count'] as int,
+        frames: map['frames'] as int,
+        path: map['path'] as String,
+        detectUs: (map['detectUs'] as num).toDouble(),
+      );
+}
+
+/// 测温区域 (ROI) 的形状: 单点、矩形 (两个对角)、折线 (沿线各像素)
+enum RoiShape { point, rect, polyline }
+
+/// 原始帧上的测温区域，坐标为像素
+class Roi {
+  /// 调用方自定，随统计结果返回
+  final int id;
+  final RoiShape shape;
+
+  /// 顶点坐标 [x0, y0, x1, y1, ...]
+  final List<int> points;
+
+  const Roi(this.id, this.shape, this.points);
+
+  Roi.point(int id, int x, int y) : this(id, RoiShape.point, [x, y]);
+
+  Roi.rect(int id, int x0, int y0, int x1, int y1)
+      : this(id, RoiShape.rect, [x0, y0, x1, y1]);
+
+  Roi.polyline(int id, List<int> points)
+      : this(id, RoiShape.polyline, points);
+
+  Map<String, dynamic> toMap() => {
+        'id': id,
+        'shape': shape.name,
+        'points': points,
+      };
+}
+
+/// 一个 ROI 在一帧上的统计 (原始计数值)。ROI 完全在画面外时 count 为 0
+class RoiStats {
+  final int id;
+  final int count;
+  final int min;
+  final int max;
+  final double mean;
+  final double stddev;
+
+  /// 最热像素 (按行序第一个达到 max 的像素，折线为沿线第一个)
+  final int maxX;
+  final int maxY;
+
+  RoiStats({
+    required this.id,
+    required this.count,
+    required this.min,
+    required this.max,
+    required this.mean,
+    required this.stddev,
+    required this.maxX,
+    required this.maxY,
+  });
+}
+
+/// roiStream 的一个事件: 一帧上所有 ROI 的统计，顺序同 setRois
+class RoiMeasurement {
+  /// 源帧序号与时间戳 (微秒)，与管线统计一致
+  final int sequence;
+  final int timestampUs;
+  final List<RoiStats> stats;
+
+  RoiMeasurement({
+    required this.sequence,
+    required this.timestampUs,
+    required this.stats,
+  });
+
+  /// 解码 TelemetryKind.roi 记录。负载为 ROI 个数 u32、每个 ROI 的
+  /// 字节数 u32，之后每个 ROI 依次为 id i32、count u32、min u16、
+  /// max u16、maxX i32、maxY i32、保留 u32、mean f64、stddev f64；
+  /// 按记录给出的字节数跳步，新版本追加的字段不影响解码
+  factory RoiMeasurement.fromRecord(TelemetryRecord record) {
+    final data = record.payload;
+    final int count = data.getUint32(0, Endian.little);
+    final int stride = data.getUint32(4, Endian.little);
+    final stats = <RoiStats>[];
+    for (var i = 0, at = 8;
+        i < count && stride >= 40 && at + 40 <= data.lengthInBytes;
+        i++, at += stride) {
+      stats.add(RoiStats(
+        id: data.getInt32(at, Endian.little),
+        count: data.getUint32(at + 4, Endian.little),
+        min: data.getUint16(at + 8, Endian.little),
+        max: data.getUint16(at + 10, Endian.little),
+        maxX: data.getInt32(at + 12, Endian.little),
+        maxY: data.getInt32(at + 16, Endian.little),
+        mean: data.getFloat64(at + 24, Endian.little),
+        stddev: data.getFloat64(at + 32, Endian.little),
+      ));
+    }
+    return RoiMeasurement(
+      sequence: record.sequence,
+      timestampUs: record.timestampUs,
+      stats: stats,
+    );
+  }
+}
+
 abstract class CameraInterface {
   bool get isInitialized;
   Future<void> initialize();
@@ -46,8 +331,13 @@ abstract class CameraInterface {
   Future<void> openDevice(int deviceIndex);
   Future<void> closeDevice();
   Stream<CameraFrame> get frameStream;
+
+  /// 预览的亮度与对比度 (0 到 1，0.5 为不调整) 以及 gamma (0.1 到 10，
+  /// 1 为不调整)。原生层把三者合成一张查找表，只在滑块变化时重建，
+  /// 在颜色转换的同一遍中应用；原始模式下作用于调色板
   Future<void> setBrightness(double value);
   Future<void> setContrast(double value);
+  Future<void> setGamma(double value);
 
   /// 获取设备支持的分辨率列表
   Future<List<CameraResolution>> getSupportedResolutions();
@@ -58,9 +348,104 @@ abstract class CameraInterface {
   /// 获取当前分辨率
   CameraResolution? get currentResolution;
 
+  /// 切换原始 16 位 (Y16) 辐射测量模式，下次启动预览时生效。
+  /// [rawYuy2] 表示相机以 YUY2 传输原始计数 (部分热成像机芯)；默认 YUY2
+  /// 按彩色格式显示，因为普通摄像头也提供 YUY2
+  Future<void> setRawMode(bool enabled, {bool rawYuy2 = false});
+
+  /// 显示端尚未取走上一帧时跳过新帧的格式转换 (高帧率相机降低负载)，
+  /// 下次启动预览时生效；跳过的帧数见 getPipelineStats 的 skippedUnconsumed
+  Future<void> setSkipUnconsumedFrames(bool enabled);
+
+  /// 预览纹理的最大需要尺寸 (0 表示不限)。MJPEG 帧按不小于该尺寸的
+  /// 1/8 倍数缩小解码，省去全尺寸解码；下次启动预览时生效
+  Future<void> setMaxPreviewSize(int width, int height);
+
+  /// 为 captureBurst 预留 [megabytes] MB 的预触发缓冲区 (0 表示不保留)，
+  /// 采集线程把每一帧原始数据复制进去；下次启动预览时生效
+  Future<void> setBurstBuffer(int megabytes,
+      {BurstEviction eviction = BurstEviction.oldest});
+
+  /// 设置原始模式下的伪彩色调色板
+  /// (white_hot, black_hot, ironbow, rainbow, arctic)
+  Future<void> setPalette(String palette);
+
+  /// 设置原始模式下的自动增益 (AGC) 模式 (linear, percentile, plateau)
+  Future<void> setAgcMode(String mode);
+
+  /// 开关原始模式下的时域降噪。[noiseSigma] 为传感器时域噪声 (计数值，
+  /// 一个标准差)，[minWeight] 为静止区域新帧的权重，越小越平滑；
+  /// 为 null 的参数保持原值
+  Future<void> setTemporalDenoise(bool enabled,
+      {double? minWeight, double? noiseSigma});
+
+  /// 开关原始模式下的非均匀性校正。[shutterless] 为 true 时还按场景
+  /// 持续估计并消除列条纹，无需快门；为 null 的参数保持原值
+  Future<void> setNuc(bool enabled, {bool? shutterless});
+
+  /// 在原始模式预览中平均接下来的 [frames] 帧作为 [level] 平场参考
+  /// (对准均匀的冷/热黑体或镜头盖)，预览不中断
+  Future<NucResult> captureNucReference(NucReference level,
+      {int frames = 32});
+
+  /// 在原生后台线程由参考帧计算校正表，保存到 [path] (.uvcnuc，可选)
+  /// 并在下一帧原子地切换过去；失败时抛出 PlatformException
+  Future<NucResult> computeNuc({String? path});
+
+  /// 映射 computeNuc 保存的校正表，启动时无需重新标定
+  Future<void> loadNuc(String path);
+
+  /// 开关原始模式下的坏点替换 (用邻域中值替换死点、盲元)。[directory]
+  /// 为按设备序列号保存坏点表 (.uvcbpm) 的目录，每次启动预览时自动加载
+  Future<void> setBadPixels(bool enabled, {String? directory});
+
+  /// 在原始模式预览中用接下来的 [frames] 帧检测坏点: 偏离邻域超过
+  /// [kSigma] 倍标准差或完全不变的像素。坏点表保存到 setBadPixels 的
+  /// 目录并立即生效，预览不中断
+  Future<BadPixelScanResult> scanBadPixels(
+      {int frames = 32, double kSigma = 6.0});
+
+  /// 设置原始模式下每帧测量的 ROI (最多 64 个)，替换之前的设置；
+  /// 空列表停止测量
+  Future<void> setRois(List<Roi> rois);
+
+  /// 每帧 ROI 统计 (最小/最大/均值/标准差/最热点) 在采集线程上计算，
+  /// 每帧只传几百字节；显示端来不及接收时只保留最新一帧
+  Stream<RoiMeasurement> get roiStream;
+
+  /// 开关 frameStream 使用的帧环: 原生层把每 [everyNth] 帧中的一帧
+  /// (且每秒不超过 [maxFps] 帧，0 为不限) 复制进 [slots] 个槽的共享
+  /// 内存，Dart 经 dart:ffi 直接读取。[downscale] 为 1、2 或 4 倍缩小，
+  /// [raw] 为 true 时原始模式下传 16 位计数。抽帧设置立即生效，其余
+  /// 下次启动预览时生效
+  Future<void> setFrameStream(bool enabled,
+      {int slots = 4,
+      int everyNth = 1,
+      double maxFps = 0,
+      int downscale = 1,
+      bool raw = false});
+
+  /// 当前预览的帧环，未启用或未在预览时为 null
+  Future<FrameRingReader?> getFrameRing();
+
+  /// 获取采集管线统计: 帧计数、丢帧、采集/显示帧率以及各阶段延迟百分位 (微秒)
+  /// reset 为 true 时在读取后重新开始统计
+  Future<Map<String, dynamic>> getPipelineStats({bool reset = false});
+
   /// 拍照并返回图片数据
   Future<Uint8List?> capturePhoto();
 
+  /// 在原生后台线程把当前帧编码为 [format] 并直接写入 [path]，
+  /// 不经过 Dart 传输像素；失败时抛出 PlatformException
+  Future<SnapshotResult> captureToFile(String path,
+      {SnapshotFormat format = SnapshotFormat.png});
+
+  /// 把触发前 [preSeconds] 秒与触发后 [postSeconds] 秒的原始帧写入
+  /// [path] (.uvcrec)。写盘在原生后台线程进行，不暂停预览；
+  /// 需先通过 setBurstBuffer 预留缓冲区，失败时抛出 PlatformException
+  Future<BurstResult> captureBurst(String path,
+      {double preSeconds = 2.0, double postSeconds = 0.0});
+
   /// 设备热插拔事件流 (connected/disconnected)
   Stream<String> get onDeviceChanged;
 
@@ -1,8 +1,6 @@
 import 'package:flutter/material.dart';
 import 'package:logging/logging.dart';
 import 'dart:async';
-import 'dart:io';
-import 'dart:typed_data';
 import 'package:path_provider/path_provider.dart';
 import 'uvc_camera.dart';
 import 'camera_interface.dart';
@@ -24,10 +22,18 @@ class _CameraPreviewPageState extends State<CameraPreviewPage> {
   int? _selectedDeviceIndex;
   double _brightness = 0.5;
   double _contrast = 0.5;
+  double _gamma = 1.0;
+  bool _rawMode = false;
+  bool _rawYuy2 = false;
+  String _palette = 'white_hot';
+  String _agcMode = 'plateau';
+  bool _denoise = false;
+  bool _badPixels = false;
   Timer? _statusCheckTimer;
   Map<String, dynamic>? _selectedDeviceStatus;
   int? _textureId;
   bool _isCapturing = false;
+  bool _isSavingBurst = false;
   List<CameraResolution> _supportedResolutions = [];
   CameraResolution? _selectedResolution;
   StreamSubscription<String>? _deviceChangeSubscription;
@@ -200,38 +206,100 @@ class _CameraPreviewPageState extends State<CameraPreviewPage> {
     });
   }
 
+  /// 原始模式预触发缓冲区大小: 640x512 16 位约 400 帧
+  static const int _burstBufferMb = 256;
+
+  Future<void> _captureBurst() async {
+    if (_isSavingBurst) return;
+
+    setState(() => _isSavingBurst = true);
+
+    try {
+      // 触发前 5 秒与触发后 1 秒，写盘期间预览照常进行
+      final directory = await getApplicationDocumentsDirectory();
+      final result = await _camera.captureBurst(
+          '${directory.path}/burst_${DateTime.now().millisecondsSinceEpoch}.uvcrec',
+          preSeconds: 5,
+          postSeconds: 1);
+      _logger.info('Saved ${result.path}: ${result.frames} frames '
+          '(${result.preFrames} before the trigger, from '
+          '${result.firstOffsetMs.toStringAsFixed(0)} ms), '
+          'write ${(result.writeUs / 1000).toStringAsFixed(1)} ms'
+          '${result.truncated ? ', truncated' : ''}');
+
+      if (mounted) {
+        ScaffoldMessenger.of(context).showSnackBar(
+          SnackBar(
+            content: Text('连拍已保存: ${result.path} (${result.frames} 帧)'),
+            backgroundColor: Colors.green,
+            duration: const Duration(seconds: 3),
+          ),
+        );
+      }
+    } catch (e) {
+      _logger.severe('Failed to save burst', e);
+      if (mounted) {
+        ScaffoldMessenger.of(context).showSnackBar(
+          SnackBar(
+            content: Text('连拍保存失败: $e'),
+            backgroundColor: Colors.red,
+          ),
+        );
+      }
+    } finally {
+      if (mounted) {
+        setState(() => _isSavingBurst = false);
+      }
+    }
+  }
+
+  Future<void> _setBadPixels(bool enabled) async {
+    setState(() => _badPixels = enabled);
+    try {
+      // 坏点表按设备保存在文档目录；开启时重新检测一次并覆盖保存
+      final directory = await getApplicationDocumentsDirectory();
+      await _camera.setBadPixels(enabled, directory: directory.path);
+      if (!enabled) return;
+      final result = await _camera.scanBadPixels();
+      _logger.info('Found ${result.count} bad pixels in ${result.frames} '
+          'frames, saved to ${result.path}');
+    } catch (e) {
+      _logger.warning('Bad pixel scan failed', e);
+    }
+  }
+
   Future<void> _capturePhoto() async {
     if (_isCapturing) return;
 
     setState(() => _isCapturing = true);
 
     try {
-      final photoData = await _camera.capturePhoto();
-      if (photoData != null && photoData.isNotEmpty) {
-        // 保存到文件
-        final directory = await getApplicationDocumentsDirectory();
-        final timestamp = DateTime.now().millisecondsSinceEpoch;
-        final filePath = '${directory.path}/capture_$timestamp.bmp';
-
-        // 创建BMP文件头（简化版，假设是BGRA格式）
-        final width = _camera.currentResolution?.width ?? 640;
-        final height = _camera.currentResolution?.height ?? 480;
-        final bmpData = _createBmpFromRgba(photoData, width, height);
-
-        final file = File(filePath);
-        await file.writeAsBytes(bmpData);
+      // 编码与写盘在原生后台线程完成，UI 线程只等待路径与耗时
+      final directory = await getApplicationDocumentsDirectory();
+      final base =
+          '${directory.path}/capture_${DateTime.now().millisecondsSinceEpoch}';
+      final results = [
+        await _camera.captureToFile('$base.png'),
+        // 原始模式同时保存 16 位辐射测量数据
+        if (_rawMode)
+          await _camera.captureToFile('$base.tiff',
+              format: SnapshotFormat.tiff),
+      ];
+      for (final result in results) {
+        _logger.info('Saved ${result.path}: ${result.bytes} bytes, '
+            'encode ${(result.encodeUs / 1000).toStringAsFixed(1)} ms, '
+            'write ${(result.writeUs / 1000).toStringAsFixed(1)} ms');
+      }
 
-        if (mounted) {
-          ScaffoldMessenger.of(context).showSnackBar(
-            SnackBar(
-              content: Text('照片已保存: $filePath'),
-              backgroundColor: Colors.green,
-              duration: const Duration(seconds: 3),
-            ),
-          );
-        }
-      } else {
-        throw Exception('Failed to capture photo');
+      if (mounted) {
+        ScaffoldMessenger.of(context).showSnackBar(
+          SnackBar(
+            content:
+                Text('照片已保存: ${results.map((r) => r.path).join(', ')}'),
+            backgroundColor: Colors.green,
+            duration: const Duration(seconds: 3),
+          ),
+        );
       }
     } catch (e) {
       _logger.severe('Failed to capture photo', e);
@@ -250,39 +318,6 @@ class _CameraPreviewPageState extends State<CameraPreviewPage> {
     }
   }
 
-  Uint8List _createBmpFromRgba(Uint8List rgbaData, int width, int height) {
-    // BMP文件头
-    final fileSize = 54 + rgbaData.length;
-    final bmp = ByteData(fileSize);
-
-    // BMP文件头 (14 bytes)
-    bmp.setUint8(0, 0x42); // 'B'
-    bmp.setUint8(1, 0x4D); // 'M'
-    bmp.setUint32(2, fileSize, Endian.little);
-    bmp.setUint32(6, 0, Endian.little); // Reserved
-    bmp.setUint32(10, 54, Endian.little); // Pixel data offset
-
-    // DIB头 (40 bytes)
-    bmp.setUint32(14, 40, Endian.little); // DIB header size
-    bmp.setInt32(18, width, Endian.little);
-    bmp.setInt32(22, -height, Endian.little); // 负值表示自顶向下
-    bmp.setUint16(26, 1, Endian.little); // Color planes
-    bmp.setUint16(28, 32, Endian.little); // Bits per pixel
-    bmp.setUint32(30, 0, Endian.little); // Compression (none)
-    bmp.setUint32(34, rgbaData.length, Endian.little); // Image size
-    bmp.setInt32(38, 2835, Endian.little); // Horizontal resolution
-    bmp.setInt32(42, 2835, Endian.little); // Vertical resolution
-    bmp.setUint32(46, 0, Endian.little); // Colors in palette
-    bmp.setUint32(50, 0, Endian.little); // Important colors
-
-    // 像素数据
-    final result = Uint8List(fileSize);
-    result.setRange(0, 54, bmp.buffer.asUint8List());
-    result.setRange(54, fileSize, rgbaData);
-
-    return result;
-  }
-
   @override
   Widget build(BuildContext context) {
     return Scaffold(
@@ -530,7 +565,111 @@ class _CameraPreviewPageState extends State<CameraPreviewPage> {
                       }
                     },
                   ),
-                  const SizedBox(height: 16),
+                  const SizedBox(height: 8),
+
+                  // Raw 16-bit mode
+                  SwitchListTile(
+                    title: const Text('Raw 16-bit (Y16)'),
+                    value: _rawMode,
+                    contentPadding: EdgeInsets.zero,
+                    onChanged: (bool value) async {
+                      final deviceIndex = _selectedDeviceIndex;
+                      setState(() => _rawMode = value);
+                      await _camera.setRawMode(value, rawYuy2: _rawYuy2);
+                      // 原始模式下保留最近几秒的帧，供 captureBurst 回溯保存
+                      await _camera.setBurstBuffer(value ? _burstBufferMb : 0);
+                      if (deviceIndex != null) {
+                        await _stopPreview();
+                        await _startPreview(deviceIndex);
+                      }
+                    },
+                  ),
+                  if (_rawMode) ...[
+                    // 仅用于以 YUY2 传输原始计数的热成像机芯；普通摄像头的
+                    // YUY2 是彩色图像
+                    SwitchListTile(
+                      title: const Text('YUY2 carries raw counts'),
+                      value: _rawYuy2,
+                      contentPadding: EdgeInsets.zero,
+                      onChanged: (bool value) async {
+                        final deviceIndex = _selectedDeviceIndex;
+                        setState(() => _rawYuy2 = value);
+                        await _camera.setRawMode(true, rawYuy2: value);
+                        if (deviceIndex != null) {
+                          await _stopPreview();
+                          await _startPreview(deviceIndex);
+                        }
+                      },
+                    ),
+                    const SizedBox(height: 8),
+                    DropdownButtonFormField<String>(
+                      value: _palette,
+                      decoration: InputDecoration(
+                        labelText: 'Palette',
+                        border: const OutlineInputBorder(),
+                        filled: true,
+                        fillColor: theme.colorScheme.surfaceContainer,
+                      ),
+                      isExpanded: true,
+                      items: const [
+                        DropdownMenuItem(
+                            value: 'white_hot', child: Text('White hot')),
+                        DropdownMenuItem(
+                            value: 'black_hot', child: Text('Black hot')),
+                        DropdownMenuItem(
+                            value: 'ironbow', child: Text('Ironbow')),
+                        DropdownMenuItem(
+                            value: 'rainbow', child: Text('Rainbow')),
+                        DropdownMenuItem(value: 'arctic', child: Text('Arctic')),
+                      ],
+                      onChanged: (String? value) {
+                        if (value != null) {
+                          setState(() => _palette = value);
+                          _camera.setPalette(value);
+                        }
+                      },
+                    ),
+                    const SizedBox(height: 8),
+                    DropdownButtonFormField<String>(
+                      value: _agcMode,
+                      decoration: InputDecoration(
+                        labelText: 'AGC',
+                        border: const OutlineInputBorder(),
+                        filled: true,
+                        fillColor: theme.colorScheme.surfaceContainer,
+                      ),
+                      isExpanded: true,
+                      items: const [
+                        DropdownMenuItem(value: 'linear', child: Text('Linear')),
+                        DropdownMenuItem(
+                            value: 'percentile', child: Text('Percentile')),
+                        DropdownMenuItem(
+                            value: 'plateau', child: Text('Plateau')),
+                      ],
+                      onChanged: (String? value) {
+                        if (value != null) {
+                          setState(() => _agcMode = value);
+                          _camera.setAgcMode(value);
+                        }
+                      },
+                    ),
+                    SwitchListTile(
+                      title: const Text('Temporal denoise'),
+                      value: _denoise,
+                      contentPadding: EdgeInsets.zero,
+                      onChanged: (bool value) {
+                        setState(() => _denoise = value);
+                        _camera.setTemporalDenoise(value);
+                      },
+                    ),
+                    SwitchListTile(
+                      title: const Text('Bad pixel replacement'),
+                      value: _badPixels,
+                      contentPadding: EdgeInsets.zero,
+                      onChanged: (bool value) => _setBadPixels(value),
+                    ),
+                  ],
+                  const SizedBox(height: 8),
 
                   // Image Controls
                   const SizedBox(height: 8),
@@ -566,6 +705,24 @@ class _CameraPreviewPageState extends State<CameraPreviewPage> {
                       ),
                     ],
                   ),
+                  Row(
+                    children: [
+                      const Icon(Icons.tonality, size: 20),
+                      const SizedBox(width: 8),
+                      Expanded(
+                        child: Slider(
+                          value: _gamma,
+                          min: 0.25,
+                          max: 4.0,
+                          label: 'Gamma ${_gamma.toStringAsFixed(2)}',
+                          onChanged: (val) {
+                            setState(() => _gamma = val);
+                            _camera.setGamma(val);
+                          },
+                        ),
+                      ),
+                    ],
+                  ),
                 ],
               ],
             ),
@@ -595,6 +752,15 @@ class _CameraPreviewPageState extends State<CameraPreviewPage> {
                             : const Icon(Icons.camera, size: 36),
                       ),
 
+                      // Burst Button: saves the seconds before the press
+                      if (_rawMode)
+                        IconButton.filledTonal(
+                          onPressed: _isSavingBurst ? null : _captureBurst,
+                          icon: const Icon(Icons.burst_mode),
+                          tooltip: 'Save last 5 s',
+                          iconSize: 28,
+                        ),
+
                       // Stop/Start Button
                       IconButton.filledTonal(
                         onPressed: _stopPreview,
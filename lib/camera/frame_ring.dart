@@ -0,0 +1,161 @@
+import 'dart:ffi';
+import 'dart:typed_data';
+
+import 'package:ffi/ffi.dart';
+
+/// 帧环中一帧的拷贝
+class FrameRingFrame {
+  /// 写入帧环的顺序号，从 0 开始
+  final int frame;
+
+  /// 源帧序号与时间戳 (100 纳秒)，与管线统计一致
+  final int sequence;
+  final int timestamp;
+
+  /// RGBA 像素，或原始模式下的 16 位计数 (小端)
+  final Uint8List pixels;
+
+  FrameRingFrame({
+    required this.frame,
+    required this.sequence,
+    required this.timestamp,
+    required this.pixels,
+  });
+}
+
+/// 读取帧环的结果
+enum FrameRingRead {
+  ok,
+
+  /// 尚未写入任何帧，或该帧还没写到
+  empty,
+
+  /// 读取前或读取中该帧已被覆盖
+  overwritten,
+
+  /// 不是本版本的帧环
+  invalid,
+}
+
+/// 原生层 UvcFrameRingRead (native/src/frame_ring.h) 的签名
+typedef _ReadNative = Int32 Function(
+    Pointer<Uint8>, Uint64, Pointer<Uint8>, Uint64, Pointer<Int64>);
+typedef _Read = int Function(
+    Pointer<Uint8>, int, Pointer<Uint8>, int, Pointer<Int64>);
+
+/// 原生层写入的帧环 (native/src/frame_ring.h) 的读取端。
+///
+/// 帧环是进程内的一块内存，通过 dart:ffi 按地址映射，不经过通道编解码。
+/// 每个槽有一个 seqlock 代数，写入时为奇数。Dart 的 ffi 读取没有
+/// acquire 语义，在 ARM64 上读到的像素可能早于代数检查，事后再校验
+/// 也无法发现，因此整帧的读取交给原生层的 UvcFrameRingRead (地址随
+/// getFrameRing 返回)，以 leaf 调用拷贝到原生暂存区后再拷进 Dart。
+/// 头部字段 (尺寸、written、closed) 仍直接读取，只作为提示。
+class FrameRingReader {
+  static const int _magic = 0x00474e4952435655; // "UVCRING\0"
+  static const int version = 1;
+
+  // 头部偏移，与 FrameRingHeader 一致
+  static const int _versionOffset = 8;
+  static const int _slotCountOffset = 12;
+  static const int _pixelFormatOffset = 24;
+  static const int _widthOffset = 28;
+  static const int _heightOffset = 32;
+  static const int _strideOffset = 36;
+  static const int _writtenOffset = 40;
+  static const int _closedOffset = 48;
+
+  // 暂存区开头存放帧号、序号与时间戳，之后是像素
+  static const int _metaBytes = 32;
+
+  static final _finalizer = NativeFinalizer(malloc.nativeFree);
+
+  final int address;
+  final ByteData _data;
+  final _Read _read;
+  final Pointer<Uint8> _scratch;
+  final Pointer<Uint8> _pixels;
+
+  FrameRingReader._(this.address, Uint8List bytes, this._read, this._scratch)
+      : _data = ByteData.sublistView(bytes),
+        _pixels = Pointer<Uint8>.fromAddress(_scratch.address + _metaBytes);
+
+  /// 映射 getFrameRing 返回的 {address, bytes, read}；不是有效帧环时
+  /// 返回 null
+  static FrameRingReader? fromMap(Map<dynamic, dynamic>? map) {
+    if (map == null) return null;
+    final int address = map['address'] as int;
+    final int bytes = map['bytes'] as int;
+    final int read = (map['read'] as int?) ?? 0;
+    if (address == 0 || bytes < 64 || read == 0) return null;
+    final header = ByteData.sublistView(
+        Pointer<Uint8>.fromAddress(address).asTypedList(64));
+    if (header.getUint64(0, Endian.little) != _magic ||
+        header.getUint32(_versionOffset, Endian.little) != version) {
+      return null;
+    }
+    final int frameBytes = header.getUint32(_strideOffset, Endian.little) *
+        header.getUint32(_heightOffset, Endian.little);
+    final Pointer<Uint8> scratch = malloc<Uint8>(_metaBytes + frameBytes);
+    final reader = FrameRingReader._(
+        address,
+        Pointer<Uint8>.fromAddress(address).asTypedList(bytes),
+        Pointer<NativeFunction<_ReadNative>>.fromAddress(read)
+            .asFunction<_Read>(isLeaf: true),
+        scratch);
+    _finalizer.attach(reader, scratch.cast(),
+        externalSize: _metaBytes + frameBytes);
+    return reader;
+  }
+
+  bool get valid =>
+      _data.getUint64(0, Endian.little) == _magic &&
+      _data.getUint32(_versionOffset, Endian.little) == version;
+
+  int get slotCount => _data.getUint32(_slotCountOffset, Endian.little);
+
+  /// 0 为 RGBA，1 为 16 位计数
+  int get pixelFormat => _data.getUint32(_pixelFormatOffset, Endian.little);
+  bool get isRaw => pixelFormat == 1;
+  int get width => _data.getUint32(_widthOffset, Endian.little);
+  int get height => _data.getUint32(_heightOffset, Endian.little);
+  int get stride => _data.getUint32(_strideOffset, Endian.little);
+
+  /// 已写入的帧数；最新一帧为 written - 1
+  int get written => _data.getUint64(_writtenOffset, Endian.little);
+
+  /// 原生层不再写入此帧环 (停止预览或换了布局)，应重新 getFrameRing；
+  /// 再换一次布局后，这块内存可能被复用或释放
+  bool get closed => _data.getUint32(_closedOffset, Endian.little) != 0;
+
+  /// 把第 [index] 帧拷贝进 [out] (长度至少 stride * height，省略时新建)
+  (FrameRingRead, FrameRingFrame?) read(int index, {Uint8List? out}) {
+    final int length = stride * height;
+    final int code = _read(Pointer<Uint8>.fromAddress(address), index,
+        _pixels, length, _scratch.cast<Int64>());
+    final status = code >= 0 && code < FrameRingRead.values.length
+        ? FrameRingRead.values[code]
+        : FrameRingRead.invalid;
+    if (status != FrameRingRead.ok) return (status, null);
+    final Int64List meta = _scratch.cast<Int64>().asTypedList(3);
+    final Uint8List pixels = out ?? Uint8List(length);
+    pixels.setRange(0, length, _pixels.asTypedList(length));
+    return (
+      FrameRingRead.ok,
+      FrameRingFrame(
+        frame: meta[0],
+        sequence: meta[1],
+        timestamp: meta[2],
+        pixels: pixels,
+      )
+    );
+  }
+
+  /// 拷贝最新一帧
+  (FrameRingRead, FrameRingFrame?) readLatest({Uint8List? out}) {
+    if (!valid) return (FrameRingRead.invalid, null);
+    final int total = written;
+    if (total == 0) return (FrameRingRead.empty, null);
+    return read(total - 1, out: out);
+  }
+}
@@ -0,0 +1,56 @@
+import 'dart:typed_data';
+
+/// 原生层的记录类型，与 TelemetryKind (native/src/telemetry_record.h) 一致
+enum TelemetryKind {
+  /// roiStream 的 ROI 统计
+  roi(1);
+
+  final int code;
+  const TelemetryKind(this.code);
+}
+
+/// 原生层发往 Dart 的高频二进制记录 (native/src/telemetry_record.h)。
+///
+/// 固定布局、小端，开头 24 字节的记录头:
+/// 魔数 u16、版本 u8、类型 u8、整条记录字节数 u32、源帧序号 u64、
+/// 源帧时间戳 (微秒) i64，之后为该类型的负载。字段直接从 ByteData 视图
+/// 读取，不经过 StandardMessageCodec 的逐字段解码。
+class TelemetryRecord {
+  static const int magic = 0x5455;
+  static const int version = 1;
+  static const int headerBytes = 24;
+
+  final TelemetryKind kind;
+  final int sequence;
+  final int timestampUs;
+
+  /// 负载部分的视图 (不含记录头)
+  final ByteData payload;
+
+  TelemetryRecord._(this.kind, this.sequence, this.timestampUs, this.payload);
+
+  /// 解析一条记录；魔数、版本或类型不认识、长度不符时返回 null
+  static TelemetryRecord? tryParse(Uint8List bytes) {
+    if (bytes.length < headerBytes) return null;
+    final data =
+        ByteData.view(bytes.buffer, bytes.offsetInBytes, bytes.length);
+    if (data.getUint16(0, Endian.little) != magic ||
+        data.getUint8(2) != version) {
+      return null;
+    }
+    final int code = data.getUint8(3);
+    final int size = data.getUint32(4, Endian.little);
+    if (size < headerBytes || size > bytes.length) return null;
+    for (final kind in TelemetryKind.values) {
+      if (kind.code != code) continue;
+      return TelemetryRecord._(
+        kind,
+        data.getUint64(8, Endian.little),
+        data.getInt64(16, Endian.little),
+        ByteData.view(bytes.buffer, bytes.offsetInBytes + headerBytes,
+            size - headerBytes),
+      );
+    }
+    return null;
+  }
+}
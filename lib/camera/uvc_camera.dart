@@ -2,6 +2,7 @@ import 'dart:io';
 import 'dart:async';
 import 'dart:typed_data';
 import 'camera_interface.dart';
+import 'frame_ring.dart';
 import 'win32_wmf.dart';
 import 'android_uvc.dart';
 
@@ -10,7 +11,8 @@ class UVCCamera implements CameraInterface {
   bool _isCreated = false;
 
   UVCCamera() {
-    if (Platform.isWindows) {
+    if (Platform.isWindows || Platform.isLinux) {
+      // Linux 原生层 (V4L2) 实现了与 Windows 相同的方法通道
       _impl = WMFCamera();
     } else if (Platform.isAndroid) {
       _impl = AndroidUVCCamera();
@@ -54,6 +56,9 @@ class UVCCamera implements CameraInterface {
   @override
   Future<void> setContrast(double value) => _impl.setContrast(value);
 
+  @override
+  Future<void> setGamma(double value) => _impl.setGamma(value);
+
   @override
   Future<List<CameraResolution>> getSupportedResolutions() =>
       _impl.getSupportedResolutions();
@@ -62,9 +67,101 @@ class UVCCamera implements CameraInterface {
   Future<void> setResolution(CameraResolution resolution) =>
       _impl.setResolution(resolution);
 
+  @override
+  Future<void> setRawMode(bool enabled, {bool rawYuy2 = false}) =>
+      _impl.setRawMode(enabled, rawYuy2: rawYuy2);
+
+  @override
+  Future<void> setSkipUnconsumedFrames(bool enabled) =>
+      _impl.setSkipUnconsumedFrames(enabled);
+
+  @override
+  Future<void> setMaxPreviewSize(int width, int height) =>
+      _impl.setMaxPreviewSize(width, height);
+
+  @override
+  Future<void> setBurstBuffer(int megabytes,
+          {BurstEviction eviction = BurstEviction.oldest}) =>
+      _impl.setBurstBuffer(megabytes, eviction: eviction);
+
+  @override
+  Future<void> setPalette(String palette) => _impl.setPalette(palette);
+
+  @override
+  Future<void> setAgcMode(String mode) => _impl.setAgcMode(mode);
+
+  @override
+  Future<void> setTemporalDenoise(bool enabled,
+          {double? minWeight, double? noiseSigma}) =>
+      _impl.setTemporalDenoise(enabled,
+          minWeight: minWeight, noiseSigma: noiseSigma);
+
+  @override
+  Future<void> setNuc(bool enabled, {bool? shutterless}) =>
+      _impl.setNuc(enabled, shutterless: shutterless);
+
+  @override
+  Future<NucResult> captureNucReference(NucReference level,
+          {int frames = 32}) =>
+      _impl.captureNucReference(level, frames: frames);
+
+  @override
+  Future<NucResult> computeNuc({String? path}) =>
+      _impl.computeNuc(path: path);
+
+  @override
+  Future<void> loadNuc(String path) => _impl.loadNuc(path);
+
+  @override
+  Future<void> setBadPixels(bool enabled, {String? directory}) =>
+      _impl.setBadPixels(enabled, directory: directory);
+
+  @override
+  Future<BadPixelScanResult> scanBadPixels(
+          {int frames = 32, double kSigma = 6.0}) =>
+      _impl.scanBadPixels(frames: frames, kSigma: kSigma);
+
+  @override
+  Future<void> setRois(List<Roi> rois) => _impl.setRois(rois);
+
+  @override
+  Stream<RoiMeasurement> get roiStream => _impl.roiStream;
+
+  @override
+  Future<void> setFrameStream(bool enabled,
+          {int slots = 4,
+          int everyNth = 1,
+          double maxFps = 0,
+          int downscale = 1,
+          bool raw = false}) =>
+      _impl.setFrameStream(enabled,
+          slots: slots,
+          everyNth: everyNth,
+          maxFps: maxFps,
+          downscale: downscale,
+          raw: raw);
+
+  @override
+  Future<FrameRingReader?> getFrameRing() => _impl.getFrameRing();
+
+  @override
+  Future<Map<String, dynamic>> getPipelineStats({bool reset = false}) =>
+      _impl.getPipelineStats(reset: reset);
+
   @override
   Future<Uint8List?> capturePhoto() => _impl.capturePhoto();
 
+  @override
+  Future<SnapshotResult> captureToFile(String path,
+          {SnapshotFormat format = SnapshotFormat.png}) =>
+      _impl.captureToFile(path, format: format);
+
+  @override
+  Future<BurstResult> captureBurst(String path,
+          {double preSeconds = 2.0, double postSeconds = 0.0}) =>
+      _impl.captureBurst(path,
+          preSeconds: preSeconds, postSeconds: postSeconds);
+
   @override
   Stream<String> get onDeviceChanged => _impl.onDeviceChanged;
 
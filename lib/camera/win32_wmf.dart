@@ -1,18 +1,41 @@
 import 'dart:async';
 import 'package:flutter/services.dart';
 import 'camera_interface.dart';
+import 'frame_ring.dart';
+import 'telemetry_record.dart';
 
 class WMFCamera implements CameraInterface {
   static const MethodChannel _channel =
       MethodChannel('com.example.uvc_viewer/camera');
   static const MethodChannel _deviceChangeChannel =
       MethodChannel('com.example.uvc_viewer/device_change');
+  static const EventChannel _roiChannel =
+      EventChannel('com.example.uvc_viewer/roi');
 
-  final _frameStreamController = StreamController<CameraFrame>.broadcast();
+  // 有监听者时轮询帧环，把新帧送入 frameStream
+  late final _frameStreamController = StreamController<CameraFrame>.broadcast(
+    onListen: () => _frameRingTimer ??= Timer.periodic(
+        const Duration(milliseconds: 10), (_) => _pollFrameRing()),
+    onCancel: () {
+      _frameRingTimer?.cancel();
+      _frameRingTimer = null;
+    },
+  );
+  Timer? _frameRingTimer;
+  FrameRingReader? _frameRing;
+  bool _fetchingFrameRing = false;
+  int _lastRingFrame = -1;
   final _deviceChangeController = StreamController<String>.broadcast();
   bool _isInitialized = false;
   CameraResolution? _currentResolution;
   List<CameraResolution> _supportedResolutions = [];
+  bool _rawMode = false;
+  bool _rawYuy2 = false;
+  bool _skipUnconsumed = false;
+  int _maxPreviewWidth = 0;
+  int _maxPreviewHeight = 0;
+  int _burstBufferMb = 0;
+  BurstEviction _burstEviction = BurstEviction.oldest;
 
   @override
   Stream<CameraFrame> get frameStream => _frameStreamController.stream;
@@ -48,10 +71,25 @@ class WMFCamera implements CameraInterface {
 
   @override
   Future<int?> getTextureId() async {
-    final Map<String, dynamic> params = {'index': _deviceIndex};
+    final Map<String, dynamic> params = {
+      'index': _deviceIndex,
+      'rawMode': _rawMode,
+      'rawYuy2': _rawYuy2,
+      'skipUnconsumed': _skipUnconsumed,
+      'maxPreviewWidth': _maxPreviewWidth,
+      'maxPreviewHeight': _maxPreviewHeight,
+      'burstBufferMb': _burstBufferMb,
+      'burstEviction': _burstEviction.name,
+    };
     if (_currentResolution != null) {
       params['width'] = _currentResolution!.width;
       params['height'] = _currentResolution!.height;
+      // 精确帧率，原生层据此在同一分辨率的多个帧率中选择
+      if (_currentResolution!.fpsNumerator != null &&
+          _currentResolution!.fpsDenominator != null) {
+        params['fpsNumerator'] = _currentResolution!.fpsNumerator;
+        params['fpsDenominator'] = _currentResolution!.fpsDenominator;
+      }
     }
     final int? textureId = await _channel.invokeMethod('startPreview', params);
     return textureId;
@@ -104,11 +142,21 @@ class WMFCamera implements CameraInterface {
     await _channel.invokeMethod('setContrast', {'value': value});
   }
 
+  @override
+  Future<void> setGamma(double value) async {
+    await _channel.invokeMethod('setGamma', {'value': value});
+  }
+
   @override
   Future<List<CameraResolution>> getSupportedResolutions() async {
     try {
       final List<dynamic>? result = await _channel
-          .invokeMethod('getSupportedResolutions', {'index': _deviceIndex});
+          .invokeMethod('getSupportedResolutions', {
+        'index': _deviceIndex,
+        // 列出的格式取决于是否为 raw 模式
+        'rawMode': _rawMode,
+        'rawYuy2': _rawYuy2,
+      });
       if (result != null) {
         return result.map((item) {
           final map = item as Map<dynamic, dynamic>;
@@ -116,6 +164,9 @@ class WMFCamera implements CameraInterface {
             width: map['width'] as int,
             height: map['height'] as int,
             frameRate: (map['frameRate'] as int?) ?? 30,
+            subtype: map['subtype'] as String?,
+            fpsNumerator: map['fpsNumerator'] as int?,
+            fpsDenominator: map['fpsDenominator'] as int?,
           );
         }).toList();
       }
@@ -144,6 +195,183 @@ class WMFCamera implements CameraInterface {
     }
   }
 
+  @override
+  Future<void> setRawMode(bool enabled, {bool rawYuy2 = false}) async {
+    // 原生层在 startPreview 时协商格式，因此只需记录
+    _rawMode = enabled;
+    _rawYuy2 = rawYuy2;
+  }
+
+  @override
+  Future<void> setSkipUnconsumedFrames(bool enabled) async {
+    // 与 rawMode 相同，在 startPreview 时传给原生层
+    _skipUnconsumed = enabled;
+  }
+
+  @override
+  Future<void> setMaxPreviewSize(int width, int height) async {
+    // 同样在 startPreview 时传给原生层
+    _maxPreviewWidth = width;
+    _maxPreviewHeight = height;
+  }
+
+  @override
+  Future<void> setBurstBuffer(int megabytes,
+      {BurstEviction eviction = BurstEviction.oldest}) async {
+    // 缓冲区在 startPreview 时按协商出的帧格式分配
+    _burstBufferMb = megabytes;
+    _burstEviction = eviction;
+  }
+
+  @override
+  Future<void> setPalette(String palette) async {
+    await _channel.invokeMethod('setPalette', {'palette': palette});
+  }
+
+  @override
+  Future<void> setAgcMode(String mode) async {
+    await _channel.invokeMethod('setAgc', {'mode': mode});
+  }
+
+  @override
+  Future<void> setTemporalDenoise(bool enabled,
+      {double? minWeight, double? noiseSigma}) async {
+    await _channel.invokeMethod('setDenoise', {
+      'enabled': enabled,
+      if (minWeight != null) 'minWeight': minWeight,
+      if (noiseSigma != null) 'noiseSigma': noiseSigma,
+    });
+  }
+
+  @override
+  Future<void> setNuc(bool enabled, {bool? shutterless}) async {
+    await _channel.invokeMethod('setNuc', {
+      'enabled': enabled,
+      if (shutterless != null) 'shutterless': shutterless,
+    });
+  }
+
+  @override
+  Future<NucResult> captureNucReference(NucReference level,
+      {int frames = 32}) async {
+    // 参考帧采集完、平均完才返回
+    final result = await _channel.invokeMethod<Map>('captureNucReference', {
+      'level': level.name,
+      'frames': frames,
+    });
+    return NucResult.fromMap(result!);
+  }
+
+  @override
+  Future<NucResult> computeNuc({String? path}) async {
+    final result = await _channel.invokeMethod<Map>('computeNuc', {
+      if (path != null) 'path': path,
+    });
+    return NucResult.fromMap(result!);
+  }
+
+  @override
+  Future<void> loadNuc(String path) async {
+    await _channel.invokeMethod('loadNuc', {'path': path});
+  }
+
+  @override
+  Future<void> setBadPixels(bool enabled, {String? directory}) async {
+    await _channel.invokeMethod('setBadPixels', {
+      'enabled': enabled,
+      if (directory != null) 'directory': directory,
+    });
+  }
+
+  @override
+  Future<BadPixelScanResult> scanBadPixels(
+      {int frames = 32, double kSigma = 6.0}) async {
+    // 检测完成、坏点表保存后才返回
+    final result = await _channel.invokeMethod<Map>('scanBadPixels', {
+      'frames': frames,
+      'kSigma': kSigma,
+    });
+    return BadPixelScanResult.fromMap(result!);
+  }
+
+  @override
+  Future<void> setRois(List<Roi> rois) async {
+    await _channel.invokeMethod('setRois', {
+      'rois': [for (final roi in rois) roi.toMap()],
+    });
+  }
+
+  @override
+  Stream<RoiMeasurement> get roiStream => _roiChannel
+      .receiveBroadcastStream()
+      .map((event) => TelemetryRecord.tryParse(event as Uint8List))
+      .where((record) => record?.kind == TelemetryKind.roi)
+      .map((record) => RoiMeasurement.fromRecord(record!));
+
+  @override
+  Future<void> setFrameStream(bool enabled,
+      {int slots = 4,
+      int everyNth = 1,
+      double maxFps = 0,
+      int downscale = 1,
+      bool raw = false}) async {
+    await _channel.invokeMethod('setFrameStream', {
+      'enabled': enabled,
+      'slots': slots,
+      'everyNth': everyNth,
+      'maxFps': maxFps,
+      'downscale': downscale,
+      'raw': raw,
+    });
+  }
+
+  @override
+  Future<FrameRingReader?> getFrameRing() async {
+    final result = await _channel.invokeMethod<Map>('getFrameRing');
+    return FrameRingReader.fromMap(result);
+  }
+
+  void _pollFrameRing() {
+    final ring = _frameRing;
+    if (ring == null || ring.closed) {
+      // 预览重启后帧环可能换了地址
+      if (_fetchingFrameRing) return;
+      _fetchingFrameRing = true;
+      getFrameRing().then((reader) {
+        if (reader?.address != _frameRing?.address) _lastRingFrame = -1;
+        _frameRing = reader;
+      }).catchError((_) {
+        _frameRing = null;
+      }).whenComplete(() => _fetchingFrameRing = false);
+      return;
+    }
+    if (ring.written - 1 == _lastRingFrame) return;
+    final (status, frame) = ring.readLatest();
+    if (status != FrameRingRead.ok || frame == null) return;
+    _lastRingFrame = frame.frame;
+    _frameStreamController.add(CameraFrame(
+      bytes: frame.pixels,
+      width: ring.width,
+      height: ring.height,
+      raw: ring.isRaw,
+      sequence: frame.sequence,
+    ));
+  }
+
+  @override
+  Future<Map<String, dynamic>> getPipelineStats({bool reset = false}) async {
+    final result = await _channel.invokeMethod<Map>('getPipelineStats', {
+      'reset': reset,
+    });
+    if (result == null) {
+      return {};
+    }
+    return result.map((key, value) => MapEntry(
+          key as String,
+          value is Map ? Map<String, dynamic>.from(value) : value,
+        ));
+  }
+
   @override
   Future<Uint8List?> capturePhoto() async {
     try {
@@ -157,11 +385,35 @@ class WMFCamera implements CameraInterface {
     return null;
   }
 
+  @override
+  Future<SnapshotResult> captureToFile(String path,
+      {SnapshotFormat format = SnapshotFormat.png}) async {
+    // 编码与写盘都在原生后台线程完成，这里只收到路径与耗时
+    final result = await _channel.invokeMethod<Map>('captureToFile', {
+      'path': path,
+      'format': format.name,
+    });
+    return SnapshotResult.fromMap(result!);
+  }
+
+  @override
+  Future<BurstResult> captureBurst(String path,
+      {double preSeconds = 2.0, double postSeconds = 0.0}) async {
+    // 触发后的帧采集完、文件写完才返回
+    final result = await _channel.invokeMethod<Map>('captureBurst', {
+      'path': path,
+      'preSeconds': preSeconds,
+      'postSeconds': postSeconds,
+    });
+    return BurstResult.fromMap(result!);
+  }
+
   @override
   Stream<String> get onDeviceChanged => _deviceChangeController.stream;
 
   @override
   void dispose() {
+    _frameRingTimer?.cancel();
     _frameStreamController.close();
     _deviceChangeController.close();
   }
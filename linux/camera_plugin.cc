@@ -0,0 +1,1426 @@
+#include "camera_plugin.h"
+
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "agc.h"
+#include "bad_pixels.h"
+#include "burst_recorder.h"
+#include "capture_worker.h"
+#include "format_negotiation.h"
+#include "frame_notifier.h"
+#include "frame_pool.h"
+#include "frame_ring.h"
+#include "frame_source.h"
+#include "latest_frames.h"
+#if defined(UVC_HAVE_JPEG)
+#include "mjpeg_pipeline.h"
+#endif
+#include "nuc.h"
+#include "pipeline_stats.h"
+#include "pixel_convert.h"
+#include "raw_convert.h"
+#include "roi_engine.h"
+#include "snapshot_writer.h"
+#include "temporal_denoise.h"
+#include "thermal_palette.h"
+#include "tone_curve.h"
+#include "triple_buffer.h"
+#include "v4l2_device.h"
+#include "virtual_camera.h"
+#include "yuv_convert.h"
+
+class V4l2Camera;
+
+// The preview texture. The raster thread pulls frames from the camera.
+G_DECLARE_FINAL_TYPE(CameraTexture, camera_texture, CAMERA, TEXTURE,
+                     FlPixelBufferTexture)
+
+struct _CameraTexture {
+  FlPixelBufferTexture parent_instance;
+  V4l2Camera* camera;
+};
+
+G_DEFINE_TYPE(CameraTexture, camera_texture, fl_pixel_buffer_texture_get_type())
+
+static gboolean camera_texture_copy_pixels(FlPixelBufferTexture* texture,
+                                           const uint8_t** out_buffer,
+                                           uint32_t* width, uint32_t* height,
+                                           GError** error);
+
+static void camera_texture_class_init(CameraTextureClass* klass) {
+  FL_PIXEL_BUFFER_TEXTURE_CLASS(klass)->copy_pixels =
+      camera_texture_copy_pixels;
+}
+
+static void camera_texture_init(CameraTexture* self) {}
+
+static CameraTexture* camera_texture_new(V4l2Camera* camera) {
+  CameraTexture* self =
+      CAMERA_TEXTURE(g_object_new(camera_texture_get_type(), nullptr));
+  self->camera = camera;
+  return self;
+}
+
+namespace {
+
+// How long closing waits for the capture thread before reporting it stuck.
+constexpr std::chrono::milliseconds kStopTimeout(500);
+
+// Method results. Both take ownership of |value|.
+FlMethodResponse* Success(FlValue* value = nullptr) {
+  FlMethodResponse* response =
+      FL_METHOD_RESPONSE(fl_method_success_response_new(value));
+  if (value != nullptr) fl_value_unref(value);
+  return response;
+}
+
+FlMethodResponse* Error(const char* code, const char* message) {
+  return FL_METHOD_RESPONSE(
+      fl_method_error_response_new(code, message, nullptr));
+}
+
+// The argument |key| if the call has one, of any type.
+FlValue* Lookup(FlValue* args, const char* key) {
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return nullptr;
+  }
+  return fl_value_lookup_string(args, key);
+}
+
+// The argument |key| if it is present and of |type|.
+FlValue* Arg(FlValue* args, const char* key, FlValueType type) {
+  FlValue* value = Lookup(args, key);
+  return value != nullptr && fl_value_get_type(value) == type ? value
+                                                              : nullptr;
+}
+
+int64_t IntArg(FlValue* args, const char* key, int64_t fallback) {
+  FlValue* value = Arg(args, key, FL_VALUE_TYPE_INT);
+  return value != nullptr ? fl_value_get_int(value) : fallback;
+}
+
+bool BoolArg(FlValue* args, const char* key, bool fallback) {
+  FlValue* value = Arg(args, key, FL_VALUE_TYPE_BOOL);
+  return value != nullptr ? fl_value_get_bool(value) : fallback;
+}
+
+double DoubleArg(FlValue* args, const char* key, double fallback) {
+  FlValue* value = Arg(args, key, FL_VALUE_TYPE_FLOAT);
+  return value != nullptr ? fl_value_get_float(value) : fallback;
+}
+
+// The captureToFile result: where the file went and what it cost, in
+// microseconds.
+FlMethodResponse* SnapshotResponse(const uvc::SnapshotResult& result) {
+  if (!result.ok) {
+    return Error("WRITE_FAILED", result.error.c_str());
+  }
+  FlValue* value = fl_value_new_map();
+  fl_value_set_string_take(value, "path",
+                           fl_value_new_string(result.path.c_str()));
+  fl_value_set_string_take(value, "bytes", fl_value_new_int(result.bytes));
+  const std::pair<const char*, int64_t> timings[] = {
+      {"queuedUs", result.queued_ns},
+      {"encodeUs", result.encode_ns},
+      {"writeUs", result.write_ns},
+  };
+  for (const auto& timing : timings) {
+    fl_value_set_string_take(value, timing.first,
+                             fl_value_new_float(timing.second / 1e3));
+  }
+  return Success(value);
+}
+
+// The captureBurst result: the recording and where its frames lie
+// relative to the trigger.
+FlMethodResponse* BurstResponse(const uvc::BurstResult& result) {
+  if (!result.ok) {
+    return Error("WRITE_FAILED", result.error.c_str());
+  }
+  FlValue* value = fl_value_new_map();
+  fl_value_set_string_take(value, "path",
+                           fl_value_new_string(result.path.c_str()));
+  fl_value_set_string_take(value, "frames", fl_value_new_int(result.frames));
+  fl_value_set_string_take(value, "preFrames",
+                           fl_value_new_int(result.pre_frames));
+  fl_value_set_string_take(value, "firstOffsetMs",
+                           fl_value_new_float(result.first_offset / 1e4));
+  fl_value_set_string_take(value, "lastOffsetMs",
+                           fl_value_new_float(result.last_offset / 1e4));
+  fl_value_set_string_take(value, "truncated",
+                           fl_value_new_bool(result.truncated));
+  fl_value_set_string_take(value, "writeUs",
+                           fl_value_new_float(result.write_ns / 1e3));
+  return Success(value);
+}
+
+// A NUC result: the reference averaged, or the tables computed and where
+// they were saved.
+FlMethodResponse* NucResponse(const uvc::NucResult& result) {
+  if (!result.ok) {
+    return Error("NUC_FAILED", result.error.c_str());
+  }
+  FlValue* value = fl_value_new_map();
+  fl_value_set_string_take(value, "frames", fl_value_new_int(result.frames));
+  fl_value_set_string_take(value, "mean", fl_value_new_float(result.mean));
+  fl_value_set_string_take(value, "twoPoint",
+                           fl_value_new_bool(result.two_point));
+  fl_value_set_string_take(value, "path",
+                           fl_value_new_string(result.path.c_str()));
+  fl_value_set_string_take(value, "computeUs",
+                           fl_value_new_float(result.compute_ns / 1e3));
+  return Success(value);
+}
+
+// A bad-pixel scan result: how many were found and where the map went.
+FlMethodResponse* BadPixelResponse(const uvc::BadPixelResult& result) {
+  if (!result.ok) {
+    return Error("BAD_PIXELS_FAILED", result.error.c_str());
+  }
+  FlValue* value = fl_value_new_map();
+  fl_value_set_string_take(value, "count", fl_value_new_int(result.count));
+  fl_value_set_string_take(value, "frames", fl_value_new_int(result.frames));
+  fl_value_set_string_take(value, "path",
+                           fl_value_new_string(result.path.c_str()));
+  fl_value_set_string_take(value, "detectUs",
+                           fl_value_new_float(result.detect_ns / 1e3));
+  return Success(value);
+}
+
+// The ROIs of a setRois call: a list of {id, shape, points}, with the
+// points as a flat [x0, y0, x1, y1, ...] list. False on a malformed entry.
+bool ParseRois(FlValue* list, std::vector<uvc::Roi>* rois) {
+  for (size_t i = 0; i < fl_value_get_length(list); i++) {
+    FlValue* entry = fl_value_get_list_value(list, i);
+    FlValue* shape = Arg(entry, "shape", FL_VALUE_TYPE_STRING);
+    FlValue* points = Arg(entry, "points", FL_VALUE_TYPE_LIST);
+    uvc::Roi roi;
+    roi.id = static_cast<int32_t>(IntArg(entry, "id", static_cast<int64_t>(i)));
+    if (shape == nullptr || points == nullptr ||
+        !uvc::ParseRoiShape(fl_value_get_string(shape), &roi.shape) ||
+        fl_value_get_length(points) % 2 != 0) {
+      return false;
+    }
+    for (size_t j = 0; j < fl_value_get_length(points); j += 2) {
+      FlValue* x = fl_value_get_list_value(points, j);
+      FlValue* y = fl_value_get_list_value(points, j + 1);
+      if (fl_value_get_type(x) != FL_VALUE_TYPE_INT ||
+          fl_value_get_type(y) != FL_VALUE_TYPE_INT) {
+        return false;
+      }
+      roi.points.push_back({static_cast<int32_t>(fl_value_get_int(x)),
+                            static_cast<int32_t>(fl_value_get_int(y))});
+    }
+    rois->push_back(std::move(roi));
+  }
+  return true;
+}
+
+// A response made off the main thread, sent from it.
+struct PendingResponse {
+  FlMethodCall* method_call;
+  FlMethodResponse* response;
+};
+
+gboolean SendPendingResponse(gpointer data) {
+  PendingResponse* pending = static_cast<PendingResponse*>(data);
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(pending->method_call, pending->response,
+                              &error)) {
+    g_warning("Failed to send response: %s", error->message);
+  }
+  g_object_unref(pending->response);
+  g_object_unref(pending->method_call);
+  delete pending;
+  return G_SOURCE_REMOVE;
+}
+
+// One getSupportedResolutions entry. frameRate is the rounded rate for
+// older callers; fpsNumerator / fpsDenominator are exact.
+FlValue* ResolutionValue(const uvc::Capability& capability) {
+  const uvc::FrameRate rate = capability.rate.known()
+                                  ? capability.rate.Reduced()
+                                  : uvc::FrameRate{30, 1};
+  FlValue* resolution = fl_value_new_map();
+  fl_value_set_string_take(resolution, "width",
+                           fl_value_new_int(capability.width));
+  fl_value_set_string_take(resolution, "height",
+                           fl_value_new_int(capability.height));
+  fl_value_set_string_take(
+      resolution, "frameRate",
+      fl_value_new_int(static_cast<int64_t>(rate.ToDouble() + 0.5)));
+  fl_value_set_string_take(resolution, "fpsNumerator",
+                           fl_value_new_int(rate.numerator));
+  fl_value_set_string_take(resolution, "fpsDenominator",
+                           fl_value_new_int(rate.denominator));
+  fl_value_set_string_take(
+      resolution, "subtype",
+      fl_value_new_string(uvc::VideoSubtypeName(capability.subtype)));
+  return resolution;
+}
+
+// Everything enumerateDevices lists: V4L2 capture nodes first, then the
+// virtual cameras from UVC_VIRTUAL_CAMERAS. Indices from Dart refer to this
+// order.
+struct DeviceList {
+  std::vector<uvc::V4l2DeviceInfo> cameras;
+  std::vector<uvc::VirtualCameraSpec> virtual_cameras;
+
+  size_t size() const { return cameras.size() + virtual_cameras.size(); }
+  bool Contains(int64_t index) const {
+    return index >= 0 && static_cast<size_t>(index) < size();
+  }
+  bool IsVirtual(int64_t index) const {
+    return static_cast<size_t>(index) >= cameras.size();
+  }
+  const uvc::VirtualCameraSpec& Virtual(int64_t index) const {
+    return virtual_cameras[index - cameras.size()];
+  }
+  std::string Name(int64_t index) const {
+    return IsVirtual(index) ? uvc::VirtualCameraName(Virtual(index))
+                            : cameras[index].card;
+  }
+  // Names the device's saved bad-pixel map: the USB serial number where
+  // there is one, else the port it is plugged into.
+  std::string Key(int64_t index) const {
+    if (IsVirtual(index)) return Name(index);
+    const uvc::V4l2DeviceInfo& camera = cameras[index];
+    return camera.card + "-" +
+           (camera.serial.empty() ? camera.bus_info : camera.serial);
+  }
+};
+
+int64_t ElapsedNs(std::chrono::steady_clock::time_point since) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - since)
+      .count();
+}
+
+DeviceList ListDevices() {
+  return DeviceList{uvc::EnumerateV4l2Devices(),
+                    uvc::VirtualCamerasFromEnvironment()};
+}
+
+}  // namespace
+
+// Capture state shared by the method handlers (platform thread), the capture
+// thread and the texture (raster thread). Mirrors the Windows CameraPlugin.
+class V4l2Camera {
+ public:
+  V4l2Camera(FlTextureRegistrar* texture_registrar,
+             FlBinaryMessenger* messenger)
+      : texture_registrar_(FL_TEXTURE_REGISTRAR(
+            g_object_ref(texture_registrar))) {
+    g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+    roi_channel_ = fl_event_channel_new(messenger, "com.example.uvc_viewer/roi",
+                                        FL_METHOD_CODEC(codec));
+    fl_event_channel_set_stream_handlers(roi_channel_, RoiListenCb,
+                                         RoiCancelCb, this, nullptr);
+  }
+
+  ~V4l2Camera() {
+    StopPreview();
+    // The capture thread is gone; drop an ROI frame still waiting to be
+    // sent.
+    g_idle_remove_by_data(this);
+    fl_event_channel_set_stream_handlers(roi_channel_, nullptr, nullptr,
+                                         nullptr, nullptr);
+    g_object_unref(roi_channel_);
+    g_object_unref(texture_registrar_);
+  }
+
+  V4l2Camera(const V4l2Camera&) = delete;
+  V4l2Camera& operator=(const V4l2Camera&) = delete;
+
+  FlMethodResponse* EnumerateDevices() {
+    const DeviceList devices = ListDevices();
+    FlValue* names = fl_value_new_list();
+    for (size_t i = 0; i < devices.size(); i++) {
+      fl_value_append_take(names,
+                           fl_value_new_string(devices.Name(i).c_str()));
+    }
+    return Success(names);
+  }
+
+  FlMethodResponse* StartPreview(FlValue* args) {
+    const int64_t index = IntArg(args, "index", 0);
+    const bool raw_mode = BoolArg(args, "rawMode", false);
+    // Whether the camera's YUYV carries counts; colour webcams offer YUYV
+    // too, so raw mode leaves it to the colour path unless told otherwise.
+    const bool raw_yuy2 = BoolArg(args, "rawYuy2", false);
+    const bool skip_unconsumed = BoolArg(args, "skipUnconsumed", false);
+    const uint32_t width = static_cast<uint32_t>(IntArg(args, "width", 0));
+    const uint32_t height = static_cast<uint32_t>(IntArg(args, "height", 0));
+    const uvc::FrameRate rate{
+        static_cast<uint32_t>(IntArg(args, "fpsNumerator", 0)),
+        static_cast<uint32_t>(IntArg(args, "fpsDenominator", 1))};
+    // MJPEG is decoded at the smallest 1/8 scale that still covers this.
+    const uint32_t max_preview_width =
+        static_cast<uint32_t>(IntArg(args, "maxPreviewWidth", 0));
+    const uint32_t max_preview_height =
+        static_cast<uint32_t>(IntArg(args, "maxPreviewHeight", 0));
+    // Pre-trigger history for captureBurst; 0 keeps none.
+    const int64_t burst_buffer_mb = IntArg(args, "burstBufferMb", 0);
+    uvc::BurstEviction burst_eviction = uvc::BurstEviction::kOldest;
+    FlValue* eviction_name = Arg(args, "burstEviction", FL_VALUE_TYPE_STRING);
+    if (eviction_name != nullptr &&
+        !uvc::ParseBurstEviction(fl_value_get_string(eviction_name),
+                                 &burst_eviction)) {
+      return Error("INVALID_ARGUMENT", "Unknown burst eviction policy");
+    }
+
+    StopPreview();
+
+    const DeviceList devices = ListDevices();
+    if (!devices.Contains(index)) {
+      return Error("OPEN_FAILED", "Failed to open device");
+    }
+    std::unique_ptr<uvc::FrameSource> source;
+    if (devices.IsVirtual(index)) {
+      source = uvc::CreateVirtualCamera(devices.Virtual(index));
+      if (!source) return Error("OPEN_FAILED", "Failed to open device");
+    } else {
+      auto camera = std::make_unique<uvc::V4l2Source>();
+      // Raw mode asks for the camera's 16-bit format; without one it falls
+      // back to the colour path, as on Windows.
+      switch (camera->Open(devices.cameras[index].path, raw_mode, raw_yuy2,
+                           width, height, rate)) {
+        case uvc::V4l2Source::OpenResult::kOk:
+          break;
+        case uvc::V4l2Source::OpenResult::kOpenFailed:
+          return Error("OPEN_FAILED", "Failed to open device");
+        case uvc::V4l2Source::OpenResult::kUnsupportedFormat:
+          return Error("UNSUPPORTED_FORMAT", "No supported pixel format");
+        case uvc::V4l2Source::OpenResult::kFormatFailed:
+          return Error("OPEN_FAILED", "Failed to set the capture format");
+      }
+      source = std::move(camera);
+    }
+    // A 16-bit virtual camera is always shown through AGC.
+    mode_ = source->mode();
+    raw_packing_ = uvc::RawPackingForMode(mode_);
+
+    uvc::FrameFormat format;
+    format.pixel_format = uvc::PixelFormat::kRgba8;
+    format.width = mode_.width;
+    format.height = mode_.height;
+#if defined(UVC_HAVE_JPEG)
+    uvc::MjpegPipelineOptions mjpeg_options;
+    if (mode_.format == uvc::SourcePixelFormat::kMjpeg) {
+      mjpeg_options.decode.target_width = max_preview_width;
+      mjpeg_options.decode.target_height = max_preview_height;
+      uvc::MjpegOutputSize(mode_.width, mode_.height, mjpeg_options.decode,
+                           &format.width, &format.height);
+    }
+#else
+    (void)max_preview_width;
+    (void)max_preview_height;
+#endif
+    bool pools_ready = frame_pool_.Configure(format, 5, 8);
+    if (pools_ready && raw_packing_ != uvc::RawPacking::kNone) {
+      format.pixel_format = uvc::PixelFormat::kGray16;
+      pools_ready = raw_pool_.Configure(format, 3, 6);
+    }
+    if (!pools_ready) {
+      return Error("OUT_OF_MEMORY", "Failed to allocate frame buffers");
+    }
+    // Both wait for a burst still being written from the previous session.
+    // Compressed frames cannot be recorded.
+    if (burst_buffer_mb <= 0 ||
+        mode_.format == uvc::SourcePixelFormat::kMjpeg) {
+      burst_.Reset();
+    } else if (!burst_.Configure(mode_,
+                                 static_cast<size_t>(burst_buffer_mb) << 20,
+                                 burst_eviction)) {
+      g_warning("No burst buffer: %lld MB hold fewer than %u frames of %ux%u",
+                static_cast<long long>(burst_buffer_mb),
+                static_cast<unsigned>(uvc::BurstRecorder::kMinFrames),
+                mode_.width, mode_.height);
+    }
+    // The frame stream carries the counts only when asked to in raw mode.
+    uvc::FrameFormat ring_format = format;
+    if (!frame_ring_config_.raw || raw_packing_ == uvc::RawPacking::kNone) {
+      ring_format.pixel_format = uvc::PixelFormat::kRgba8;
+    }
+    frame_ring_.Configure(frame_ring_config_, ring_format);
+    // Another device's map would replace good pixels.
+    device_key_ = devices.Key(index);
+    LoadBadPixelMap();
+    agc_.Reset();
+    denoise_.Reset();
+    stats_.Reset();
+    stats_.OnSourceRestarted();
+    notifier_.Reset();
+    skip_unconsumed_ = skip_unconsumed;
+
+    if (!source->Start()) {
+      source->Stop();
+      // Nothing will write them; readers of the ring see it closed.
+      frame_ring_.Close();
+      burst_.Reset();
+      return Error("STREAM_FAILED", "Failed to start streaming");
+    }
+    if (!devices.IsVirtual(index)) {
+      const uvc::V4l2Device& device =
+          static_cast<uvc::V4l2Source*>(source.get())->device();
+      g_message("Streaming %s %ux%u with %s buffers",
+                devices.cameras[index].path.c_str(), mode_.width, mode_.height,
+                device.io_mode() == uvc::V4l2IoMode::kDmabuf ? "DMABUF"
+                                                             : "MMAP");
+    }
+    source_ = std::move(source);
+
+    texture_ = camera_texture_new(this);
+    fl_texture_registrar_register_texture(texture_registrar_,
+                                          FL_TEXTURE(texture_));
+    texture_id_ = fl_texture_get_id(FL_TEXTURE(texture_));
+
+#if defined(UVC_HAVE_JPEG)
+    if (mode_.format == uvc::SourcePixelFormat::kMjpeg) {
+      mjpeg_.Start(mjpeg_options, &frame_pool_, [this](uvc::FrameRef frame) {
+        PublishFrame(std::move(frame), uvc::FrameRef());
+      });
+    }
+#endif
+    worker_.Start([this] { CaptureLoop(); }, [this] { source_->Interrupt(); });
+    return Success(fl_value_new_int(texture_id_));
+  }
+
+  FlMethodResponse* CloseDevice() {
+    StopPreview();
+    return Success();
+  }
+
+  FlMethodResponse* GetDeviceStatus(FlValue* args) {
+    const int64_t index = IntArg(args, "index", 0);
+    const DeviceList devices = ListDevices();
+    const bool connected = devices.Contains(index);
+    const bool available =
+        connected &&
+        (devices.IsVirtual(index) ||
+         access(devices.cameras[index].path.c_str(), R_OK | W_OK) == 0);
+
+    FlValue* status = fl_value_new_map();
+    fl_value_set_string_take(status, "isConnected",
+                             fl_value_new_bool(connected));
+    fl_value_set_string_take(status, "isAvailable",
+                             fl_value_new_bool(available));
+    fl_value_set_string_take(status, "deviceCount",
+                             fl_value_new_int(devices.size()));
+    if (connected) {
+      fl_value_set_string_take(
+          status, "deviceName",
+          fl_value_new_string(devices.Name(index).c_str()));
+    }
+    return Success(status);
+  }
+
+  FlMethodResponse* GetSupportedResolutions(FlValue* args) {
+    const int64_t index = IntArg(args, "index", 0);
+    FlValue* resolutions = fl_value_new_list();
+    const DeviceList devices = ListDevices();
+    if (!devices.Contains(index)) return Success(resolutions);
+
+    if (devices.IsVirtual(index)) {
+      // A virtual camera has exactly one mode.
+      std::unique_ptr<uvc::FrameSource> source =
+          uvc::CreateVirtualCamera(devices.Virtual(index));
+      if (source) {
+        fl_value_append_take(
+            resolutions, ResolutionValue(uvc::CapabilityForMode(source->mode())));
+      }
+      return Success(resolutions);
+    }
+
+    // V4L2 allows a second handle for queries while the first streams.
+    uvc::V4l2Device device;
+    if (!device.Open(devices.cameras[index].path)) {
+      return Success(resolutions);
+    }
+    const uvc::CapabilityIndex capabilities =
+        uvc::IndexV4l2Modes(device.EnumerateModes());
+    // Each size is reported with the type and exact rate StartPreview would
+    // open for it.
+    uvc::FormatRequest request;
+    request.raw = BoolArg(args, "rawMode", false);
+    request.raw_yuy2 = BoolArg(args, "rawYuy2", false);
+    request.direct_subtypes = uvc::kV4l2DirectSubtypes;
+    for (const auto& size : capabilities.Sizes()) {
+      request.width = size.first;
+      request.height = size.second;
+      uvc::NegotiatedFormat negotiated;
+      if (uvc::NegotiatePreviewFormat(capabilities, request, &negotiated) &&
+          negotiated.native.width == size.first &&
+          negotiated.native.height == size.second) {
+        fl_value_append_take(resolutions, ResolutionValue(negotiated.native));
+      }
+    }
+    return Success(resolutions);
+  }
+
+  FlMethodResponse* CapturePhoto() {
+    const uvc::FrameRef frame = latest_.frame();
+    if (!frame) return Error("NO_FRAME", "No frame available to capture");
+    return Success(fl_value_new_uint8_list(frame.data(), frame.size()));
+  }
+
+  // Queues the latest frame (png) or its raw counts (tiff) to be written to
+  // the path argument by the snapshot worker, and answers |method_call| from
+  // there. Returns the response now only if nothing was queued.
+  FlMethodResponse* CaptureToFile(FlMethodCall* method_call, FlValue* args) {
+    FlValue* path = Arg(args, "path", FL_VALUE_TYPE_STRING);
+    if (path == nullptr) {
+      return Error("INVALID_ARGUMENT", "A path is required");
+    }
+    uvc::SnapshotFormat format = uvc::SnapshotFormat::kPng;
+    FlValue* format_name = Arg(args, "format", FL_VALUE_TYPE_STRING);
+    if (format_name != nullptr &&
+        !uvc::ParseSnapshotFormat(fl_value_get_string(format_name),
+                                  &format)) {
+      return Error("INVALID_FORMAT", "Unknown snapshot format");
+    }
+    uvc::FrameRef frame = format == uvc::SnapshotFormat::kTiff16
+                              ? latest_.counts()
+                              : latest_.frame();
+    if (!frame) return Error("NO_FRAME", "No frame available to capture");
+
+    g_object_ref(method_call);
+    const bool queued = snapshots_.Submit(
+        std::move(frame), format, fl_value_get_string(path),
+        [method_call](const uvc::SnapshotResult& result) {
+          PendingResponse* pending =
+              new PendingResponse{method_call, SnapshotResponse(result)};
+          g_idle_add(SendPendingResponse, pending);
+        });
+    if (!queued) {
+      g_object_unref(method_call);
+      return Error("BUSY", "Earlier snapshots are still being written");
+    }
+    return nullptr;
+  }
+
+  // Saves the preSeconds before now and the postSeconds after it from the
+  // burst buffer to the path argument, as a recording, and answers
+  // |method_call| once the file is written. Returns the response now only if
+  // no burst was started.
+  FlMethodResponse* CaptureBurst(FlMethodCall* method_call, FlValue* args) {
+    FlValue* path = Arg(args, "path", FL_VALUE_TYPE_STRING);
+    if (path == nullptr) {
+      return Error("INVALID_ARGUMENT", "A path is required");
+    }
+    const double pre_seconds = DoubleArg(args, "preSeconds", 2.0);
+    const double post_seconds = DoubleArg(args, "postSeconds", 0.0);
+    if (!burst_.configured()) {
+      return Error("NO_BUFFER", "Preview was started without burstBufferMb");
+    }
+
+    g_object_ref(method_call);
+    const bool started = burst_.Trigger(
+        uvc::SteadyNow100ns(), static_cast<int64_t>(pre_seconds * 1e7),
+        static_cast<int64_t>(post_seconds * 1e7), fl_value_get_string(path),
+        [method_call](const uvc::BurstResult& result) {
+          PendingResponse* pending =
+              new PendingResponse{method_call, BurstResponse(result)};
+          g_idle_add(SendPendingResponse, pending);
+        });
+    if (!started) {
+      g_object_unref(method_call);
+      return Error("BUSY", "The previous burst is still being written");
+    }
+    return nullptr;
+  }
+
+  // Pulls the counters and per-stage latency percentiles (microseconds)
+  // since the last reset; with reset: true, starts a new window afterwards.
+  FlMethodResponse* GetPipelineStats(FlValue* args) {
+    uvc::PipelineStatsSnapshot snapshot;
+    stats_.Read(&snapshot);
+    if (BoolArg(args, "reset", false)) stats_.Reset();
+
+    const uvc::PipelineCounters& counters = snapshot.counters;
+    FlValue* result = fl_value_new_map();
+    fl_value_set_string_take(result, "intervalSeconds",
+                             fl_value_new_float(snapshot.interval_seconds));
+    fl_value_set_string_take(result, "captureFps",
+                             fl_value_new_float(snapshot.capture_fps));
+    fl_value_set_string_take(result, "presentFps",
+                             fl_value_new_float(snapshot.present_fps));
+    const std::pair<const char*, uint64_t> values[] = {
+        {"captured", counters.captured},
+        {"published", counters.published},
+        {"notified", counters.notified},
+        {"skippedUnconsumed", counters.skipped_unconsumed},
+        {"presented", counters.presented},
+        {"duplicated", counters.duplicated},
+        {"droppedSource", counters.dropped_source},
+        {"droppedPool", counters.dropped_pool},
+    };
+    for (const auto& value : values) {
+      fl_value_set_string_take(result, value.first,
+                               fl_value_new_int(value.second));
+    }
+
+    FlValue* stages = fl_value_new_map();
+    for (size_t i = 0; i < uvc::kPipelineStageCount; i++) {
+      const uvc::LatencyHistogram::Snapshot& histogram = snapshot.stages[i];
+      const std::pair<const char*, double> percentiles[] = {
+          {"meanUs", histogram.Mean()},
+          {"p50Us", histogram.ValueAtQuantile(0.5)},
+          {"p90Us", histogram.ValueAtQuantile(0.9)},
+          {"p99Us", histogram.ValueAtQuantile(0.99)},
+          {"p999Us", histogram.ValueAtQuantile(0.999)},
+          {"maxUs", histogram.Max()},
+      };
+      FlValue* stage = fl_value_new_map();
+      fl_value_set_string_take(stage, "count",
+                               fl_value_new_int(histogram.count));
+      for (const auto& percentile : percentiles) {
+        fl_value_set_string_take(stage, percentile.first,
+                                 fl_value_new_float(percentile.second / 1e3));
+      }
+      fl_value_set_string_take(
+          stages,
+          uvc::PipelineStageName(static_cast<uvc::PipelineStage>(i)),
+          stage);
+    }
+    fl_value_set_string_take(result, "stages", stages);
+    return Success(result);
+  }
+
+  FlMethodResponse* SetPalette(FlValue* args) {
+    FlValue* name = Arg(args, "palette", FL_VALUE_TYPE_STRING);
+    uvc::ThermalPalette palette;
+    if (name == nullptr ||
+        !uvc::ParseThermalPalette(fl_value_get_string(name), &palette)) {
+      return Error("INVALID_PALETTE", "Unknown palette");
+    }
+    palette_.Select(palette);
+    return Success();
+  }
+
+  // setBrightness, setContrast and setGamma: one slider's {value}, applied
+  // from the next converted frame.
+  FlMethodResponse* SetTone(const char* method, FlValue* args) {
+    uvc::ToneSettings settings = tone_.settings();
+    const double value = DoubleArg(args, "value", -1);
+    if (strcmp(method, "setBrightness") == 0) {
+      settings.brightness = value;
+    } else if (strcmp(method, "setContrast") == 0) {
+      settings.contrast = value;
+    } else {
+      settings.gamma = value;
+    }
+    if (!settings.IsValid()) {
+      return Error("INVALID_ARGUMENT", "value out of range");
+    }
+    tone_.Set(settings);
+    return Success();
+  }
+
+  FlMethodResponse* SetAgc(FlValue* args) {
+    // Keys that are absent keep their current value.
+    uvc::AgcConfig config = agc_.config();
+    if (FlValue* mode = Lookup(args, "mode")) {
+      if (fl_value_get_type(mode) != FL_VALUE_TYPE_STRING ||
+          !uvc::ParseAgcMode(fl_value_get_string(mode), &config.mode)) {
+        return Error("INVALID_AGC_MODE", "Unknown AGC mode");
+      }
+    }
+    const std::pair<const char*, float*> values[] = {
+        {"smoothing", &config.smoothing},
+        {"plateau", &config.plateau},
+        {"clipLow", &config.clip_low},
+        {"clipHigh", &config.clip_high},
+    };
+    for (const auto& value : values) {
+      if (FlValue* number = Arg(args, value.first, FL_VALUE_TYPE_FLOAT)) {
+        *value.second = static_cast<float>(fl_value_get_float(number));
+      }
+    }
+    agc_.SetConfig(config);
+    return Success();
+  }
+
+  FlMethodResponse* SetDenoise(FlValue* args) {
+    // Keys that are absent keep their current value.
+    uvc::DenoiseConfig config = denoise_.config();
+    config.enabled = BoolArg(args, "enabled", config.enabled);
+    const std::pair<const char*, float*> values[] = {
+        {"minWeight", &config.min_weight},
+        {"noiseSigma", &config.noise_sigma},
+        {"motionLow", &config.motion_low},
+        {"motionHigh", &config.motion_high},
+    };
+    for (const auto& value : values) {
+      if (FlValue* number = Arg(args, value.first, FL_VALUE_TYPE_FLOAT)) {
+        *value.second = static_cast<float>(fl_value_get_float(number));
+      }
+    }
+    denoise_.SetConfig(config);
+    return Success();
+  }
+
+  FlMethodResponse* SetNuc(FlValue* args) {
+    // Keys that are absent keep their current value.
+    uvc::NucConfig config = nuc_.config();
+    config.enabled = BoolArg(args, "enabled", config.enabled);
+    config.shutterless = BoolArg(args, "shutterless", config.shutterless);
+    const std::pair<const char*, float*> values[] = {
+        {"shutterlessRate", &config.shutterless_rate},
+        {"shutterlessGate", &config.shutterless_gate},
+    };
+    for (const auto& value : values) {
+      if (FlValue* number = Arg(args, value.first, FL_VALUE_TYPE_FLOAT)) {
+        *value.second = static_cast<float>(fl_value_get_float(number));
+      }
+    }
+    nuc_.SetConfig(config);
+    return Success();
+  }
+
+  // Averages the next frames of the running raw preview as the cold or hot
+  // flat field and answers |method_call| once they are in. Returns the
+  // response now only if no capture was started.
+  FlMethodResponse* CaptureNucReference(FlMethodCall* method_call,
+                                        FlValue* args) {
+    FlValue* level = Arg(args, "level", FL_VALUE_TYPE_STRING);
+    uvc::NucReference reference;
+    if (level == nullptr ||
+        !uvc::ParseNucReference(fl_value_get_string(level), &reference)) {
+      return Error("INVALID_ARGUMENT", "level must be 'cold' or 'hot'");
+    }
+    const int64_t frames = IntArg(args, "frames", 32);
+    if (frames <= 0 ||
+        frames > static_cast<int64_t>(uvc::NucEngine::kMaxReferenceFrames)) {
+      return Error("INVALID_ARGUMENT", "frames out of range");
+    }
+    if (!source_ || raw_packing_ == uvc::RawPacking::kNone) {
+      return Error("NOT_RAW", "Calibration needs a raw preview");
+    }
+
+    g_object_ref(method_call);
+    const bool started = nuc_.CaptureReference(
+        reference, static_cast<size_t>(frames), mode_.width, mode_.height,
+        [method_call](const uvc::NucResult& result) {
+          PendingResponse* pending =
+              new PendingResponse{method_call, NucResponse(result)};
+          g_idle_add(SendPendingResponse, pending);
+        });
+    if (!started) {
+      g_object_unref(method_call);
+      return Error("BUSY", "A NUC capture or computation is running");
+    }
+    return nullptr;
+  }
+
+  // Turns the captured references into tables on the calibration thread,
+  // saves them to the optional path argument and switches to them without
+  // stopping the preview. Returns the response now only if nothing was
+  // started.
+  FlMethodResponse* ComputeNuc(FlMethodCall* method_call, FlValue* args) {
+    FlValue* path = Arg(args, "path", FL_VALUE_TYPE_STRING);
+    g_object_ref(method_call);
+    const bool started = nuc_.ComputeTables(
+        path != nullptr ? fl_value_get_string(path) : "",
+        [method_call](const uvc::NucResult& result) {
+          PendingResponse* pending =
+              new PendingResponse{method_call, NucResponse(result)};
+          g_idle_add(SendPendingResponse, pending);
+        });
+    if (!started) {
+      g_object_unref(method_call);
+      return Error("BUSY", "A NUC capture or computation is running");
+    }
+    return nullptr;
+  }
+
+  // Maps tables saved by computeNuc; nothing is recomputed.
+  FlMethodResponse* LoadNuc(FlValue* args) {
+    FlValue* path = Arg(args, "path", FL_VALUE_TYPE_STRING);
+    if (path == nullptr) {
+      return Error("INVALID_ARGUMENT", "A path is required");
+    }
+    std::string error;
+    if (!nuc_.LoadTables(fl_value_get_string(path), &error)) {
+      return Error("LOAD_FAILED", error.c_str());
+    }
+    return Success();
+  }
+
+  // Turns bad-pixel replacement on or off. A directory argument is where
+  // each device's map is kept: the open device's map is loaded from it now
+  // and on every startPreview, and scanBadPixels saves there.
+  FlMethodResponse* SetBadPixels(FlValue* args) {
+    bad_pixels_.SetEnabled(BoolArg(args, "enabled", bad_pixels_.enabled()));
+    if (FlValue* directory = Arg(args, "directory", FL_VALUE_TYPE_STRING)) {
+      bad_pixel_dir_ = fl_value_get_string(directory);
+      if (source_) LoadBadPixelMap();
+    }
+    return Success();
+  }
+
+  // Detects bad pixels over the next frames of the running raw preview and
+  // answers |method_call| once the map is built. Returns the response now
+  // only if no scan was started.
+  FlMethodResponse* ScanBadPixels(FlMethodCall* method_call, FlValue* args) {
+    const int64_t frames = IntArg(args, "frames", 32);
+    const double k_sigma = DoubleArg(args, "kSigma", 6.0);
+    if (frames <= 0 ||
+        frames > static_cast<int64_t>(uvc::BadPixelCorrector::kMaxScanFrames) ||
+        !(k_sigma > 0)) {
+      return Error("INVALID_ARGUMENT", "frames or kSigma out of range");
+    }
+    if (!source_ || raw_packing_ == uvc::RawPacking::kNone) {
+      return Error("NOT_RAW", "Scanning needs a raw preview");
+    }
+
+    g_object_ref(method_call);
+    const bool started = bad_pixels_.Scan(
+        static_cast<size_t>(frames), static_cast<float>(k_sigma), mode_.width,
+        mode_.height, BadPixelMapPath(),
+        [method_call](const uvc::BadPixelResult& result) {
+          PendingResponse* pending =
+              new PendingResponse{method_call, BadPixelResponse(result)};
+          g_idle_add(SendPendingResponse, pending);
+        });
+    if (!started) {
+      g_object_unref(method_call);
+      return Error("BUSY", "A bad-pixel scan is running");
+    }
+    return nullptr;
+  }
+
+  // Replaces the ROIs measured on each raw frame while Dart listens to the
+  // roi event channel.
+  FlMethodResponse* SetRois(FlValue* args) {
+    FlValue* list = Arg(args, "rois", FL_VALUE_TYPE_LIST);
+    std::vector<uvc::Roi> rois;
+    if (list == nullptr || !ParseRois(list, &rois)) {
+      return Error("INVALID_ARGUMENT", "Malformed ROI list");
+    }
+    if (!rois_.SetRois(std::move(rois))) {
+      return Error("INVALID_ARGUMENT", "Too many ROIs or points");
+    }
+    return Success();
+  }
+
+  // Configures the frame ring Dart reads through dart:ffi: its layout at
+  // the next startPreview, its decimation at once.
+  FlMethodResponse* SetFrameStream(FlValue* args) {
+    uvc::FrameRingConfig config = frame_ring_config_;
+    config.enabled = BoolArg(args, "enabled", config.enabled);
+    config.raw = BoolArg(args, "raw", config.raw);
+    const int64_t slots = IntArg(args, "slots", config.slots);
+    const int64_t every_nth = IntArg(args, "everyNth", config.every_nth);
+    const int64_t downscale = IntArg(args, "downscale", config.downscale);
+    config.max_fps = DoubleArg(args, "maxFps", config.max_fps);
+    if (slots <= 0 || slots > uvc::FrameRing::kMaxSlots || every_nth <= 0 ||
+        every_nth > UINT32_MAX ||
+        (downscale != 1 && downscale != 2 && downscale != 4) ||
+        !(config.max_fps >= 0)) {
+      return Error("INVALID_ARGUMENT",
+                   "slots, everyNth, maxFps or downscale out of range");
+    }
+    config.slots = static_cast<uint32_t>(slots);
+    config.every_nth = static_cast<uint32_t>(every_nth);
+    config.downscale = static_cast<uint32_t>(downscale);
+    frame_ring_config_ = config;
+    frame_ring_.SetDecimation(config.every_nth, config.max_fps);
+    return Success();
+  }
+
+  // The active frame ring's address and size, and the address of the
+  // function Dart reads it through, or null.
+  FlMethodResponse* GetFrameRing() {
+    if (frame_ring_.memory() == nullptr) return Success();
+    FlValue* value = fl_value_new_map();
+    fl_value_set_string_take(
+        value, "address",
+        fl_value_new_int(static_cast<int64_t>(
+            reinterpret_cast<uintptr_t>(frame_ring_.memory()))));
+    fl_value_set_string_take(
+        value, "bytes",
+        fl_value_new_int(static_cast<int64_t>(frame_ring_.size())));
+    fl_value_set_string_take(
+        value, "read",
+        fl_value_new_int(static_cast<int64_t>(
+            reinterpret_cast<uintptr_t>(&UvcFrameRingRead))));
+    return Success(value);
+  }
+
+  // Raster thread. Only it consumes preview_frames_, so no lock is needed;
+  // the previous front frame is released once the engine has uploaded it.
+  bool CopyPixels(const uint8_t** buffer, uint32_t* width, uint32_t* height) {
+    notifier_.Consume();
+    const bool fresh = preview_frames_.Update();
+    const uvc::FrameRef& frame = preview_frames_.ReadBuffer();
+    if (frame) stats_.OnPresented(fresh, frame.info(), uvc::SteadyNow100ns());
+    if (!frame) {
+      // Nothing captured yet: show a transparent pixel rather than an error.
+      static const uint8_t kEmpty[4] = {0, 0, 0, 0};
+      *buffer = kEmpty;
+      *width = 1;
+      *height = 1;
+      return true;
+    }
+    *buffer = frame.data();
+    *width = frame.format().width;
+    *height = frame.format().height;
+    return true;
+  }
+
+ private:
+  // Joins the capture thread before stopping the source and dropping the
+  // texture, so neither is touched after it is gone.
+  void StopPreview() {
+    if (!worker_.Stop(kStopTimeout)) {
+      // Interrupt() wakes a blocked dequeue, so this means a driver call is
+      // stuck. The source cannot be freed under it; keep waiting.
+      g_warning("Capture thread did not stop within %lld ms",
+                static_cast<long long>(kStopTimeout.count()));
+      worker_.Join();
+    }
+#if defined(UVC_HAVE_JPEG)
+    // Frames being decoded are still delivered to the texture.
+    mjpeg_.Stop();
+#endif
+    frame_ring_.Close();
+    // A burst waiting for frames after its trigger gets no more, nor does
+    // a NUC reference capture or a bad-pixel scan.
+    burst_.EndWindow();
+    nuc_.Reset();
+    bad_pixels_.Reset();
+    if (source_) {
+      source_->Stop();
+      source_.reset();
+    }
+    if (texture_ != nullptr) {
+      fl_texture_registrar_unregister_texture(texture_registrar_,
+                                              FL_TEXTURE(texture_));
+      g_clear_object(&texture_);
+      texture_id_ = -1;
+    }
+  }
+
+  // Where the open device's bad-pixel map is kept; empty without a
+  // directory from setBadPixels.
+  std::string BadPixelMapPath() const {
+    if (bad_pixel_dir_.empty() || device_key_.empty()) return std::string();
+    return bad_pixel_dir_ + "/" + uvc::BadPixelMapFileName(device_key_);
+  }
+
+  // Loads the open device's saved map, or clears the map if it has none.
+  void LoadBadPixelMap() {
+    bad_pixels_.SetMap(nullptr);
+    const std::string path = BadPixelMapPath();
+    std::string error;
+    if (!path.empty() && access(path.c_str(), F_OK) == 0 &&
+        !bad_pixels_.LoadMap(path, &error)) {
+      g_warning("Ignoring bad-pixel map: %s", error.c_str());
+    }
+  }
+
+  void CaptureLoop() {
+    while (!worker_.stop_requested()) {
+      uvc::SourceFrame source_frame;
+      const uvc::SourceStatus status = source_->Next(-1, &source_frame);
+      if (status == uvc::SourceStatus::kError) {
+        g_warning("Capture stopped: the frame source failed");
+        break;
+      }
+      if (status == uvc::SourceStatus::kEnd) break;
+      if (status != uvc::SourceStatus::kFrame) continue;
+      uvc::FrameInfo info;
+      info.sequence = source_frame.sequence;
+      info.timestamp = source_frame.timestamp;
+      stats_.OnFrameCaptured(info, uvc::SteadyNow100ns());
+      // Every captured frame, also those the preview skips.
+      burst_.Record(source_frame);
+
+#if defined(UVC_HAVE_JPEG)
+      // Compressed frames are copied out for the decode workers, which
+      // publish them in order. Nothing but the display uses them, so an
+      // unconsumed texture skips the decode too.
+      if (mode_.format == uvc::SourcePixelFormat::kMjpeg) {
+        if (SkipDisplay()) {
+          stats_.OnSkippedUnconsumed();
+        } else {
+          // The curve goes with the frame; the decoder maps the rows as
+          // it writes them.
+          const bool toned = tone_.Update();
+          mjpeg_.Submit(source_frame.data, source_frame.size, info,
+                        toned ? tone_.curve() : nullptr);
+        }
+        source_->Release(source_frame);
+        continue;
+      }
+#endif
+
+      // An empty handle means every slab is still referenced; the frame is
+      // dropped rather than waiting for one.
+      const auto convert_start = std::chrono::steady_clock::now();
+      uvc::FrameRef raw_frame;
+      if (raw_packing_ != uvc::RawPacking::kNone) {
+        raw_frame = raw_pool_.Acquire();
+        if (!raw_frame) {
+          stats_.OnPoolExhausted();
+          source_->Release(source_frame);
+          continue;
+        }
+        CorrectCounts(source_frame, raw_frame);
+        raw_frame.info() = info;
+        MeasureRois(raw_frame);
+        // A raw-mode ring takes the counts, whether or not they are shown.
+        frame_ring_.Write(raw_frame);
+      }
+
+      // The engine has yet to copy the last frame; converting this one for
+      // display would at best replace it unseen. The counts above are still
+      // corrected and measured: temporal denoise and the ROI stream need
+      // every frame.
+      if (SkipDisplay()) {
+        // Snapshots of the counts still move on with the ROI stream.
+        if (raw_frame) latest_.PublishCounts(std::move(raw_frame));
+        stats_.OnSkippedUnconsumed();
+        source_->Release(source_frame);
+        continue;
+      }
+
+      uvc::FrameRef frame = frame_pool_.Acquire();
+      if (frame) {
+        ConvertFrame(source_frame, raw_frame, frame);
+        stats_.Record(uvc::PipelineStage::kConvert, ElapsedNs(convert_start));
+        frame.info() = info;
+      } else {
+        stats_.OnPoolExhausted();
+      }
+      // The pixels are copied out; give the buffer back to the source first.
+      source_->Release(source_frame);
+
+      if (frame) PublishFrame(std::move(frame), std::move(raw_frame));
+    }
+  }
+
+  // Whether skipUnconsumed holds this frame back from display conversion:
+  // the engine has yet to copy the last frame, and no frame ring waits for
+  // the displayed frames.
+  bool SkipDisplay() const {
+    return skip_unconsumed_ && notifier_.Pending() &&
+           (frame_ring_.memory() == nullptr ||
+            frame_ring_.source().pixel_format == uvc::PixelFormat::kGray16);
+  }
+
+  // Hands a converted frame to the texture and to CapturePhoto. Called by
+  // the capture thread, or for MJPEG by one decode worker at a time.
+  void PublishFrame(uvc::FrameRef frame, uvc::FrameRef raw_frame) {
+    frame.info().published = uvc::SteadyNow100ns();
+    // Written unless the ring is in raw mode and took the counts already.
+    frame_ring_.Write(frame);
+    latest_.Publish(frame, std::move(raw_frame));
+    preview_frames_.WriteBuffer() = std::move(frame);
+    preview_frames_.Publish();
+    stats_.OnPublished();
+    if (notifier_.Publish()) {
+      fl_texture_registrar_mark_texture_frame_available(
+          texture_registrar_, FL_TEXTURE(texture_));
+      stats_.OnNotified();
+    }
+  }
+
+  // Capture thread: measures the ROIs on the corrected counts and has the
+  // main thread send them, at most one send outstanding as for the texture.
+  void MeasureRois(const uvc::FrameRef& raw_frame) {
+    if (!roi_listening_.load(std::memory_order_relaxed)) return;
+    uvc::RoiFrame& roi_frame = roi_frames_.WriteBuffer();
+    const uint32_t width = raw_frame.format().width;
+    if (!rois_.Measure(reinterpret_cast<const uint16_t*>(raw_frame.data()),
+                       width, width, raw_frame.format().height,
+                       &roi_frame.stats)) {
+      return;
+    }
+    roi_frame.sequence = raw_frame.info().sequence;
+    roi_frame.timestamp = raw_frame.info().timestamp;
+    roi_frames_.Publish();
+    if (roi_notifier_.Publish()) g_idle_add(SendRoiFrameCb, this);
+  }
+
+  // Main thread: sends the newest ROI frame as one binary kRoi telemetry
+  // record (see telemetry_record.h).
+  void SendRoiFrame() {
+    roi_notifier_.Consume();
+    if (!roi_frames_.Update() || !roi_listening_.load()) return;
+    uvc::TelemetryWriter writer(roi_record_.data(), roi_record_.size());
+    const size_t size = uvc::WriteRoiRecord(roi_frames_.ReadBuffer(), &writer);
+    if (size == 0) return;
+    g_autoptr(FlValue) event = fl_value_new_uint8_list(roi_record_.data(), size);
+    g_autoptr(GError) error = nullptr;
+    if (!fl_event_channel_send(roi_channel_, event, nullptr, &error)) {
+      g_warning("Failed to send ROI statistics: %s", error->message);
+    }
+  }
+
+  static gboolean SendRoiFrameCb(gpointer user_data) {
+    static_cast<V4l2Camera*>(user_data)->SendRoiFrame();
+    return G_SOURCE_REMOVE;
+  }
+
+  static FlMethodErrorResponse* RoiListenCb(FlEventChannel* channel,
+                                            FlValue* args,
+                                            gpointer user_data) {
+    static_cast<V4l2Camera*>(user_data)->roi_listening_.store(true);
+    return nullptr;
+  }
+
+  static FlMethodErrorResponse* RoiCancelCb(FlEventChannel* channel,
+                                            FlValue* args,
+                                            gpointer user_data) {
+    static_cast<V4l2Camera*>(user_data)->roi_listening_.store(false);
+    return nullptr;
+  }
+
+  // Unpacks the counts into |raw_frame| and corrects them in place, so
+  // snapshots of the raw counts are corrected and denoised too.
+  void CorrectCounts(const uvc::SourceFrame& source_frame,
+                     uvc::FrameRef& raw_frame) {
+    uint16_t* counts = reinterpret_cast<uint16_t*>(raw_frame.data());
+    const uint32_t width = raw_frame.format().width;
+    const uint32_t height = raw_frame.format().height;
+    uvc::UnpackRaw16(raw_packing_, source_frame.data, source_frame.stride,
+                     counts, width, height);
+    nuc_.Process(counts, width, width, height);
+    bad_pixels_.Process(counts, width, width, height);
+    denoise_.Process(counts, width, width, height);
+  }
+
+  // Renders the display frame: the corrected counts through AGC, or the
+  // colour source converted to RGBA.
+  void ConvertFrame(const uvc::SourceFrame& source_frame,
+                    const uvc::FrameRef& raw_frame, uvc::FrameRef& frame) {
+    const uint8_t* data = source_frame.data;
+    const ptrdiff_t src_stride = source_frame.stride;
+    const ptrdiff_t dst_stride =
+        static_cast<ptrdiff_t>(frame.format().Stride());
+    const uint32_t width = frame.format().width;
+    const uint32_t height = frame.format().height;
+    const bool toned = tone_.Update();
+    // The YUV kernels map through the curve as they store.
+    const uint8_t* curve = toned ? tone_.curve() : nullptr;
+    if (raw_frame) {
+      // The curve is folded into the palette, so it costs no extra pass.
+      agc_.Process(reinterpret_cast<const uint16_t*>(raw_frame.data()), width,
+                   width, height, tone_.Apply(palette_.table()), frame.data(),
+                   dst_stride);
+    } else if (mode_.format == uvc::SourcePixelFormat::kBgra32) {
+      if (toned) {
+        uvc::ConvertBgraToRgbaLut(data, src_stride, frame.data(), dst_stride,
+                                  width, height, tone_.swizzle_lut(), true);
+      } else {
+        uvc::ConvertBgrxToRgba(data, src_stride, frame.data(), dst_stride,
+                               width, height);
+      }
+    } else if (mode_.format == uvc::SourcePixelFormat::kUyvy) {
+      uvc::ConvertUyvyToRgba(data, src_stride, frame.data(), dst_stride, width,
+                             height, uvc::YuvColorSpace(), curve);
+    } else if (mode_.format == uvc::SourcePixelFormat::kNv12) {
+      uvc::ConvertNv12ToRgba(data, src_stride, data + src_stride * height,
+                             src_stride, frame.data(), dst_stride, width,
+                             height, uvc::YuvColorSpace(), curve);
+    } else {
+      uvc::ConvertYuyvToRgba(data, src_stride, frame.data(), dst_stride, width,
+                             height, uvc::YuvColorSpace(), curve);
+    }
+  }
+
+  FlTextureRegistrar* texture_registrar_;
+  CameraTexture* texture_ = nullptr;
+  int64_t texture_id_ = -1;
+
+  // A V4L2 camera or a virtual camera.
+  std::unique_ptr<uvc::FrameSource> source_;
+  uvc::SourceMode mode_;
+  uvc::RawPacking raw_packing_ = uvc::RawPacking::kNone;
+  uvc::CaptureWorker worker_;
+#if defined(UVC_HAVE_JPEG)
+  // Decodes kMjpeg sources into frame_pool_.
+  uvc::MjpegPipeline mjpeg_;
+#endif
+
+  uvc::FramePool frame_pool_;
+  uvc::TripleBuffer<uvc::FrameRef> preview_frames_;
+  // At most one texture-available notification is outstanding; frames
+  // published meanwhile are picked up by the copy it triggers.
+  uvc::FrameNotifier notifier_;
+  // Set by startPreview's skipUnconsumed: while the engine has not copied
+  // the last frame, new ones are not converted for display.
+  bool skip_unconsumed_ = false;
+  uvc::FramePool raw_pool_;
+  uvc::PaletteSelector palette_;
+  uvc::AutoGain agc_;
+  // Brightness, contrast and gamma, set on the main thread and taken up by
+  // ConvertFrame() on the capture thread.
+  uvc::ToneCurve tone_;
+  // Non-uniformity correction, first on the unpacked counts.
+  uvc::NucEngine nuc_;
+  // Dead and stuck pixels, replaced after NUC so their neighbours are
+  // corrected. Maps are kept per device in bad_pixel_dir_.
+  uvc::BadPixelCorrector bad_pixels_;
+  std::string bad_pixel_dir_;
+  std::string device_key_;
+  // Runs on the counts before AGC; configured by setDenoise.
+  uvc::TemporalDenoise denoise_;
+  // Measured on the corrected counts while Dart listens on roi_channel_;
+  // the newest frame's statistics wait in roi_frames_ for the main thread.
+  uvc::RoiEngine rois_;
+  FlEventChannel* roi_channel_ = nullptr;
+  std::atomic<bool> roi_listening_{false};
+  uvc::TripleBuffer<uvc::RoiFrame> roi_frames_;
+  uvc::FrameNotifier roi_notifier_;
+  std::array<uint8_t, uvc::RoiRecordBytes(uvc::RoiEngine::kMaxRois)>
+      roi_record_;
+  // Written by the capture and raster threads, read by GetPipelineStats.
+  uvc::PipelineStats stats_;
+  // The newest frame and counts for CapturePhoto and captureToFile.
+  uvc::LatestFrames latest_{&stats_};
+  // Recent frames (or counts) for Dart to read in place, written by
+  // whichever thread publishes; laid out by StartPreview() from
+  // frame_ring_config_.
+  uvc::FrameRingConfig frame_ring_config_;
+  uvc::FrameRing frame_ring_;
+  // The last frames from the source, for captureBurst.
+  uvc::BurstRecorder burst_;
+  // Encodes and writes captureToFile snapshots off the platform thread.
+  uvc::SnapshotWriter snapshots_;
+};
+
+static gboolean camera_texture_copy_pixels(FlPixelBufferTexture* texture,
+                                           const uint8_t** out_buffer,
+                                           uint32_t* width, uint32_t* height,
+                                           GError** error) {
+  return CAMERA_TEXTURE(texture)->camera->CopyPixels(out_buffer, width,
+                                                     height);
+}
+
+struct _CameraPlugin {
+  GObject parent_instance;
+  V4l2Camera* camera;
+};
+
+G_DEFINE_TYPE(CameraPlugin, camera_plugin, g_object_get_type())
+
+static void camera_plugin_handle_method_call(CameraPlugin* self,
+                                             FlMethodCall* method_call) {
+  const gchar* method = fl_method_call_get_name(method_call);
+  FlValue* args = fl_method_call_get_args(method_call);
+  V4l2Camera* camera = self->camera;
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (strcmp(method, "enumerateDevices") == 0) {
+    response = camera->EnumerateDevices();
+  } else if (strcmp(method, "startPreview") == 0) {
+    response = camera->StartPreview(args);
+  } else if (strcmp(method, "closeDevice") == 0) {
+    response = camera->CloseDevice();
+  } else if (strcmp(method, "getDeviceStatus") == 0) {
+    response = camera->GetDeviceStatus(args);
+  } else if (strcmp(method, "getSupportedResolutions") == 0) {
+    response = camera->GetSupportedResolutions(args);
+  } else if (strcmp(method, "capturePhoto") == 0) {
+    response = camera->CapturePhoto();
+  } else if (strcmp(method, "captureToFile") == 0) {
+    response = camera->CaptureToFile(method_call, args);
+    // Answered by the snapshot worker.
+    if (response == nullptr) return;
+  } else if (strcmp(method, "captureBurst") == 0) {
+    response = camera->CaptureBurst(method_call, args);
+    // Answered by the burst writer.
+    if (response == nullptr) return;
+  } else if (strcmp(method, "setPalette") == 0) {
+    response = camera->SetPalette(args);
+  } else if (strcmp(method, "setAgc") == 0) {
+    response = camera->SetAgc(args);
+  } else if (strcmp(method, "setDenoise") == 0) {
+    response = camera->SetDenoise(args);
+  } else if (strcmp(method, "setNuc") == 0) {
+    response = camera->SetNuc(args);
+  } else if (strcmp(method, "captureNucReference") == 0) {
+    response = camera->CaptureNucReference(method_call, args);
+    // Answered by the NUC calibration thread.
+    if (response == nullptr) return;
+  } else if (strcmp(method, "computeNuc") == 0) {
+    response = camera->ComputeNuc(method_call, args);
+    if (response == nullptr) return;
+  } else if (strcmp(method, "loadNuc") == 0) {
+    response = camera->LoadNuc(args);
+  } else if (strcmp(method, "setBadPixels") == 0) {
+    response = camera->SetBadPixels(args);
+  } else if (strcmp(method, "scanBadPixels") == 0) {
+    response = camera->ScanBadPixels(method_call, args);
+    // Answered by the detection thread.
+    if (response == nullptr) return;
+  } else if (strcmp(method, "setRois") == 0) {
+    response = camera->SetRois(args);
+  } else if (strcmp(method, "setFrameStream") == 0) {
+    response = camera->SetFrameStream(args);
+  } else if (strcmp(method, "getFrameRing") == 0) {
+    response = camera->GetFrameRing();
+  } else if (strcmp(method, "getPipelineStats") == 0) {
+    response = camera->GetPipelineStats(args);
+  } else if (strcmp(method, "setBrightness") == 0 ||
+             strcmp(method, "setContrast") == 0 ||
+             strcmp(method, "setGamma") == 0) {
+    response = camera->SetTone(method, args);
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send response: %s", error->message);
+  }
+}
+
+static void method_call_cb(FlMethodChannel* channel, FlMethodCall* method_call,
+                           gpointer user_data) {
+  camera_plugin_handle_method_call(CAMERA_PLUGIN(user_data), method_call);
+}
+
+static void camera_plugin_dispose(GObject* object) {
+  CameraPlugin* self = CAMERA_PLUGIN(object);
+  delete self->camera;
+  self->camera = nullptr;
+  G_OBJECT_CLASS(camera_plugin_parent_class)->dispose(object);
+}
+
+static void camera_plugin_class_init(CameraPluginClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = camera_plugin_dispose;
+}
+
+static void camera_plugin_init(CameraPlugin* self) {}
+
+void camera_plugin_register_with_registrar(FlPluginRegistrar* registrar) {
+  CameraPlugin* plugin =
+      CAMERA_PLUGIN(g_object_new(camera_plugin_get_type(), nullptr));
+  plugin->camera =
+      new V4l2Camera(fl_plugin_registrar_get_texture_registrar(registrar),
+                     fl_plugin_registrar_get_messenger(registrar));
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  g_autoptr(FlMethodChannel) channel =
+      fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                            "com.example.uvc_viewer/camera",
+                            FL_METHOD_CODEC(codec));
+  // The handler holds the plugin reference from here on.
+  fl_method_channel_set_method_call_handler(channel, method_call_cb,
+                                            g_object_ref(plugin),
+                                            g_object_unref);
+  g_object_unref(plugin);
+}
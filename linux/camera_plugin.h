@@ -0,0 +1,19 @@
+#ifndef FLUTTER_CAMERA_PLUGIN_H_
+#define FLUTTER_CAMERA_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_DECLARE_FINAL_TYPE(CameraPlugin, camera_plugin, CAMERA, PLUGIN, GObject)
+
+/**
+ * camera_plugin_register_with_registrar:
+ * @registrar: an #FlPluginRegistrar.
+ *
+ * Serves the com.example.uvc_viewer/camera method channel from Video4Linux2
+ * capture devices, with the same methods and results as the Windows runner.
+ * Frames are streamed with V4L2 MMAP or DMABUF buffers and shown through an
+ * #FlPixelBufferTexture.
+ */
+void camera_plugin_register_with_registrar(FlPluginRegistrar* registrar);
+
+#endif  // FLUTTER_CAMERA_PLUGIN_H_
@@ -0,0 +1,42 @@
+// Cost of the AGC stage (render + histogram + mapping update) per mode. The
+// budget is 1 ms per frame at 640x512, the largest common uncooled core.
+#include <random>
+#include <vector>
+
+#include "agc.h"
+#include "bench_harness.h"
+#include "thermal_palette.h"
+
+int main(int argc, char **argv) {
+  using namespace uvc;
+  if (!bench::Init(argc, argv)) return 2;
+  const bench::Resolution resolutions[] = {{256, 192}, {384, 288}, {640, 512}};
+  const AgcMode modes[] = {AgcMode::kLinear, AgcMode::kPercentile,
+                           AgcMode::kPlateau};
+  const uint32_t *palette = GetPaletteTable(ThermalPalette::kIronbow);
+
+  bench::PrintHeader();
+  for (const auto &res : resolutions) {
+    std::mt19937 rng(1);
+    std::vector<uint16_t> src(res.width * res.height);
+    for (auto &v : src) v = static_cast<uint16_t>(6000 + rng() % 4000);
+    std::vector<uint8_t> dst(res.width * res.height * 4);
+
+    for (AgcMode mode : modes) {
+      AutoGain agc;
+      AgcConfig config;
+      config.mode = mode;
+      agc.SetConfig(config);
+      const bench::Result r = bench::Measure(
+          std::string("agc/") + AgcModeName(mode), res, [&] {
+            agc.Process(src.data(), res.width, res.width, res.height, palette,
+                        dst.data(), res.width * 4);
+          }).WithBytes(6.0 * res.width * res.height);
+      bench::Print(r);
+      if (res.width == 640 && res.height == 512 && r.ns_per_frame > 1e6) {
+        bench::Note("  over the 1 ms budget");
+      }
+    }
+  }
+  return 0;
+}
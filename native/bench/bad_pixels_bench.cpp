@@ -0,0 +1,68 @@
+// Cost of bad-pixel replacement for each kernel and share of bad pixels,
+// to show it follows the number of bad pixels rather than the frame size,
+// and of one detection pass over a 32-frame scan.
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bad_pixels.h"
+#include "bench_harness.h"
+#include "cpu_features.h"
+
+int main(int argc, char **argv) {
+  using namespace uvc;
+  if (!bench::Init(argc, argv)) return 2;
+  const bench::Resolution resolutions[] = {
+      {384, 288}, {640, 512}, {1280, 1024}};
+  std::vector<SimdLevel> levels = {SimdLevel::kScalar};
+  const SimdLevel detected = DetectSimdLevel();
+  if (detected == SimdLevel::kNeon) {
+    levels.push_back(SimdLevel::kNeon);
+  } else {
+    for (int l = 1; l <= static_cast<int>(detected); l++) {
+      levels.push_back(static_cast<SimdLevel>(l));
+    }
+  }
+
+  bench::PrintHeader();
+  for (const auto &res : resolutions) {
+    const size_t pixels = static_cast<size_t>(res.width) * res.height;
+    std::mt19937 rng(1);
+    std::normal_distribution<float> noise(0.0f, 4.0f);
+    std::vector<uint16_t> scene(pixels);
+    for (size_t i = 0; i < pixels; i++) {
+      scene[i] = static_cast<uint16_t>(6000 + (i % res.width) * 2 +
+                                       noise(rng));
+    }
+    std::vector<uint16_t> frame = scene;
+
+    // Uncooled cores are specified at up to 0.1%; 1% is a worn one.
+    for (double share : {0.001, 0.01}) {
+      std::uniform_int_distribution<uint32_t> pixel(
+          0, static_cast<uint32_t>(pixels - 1));
+      std::vector<uint32_t> indices(static_cast<size_t>(pixels * share));
+      for (uint32_t &index : indices) index = pixel(rng);
+      const BadPixelMap map(res.width, res.height, std::move(indices));
+      for (SimdLevel level : levels) {
+        SetMaxSimdLevel(level);
+        const bench::Result r = bench::Measure(
+            std::string("replace/") + SimdLevelName(level) + "/" +
+                std::to_string(map.size()) + "px",
+            res, [&] { map.Apply(frame.data(), res.width); });
+        bench::Print(r);
+      }
+      SetMaxSimdLevel(SimdLevel::kNeon);
+    }
+
+    BadPixelDetector detector(res.width, res.height);
+    const bench::Result add =
+        bench::Measure("scan/add", res,
+                       [&] { detector.Add(scene.data(), res.width); })
+            .WithBytes(2.0 * pixels);
+    bench::Print(add);
+    const bench::Result detect = bench::Measure(
+        "scan/detect", res, [&] { detector.Detect(6.0f); });
+    bench::Print(detect);
+  }
+  return 0;
+}
@@ -0,0 +1,260 @@
+#ifndef UVC_BENCH_HARNESS_H_
+#define UVC_BENCH_HARNESS_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "cpu_features.h"
+
+#if defined(UVC_ARCH_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace uvc {
+namespace bench {
+
+struct Resolution {
+  size_t width;
+  size_t height;
+};
+
+// The sensor and display sizes the app is used with, from the smallest
+// thermal cores to 1080p webcams.
+constexpr Resolution kStandardResolutions[] = {
+    {160, 120}, {256, 192}, {384, 288}, {640, 512}, {1280, 720}, {1920, 1080},
+};
+
+struct Result {
+  std::string name;
+  Resolution resolution;
+  double ns_per_frame;
+  // Time-stamp counter ticks per frame; 0 where there is no counter.
+  double cycles_per_frame = 0;
+  // Bytes read plus bytes written per frame; 0 if not meaningful.
+  double bytes_per_frame = 0;
+  // Filtered out by --filter; not measured and not printed.
+  bool skipped = false;
+
+  double MegapixelsPerSecond() const {
+    return static_cast<double>(resolution.width * resolution.height) * 1e3 /
+           ns_per_frame;
+  }
+  double BytesPerCycle() const {
+    return cycles_per_frame > 0 ? bytes_per_frame / cycles_per_frame : 0;
+  }
+  Result WithBytes(double bytes) const {
+    Result r = *this;
+    r.bytes_per_frame = bytes;
+    return r;
+  }
+};
+
+enum class Format { kTable, kCsv, kJsonLines };
+
+struct Options {
+  std::string program;
+  Format format = Format::kTable;
+  std::string filter;
+  std::FILE *out = stdout;
+  // Cycles per nanosecond for hosts without a readable cycle counter, from
+  // UVC_BENCH_CPU_GHZ.
+  double ghz = 0;
+};
+
+inline Options &GetOptions() {
+  static Options options;
+  return options;
+}
+
+// Parses the options every benchmark accepts:
+//   --format=table|csv|jsonl  table for people, csv / JSON lines for scripts
+//   --filter=TEXT             only benchmarks whose name contains TEXT
+//   --output=FILE             write results to FILE instead of stdout
+// Returns false after printing usage on anything else.
+inline bool Init(int argc, char **argv) {
+  Options &options = GetOptions();
+  options.program = argv[0];
+  options.program.erase(0, options.program.find_last_of("/\\") + 1);
+  if (const char *ghz = std::getenv("UVC_BENCH_CPU_GHZ")) {
+    options.ghz = std::atof(ghz);
+  }
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--format=table") {
+      options.format = Format::kTable;
+    } else if (arg == "--format=csv") {
+      options.format = Format::kCsv;
+    } else if (arg == "--format=jsonl") {
+      options.format = Format::kJsonLines;
+    } else if (arg.compare(0, 9, "--filter=") == 0) {
+      options.filter = arg.substr(9);
+    } else if (arg.compare(0, 9, "--output=") == 0) {
+      options.out = std::fopen(arg.c_str() + 9, "w");
+      if (options.out == nullptr) {
+        std::fprintf(stderr, "cannot write %s\n", arg.c_str() + 9);
+        return false;
+      }
+    } else {
+      std::fprintf(stderr,
+                   "usage: %s [--format=table|csv|jsonl] [--filter=TEXT] "
+                   "[--output=FILE]\n",
+                   options.program.c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+// Reference cycles: the TSC on x86, which ticks at a fixed rate close to the
+// nominal clock rather than the current core clock.
+inline uint64_t ReadCycleCounter() {
+#if defined(UVC_ARCH_X86)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+// Keeps the compiler from discarding work whose result is otherwise unused,
+// e.g. an allocation that is freed again right away.
+inline void DoNotOptimize(const void *pointer) {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "g"(pointer) : "memory");
+#else
+  static const void *volatile sink;
+  sink = pointer;
+#endif
+}
+
+// Repeats |fn| until at least |min_seconds| have elapsed (after a short
+// warm-up) and reports the best average of several batches, which is the
+// least disturbed by other processes.
+template <typename Fn>
+Result Measure(const std::string &name, Resolution resolution, Fn &&fn,
+               double min_seconds = 0.25) {
+  const Options &options = GetOptions();
+  if (!options.filter.empty() &&
+      name.find(options.filter) == std::string::npos) {
+    Result skipped{name, resolution, 0};
+    skipped.skipped = true;
+    return skipped;
+  }
+
+  using Clock = std::chrono::steady_clock;
+  for (int i = 0; i < 3; i++) fn();
+
+  size_t batch = 1;
+  for (;;) {
+    const auto start = Clock::now();
+    for (size_t i = 0; i < batch; i++) fn();
+    const std::chrono::duration<double> elapsed = Clock::now() - start;
+    if (elapsed.count() > 0.01 || batch >= (1u << 20)) break;
+    batch *= 2;
+  }
+
+  double best_ns = 1e300;
+  double best_cycles = 0;
+  double total = 0;
+  while (total < min_seconds) {
+    const uint64_t start_cycles = ReadCycleCounter();
+    const auto start = Clock::now();
+    for (size_t i = 0; i < batch; i++) fn();
+    const std::chrono::duration<double> elapsed = Clock::now() - start;
+    const uint64_t cycles = ReadCycleCounter() - start_cycles;
+    total += elapsed.count();
+    const double ns = elapsed.count() * 1e9 / batch;
+    if (ns < best_ns) {
+      best_ns = ns;
+      best_cycles = static_cast<double>(cycles) / batch;
+    }
+  }
+  if (best_cycles == 0) best_cycles = best_ns * options.ghz;
+  Result result{name, resolution, best_ns};
+  result.cycles_per_frame = best_cycles;
+  return result;
+}
+
+inline void PrintHeader() {
+  const Options &options = GetOptions();
+  switch (options.format) {
+    case Format::kTable:
+      std::fprintf(options.out, "%-32s %11s %14s %10s %11s\n", "benchmark",
+                   "resolution", "ns/frame", "MPix/s", "bytes/cyc");
+      break;
+    case Format::kCsv:
+      std::fprintf(options.out,
+                   "program,benchmark,width,height,ns_per_frame,mpix_per_s,"
+                   "bytes_per_frame,cycles_per_frame,bytes_per_cycle,simd\n");
+      break;
+    case Format::kJsonLines:
+      break;
+  }
+}
+
+inline void Print(const Result &r) {
+  if (r.skipped) return;
+  const Options &options = GetOptions();
+  const char *simd = SimdLevelName(GetSimdLevel());
+  switch (options.format) {
+    case Format::kTable: {
+      char res[32];
+      std::snprintf(res, sizeof(res), "%zux%zu", r.resolution.width,
+                    r.resolution.height);
+      char bpc[32] = "-";
+      if (r.BytesPerCycle() > 0) {
+        std::snprintf(bpc, sizeof(bpc), "%.2f", r.BytesPerCycle());
+      }
+      std::fprintf(options.out, "%-32s %11s %14.0f %10.1f %11s\n",
+                   r.name.c_str(), res, r.ns_per_frame,
+                   r.MegapixelsPerSecond(), bpc);
+      break;
+    }
+    case Format::kCsv:
+      std::fprintf(options.out, "%s,%s,%zu,%zu,%.1f,%.2f,%.0f,%.0f,%.4f,%s\n",
+                   options.program.c_str(), r.name.c_str(),
+                   r.resolution.width, r.resolution.height, r.ns_per_frame,
+                   r.MegapixelsPerSecond(), r.bytes_per_frame,
+                   r.cycles_per_frame, r.BytesPerCycle(), simd);
+      break;
+    case Format::kJsonLines:
+      std::fprintf(options.out,
+                   "{\"program\":\"%s\",\"benchmark\":\"%s\",\"width\":%zu,"
+                   "\"height\":%zu,\"ns_per_frame\":%.1f,\"mpix_per_s\":%.2f,"
+                   "\"bytes_per_frame\":%.0f,\"cycles_per_frame\":%.0f,"
+                   "\"bytes_per_cycle\":%.4f,\"simd\":\"%s\"}\n",
+                   options.program.c_str(), r.name.c_str(),
+                   r.resolution.width, r.resolution.height, r.ns_per_frame,
+                   r.MegapixelsPerSecond(), r.bytes_per_frame,
+                   r.cycles_per_frame, r.BytesPerCycle(), simd);
+      break;
+  }
+  std::fflush(options.out);
+}
+
+// Commentary for people reading the table. Goes to stderr in the machine
+// formats so their output stays parseable.
+inline void Note(const char *format, ...) {
+  const Options &options = GetOptions();
+  std::FILE *out = options.format == Format::kTable ? options.out : stderr;
+  va_list args;
+  va_start(args, format);
+  std::vfprintf(out, format, args);
+  va_end(args);
+  std::fputc('\n', out);
+}
+
+}  // namespace bench
+}  // namespace uvc
+
+#endif  // UVC_BENCH_HARNESS_H_
@@ -0,0 +1,71 @@
+// Cost of the temporal denoise stage on 14-bit frames for each kernel and
+// stripe thread count. The budget is 1 ms per frame at 640x512, the largest
+// common uncooled core.
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_harness.h"
+#include "cpu_features.h"
+#include "temporal_denoise.h"
+
+int main(int argc, char **argv) {
+  using namespace uvc;
+  if (!bench::Init(argc, argv)) return 2;
+  const bench::Resolution resolutions[] = {
+      {384, 288}, {640, 512}, {1280, 1024}};
+  std::vector<SimdLevel> levels = {SimdLevel::kScalar};
+  const SimdLevel detected = DetectSimdLevel();
+  if (detected == SimdLevel::kNeon) {
+    levels.push_back(SimdLevel::kNeon);
+  } else {
+    for (int l = 1; l <= static_cast<int>(detected); l++) {
+      levels.push_back(static_cast<SimdLevel>(l));
+    }
+  }
+  bench::Note("stripe threads by default: %zu", DefaultStripeThreads());
+
+  bench::PrintHeader();
+  for (const auto &res : resolutions) {
+    const size_t pixels = static_cast<size_t>(res.width) * res.height;
+    // A fixed scene with sigma 16 noise, so part of the frame sits on the
+    // motion ramp as in a real sequence.
+    std::mt19937 rng(1);
+    std::normal_distribution<float> noise(0.0f, 16.0f);
+    std::vector<uint16_t> scene(pixels);
+    for (size_t i = 0; i < pixels; i++) {
+      scene[i] = static_cast<uint16_t>(6000 + (i % res.width) * 2 +
+                                       std::lround(noise(rng)));
+    }
+    std::vector<uint16_t> frame(pixels);
+    DenoiseConfig config;
+    config.enabled = true;
+
+    for (SimdLevel level : levels) {
+      SetMaxSimdLevel(level);
+      for (size_t threads : {1, 2, 4}) {
+        TemporalDenoise denoise(threads);
+        denoise.SetConfig(config);
+        frame = scene;
+        denoise.Process(frame.data(), res.width, res.width, res.height);
+        const bench::Result r =
+            bench::Measure(std::string("denoise/") + SimdLevelName(level) +
+                               "/" + std::to_string(threads) + "t",
+                           res, [&] {
+                             frame = scene;
+                             denoise.Process(frame.data(), res.width,
+                                             res.width, res.height);
+                           })
+                // Frame copy in, counts and accumulator read and written.
+                .WithBytes(14.0 * pixels);
+        bench::Print(r);
+        if (res.width == 640 && res.height == 512 && r.ns_per_frame > 1e6) {
+          bench::Note("  over the 1 ms budget");
+        }
+      }
+    }
+    SetMaxSimdLevel(SimdLevel::kNeon);
+  }
+  return 0;
+}
@@ -0,0 +1,135 @@
+// Every per-frame stage of the capture path at the resolutions the app is
+// used with, through the same dispatching entry points the runners call:
+//
+//   swizzle/*        the BGRA->RGBA conversion in ReadSampleLoop
+//   stride/*         the same with a padded pitch and a bottom-up buffer, as
+//                    IMF2DBuffer::Lock2D can return them
+//   alloc/*          a fresh std::vector per frame, as the loop used to do,
+//                    against a FramePool acquire / release
+//   capture_photo    the copy CapturePhoto makes for the method codec
+//   yuyv, unpack/*, palette/*, agc/*   the webcam and raw thermal stages
+//
+// bytes/cycle counts the bytes each stage reads plus writes. Use
+// --format=csv or --format=jsonl to keep results for comparing releases.
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "agc.h"
+#include "bench_harness.h"
+#include "frame_pool.h"
+#include "pixel_convert.h"
+#include "raw_convert.h"
+#include "thermal_palette.h"
+#include "yuv_convert.h"
+
+namespace {
+
+using namespace uvc;
+
+void RunColourStages(bench::Resolution res) {
+  const size_t width = res.width;
+  const size_t height = res.height;
+  const size_t pixels = width * height;
+  const double bytes = 8.0 * pixels;  // 4 read + 4 written per pixel.
+  const ptrdiff_t stride = static_cast<ptrdiff_t>(width * 4);
+
+  // Media Foundation pads some pitches; 64 bytes is a typical alignment.
+  const ptrdiff_t padded = stride + 64;
+  std::vector<uint8_t> src(static_cast<size_t>(padded) * height);
+  for (size_t i = 0; i < src.size(); i++) src[i] = static_cast<uint8_t>(i * 131);
+  std::vector<uint8_t> dst(pixels * 4);
+
+  bench::Print(bench::Measure("swizzle/bgra_to_rgba", res, [&] {
+                 ConvertBgraToRgba(src.data(), stride, dst.data(), stride,
+                                   width, height);
+               }).WithBytes(bytes));
+  bench::Print(bench::Measure("swizzle/bgrx_to_rgba", res, [&] {
+                 ConvertBgrxToRgba(src.data(), stride, dst.data(), stride,
+                                   width, height);
+               }).WithBytes(bytes));
+  bench::Print(bench::Measure("stride/padded_pitch", res, [&] {
+                 ConvertBgraToRgba(src.data(), padded, dst.data(), stride,
+                                   width, height);
+               }).WithBytes(bytes));
+  // Scanline 0 is the last row in memory and the pitch is negative.
+  const uint8_t *bottom_up = src.data() + (height - 1) * stride;
+  bench::Print(bench::Measure("stride/bottom_up", res, [&] {
+                 ConvertBgraToRgba(bottom_up, -stride, dst.data(), stride,
+                                   width, height);
+               }).WithBytes(bytes));
+
+  const size_t frame_bytes = pixels * 4;
+  bench::Print(bench::Measure("alloc/vector_per_frame", res, [&] {
+                 std::vector<uint8_t> frame(frame_bytes);
+                 bench::DoNotOptimize(frame.data());
+               }).WithBytes(static_cast<double>(frame_bytes)));
+  FramePool pool;
+  FrameFormat format;
+  format.width = static_cast<uint32_t>(width);
+  format.height = static_cast<uint32_t>(height);
+  pool.Configure(format, 5, 8);
+  bench::Print(bench::Measure("alloc/frame_pool", res, [&] {
+    FrameRef frame = pool.Acquire();
+    bench::DoNotOptimize(frame.data());
+  }));
+
+  FrameRef latest = pool.Acquire();
+  std::memcpy(latest.data(), src.data(), latest.size());
+  bench::Print(bench::Measure("capture_photo", res, [&] {
+                 std::vector<uint8_t> photo(latest.data(),
+                                            latest.data() + latest.size());
+                 bench::DoNotOptimize(photo.data());
+               }).WithBytes(2.0 * frame_bytes));
+
+  bench::Print(bench::Measure("yuyv_to_rgba", res, [&] {
+                 ConvertYuyvToRgba(src.data(), stride / 2, dst.data(), stride,
+                                   width, height);
+               }).WithBytes(6.0 * pixels));
+}
+
+void RunRawStages(bench::Resolution res) {
+  const size_t width = res.width;
+  const size_t height = res.height;
+  const size_t pixels = width * height;
+
+  // Counts spread over a 14-bit scene, like an uncooled core.
+  std::mt19937 rng(1);
+  std::vector<uint16_t> counts(pixels);
+  for (auto &v : counts) v = static_cast<uint16_t>(6000 + rng() % 4000);
+  std::vector<uint16_t> unpacked(pixels);
+  std::vector<uint8_t> dst(pixels * 4);
+  const uint8_t *raw = reinterpret_cast<const uint8_t *>(counts.data());
+
+  bench::Print(bench::Measure("unpack/y14", res, [&] {
+                 UnpackRaw16(RawPacking::kY14, raw,
+                             static_cast<ptrdiff_t>(width * 2),
+                             unpacked.data(), width, height);
+               }).WithBytes(4.0 * pixels));
+
+  const uint32_t *ironbow = GetPaletteTable(ThermalPalette::kIronbow);
+  bench::Print(bench::Measure("palette/ironbow", res, [&] {
+                 ColorizeGray16(counts.data(), width, ironbow, dst.data(),
+                                width * 4, width, height, 6000, 10000);
+               }).WithBytes(6.0 * pixels));
+
+  AutoGain agc;
+  bench::Print(bench::Measure("agc/plateau", res, [&] {
+                 agc.Process(counts.data(), width, width, height, ironbow,
+                             dst.data(), width * 4);
+               }).WithBytes(6.0 * pixels));
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (!bench::Init(argc, argv)) return 2;
+  bench::Note("detected SIMD level: %s", SimdLevelName(DetectSimdLevel()));
+  bench::PrintHeader();
+  for (const auto &res : bench::kStandardResolutions) {
+    RunColourStages(res);
+    RunRawStages(res);
+  }
+  return 0;
+}
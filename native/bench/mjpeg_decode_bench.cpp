@@ -0,0 +1,218 @@
+// MJPEG decode throughput: one JpegDecoder at full and reduced scale, then
+// MjpegPipeline with 1, 2 and 4 workers, per frame size of the corpus.
+//
+// The corpus is UVC_MJPEG_CORPUS when set: a directory of .jpg files or a
+// Motion JPEG stream, e.g. a V4L2 capture saved with
+//   ffmpeg -f v4l2 -input_format mjpeg -video_size 1920x1080 \
+//       -i /dev/video0 -c copy -frames 120 corpus.mjpeg
+// Otherwise it is encoded here from a noisy colour test pattern at 720p,
+// 1080p and 4K, which compresses roughly like a camera image.
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench_harness.h"
+#include "jpeg_codec.h"
+#include "mjpeg_pipeline.h"
+
+namespace {
+
+using namespace uvc;
+
+using Frames = std::vector<std::vector<uint8_t>>;
+
+std::vector<uint8_t> ReadFile(const std::filesystem::path &path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file),
+                              std::istreambuf_iterator<char>());
+}
+
+// Frames of |path| (a directory or an MJPEG stream), in name order.
+Frames LoadCorpus(const std::string &path) {
+  Frames frames;
+  std::vector<std::filesystem::path> files;
+  if (std::filesystem::is_directory(path)) {
+    for (const auto &entry : std::filesystem::directory_iterator(path)) {
+      std::string extension = entry.path().extension().string();
+      std::transform(extension.begin(), extension.end(), extension.begin(),
+                     [](unsigned char c) { return std::tolower(c); });
+      if (extension == ".jpg" || extension == ".jpeg") {
+        files.push_back(entry.path());
+      }
+    }
+    std::sort(files.begin(), files.end());
+  } else {
+    files.push_back(path);
+  }
+  for (const auto &file : files) {
+    const std::vector<uint8_t> data = ReadFile(file);
+    for (const auto &frame : SplitMjpegStream(data.data(), data.size())) {
+      frames.emplace_back(data.begin() + frame.first,
+                          data.begin() + frame.first + frame.second);
+    }
+  }
+  return frames;
+}
+
+Frames EncodeCorpus(uint32_t width, uint32_t height, int count) {
+  std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4);
+  std::mt19937 rng(1);
+  Frames frames;
+  for (int n = 0; n < count; n++) {
+    for (uint32_t y = 0; y < height; y++) {
+      for (uint32_t x = 0; x < width; x++) {
+        uint8_t *p = &rgba[(static_cast<size_t>(y) * width + x) * 4];
+        const int noise = static_cast<int>(rng() % 6);
+        const uint32_t u = x + n * 16;
+        p[0] = static_cast<uint8_t>((u * 255 / width + noise) & 0xFF);
+        p[1] = static_cast<uint8_t>((y * 255 / height + noise) & 0xFF);
+        p[2] = static_cast<uint8_t>(((u ^ y) & 0x40) ? 200 : 40 + noise);
+        p[3] = 255;
+      }
+    }
+    std::vector<uint8_t> jpeg;
+    EncodeJpeg(rgba.data(), static_cast<ptrdiff_t>(width) * 4, width, height,
+               85, &jpeg);
+    frames.push_back(std::move(jpeg));
+  }
+  return frames;
+}
+
+void Run(bench::Resolution res, const Frames &frames) {
+  const uint32_t width = static_cast<uint32_t>(res.width);
+  const uint32_t height = static_cast<uint32_t>(res.height);
+  size_t total_bytes = 0;
+  for (const auto &frame : frames) total_bytes += frame.size();
+  const double mean_bytes = static_cast<double>(total_bytes) / frames.size();
+  bench::Note("%ux%u: %zu frames, %.0f KiB/frame", width, height,
+              frames.size(), mean_bytes / 1024);
+
+  JpegDecoder decoder;
+  std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4);
+  struct Variant {
+    const char *name;
+    uint32_t divisor;
+    bool fast;
+  };
+  const Variant variants[] = {
+      {"decode/full_accurate", 1, false},
+      {"decode/full", 1, true},
+      {"decode/half", 2, true},
+      {"decode/quarter", 4, true},
+  };
+  for (const Variant &variant : variants) {
+    JpegDecodeOptions options;
+    options.fast = variant.fast;
+    if (variant.divisor > 1) {
+      options.target_width = width / variant.divisor;
+      options.target_height = height / variant.divisor;
+    }
+    uint32_t out_width, out_height;
+    MjpegOutputSize(width, height, options, &out_width, &out_height);
+    size_t i = 0;
+    bool ok = true;
+    const auto result = bench::Measure(variant.name, res, [&] {
+      const auto &frame = frames[i++ % frames.size()];
+      ok &= decoder.Decode(frame.data(), frame.size(), options, rgba.data(),
+                           static_cast<ptrdiff_t>(out_width) * 4, out_width,
+                           out_height);
+    });
+    bench::Print(result.WithBytes(mean_bytes + out_width * out_height * 4.0));
+    if (!ok) bench::Note("FAILED: %s could not decode the corpus", variant.name);
+  }
+
+  FramePool pool;
+  FrameFormat format;
+  format.width = width;
+  format.height = height;
+  pool.Configure(format, 8, 16);
+  for (int workers : {1, 2, 4}) {
+    MjpegPipeline pipeline;
+    MjpegPipelineOptions options;
+    options.workers = workers;
+    // Room for a full batch, so the throughput run drops nothing.
+    options.max_queued = static_cast<size_t>(workers);
+    pipeline.Start(options, &pool, [](FrameRef) {});
+    size_t i = 0;
+    FrameInfo info;
+    // One batch per worker, then wait for all of them; reported per frame.
+    auto result = bench::Measure(
+        "pipeline/workers_" + std::to_string(workers), res, [&] {
+          for (int n = 0; n < workers; n++, i++) {
+            const auto &frame = frames[i % frames.size()];
+            info.sequence = i;
+            pipeline.Submit(frame.data(), frame.size(), info);
+          }
+          pipeline.Flush();
+        });
+    result.ns_per_frame /= workers;
+    result.cycles_per_frame /= workers;
+    bench::Print(result.WithBytes(mean_bytes + width * height * 4.0));
+    const MjpegPipelineStats stats = pipeline.Stats();
+    if (stats.decoded != stats.submitted) {
+      bench::Note("FAILED: %llu of %llu frames decoded",
+                  static_cast<unsigned long long>(stats.decoded),
+                  static_cast<unsigned long long>(stats.submitted));
+    }
+  }
+
+  // A camera outpacing one worker: everything is submitted at once, so
+  // most frames should give way to newer ones rather than queue up.
+  MjpegPipeline pipeline;
+  MjpegPipelineOptions options;
+  options.workers = 1;
+  pipeline.Start(options, &pool, [](FrameRef) {});
+  FrameInfo info;
+  for (size_t i = 0; i < 100; i++) {
+    const auto &frame = frames[i % frames.size()];
+    info.sequence = i;
+    pipeline.Submit(frame.data(), frame.size(), info);
+  }
+  pipeline.Flush();
+  const MjpegPipelineStats stats = pipeline.Stats();
+  bench::Note("overload, 1 worker: %llu submitted, %llu decoded, %llu dropped",
+              static_cast<unsigned long long>(stats.submitted),
+              static_cast<unsigned long long>(stats.decoded),
+              static_cast<unsigned long long>(stats.dropped_stale));
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (!bench::Init(argc, argv)) return 2;
+
+  // Frames grouped by size, largest last.
+  std::map<std::pair<uint32_t, uint32_t>, Frames> corpus;
+  if (const char *path = std::getenv("UVC_MJPEG_CORPUS")) {
+    JpegDecoder decoder;
+    for (auto &frame : LoadCorpus(path)) {
+      uint32_t width, height;
+      if (decoder.ReadSize(frame.data(), frame.size(), &width, &height)) {
+        corpus[{width, height}].push_back(std::move(frame));
+      }
+    }
+    if (corpus.empty()) {
+      std::fprintf(stderr, "no JPEG frames in %s\n", path);
+      return 2;
+    }
+  } else {
+    for (const auto &size : {std::make_pair(1280u, 720u),
+                             std::make_pair(1920u, 1080u),
+                             std::make_pair(3840u, 2160u)}) {
+      corpus[size] = EncodeCorpus(size.first, size.second, 8);
+    }
+  }
+
+  bench::PrintHeader();
+  for (const auto &entry : corpus) {
+    Run({entry.first.first, entry.first.second}, entry.second);
+  }
+  return 0;
+}
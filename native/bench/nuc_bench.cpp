@@ -0,0 +1,77 @@
+// Cost of non-uniformity correction on 14-bit frames for each kernel and
+// stripe thread count, with and without the shutterless column update.
+// The budget is 1 ms per frame at 640x512, the largest common uncooled
+// core.
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_harness.h"
+#include "cpu_features.h"
+#include "nuc.h"
+
+int main(int argc, char **argv) {
+  using namespace uvc;
+  if (!bench::Init(argc, argv)) return 2;
+  const bench::Resolution resolutions[] = {
+      {384, 288}, {640, 512}, {1280, 1024}};
+  std::vector<SimdLevel> levels = {SimdLevel::kScalar};
+  const SimdLevel detected = DetectSimdLevel();
+  if (detected == SimdLevel::kNeon) {
+    levels.push_back(SimdLevel::kNeon);
+  } else {
+    for (int l = 1; l <= static_cast<int>(detected); l++) {
+      levels.push_back(static_cast<SimdLevel>(l));
+    }
+  }
+  bench::Note("stripe threads by default: %zu", DefaultStripeThreads());
+
+  bench::PrintHeader();
+  for (const auto &res : resolutions) {
+    const size_t pixels = static_cast<size_t>(res.width) * res.height;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> gain(0.9f, 1.1f);
+    std::uniform_real_distribution<float> offset(-200.0f, 200.0f);
+    std::vector<float> gains(pixels), offsets(pixels);
+    std::vector<uint16_t> scene(pixels);
+    for (size_t i = 0; i < pixels; i++) {
+      gains[i] = gain(rng);
+      offsets[i] = offset(rng);
+      scene[i] = static_cast<uint16_t>(6000 + (i % res.width) * 2);
+    }
+    auto tables = std::make_shared<const NucTables>(res.width, res.height,
+                                                    gains, offsets);
+    std::vector<uint16_t> frame(pixels);
+
+    for (SimdLevel level : levels) {
+      SetMaxSimdLevel(level);
+      for (bool shutterless : {false, true}) {
+        for (size_t threads : {1, 2, 4}) {
+          NucEngine nuc(threads);
+          NucConfig config;
+          config.enabled = true;
+          config.shutterless = shutterless;
+          nuc.SetConfig(config);
+          nuc.SetTables(tables);
+          const bench::Result r =
+              bench::Measure(std::string("nuc/") + SimdLevelName(level) +
+                                 (shutterless ? "+columns/" : "/") +
+                                 std::to_string(threads) + "t",
+                             res, [&] {
+                               frame = scene;
+                               nuc.Process(frame.data(), res.width,
+                                           res.width, res.height);
+                             })
+                  // Frame copy in, counts read and written, two tables.
+                  .WithBytes(14.0 * pixels);
+          bench::Print(r);
+          if (res.width == 640 && res.height == 512 && r.ns_per_frame > 1e6) {
+            bench::Note("  over the 1 ms budget");
+          }
+        }
+      }
+    }
+    SetMaxSimdLevel(SimdLevel::kNeon);
+  }
+  return 0;
+}
@@ -0,0 +1,45 @@
+// Megapixels per second of the raw-count colouriser for every palette and
+// every lookup kernel the host supports.
+#include <random>
+#include <vector>
+
+#include "bench_harness.h"
+#include "thermal_palette.h"
+
+int main(int argc, char **argv) {
+  using namespace uvc;
+  if (!bench::Init(argc, argv)) return 2;
+  const bench::Resolution resolutions[] = {{384, 288}, {640, 512}, {1280, 720}};
+  const ThermalPalette palettes[] = {
+      ThermalPalette::kWhiteHot, ThermalPalette::kBlackHot,
+      ThermalPalette::kIronbow, ThermalPalette::kRainbow,
+      ThermalPalette::kArctic};
+
+  std::vector<SimdLevel> levels = {SimdLevel::kScalar};
+  if (DetectSimdLevel() == SimdLevel::kAvx2) levels.push_back(SimdLevel::kAvx2);
+
+  bench::Note("detected SIMD level: %s", SimdLevelName(DetectSimdLevel()));
+  bench::PrintHeader();
+  for (const auto &res : resolutions) {
+    // Counts spread over a 14-bit scene, like an uncooled core.
+    std::mt19937 rng(1);
+    std::vector<uint16_t> src(res.width * res.height);
+    for (auto &v : src) v = static_cast<uint16_t>(6000 + rng() % 4000);
+    std::vector<uint8_t> dst(res.width * res.height * 4);
+
+    for (ThermalPalette palette : palettes) {
+      const uint32_t *table = GetPaletteTable(palette);
+      for (SimdLevel level : levels) {
+        bench::Print(bench::Measure(
+            std::string("palette/") + ThermalPaletteName(palette) + "/" +
+                SimdLevelName(level),
+            res, [&] {
+              ColorizeGray16WithLevel(level, src.data(), res.width, table,
+                                      dst.data(), res.width * 4, res.width,
+                                      res.height, 6000, 10000);
+            }).WithBytes(6.0 * res.width * res.height));
+      }
+    }
+  }
+  return 0;
+}
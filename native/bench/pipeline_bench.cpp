@@ -0,0 +1,136 @@
+// The whole capture path without a camera: an unpaced synthetic source feeds
+// the same acquire / convert / publish steps as the runners' capture loops,
+// while a consumer thread takes frames off the triple buffer like the raster
+// thread does. "source" is the cost of producing the frame alone, so the
+// difference to "pipeline" is what the app adds per frame.
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "agc.h"
+#include "bench_harness.h"
+#include "frame_pool.h"
+#include "pixel_convert.h"
+#include "raw_convert.h"
+#include "synthetic_source.h"
+#include "thermal_palette.h"
+#include "triple_buffer.h"
+#include "yuv_convert.h"
+
+namespace {
+
+using namespace uvc;
+
+const char *FormatName(SourcePixelFormat format) {
+  switch (format) {
+    case SourcePixelFormat::kBgra32:
+      return "bgra";
+    case SourcePixelFormat::kYuyv:
+      return "yuyv";
+    case SourcePixelFormat::kGray16:
+      return "y14+agc";
+    case SourcePixelFormat::kUyvy:
+      return "uyvy";
+    case SourcePixelFormat::kNv12:
+      return "nv12";
+    case SourcePixelFormat::kMjpeg:
+      return "mjpeg";
+  }
+  return "";
+}
+
+void Run(bench::Resolution res, SourcePixelFormat format) {
+  SyntheticConfig config;
+  config.width = static_cast<uint32_t>(res.width);
+  config.height = static_cast<uint32_t>(res.height);
+  config.format = format;
+  config.fps = 0;
+  SyntheticSource source(config);
+  source.Start();
+  const SourceMode mode = source.mode();
+  const RawPacking packing = RawPackingForMode(mode);
+
+  FramePool frame_pool, raw_pool;
+  FrameFormat frame_format;
+  frame_format.width = mode.width;
+  frame_format.height = mode.height;
+  frame_pool.Configure(frame_format, 5, 8);
+  frame_format.pixel_format = PixelFormat::kGray16;
+  raw_pool.Configure(frame_format, 3, 6);
+  TripleBuffer<FrameRef> preview;
+  AutoGain agc;
+  const uint32_t *palette = GetPaletteTable(ThermalPalette::kIronbow);
+
+  SourceFrame frame;
+  const std::string name = std::string("/") + FormatName(format);
+  bench::Print(bench::Measure("source" + name, res, [&] {
+    source.Next(0, &frame);
+    source.Release(frame);
+  }));
+
+  // A display refreshing at 1 kHz.
+  std::atomic<bool> stop{false};
+  std::thread consumer([&] {
+    while (!stop.load()) {
+      preview.Update();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+
+  bench::Print(bench::Measure("pipeline" + name, res, [&] {
+    source.Next(0, &frame);
+    FrameRef out = frame_pool.Acquire();
+    FrameRef raw;
+    if (packing != RawPacking::kNone) raw = raw_pool.Acquire();
+    if (out) {
+      const ptrdiff_t dst_stride = static_cast<ptrdiff_t>(out.format().Stride());
+      if (raw) {
+        uint16_t *counts = reinterpret_cast<uint16_t *>(raw.data());
+        UnpackRaw16(packing, frame.data, frame.stride, counts, mode.width,
+                    mode.height);
+        agc.Process(counts, mode.width, mode.width, mode.height, palette,
+                    out.data(), dst_stride);
+      } else if (format == SourcePixelFormat::kBgra32) {
+        ConvertBgrxToRgba(frame.data, frame.stride, out.data(), dst_stride,
+                          mode.width, mode.height);
+      } else if (format == SourcePixelFormat::kUyvy) {
+        ConvertUyvyToRgba(frame.data, frame.stride, out.data(), dst_stride,
+                          mode.width, mode.height);
+      } else if (format == SourcePixelFormat::kNv12) {
+        ConvertNv12ToRgba(frame.data, frame.stride,
+                          frame.data + frame.stride * mode.height,
+                          frame.stride, out.data(), dst_stride, mode.width,
+                          mode.height);
+      } else {
+        ConvertYuyvToRgba(frame.data, frame.stride, out.data(), dst_stride,
+                          mode.width, mode.height);
+      }
+      out.info().sequence = frame.sequence;
+      out.info().timestamp = frame.timestamp;
+      preview.WriteBuffer() = std::move(out);
+      preview.Publish();
+    }
+    source.Release(frame);
+  }));
+
+  stop.store(true);
+  consumer.join();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (!bench::Init(argc, argv)) return 2;
+  const bench::Resolution resolutions[] = {{256, 192}, {640, 512}, {1280, 720}};
+  const SourcePixelFormat formats[] = {SourcePixelFormat::kGray16,
+                                       SourcePixelFormat::kBgra32,
+                                       SourcePixelFormat::kYuyv,
+                                       SourcePixelFormat::kNv12};
+  bench::PrintHeader();
+  for (const auto &res : resolutions) {
+    for (SourcePixelFormat format : formats) Run(res, format);
+  }
+  return 0;
+}
@@ -0,0 +1,136 @@
+// Compares every BGRA->RGBA kernel the host supports against the scalar one
+// and against the byte-at-a-time loop ReadSampleLoop used originally, and
+// the tone-curve conversion (brightness / contrast / gamma) fused into the
+// swizzle, at every level, against the same level's plain swizzle and
+// against the plain conversion followed by a second pass.
+#include <cstring>
+#include <vector>
+
+#include "bench_harness.h"
+#include "pixel_convert.h"
+#include "tone_curve.h"
+
+namespace {
+
+void LegacyByteLoop(const uint8_t *src, ptrdiff_t src_stride, uint8_t *dst,
+                    size_t width, size_t height) {
+  for (size_t y = 0; y < height; y++) {
+    for (size_t x = 0; x < width; x++) {
+      dst[x * 4 + 0] = src[x * 4 + 2];
+      dst[x * 4 + 1] = src[x * 4 + 1];
+      dst[x * 4 + 2] = src[x * 4 + 0];
+      dst[x * 4 + 3] = src[x * 4 + 3];
+    }
+    dst += width * 4;
+    src += src_stride;
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  using namespace uvc;
+  if (!bench::Init(argc, argv)) return 2;
+
+  std::vector<SimdLevel> levels = {SimdLevel::kScalar};
+  const SimdLevel detected = DetectSimdLevel();
+  if (detected == SimdLevel::kNeon) {
+    levels.push_back(SimdLevel::kNeon);
+  } else {
+    for (int l = 1; l <= static_cast<int>(detected); l++) {
+      levels.push_back(static_cast<SimdLevel>(l));
+    }
+  }
+
+  bench::Note("detected SIMD level: %s", SimdLevelName(detected));
+  bench::PrintHeader();
+  int failures = 0;
+  for (const auto &res : bench::kStandardResolutions) {
+    const size_t bytes = res.width * res.height * 4;
+    std::vector<uint8_t> src(bytes);
+    for (size_t i = 0; i < bytes; i++) src[i] = static_cast<uint8_t>(i * 131);
+    std::vector<uint8_t> reference(bytes);
+    std::vector<uint8_t> dst(bytes);
+    const ptrdiff_t stride = static_cast<ptrdiff_t>(res.width * 4);
+
+    LegacyByteLoop(src.data(), stride, reference.data(), res.width,
+                   res.height);
+    bench::Print(bench::Measure("bgra_to_rgba/legacy_loop", res, [&] {
+                   LegacyByteLoop(src.data(), stride, reference.data(),
+                                  res.width, res.height);
+                 }).WithBytes(2.0 * bytes));
+
+    double scalar_ns = 0;
+    for (SimdLevel level : levels) {
+      std::memset(dst.data(), 0, bytes);
+      ConvertBgraToRgbaWithLevel(level, src.data(), stride, dst.data(),
+                                 stride, res.width, res.height);
+      if (dst != reference) {
+        bench::Note("MISMATCH: %s differs from scalar reference",
+                    SimdLevelName(level));
+        failures++;
+      }
+      const auto result = bench::Measure(
+          std::string("bgra_to_rgba/") + SimdLevelName(level), res, [&] {
+            ConvertBgraToRgbaWithLevel(level, src.data(), stride, dst.data(),
+                                       stride, res.width, res.height);
+          }).WithBytes(2.0 * bytes);
+      bench::Print(result);
+      if (level == SimdLevel::kScalar) {
+        scalar_ns = result.ns_per_frame;
+      } else if (!result.skipped && scalar_ns > 0) {
+        bench::Note("%-32s %11s %13.2fx", "", "vs scalar",
+                    scalar_ns / result.ns_per_frame);
+      }
+    }
+
+    ToneCurve tone;
+    ToneSettings settings;
+    settings.contrast = 0.6;
+    settings.gamma = 1.5;
+    tone.Set(settings);
+    tone.Update();
+    // Each level's table conversion against its plain swizzle: the cost of
+    // the lookups on top of the shuffle.
+    std::vector<uint8_t> lut_reference(bytes);
+    ConvertBgraToRgbaLutWithLevel(SimdLevel::kScalar, src.data(), stride,
+                                  lut_reference.data(), stride, res.width,
+                                  res.height, tone.swizzle_lut(), false);
+    for (SimdLevel level : levels) {
+      std::memset(dst.data(), 0, bytes);
+      ConvertBgraToRgbaLutWithLevel(level, src.data(), stride, dst.data(),
+                                    stride, res.width, res.height,
+                                    tone.swizzle_lut(), false);
+      if (dst != lut_reference) {
+        bench::Note("MISMATCH: tone_lut %s differs from scalar",
+                    SimdLevelName(level));
+        failures++;
+      }
+      const auto plain = bench::Measure(
+          std::string("bgra_to_rgba/") + SimdLevelName(level), res, [&] {
+            ConvertBgraToRgbaWithLevel(level, src.data(), stride, dst.data(),
+                                       stride, res.width, res.height);
+          }).WithBytes(2.0 * bytes);
+      const auto toned = bench::Measure(
+          std::string("bgra_to_rgba/tone_lut/") + SimdLevelName(level), res,
+          [&] {
+            ConvertBgraToRgbaLutWithLevel(level, src.data(), stride,
+                                          dst.data(), stride, res.width,
+                                          res.height, tone.swizzle_lut(),
+                                          false);
+          }).WithBytes(2.0 * bytes);
+      bench::Print(toned);
+      if (!toned.skipped && !plain.skipped) {
+        bench::Note("%-32s %11s %13.2fx", "", "time vs swizzle",
+                    toned.ns_per_frame / plain.ns_per_frame);
+      }
+    }
+    bench::Print(bench::Measure("bgra_to_rgba/tone_two_pass", res, [&] {
+                   ConvertBgraToRgba(src.data(), stride, dst.data(), stride,
+                                     res.width, res.height);
+                   ApplyCurveToRgba(dst.data(), stride, res.width, res.height,
+                                    tone.curve());
+                 }).WithBytes(4.0 * bytes));
+  }
+  return failures == 0 ? 0 : 1;
+}
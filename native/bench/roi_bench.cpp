@@ -0,0 +1,73 @@
+// Cost of measuring ROIs on a raw frame for each kernel: a few small boxes
+// as a user would place them, one box over the whole frame, and a long
+// polyline.
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_harness.h"
+#include "cpu_features.h"
+#include "roi_engine.h"
+
+int main(int argc, char **argv) {
+  using namespace uvc;
+  if (!bench::Init(argc, argv)) return 2;
+  const bench::Resolution resolutions[] = {
+      {384, 288}, {640, 512}, {1280, 1024}};
+  std::vector<SimdLevel> levels = {SimdLevel::kScalar};
+  const SimdLevel detected = DetectSimdLevel();
+  if (detected == SimdLevel::kNeon) {
+    levels.push_back(SimdLevel::kNeon);
+  } else {
+    for (int l = 1; l <= static_cast<int>(detected); l++) {
+      levels.push_back(static_cast<SimdLevel>(l));
+    }
+  }
+
+  bench::PrintHeader();
+  for (const auto &res : resolutions) {
+    const int32_t w = res.width;
+    const int32_t h = res.height;
+    const size_t pixels = static_cast<size_t>(w) * h;
+    std::mt19937 rng(1);
+    std::normal_distribution<float> noise(0.0f, 4.0f);
+    std::vector<uint16_t> frame(pixels);
+    for (size_t i = 0; i < pixels; i++) {
+      frame[i] = static_cast<uint16_t>(6000 + (i % w) * 2 + noise(rng));
+    }
+
+    std::vector<Roi> boxes;
+    for (int32_t i = 0; i < 8; i++) {
+      const int32_t x = (i % 4) * w / 4 + 8;
+      const int32_t y = (i / 4) * h / 2 + 8;
+      boxes.push_back(Roi{i, RoiShape::kRect, {{x, y}, {x + 31, y + 31}}});
+    }
+    const std::vector<Roi> whole = {
+        Roi{0, RoiShape::kRect, {{0, 0}, {w - 1, h - 1}}}};
+    const std::vector<Roi> line = {Roi{0,
+                                       RoiShape::kPolyline,
+                                       {{0, 0},
+                                        {w - 1, h - 1},
+                                        {0, h - 1},
+                                        {w - 1, 0}}}};
+    const struct {
+      const char *name;
+      const std::vector<Roi> &rois;
+    } cases[] = {{"boxes8x32", boxes}, {"frame", whole}, {"polyline", line}};
+
+    for (const auto &c : cases) {
+      RoiEngine engine;
+      engine.SetRois(c.rois);
+      std::vector<RoiStats> stats;
+      for (SimdLevel level : levels) {
+        SetMaxSimdLevel(level);
+        const bench::Result r = bench::Measure(
+            std::string(c.name) + "/" + SimdLevelName(level), res,
+            [&] { engine.Measure(frame.data(), w, w, h, &stats); });
+        bench::Print(r);
+      }
+      SetMaxSimdLevel(SimdLevel::kNeon);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,76 @@
+// Time to encode one snapshot: RGBA PNG and 16-bit TIFF from a thermal core
+// up to 4K, plus the whole encode-and-write a captureToFile call costs the
+// snapshot worker. The platform thread only queues the frame handle.
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_harness.h"
+#include "frame_pool.h"
+#include "image_encode.h"
+#include "snapshot_writer.h"
+
+int main(int argc, char **argv) {
+  using namespace uvc;
+  if (!bench::Init(argc, argv)) return 2;
+  const bench::Resolution resolutions[] = {
+      {640, 512}, {1920, 1080}, {3840, 2160}};
+#if defined(UVC_HAVE_ZLIB)
+  bench::Note("PNG: zlib, fastest level");
+#else
+  bench::Note("PNG: stored deflate blocks (no zlib)");
+#endif
+
+  bench::PrintHeader();
+  for (const auto &res : resolutions) {
+    const uint32_t width = static_cast<uint32_t>(res.width);
+    const uint32_t height = static_cast<uint32_t>(res.height);
+    // Smooth gradients with sensor noise, which compress like a camera
+    // image rather than like flat test colours.
+    std::mt19937 rng(1);
+    FramePool pool;
+    FrameFormat format;
+    format.width = width;
+    format.height = height;
+    pool.Configure(format, 1, 1);
+    FrameRef frame = pool.Acquire();
+    uint8_t *rgba = frame.data();
+    std::vector<uint16_t> counts(res.width * res.height);
+    for (uint32_t y = 0; y < height; y++) {
+      for (uint32_t x = 0; x < width; x++) {
+        const int noise = static_cast<int>(rng() % 8);
+        uint8_t *p = &rgba[(static_cast<size_t>(y) * width + x) * 4];
+        p[0] = static_cast<uint8_t>(x * 255 / width + noise);
+        p[1] = static_cast<uint8_t>(y * 255 / height + noise);
+        p[2] = static_cast<uint8_t>(128 + noise);
+        p[3] = 255;
+        counts[static_cast<size_t>(y) * width + x] =
+            static_cast<uint16_t>(6000 + x + y + noise * 4);
+      }
+    }
+
+    std::vector<uint8_t> encoded;
+    const auto png = bench::Measure("encode/png", res, [&] {
+      EncodePng(rgba, static_cast<ptrdiff_t>(width) * 4, width, height,
+                &encoded);
+    });
+    bench::Print(png.WithBytes(res.width * res.height * 4.0 + encoded.size()));
+    bench::Note("png: %.1f%% of the raw size",
+                100.0 * encoded.size() / (res.width * res.height * 4.0));
+    bench::Print(bench::Measure("encode/tiff16", res, [&] {
+                   EncodeTiff16(counts.data(), width, width, height,
+                                &encoded);
+                 }).WithBytes(res.width * res.height * 4.0));
+
+    const std::string path =
+        (std::filesystem::temp_directory_path() / "uvc_snapshot_bench.png")
+            .string();
+    bench::Print(bench::Measure("write/png", res, [&] {
+      WriteSnapshot(frame, SnapshotFormat::kPng, path);
+    }));
+    std::remove(path.c_str());
+  }
+  return 0;
+}
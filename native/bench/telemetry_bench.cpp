@@ -0,0 +1,206 @@
+// Cost of turning one frame's ROI results into a channel message, from the
+// results to the encoded bytes, for 1, 8 and 64 ROIs:
+//   record      WriteRoiRecord into a fixed buffer, sent as one byte list
+//   float_list  the previous {sequence, timestampUs, stats} event, stats a
+//               Float64List of 8 doubles per ROI
+//   map         a map with string keys per ROI, the way getDeviceStatus and
+//               getSupportedResolutions build their results
+// The map cases build EncodableValue-like trees and encode them with
+// StandardMessageCodec's wire format, as the Flutter engine's codec would;
+// the "resolution" column is the ROI count.
+#include <cstring>
+#include <map>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "bench_harness.h"
+#include "roi_engine.h"
+#include "telemetry_record.h"
+
+namespace {
+
+using namespace uvc;
+
+// Mirrors flutter::EncodableValue for the types these messages use.
+struct Value;
+using List = std::vector<Value>;
+using Map = std::map<std::string, Value>;
+struct Value {
+  std::variant<int64_t, double, std::string, std::vector<uint8_t>,
+               std::vector<double>, List, Map>
+      v;
+};
+
+// StandardMessageCodec's encoding, written the way its ByteStreamWriter
+// does: byte at a time into a growing vector.
+class StandardWriter {
+ public:
+  explicit StandardWriter(std::vector<uint8_t> *out) : out_(out) {}
+
+  void Write(const Value &value) {
+    switch (value.v.index()) {
+      case 0:
+        out_->push_back(4);
+        WriteRaw(&std::get<int64_t>(value.v), 8);
+        break;
+      case 1:
+        out_->push_back(6);
+        Align(8);
+        WriteRaw(&std::get<double>(value.v), 8);
+        break;
+      case 2:
+        WriteString(std::get<std::string>(value.v));
+        break;
+      case 3: {
+        const auto &bytes = std::get<std::vector<uint8_t>>(value.v);
+        out_->push_back(8);
+        WriteSize(bytes.size());
+        WriteRaw(bytes.data(), bytes.size());
+        break;
+      }
+      case 4: {
+        const auto &doubles = std::get<std::vector<double>>(value.v);
+        out_->push_back(11);
+        WriteSize(doubles.size());
+        Align(8);
+        WriteRaw(doubles.data(), doubles.size() * sizeof(double));
+        break;
+      }
+      case 5: {
+        const List &list = std::get<List>(value.v);
+        out_->push_back(12);
+        WriteSize(list.size());
+        for (const Value &item : list) Write(item);
+        break;
+      }
+      case 6: {
+        const Map &map = std::get<Map>(value.v);
+        out_->push_back(13);
+        WriteSize(map.size());
+        for (const auto &entry : map) {
+          WriteString(entry.first);
+          Write(entry.second);
+        }
+        break;
+      }
+    }
+  }
+
+ private:
+  void WriteString(const std::string &s) {
+    out_->push_back(7);
+    WriteSize(s.size());
+    WriteRaw(s.data(), s.size());
+  }
+  void WriteSize(size_t size) {
+    if (size < 254) {
+      out_->push_back(static_cast<uint8_t>(size));
+    } else if (size <= 0xffff) {
+      out_->push_back(254);
+      const uint16_t s = static_cast<uint16_t>(size);
+      WriteRaw(&s, 2);
+    } else {
+      out_->push_back(255);
+      const uint32_t s = static_cast<uint32_t>(size);
+      WriteRaw(&s, 4);
+    }
+  }
+  void Align(size_t alignment) {
+    while (out_->size() % alignment != 0) out_->push_back(0);
+  }
+  void WriteRaw(const void *data, size_t size) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; i++) out_->push_back(bytes[i]);
+  }
+
+  std::vector<uint8_t> *out_;
+};
+
+Value Int(int64_t value) { return Value{value}; }
+Value Double(double value) { return Value{value}; }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (!bench::Init(argc, argv)) return 2;
+  bench::PrintHeader();
+  for (size_t rois : {size_t{1}, size_t{8}, size_t{64}}) {
+    const bench::Resolution res{rois, 1};
+    RoiFrame frame;
+    frame.sequence = 123456;
+    frame.timestamp = 98765432100;
+    for (size_t i = 0; i < rois; i++) {
+      RoiStats s;
+      s.id = static_cast<int32_t>(i);
+      s.count = 1024;
+      s.min = 6000;
+      s.max = 7200;
+      s.mean = 6543.21;
+      s.stddev = 87.6;
+      s.max_x = 100 + static_cast<int32_t>(i);
+      s.max_y = 200;
+      frame.stats.push_back(s);
+    }
+
+    uint8_t record[RoiRecordBytes(RoiEngine::kMaxRois)];
+    size_t message_bytes = 0;
+    bench::Print(bench::Measure("record", res, [&] {
+      TelemetryWriter writer(record, sizeof(record));
+      const size_t size = WriteRoiRecord(frame, &writer);
+      // The runner hands the codec one byte list.
+      Value value{std::vector<uint8_t>(record, record + size)};
+      std::vector<uint8_t> out;
+      StandardWriter(&out).Write(value);
+      message_bytes = out.size();
+      bench::DoNotOptimize(out.data());
+    }));
+    bench::Note("  record message: %zu bytes", message_bytes);
+
+    bench::Print(bench::Measure("float_list", res, [&] {
+      std::vector<double> values;
+      for (const RoiStats &s : frame.stats) {
+        values.insert(values.end(),
+                      {static_cast<double>(s.id), static_cast<double>(s.count),
+                       static_cast<double>(s.min), static_cast<double>(s.max),
+                       s.mean, s.stddev, static_cast<double>(s.max_x),
+                       static_cast<double>(s.max_y)});
+      }
+      Map event;
+      event["sequence"] = Int(static_cast<int64_t>(frame.sequence));
+      event["timestampUs"] = Int(frame.timestamp / 10);
+      event["stats"] = Value{std::move(values)};
+      std::vector<uint8_t> out;
+      StandardWriter(&out).Write(Value{std::move(event)});
+      message_bytes = out.size();
+      bench::DoNotOptimize(out.data());
+    }));
+    bench::Note("  float_list message: %zu bytes", message_bytes);
+
+    bench::Print(bench::Measure("map", res, [&] {
+      List stats;
+      for (const RoiStats &s : frame.stats) {
+        Map entry;
+        entry["id"] = Int(s.id);
+        entry["count"] = Int(s.count);
+        entry["min"] = Int(s.min);
+        entry["max"] = Int(s.max);
+        entry["mean"] = Double(s.mean);
+        entry["stddev"] = Double(s.stddev);
+        entry["maxX"] = Int(s.max_x);
+        entry["maxY"] = Int(s.max_y);
+        stats.push_back(Value{std::move(entry)});
+      }
+      Map event;
+      event["sequence"] = Int(static_cast<int64_t>(frame.sequence));
+      event["timestampUs"] = Int(frame.timestamp / 10);
+      event["stats"] = Value{std::move(stats)};
+      std::vector<uint8_t> out;
+      StandardWriter(&out).Write(Value{std::move(event)});
+      message_bytes = out.size();
+      bench::DoNotOptimize(out.data());
+    }));
+    bench::Note("  map message: %zu bytes", message_bytes);
+  }
+  return 0;
+}
@@ -0,0 +1,150 @@
+// Compares every YUV->RGBA kernel the host supports (YUY2, UYVY and NV12)
+// against the scalar one, and the scalar one against the 8.8 fixed-point
+// loop the YUYV path used before. Each SIMD result is also checked against
+// scalar output, so a run doubles as a smoke test.
+//
+// bytes/cycle counts the YUV bytes read plus the RGBA bytes written: 6 per
+// pixel for the packed layouts, 5.5 for NV12.
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_harness.h"
+#include "yuv_convert.h"
+
+namespace {
+
+using namespace uvc;
+
+inline uint8_t Clamp8(int v) {
+  return static_cast<uint8_t>(std::min(std::max(v, 0), 255));
+}
+
+// The BT.601 limited-range YUYV loop before the SIMD kernels.
+void LegacyYuyvLoop(const uint8_t *src, uint8_t *dst, size_t width,
+                    size_t height) {
+  const auto pixel = [](int y, int u, int v, uint8_t *d) {
+    const int c = 298 * (y - 16) + 128;
+    const int e = u - 128;
+    const int f = v - 128;
+    d[0] = Clamp8((c + 409 * f) >> 8);
+    d[1] = Clamp8((c - 100 * e - 208 * f) >> 8);
+    d[2] = Clamp8((c + 516 * e) >> 8);
+    d[3] = 255;
+  };
+  for (size_t i = 0; i < width * height / 2; i++, src += 4, dst += 8) {
+    pixel(src[0], src[1], src[3], dst);
+    pixel(src[2], src[1], src[3], dst + 4);
+  }
+}
+
+std::vector<SimdLevel> SupportedLevels() {
+  std::vector<SimdLevel> levels = {SimdLevel::kScalar};
+  const SimdLevel detected = DetectSimdLevel();
+  if (detected == SimdLevel::kNeon) {
+    levels.push_back(SimdLevel::kNeon);
+  } else {
+    for (int l = 1; l <= static_cast<int>(detected); l++) {
+      levels.push_back(static_cast<SimdLevel>(l));
+    }
+  }
+  return levels;
+}
+
+// Measures |convert| at every level; returns the number of levels whose
+// output differs from scalar.
+template <typename Convert>
+int RunLevels(const std::string &name, bench::Resolution res,
+              double bytes_per_frame, std::vector<uint8_t> &dst,
+              const Convert &convert) {
+  std::vector<uint8_t> reference(dst.size());
+  convert(SimdLevel::kScalar, reference.data());
+  int failures = 0;
+  double scalar_ns = 0;
+  for (SimdLevel level : SupportedLevels()) {
+    std::memset(dst.data(), 0, dst.size());
+    convert(level, dst.data());
+    if (dst != reference) {
+      bench::Note("MISMATCH: %s %s differs from scalar", name.c_str(),
+                  SimdLevelName(level));
+      failures++;
+    }
+    const auto result =
+        bench::Measure(name + "/" + SimdLevelName(level), res, [&] {
+          convert(level, dst.data());
+        }).WithBytes(bytes_per_frame);
+    bench::Print(result);
+    if (level == SimdLevel::kScalar) {
+      scalar_ns = result.ns_per_frame;
+    } else if (!result.skipped && scalar_ns > 0) {
+      bench::Note("%-32s %11s %13.2fx", "", "vs scalar",
+                  scalar_ns / result.ns_per_frame);
+    }
+  }
+  return failures;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (!bench::Init(argc, argv)) return 2;
+
+  bench::Note("detected SIMD level: %s", SimdLevelName(DetectSimdLevel()));
+  bench::PrintHeader();
+  const YuvColorSpace bt709{YuvMatrix::kBt709, YuvRange::kLimited};
+  // A gamma-like curve for the toned case.
+  uint8_t curve[256];
+  for (int i = 0; i < 256; i++) {
+    curve[i] = static_cast<uint8_t>(std::sqrt(i / 255.0) * 255.0 + 0.5);
+  }
+  int failures = 0;
+  for (const auto &res : bench::kStandardResolutions) {
+    const size_t width = res.width;
+    const size_t height = res.height;
+    const size_t pixels = width * height;
+    std::mt19937 rng(1);
+    std::vector<uint8_t> packed(pixels * 2);
+    for (auto &b : packed) b = static_cast<uint8_t>(rng());
+    std::vector<uint8_t> dst(pixels * 4);
+    const ptrdiff_t packed_stride = static_cast<ptrdiff_t>(width * 2);
+    const ptrdiff_t dst_stride = static_cast<ptrdiff_t>(width * 4);
+
+    bench::Print(bench::Measure("yuyv/legacy_loop", res, [&] {
+                   LegacyYuyvLoop(packed.data(), dst.data(), width, height);
+                 }).WithBytes(6.0 * pixels));
+    failures += RunLevels(
+        "yuyv", res, 6.0 * pixels, dst, [&](SimdLevel level, uint8_t *out) {
+          ConvertYuyvToRgbaWithLevel(level, packed.data(), packed_stride, out,
+                                     dst_stride, width, height);
+        });
+    failures += RunLevels(
+        "yuyv_709", res, 6.0 * pixels, dst, [&](SimdLevel level, uint8_t *out) {
+          ConvertYuyvToRgbaWithLevel(level, packed.data(), packed_stride, out,
+                                     dst_stride, width, height, bt709);
+        });
+    failures += RunLevels(
+        "yuyv_toned", res, 6.0 * pixels, dst,
+        [&](SimdLevel level, uint8_t *out) {
+          ConvertYuyvToRgbaWithLevel(level, packed.data(), packed_stride, out,
+                                     dst_stride, width, height,
+                                     YuvColorSpace(), curve);
+        });
+    failures += RunLevels(
+        "uyvy", res, 6.0 * pixels, dst, [&](SimdLevel level, uint8_t *out) {
+          ConvertUyvyToRgbaWithLevel(level, packed.data(), packed_stride, out,
+                                     dst_stride, width, height);
+        });
+    // NV12 as one Media Foundation buffer: the UV plane follows the Y plane.
+    const uint8_t *luma = packed.data();
+    const uint8_t *chroma = packed.data() + pixels;
+    failures += RunLevels(
+        "nv12", res, 5.5 * pixels, dst, [&](SimdLevel level, uint8_t *out) {
+          ConvertNv12ToRgbaWithLevel(level, luma, width, chroma, width, out,
+                                     dst_stride, width, height);
+        });
+  }
+  return failures == 0 ? 0 : 1;
+}
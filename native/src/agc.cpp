@@ -0,0 +1,220 @@
+#include "agc.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace uvc {
+
+namespace {
+
+constexpr uint32_t kNeverWritten = 0xFFFFFFFFu;
+constexpr uint32_t kPaletteMax = 65535;
+// Palette steps a bin may drift before its LUT entries are rewritten. 16 of
+// 65535 is well below one 8-bit output level.
+constexpr uint32_t kRewriteHysteresis = 16;
+
+struct ModeName {
+  AgcMode mode;
+  const char *name;
+};
+
+constexpr ModeName kModeNames[] = {
+    {AgcMode::kLinear, "linear"},
+    {AgcMode::kPercentile, "percentile"},
+    {AgcMode::kPlateau, "plateau"},
+};
+
+}  // namespace
+
+const char *AgcModeName(AgcMode mode) {
+  for (const auto &entry : kModeNames) {
+    if (entry.mode == mode) return entry.name;
+  }
+  return "unknown";
+}
+
+bool ParseAgcMode(const char *name, AgcMode *mode) {
+  for (const auto &entry : kModeNames) {
+    if (std::strcmp(entry.name, name) == 0) {
+      *mode = entry.mode;
+      return true;
+    }
+  }
+  return false;
+}
+
+AutoGain::AutoGain()
+    : histogram_(new uint32_t[kBins]()),
+      target_(new float[kBins]()),
+      mapping_(new float[kBins]()),
+      written_index_(new uint32_t[kBins]),
+      lut_(new uint32_t[65536]()) {
+  std::fill(written_index_.get(), written_index_.get() + kBins, kNeverWritten);
+}
+
+AutoGain::~AutoGain() = default;
+
+void AutoGain::SetConfig(const AgcConfig &config) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  pending_config_ = config;
+  config_dirty_.store(true, std::memory_order_release);
+}
+
+AgcConfig AutoGain::config() const {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return config_dirty_.load(std::memory_order_acquire) ? pending_config_
+                                                       : config_;
+}
+
+void AutoGain::Reset() { primed_ = false; }
+
+void AutoGain::Process(const uint16_t *src, size_t src_stride_pixels,
+                       size_t width, size_t height, const uint32_t *palette,
+                       uint8_t *dst, ptrdiff_t dst_stride) {
+  if (config_dirty_.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    config_ = pending_config_;
+    config_dirty_.store(false, std::memory_order_relaxed);
+  }
+
+  const size_t pixel_count = width * height;
+  if (!primed_) {
+    // No mapping yet: measure this frame first instead of showing it black.
+    Accumulate(src, src_stride_pixels, width, height);
+    UpdateMapping(pixel_count, true);
+    RebuildLut(palette, true);
+    primed_ = true;
+  } else if (palette != lut_palette_) {
+    RebuildLut(palette, true);
+  }
+
+  // Render and gather the next histogram in a single pass.
+  uint32_t *hist = histogram_.get();
+  const uint32_t *lut = lut_.get();
+  std::memset(hist, 0, kBins * sizeof(uint32_t));
+  for (size_t y = 0; y < height; y++) {
+    const uint16_t *s = src + y * src_stride_pixels;
+    uint8_t *d = dst + static_cast<ptrdiff_t>(y) * dst_stride;
+    for (size_t x = 0; x < width; x++) {
+      const uint16_t v = s[x];
+      hist[v >> kBinShift]++;
+      std::memcpy(d + x * 4, &lut[v], 4);
+    }
+  }
+
+  UpdateMapping(pixel_count, false);
+  RebuildLut(palette, false);
+}
+
+void AutoGain::Accumulate(const uint16_t *src, size_t src_stride_pixels,
+                          size_t width, size_t height) {
+  uint32_t *hist = histogram_.get();
+  std::memset(hist, 0, kBins * sizeof(uint32_t));
+  for (size_t y = 0; y < height; y++) {
+    const uint16_t *s = src + y * src_stride_pixels;
+    for (size_t x = 0; x < width; x++) hist[s[x] >> kBinShift]++;
+  }
+}
+
+void AutoGain::UpdateMapping(size_t pixel_count, bool snap) {
+  const uint32_t *hist = histogram_.get();
+  size_t first = 0;
+  while (first < kBins && hist[first] == 0) first++;
+  if (first == kBins || pixel_count == 0) return;  // Empty frame.
+  size_t last = kBins - 1;
+  while (hist[last] == 0) last--;
+
+  stats_.scene_min = static_cast<uint16_t>(first << kBinShift);
+  stats_.scene_max =
+      static_cast<uint16_t>((last << kBinShift) | ((1u << kBinShift) - 1));
+
+  ComputeTarget(pixel_count, first, last);
+
+  const float alpha = snap ? 1.0f : std::clamp(config_.smoothing, 0.0f, 1.0f);
+  float *mapping = mapping_.get();
+  const float *target = target_.get();
+  for (size_t b = 0; b < kBins; b++) {
+    mapping[b] += alpha * (target[b] - mapping[b]);
+  }
+}
+
+void AutoGain::ComputeTarget(size_t pixel_count, size_t first_bin,
+                             size_t last_bin) {
+  const uint32_t *hist = histogram_.get();
+  float *target = target_.get();
+  std::fill(target, target + first_bin, 0.0f);
+  std::fill(target + last_bin + 1, target + kBins, 1.0f);
+
+  if (config_.mode == AgcMode::kPlateau) {
+    size_t occupied = 0;
+    for (size_t b = first_bin; b <= last_bin; b++) occupied += hist[b] != 0;
+    const double mean = static_cast<double>(pixel_count) / occupied;
+    const uint32_t plateau = static_cast<uint32_t>(
+        std::max(1.0, mean * static_cast<double>(config_.plateau)));
+    uint64_t total = 0;
+    for (size_t b = first_bin; b <= last_bin; b++) {
+      total += std::min(hist[b], plateau);
+    }
+    // Each bin maps to the middle of its share of the clipped CDF.
+    const double inv_total = 1.0 / static_cast<double>(total);
+    uint64_t cumulative = 0;
+    for (size_t b = first_bin; b <= last_bin; b++) {
+      const uint32_t clipped = std::min(hist[b], plateau);
+      target[b] = static_cast<float>(
+          (static_cast<double>(cumulative) + clipped * 0.5) * inv_total);
+      cumulative += clipped;
+    }
+    return;
+  }
+
+  size_t low = first_bin, high = last_bin;
+  if (config_.mode == AgcMode::kPercentile) {
+    const double low_count = config_.clip_low * static_cast<double>(pixel_count);
+    const double high_count =
+        (1.0 - config_.clip_high) * static_cast<double>(pixel_count);
+    uint64_t cumulative = 0;
+    bool low_found = false;
+    for (size_t b = first_bin; b <= last_bin; b++) {
+      cumulative += hist[b];
+      if (!low_found && static_cast<double>(cumulative) > low_count) {
+        low = b;
+        low_found = true;
+      }
+      if (static_cast<double>(cumulative) >= high_count) {
+        high = b;
+        break;
+      }
+    }
+  }
+
+  const float span = static_cast<float>(std::max<size_t>(high - low, 1));
+  for (size_t b = first_bin; b <= last_bin; b++) {
+    const float t = (static_cast<float>(b) - static_cast<float>(low)) / span;
+    target[b] = std::clamp(t, 0.0f, 1.0f);
+  }
+}
+
+void AutoGain::RebuildLut(const uint32_t *palette, bool force) {
+  const float *mapping = mapping_.get();
+  uint32_t *written = written_index_.get();
+  uint32_t *lut = lut_.get();
+  uint32_t updated = 0;
+  for (size_t b = 0; b < kBins; b++) {
+    const uint32_t index = std::min<uint32_t>(
+        static_cast<uint32_t>(mapping[b] * kPaletteMax + 0.5f), kPaletteMax);
+    if (!force && written[b] != kNeverWritten) {
+      const uint32_t delta =
+          index > written[b] ? index - written[b] : written[b] - index;
+      if (delta <= kRewriteHysteresis) continue;
+    }
+    written[b] = index;
+    const uint32_t color = palette[index];
+    uint32_t *entries = lut + (b << kBinShift);
+    for (size_t i = 0; i < (1u << kBinShift); i++) entries[i] = color;
+    updated++;
+  }
+  lut_palette_ = palette;
+  stats_.updated_bins = updated;
+}
+
+}  // namespace uvc
@@ -0,0 +1,122 @@
+#ifndef UVC_AGC_H_
+#define UVC_AGC_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace uvc {
+
+enum class AgcMode {
+  // Stretch the scene's min..max onto the palette.
+  kLinear,
+  // Like kLinear, but ignore the coldest and hottest pixels given by
+  // AgcConfig::clip_low / clip_high so single hot spots do not flatten the
+  // rest of the image.
+  kPercentile,
+  // Plateau histogram equalization: each histogram bin is clipped at a
+  // plateau before building the cumulative mapping, so large uniform areas
+  // (sky, walls) cannot claim most of the palette.
+  kPlateau,
+};
+
+const char *AgcModeName(AgcMode mode);
+bool ParseAgcMode(const char *name, AgcMode *mode);
+
+struct AgcConfig {
+  AgcMode mode = AgcMode::kPlateau;
+  // Fractions of pixels clipped at each end in kPercentile mode.
+  float clip_low = 0.005f;
+  float clip_high = 0.005f;
+  // Plateau as a multiple of the mean count of the occupied bins.
+  float plateau = 3.0f;
+  // Weight of the newest frame in the exponential moving average of the
+  // mapping: 1 follows the scene immediately, smaller values damp flicker.
+  float smoothing = 0.25f;
+};
+
+struct AgcStats {
+  uint16_t scene_min = 0;
+  uint16_t scene_max = 0;
+  // Histogram bins whose output colour changed in the last update; the
+  // remaining LUT entries were left untouched.
+  uint32_t updated_bins = 0;
+};
+
+// Automatic gain control for raw 16-bit frames.
+//
+// The stage keeps a 64K-entry LUT from raw count to RGBA (the AGC mapping
+// composed with a palette) and renders a frame with one lookup per pixel.
+// The histogram for the next mapping is accumulated in that same loop, so
+// AGC costs no extra pass over the frame; the mapping therefore lags the
+// scene by one frame, which the temporal smoothing hides.
+//
+// After each frame the target mapping is recomputed at histogram-bin
+// resolution, blended into the running mapping, and only LUT entries of bins
+// whose output changed are rewritten. A static scene ends up rewriting
+// nothing.
+//
+// Process() must be called from one thread; SetConfig() may be called from
+// any thread and takes effect on the next frame.
+class AutoGain {
+ public:
+  // Counts are binned four to a bin: 14 significant bits of histogram.
+  static constexpr int kBinShift = 2;
+  static constexpr size_t kBins = 65536 >> kBinShift;
+
+  AutoGain();
+  ~AutoGain();
+  AutoGain(const AutoGain &) = delete;
+  AutoGain &operator=(const AutoGain &) = delete;
+
+  void SetConfig(const AgcConfig &config);
+  AgcConfig config() const;
+
+  // Renders |src| through the current mapping and |palette| (a 64K table
+  // from GetPaletteTable) into RGBA |dst|, then updates the mapping from the
+  // histogram gathered on the way. The first frame after construction or
+  // Reset() is measured before it is rendered.
+  void Process(const uint16_t *src, size_t src_stride_pixels, size_t width,
+               size_t height, const uint32_t *palette, uint8_t *dst,
+               ptrdiff_t dst_stride);
+
+  // Forgets the mapping, e.g. when the camera or its range changes.
+  void Reset();
+
+  AgcStats stats() const { return stats_; }
+
+  // Histogram of the last processed frame, kBins entries.
+  const uint32_t *histogram() const { return histogram_.get(); }
+
+  // Current mapping of histogram bin to palette position in [0, 1].
+  float MappingAt(size_t bin) const { return mapping_[bin]; }
+
+ private:
+  void Accumulate(const uint16_t *src, size_t src_stride_pixels, size_t width,
+                  size_t height);
+  void UpdateMapping(size_t pixel_count, bool snap);
+  void ComputeTarget(size_t pixel_count, size_t first_bin, size_t last_bin);
+  void RebuildLut(const uint32_t *palette, bool force);
+
+  mutable std::mutex config_mutex_;
+  AgcConfig pending_config_;
+  std::atomic<bool> config_dirty_{false};
+
+  AgcConfig config_;
+  bool primed_ = false;
+  const uint32_t *lut_palette_ = nullptr;
+  AgcStats stats_;
+
+  std::unique_ptr<uint32_t[]> histogram_;
+  std::unique_ptr<float[]> target_;
+  std::unique_ptr<float[]> mapping_;
+  // Palette index each bin was last written with; UINT32_MAX = never.
+  std::unique_ptr<uint32_t[]> written_index_;
+  std::unique_ptr<uint32_t[]> lut_;
+};
+
+}  // namespace uvc
+
+#endif  // UVC_AGC_H_
@@ -0,0 +1,570 @@
+#include "bad_pixels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <utility>
+
+#include "cpu_features.h"
+
+#if defined(UVC_ARCH_X86)
+#include <immintrin.h>
+#elif defined(UVC_ARCH_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace uvc {
+
+const char kBadPixelMagic[8] = {'U', 'V', 'C', 'B', 'P', 'M', '1', '\0'};
+
+namespace {
+
+// Neighbour slot markers in place of a dx.
+constexpr int8_t kPadLow = -128;
+constexpr int8_t kPadHigh = 127;
+
+// Bad pixels gathered and sorted together.
+constexpr size_t kBatch = 256;
+
+// Below this robust sigma, in counts, the residuals are quantisation and
+// the frames a synthetic or clipped scene.
+constexpr float kMinSigma = 0.5f;
+
+int64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Batcher's odd-even merge sort network for eight values; after applying
+// every compare-exchange in order, slot 4 holds the fifth smallest. Each
+// kernel runs it inline, as a lambda would lose the kernel's target.
+constexpr uint8_t kSortPairs[19][2] = {
+    {0, 1}, {2, 3}, {4, 5}, {6, 7}, {0, 2}, {1, 3}, {4, 6},
+    {5, 7}, {1, 2}, {5, 6}, {0, 4}, {1, 5}, {2, 6}, {3, 7},
+    {2, 4}, {3, 5}, {1, 2}, {3, 4}, {5, 6}};
+
+// Writes the fifth smallest of the eight |slots| for each of the first
+// |count| lanes to |out|. The slots are kBatch lanes long, so kernels may
+// run past |count| up to their vector width.
+using MedianFn = void (*)(const uint16_t (*slots)[kBatch], size_t count,
+                          uint16_t *out);
+
+void MedianScalar(const uint16_t (*slots)[kBatch], size_t count,
+                  uint16_t *out) {
+  for (size_t i = 0; i < count; i++) {
+    uint16_t v[BadPixelMap::kNeighbours];
+    for (size_t s = 0; s < BadPixelMap::kNeighbours; s++) v[s] = slots[s][i];
+    for (const auto &pair : kSortPairs) {
+      const uint16_t low = std::min(v[pair[0]], v[pair[1]]);
+      v[pair[1]] = std::max(v[pair[0]], v[pair[1]]);
+      v[pair[0]] = low;
+    }
+    out[i] = v[4];
+  }
+}
+
+#if defined(UVC_ARCH_X86)
+// SSSE3 has no unsigned 16-bit min/max; the signed ones order values with
+// the top bit flipped the same way.
+UVC_TARGET_SSSE3 void MedianSsse3(const uint16_t (*slots)[kBatch],
+                                  size_t count, uint16_t *out) {
+  const __m128i bias = _mm_set1_epi16(static_cast<int16_t>(0x8000));
+  for (size_t i = 0; i < count; i += 8) {
+    __m128i v[BadPixelMap::kNeighbours];
+    for (size_t s = 0; s < BadPixelMap::kNeighbours; s++) {
+      v[s] = _mm_xor_si128(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(slots[s] + i)),
+          bias);
+    }
+    for (const auto &pair : kSortPairs) {
+      const __m128i low = _mm_min_epi16(v[pair[0]], v[pair[1]]);
+      v[pair[1]] = _mm_max_epi16(v[pair[0]], v[pair[1]]);
+      v[pair[0]] = low;
+    }
+    alignas(16) uint16_t median[8];
+    _mm_store_si128(reinterpret_cast<__m128i *>(median),
+                    _mm_xor_si128(v[4], bias));
+    std::memcpy(out + i, median, std::min<size_t>(count - i, 8) * 2);
+  }
+}
+
+UVC_TARGET_AVX2 void MedianAvx2(const uint16_t (*slots)[kBatch], size_t count,
+                                uint16_t *out) {
+  for (size_t i = 0; i < count; i += 16) {
+    __m256i v[BadPixelMap::kNeighbours];
+    for (size_t s = 0; s < BadPixelMap::kNeighbours; s++) {
+      v[s] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(slots[s] + i));
+    }
+    for (const auto &pair : kSortPairs) {
+      const __m256i low = _mm256_min_epu16(v[pair[0]], v[pair[1]]);
+      v[pair[1]] = _mm256_max_epu16(v[pair[0]], v[pair[1]]);
+      v[pair[0]] = low;
+    }
+    alignas(32) uint16_t median[16];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(median), v[4]);
+    std::memcpy(out + i, median, std::min<size_t>(count - i, 16) * 2);
+  }
+}
+#endif  // UVC_ARCH_X86
+
+#if defined(UVC_ARCH_NEON)
+void MedianNeon(const uint16_t (*slots)[kBatch], size_t count, uint16_t *out) {
+  for (size_t i = 0; i < count; i += 8) {
+    uint16x8_t v[BadPixelMap::kNeighbours];
+    for (size_t s = 0; s < BadPixelMap::kNeighbours; s++) {
+      v[s] = vld1q_u16(slots[s] + i);
+    }
+    for (const auto &pair : kSortPairs) {
+      const uint16x8_t low = vminq_u16(v[pair[0]], v[pair[1]]);
+      v[pair[1]] = vmaxq_u16(v[pair[0]], v[pair[1]]);
+      v[pair[0]] = low;
+    }
+    uint16_t median[8];
+    vst1q_u16(median, v[4]);
+    std::memcpy(out + i, median, std::min<size_t>(count - i, 8) * 2);
+  }
+}
+#endif  // UVC_ARCH_NEON
+
+MedianFn SelectMedianFn(SimdLevel level) {
+  switch (level) {
+#if defined(UVC_ARCH_X86)
+    case SimdLevel::kAvx2:
+      return MedianAvx2;
+    case SimdLevel::kSsse3:
+      return MedianSsse3;
+#endif
+#if defined(UVC_ARCH_NEON)
+    case SimdLevel::kNeon:
+      return MedianNeon;
+#endif
+    default:
+      return MedianScalar;
+  }
+}
+
+// The upper median of |values|, reordering them.
+float UpperMedian(float *values, size_t count) {
+  std::nth_element(values, values + count / 2, values + count);
+  return values[count / 2];
+}
+
+}  // namespace
+
+BadPixelMap::BadPixelMap(uint32_t width, uint32_t height,
+                         std::vector<uint32_t> indices)
+    : width_(width), height_(height), indices_(std::move(indices)) {
+  const uint64_t pixels = static_cast<uint64_t>(width_) * height_;
+  indices_.erase(std::remove_if(indices_.begin(), indices_.end(),
+                                [pixels](uint32_t i) { return i >= pixels; }),
+                 indices_.end());
+  std::sort(indices_.begin(), indices_.end());
+  indices_.erase(std::unique(indices_.begin(), indices_.end()),
+                 indices_.end());
+
+  // Nearest ring first; the 5x5 ring only for pixels with no good pixel
+  // next to them, edge-adjacent positions before the corners.
+  static constexpr int8_t kRing1[8][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1},
+                                          {-1, -1}, {1, -1}, {-1, 1}, {1, 1}};
+  static constexpr int8_t kRing2[16][2] = {
+      {-2, 0},  {2, 0},  {0, -2},  {0, 2},  {-2, -1}, {2, -1},
+      {-2, 1},  {2, 1},  {-1, -2}, {1, -2}, {-1, 2},  {1, 2},
+      {-2, -2}, {2, -2}, {-2, 2},  {2, 2}};
+  neighbours_.resize(indices_.size() * kNeighbours * 2);
+  for (size_t b = 0; b < indices_.size(); b++) {
+    const int64_t x = indices_[b] % width_;
+    const int64_t y = indices_[b] / width_;
+    int8_t *slots = neighbours_.data() + b * kNeighbours * 2;
+    size_t good = 0;
+    auto collect = [&](const int8_t (*ring)[2], size_t size) {
+      for (size_t i = 0; i < size && good < kNeighbours; i++) {
+        const int64_t nx = x + ring[i][0];
+        const int64_t ny = y + ring[i][1];
+        if (nx < 0 || ny < 0 || nx >= width_ || ny >= height_ ||
+            Contains(static_cast<uint32_t>(nx), static_cast<uint32_t>(ny))) {
+          continue;
+        }
+        slots[good * 2] = ring[i][0];
+        slots[good * 2 + 1] = ring[i][1];
+        good++;
+      }
+    };
+    collect(kRing1, 8);
+    if (good == 0) collect(kRing2, 16);
+    if (good == 0) {
+      // Deep inside a cluster: the pixel gathers itself and keeps its count.
+      std::fill(slots, slots + kNeighbours * 2, 0);
+      continue;
+    }
+    // With p pads, ceil(p/2) low and floor(p/2) high leave the upper median
+    // of the good neighbours fifth.
+    const size_t pads = kNeighbours - good;
+    for (size_t i = 0; i < pads; i++) {
+      slots[(good + i) * 2] = i < (pads + 1) / 2 ? kPadLow : kPadHigh;
+      slots[(good + i) * 2 + 1] = 0;
+    }
+  }
+}
+
+bool BadPixelMap::Contains(uint32_t x, uint32_t y) const {
+  return std::binary_search(indices_.begin(), indices_.end(),
+                            y * width_ + x);
+}
+
+void BadPixelMap::Apply(uint16_t *frame, size_t stride_pixels) const {
+  const MedianFn median = SelectMedianFn(GetSimdLevel());
+  alignas(32) uint16_t slots[kNeighbours][kBatch];
+  alignas(32) uint16_t replaced[kBatch];
+  for (size_t begin = 0; begin < indices_.size(); begin += kBatch) {
+    const size_t count = std::min(kBatch, indices_.size() - begin);
+    for (size_t i = 0; i < count; i++) {
+      const size_t b = begin + i;
+      const uint16_t *pixel = frame + indices_[b] / width_ * stride_pixels +
+                              indices_[b] % width_;
+      const int8_t *n = neighbours_.data() + b * kNeighbours * 2;
+      for (size_t s = 0; s < kNeighbours; s++) {
+        const int8_t dx = n[s * 2];
+        const int8_t dy = n[s * 2 + 1];
+        slots[s][i] =
+            dx == kPadLow    ? 0
+            : dx == kPadHigh ? 65535
+                             : pixel[static_cast<ptrdiff_t>(dy) *
+                                         static_cast<ptrdiff_t>(stride_pixels) +
+                                     dx];
+      }
+    }
+    // Good neighbours only, so nothing gathered depends on a replacement.
+    median(slots, count, replaced);
+    for (size_t i = 0; i < count; i++) {
+      const uint32_t index = indices_[begin + i];
+      frame[index / width_ * stride_pixels + index % width_] = replaced[i];
+    }
+  }
+}
+
+std::shared_ptr<const BadPixelMap> BadPixelMap::Load(const std::string &path,
+                                                     std::string *error) {
+  std::ifstream file(std::filesystem::u8path(path), std::ios::binary);
+  if (!file) {
+    *error = "OPEN_FAILED: " + path;
+    return nullptr;
+  }
+  BadPixelFileHeader header;
+  if (!file.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+    *error = "INVALID_FILE: truncated header";
+    return nullptr;
+  }
+  if (std::memcmp(header.magic, kBadPixelMagic, sizeof(kBadPixelMagic)) != 0 ||
+      header.version != kBadPixelVersion) {
+    *error = "INVALID_FILE: not a version " +
+             std::to_string(kBadPixelVersion) + " bad-pixel map";
+    return nullptr;
+  }
+  const uint64_t pixels = static_cast<uint64_t>(header.width) * header.height;
+  if (pixels == 0 || header.count > pixels) {
+    *error = "INVALID_FILE: bad size";
+    return nullptr;
+  }
+  std::vector<uint32_t> indices(header.count);
+  if (!file.read(reinterpret_cast<char *>(indices.data()),
+                 static_cast<std::streamsize>(indices.size() * 4))) {
+    *error = "INVALID_FILE: truncated index list";
+    return nullptr;
+  }
+  for (size_t i = 0; i < indices.size(); i++) {
+    if (indices[i] >= pixels || (i > 0 && indices[i] <= indices[i - 1])) {
+      *error = "INVALID_FILE: index list out of order";
+      return nullptr;
+    }
+  }
+  return std::make_shared<const BadPixelMap>(header.width, header.height,
+                                             std::move(indices));
+}
+
+bool BadPixelMap::Save(const std::string &path) const {
+  BadPixelFileHeader header = {};
+  std::memcpy(header.magic, kBadPixelMagic, sizeof(kBadPixelMagic));
+  header.version = kBadPixelVersion;
+  header.width = width_;
+  header.height = height_;
+  header.count = static_cast<uint32_t>(indices_.size());
+
+  const std::filesystem::path target = std::filesystem::u8path(path);
+  std::filesystem::path temporary = target;
+  temporary += ".part";
+  std::error_code error;
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(indices_.data()),
+               static_cast<std::streamsize>(indices_.size() * 4));
+    file.close();
+    if (!file) {
+      std::filesystem::remove(temporary, error);
+      return false;
+    }
+  }
+  std::filesystem::rename(temporary, target, error);
+  if (error) {
+    std::filesystem::remove(temporary, error);
+    return false;
+  }
+  return true;
+}
+
+BadPixelDetector::BadPixelDetector(uint32_t width, uint32_t height)
+    : width_(width),
+      height_(height),
+      sums_(static_cast<size_t>(width) * height, 0),
+      min_(sums_.size(), 65535),
+      max_(sums_.size(), 0) {}
+
+void BadPixelDetector::Add(const uint16_t *frame, size_t stride_pixels) {
+  // A local width, so the stores below cannot change the loop bound and
+  // the loop vectorizes.
+  const size_t width = width_;
+  for (size_t y = 0; y < height_; y++) {
+    const uint16_t *row = frame + y * stride_pixels;
+    uint32_t *sums = sums_.data() + y * width;
+    uint16_t *min = min_.data() + y * width;
+    uint16_t *max = max_.data() + y * width;
+    for (size_t x = 0; x < width; x++) {
+      sums[x] += row[x];
+      min[x] = std::min(min[x], row[x]);
+      max[x] = std::max(max[x], row[x]);
+    }
+  }
+  frames_++;
+}
+
+std::vector<uint32_t> BadPixelDetector::Detect(float k_sigma) const {
+  std::vector<uint32_t> bad;
+  if (frames_ == 0) return bad;
+  const size_t pixels = sums_.size();
+  const float scale = 1.0f / static_cast<float>(frames_);
+  std::vector<float> mean(pixels);
+  for (size_t i = 0; i < pixels; i++) mean[i] = sums_[i] * scale;
+
+  std::vector<float> residual(pixels);
+  for (size_t y = 0; y < height_; y++) {
+    for (size_t x = 0; x < width_; x++) {
+      float around[8];
+      size_t count = 0;
+      for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+          const int64_t nx = static_cast<int64_t>(x) + dx;
+          const int64_t ny = static_cast<int64_t>(y) + dy;
+          if ((dx == 0 && dy == 0) || nx < 0 || ny < 0 || nx >= width_ ||
+              ny >= height_) {
+            continue;
+          }
+          around[count++] = mean[ny * width_ + nx];
+        }
+      }
+      const size_t i = y * width_ + x;
+      residual[i] = count > 0 ? mean[i] - UpperMedian(around, count) : 0.0f;
+    }
+  }
+
+  // 1.4826 MAD is the sigma of normally distributed residuals, and barely
+  // moves for the few outliers being looked for.
+  std::vector<float> deviation(pixels);
+  for (size_t i = 0; i < pixels; i++) deviation[i] = std::fabs(residual[i]);
+  const float sigma = std::max(
+      1.4826f * UpperMedian(deviation.data(), pixels), kMinSigma);
+  const float limit = k_sigma * sigma;
+  for (size_t i = 0; i < pixels; i++) {
+    const bool stuck = frames_ >= 2 && min_[i] == max_[i];
+    if (stuck || std::fabs(residual[i]) > limit) {
+      bad.push_back(static_cast<uint32_t>(i));
+    }
+  }
+  return bad;
+}
+
+std::string BadPixelMapFileName(const std::string &device_key) {
+  // Long enough for a Windows symbolic link, whose instance part carries
+  // the serial number.
+  constexpr size_t kMaxKey = 160;
+  std::string name = "badpixels-";
+  for (size_t i = 0; i < device_key.size() && i < kMaxKey; i++) {
+    const char c = device_key[i];
+    if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-' ||
+        c == '.') {
+      name += c;
+    } else if (c >= 'A' && c <= 'Z') {
+      // Windows device paths differ in case between APIs.
+      name += static_cast<char>(c - 'A' + 'a');
+    } else {
+      name += '_';
+    }
+  }
+  return name + ".uvcbpm";
+}
+
+BadPixelCorrector::~BadPixelCorrector() {
+  // Every accepted scan hears back, even one that never got its frames.
+  Reset();
+  {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    if (pending_scan_) FinishScan(std::move(pending_scan_), "SCAN_STOPPED");
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    changed_.notify_all();
+  }
+  if (thread_.joinable()) thread_.join();
+}
+
+void BadPixelCorrector::SetEnabled(bool enabled) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  pending_enabled_ = enabled;
+  config_dirty_.store(true, std::memory_order_release);
+}
+
+bool BadPixelCorrector::enabled() const {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return pending_enabled_;
+}
+
+void BadPixelCorrector::SetMap(std::shared_ptr<const BadPixelMap> map) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  pending_map_ = std::move(map);
+  config_dirty_.store(true, std::memory_order_release);
+}
+
+std::shared_ptr<const BadPixelMap> BadPixelCorrector::map() const {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return pending_map_;
+}
+
+bool BadPixelCorrector::LoadMap(const std::string &path, std::string *error) {
+  std::shared_ptr<const BadPixelMap> map = BadPixelMap::Load(path, error);
+  if (!map) return false;
+  SetMap(std::move(map));
+  return true;
+}
+
+bool BadPixelCorrector::Scan(size_t frames, float k_sigma, uint32_t width,
+                             uint32_t height, std::string path,
+                             Callback done) {
+  if (frames == 0 || frames > kMaxScanFrames || !(k_sigma > 0) ||
+      width == 0 || height == 0) {
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (busy_ || stopping_) return false;
+    busy_ = true;
+  }
+  // Allocated here, so the capture thread only accumulates.
+  auto scan = std::make_unique<Scanning>();
+  scan->frames = frames;
+  scan->k_sigma = k_sigma;
+  scan->path = std::move(path);
+  scan->detector = std::make_unique<BadPixelDetector>(width, height);
+  scan->width = width;
+  scan->height = height;
+  scan->done = std::move(done);
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  pending_scan_ = std::move(scan);
+  config_dirty_.store(true, std::memory_order_release);
+  return true;
+}
+
+void BadPixelCorrector::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  changed_.wait(lock, [this] { return !busy_ && jobs_.empty(); });
+}
+
+void BadPixelCorrector::Reset() {
+  if (scan_) FinishScan(std::move(scan_), "SCAN_STOPPED");
+}
+
+void BadPixelCorrector::FinishScan(std::unique_ptr<Scanning> scan,
+                                   std::string error) {
+  std::shared_ptr<Scanning> finished = std::move(scan);
+  std::lock_guard<std::mutex> lock(mutex_);
+  jobs_.push_back([this, finished, error = std::move(error)] {
+    const int64_t start = NowNs();
+    BadPixelResult result;
+    result.error = error;
+    result.frames = finished->detector->frames();
+    if (error.empty()) {
+      auto map = std::make_shared<const BadPixelMap>(
+          finished->width, finished->height,
+          finished->detector->Detect(finished->k_sigma));
+      result.count = map->size();
+      if (!finished->path.empty() && !map->Save(finished->path)) {
+        result.error = "WRITE_FAILED: " + finished->path;
+      } else {
+        SetMap(std::move(map));
+        result.ok = true;
+        result.path = finished->path;
+      }
+    }
+    finished->detector.reset();
+    result.detect_ns = NowNs() - start;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      busy_ = false;
+    }
+    if (finished->done) finished->done(result);
+  });
+  // Started on first use: most sessions load a saved map instead.
+  if (!thread_.joinable()) thread_ = std::thread([this] { Work(); });
+  changed_.notify_all();
+}
+
+void BadPixelCorrector::Work() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    changed_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+    // Queued jobs are finished even when stopping.
+    if (jobs_.empty()) return;
+    std::function<void()> job = std::move(jobs_.front());
+    lock.unlock();
+    job();
+    lock.lock();
+    // Popped only now, so Flush() waits for the job to finish.
+    jobs_.pop_front();
+    changed_.notify_all();
+  }
+}
+
+void BadPixelCorrector::Process(uint16_t *frame, size_t stride_pixels,
+                                size_t width, size_t height) {
+  if (config_dirty_.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    enabled_ = pending_enabled_;
+    map_ = pending_map_;
+    if (pending_scan_) scan_ = std::move(pending_scan_);
+    config_dirty_.store(false, std::memory_order_relaxed);
+  }
+
+  if (scan_) {
+    if (scan_->width != width || scan_->height != height) {
+      FinishScan(std::move(scan_), "SIZE_CHANGED");
+    } else {
+      scan_->detector->Add(frame, stride_pixels);
+      if (scan_->detector->frames() == scan_->frames) {
+        FinishScan(std::move(scan_), std::string());
+      }
+    }
+  }
+
+  const BadPixelMap *map = map_.get();
+  if (!enabled_ || map == nullptr || map->width() != width ||
+      map->height() != height) {
+    return;
+  }
+  map->Apply(frame, stride_pixels);
+}
+
+}  // namespace uvc
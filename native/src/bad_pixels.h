@@ -0,0 +1,212 @@
+#ifndef UVC_BAD_PIXELS_H_
+#define UVC_BAD_PIXELS_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace uvc {
+
+// On-disk layout of a bad-pixel map (.uvcbpm): this header, then |count|
+// uint32 pixel indices (y * width + x) in ascending order. All fields are
+// little-endian.
+struct BadPixelFileHeader {
+  char magic[8];  // kBadPixelMagic.
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t count;
+};
+static_assert(sizeof(BadPixelFileHeader) == 24, "Bad-pixel header layout");
+
+extern const char kBadPixelMagic[8];
+constexpr uint32_t kBadPixelVersion = 1;
+
+// The dead, stuck and outlying pixels of one sensor, as a sorted index list.
+//
+// Each bad pixel is replaced by the median of up to eight good neighbours,
+// chosen once when the map is built: the 3x3 ring, or the 5x5 ring for a
+// pixel inside a cluster. Replacing touches only the listed pixels, so its
+// cost grows with the number of bad pixels rather than with the frame.
+// Immutable once built; shared through a shared_ptr like NucTables.
+class BadPixelMap {
+ public:
+  // Indices out of range are dropped and the rest sorted.
+  BadPixelMap(uint32_t width, uint32_t height, std::vector<uint32_t> indices);
+  BadPixelMap(const BadPixelMap &) = delete;
+  BadPixelMap &operator=(const BadPixelMap &) = delete;
+
+  // Reads the map saved at |path| (UTF-8). Returns null and sets |error| if
+  // the file is missing, truncated, or not a version this code reads.
+  static std::shared_ptr<const BadPixelMap> Load(const std::string &path,
+                                                 std::string *error);
+
+  // Writes the map to |path| through a temporary file next to it.
+  bool Save(const std::string &path) const;
+
+  uint32_t width() const { return width_; }
+  uint32_t height() const { return height_; }
+  const std::vector<uint32_t> &indices() const { return indices_; }
+  size_t size() const { return indices_.size(); }
+  bool Contains(uint32_t x, uint32_t y) const;
+
+  // Replaces the bad pixels of |frame|, which must be width() x height().
+  void Apply(uint16_t *frame, size_t stride_pixels) const;
+
+  // Neighbours gathered per bad pixel.
+  static constexpr size_t kNeighbours = 8;
+
+ private:
+  uint32_t width_;
+  uint32_t height_;
+  std::vector<uint32_t> indices_;
+  // kNeighbours (dx, dy) pairs per bad pixel. Slots without a good
+  // neighbour hold kPadLow or kPadHigh in dx, which gather as 0 and 65535
+  // and are balanced so the fifth smallest of the eight is the median of
+  // the real neighbours.
+  std::vector<int8_t> neighbours_;
+};
+
+// Collects frames for bad-pixel detection. Each Add() costs a pass over the
+// frame; Detect() is heavier and meant for a background thread.
+class BadPixelDetector {
+ public:
+  BadPixelDetector(uint32_t width, uint32_t height);
+
+  void Add(const uint16_t *frame, size_t stride_pixels);
+  size_t frames() const { return frames_; }
+
+  // Flags pixels that never changed over the frames (with at least two of
+  // them) and pixels whose mean stands more than |k_sigma| robust sigmas
+  // off the median of its neighbours' means. The sigma is estimated from
+  // the whole frame's residuals, so a hot object's edges are not flagged
+  // while a single pixel well off its surroundings is.
+  std::vector<uint32_t> Detect(float k_sigma) const;
+
+ private:
+  uint32_t width_;
+  uint32_t height_;
+  size_t frames_ = 0;
+  std::vector<uint32_t> sums_;
+  std::vector<uint16_t> min_;
+  std::vector<uint16_t> max_;
+};
+
+// File name of the saved map of the device identified by |device_key| (a
+// serial number, or whatever identifies the device best), with characters
+// that are not portable in file names replaced.
+std::string BadPixelMapFileName(const std::string &device_key);
+
+struct BadPixelResult {
+  bool ok = false;
+  // Why it failed, e.g. "SIZE_CHANGED"; empty on success.
+  std::string error;
+  // The file the map was saved to, if any.
+  std::string path;
+  size_t frames = 0;
+  // Bad pixels found.
+  size_t count = 0;
+  // Detection on the background thread.
+  int64_t detect_ns = 0;
+};
+
+// Bad-pixel replacement for raw 16-bit frames, with detection from the
+// live preview.
+//
+// Scan() has Process() feed the next frames to a BadPixelDetector; a
+// thread of the corrector's own then detects the bad pixels, saves the map
+// and hands it to SetMap(). A new map is picked up by the next Process()
+// call. Frames are fed before replacement, so a rescan finds the pixels the
+// current map already hides.
+//
+// Process() must be called from one thread, and Reset() only while it is
+// not running; the other methods may be called from any thread. Callbacks
+// run on the detection thread.
+class BadPixelCorrector {
+ public:
+  using Callback = std::function<void(const BadPixelResult &result)>;
+
+  static constexpr size_t kMaxScanFrames = 1024;
+
+  BadPixelCorrector() = default;
+  ~BadPixelCorrector();
+  BadPixelCorrector(const BadPixelCorrector &) = delete;
+  BadPixelCorrector &operator=(const BadPixelCorrector &) = delete;
+
+  void SetEnabled(bool enabled);
+  bool enabled() const;
+
+  // Replaces the map from the next frame on; null removes it. A map of
+  // another size than the frames leaves them unchanged.
+  void SetMap(std::shared_ptr<const BadPixelMap> map);
+  std::shared_ptr<const BadPixelMap> map() const;
+  // Loads a map saved by Scan() and sets it.
+  bool LoadMap(const std::string &path, std::string *error);
+
+  // Scans the next |frames| frames of |width| x |height| with BadPixelDetector
+  // at |k_sigma|, saves the map to |path| unless it is empty, sets it, and
+  // calls |done|. Returns false, and does not call |done|, while another
+  // scan is running or if the arguments are out of range.
+  bool Scan(size_t frames, float k_sigma, uint32_t width, uint32_t height,
+            std::string path, Callback done);
+
+  // Waits until no scan is running.
+  void Flush();
+
+  // Feeds a pending scan, then replaces the bad pixels in place while
+  // enabled.
+  void Process(uint16_t *frame, size_t stride_pixels, size_t width,
+               size_t height);
+
+  // Fails a scan still collecting frames, e.g. when capture stops.
+  void Reset();
+
+ private:
+  struct Scanning {
+    size_t frames = 0;
+    float k_sigma = 0;
+    std::string path;
+    std::unique_ptr<BadPixelDetector> detector;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    Callback done;
+  };
+
+  // Hands |scan| to the detection thread, or fails it with |error| if that
+  // is not empty.
+  void FinishScan(std::unique_ptr<Scanning> scan, std::string error);
+  void Work();
+
+  // Guards the pending settings and scan.
+  mutable std::mutex config_mutex_;
+  bool pending_enabled_ = false;
+  std::shared_ptr<const BadPixelMap> pending_map_;
+  std::unique_ptr<Scanning> pending_scan_;
+  std::atomic<bool> config_dirty_{false};
+
+  // Owned by the Process() thread.
+  bool enabled_ = false;
+  std::shared_ptr<const BadPixelMap> map_;
+  std::unique_ptr<Scanning> scan_;
+
+  // The detection thread.
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::deque<std::function<void()>> jobs_;
+  // A scan is between its call and its callback.
+  bool busy_ = false;
+  bool stopping_ = false;
+  std::thread thread_;
+};
+
+}  // namespace uvc
+
+#endif  // UVC_BAD_PIXELS_H_
@@ -0,0 +1,296 @@
+#include "burst_recorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#include "replay_source.h"
+
+namespace uvc {
+
+namespace {
+
+constexpr size_t kAlignment = 64;
+
+int64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+bool ParseBurstEviction(const std::string &name, BurstEviction *eviction) {
+  if (name == "oldest") {
+    *eviction = BurstEviction::kOldest;
+  } else if (name == "thin") {
+    *eviction = BurstEviction::kThinOlder;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+BurstRecorder::BurstRecorder() = default;
+
+BurstRecorder::~BurstRecorder() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    FreeRingLocked(&lock);
+    stopping_ = true;
+    changed_.notify_all();
+  }
+  if (thread_.joinable()) thread_.join();
+}
+
+bool BurstRecorder::Configure(const SourceMode &mode, size_t budget_bytes,
+                              BurstEviction eviction) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  FreeRingLocked(&lock);
+
+  const size_t row_bytes =
+      static_cast<size_t>(mode.width) * SourceBytesPerPixel(mode.format);
+  const size_t rows = SourceFrameRows(mode.format, mode.height);
+  // Slots start on a cache line, like pooled frames.
+  const size_t frame_bytes =
+      (row_bytes * rows + kAlignment - 1) / kAlignment * kAlignment;
+  if (frame_bytes == 0) return false;
+  const size_t capacity = budget_bytes / frame_bytes;
+  if (capacity < kMinFrames || capacity > UINT32_MAX) return false;
+
+  void *storage = ::operator new(capacity * frame_bytes,
+                                 std::align_val_t(kAlignment), std::nothrow);
+  if (!storage) return false;
+  storage_ = static_cast<uint8_t *>(storage);
+  mode_ = mode;
+  eviction_ = eviction;
+  capacity_ = capacity;
+  frame_bytes_ = frame_bytes;
+  row_bytes_ = row_bytes;
+  rows_ = rows;
+  max_burst_ = capacity - capacity / 4;
+  slots_.assign(capacity, Slot());
+  history_.clear();
+  history_.reserve(capacity);
+  burst_.clear();
+  burst_.reserve(capacity);
+  free_.clear();
+  free_.reserve(capacity);
+  // Popped from the back: slot 0 is used first.
+  for (size_t i = capacity; i > 0; i--) {
+    free_.push_back(static_cast<uint32_t>(i - 1));
+  }
+  thin_cursor_ = 1;
+  stats_ = BurstRecorderStats();
+  stats_.capacity = capacity;
+  stats_.frame_bytes = frame_bytes;
+  return true;
+}
+
+void BurstRecorder::Reset() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  FreeRingLocked(&lock);
+}
+
+bool BurstRecorder::configured() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return storage_ != nullptr;
+}
+
+void BurstRecorder::EndWindow() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (state_ == State::kCollecting) {
+    burst_truncated_ = true;
+    EndBurstLocked();
+  }
+}
+
+void BurstRecorder::FreeRingLocked(std::unique_lock<std::mutex> *lock) {
+  // No more frames arrive for a window still collecting; the writer needs
+  // the ring until it is done.
+  if (state_ == State::kCollecting) {
+    burst_truncated_ = true;
+    EndBurstLocked();
+  }
+  changed_.wait(*lock, [this] { return state_ == State::kIdle; });
+  if (storage_) {
+    ::operator delete(static_cast<void *>(storage_),
+                      std::align_val_t(kAlignment));
+  }
+  storage_ = nullptr;
+  capacity_ = 0;
+  history_.clear();
+  free_.clear();
+  burst_.clear();
+}
+
+bool BurstRecorder::TakeSlotLocked(uint32_t *slot) {
+  if (!free_.empty()) {
+    *slot = free_.back();
+    free_.pop_back();
+    return true;
+  }
+  if (history_.empty()) return false;
+  size_t victim = 0;
+  if (eviction_ == BurstEviction::kThinOlder && history_.size() >= 4) {
+    // Erasing shifts the next frame into the cursor's place, so stepping by
+    // one removes every other frame of the older half per sweep. The
+    // oldest frame is kept: it is what reaches furthest back.
+    if (thin_cursor_ >= history_.size() / 2) thin_cursor_ = 1;
+    victim = thin_cursor_++;
+  }
+  *slot = history_[victim];
+  // No reallocation: only shifts indices within the reserved capacity.
+  history_.erase(history_.begin() + static_cast<ptrdiff_t>(victim));
+  stats_.evicted++;
+  return true;
+}
+
+void BurstRecorder::Record(const SourceFrame &frame) {
+  uint32_t slot = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!storage_) return;
+    if (!TakeSlotLocked(&slot)) {
+      stats_.dropped++;
+      return;
+    }
+  }
+
+  // The slot is in no list while it is filled, so nobody else touches it
+  // and the copy runs without the lock.
+  uint8_t *dst = SlotData(slot);
+  if (frame.stride == static_cast<ptrdiff_t>(row_bytes_)) {
+    std::memcpy(dst, frame.data, row_bytes_ * rows_);
+  } else {
+    for (size_t y = 0; y < rows_; y++) {
+      std::memcpy(dst + y * row_bytes_,
+                  frame.data + static_cast<ptrdiff_t>(y) * frame.stride,
+                  row_bytes_);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  slots_[slot].timestamp = frame.timestamp;
+  stats_.recorded++;
+  if (state_ == State::kCollecting) {
+    const bool room = burst_.size() < max_burst_;
+    if (frame.timestamp <= burst_end_ && room) {
+      burst_.push_back(slot);
+      slot = UINT32_MAX;
+    }
+    if (!room) burst_truncated_ = true;
+    if (frame.timestamp >= burst_end_ || burst_.size() >= max_burst_) {
+      burst_truncated_ |= frame.timestamp < burst_end_;
+      EndBurstLocked();
+    }
+  }
+  if (slot != UINT32_MAX) history_.push_back(slot);
+}
+
+bool BurstRecorder::Trigger(int64_t now, int64_t pre, int64_t post,
+                            std::string path, Callback done) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!storage_ || state_ != State::kIdle || stopping_) return false;
+
+  // The newest frames from |pre| before the trigger move from the history
+  // to the burst, oldest first.
+  const int64_t from = now - std::max<int64_t>(pre, 0);
+  size_t count = 0;
+  while (count < history_.size() && count < max_burst_ &&
+         slots_[history_[history_.size() - 1 - count]].timestamp >= from) {
+    count++;
+  }
+  // Frames of the window that did not fit stay in the history.
+  const bool cut = count < history_.size() &&
+                   slots_[history_[history_.size() - 1 - count]].timestamp >=
+                       from;
+  burst_.assign(history_.end() - static_cast<ptrdiff_t>(count),
+                history_.end());
+  history_.resize(history_.size() - count);
+  if (thin_cursor_ >= history_.size() / 2) thin_cursor_ = 1;
+
+  burst_pre_ = count;
+  burst_trigger_ = now;
+  burst_end_ = now + std::max<int64_t>(post, 0);
+  burst_truncated_ = cut;
+  burst_path_ = std::move(path);
+  burst_done_ = std::move(done);
+  state_ = State::kCollecting;
+  if (post <= 0 || burst_.size() >= max_burst_) {
+    burst_truncated_ |= post > 0;
+    EndBurstLocked();
+  }
+  // Started on first use: most sessions never trigger a burst.
+  if (!thread_.joinable()) thread_ = std::thread([this] { Work(); });
+  return true;
+}
+
+void BurstRecorder::EndBurstLocked() {
+  state_ = State::kWriting;
+  changed_.notify_all();
+}
+
+void BurstRecorder::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  changed_.wait(lock, [this] { return state_ == State::kIdle; });
+}
+
+BurstRecorderStats BurstRecorder::Stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void BurstRecorder::Work() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    changed_.wait(lock,
+                  [this] { return stopping_ || state_ == State::kWriting; });
+    if (state_ != State::kWriting) return;
+
+    // Only this thread changes the burst until it is idle again.
+    BurstResult result;
+    result.path = burst_path_;
+    result.frames = burst_.size();
+    result.pre_frames = burst_pre_;
+    result.truncated = burst_truncated_;
+    if (!burst_.empty()) {
+      result.first_offset = slots_[burst_.front()].timestamp - burst_trigger_;
+      result.last_offset = slots_[burst_.back()].timestamp - burst_trigger_;
+    }
+    const SourceMode mode = mode_;
+    lock.unlock();
+
+    const int64_t start = NowNs();
+    RecordingWriter writer;
+    bool ok = writer.Open(result.path, mode);
+    for (size_t i = 0; i < result.frames; i++) {
+      const uint32_t slot = burst_[i];
+      if (ok) ok = writer.Append(SlotData(slot), row_bytes_);
+      // Recording can use the slot again right away.
+      lock.lock();
+      free_.push_back(slot);
+      lock.unlock();
+    }
+    ok = writer.Close() && ok;
+    result.write_ns = NowNs() - start;
+    result.ok = ok;
+    if (!ok) result.error = "WRITE_FAILED: " + result.path;
+
+    lock.lock();
+    Callback done = std::move(burst_done_);
+    burst_done_ = nullptr;
+    burst_.clear();
+    stats_.bursts++;
+    lock.unlock();
+    if (done) done(result);
+
+    lock.lock();
+    state_ = State::kIdle;
+    changed_.notify_all();
+  }
+}
+
+}  // namespace uvc
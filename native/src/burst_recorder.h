@@ -0,0 +1,167 @@
+#ifndef UVC_BURST_RECORDER_H_
+#define UVC_BURST_RECORDER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame_source.h"
+
+namespace uvc {
+
+// Which recorded frame makes room for a new one once the ring is full.
+enum class BurstEviction {
+  // The oldest: the ring holds the most recent history at the full rate.
+  kOldest,
+  // Every other frame of the older half, sweeping through it: the same
+  // budget reaches further back, at a rate that halves with age.
+  kThinOlder,
+};
+
+// Parses "oldest" or "thin". Returns false for anything else.
+bool ParseBurstEviction(const std::string &name, BurstEviction *eviction);
+
+struct BurstResult {
+  bool ok = false;
+  std::string path;
+  // Why it failed, e.g. "WRITE_FAILED: <path>"; empty on success.
+  std::string error;
+  uint64_t frames = 0;
+  // How many of |frames| were recorded before the trigger.
+  uint64_t pre_frames = 0;
+  // First and last frame relative to the trigger, in 100 ns units.
+  int64_t first_offset = 0;
+  int64_t last_offset = 0;
+  // The window did not fit in the ring, or capture stopped before it was
+  // over, so the burst ends early.
+  bool truncated = false;
+  int64_t write_ns = 0;
+};
+
+struct BurstRecorderStats {
+  size_t capacity = 0;     // Frames the ring holds.
+  size_t frame_bytes = 0;  // Bytes per frame.
+  uint64_t recorded = 0;   // Frames copied into the ring.
+  uint64_t evicted = 0;    // Frames overwritten to make room.
+  // Frames not recorded for lack of a slot. A burst leaves a quarter of
+  // the ring to recording, so this stays 0.
+  uint64_t dropped = 0;
+  uint64_t bursts = 0;  // Bursts written, successfully or not.
+};
+
+// Keeps the last frames a source delivered so that a trigger can save the
+// seconds before it, and the ones after it, as a recording (.uvcrec, see
+// replay_source.h).
+//
+// Configure() allocates one slab for as many frames as fit in the budget;
+// after that Record() only copies pixels into a free or evicted slot and
+// moves indices in vectors whose capacity was reserved up front, so the
+// capture thread never allocates. Trigger() pins the frames of its window
+// instead of copying them, and a writer thread of the recorder's own
+// appends them to the file, handing each slot back as soon as it is
+// written. A burst pins at most three quarters of the ring, so recording
+// carries on into the rest while it is written.
+//
+// Record() is called from the capture thread only; Trigger(), Flush() and
+// Stats() from any thread. Configure() and Reset() must not race Record().
+class BurstRecorder {
+ public:
+  using Callback = std::function<void(const BurstResult &result)>;
+
+  // Rings smaller than this are refused.
+  static constexpr size_t kMinFrames = 8;
+
+  BurstRecorder();
+  ~BurstRecorder();
+  BurstRecorder(const BurstRecorder &) = delete;
+  BurstRecorder &operator=(const BurstRecorder &) = delete;
+
+  // Ends the current burst, if any, and allocates a ring of |mode| frames
+  // within |budget_bytes|. Returns false, leaving the recorder unconfigured,
+  // if |mode| cannot be recorded (kMjpeg), fewer than kMinFrames fit, or the
+  // allocation failed.
+  bool Configure(const SourceMode &mode, size_t budget_bytes,
+                 BurstEviction eviction);
+  // Ends the current burst, if any, and frees the ring.
+  void Reset();
+  bool configured() const;
+
+  // Copies |frame| into the ring. |frame|.timestamp orders the history and
+  // must be on the clock Trigger() is given.
+  void Record(const SourceFrame &frame);
+
+  // Saves the frames recorded from |pre| before |now| up to |post| after
+  // it to |path|, calling |done| on the writer thread once the file is
+  // complete. Returns false, and does not call |done|, if the recorder is
+  // unconfigured or the previous burst is not written yet. Times are in
+  // 100 ns units.
+  bool Trigger(int64_t now, int64_t pre, int64_t post, std::string path,
+               Callback done);
+
+  // Ends a window still collecting frames with those it has, for when
+  // capture stops; the burst is then written as usual.
+  void EndWindow();
+
+  // Waits until no burst is collecting frames or being written. Only
+  // returns once frames up to the end of a pending window were recorded.
+  void Flush();
+
+  BurstRecorderStats Stats() const;
+
+ private:
+  enum class State { kIdle, kCollecting, kWriting };
+
+  struct Slot {
+    int64_t timestamp = 0;
+  };
+
+  // Under |mutex_|.
+  bool TakeSlotLocked(uint32_t *slot);
+  void EndBurstLocked();
+  void FreeRingLocked(std::unique_lock<std::mutex> *lock);
+  uint8_t *SlotData(uint32_t slot) const {
+    return storage_ + static_cast<size_t>(slot) * frame_bytes_;
+  }
+  void Work();
+
+  mutable std::mutex mutex_;
+  std::condition_variable changed_;
+  SourceMode mode_;
+  BurstEviction eviction_ = BurstEviction::kOldest;
+  uint8_t *storage_ = nullptr;
+  size_t capacity_ = 0;
+  size_t frame_bytes_ = 0;
+  size_t row_bytes_ = 0;
+  size_t rows_ = 0;
+  size_t max_burst_ = 0;
+  std::vector<Slot> slots_;
+  // Recorded frames not in a burst, oldest first.
+  std::vector<uint32_t> history_;
+  // Slots never used or handed back by the writer.
+  std::vector<uint32_t> free_;
+  // Next history_ index kThinOlder evicts.
+  size_t thin_cursor_ = 1;
+
+  State state_ = State::kIdle;
+  // The burst's frames in recording order, and what to do with them.
+  std::vector<uint32_t> burst_;
+  size_t burst_pre_ = 0;
+  int64_t burst_trigger_ = 0;
+  int64_t burst_end_ = 0;
+  bool burst_truncated_ = false;
+  std::string burst_path_;
+  Callback burst_done_;
+
+  BurstRecorderStats stats_;
+  bool stopping_ = false;
+  std::thread thread_;
+};
+
+}  // namespace uvc
+
+#endif  // UVC_BURST_RECORDER_H_
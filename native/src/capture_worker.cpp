@@ -0,0 +1,74 @@
+#include "capture_worker.h"
+
+#include <utility>
+
+namespace uvc {
+
+CaptureWorker::~CaptureWorker() {
+  if (running()) {
+    RequestStop();
+    Join();
+  }
+}
+
+bool CaptureWorker::Start(std::function<void()> body,
+                          std::function<void()> wake) {
+  if (running() && !Join(std::chrono::milliseconds(0))) return false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = false;
+    wake_ = std::move(wake);
+  }
+  stop_requested_.store(false, std::memory_order_release);
+  thread_ = std::thread([this, body = std::move(body)] { Run(body); });
+  return true;
+}
+
+void CaptureWorker::Run(const std::function<void()> &body) {
+  body();
+  std::lock_guard<std::mutex> lock(mutex_);
+  finished_ = true;
+  changed_.notify_all();
+}
+
+void CaptureWorker::RequestStop() {
+  std::function<void()> wake;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_requested_.store(true, std::memory_order_release);
+    changed_.notify_all();
+    if (!finished_) wake = wake_;
+  }
+  // Outside the lock: waking may itself wait for the body, e.g. for a
+  // driver call to return.
+  if (wake) wake();
+}
+
+bool CaptureWorker::Join(std::chrono::milliseconds timeout) {
+  if (!running()) return true;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!changed_.wait_for(lock, timeout, [this] { return finished_; })) {
+      return false;
+    }
+  }
+  // The body has returned; only the thread's exit is left to wait for.
+  thread_.join();
+  return true;
+}
+
+void CaptureWorker::Join() {
+  if (running()) thread_.join();
+}
+
+bool CaptureWorker::Stop(std::chrono::milliseconds timeout) {
+  RequestStop();
+  return Join(timeout);
+}
+
+bool CaptureWorker::WaitForStop(std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return changed_.wait_for(lock, timeout, [this] { return stop_requested(); });
+}
+
+}  // namespace uvc
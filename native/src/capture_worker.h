@@ -0,0 +1,81 @@
+#ifndef UVC_CAPTURE_WORKER_H_
+#define UVC_CAPTURE_WORKER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace uvc {
+
+// The thread a capture loop runs on, with an explicit lifecycle:
+//
+//   Start(body, wake)  runs |body| on a new thread
+//   RequestStop()      raises stop_requested() and calls |wake| to unblock a
+//                      read the body may be waiting in
+//   Join(timeout)      waits for |body| to return, for at most |timeout|
+//   Start() again      once joined, e.g. after a resolution change
+//
+// |body| is expected to loop while !stop_requested(). It may also return on
+// its own (end of stream, device error); Join() then succeeds at once.
+//
+// Start(), RequestStop() and Join() are called from the owning thread;
+// stop_requested() and WaitForStop() from the body.
+class CaptureWorker {
+ public:
+  CaptureWorker() = default;
+  // Stops and joins without a deadline: the body may use state the owner is
+  // about to destroy.
+  ~CaptureWorker();
+
+  CaptureWorker(const CaptureWorker &) = delete;
+  CaptureWorker &operator=(const CaptureWorker &) = delete;
+
+  // Starts |body| on a new thread. |wake| (optional) is called by
+  // RequestStop() on the stopping thread; it must make a blocked read in
+  // |body| return, like FrameSource::Interrupt(). Returns false if the
+  // previous run has not finished yet.
+  bool Start(std::function<void()> body, std::function<void()> wake = nullptr);
+
+  // Asks the body to return and wakes it. Does not wait; repeated calls are
+  // harmless.
+  void RequestStop();
+
+  // Waits until the body has returned, then joins the thread. Returns false
+  // if it is still running after |timeout|; the thread is then left alone
+  // and Join() can be called again, e.g. after waking it some other way.
+  bool Join(std::chrono::milliseconds timeout);
+  void Join();
+
+  // RequestStop() followed by Join(|timeout|).
+  bool Stop(std::chrono::milliseconds timeout);
+
+  // Whether a thread was started and not joined yet.
+  bool running() const { return thread_.joinable(); }
+
+  // Body: whether RequestStop() was called for this run.
+  bool stop_requested() const {
+    return stop_requested_.load(std::memory_order_acquire);
+  }
+
+  // Body: sleeps for |timeout| or until RequestStop(), whichever is first,
+  // e.g. between reconnection attempts. Returns stop_requested().
+  bool WaitForStop(std::chrono::milliseconds timeout);
+
+ private:
+  void Run(const std::function<void()> &body);
+
+  std::thread thread_;
+  std::atomic<bool> stop_requested_{false};
+  // Guards the members below; signalled when either changes.
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  bool finished_ = true;
+  std::function<void()> wake_;
+};
+
+}  // namespace uvc
+
+#endif  // UVC_CAPTURE_WORKER_H_
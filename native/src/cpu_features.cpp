@@ -0,0 +1,106 @@
+#include "cpu_features.h"
+
+#include <atomic>
+
+#if defined(UVC_ARCH_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace uvc {
+
+namespace {
+
+#if defined(UVC_ARCH_X86)
+void CpuId(int leaf, int subleaf, unsigned int regs[4]) {
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuidex(info, leaf, subleaf);
+  for (int i = 0; i < 4; i++) regs[i] = static_cast<unsigned int>(info[i]);
+#else
+  __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+unsigned long long ReadXcr0() {
+#if defined(_MSC_VER)
+  return _xgetbv(0);
+#else
+  unsigned int eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+
+SimdLevel DetectX86() {
+  unsigned int regs[4] = {0, 0, 0, 0};
+  CpuId(0, 0, regs);
+  const unsigned int max_leaf = regs[0];
+  if (max_leaf < 1) return SimdLevel::kScalar;
+
+  CpuId(1, 0, regs);
+  const bool ssse3 = (regs[2] & (1u << 9)) != 0;
+  const bool osxsave = (regs[2] & (1u << 27)) != 0;
+  const bool avx = (regs[2] & (1u << 28)) != 0;
+  if (!ssse3) return SimdLevel::kScalar;
+
+  if (max_leaf >= 7 && osxsave && avx) {
+    // XMM and YMM state must both be enabled by the OS.
+    const bool ymm_enabled = (ReadXcr0() & 0x6) == 0x6;
+    CpuId(7, 0, regs);
+    const bool avx2 = (regs[1] & (1u << 5)) != 0;
+    if (ymm_enabled && avx2) return SimdLevel::kAvx2;
+  }
+  return SimdLevel::kSsse3;
+}
+#endif
+
+std::atomic<int> g_max_level{static_cast<int>(SimdLevel::kNeon)};
+
+}  // namespace
+
+SimdLevel DetectSimdLevel() {
+#if defined(UVC_ARCH_X86)
+  static const SimdLevel level = DetectX86();
+  return level;
+#elif defined(UVC_ARCH_NEON)
+  return SimdLevel::kNeon;
+#else
+  return SimdLevel::kScalar;
+#endif
+}
+
+SimdLevel GetSimdLevel() {
+  const SimdLevel detected = DetectSimdLevel();
+  const int cap = g_max_level.load(std::memory_order_relaxed);
+  if (static_cast<int>(detected) <= cap) return detected;
+#if defined(UVC_ARCH_X86)
+  return static_cast<SimdLevel>(cap);
+#else
+  // NEON is the only vector tier on ARM, so any lower cap means scalar.
+  return SimdLevel::kScalar;
+#endif
+}
+
+void SetMaxSimdLevel(SimdLevel level) {
+  g_max_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+const char *SimdLevelName(SimdLevel level) {
+  switch (level) {
+    case SimdLevel::kScalar:
+      return "scalar";
+    case SimdLevel::kSsse3:
+      return "ssse3";
+    case SimdLevel::kAvx2:
+      return "avx2";
+    case SimdLevel::kNeon:
+      return "neon";
+  }
+  return "unknown";
+}
+
+}  // namespace uvc
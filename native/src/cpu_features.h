@@ -0,0 +1,50 @@
+#ifndef UVC_CPU_FEATURES_H_
+#define UVC_CPU_FEATURES_H_
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define UVC_ARCH_X86 1
+#elif defined(_M_ARM64) || defined(__aarch64__) || defined(__ARM_NEON)
+#define UVC_ARCH_NEON 1
+#endif
+
+// Marks a function as compiled for a newer instruction set than the rest of
+// the translation unit. GCC and Clang refuse to inline intrinsics into
+// functions without the matching target; MSVC exposes every intrinsic
+// unconditionally, so the macros expand to nothing there. Functions marked
+// this way must only be called after GetSimdLevel() has confirmed support.
+#if defined(UVC_ARCH_X86) && (defined(__GNUC__) || defined(__clang__))
+#define UVC_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define UVC_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define UVC_TARGET_SSSE3
+#define UVC_TARGET_AVX2
+#endif
+
+namespace uvc {
+
+// Instruction set tiers the frame kernels are specialised for, ordered so
+// that a larger value implies every smaller one on the same architecture.
+enum class SimdLevel {
+  kScalar = 0,
+  kSsse3 = 1,
+  kAvx2 = 2,
+  kNeon = 3,
+};
+
+// Returns the best level supported by both the CPU and the OS (AVX2 also
+// needs the OS to save YMM state). Detection runs once.
+SimdLevel DetectSimdLevel();
+
+// Returns the level kernels should dispatch to: the detected level, lowered
+// by SetMaxSimdLevel() if a cap is in place.
+SimdLevel GetSimdLevel();
+
+// Caps dispatch at |level|. Tests and benchmarks use this to run every
+// kernel variant the machine supports against the scalar reference.
+void SetMaxSimdLevel(SimdLevel level);
+
+const char *SimdLevelName(SimdLevel level);
+
+}  // namespace uvc
+
+#endif  // UVC_CPU_FEATURES_H_
@@ -0,0 +1,42 @@
+#include "device_registry.h"
+
+#include <utility>
+
+namespace uvc {
+
+const DeviceEntry *DeviceSnapshot::Find(const std::string &id) const {
+  for (const DeviceEntry &entry : devices) {
+    if (entry.id == id) return &entry;
+  }
+  return nullptr;
+}
+
+DeviceRegistry::DeviceRegistry(std::unique_ptr<DeviceEnumerator> enumerator)
+    : enumerator_(std::move(enumerator)),
+      snapshot_(std::make_shared<DeviceSnapshot>()) {}
+
+std::shared_ptr<const DeviceSnapshot> DeviceRegistry::Get() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Read before enumerating: an Invalidate() that races with the
+  // enumeration leaves the result stale, not the notification lost.
+  const uint64_t epoch = epoch_.load(std::memory_order_acquire);
+  if (epoch == snapshot_epoch_) return snapshot_;
+
+  auto snapshot = std::make_shared<DeviceSnapshot>();
+  snapshot->generation = enumerations_.load(std::memory_order_relaxed) + 1;
+  snapshot->ok = enumerator_->Enumerate(&snapshot->devices);
+  enumerations_.fetch_add(1, std::memory_order_relaxed);
+  if (snapshot->ok) {
+    snapshot_epoch_ = epoch;
+  } else {
+    snapshot->devices.clear();
+  }
+  snapshot_ = std::move(snapshot);
+  return snapshot_;
+}
+
+void DeviceRegistry::Invalidate() {
+  epoch_.fetch_add(1, std::memory_order_acq_rel);
+}
+
+}  // namespace uvc
@@ -0,0 +1,88 @@
+#ifndef UVC_DEVICE_REGISTRY_H_
+#define UVC_DEVICE_REGISTRY_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace uvc {
+
+// One capture device as listed by the platform.
+struct DeviceEntry {
+  // Friendly name, UTF-8.
+  std::string name;
+  // Stable identity across enumerations: the symbolic link on Windows, the
+  // device path on Linux.
+  std::string id;
+  // Platform object that opens the device (an IMFActivate on Windows),
+  // released with the last snapshot that lists it. May be null.
+  std::shared_ptr<void> handle;
+};
+
+// The devices present at one enumeration. Immutable once published, so a
+// caller can keep using a snapshot, and its handles, while a newer one is
+// being built.
+struct DeviceSnapshot {
+  std::vector<DeviceEntry> devices;
+  // Counts enumerations; changes whenever the list may have.
+  uint64_t generation = 0;
+  // False if the enumeration failed; |devices| is then empty.
+  bool ok = true;
+
+  // Entry with |id|, or null.
+  const DeviceEntry *Find(const std::string &id) const;
+};
+
+// Lists the capture devices present right now. Implemented per platform
+// (Media Foundation, V4L2) and by mocks in tests.
+class DeviceEnumerator {
+ public:
+  virtual ~DeviceEnumerator() = default;
+  // Fills |devices|; false on failure.
+  virtual bool Enumerate(std::vector<DeviceEntry> *devices) = 0;
+};
+
+// Caches the device list between hot-plug notifications.
+//
+// Enumerating is slow (hundreds of microseconds to milliseconds, and it
+// touches drivers), while the list only changes when a device arrives or
+// leaves. Get() enumerates once and then returns the cached snapshot until
+// Invalidate() is called for such a notification; a failed enumeration is
+// retried by the next Get().
+//
+// Get() may be called from any thread; Invalidate() too, including while
+// an enumeration is in progress, in which case the next Get() enumerates
+// again.
+class DeviceRegistry {
+ public:
+  explicit DeviceRegistry(std::unique_ptr<DeviceEnumerator> enumerator);
+
+  DeviceRegistry(const DeviceRegistry &) = delete;
+  DeviceRegistry &operator=(const DeviceRegistry &) = delete;
+
+  std::shared_ptr<const DeviceSnapshot> Get();
+  void Invalidate();
+
+  // Enumerations so far, for tests and stats.
+  uint64_t enumerations() const {
+    return enumerations_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::unique_ptr<DeviceEnumerator> enumerator_;
+  // Bumped by Invalidate(); the snapshot is current while it matches
+  // snapshot_epoch_.
+  std::atomic<uint64_t> epoch_{1};
+  std::atomic<uint64_t> enumerations_{0};
+  // Guards the members below and serialises enumerations.
+  std::mutex mutex_;
+  uint64_t snapshot_epoch_ = 0;
+  std::shared_ptr<const DeviceSnapshot> snapshot_;
+};
+
+}  // namespace uvc
+
+#endif  // UVC_DEVICE_REGISTRY_H_
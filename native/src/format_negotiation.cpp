@@ -0,0 +1,198 @@
+#include "format_negotiation.h"
+
+#include <cmath>
+#include <numeric>
+
+namespace uvc {
+
+const char *VideoSubtypeName(VideoSubtype subtype) {
+  switch (subtype) {
+    case VideoSubtype::kY16:
+      return "Y16";
+    case VideoSubtype::kY14:
+      return "Y14";
+    case VideoSubtype::kNv12:
+      return "NV12";
+    case VideoSubtype::kYuy2:
+      return "YUY2";
+    case VideoSubtype::kUyvy:
+      return "UYVY";
+    case VideoSubtype::kMjpg:
+      return "MJPG";
+    case VideoSubtype::kRgb32:
+      return "RGB32";
+    case VideoSubtype::kUnknown:
+      break;
+  }
+  return "unknown";
+}
+
+FrameRate FrameRate::Reduced() const {
+  if (!known()) return FrameRate();
+  const uint32_t divisor = std::gcd(numerator, denominator);
+  return FrameRate{numerator / divisor, denominator / divisor};
+}
+
+bool operator==(const FrameRate &a, const FrameRate &b) {
+  if (!a.known() || !b.known()) return a.known() == b.known();
+  return static_cast<uint64_t>(a.numerator) * b.denominator ==
+         static_cast<uint64_t>(b.numerator) * a.denominator;
+}
+
+Capability CapabilityForMode(const SourceMode &mode) {
+  Capability capability;
+  switch (mode.format) {
+    case SourcePixelFormat::kBgra32:
+      capability.subtype = VideoSubtype::kRgb32;
+      break;
+    case SourcePixelFormat::kYuyv:
+      capability.subtype = VideoSubtype::kYuy2;
+      break;
+    case SourcePixelFormat::kGray16:
+      capability.subtype =
+          mode.bit_depth <= 14 ? VideoSubtype::kY14 : VideoSubtype::kY16;
+      break;
+    case SourcePixelFormat::kUyvy:
+      capability.subtype = VideoSubtype::kUyvy;
+      break;
+    case SourcePixelFormat::kNv12:
+      capability.subtype = VideoSubtype::kNv12;
+      break;
+    case SourcePixelFormat::kMjpeg:
+      capability.subtype = VideoSubtype::kMjpg;
+      break;
+  }
+  capability.width = mode.width;
+  capability.height = mode.height;
+  capability.rate = FrameRate{mode.fps_numerator, mode.fps_denominator};
+  return capability;
+}
+
+bool CapabilityIndex::Add(const Capability &capability) {
+  const FrameRate rate = capability.rate.Reduced();
+  if (!keys_
+           .emplace(capability.subtype, capability.width, capability.height,
+                    rate.numerator, rate.denominator)
+           .second) {
+    return false;
+  }
+  capabilities_.push_back(capability);
+  return true;
+}
+
+std::vector<std::pair<uint32_t, uint32_t>> CapabilityIndex::Sizes() const {
+  std::vector<std::pair<uint32_t, uint32_t>> sizes;
+  std::set<std::pair<uint32_t, uint32_t>> seen;
+  for (const Capability &capability : capabilities_) {
+    const std::pair<uint32_t, uint32_t> size(capability.width,
+                                             capability.height);
+    if (seen.insert(size).second) sizes.push_back(size);
+  }
+  return sizes;
+}
+
+int FormatCost(VideoSubtype subtype, FormatPath path) {
+  switch (path) {
+    case FormatPath::kRaw:
+      // YUY2 carrying counts needs its bytes reassembled.
+      return subtype == VideoSubtype::kYuy2 ? 1 : 0;
+    case FormatPath::kDirect:
+      switch (subtype) {
+        case VideoSubtype::kRgb32:
+          return 1;
+        case VideoSubtype::kNv12:
+        case VideoSubtype::kYuy2:
+        case VideoSubtype::kUyvy:
+          return 2;
+        case VideoSubtype::kMjpg:
+          return 3;
+        default:
+          return 5;
+      }
+    case FormatPath::kProcessor:
+      return 4;
+  }
+  return 5;
+}
+
+namespace {
+
+bool IsRawSubtype(VideoSubtype subtype) {
+  return subtype == VideoSubtype::kY16 || subtype == VideoSubtype::kY14;
+}
+
+// The path |capability| would take for |request|; false if it cannot be
+// shown at all.
+bool PathFor(const Capability &capability, const FormatRequest &request,
+             FormatPath *path) {
+  if (request.raw) {
+    const bool raw_yuy2 =
+        request.raw_yuy2 && capability.subtype == VideoSubtype::kYuy2;
+    if (!IsRawSubtype(capability.subtype) && !raw_yuy2) return false;
+    *path = FormatPath::kRaw;
+    return true;
+  }
+  // Counts need AGC; colour converters would show garbage.
+  if (IsRawSubtype(capability.subtype)) return false;
+  if ((request.direct_subtypes & SubtypeBit(capability.subtype)) != 0) {
+    *path = FormatPath::kDirect;
+    return true;
+  }
+  if (request.processor && capability.subtype != VideoSubtype::kUnknown) {
+    *path = FormatPath::kProcessor;
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+bool NegotiateFormat(const CapabilityIndex &index, const FormatRequest &request,
+                     NegotiatedFormat *result) {
+  // Compared lexicographically, larger is better.
+  using Key = std::tuple<bool, bool, int, uint64_t, double>;
+  const bool any_size = request.width == 0 || request.height == 0;
+  const bool any_rate = !request.rate.known();
+  bool found = false;
+  Key best{};
+  for (const Capability &capability : index.capabilities()) {
+    FormatPath path;
+    if (!PathFor(capability, request, &path)) continue;
+    const bool size_match = any_size || (capability.width == request.width &&
+                                         capability.height == request.height);
+    const bool rate_match = any_rate || capability.rate == request.rate;
+    const double fps = capability.rate.ToDouble();
+    const double rate_score =
+        any_rate ? fps : -std::fabs(fps - request.rate.ToDouble());
+    const Key key{size_match, rate_match, -FormatCost(capability.subtype, path),
+                  static_cast<uint64_t>(capability.width) * capability.height,
+                  rate_score};
+    if (!found || key > best) {
+      found = true;
+      best = key;
+      result->native = capability;
+      result->path = path;
+    }
+  }
+  return found;
+}
+
+bool NegotiatePreviewFormat(const CapabilityIndex &index,
+                            const FormatRequest &request,
+                            NegotiatedFormat *result) {
+  NegotiatedFormat raw;
+  const bool have_raw = request.raw && NegotiateFormat(index, request, &raw);
+  const bool any_size = request.width == 0 || request.height == 0;
+  if (have_raw && (any_size || (raw.native.width == request.width &&
+                                raw.native.height == request.height))) {
+    *result = raw;
+    return true;
+  }
+  FormatRequest colour = request;
+  colour.raw = false;
+  if (NegotiateFormat(index, colour, result)) return true;
+  if (have_raw) *result = raw;
+  return have_raw;
+}
+
+}  // namespace uvc
@@ -0,0 +1,151 @@
+#ifndef UVC_FORMAT_NEGOTIATION_H_
+#define UVC_FORMAT_NEGOTIATION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "frame_source.h"
+
+namespace uvc {
+
+// Native pixel formats cameras offer, independent of the platform's GUID or
+// fourcc for them.
+enum class VideoSubtype {
+  kUnknown,
+  kY16,    // 16-bit radiometric counts.
+  kY14,    // 14-bit counts in 16-bit words.
+  kNv12,   // 4:2:0, Y plane then interleaved UV.
+  kYuy2,   // Packed 4:2:2 Y0 U Y1 V; a raw 16-bit transport on some cores.
+  kUyvy,   // Packed 4:2:2 U Y0 V Y1.
+  kMjpg,   // Motion JPEG.
+  kRgb32,  // B, G, R, X bytes.
+};
+
+// Short name for results sent to Dart: "Y16", "NV12", "MJPG", ...
+const char *VideoSubtypeName(VideoSubtype subtype);
+
+constexpr uint32_t SubtypeBit(VideoSubtype subtype) {
+  return 1u << static_cast<unsigned>(subtype);
+}
+
+// An exact frame rate, e.g. 30000/1001. 0/1 when unknown.
+struct FrameRate {
+  uint32_t numerator = 0;
+  uint32_t denominator = 1;
+
+  bool known() const { return numerator != 0 && denominator != 0; }
+  double ToDouble() const {
+    return known() ? static_cast<double>(numerator) / denominator : 0.0;
+  }
+  // Lowest terms, so that 60/1 and 120/2 compare equal.
+  FrameRate Reduced() const;
+};
+
+bool operator==(const FrameRate &a, const FrameRate &b);
+inline bool operator!=(const FrameRate &a, const FrameRate &b) {
+  return !(a == b);
+}
+
+// One native media type of a camera.
+struct Capability {
+  VideoSubtype subtype = VideoSubtype::kUnknown;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  FrameRate rate;
+  // The platform's handle for selecting it again, e.g. the index passed to
+  // IMFSourceReader::GetNativeMediaType.
+  uint32_t native_index = 0;
+};
+
+// The single capability of a source with a fixed |mode|, such as a virtual
+// camera.
+Capability CapabilityForMode(const SourceMode &mode);
+
+// The distinct capabilities of a camera, keyed by (subtype, width, height,
+// exact frame rate). Cameras commonly list the same mode several times
+// (once per colour space or stream), which this folds in O(log n) per type.
+class CapabilityIndex {
+ public:
+  // Adds |capability| unless one with the same key is present; the first
+  // one listed is kept. Returns whether it was added.
+  bool Add(const Capability &capability);
+
+  // In the order first listed, which is the camera's order of preference.
+  const std::vector<Capability> &capabilities() const { return capabilities_; }
+  bool empty() const { return capabilities_.empty(); }
+  size_t size() const { return capabilities_.size(); }
+
+  // Distinct frame sizes, in the order first listed.
+  std::vector<std::pair<uint32_t, uint32_t>> Sizes() const;
+
+ private:
+  using Key = std::tuple<VideoSubtype, uint32_t, uint32_t, uint32_t, uint32_t>;
+  std::vector<Capability> capabilities_;
+  std::set<Key> keys_;
+};
+
+// How frames of the chosen type reach the display.
+enum class FormatPath {
+  // 16-bit counts, unpacked and rendered through AGC and a palette.
+  kRaw,
+  // Converted to RGBA by the capture loop itself.
+  kDirect,
+  // Converted to RGB32 by the platform (the Media Foundation video
+  // processor) before the capture loop sees it.
+  kProcessor,
+};
+
+struct FormatRequest {
+  // 0 x 0 = any size.
+  uint32_t width = 0;
+  uint32_t height = 0;
+  // Unknown = any rate.
+  FrameRate rate;
+  // Only raw 16-bit types qualify: Y16 and Y14, then YUY2 as a transport
+  // if |raw_yuy2|.
+  bool raw = false;
+  // Whether this camera's YUY2 carries 16-bit counts, as on some thermal
+  // cores. Colour webcams offer YUY2 too and their pixels would show as
+  // noise, so only the caller can say; otherwise YUY2 is a colour type.
+  bool raw_yuy2 = false;
+  // Colour subtypes the capture loop converts itself (SubtypeBit mask).
+  uint32_t direct_subtypes = 0;
+  // Whether the platform can convert any other colour type to RGB32.
+  bool processor = false;
+};
+
+struct NegotiatedFormat {
+  Capability native;
+  FormatPath path = FormatPath::kDirect;
+};
+
+// Conversion work per frame for |subtype| on |path|, lower is cheaper:
+// raw Y16/Y14 < direct RGB32 < direct NV12/YUY2/UYVY < MJPG < processor
+// RGB32.
+int FormatCost(VideoSubtype subtype, FormatPath path);
+
+// Picks the native type to open for |request|. Ranked, in order:
+//   1. the requested size (any, if none was requested),
+//   2. the exact requested frame rate (any, if none was requested),
+//   3. the least conversion work, see FormatCost(),
+//   4. the larger frame,
+//   5. the requested rate's nearest neighbour, or else the highest rate.
+// Ties keep the type listed first. Returns false if no type qualifies,
+// e.g. a raw request on a camera without raw types.
+bool NegotiateFormat(const CapabilityIndex &index, const FormatRequest &request,
+                     NegotiatedFormat *result);
+
+// NegotiateFormat() as a preview uses it: with |request|.raw, a raw type at
+// the requested size, else a colour type, else a raw type of another size.
+// Without |request|.raw, colour types only.
+bool NegotiatePreviewFormat(const CapabilityIndex &index,
+                            const FormatRequest &request,
+                            NegotiatedFormat *result);
+
+}  // namespace uvc
+
+#endif  // UVC_FORMAT_NEGOTIATION_H_
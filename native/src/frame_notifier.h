@@ -0,0 +1,47 @@
+#ifndef UVC_FRAME_NOTIFIER_H_
+#define UVC_FRAME_NOTIFIER_H_
+
+#include <atomic>
+
+namespace uvc {
+
+// Coalesces "new frame available" notifications to the Flutter engine.
+//
+// Marking a texture available once per captured frame floods the engine when
+// the camera runs faster than the display: every notification schedules a
+// copy, and all but the last are wasted. With this, at most one notification
+// is outstanding. The producer notifies only if the engine has copied since
+// the previous notification. Frames published in between still replace the
+// newest value in the TripleBuffer and are picked up by the pending copy.
+//
+// Publish() and Pending() belong to the capture thread, Consume() to the
+// raster thread; neither side waits.
+class FrameNotifier {
+ public:
+  // Producer, after publishing a frame: true if the engine must be told,
+  // false if a notification is already outstanding.
+  bool Publish() {
+    return !pending_.exchange(true, std::memory_order_acq_rel);
+  }
+
+  // Producer: whether the engine has not yet copied since the last
+  // notification, i.e. a converted frame is still waiting to be shown.
+  bool Pending() const { return pending_.load(std::memory_order_acquire); }
+
+  // Consumer: call before taking the newest frame out of the TripleBuffer.
+  // A frame published after this point is notified again, so none is left
+  // unannounced; one published before it is taken by this copy. (An
+  // exchange rather than a store, so that it acquires that publication.)
+  void Consume() { pending_.exchange(false, std::memory_order_acq_rel); }
+
+  // Either side, while the other is stopped: forget an outstanding
+  // notification, e.g. when a new texture is registered.
+  void Reset() { pending_.store(false, std::memory_order_release); }
+
+ private:
+  std::atomic<bool> pending_{false};
+};
+
+}  // namespace uvc
+
+#endif  // UVC_FRAME_NOTIFIER_H_
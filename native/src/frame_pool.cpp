@@ -0,0 +1,263 @@
+#include "frame_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace uvc {
+
+size_t BytesPerPixel(PixelFormat format) {
+  switch (format) {
+    case PixelFormat::kRgba8:
+      return 4;
+    case PixelFormat::kGray16:
+      return 2;
+  }
+  return 4;
+}
+
+namespace detail {
+
+// Header placed in front of the pixels of every slab, padded so the payload
+// starts on a FramePool::kAlignment boundary.
+struct FrameSlab {
+  std::atomic<uint32_t> refs{0};
+  FramePoolCore *core = nullptr;
+  uint64_t generation = 0;
+  FrameFormat format;
+  FrameInfo info;
+  uint8_t *data = nullptr;
+  size_t size = 0;
+};
+
+constexpr size_t kSlabHeaderSize =
+    (sizeof(FrameSlab) + FramePool::kAlignment - 1) &
+    ~(FramePool::kAlignment - 1);
+
+// State shared by a FramePool and every slab it allocated. It is destroyed by
+// whichever of them goes last: the pool on destruction, or the release of the
+// last outstanding frame.
+class FramePoolCore {
+ public:
+  bool Configure(const FrameFormat &format, size_t preallocate,
+                 size_t max_slabs) {
+    std::vector<FrameSlab *> stale;
+    bool ok = true;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      generation_++;
+      format_ = format;
+      max_slabs_ = std::max(max_slabs, preallocate);
+      stale.swap(free_);
+      slab_count_ = 0;
+      in_use_ = 0;
+      high_water_ = 0;
+      allocations_ = 0;
+      exhausted_ = 0;
+      free_.reserve(max_slabs_);
+      for (size_t i = 0; i < preallocate; i++) {
+        FrameSlab *slab = AllocateLocked();
+        if (!slab) {
+          ok = false;
+          break;
+        }
+        free_.push_back(slab);
+      }
+    }
+    for (FrameSlab *slab : stale) FreeSlab(slab);
+    return ok;
+  }
+
+  FrameRef Acquire() {
+    FrameSlab *slab = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (format_.ByteSize() == 0) {
+        exhausted_++;
+        return FrameRef();
+      }
+      if (!free_.empty()) {
+        slab = free_.back();
+        free_.pop_back();
+      } else if (slab_count_ < max_slabs_) {
+        slab = AllocateLocked();
+      }
+      if (!slab) {
+        exhausted_++;
+        return FrameRef();
+      }
+      in_use_++;
+      high_water_ = std::max(high_water_, in_use_);
+    }
+    slab->info = FrameInfo();
+    slab->refs.store(1, std::memory_order_relaxed);
+    return FrameRef(slab);
+  }
+
+  // Called when the last handle to |slab| is dropped.
+  void Release(FrameSlab *slab) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (slab->generation == generation_) {
+        in_use_--;
+        if (pool_alive_) {
+          // Never reallocates: capacity was reserved for max_slabs_.
+          free_.push_back(slab);
+          return;
+        }
+        slab_count_--;
+      }
+    }
+    FreeSlab(slab);
+  }
+
+  // Called by ~FramePool. Frees idle slabs now; slabs still referenced are
+  // freed by Release().
+  void Detach() {
+    std::vector<FrameSlab *> idle;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pool_alive_ = false;
+      idle.swap(free_);
+      slab_count_ -= idle.size();
+    }
+    for (FrameSlab *slab : idle) FreeSlab(slab);
+    DropOwner();
+  }
+
+  FrameFormat format() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return format_;
+  }
+
+  FramePoolStats Stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FramePoolStats stats;
+    stats.slab_bytes = format_.ByteSize();
+    stats.slab_count = slab_count_;
+    stats.in_use = in_use_;
+    stats.high_water = high_water_;
+    stats.allocations = allocations_;
+    stats.exhausted = exhausted_;
+    return stats;
+  }
+
+ private:
+  FrameSlab *AllocateLocked() {
+    const size_t size = format_.ByteSize();
+    void *memory =
+        ::operator new(kSlabHeaderSize + size,
+                       std::align_val_t(FramePool::kAlignment), std::nothrow);
+    if (!memory) return nullptr;
+    FrameSlab *slab = new (memory) FrameSlab();
+    slab->core = this;
+    slab->generation = generation_;
+    slab->format = format_;
+    slab->data = static_cast<uint8_t *>(memory) + kSlabHeaderSize;
+    slab->size = size;
+    owners_.fetch_add(1, std::memory_order_relaxed);
+    slab_count_++;
+    allocations_++;
+    return slab;
+  }
+
+  void FreeSlab(FrameSlab *slab) {
+    slab->~FrameSlab();
+    ::operator delete(static_cast<void *>(slab),
+                      std::align_val_t(FramePool::kAlignment));
+    DropOwner();
+  }
+
+  void DropOwner() {
+    if (owners_.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+  }
+
+  mutable std::mutex mutex_;
+  // One reference for the pool plus one per allocated slab.
+  std::atomic<size_t> owners_{1};
+  bool pool_alive_ = true;
+  uint64_t generation_ = 0;
+  FrameFormat format_;
+  size_t max_slabs_ = 0;
+  std::vector<FrameSlab *> free_;
+  size_t slab_count_ = 0;
+  size_t in_use_ = 0;
+  size_t high_water_ = 0;
+  uint64_t allocations_ = 0;
+  uint64_t exhausted_ = 0;
+};
+
+}  // namespace detail
+
+FrameRef::FrameRef(const FrameRef &other) : slab_(other.slab_) {
+  if (slab_) slab_->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+FrameRef::FrameRef(FrameRef &&other) noexcept : slab_(other.slab_) {
+  other.slab_ = nullptr;
+}
+
+FrameRef &FrameRef::operator=(const FrameRef &other) {
+  if (this != &other) {
+    FrameRef copy(other);
+    std::swap(slab_, copy.slab_);
+  }
+  return *this;
+}
+
+FrameRef &FrameRef::operator=(FrameRef &&other) noexcept {
+  if (this != &other) {
+    reset();
+    slab_ = other.slab_;
+    other.slab_ = nullptr;
+  }
+  return *this;
+}
+
+FrameRef::~FrameRef() { reset(); }
+
+void FrameRef::reset() {
+  if (!slab_) return;
+  detail::FrameSlab *slab = slab_;
+  slab_ = nullptr;
+  if (slab->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    slab->core->Release(slab);
+  }
+}
+
+uint8_t *FrameRef::data() const { return slab_ ? slab_->data : nullptr; }
+
+size_t FrameRef::size() const { return slab_ ? slab_->size : 0; }
+
+const FrameFormat &FrameRef::format() const {
+  static const FrameFormat kEmpty;
+  return slab_ ? slab_->format : kEmpty;
+}
+
+FrameInfo &FrameRef::info() const {
+  static FrameInfo empty;
+  return slab_ ? slab_->info : empty;
+}
+
+uint32_t FrameRef::use_count() const {
+  return slab_ ? slab_->refs.load(std::memory_order_relaxed) : 0;
+}
+
+FramePool::FramePool() : core_(new detail::FramePoolCore()) {}
+
+FramePool::~FramePool() { core_->Detach(); }
+
+bool FramePool::Configure(const FrameFormat &format, size_t preallocate,
+                          size_t max_slabs) {
+  return core_->Configure(format, preallocate, max_slabs);
+}
+
+FrameRef FramePool::Acquire() { return core_->Acquire(); }
+
+FrameFormat FramePool::format() const { return core_->format(); }
+
+FramePoolStats FramePool::Stats() const { return core_->Stats(); }
+
+}  // namespace uvc
@@ -0,0 +1,132 @@
+#ifndef UVC_FRAME_POOL_H_
+#define UVC_FRAME_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace uvc {
+
+enum class PixelFormat {
+  kRgba8,
+  // Raw sensor counts, one little-endian uint16_t per pixel.
+  kGray16,
+};
+
+size_t BytesPerPixel(PixelFormat format);
+
+// Layout of a pooled frame. Rows are tightly packed, as required by
+// FlutterDesktopPixelBuffer.
+struct FrameFormat {
+  PixelFormat pixel_format = PixelFormat::kRgba8;
+  uint32_t width = 0;
+  uint32_t height = 0;
+
+  size_t Stride() const { return width * BytesPerPixel(pixel_format); }
+  size_t ByteSize() const { return Stride() * height; }
+
+  bool operator==(const FrameFormat &other) const {
+    return pixel_format == other.pixel_format && width == other.width &&
+           height == other.height;
+  }
+  bool operator!=(const FrameFormat &other) const { return !(*this == other); }
+};
+
+// Per-frame metadata filled in by the producer.
+struct FrameInfo {
+  uint64_t sequence = 0;
+  // Presentation time in 100 ns units, as reported by the capture source.
+  int64_t timestamp = 0;
+  // SteadyNow100ns() when the frame was handed to the texture; 0 before.
+  int64_t published = 0;
+};
+
+struct FramePoolStats {
+  size_t slab_bytes = 0;        // Payload bytes per frame.
+  size_t slab_count = 0;        // Slabs currently allocated.
+  size_t in_use = 0;            // Slabs referenced by at least one handle.
+  size_t high_water = 0;        // Largest in_use since Configure().
+  uint64_t allocations = 0;     // Slab allocations since Configure().
+  uint64_t exhausted = 0;       // Acquire() calls that returned nothing.
+};
+
+namespace detail {
+class FramePoolCore;
+struct FrameSlab;
+}  // namespace detail
+
+// Shared, reference-counted handle to a pooled frame. Copying a handle only
+// bumps an atomic count, so the texture, snapshots and recorders can all hold
+// the same frame without copying pixels. The buffer goes back to its pool
+// when the last handle is dropped, from whichever thread drops it.
+//
+// The pixels are writable through any handle; by convention only the
+// producer that acquired the frame writes, before it shares the handle.
+class FrameRef {
+ public:
+  FrameRef() = default;
+  FrameRef(const FrameRef &other);
+  FrameRef(FrameRef &&other) noexcept;
+  FrameRef &operator=(const FrameRef &other);
+  FrameRef &operator=(FrameRef &&other) noexcept;
+  ~FrameRef();
+
+  explicit operator bool() const { return slab_ != nullptr; }
+
+  uint8_t *data() const;
+  size_t size() const;
+  const FrameFormat &format() const;
+  FrameInfo &info() const;
+
+  // Number of handles sharing the frame. Only meaningful for tests and
+  // diagnostics; it can change concurrently.
+  uint32_t use_count() const;
+
+  void reset();
+
+ private:
+  friend class detail::FramePoolCore;
+  explicit FrameRef(detail::FrameSlab *slab) : slab_(slab) {}
+
+  detail::FrameSlab *slab_ = nullptr;
+};
+
+// Recycles 64-byte aligned frame buffers of one negotiated format.
+//
+// Configure() preallocates slabs; after that Acquire() and the release of the
+// last FrameRef only move pointers on a free list whose storage is reserved up
+// front, so steady-state capture does no heap allocation. The pool grows up
+// to |max_slabs| if consumers hold on to frames, and returns an empty handle
+// beyond that so the producer can drop the frame instead of blocking.
+//
+// Thread-safe. Handles may outlive the pool; their slabs are freed when the
+// last one is released.
+class FramePool {
+ public:
+  static constexpr size_t kAlignment = 64;
+
+  FramePool();
+  ~FramePool();
+  FramePool(const FramePool &) = delete;
+  FramePool &operator=(const FramePool &) = delete;
+
+  // Switches to |format|, preallocating |preallocate| slabs and allowing up
+  // to |max_slabs|. Frames of the previous format stay valid for their
+  // holders and are freed rather than recycled when released. Returns false
+  // if the preallocation failed.
+  bool Configure(const FrameFormat &format, size_t preallocate,
+                 size_t max_slabs);
+
+  // Returns an unshared frame of the configured format, or an empty handle if
+  // the pool is unconfigured or exhausted.
+  FrameRef Acquire();
+
+  FrameFormat format() const;
+  FramePoolStats Stats() const;
+
+ private:
+  detail::FramePoolCore *core_;
+};
+
+}  // namespace uvc
+
+#endif  // UVC_FRAME_POOL_H_
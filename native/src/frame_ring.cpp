@@ -0,0 +1,287 @@
+#include "frame_ring.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+namespace uvc {
+
+const char kFrameRingMagic[8] = {'U', 'V', 'C', 'R', 'I', 'N', 'G', '\0'};
+
+// The Dart reader hard-codes these offsets.
+static_assert(sizeof(std::atomic<uint64_t>) == 8 &&
+                  sizeof(std::atomic<uint32_t>) == 4,
+              "atomics must be plain words");
+static_assert(offsetof(FrameRingHeader, version) == 8, "layout");
+static_assert(offsetof(FrameRingHeader, slot_count) == 12, "layout");
+static_assert(offsetof(FrameRingHeader, slot_bytes) == 16, "layout");
+static_assert(offsetof(FrameRingHeader, slots_offset) == 20, "layout");
+static_assert(offsetof(FrameRingHeader, pixel_format) == 24, "layout");
+static_assert(offsetof(FrameRingHeader, width) == 28, "layout");
+static_assert(offsetof(FrameRingHeader, height) == 32, "layout");
+static_assert(offsetof(FrameRingHeader, stride) == 36, "layout");
+static_assert(offsetof(FrameRingHeader, written) == 40, "layout");
+static_assert(offsetof(FrameRingHeader, closed) == 48, "layout");
+static_assert(sizeof(FrameRingHeader) == 64, "layout");
+static_assert(offsetof(FrameRingSlot, frame) == 8, "layout");
+static_assert(offsetof(FrameRingSlot, sequence) == 16, "layout");
+static_assert(offsetof(FrameRingSlot, timestamp) == 24, "layout");
+static_assert(sizeof(FrameRingSlot) == 64, "layout");
+// ...and UvcFrameRingRead()'s return codes.
+static_assert(static_cast<int>(FrameRingRead::kOk) == 0 &&
+                  static_cast<int>(FrameRingRead::kEmpty) == 1 &&
+                  static_cast<int>(FrameRingRead::kOverwritten) == 2 &&
+                  static_cast<int>(FrameRingRead::kInvalid) == 3,
+              "FrameRingRead codes");
+
+namespace {
+
+constexpr size_t kAlignment = 64;
+
+size_t AlignUp(size_t value) {
+  return (value + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+// Averages |factor| x |factor| blocks of |Channels|-channel pixels, rounding
+// to nearest. Rows past the last whole block are dropped.
+template <typename T, int Channels>
+void DownscaleBox(const T *src, size_t src_stride, T *dst, uint32_t width,
+                  uint32_t height, uint32_t factor) {
+  const uint32_t area = factor * factor;
+  for (uint32_t y = 0; y < height; y++) {
+    const T *rows = src + static_cast<size_t>(y) * factor * src_stride;
+    T *out = dst + static_cast<size_t>(y) * width * Channels;
+    for (uint32_t x = 0; x < width; x++) {
+      uint32_t sums[Channels] = {};
+      for (uint32_t dy = 0; dy < factor; dy++) {
+        const T *in = rows + dy * src_stride + x * factor * Channels;
+        for (uint32_t dx = 0; dx < factor * Channels; dx++) {
+          sums[dx % Channels] += in[dx];
+        }
+      }
+      for (int c = 0; c < Channels; c++) {
+        out[x * Channels + c] = static_cast<T>((sums[c] + area / 2) / area);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+bool FrameRing::Configure(const FrameRingConfig &config,
+                          const FrameFormat &source) {
+  const uint32_t factor = config.downscale;
+  if (!config.enabled || config.slots == 0 || config.slots > kMaxSlots ||
+      (factor != 1 && factor != 2 && factor != 4) ||
+      source.width / factor == 0 || source.height / factor == 0) {
+    Close();
+    return false;
+  }
+  SetDecimation(config.every_nth, config.max_fps);
+  offered_ = 0;
+  wrote_any_ = false;
+
+  const uint32_t width = source.width / factor;
+  const uint32_t height = source.height / factor;
+  const uint32_t stride =
+      width * static_cast<uint32_t>(BytesPerPixel(source.pixel_format));
+  const size_t slot_bytes =
+      AlignUp(sizeof(FrameRingSlot) + static_cast<size_t>(stride) * height);
+  const size_t slots_offset = AlignUp(sizeof(FrameRingHeader));
+  // The last ring is reopened if it has the same layout, so a reader that
+  // kept its address carries on.
+  if (!blocks_.empty()) {
+    FrameRingHeader *last =
+        reinterpret_cast<FrameRingHeader *>(blocks_.back().base);
+    if (last->slot_count == config.slots && last->width == width &&
+        last->height == height &&
+        last->pixel_format == static_cast<uint32_t>(source.pixel_format)) {
+      active_ = blocks_.back().base;
+      active_size_ = blocks_.back().size;
+      source_ = source;
+      downscale_ = factor;
+      last->closed.store(0, std::memory_order_release);
+      return true;
+    }
+  }
+  Close();
+
+  // Lay the ring out in the smallest block that fits, other than the one
+  // just closed; failing that, allocate one, freeing the least recently
+  // used if there are kMaxBlocks already.
+  const size_t size = slots_offset + slot_bytes * config.slots;
+  size_t reuse = blocks_.size();
+  for (size_t b = 0; b + 1 < blocks_.size(); b++) {
+    if (blocks_[b].size >= size &&
+        (reuse == blocks_.size() || blocks_[b].size < blocks_[reuse].size)) {
+      reuse = b;
+    }
+  }
+  Block block;
+  if (reuse < blocks_.size()) {
+    block = std::move(blocks_[reuse]);
+    blocks_.erase(blocks_.begin() + static_cast<ptrdiff_t>(reuse));
+    std::memset(block.base, 0, block.size);
+  } else {
+    if (blocks_.size() >= kMaxBlocks) blocks_.erase(blocks_.begin());
+    block.size = size;
+    block.storage.reset(new (std::nothrow) uint8_t[block.size + kAlignment]());
+    if (!block.storage) return false;
+    block.base =
+        block.storage.get() +
+        (kAlignment - reinterpret_cast<uintptr_t>(block.storage.get()) %
+                          kAlignment) %
+            kAlignment;
+  }
+  FrameRingHeader *h = new (block.base) FrameRingHeader();
+  std::memcpy(h->magic, kFrameRingMagic, sizeof(h->magic));
+  h->version = kFrameRingVersion;
+  h->slot_count = config.slots;
+  h->slot_bytes = static_cast<uint32_t>(slot_bytes);
+  h->slots_offset = static_cast<uint32_t>(slots_offset);
+  h->pixel_format = static_cast<uint32_t>(source.pixel_format);
+  h->width = width;
+  h->height = height;
+  h->stride = stride;
+  h->written.store(0, std::memory_order_relaxed);
+  h->closed.store(0, std::memory_order_relaxed);
+  for (uint32_t s = 0; s < config.slots; s++) {
+    new (block.base + slots_offset + s * slot_bytes) FrameRingSlot();
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+  active_ = block.base;
+  active_size_ = block.size;
+  source_ = source;
+  downscale_ = factor;
+  blocks_.push_back(std::move(block));
+  return true;
+}
+
+void FrameRing::Close() {
+  if (active_) header()->closed.store(1, std::memory_order_release);
+  active_ = nullptr;
+}
+
+void FrameRing::SetDecimation(uint32_t every_nth, double max_fps) {
+  every_nth_.store(every_nth > 0 ? every_nth : 1, std::memory_order_relaxed);
+  min_interval_.store(max_fps > 0 ? std::llround(1e7 / max_fps) : 0,
+                      std::memory_order_relaxed);
+}
+
+bool FrameRing::Write(const FrameRef &frame) {
+  if (!active_ || !frame || frame.format() != source_) return false;
+  if (offered_++ % every_nth_.load(std::memory_order_relaxed) != 0) {
+    return false;
+  }
+  const int64_t interval = min_interval_.load(std::memory_order_relaxed);
+  const int64_t timestamp = frame.info().timestamp;
+  if (interval > 0) {
+    // Source timestamps jitter and round; a frame up to an eighth of the
+    // interval early is on time.
+    const bool scheduled = wrote_any_ && interval == due_interval_;
+    if (scheduled && timestamp + interval / 8 < next_due_) return false;
+    // Keep the cadence unless the source fell a whole interval behind it.
+    next_due_ = (scheduled && timestamp - next_due_ < interval ? next_due_
+                                                               : timestamp) +
+                interval;
+  }
+  due_interval_ = interval;
+  wrote_any_ = true;
+
+  FrameRingHeader *h = header();
+  const uint64_t index = h->written.load(std::memory_order_relaxed);
+  uint8_t *slot_base =
+      active_ + h->slots_offset +
+      static_cast<size_t>(index % h->slot_count) * h->slot_bytes;
+  FrameRingSlot *slot = reinterpret_cast<FrameRingSlot *>(slot_base);
+  const uint64_t generation = slot->generation.load(std::memory_order_relaxed);
+  slot->generation.store(generation + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot->frame = index;
+  slot->sequence = frame.info().sequence;
+  slot->timestamp = timestamp;
+  uint8_t *pixels = slot_base + sizeof(FrameRingSlot);
+  if (downscale_ == 1) {
+    std::memcpy(pixels, frame.data(), static_cast<size_t>(h->stride) * h->height);
+  } else if (source_.pixel_format == PixelFormat::kGray16) {
+    DownscaleBox<uint16_t, 1>(reinterpret_cast<const uint16_t *>(frame.data()),
+                              source_.width,
+                              reinterpret_cast<uint16_t *>(pixels), h->width,
+                              h->height, downscale_);
+  } else {
+    DownscaleBox<uint8_t, 4>(frame.data(), source_.Stride(), pixels, h->width,
+                             h->height, downscale_);
+  }
+
+  slot->generation.store(generation + 2, std::memory_order_release);
+  h->written.store(index + 1, std::memory_order_release);
+  return true;
+}
+
+bool FrameRingReader::valid() const {
+  return memory_ != nullptr &&
+         std::memcmp(header().magic, kFrameRingMagic, sizeof(kFrameRingMagic)) ==
+             0 &&
+         header().version == kFrameRingVersion;
+}
+
+FrameRingRead FrameRingReader::Read(uint64_t index, FrameRingFrame *out) const {
+  if (!valid()) return FrameRingRead::kInvalid;
+  out->pixels.resize(static_cast<size_t>(header().stride) * header().height);
+  return Read(index, out->pixels.data(), out->pixels.size(), out);
+}
+
+FrameRingRead FrameRingReader::Read(uint64_t index, uint8_t *pixels,
+                                    size_t capacity,
+                                    FrameRingFrame *out) const {
+  if (!valid()) return FrameRingRead::kInvalid;
+  const FrameRingHeader &h = header();
+  const size_t bytes = static_cast<size_t>(h.stride) * h.height;
+  if (capacity < bytes) return FrameRingRead::kInvalid;
+  const uint64_t written = this->written();
+  if (index >= written) return FrameRingRead::kEmpty;
+  if (written - index > h.slot_count) return FrameRingRead::kOverwritten;
+
+  const uint8_t *slot_base = memory_ + h.slots_offset +
+                             static_cast<size_t>(index % h.slot_count) *
+                                 h.slot_bytes;
+  const FrameRingSlot *slot =
+      reinterpret_cast<const FrameRingSlot *>(slot_base);
+  const uint64_t before = slot->generation.load(std::memory_order_acquire);
+  if (before % 2 != 0) return FrameRingRead::kOverwritten;
+  out->frame = slot->frame;
+  out->sequence = slot->sequence;
+  out->timestamp = slot->timestamp;
+  std::memcpy(pixels, slot_base + sizeof(FrameRingSlot), bytes);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (slot->generation.load(std::memory_order_relaxed) != before ||
+      out->frame != index) {
+    return FrameRingRead::kOverwritten;
+  }
+  return FrameRingRead::kOk;
+}
+
+FrameRingRead FrameRingReader::ReadLatest(FrameRingFrame *out) const {
+  if (!valid()) return FrameRingRead::kInvalid;
+  const uint64_t written = this->written();
+  if (written == 0) return FrameRingRead::kEmpty;
+  return Read(written - 1, out);
+}
+
+}  // namespace uvc
+
+extern "C" int32_t UvcFrameRingRead(const uint8_t *ring, uint64_t index,
+                                    uint8_t *pixels, uint64_t capacity,
+                                    int64_t *meta) {
+  uvc::FrameRingFrame frame;
+  const uvc::FrameRingRead status = uvc::FrameRingReader(ring).Read(
+      index, pixels, static_cast<size_t>(capacity), &frame);
+  if (status == uvc::FrameRingRead::kOk) {
+    meta[0] = static_cast<int64_t>(frame.frame);
+    meta[1] = static_cast<int64_t>(frame.sequence);
+    meta[2] = frame.timestamp;
+  }
+  return static_cast<int32_t>(status);
+}
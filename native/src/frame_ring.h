@@ -0,0 +1,205 @@
+#ifndef UVC_FRAME_RING_H_
+#define UVC_FRAME_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "frame_pool.h"
+
+namespace uvc {
+
+// Memory layout of a frame ring, read in place by other code in the process
+// (the Dart side maps it with dart:ffi, see lib/camera/frame_ring.dart).
+// Every field is little-endian at a fixed offset; the static_asserts in
+// frame_ring.cpp pin them.
+//
+// The header is followed by |slot_count| slots of |slot_bytes| each, a
+// FrameRingSlot and then the pixels, |stride| bytes per row. Frames are
+// numbered from 0 in the order written; frame n goes to slot
+// n % slot_count.
+struct FrameRingHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t slot_count;
+  uint32_t slot_bytes;
+  // Offset of the first slot from the header.
+  uint32_t slots_offset;
+  // A PixelFormat: 0 RGBA, 1 16-bit counts.
+  uint32_t pixel_format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t stride;
+  // Frames written so far; the newest is written - 1.
+  std::atomic<uint64_t> written;
+  // Set once the runner stops writing to this ring for good, e.g. after a
+  // restart with another layout.
+  std::atomic<uint32_t> closed;
+  uint32_t reserved[3];
+};
+
+// One slot's seqlock. |generation| is odd while the writer fills the slot;
+// a reader that sees the same even generation before and after reading
+// |frame| and the pixels has a consistent copy.
+struct FrameRingSlot {
+  std::atomic<uint64_t> generation;
+  uint64_t frame;
+  uint64_t sequence;
+  // The source timestamp, in 100 ns units.
+  int64_t timestamp;
+  uint64_t reserved[4];
+};
+
+extern const char kFrameRingMagic[8];
+constexpr uint32_t kFrameRingVersion = 1;
+
+struct FrameRingConfig {
+  bool enabled = false;
+  uint32_t slots = 4;
+  // Writes every Nth offered frame...
+  uint32_t every_nth = 1;
+  // ...and then at most this many per second of source time; 0 for any.
+  double max_fps = 0;
+  // Box-filters each frame down by 1, 2 or 4 in both directions.
+  uint32_t downscale = 1;
+  // In raw mode, the 16-bit counts instead of the displayed RGBA.
+  bool raw = false;
+};
+
+// A ring of recent frames in one block of memory that readers in the same
+// process use in place, so frames reach Dart without a channel codec or a
+// copy on the platform thread. The writer copies (and optionally
+// downscales) each kept frame into the next slot under the slot's seqlock;
+// readers never block it, and a reader that falls behind by more than the
+// ring finds its frame overwritten rather than delaying capture.
+//
+// Configure() runs while nothing writes, Write() on one thread at a time;
+// SetDecimation() may be called from any thread.
+class FrameRing {
+ public:
+  static constexpr uint32_t kMaxSlots = 64;
+  // Blocks kept, active and closed.
+  static constexpr size_t kMaxBlocks = 3;
+
+  FrameRing() = default;
+  FrameRing(const FrameRing &) = delete;
+  FrameRing &operator=(const FrameRing &) = delete;
+
+  // Lays out a ring for frames of |source| (RGBA or counts) per |config|.
+  // An unchanged layout keeps the ring, and readers carry on; otherwise the
+  // old ring is closed and the new one laid out in a block retired earlier
+  // that is large enough, or else a new block. The ring just closed is left
+  // alone, so its readers see it closed and can fetch the new one; one
+  // closed before that may be reused or freed, keeping at most kMaxBlocks.
+  // Returns false, leaving no ring active, for a disabled or invalid
+  // |config|.
+  bool Configure(const FrameRingConfig &config, const FrameFormat &source);
+
+  // Stops writing and closes the ring, keeping it mapped.
+  void Close();
+
+  void SetDecimation(uint32_t every_nth, double max_fps);
+
+  // Copies |frame| into the ring unless decimation skips it or it does not
+  // have the configured source format. Returns whether it was written.
+  bool Write(const FrameRef &frame);
+
+  // The active ring, or null.
+  const uint8_t *memory() const { return active_; }
+  size_t size() const { return active_ ? active_size_ : 0; }
+  const FrameFormat &source() const { return source_; }
+  size_t block_count() const { return blocks_.size(); }
+
+ private:
+  struct Block {
+    std::unique_ptr<uint8_t[]> storage;
+    uint8_t *base = nullptr;
+    size_t size = 0;
+  };
+
+  FrameRingHeader *header() const {
+    return reinterpret_cast<FrameRingHeader *>(active_);
+  }
+
+  // From least to most recently used; the last holds the active ring, or
+  // the one closed last.
+  std::vector<Block> blocks_;
+  uint8_t *active_ = nullptr;
+  size_t active_size_ = 0;
+  FrameFormat source_;
+  uint32_t downscale_ = 1;
+
+  std::atomic<uint32_t> every_nth_{1};
+  // Minimum spacing of written frames, in 100 ns units.
+  std::atomic<int64_t> min_interval_{0};
+  // Owned by the writer.
+  uint64_t offered_ = 0;
+  int64_t next_due_ = 0;
+  // The interval next_due_ was scheduled with.
+  int64_t due_interval_ = 0;
+  bool wrote_any_ = false;
+};
+
+enum class FrameRingRead {
+  kOk,
+  // Nothing written yet, or the frame is yet to come.
+  kEmpty,
+  // The frame was overwritten before or while it was read.
+  kOverwritten,
+  // Not a frame ring of this version.
+  kInvalid,
+};
+
+struct FrameRingFrame {
+  uint64_t frame = 0;
+  uint64_t sequence = 0;
+  int64_t timestamp = 0;
+  std::vector<uint8_t> pixels;
+};
+
+// Reads a frame ring under the slots' seqlocks. Needs only the ring's
+// address, so it also serves tests and tools that find the ring by other
+// means; the Dart side reads through UvcFrameRingRead() below.
+class FrameRingReader {
+ public:
+  explicit FrameRingReader(const uint8_t *memory) : memory_(memory) {}
+
+  bool valid() const;
+  const FrameRingHeader &header() const {
+    return *reinterpret_cast<const FrameRingHeader *>(memory_);
+  }
+  uint64_t written() const {
+    return header().written.load(std::memory_order_acquire);
+  }
+  bool closed() const {
+    return header().closed.load(std::memory_order_acquire) != 0;
+  }
+
+  // Copies frame |index| into |out|.
+  FrameRingRead Read(uint64_t index, FrameRingFrame *out) const;
+  // As above, but copies the pixels into |pixels|, which holds |capacity|
+  // bytes, and leaves out->pixels alone. kInvalid if the frame does not fit.
+  FrameRingRead Read(uint64_t index, uint8_t *pixels, size_t capacity,
+                     FrameRingFrame *out) const;
+  // Copies the newest frame into |out|.
+  FrameRingRead ReadLatest(FrameRingFrame *out) const;
+
+ private:
+  const uint8_t *memory_;
+};
+
+}  // namespace uvc
+
+// FrameRingReader::Read() for the Dart reader, which cannot load the ring's
+// words with acquire ordering itself. The runners return this function's
+// address from getFrameRing, and Dart calls it as an ffi leaf call. Copies
+// frame |index| of the ring at |ring| into |pixels| (|capacity| bytes) and
+// its frame number, sequence and timestamp into meta[0..2]. Returns a
+// FrameRingRead.
+extern "C" int32_t UvcFrameRingRead(const uint8_t *ring, uint64_t index,
+                                    uint8_t *pixels, uint64_t capacity,
+                                    int64_t *meta);
+
+#endif  // UVC_FRAME_RING_H_
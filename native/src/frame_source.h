@@ -0,0 +1,92 @@
+#ifndef UVC_FRAME_SOURCE_H_
+#define UVC_FRAME_SOURCE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "raw_convert.h"
+
+namespace uvc {
+
+// Pixel layout of the frames a FrameSource delivers.
+enum class SourcePixelFormat {
+  kBgra32,  // B, G, R, A/X bytes.
+  kYuyv,    // Packed 4:2:2, Y0 U Y1 V.
+  kGray16,  // One little-endian count per pixel; see SourceMode::bit_depth.
+  kUyvy,    // Packed 4:2:2, U Y0 V Y1.
+  // 4:2:0: a plane of Y, then interleaved U V for each 2x2 block. The UV
+  // rows follow the last Y row at the same stride, as in one Media
+  // Foundation buffer.
+  kNv12,
+  // Motion JPEG: each frame is one JPEG of SourceFrame::size bytes, decoded
+  // by MjpegPipeline.
+  kMjpeg,
+};
+
+struct SourceMode {
+  SourcePixelFormat format = SourcePixelFormat::kBgra32;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  // Significant bits of kGray16 counts (8..16).
+  int bit_depth = 8;
+  // Nominal rate; 0/1 when unknown or unpaced.
+  uint32_t fps_numerator = 0;
+  uint32_t fps_denominator = 1;
+};
+
+// How the capture loop unpacks kGray16 frames of |mode|: 14-bit sources get
+// their unused top bits masked off.
+inline RawPacking RawPackingForMode(const SourceMode &mode) {
+  if (mode.format != SourcePixelFormat::kGray16) return RawPacking::kNone;
+  return mode.bit_depth == 14 ? RawPacking::kY14 : RawPacking::kY16;
+}
+
+// A frame on loan from its source, valid until Release() or the next Next().
+struct SourceFrame {
+  const uint8_t *data = nullptr;
+  ptrdiff_t stride = 0;  // Bytes from one row to the next.
+  size_t size = 0;       // Bytes of a compressed (kMjpeg) frame.
+  // Source frame counter. Gaps mean the source dropped frames.
+  uint64_t sequence = 0;
+  // Capture time in 100 ns units on the steady clock (see SteadyNow100ns),
+  // like FrameInfo::timestamp.
+  int64_t timestamp = 0;
+  // Source-specific handle for Release().
+  uint32_t index = 0;
+};
+
+enum class SourceStatus {
+  kFrame,
+  kTimeout,
+  kInterrupted,  // Interrupt() was called.
+  kEnd,          // A finite source ran out of frames.
+  kError,
+};
+
+// Anything the capture loop can pull frames from: a camera, or a virtual
+// camera for testing the pipeline without one.
+//
+// Next() and Release() are called from the capture thread only. Interrupt()
+// may be called from any thread; it makes the pending or the next Next()
+// return kInterrupted, which is how a capture loop is stopped promptly.
+class FrameSource {
+ public:
+  virtual ~FrameSource() = default;
+
+  // The format frames are delivered in. Fixed once Start() succeeded.
+  virtual SourceMode mode() const = 0;
+
+  virtual bool Start() = 0;
+  virtual void Stop() = 0;
+
+  // Waits up to |timeout_ms| (-1 = forever) for the next frame.
+  virtual SourceStatus Next(int timeout_ms, SourceFrame *frame) = 0;
+  // Returns a frame from Next() to the source.
+  virtual void Release(const SourceFrame &frame) = 0;
+
+  virtual void Interrupt() = 0;
+};
+
+}  // namespace uvc
+
+#endif  // UVC_FRAME_SOURCE_H_
@@ -0,0 +1,281 @@
+#include "image_encode.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(UVC_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+namespace uvc {
+
+namespace {
+
+void PutBe32(uint8_t *p, uint32_t value) {
+  p[0] = static_cast<uint8_t>(value >> 24);
+  p[1] = static_cast<uint8_t>(value >> 16);
+  p[2] = static_cast<uint8_t>(value >> 8);
+  p[3] = static_cast<uint8_t>(value);
+}
+
+void AppendLe16(std::vector<uint8_t> *out, uint16_t value) {
+  out->push_back(static_cast<uint8_t>(value));
+  out->push_back(static_cast<uint8_t>(value >> 8));
+}
+
+void AppendLe32(std::vector<uint8_t> *out, uint32_t value) {
+  AppendLe16(out, static_cast<uint16_t>(value));
+  AppendLe16(out, static_cast<uint16_t>(value >> 16));
+}
+
+#if defined(UVC_HAVE_ZLIB)
+uint32_t Crc32(uint32_t crc, const uint8_t *data, size_t size) {
+  // zlib takes uInt lengths.
+  while (size > 0) {
+    const uInt chunk = static_cast<uInt>(std::min<size_t>(size, 1u << 30));
+    crc = static_cast<uint32_t>(crc32(crc, data, chunk));
+    data += chunk;
+    size -= chunk;
+  }
+  return crc;
+}
+#else
+uint32_t Crc32(uint32_t crc, const uint8_t *data, size_t size) {
+  static const struct Table {
+    uint32_t entries[256];
+    Table() {
+      for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+          c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        entries[i] = c;
+      }
+    }
+  } table;
+  crc = ~crc;
+  for (size_t i = 0; i < size; i++) {
+    crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+// Builds a zlib stream of stored (uncompressed) deflate blocks.
+class StoredDeflate {
+ public:
+  explicit StoredDeflate(std::vector<uint8_t> *out) : out_(out) {
+    out_->push_back(0x78);  // 32K window, no dictionary,
+    out_->push_back(0x01);  // fastest level; (0x7801 % 31) == 0.
+  }
+
+  void Write(const uint8_t *data, size_t size) {
+    Adler(data, size);
+    while (size > 0) {
+      const size_t n = std::min(size, kBlockSize - block_.size());
+      block_.insert(block_.end(), data, data + n);
+      data += n;
+      size -= n;
+      if (block_.size() == kBlockSize) EmitBlock(false);
+    }
+  }
+
+  void Finish() {
+    EmitBlock(true);
+    uint8_t adler[4];
+    PutBe32(adler, (b_ << 16) | a_);
+    out_->insert(out_->end(), adler, adler + 4);
+  }
+
+ private:
+  static constexpr size_t kBlockSize = 65535;
+
+  void EmitBlock(bool final) {
+    const uint16_t length = static_cast<uint16_t>(block_.size());
+    out_->push_back(final ? 1 : 0);  // BFINAL, BTYPE 00.
+    AppendLe16(out_, length);
+    AppendLe16(out_, static_cast<uint16_t>(~length));
+    out_->insert(out_->end(), block_.begin(), block_.end());
+    block_.clear();
+  }
+
+  void Adler(const uint8_t *data, size_t size) {
+    while (size > 0) {
+      // Largest run before the sums can overflow 32 bits.
+      const size_t n = std::min<size_t>(size, 5552);
+      for (size_t i = 0; i < n; i++) {
+        a_ += data[i];
+        b_ += a_;
+      }
+      a_ %= 65521;
+      b_ %= 65521;
+      data += n;
+      size -= n;
+    }
+  }
+
+  std::vector<uint8_t> *out_;
+  std::vector<uint8_t> block_;
+  uint32_t a_ = 1;
+  uint32_t b_ = 0;
+};
+#endif
+
+// Appends a chunk header for |size| bytes of |type|; its data follows.
+void BeginChunk(std::vector<uint8_t> *out, const char *type, uint32_t size) {
+  uint8_t header[8];
+  PutBe32(header, size);
+  std::memcpy(header + 4, type, 4);
+  out->insert(out->end(), header, header + 8);
+}
+
+// Appends the CRC of the chunk starting at |start|.
+void EndChunk(std::vector<uint8_t> *out, size_t start) {
+  uint8_t crc[4];
+  PutBe32(crc, Crc32(0, out->data() + start + 4, out->size() - start - 4));
+  out->insert(out->end(), crc, crc + 4);
+}
+
+// Filter type 2 ("up"): each byte minus the byte above it.
+void FilterUp(const uint8_t *row, const uint8_t *above, size_t size,
+              uint8_t *dst) {
+  dst[0] = 2;
+  if (above == nullptr) {
+    std::memcpy(dst + 1, row, size);
+    return;
+  }
+  for (size_t i = 0; i < size; i++) {
+    dst[i + 1] = static_cast<uint8_t>(row[i] - above[i]);
+  }
+}
+
+}  // namespace
+
+bool EncodePng(const uint8_t *rgba, ptrdiff_t stride, uint32_t width,
+               uint32_t height, std::vector<uint8_t> *out) {
+  if (width == 0 || height == 0) return false;
+  static const uint8_t kSignature[8] = {0x89, 'P',  'N',  'G',
+                                        '\r', '\n', 0x1A, '\n'};
+  out->assign(kSignature, kSignature + 8);
+
+  size_t start = out->size();
+  BeginChunk(out, "IHDR", 13);
+  uint8_t ihdr[13];
+  PutBe32(ihdr, width);
+  PutBe32(ihdr + 4, height);
+  ihdr[8] = 8;   // Bit depth.
+  ihdr[9] = 6;   // Truecolour with alpha.
+  ihdr[10] = 0;  // Deflate.
+  ihdr[11] = 0;  // Adaptive filtering.
+  ihdr[12] = 0;  // Not interlaced.
+  out->insert(out->end(), ihdr, ihdr + 13);
+  EndChunk(out, start);
+
+  // The length is patched in once the compressed size is known.
+  start = out->size();
+  BeginChunk(out, "IDAT", 0);
+  const size_t row_size = static_cast<size_t>(width) * 4;
+  std::vector<uint8_t> filtered(row_size + 1);
+#if defined(UVC_HAVE_ZLIB)
+  // Fastest level: for camera frames it gets most of the size reduction at
+  // a fraction of the time of the default.
+  z_stream stream = {};
+  if (deflateInit(&stream, Z_BEST_SPEED) != Z_OK) return false;
+  const size_t raw_size = (row_size + 1) * height;
+  const size_t data_start = out->size();
+  out->resize(data_start +
+              deflateBound(&stream, static_cast<uLong>(raw_size)));
+  stream.next_out = out->data() + data_start;
+  stream.avail_out = static_cast<uInt>(out->size() - data_start);
+  // deflateBound() leaves room for everything, so each call consumes its
+  // whole row.
+  int status = Z_OK;
+  for (uint32_t y = 0; y < height && status == Z_OK; y++) {
+    const uint8_t *row = rgba + stride * static_cast<ptrdiff_t>(y);
+    FilterUp(row, y > 0 ? row - stride : nullptr, row_size, filtered.data());
+    stream.next_in = filtered.data();
+    stream.avail_in = static_cast<uInt>(filtered.size());
+    status = deflate(&stream, y + 1 == height ? Z_FINISH : Z_NO_FLUSH);
+  }
+  const size_t compressed_size = stream.total_out;
+  deflateEnd(&stream);
+  if (status != Z_STREAM_END) return false;
+  out->resize(data_start + compressed_size);
+#else
+  out->reserve(out->size() + (row_size + 1) * height * 65540 / 65535 + 64);
+  StoredDeflate stream(out);
+  for (uint32_t y = 0; y < height; y++) {
+    const uint8_t *row = rgba + stride * static_cast<ptrdiff_t>(y);
+    FilterUp(row, y > 0 ? row - stride : nullptr, row_size, filtered.data());
+    stream.Write(filtered.data(), filtered.size());
+  }
+  stream.Finish();
+#endif
+  PutBe32(out->data() + start, static_cast<uint32_t>(out->size() - start - 8));
+  EndChunk(out, start);
+
+  start = out->size();
+  BeginChunk(out, "IEND", 0);
+  EndChunk(out, start);
+  return true;
+}
+
+bool EncodeTiff16(const uint16_t *pixels, size_t stride_pixels,
+                  uint32_t width, uint32_t height, std::vector<uint8_t> *out) {
+  if (width == 0 || height == 0) return false;
+  struct Entry {
+    uint16_t tag;
+    uint16_t type;  // 3 = SHORT, 4 = LONG.
+    uint32_t value;
+  };
+  constexpr uint32_t kEntryCount = 11;
+  constexpr uint32_t kIfdOffset = 8;
+  constexpr uint32_t kDataOffset = kIfdOffset + 2 + kEntryCount * 12 + 4;
+  const uint32_t data_size = width * height * 2;
+  // Sorted by tag, as TIFF requires.
+  const Entry entries[kEntryCount] = {
+      {256, 4, width},        // ImageWidth
+      {257, 4, height},       // ImageLength
+      {258, 3, 16},           // BitsPerSample
+      {259, 3, 1},            // Compression: none
+      {262, 3, 1},            // PhotometricInterpretation: BlackIsZero
+      {273, 4, kDataOffset},  // StripOffsets
+      {277, 3, 1},            // SamplesPerPixel
+      {278, 4, height},       // RowsPerStrip
+      {279, 4, data_size},    // StripByteCounts
+      {284, 3, 1},            // PlanarConfiguration: chunky
+      {339, 3, 1},            // SampleFormat: unsigned
+  };
+
+  static const uint8_t kHeader[4] = {'I', 'I', 42, 0};
+  out->assign(kHeader, kHeader + 4);
+  out->reserve(kDataOffset + data_size);
+  AppendLe32(out, kIfdOffset);
+  AppendLe16(out, kEntryCount);
+  for (const Entry &entry : entries) {
+    AppendLe16(out, entry.tag);
+    AppendLe16(out, entry.type);
+    AppendLe32(out, 1);  // Count.
+    // A SHORT value sits in the first two bytes of the field.
+    if (entry.type == 3) {
+      AppendLe16(out, static_cast<uint16_t>(entry.value));
+      AppendLe16(out, 0);
+    } else {
+      AppendLe32(out, entry.value);
+    }
+  }
+  AppendLe32(out, 0);  // No further IFD.
+
+  out->resize(kDataOffset + data_size);
+  uint8_t *dst = out->data() + kDataOffset;
+  for (uint32_t y = 0; y < height; y++) {
+    const uint16_t *row = pixels + stride_pixels * y;
+    for (uint32_t x = 0; x < width; x++) {
+      dst[0] = static_cast<uint8_t>(row[x]);
+      dst[1] = static_cast<uint8_t>(row[x] >> 8);
+      dst += 2;
+    }
+  }
+  return true;
+}
+
+}  // namespace uvc
@@ -0,0 +1,28 @@
+#ifndef UVC_IMAGE_ENCODE_H_
+#define UVC_IMAGE_ENCODE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Lossless still-image encoders for snapshots. PNG is compressed with zlib
+// when CMake finds it (UVC_HAVE_ZLIB) and written as stored deflate blocks
+// otherwise: larger, but every viewer still opens it. TIFF is uncompressed.
+
+namespace uvc {
+
+// Encodes |width| x |height| RGBA rows |stride| bytes apart as an 8-bit
+// RGBA PNG into |out|, replacing its contents. Each row uses the "up"
+// filter. Returns false for an empty image.
+bool EncodePng(const uint8_t *rgba, ptrdiff_t stride, uint32_t width,
+               uint32_t height, std::vector<uint8_t> *out);
+
+// Encodes 16-bit grey samples, rows |stride_pixels| apart, as a single-strip
+// little-endian baseline TIFF, so radiometric counts survive unscaled.
+// Returns false for an empty image.
+bool EncodeTiff16(const uint16_t *pixels, size_t stride_pixels,
+                  uint32_t width, uint32_t height, std::vector<uint8_t> *out);
+
+}  // namespace uvc
+
+#endif  // UVC_IMAGE_ENCODE_H_
@@ -0,0 +1,213 @@
+#include "jpeg_codec.h"
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+
+// jpeglib.h expects size_t and FILE to be declared already.
+#include <jpeglib.h>
+
+namespace uvc {
+
+namespace {
+
+// libjpeg reports fatal errors through error_exit, which must not return;
+// it jumps back to the setjmp() in the function that called into libjpeg.
+// Those functions keep no objects with destructors across the call.
+struct ErrorManager {
+  jpeg_error_mgr base;
+  std::jmp_buf jump;
+};
+
+void ErrorExit(j_common_ptr info) {
+  std::longjmp(reinterpret_cast<ErrorManager *>(info->err)->jump, 1);
+}
+
+// Corrupt-data warnings are common on USB (dropped packets); the frame is
+// still shown, so they are not logged either.
+void OutputMessage(j_common_ptr) {}
+
+constexpr int kMaxRowsPerRead = 16;
+
+}  // namespace
+
+int JpegScaleEighths(uint32_t width, uint32_t height, uint32_t target_width,
+                     uint32_t target_height) {
+  if (target_width == 0 || target_height == 0) return 8;
+  for (int eighths = 1; eighths < 8; eighths++) {
+    if (JpegScaledSize(width, eighths) >= target_width &&
+        JpegScaledSize(height, eighths) >= target_height) {
+      return eighths;
+    }
+  }
+  return 8;
+}
+
+uint32_t JpegScaledSize(uint32_t size, int eighths) {
+  return static_cast<uint32_t>(
+      (static_cast<uint64_t>(size) * static_cast<uint32_t>(eighths) + 7) / 8);
+}
+
+struct JpegDecoder::Context {
+  jpeg_decompress_struct info;
+  ErrorManager error;
+};
+
+JpegDecoder::JpegDecoder() : context_(new Context) {
+  context_->info.err = jpeg_std_error(&context_->error.base);
+  context_->error.base.error_exit = ErrorExit;
+  context_->error.base.output_message = OutputMessage;
+  jpeg_create_decompress(&context_->info);
+}
+
+JpegDecoder::~JpegDecoder() {
+  jpeg_destroy_decompress(&context_->info);
+  delete context_;
+}
+
+bool JpegDecoder::ReadSize(const uint8_t *jpeg, size_t size, uint32_t *width,
+                           uint32_t *height) {
+  jpeg_decompress_struct *info = &context_->info;
+  if (setjmp(context_->error.jump)) {
+    jpeg_abort_decompress(info);
+    return false;
+  }
+  jpeg_mem_src(info, jpeg, static_cast<unsigned long>(size));
+  jpeg_read_header(info, TRUE);
+  *width = info->image_width;
+  *height = info->image_height;
+  jpeg_abort_decompress(info);
+  return true;
+}
+
+bool JpegDecoder::Decode(const uint8_t *jpeg, size_t size,
+                         const JpegDecodeOptions &options, uint8_t *dst,
+                         ptrdiff_t dst_stride, uint32_t width,
+                         uint32_t height) {
+  jpeg_decompress_struct *info = &context_->info;
+  JSAMPROW rows[kMaxRowsPerRead];
+  if (setjmp(context_->error.jump)) {
+    jpeg_abort_decompress(info);
+    return false;
+  }
+  jpeg_mem_src(info, jpeg, static_cast<unsigned long>(size));
+  if (jpeg_read_header(info, TRUE) != JPEG_HEADER_OK) {
+    jpeg_abort_decompress(info);
+    return false;
+  }
+  info->out_color_space = JCS_EXT_RGBA;
+  info->scale_num = static_cast<unsigned int>(
+      JpegScaleEighths(info->image_width, info->image_height,
+                       options.target_width, options.target_height));
+  info->scale_denom = 8;
+  info->dct_method = options.fast ? JDCT_IFAST : JDCT_ISLOW;
+  info->do_fancy_upsampling = options.fast ? FALSE : TRUE;
+  jpeg_calc_output_dimensions(info);
+  if (info->output_width != width || info->output_height != height) {
+    jpeg_abort_decompress(info);
+    return false;
+  }
+  jpeg_start_decompress(info);
+  while (info->output_scanline < info->output_height) {
+    const JDIMENSION first = info->output_scanline;
+    const JDIMENSION count =
+        std::min<JDIMENSION>(info->output_height - first, kMaxRowsPerRead);
+    for (JDIMENSION i = 0; i < count; i++) {
+      rows[i] = dst + static_cast<ptrdiff_t>(first + i) * dst_stride;
+    }
+    const JDIMENSION read = jpeg_read_scanlines(info, rows, count);
+    if (options.curve) {
+      for (JDIMENSION i = 0; i < read; i++) {
+        uint8_t *p = rows[i];
+        for (uint32_t x = 0; x < width; x++, p += 4) {
+          p[0] = options.curve[p[0]];
+          p[1] = options.curve[p[1]];
+          p[2] = options.curve[p[2]];
+        }
+      }
+    }
+  }
+  jpeg_finish_decompress(info);
+  return true;
+}
+
+bool EncodeJpeg(const uint8_t *rgba, ptrdiff_t stride, uint32_t width,
+                uint32_t height, int quality, std::vector<uint8_t> *jpeg) {
+  jpeg_compress_struct info;
+  ErrorManager error;
+  unsigned char *buffer = nullptr;
+  unsigned long buffer_size = 0;
+  info.err = jpeg_std_error(&error.base);
+  error.base.error_exit = ErrorExit;
+  if (setjmp(error.jump)) {
+    jpeg_destroy_compress(&info);
+    std::free(buffer);
+    return false;
+  }
+  jpeg_create_compress(&info);
+  jpeg_mem_dest(&info, &buffer, &buffer_size);
+  info.image_width = width;
+  info.image_height = height;
+  info.input_components = 4;
+  info.in_color_space = JCS_EXT_RGBA;
+  jpeg_set_defaults(&info);
+  jpeg_set_quality(&info, quality, TRUE);
+  jpeg_start_compress(&info, TRUE);
+  while (info.next_scanline < height) {
+    JSAMPROW row = const_cast<JSAMPROW>(
+        rgba + static_cast<ptrdiff_t>(info.next_scanline) * stride);
+    jpeg_write_scanlines(&info, &row, 1);
+  }
+  jpeg_finish_compress(&info);
+  jpeg_destroy_compress(&info);
+  jpeg->assign(buffer, buffer + buffer_size);
+  std::free(buffer);
+  return true;
+}
+
+std::vector<std::pair<size_t, size_t>> SplitMjpegStream(const uint8_t *data,
+                                                        size_t size) {
+  std::vector<std::pair<size_t, size_t>> frames;
+  size_t start = 0;
+  bool in_frame = false;
+  size_t i = 0;
+  while (i + 1 < size) {
+    if (data[i] != 0xFF) {
+      i++;
+      continue;
+    }
+    const uint8_t marker = data[i + 1];
+    if (!in_frame) {
+      if (marker == 0xD8) {  // SOI
+        start = i;
+        in_frame = true;
+        i += 2;
+      } else {
+        i++;
+      }
+      continue;
+    }
+    if (marker == 0xD9) {  // EOI
+      frames.emplace_back(start, i + 2 - start);
+      in_frame = false;
+      i += 2;
+    } else if (marker == 0x00 || marker == 0xFF ||
+               (marker >= 0xD0 && marker <= 0xD7)) {
+      // Stuffed byte, fill byte or restart marker inside scan data.
+      i += marker == 0xFF ? 1 : 2;
+    } else if (marker == 0xD8) {
+      // A new frame before the last one ended: that one was truncated.
+      start = i;
+      i += 2;
+    } else {
+      // A marker segment; skipping it by its length keeps bytes inside,
+      // e.g. an EXIF thumbnail, from being taken for markers.
+      if (i + 3 >= size) break;
+      i += 2 + ((static_cast<size_t>(data[i + 2]) << 8) | data[i + 3]);
+    }
+  }
+  return frames;
+}
+
+}  // namespace uvc
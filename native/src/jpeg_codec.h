@@ -0,0 +1,79 @@
+#ifndef UVC_JPEG_CODEC_H_
+#define UVC_JPEG_CODEC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Baseline JPEG through libjpeg-turbo, for MJPEG cameras. Only built when
+// CMake finds libjpeg, which then defines UVC_HAVE_JPEG for the library and
+// everything linking it.
+
+namespace uvc {
+
+// libjpeg decodes at M/8 of the coded size (M = 1..8) by skipping DCT
+// coefficients, which costs far less than decoding in full and resizing.
+
+// Smallest M whose output still covers |target_width| x |target_height|
+// (0 = the full size), or 8 if the target is larger than the image.
+int JpegScaleEighths(uint32_t width, uint32_t height, uint32_t target_width,
+                     uint32_t target_height);
+// Output size of |size| coded pixels at |eighths| / 8, as libjpeg rounds it.
+uint32_t JpegScaledSize(uint32_t size, int eighths);
+
+struct JpegDecodeOptions {
+  // Decode at JpegScaleEighths() of this size; 0 x 0 decodes in full.
+  uint32_t target_width = 0;
+  uint32_t target_height = 0;
+  // Integer IDCT and plain chroma upsampling: faster, slightly softer edges
+  // and colour. Good enough for a preview.
+  bool fast = true;
+  // If set, R, G and B are mapped through this 256-entry curve (the display
+  // tone, ToneCurve::curve()) as each batch of rows is decoded, while the
+  // rows are still in cache.
+  const uint8_t *curve = nullptr;
+};
+
+// Decodes JPEG frames into RGBA, reusing one libjpeg context. Not
+// thread-safe; give each thread its own.
+//
+// Motion JPEG frames from UVC cameras often leave out the Huffman tables;
+// libjpeg-turbo then uses the standard ones, as the UVC spec intends.
+class JpegDecoder {
+ public:
+  JpegDecoder();
+  ~JpegDecoder();
+  JpegDecoder(const JpegDecoder &) = delete;
+  JpegDecoder &operator=(const JpegDecoder &) = delete;
+
+  // Reads the coded size. Returns false if |jpeg| is not a JPEG.
+  bool ReadSize(const uint8_t *jpeg, size_t size, uint32_t *width,
+                uint32_t *height);
+
+  // Decodes |jpeg| to opaque RGBA rows |dst_stride| bytes apart. The scaled
+  // output must be exactly |width| x |height|. Returns false on corrupt or
+  // mismatched input; |dst| may then hold a partial image.
+  bool Decode(const uint8_t *jpeg, size_t size,
+              const JpegDecodeOptions &options, uint8_t *dst,
+              ptrdiff_t dst_stride, uint32_t width, uint32_t height);
+
+ private:
+  struct Context;
+  Context *context_;
+};
+
+// Encodes RGBA (alpha ignored) as a baseline 4:2:0 JPEG, for tests,
+// benchmarks and building MJPEG corpora. Returns false on failure.
+bool EncodeJpeg(const uint8_t *rgba, ptrdiff_t stride, uint32_t width,
+                uint32_t height, int quality, std::vector<uint8_t> *jpeg);
+
+// Splits a Motion JPEG stream (frames back to back, as `ffmpeg -f mjpeg`
+// or a raw dump of V4L2 buffers writes it) into (offset, size) frames.
+// Bytes between frames and a truncated last frame are skipped.
+std::vector<std::pair<size_t, size_t>> SplitMjpegStream(const uint8_t *data,
+                                                        size_t size);
+
+}  // namespace uvc
+
+#endif  // UVC_JPEG_CODEC_H_
@@ -0,0 +1,51 @@
+#include "latest_frames.h"
+
+#include <chrono>
+#include <utility>
+
+#include "pipeline_stats.h"
+
+namespace uvc {
+namespace {
+
+// Locks |mutex|, recording the wait in |stats| if set.
+std::unique_lock<std::mutex> LockTimed(std::mutex &mutex,
+                                       PipelineStats *stats) {
+  if (stats == nullptr) return std::unique_lock<std::mutex>(mutex);
+  const auto start = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(mutex);
+  stats->Record(PipelineStage::kLockWait,
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start)
+                    .count());
+  return lock;
+}
+
+}  // namespace
+
+void LatestFrames::Publish(FrameRef frame, FrameRef raw) {
+  // Declared first, so the replaced frames go back to their pools after
+  // the lock is released.
+  FrameRef previous, previous_raw;
+  std::unique_lock<std::mutex> lock = LockTimed(mutex_, stats_);
+  previous = std::exchange(frame_, std::move(frame));
+  previous_raw = std::exchange(counts_, std::move(raw));
+}
+
+void LatestFrames::PublishCounts(FrameRef raw) {
+  FrameRef previous_raw;
+  std::unique_lock<std::mutex> lock = LockTimed(mutex_, stats_);
+  previous_raw = std::exchange(counts_, std::move(raw));
+}
+
+FrameRef LatestFrames::frame() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return frame_;
+}
+
+FrameRef LatestFrames::counts() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return counts_;
+}
+
+}  // namespace uvc
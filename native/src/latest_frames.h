@@ -0,0 +1,46 @@
+#ifndef UVC_LATEST_FRAMES_H_
+#define UVC_LATEST_FRAMES_H_
+
+#include <mutex>
+
+#include "frame_pool.h"
+
+namespace uvc {
+
+class PipelineStats;
+
+// The newest display frame and raw counts, which CapturePhoto and
+// captureToFile take on the platform thread. Only the handles are swapped
+// under the lock; frames they replace are released after it.
+//
+// The counts can be newer than the display frame: while skipUnconsumed
+// holds frames back from display conversion, their counts are still
+// corrected and published with PublishCounts(), so a tiff16 snapshot is as
+// current as the ROI stream and the frame ring.
+class LatestFrames {
+ public:
+  // |stats|, if set, records the wait for the lock as
+  // PipelineStage::kLockWait.
+  explicit LatestFrames(PipelineStats *stats = nullptr) : stats_(stats) {}
+  LatestFrames(const LatestFrames &) = delete;
+  LatestFrames &operator=(const LatestFrames &) = delete;
+
+  // Publisher: |frame| and its counts |raw| (empty outside raw mode) become
+  // the newest.
+  void Publish(FrameRef frame, FrameRef raw);
+  // Publisher: |raw| becomes the newest counts; the display frame stays.
+  void PublishCounts(FrameRef raw);
+
+  FrameRef frame() const;
+  FrameRef counts() const;
+
+ private:
+  PipelineStats *stats_;
+  mutable std::mutex mutex_;
+  FrameRef frame_;
+  FrameRef counts_;
+};
+
+}  // namespace uvc
+
+#endif  // UVC_LATEST_FRAMES_H_
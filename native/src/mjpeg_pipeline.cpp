@@ -0,0 +1,192 @@
+#include "mjpeg_pipeline.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace uvc {
+
+namespace {
+
+constexpr int kMaxWorkers = 4;
+
+int DefaultWorkers() {
+  const int threads = static_cast<int>(std::thread::hardware_concurrency());
+  // Leave a core for the capture thread and the rest of the app.
+  return std::min(std::max(threads - 1, 1), kMaxWorkers);
+}
+
+}  // namespace
+
+void MjpegOutputSize(uint32_t width, uint32_t height,
+                     const JpegDecodeOptions &options, uint32_t *out_width,
+                     uint32_t *out_height) {
+  const int eighths = JpegScaleEighths(width, height, options.target_width,
+                                       options.target_height);
+  *out_width = JpegScaledSize(width, eighths);
+  *out_height = JpegScaledSize(height, eighths);
+}
+
+MjpegPipeline::~MjpegPipeline() { Stop(); }
+
+bool MjpegPipeline::Start(const MjpegPipelineOptions &options,
+                          FramePool *pool, FrameCallback on_frame) {
+  Stop();
+  options_ = options;
+  if (options_.workers <= 0) options_.workers = DefaultWorkers();
+  options_.workers = std::min(options_.workers, kMaxWorkers);
+  options_.max_queued = std::max<size_t>(options_.max_queued, 1);
+  pool_ = pool;
+  on_frame_ = std::move(on_frame);
+
+  // One slot per worker and queued frame, plus the one Submit() fills.
+  const size_t slot_count =
+      static_cast<size_t>(options_.workers) + options_.max_queued + 1;
+  slots_.assign(slot_count, Slot());
+  free_slots_.clear();
+  for (size_t i = slot_count; i-- > 0;) free_slots_.push_back(i);
+  queue_.clear();
+  queue_.reserve(options_.max_queued + 1);
+  results_.assign(static_cast<size_t>(options_.workers) * 4, Result());
+  next_ticket_ = 0;
+  next_delivery_ = 0;
+  delivering_ = false;
+  stopping_ = false;
+  stats_ = MjpegPipelineStats();
+
+  for (int i = 0; i < options_.workers; i++) {
+    threads_.emplace_back([this] { Work(); });
+  }
+  return true;
+}
+
+bool MjpegPipeline::Submit(const uint8_t *jpeg, size_t size,
+                           const FrameInfo &info, const uint8_t *curve) {
+  size_t index;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (threads_.empty() || stopping_) return false;
+    stats_.submitted++;
+    index = free_slots_.back();
+    free_slots_.pop_back();
+  }
+
+  // Copied outside the lock so workers are not held up; the slot is ours
+  // until it is queued.
+  Slot &slot = slots_[index];
+  if (slot.data.size() < size) slot.data.resize(size);
+  std::memcpy(slot.data.data(), jpeg, size);
+  slot.size = size;
+  slot.info = info;
+  slot.toned = curve != nullptr;
+  if (curve) std::memcpy(slot.curve, curve, sizeof(slot.curve));
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (queue_.size() >= options_.max_queued) {
+    free_slots_.push_back(queue_.front());
+    queue_.erase(queue_.begin());
+    stats_.dropped_stale++;
+  }
+  queue_.push_back(index);
+  queued_.notify_one();
+  return true;
+}
+
+void MjpegPipeline::Work() {
+  JpegDecoder decoder;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    // Results are delivered in order; a frame stuck in one worker must not
+    // let the others run arbitrarily far ahead of it.
+    queued_.wait(lock, [this] {
+      return stopping_ || (!queue_.empty() &&
+                           next_ticket_ - next_delivery_ < results_.size());
+    });
+    if (stopping_) return;
+    const size_t index = queue_.front();
+    queue_.erase(queue_.begin());
+    // Tickets follow the queue order, which is the capture order.
+    slots_[index].ticket = next_ticket_++;
+    lock.unlock();
+
+    const Slot &slot = slots_[index];
+    FrameRef frame = pool_->Acquire();
+    bool exhausted = !frame;
+    bool failed = false;
+    if (frame) {
+      const FrameFormat &format = frame.format();
+      JpegDecodeOptions decode = options_.decode;
+      decode.curve = slot.toned ? slot.curve : nullptr;
+      failed = format.pixel_format != PixelFormat::kRgba8 ||
+               !decoder.Decode(slot.data.data(), slot.size, decode,
+                               frame.data(),
+                               static_cast<ptrdiff_t>(format.Stride()),
+                               format.width, format.height);
+      if (failed) {
+        frame.reset();
+      } else {
+        frame.info() = slot.info;
+      }
+    }
+
+    lock.lock();
+    const uint64_t ticket = slot.ticket;
+    free_slots_.push_back(index);
+    if (exhausted) stats_.pool_exhausted++;
+    if (failed) stats_.failed++;
+    if (frame) stats_.decoded++;
+    Finish(ticket, std::move(frame), lock);
+  }
+}
+
+void MjpegPipeline::Finish(uint64_t ticket, FrameRef frame,
+                           std::unique_lock<std::mutex> &lock) {
+  Result &result = results_[ticket % results_.size()];
+  result.done = true;
+  result.frame = std::move(frame);
+  // Whoever is delivering already will pick this up.
+  if (delivering_) return;
+  delivering_ = true;
+  for (;;) {
+    Result &next = results_[next_delivery_ % results_.size()];
+    if (next_delivery_ == next_ticket_ || !next.done) break;
+    FrameRef ready = std::move(next.frame);
+    next.done = false;
+    next_delivery_++;
+    if (ready) {
+      lock.unlock();
+      on_frame_(std::move(ready));
+      lock.lock();
+    }
+  }
+  delivering_ = false;
+  delivered_.notify_all();
+  queued_.notify_all();
+}
+
+void MjpegPipeline::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  delivered_.wait(lock, [this] {
+    return queue_.empty() && next_delivery_ == next_ticket_ && !delivering_;
+  });
+}
+
+void MjpegPipeline::Stop() {
+  if (threads_.empty()) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    for (size_t index : queue_) free_slots_.push_back(index);
+    queue_.clear();
+    queued_.notify_all();
+  }
+  for (std::thread &thread : threads_) thread.join();
+  threads_.clear();
+}
+
+MjpegPipelineStats MjpegPipeline::Stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+}  // namespace uvc
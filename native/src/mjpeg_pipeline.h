@@ -0,0 +1,137 @@
+#ifndef UVC_MJPEG_PIPELINE_H_
+#define UVC_MJPEG_PIPELINE_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "frame_pool.h"
+#include "jpeg_codec.h"
+
+namespace uvc {
+
+struct MjpegPipelineOptions {
+  // Decode threads; 0 picks one less than the hardware threads, 1..4.
+  int workers = 0;
+  // Compressed frames allowed to wait for a worker. When decoding falls
+  // behind, a new frame pushes out the oldest waiting one, so the preview
+  // stays current instead of building up latency.
+  size_t max_queued = 1;
+  JpegDecodeOptions decode;
+};
+
+struct MjpegPipelineStats {
+  uint64_t submitted = 0;
+  uint64_t decoded = 0;
+  // Pushed out of the queue by newer frames because decoding fell behind.
+  uint64_t dropped_stale = 0;
+  // Corrupt frames and frames of an unexpected size.
+  uint64_t failed = 0;
+  // No free frame in the output pool.
+  uint64_t pool_exhausted = 0;
+};
+
+// Size of the RGBA frames a pipeline decodes |width| x |height| MJPEG into
+// with |options|, e.g. to configure its output pool.
+void MjpegOutputSize(uint32_t width, uint32_t height,
+                     const JpegDecodeOptions &options, uint32_t *out_width,
+                     uint32_t *out_height);
+
+// Decodes Motion JPEG frames on a small pool of threads and hands the RGBA
+// results on in capture order.
+//
+// Submit() copies the compressed frame into a preallocated slot and returns
+// at once, so the capture thread can give its buffer straight back to the
+// driver. Each worker decodes one frame at a time into a frame from the
+// output pool. Frames finish out of order; each is held until the frames
+// submitted before it have been delivered or dropped, then |on_frame| is
+// called with it on a worker thread, never on two at once.
+//
+// Start(), Submit(), Flush() and Stop() are called from one thread.
+class MjpegPipeline {
+ public:
+  using FrameCallback = std::function<void(FrameRef frame)>;
+
+  MjpegPipeline() = default;
+  ~MjpegPipeline();
+  MjpegPipeline(const MjpegPipeline &) = delete;
+  MjpegPipeline &operator=(const MjpegPipeline &) = delete;
+
+  // Starts the workers. |pool| supplies the output frames and must be
+  // configured for kRgba8 at MjpegOutputSize(); it must outlive Stop().
+  bool Start(const MjpegPipelineOptions &options, FramePool *pool,
+             FrameCallback on_frame);
+
+  // Queues a copy of |size| bytes of JPEG at |jpeg|; |info| is passed on
+  // with the decoded frame. A non-null |curve| (256 entries) is copied too
+  // and decoded into the frame, as JpegDecodeOptions::curve. Returns false
+  // if not started.
+  bool Submit(const uint8_t *jpeg, size_t size, const FrameInfo &info,
+              const uint8_t *curve = nullptr);
+
+  // Waits until every submitted frame has been delivered or dropped.
+  void Flush();
+
+  // Discards queued frames, waits for the ones being decoded to be
+  // delivered and joins the workers.
+  void Stop();
+
+  bool running() const { return !threads_.empty(); }
+  int workers() const { return static_cast<int>(threads_.size()); }
+  MjpegPipelineStats Stats() const;
+
+ private:
+  struct Slot {
+    std::vector<uint8_t> data;
+    size_t size = 0;
+    FrameInfo info;
+    // The tone curve as of Submit(); |curve| is only filled in if |toned|.
+    bool toned = false;
+    uint8_t curve[256];
+    uint64_t ticket = 0;
+  };
+  // Outcome of a ticket (a frame a worker took, in queue order), kept
+  // until every earlier one is delivered.
+  struct Result {
+    bool done = false;
+    FrameRef frame;  // Empty if dropped or failed.
+  };
+
+  void Work();
+  // Records the outcome of |ticket| and, unless another thread already is,
+  // delivers every result that is next in line. Called with |lock| held;
+  // releases it around the callback.
+  void Finish(uint64_t ticket, FrameRef frame,
+              std::unique_lock<std::mutex> &lock);
+
+  MjpegPipelineOptions options_;
+  FramePool *pool_ = nullptr;
+  FrameCallback on_frame_;
+  std::vector<std::thread> threads_;
+
+  mutable std::mutex mutex_;
+  // Signalled when a frame is queued, a result is delivered and on Stop().
+  std::condition_variable queued_;
+  // Signalled when a result is delivered.
+  std::condition_variable delivered_;
+  bool stopping_ = false;
+  std::vector<Slot> slots_;
+  std::vector<size_t> free_slots_;
+  // Indices into slots_, oldest first.
+  std::vector<size_t> queue_;
+  // Indexed by ticket modulo its size, which bounds the tickets taken but
+  // not yet delivered.
+  std::vector<Result> results_;
+  uint64_t next_ticket_ = 0;
+  uint64_t next_delivery_ = 0;
+  bool delivering_ = false;
+  MjpegPipelineStats stats_;
+};
+
+}  // namespace uvc
+
+#endif  // UVC_MJPEG_PIPELINE_H_
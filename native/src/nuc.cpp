@@ -0,0 +1,506 @@
+#include "nuc.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+#include "cpu_features.h"
+
+#if defined(UVC_ARCH_X86)
+#include <immintrin.h>
+#elif defined(UVC_ARCH_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace uvc {
+
+namespace {
+
+// Rows below this are not worth a stripe of their own.
+constexpr size_t kMinStripeRows = 32;
+// The column estimate samples every 16th row, starting one row further
+// down on each frame; stripes run the full height, so that is plenty.
+// Columns are compared with up to this many neighbours on each side.
+constexpr size_t kColumnRowStep = 16;
+constexpr size_t kColumnRadius = 4;
+
+int64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// The correction as every kernel evaluates it, in this order:
+//   v = gain * count + offset + column
+// clamped to 0..65535 and rounded half up.
+using NucRowFn = void (*)(uint16_t *frame, const float *gain,
+                          const float *offset, const float *columns,
+                          size_t width);
+
+void NucRowScalar(uint16_t *frame, const float *gain, const float *offset,
+                  const float *columns, size_t width) {
+  for (size_t x = 0; x < width; x++) {
+    float v = gain[x] * static_cast<float>(frame[x]);
+    v = v + offset[x];
+    v = v + columns[x];
+    v = std::min(std::max(v, 0.0f), 65535.0f);
+    frame[x] = static_cast<uint16_t>(v + 0.5f);
+  }
+}
+
+#if defined(UVC_ARCH_X86)
+// Corrects four pixels given as int32 counts; returns the rounded values.
+UVC_TARGET_SSSE3 inline __m128i Correct4Ssse3(__m128i counts,
+                                              const float *gain,
+                                              const float *offset,
+                                              const float *columns) {
+  __m128 v = _mm_mul_ps(_mm_loadu_ps(gain), _mm_cvtepi32_ps(counts));
+  v = _mm_add_ps(v, _mm_loadu_ps(offset));
+  v = _mm_add_ps(v, _mm_loadu_ps(columns));
+  v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(65535.0f));
+  return _mm_cvttps_epi32(_mm_add_ps(v, _mm_set1_ps(0.5f)));
+}
+
+UVC_TARGET_SSSE3 void NucRowSsse3(uint16_t *frame, const float *gain,
+                                  const float *offset, const float *columns,
+                                  size_t width) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i bias32 = _mm_set1_epi32(32768);
+  const __m128i bias16 = _mm_set1_epi16(-32768);
+  size_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const __m128i counts =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(frame + x));
+    const __m128i lo = Correct4Ssse3(_mm_unpacklo_epi16(counts, zero),
+                                     gain + x, offset + x, columns + x);
+    const __m128i hi =
+        Correct4Ssse3(_mm_unpackhi_epi16(counts, zero), gain + x + 4,
+                      offset + x + 4, columns + x + 4);
+    // No packus_epi32 before SSE4.1: pack signed around 32768 instead.
+    const __m128i packed = _mm_packs_epi32(_mm_sub_epi32(lo, bias32),
+                                           _mm_sub_epi32(hi, bias32));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(frame + x),
+                     _mm_xor_si128(packed, bias16));
+  }
+  NucRowScalar(frame + x, gain + x, offset + x, columns + x, width - x);
+}
+
+UVC_TARGET_AVX2 void NucRowAvx2(uint16_t *frame, const float *gain,
+                                const float *offset, const float *columns,
+                                size_t width) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 top = _mm256_set1_ps(65535.0f);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  size_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const __m256i counts = _mm256_cvtepu16_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(frame + x)));
+    __m256 v = _mm256_mul_ps(_mm256_loadu_ps(gain + x),
+                             _mm256_cvtepi32_ps(counts));
+    v = _mm256_add_ps(v, _mm256_loadu_ps(offset + x));
+    v = _mm256_add_ps(v, _mm256_loadu_ps(columns + x));
+    v = _mm256_min_ps(_mm256_max_ps(v, zero), top);
+    const __m256i rounded = _mm256_cvttps_epi32(_mm256_add_ps(v, half));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(frame + x),
+                     _mm_packus_epi32(_mm256_castsi256_si128(rounded),
+                                      _mm256_extracti128_si256(rounded, 1)));
+  }
+  NucRowScalar(frame + x, gain + x, offset + x, columns + x, width - x);
+}
+#endif  // UVC_ARCH_X86
+
+#if defined(UVC_ARCH_NEON)
+inline uint32x4_t Correct4Neon(uint32x4_t counts, const float *gain,
+                               const float *offset, const float *columns) {
+  // Separate multiplies and adds, as in the scalar kernel.
+  float32x4_t v = vmulq_f32(vld1q_f32(gain), vcvtq_f32_u32(counts));
+  v = vaddq_f32(v, vld1q_f32(offset));
+  v = vaddq_f32(v, vld1q_f32(columns));
+  v = vminq_f32(vmaxq_f32(v, vdupq_n_f32(0.0f)), vdupq_n_f32(65535.0f));
+  return vcvtq_u32_f32(vaddq_f32(v, vdupq_n_f32(0.5f)));
+}
+
+void NucRowNeon(uint16_t *frame, const float *gain, const float *offset,
+                const float *columns, size_t width) {
+  size_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const uint16x8_t counts = vld1q_u16(frame + x);
+    const uint32x4_t lo = Correct4Neon(vmovl_u16(vget_low_u16(counts)),
+                                       gain + x, offset + x, columns + x);
+    const uint32x4_t hi =
+        Correct4Neon(vmovl_u16(vget_high_u16(counts)), gain + x + 4,
+                     offset + x + 4, columns + x + 4);
+    vst1q_u16(frame + x, vcombine_u16(vqmovn_u32(lo), vqmovn_u32(hi)));
+  }
+  NucRowScalar(frame + x, gain + x, offset + x, columns + x, width - x);
+}
+#endif  // UVC_ARCH_NEON
+
+NucRowFn SelectRowFn(SimdLevel level) {
+  switch (level) {
+#if defined(UVC_ARCH_X86)
+    case SimdLevel::kAvx2:
+      return NucRowAvx2;
+    case SimdLevel::kSsse3:
+      return NucRowSsse3;
+#endif
+#if defined(UVC_ARCH_NEON)
+    case SimdLevel::kNeon:
+      return NucRowNeon;
+#endif
+    default:
+      return NucRowScalar;
+  }
+}
+
+}  // namespace
+
+bool ParseNucReference(const std::string &name, NucReference *reference) {
+  if (name == "cold") {
+    *reference = NucReference::kCold;
+  } else if (name == "hot") {
+    *reference = NucReference::kHot;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+NucEngine::NucEngine(size_t threads) : pool_(threads) {}
+
+NucEngine::~NucEngine() {
+  // Every accepted capture hears back, even one that never got its frames.
+  Reset();
+  {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    if (pending_capture_) {
+      FinishCapture(std::move(pending_capture_), "CAPTURE_STOPPED");
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    changed_.notify_all();
+  }
+  if (thread_.joinable()) thread_.join();
+}
+
+void NucEngine::SetConfig(const NucConfig &config) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  pending_config_ = config;
+  config_dirty_.store(true, std::memory_order_release);
+}
+
+NucConfig NucEngine::config() const {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return pending_config_;
+}
+
+void NucEngine::SetTables(std::shared_ptr<const NucTables> tables) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  pending_tables_ = std::move(tables);
+  config_dirty_.store(true, std::memory_order_release);
+}
+
+std::shared_ptr<const NucTables> NucEngine::tables() const {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return pending_tables_;
+}
+
+bool NucEngine::LoadTables(const std::string &path, std::string *error) {
+  std::shared_ptr<const NucTables> tables = NucTables::Map(path, error);
+  if (!tables) return false;
+  SetTables(std::move(tables));
+  return true;
+}
+
+bool NucEngine::CaptureReference(NucReference reference, size_t frames,
+                                 uint32_t width, uint32_t height,
+                                 Callback done) {
+  if (frames == 0 || frames > kMaxReferenceFrames || width == 0 ||
+      height == 0) {
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (busy_ || stopping_) return false;
+    busy_ = true;
+  }
+  // Allocated here, so the capture thread only copies.
+  auto capture = std::make_unique<Capture>();
+  capture->reference = reference;
+  capture->frames = frames;
+  capture->width = width;
+  capture->height = height;
+  capture->buffer.resize(frames * width * height);
+  capture->done = std::move(done);
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  pending_capture_ = std::move(capture);
+  config_dirty_.store(true, std::memory_order_release);
+  return true;
+}
+
+bool NucEngine::ComputeTables(std::string path, Callback done) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (busy_ || stopping_) return false;
+    busy_ = true;
+  }
+  Post([this, path = std::move(path), done = std::move(done)] {
+    const int64_t start = NowNs();
+    NucResult result;
+    Reference cold, hot;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      cold = std::move(references_[static_cast<int>(NucReference::kCold)]);
+      hot = std::move(references_[static_cast<int>(NucReference::kHot)]);
+      references_[0] = Reference();
+      references_[1] = Reference();
+    }
+
+    std::shared_ptr<const NucTables> computed;
+    if (!cold.mean.empty() && !hot.mean.empty()) {
+      result.two_point = true;
+      if (cold.width != hot.width || cold.height != hot.height) {
+        result.error = "SIZE_MISMATCH";
+      } else {
+        computed = ComputeTwoPointNuc(cold.mean.data(), hot.mean.data(),
+                                      cold.width, cold.height);
+        if (!computed) result.error = "HOT_NOT_WARMER";
+      }
+    } else if (!cold.mean.empty() || !hot.mean.empty()) {
+      const Reference &flat = cold.mean.empty() ? hot : cold;
+      computed = ComputeOnePointNuc(flat.mean.data(), tables().get(),
+                                    flat.width, flat.height);
+    } else {
+      result.error = "NO_REFERENCE";
+    }
+    if (computed && !path.empty() && !computed->Save(path)) {
+      result.error = "WRITE_FAILED: " + path;
+      computed = nullptr;
+    }
+
+    if (computed) {
+      SetTables(computed);
+      result.ok = true;
+      result.path = path;
+    } else {
+      // Keep the references for another try.
+      std::lock_guard<std::mutex> lock(mutex_);
+      references_[static_cast<int>(NucReference::kCold)] = std::move(cold);
+      references_[static_cast<int>(NucReference::kHot)] = std::move(hot);
+    }
+    result.compute_ns = NowNs() - start;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      busy_ = false;
+    }
+    if (done) done(result);
+  });
+  return true;
+}
+
+void NucEngine::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  changed_.wait(lock, [this] { return !busy_ && jobs_.empty(); });
+}
+
+void NucEngine::Reset() {
+  primed_ = false;
+  if (capture_) FinishCapture(std::move(capture_), "CAPTURE_STOPPED");
+}
+
+void NucEngine::FinishCapture(std::unique_ptr<Capture> capture,
+                              std::string error) {
+  std::shared_ptr<Capture> finished = std::move(capture);
+  Post([this, finished, error = std::move(error)] {
+    const int64_t start = NowNs();
+    NucResult result;
+    result.error = error;
+    result.frames = finished->captured;
+    if (error.empty()) {
+      Reference reference;
+      reference.width = finished->width;
+      reference.height = finished->height;
+      const size_t pixels = static_cast<size_t>(reference.width) *
+                            reference.height;
+      reference.mean.resize(pixels);
+      AverageFrames(finished->buffer.data(), finished->captured, pixels,
+                    reference.mean.data());
+      double sum = 0;
+      for (float value : reference.mean) sum += value;
+      result.mean = static_cast<float>(sum / static_cast<double>(pixels));
+      result.ok = true;
+      std::lock_guard<std::mutex> lock(mutex_);
+      references_[static_cast<int>(finished->reference)] =
+          std::move(reference);
+    }
+    // The frames are not needed past this point; a 256-frame capture is
+    // large.
+    std::vector<uint16_t>().swap(finished->buffer);
+    result.compute_ns = NowNs() - start;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      busy_ = false;
+    }
+    if (finished->done) finished->done(result);
+  });
+}
+
+void NucEngine::Post(std::function<void()> job) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  jobs_.push_back(std::move(job));
+  // Started on first use: most sessions never calibrate.
+  if (!thread_.joinable()) thread_ = std::thread([this] { Work(); });
+  changed_.notify_all();
+}
+
+void NucEngine::Work() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    changed_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+    // Queued jobs are finished even when stopping.
+    if (jobs_.empty()) return;
+    std::function<void()> job = std::move(jobs_.front());
+    lock.unlock();
+    job();
+    lock.lock();
+    // Popped only now, so Flush() waits for the job to finish.
+    jobs_.pop_front();
+    changed_.notify_all();
+  }
+}
+
+void NucEngine::Process(uint16_t *frame, size_t stride_pixels, size_t width,
+                        size_t height) {
+  if (config_dirty_.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    config_ = pending_config_;
+    // Column offsets learned on top of other tables start over.
+    if (tables_ != pending_tables_ || !config_.shutterless) primed_ = false;
+    tables_ = pending_tables_;
+    if (pending_capture_) capture_ = std::move(pending_capture_);
+    config_dirty_.store(false, std::memory_order_relaxed);
+  }
+
+  // References are the counts before correction.
+  if (capture_) {
+    if (capture_->width != width || capture_->height != height) {
+      FinishCapture(std::move(capture_), "SIZE_CHANGED");
+    } else {
+      uint16_t *dst = capture_->buffer.data() +
+                      capture_->captured * width * height;
+      for (size_t y = 0; y < height; y++) {
+        std::copy(frame + y * stride_pixels,
+                  frame + y * stride_pixels + width, dst + y * width);
+      }
+      if (++capture_->captured == capture_->frames) {
+        FinishCapture(std::move(capture_), std::string());
+      }
+    }
+  }
+
+  const NucTables *tables = tables_.get();
+  if (!config_.enabled || tables == nullptr || tables->width() != width ||
+      tables->height() != height) {
+    primed_ = false;
+    return;
+  }
+  if (!primed_ || width != width_) {
+    // Only a size change allocates.
+    columns_.assign(width, 0.0f);
+    column_sums_.resize(width);
+    column_counts_.resize(width);
+    row_sums_.resize(width);
+    row_pairs_.resize(width);
+    width_ = width;
+    primed_ = true;
+  }
+
+  const NucRowFn row = SelectRowFn(GetSimdLevel());
+  const size_t stripes = std::max<size_t>(
+      std::min(pool_.threads(), height / kMinStripeRows), 1);
+  const float *columns = columns_.data();
+  pool_.Run(stripes, [&](size_t stripe) {
+    const size_t begin = height * stripe / stripes;
+    const size_t end = height * (stripe + 1) / stripes;
+    for (size_t y = begin; y < end; y++) {
+      row(frame + y * stride_pixels, tables->gain() + y * width,
+          tables->offset() + y * width, columns, width);
+    }
+  });
+
+  if (config_.shutterless) {
+    UpdateColumnOffsets(frame, stride_pixels, width, height);
+  }
+}
+
+void NucEngine::UpdateColumnOffsets(const uint16_t *frame,
+                                    size_t stride_pixels, size_t width,
+                                    size_t height) {
+  // A column stripe shows as a column standing off its neighbours by the
+  // same amount on every row. Each pixel is compared with the mean of the
+  // pixels j columns to either side, for j up to kColumnRadius, so a smooth
+  // gradient in the scene cancels out; pairs with a difference above the
+  // gate straddle a scene edge and are left out. Where no pair is left, at
+  // the frame border or beside an edge, the two nearest columns on one side
+  // are extrapolated instead.
+  const float gate = config_.shutterless_gate;
+  auto flat = [gate](float a, float b) { return std::fabs(a - b) < gate; };
+  std::fill(column_sums_.begin(), column_sums_.end(), 0.0f);
+  std::fill(column_counts_.begin(), column_counts_.end(), 0u);
+  float *row_sums = row_sums_.data();
+  float *row_pairs = row_pairs_.data();
+  size_t rows = 0;
+  column_phase_ = (column_phase_ + 1) % kColumnRowStep;
+  for (size_t y = column_phase_ % height; y < height;
+       y += kColumnRowStep, rows++) {
+    const uint16_t *p = frame + y * stride_pixels;
+    std::fill(row_sums_.begin(), row_sums_.end(), 0.0f);
+    std::fill(row_pairs_.begin(), row_pairs_.end(), 0.0f);
+    // Branch-free, so the compiler vectorizes it.
+    for (size_t j = 1; j <= kColumnRadius && 2 * j < width; j++) {
+      for (size_t x = j; x + j < width; x++) {
+        const float here = p[x];
+        const float left = p[x - j];
+        const float right = p[x + j];
+        const float use =
+            (flat(here, left) & flat(here, right)) ? 1.0f : 0.0f;
+        row_sums[x] += use * (here - 0.5f * (left + right));
+        row_pairs[x] += use;
+      }
+    }
+    for (size_t x = 0; x < width; x++) {
+      if (row_pairs[x] > 0) {
+        column_sums_[x] += row_sums[x] / row_pairs[x];
+        column_counts_[x]++;
+        continue;
+      }
+      const float here = p[x];
+      if (x >= 2 && flat(here, p[x - 1]) && flat(p[x - 1], p[x - 2])) {
+        column_sums_[x] += here - 2.0f * p[x - 1] + p[x - 2];
+        column_counts_[x]++;
+      } else if (x + 2 < width && flat(here, p[x + 1]) &&
+                 flat(p[x + 1], p[x + 2])) {
+        column_sums_[x] += here - 2.0f * p[x + 1] + p[x + 2];
+        column_counts_[x]++;
+      }
+    }
+  }
+  // Columns that are mostly edge this frame keep their offset.
+  const uint32_t min_samples = static_cast<uint32_t>(rows / 2 + 1);
+  const float rate = std::min(std::max(config_.shutterless_rate, 0.0f), 1.0f);
+  double total = 0;
+  for (size_t x = 0; x < width; x++) {
+    if (column_counts_[x] >= min_samples) {
+      columns_[x] -= rate * column_sums_[x] / column_counts_[x];
+    }
+    total += columns_[x];
+  }
+  // Stripes only: the overall level is the tables' business.
+  const float mean = static_cast<float>(total / static_cast<double>(width));
+  for (float &column : columns_) column -= mean;
+}
+
+}  // namespace uvc
@@ -0,0 +1,177 @@
+#ifndef UVC_NUC_H_
+#define UVC_NUC_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nuc_tables.h"
+#include "stripe_pool.h"
+
+namespace uvc {
+
+// Which flat field a reference capture is: a cold and a hot one make a
+// two-point calibration, either alone a one-point (offset) refresh.
+enum class NucReference { kCold, kHot };
+
+// Parses "cold" or "hot". Returns false for anything else.
+bool ParseNucReference(const std::string &name, NucReference *reference);
+
+struct NucConfig {
+  bool enabled = false;
+  // Scene-based column offsets on top of the tables, for column stripes
+  // that drift in after calibration, without closing a shutter.
+  bool shutterless = true;
+  // Fraction of each column's measured stripe removed per frame.
+  float shutterless_rate = 0.05f;
+  // Differences between neighbouring columns above this many counts are
+  // scene edges and are left out of the stripe estimate.
+  float shutterless_gate = 64.0f;
+};
+
+struct NucResult {
+  bool ok = false;
+  // Why it failed, e.g. "SIZE_CHANGED"; empty on success.
+  std::string error;
+  // The file the tables were saved to, if any.
+  std::string path;
+  // Frames averaged into a reference, and their mean count.
+  size_t frames = 0;
+  float mean = 0;
+  // The computed tables are a two-point calibration rather than an offset
+  // refresh.
+  bool two_point = false;
+  // Averaging or computing on the calibration thread.
+  int64_t compute_ns = 0;
+};
+
+// Non-uniformity correction for raw 16-bit frames: per-pixel gain and
+// offset tables (NucTables) plus scene-based column offsets, applied in one
+// fused pass by an SSSE3/AVX2/NEON kernel over stripes of rows.
+//
+// Calibration does not stop the preview. CaptureReference() has Process()
+// copy the next frames, as they arrive and before correction, into a
+// buffer allocated up front; a calibration thread of the engine's own
+// averages them, and ComputeTables() turns the references into tables
+// there, saves them, and hands them to SetTables(). New tables are picked
+// up by the next Process() call, so a frame is corrected with either the
+// old tables or the new ones, never a mix.
+//
+// Process() must be called from one thread, and Reset() only while it is
+// not running; the other methods may be called from any thread. Callbacks
+// run on the calibration thread.
+class NucEngine {
+ public:
+  using Callback = std::function<void(const NucResult &result)>;
+
+  static constexpr size_t kMaxReferenceFrames = 256;
+
+  // |threads| for the stripes, including the caller; 0 for the default.
+  explicit NucEngine(size_t threads = 0);
+  ~NucEngine();
+  NucEngine(const NucEngine &) = delete;
+  NucEngine &operator=(const NucEngine &) = delete;
+
+  void SetConfig(const NucConfig &config);
+  NucConfig config() const;
+
+  // Replaces the tables from the next frame on; null removes them. Tables
+  // of another size than the frames leave the frames uncorrected.
+  void SetTables(std::shared_ptr<const NucTables> tables);
+  std::shared_ptr<const NucTables> tables() const;
+  // Maps tables saved by ComputeTables() and sets them.
+  bool LoadTables(const std::string &path, std::string *error);
+
+  // Averages the next |frames| frames of |width| x |height| as the
+  // |reference| flat field and calls |done| with their mean. Returns false,
+  // and does not call |done|, while another capture or computation is
+  // running or if the arguments are out of range.
+  bool CaptureReference(NucReference reference, size_t frames, uint32_t width,
+                        uint32_t height, Callback done);
+
+  // Computes tables from the captured references (two-point with both, a
+  // one-point refresh of the current tables with either), saves them to
+  // |path| unless it is empty, sets them, and calls |done|. The references
+  // are used up. Returns false, and does not call |done|, while a capture
+  // or computation is running.
+  bool ComputeTables(std::string path, Callback done);
+
+  // Waits until no capture or computation is running.
+  void Flush();
+
+  // Corrects |frame| in place while enabled, after copying it into a
+  // pending reference capture.
+  void Process(uint16_t *frame, size_t stride_pixels, size_t width,
+               size_t height);
+
+  // Forgets the column offsets and fails a capture still collecting frames,
+  // e.g. when capture stops.
+  void Reset();
+
+ private:
+  struct Capture {
+    NucReference reference = NucReference::kCold;
+    size_t frames = 0;
+    size_t captured = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint16_t> buffer;
+    Callback done;
+  };
+  struct Reference {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<float> mean;
+  };
+
+  // Hands |capture| to the calibration thread to average, or to fail with
+  // |error| if it is not empty.
+  void FinishCapture(std::unique_ptr<Capture> capture, std::string error);
+  void Post(std::function<void()> job);
+  void Work();
+  void UpdateColumnOffsets(const uint16_t *frame, size_t stride_pixels,
+                           size_t width, size_t height);
+
+  // Guards the pending config, tables and capture.
+  mutable std::mutex config_mutex_;
+  NucConfig pending_config_;
+  std::shared_ptr<const NucTables> pending_tables_;
+  std::unique_ptr<Capture> pending_capture_;
+  std::atomic<bool> config_dirty_{false};
+
+  // Owned by the Process() thread.
+  NucConfig config_;
+  std::shared_ptr<const NucTables> tables_;
+  std::unique_ptr<Capture> capture_;
+  bool primed_ = false;
+  size_t width_ = 0;
+  std::vector<float> columns_;
+  std::vector<float> column_sums_;
+  std::vector<uint32_t> column_counts_;
+  std::vector<float> row_sums_;
+  std::vector<float> row_pairs_;
+  size_t column_phase_ = 0;
+  StripePool pool_;
+
+  // The calibration thread.
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::deque<std::function<void()>> jobs_;
+  // A capture or computation is between its call and its callback.
+  bool busy_ = false;
+  Reference references_[2];
+  bool stopping_ = false;
+  std::thread thread_;
+};
+
+}  // namespace uvc
+
+#endif  // UVC_NUC_H_
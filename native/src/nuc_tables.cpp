@@ -0,0 +1,269 @@
+#include "nuc_tables.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace uvc {
+
+const char kNucMagic[8] = {'U', 'V', 'C', 'N', 'U', 'C', '1', '\0'};
+
+namespace {
+
+constexpr uint64_t kTableAlignment = 64;
+
+// Gains beyond these are a pixel that barely responds, not one to correct.
+constexpr float kMinGain = 0.25f;
+constexpr float kMaxGain = 4.0f;
+
+uint64_t AlignUp(uint64_t value) {
+  return (value + kTableAlignment - 1) / kTableAlignment * kTableAlignment;
+}
+
+double Mean(const float *values, size_t count) {
+  double sum = 0;
+  for (size_t i = 0; i < count; i++) sum += values[i];
+  return count > 0 ? sum / static_cast<double>(count) : 0.0;
+}
+
+}  // namespace
+
+// A read-only view of a whole file.
+struct NucTables::Mapping {
+  Mapping(const void *data, size_t bytes) : data(data), bytes(bytes) {}
+  ~Mapping() {
+#if defined(_WIN32)
+    UnmapViewOfFile(data);
+#else
+    munmap(const_cast<void *>(data), bytes);
+#endif
+  }
+
+  const void *data;
+  size_t bytes;
+};
+
+NucTables::NucTables(uint32_t width, uint32_t height, std::vector<float> gain,
+                     std::vector<float> offset)
+    : width_(width),
+      height_(height),
+      owned_gain_(std::move(gain)),
+      owned_offset_(std::move(offset)),
+      gain_(owned_gain_.data()),
+      offset_(owned_offset_.data()) {}
+
+NucTables::NucTables(uint32_t width, uint32_t height,
+                     std::unique_ptr<Mapping> mapping, const float *gain,
+                     const float *offset)
+    : width_(width),
+      height_(height),
+      mapping_(std::move(mapping)),
+      gain_(gain),
+      offset_(offset) {}
+
+NucTables::~NucTables() = default;
+
+std::shared_ptr<const NucTables> NucTables::Identity(uint32_t width,
+                                                     uint32_t height) {
+  const size_t pixels = static_cast<size_t>(width) * height;
+  return std::make_shared<const NucTables>(width, height,
+                                           std::vector<float>(pixels, 1.0f),
+                                           std::vector<float>(pixels, 0.0f));
+}
+
+std::shared_ptr<const NucTables> NucTables::Map(const std::string &path,
+                                                std::string *error) {
+  const void *data = nullptr;
+  uint64_t bytes = 0;
+#if defined(_WIN32)
+  // u8path, so non-ASCII paths work.
+  const std::wstring wide = std::filesystem::u8path(path).wstring();
+  HANDLE file = CreateFileW(wide.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    *error = "OPEN_FAILED: " + path;
+    return nullptr;
+  }
+  LARGE_INTEGER size;
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+    bytes = static_cast<uint64_t>(size.QuadPart);
+    HANDLE mapping =
+        CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping != nullptr) {
+      // The view keeps the mapping alive once both handles are closed.
+      data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mapping);
+    }
+  }
+  CloseHandle(file);
+#else
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    *error = "OPEN_FAILED: " + path;
+    return nullptr;
+  }
+  struct stat info;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    bytes = static_cast<uint64_t>(info.st_size);
+    void *mapped = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped != MAP_FAILED) data = mapped;
+  }
+  close(fd);
+#endif
+  if (data == nullptr) {
+    *error = "MAP_FAILED: " + path;
+    return nullptr;
+  }
+  auto mapping = std::make_unique<Mapping>(data, static_cast<size_t>(bytes));
+
+  NucFileHeader header;
+  if (bytes < sizeof(header)) {
+    *error = "INVALID_FILE: truncated header";
+    return nullptr;
+  }
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, kNucMagic, sizeof(kNucMagic)) != 0 ||
+      header.version != kNucVersion) {
+    *error = "INVALID_FILE: not a version " + std::to_string(kNucVersion) +
+             " NUC file";
+    return nullptr;
+  }
+  const uint64_t table_bytes =
+      static_cast<uint64_t>(header.width) * header.height * sizeof(float);
+  if (table_bytes == 0 || header.gain_offset % kTableAlignment != 0 ||
+      header.offset_offset % kTableAlignment != 0 ||
+      header.gain_offset < sizeof(header) ||
+      header.offset_offset < sizeof(header) ||
+      header.gain_offset > bytes || bytes - header.gain_offset < table_bytes ||
+      header.offset_offset > bytes ||
+      bytes - header.offset_offset < table_bytes) {
+    *error = "INVALID_FILE: tables outside the file";
+    return nullptr;
+  }
+  const uint8_t *base = static_cast<const uint8_t *>(data);
+  const float *gain = reinterpret_cast<const float *>(base + header.gain_offset);
+  const float *offset =
+      reinterpret_cast<const float *>(base + header.offset_offset);
+  return std::shared_ptr<const NucTables>(new NucTables(
+      header.width, header.height, std::move(mapping), gain, offset));
+}
+
+bool NucTables::Save(const std::string &path) const {
+  const uint64_t table_bytes =
+      static_cast<uint64_t>(width_) * height_ * sizeof(float);
+  NucFileHeader header = {};
+  std::memcpy(header.magic, kNucMagic, sizeof(kNucMagic));
+  header.version = kNucVersion;
+  header.width = width_;
+  header.height = height_;
+  header.gain_offset = AlignUp(sizeof(header));
+  header.offset_offset = header.gain_offset + AlignUp(table_bytes);
+
+  const std::filesystem::path target = std::filesystem::u8path(path);
+  std::filesystem::path temporary = target;
+  temporary += ".part";
+  std::error_code error;
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    const char padding[kTableAlignment] = {};
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(padding, static_cast<std::streamsize>(header.gain_offset -
+                                                     sizeof(header)));
+    file.write(reinterpret_cast<const char *>(gain_),
+               static_cast<std::streamsize>(table_bytes));
+    file.write(padding,
+               static_cast<std::streamsize>(AlignUp(table_bytes) - table_bytes));
+    file.write(reinterpret_cast<const char *>(offset_),
+               static_cast<std::streamsize>(table_bytes));
+    file.close();
+    if (!file) {
+      std::filesystem::remove(temporary, error);
+      return false;
+    }
+  }
+  std::filesystem::rename(temporary, target, error);
+  if (error) {
+    std::filesystem::remove(temporary, error);
+    return false;
+  }
+  return true;
+}
+
+void AverageFrames(const uint16_t *frames, size_t count, size_t pixels,
+                   float *mean) {
+  // 32-bit sums hold 65536 frames of full-scale counts.
+  std::vector<uint32_t> sums(pixels, 0);
+  for (size_t f = 0; f < count; f++) {
+    const uint16_t *frame = frames + f * pixels;
+    for (size_t i = 0; i < pixels; i++) sums[i] += frame[i];
+  }
+  const float scale = count > 0 ? 1.0f / static_cast<float>(count) : 0.0f;
+  for (size_t i = 0; i < pixels; i++) {
+    mean[i] = static_cast<float>(sums[i]) * scale;
+  }
+}
+
+std::shared_ptr<const NucTables> ComputeTwoPointNuc(const float *cold,
+                                                    const float *hot,
+                                                    uint32_t width,
+                                                    uint32_t height) {
+  const size_t pixels = static_cast<size_t>(width) * height;
+  const double cold_mean = Mean(cold, pixels);
+  const double response = Mean(hot, pixels) - cold_mean;
+  if (pixels == 0 || !(response > 0)) return nullptr;
+
+  std::vector<float> gain(pixels), offset(pixels);
+  for (size_t i = 0; i < pixels; i++) {
+    const double pixel_response = static_cast<double>(hot[i]) - cold[i];
+    double g = pixel_response > 0 ? response / pixel_response : 1.0;
+    if (g < kMinGain || g > kMaxGain) g = 1.0;
+    gain[i] = static_cast<float>(g);
+    offset[i] = static_cast<float>(cold_mean - g * cold[i]);
+  }
+  return std::make_shared<const NucTables>(width, height, std::move(gain),
+                                           std::move(offset));
+}
+
+std::shared_ptr<const NucTables> ComputeOnePointNuc(const float *flat,
+                                                    const NucTables *base,
+                                                    uint32_t width,
+                                                    uint32_t height) {
+  const size_t pixels = static_cast<size_t>(width) * height;
+  if (pixels == 0) return nullptr;
+  const bool keep = base != nullptr && base->width() == width &&
+                    base->height() == height;
+  std::vector<float> gain(pixels), offset(pixels);
+  double level = 0;
+  for (size_t i = 0; i < pixels; i++) {
+    gain[i] = keep ? base->gain()[i] : 1.0f;
+    level += static_cast<double>(gain[i]) * flat[i] +
+             (keep ? base->offset()[i] : 0.0f);
+  }
+  level /= static_cast<double>(pixels);
+  for (size_t i = 0; i < pixels; i++) {
+    offset[i] = static_cast<float>(level - static_cast<double>(gain[i]) *
+                                               flat[i]);
+  }
+  return std::make_shared<const NucTables>(width, height, std::move(gain),
+                                           std::move(offset));
+}
+
+}  // namespace uvc
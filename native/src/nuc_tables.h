@@ -0,0 +1,104 @@
+#ifndef UVC_NUC_TABLES_H_
+#define UVC_NUC_TABLES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace uvc {
+
+// On-disk layout of NUC tables (.uvcnuc): this header, then width * height
+// float gains at |gain_offset| and as many float offsets at
+// |offset_offset|. Both start on a 64-byte boundary so a mapped file feeds
+// the correction kernel as it is. All fields are little-endian.
+struct NucFileHeader {
+  char magic[8];  // kNucMagic.
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t reserved;
+  // Bytes from the start of the file.
+  uint64_t gain_offset;
+  uint64_t offset_offset;
+};
+static_assert(sizeof(NucFileHeader) == 40, "NUC file header layout");
+
+extern const char kNucMagic[8];
+constexpr uint32_t kNucVersion = 1;
+
+// Per-pixel two-point non-uniformity correction tables:
+//   corrected = gain * count + offset
+//
+// Immutable once built, so the calibration thread that computes them and
+// the capture thread that applies them share them through a shared_ptr.
+// The tables either live in memory or are mapped straight from a file
+// written by Save(), in which case loading them costs no computation.
+class NucTables {
+ public:
+  // Takes |gain| and |offset|, width * height entries each.
+  NucTables(uint32_t width, uint32_t height, std::vector<float> gain,
+            std::vector<float> offset);
+  ~NucTables();
+  NucTables(const NucTables &) = delete;
+  NucTables &operator=(const NucTables &) = delete;
+
+  // Unity gain and zero offset.
+  static std::shared_ptr<const NucTables> Identity(uint32_t width,
+                                                   uint32_t height);
+
+  // Maps the tables saved at |path| (UTF-8). Returns null and sets |error|
+  // if the file is missing, truncated, or not a version this code reads.
+  static std::shared_ptr<const NucTables> Map(const std::string &path,
+                                              std::string *error);
+
+  // Writes the tables to |path| through a temporary file next to it.
+  bool Save(const std::string &path) const;
+
+  uint32_t width() const { return width_; }
+  uint32_t height() const { return height_; }
+  const float *gain() const { return gain_; }
+  const float *offset() const { return offset_; }
+  bool mapped() const { return mapping_ != nullptr; }
+
+ private:
+  struct Mapping;
+  NucTables(uint32_t width, uint32_t height, std::unique_ptr<Mapping> mapping,
+            const float *gain, const float *offset);
+
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  std::vector<float> owned_gain_;
+  std::vector<float> owned_offset_;
+  std::unique_ptr<Mapping> mapping_;
+  const float *gain_ = nullptr;
+  const float *offset_ = nullptr;
+};
+
+// Averages |count| frames of |pixels| counts stored back to back in
+// |frames| into |mean|.
+void AverageFrames(const uint16_t *frames, size_t count, size_t pixels,
+                   float *mean);
+
+// Two-point calibration from the per-pixel means of a |cold| and a |hot|
+// flat field: every pixel is mapped onto the frame-wide mean response, so
+// both fields come out flat. Pixels that barely respond keep unity gain
+// and gains are limited to 1/4..4, leaving dead pixels to the bad-pixel
+// stage. Returns null if |hot| is not warmer than |cold| on average.
+std::shared_ptr<const NucTables> ComputeTwoPointNuc(const float *cold,
+                                                    const float *hot,
+                                                    uint32_t width,
+                                                    uint32_t height);
+
+// One-point (offset) calibration from the mean of a |flat| field: keeps
+// the gains of |base| (unity if null or of another size) and sets offsets
+// so |flat| comes out flat at the level |base| gave it.
+std::shared_ptr<const NucTables> ComputeOnePointNuc(const float *flat,
+                                                    const NucTables *base,
+                                                    uint32_t width,
+                                                    uint32_t height);
+
+}  // namespace uvc
+
+#endif  // UVC_NUC_TABLES_H_
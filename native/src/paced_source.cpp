@@ -0,0 +1,70 @@
+#include "paced_source.h"
+
+namespace uvc {
+
+void PacedSource::SetRate(uint32_t fps_numerator, uint32_t fps_denominator) {
+  if (fps_numerator == 0 || fps_denominator == 0) {
+    period_ = Clock::duration::zero();
+    return;
+  }
+  period_ = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(static_cast<double>(fps_denominator) /
+                                    fps_numerator));
+}
+
+bool PacedSource::Start() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  interrupted_ = false;
+  sequence_ = 0;
+  next_due_ = Clock::now();
+  return true;
+}
+
+SourceStatus PacedSource::Next(int timeout_ms, SourceFrame *frame) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  Clock::time_point now = Clock::now();
+  if (period_ > Clock::duration::zero()) {
+    Clock::time_point until = next_due_;
+    if (timeout_ms >= 0) {
+      until = std::min(until, now + std::chrono::milliseconds(timeout_ms));
+    }
+    wake_.wait_until(lock, until, [this] { return interrupted_; });
+    now = Clock::now();
+  }
+  if (interrupted_) {
+    interrupted_ = false;
+    return SourceStatus::kInterrupted;
+  }
+  if (now < next_due_) return SourceStatus::kTimeout;
+
+  // Paced frames are stamped with the time they were due rather than when
+  // the consumer got to them, so timestamps step in exact periods.
+  Clock::time_point due = now;
+  if (period_ > Clock::duration::zero()) {
+    const uint64_t missed =
+        static_cast<uint64_t>((now - next_due_) / period_);
+    sequence_ += missed;
+    due = next_due_ + period_ * static_cast<Clock::rep>(missed);
+    next_due_ = due + period_;
+  }
+  const uint64_t sequence = sequence_++;
+  lock.unlock();
+
+  const SourceStatus status = Produce(sequence, frame);
+  frame->sequence = sequence;
+  frame->timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         due.time_since_epoch())
+                         .count() /
+                     100;
+  return status;
+}
+
+void PacedSource::Interrupt() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    interrupted_ = true;
+  }
+  wake_.notify_all();
+}
+
+}  // namespace uvc
@@ -0,0 +1,47 @@
+#ifndef UVC_PACED_SOURCE_H_
+#define UVC_PACED_SOURCE_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#include "frame_source.h"
+
+namespace uvc {
+
+// Base of the virtual cameras: delivers frames on a steady-clock schedule
+// the way a camera's sensor clock would. A consumer that falls behind does
+// not slow the schedule down; the frames it missed are skipped and show up as
+// gaps in SourceFrame::sequence, like frames dropped by a real driver.
+class PacedSource : public FrameSource {
+ public:
+  bool Start() override;
+  void Stop() override {}
+  SourceStatus Next(int timeout_ms, SourceFrame *frame) final;
+  void Release(const SourceFrame &) override {}
+  void Interrupt() final;
+
+ protected:
+  // Frames per second as a fraction; a zero numerator produces frames as
+  // fast as they are consumed.
+  void SetRate(uint32_t fps_numerator, uint32_t fps_denominator);
+
+  // Fills data and stride of |frame| with frame number |sequence|. Returns
+  // kFrame, kEnd or kError. The data must stay valid until the next call.
+  virtual SourceStatus Produce(uint64_t sequence, SourceFrame *frame) = 0;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool interrupted_ = false;
+  Clock::duration period_{0};
+  Clock::time_point next_due_;
+  uint64_t sequence_ = 0;
+};
+
+}  // namespace uvc
+
+#endif  // UVC_PACED_SOURCE_H_
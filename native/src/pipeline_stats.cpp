@@ -0,0 +1,233 @@
+#include "pipeline_stats.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace uvc {
+
+namespace {
+
+constexpr size_t kSubBuckets = size_t{1} << LatencyHistogram::kSubBucketBits;
+
+// Capture latencies beyond this mean the source stamps frames on another
+// clock (Media Foundation may rebase timestamps to the stream start); they
+// are not recorded rather than polluting the histogram.
+constexpr int64_t kMaxPlausibleCapture100ns = 10 * 10000000LL;
+
+int HighestBit(uint64_t value) {
+  int bit = 0;
+  while (value >>= 1) bit++;
+  return bit;
+}
+
+// Single-writer increment: a plain load and store, no read-modify-write.
+template <typename T>
+void Bump(std::atomic<T> &value, T amount = 1) {
+  value.store(value.load(std::memory_order_relaxed) + amount,
+              std::memory_order_relaxed);
+}
+
+}  // namespace
+
+int64_t SteadyNow100ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+             .count() /
+         100;
+}
+
+size_t LatencyHistogram::BucketIndex(int64_t value) {
+  const uint64_t v = static_cast<uint64_t>(std::min(value, kMaxValue));
+  if (v < kSubBuckets) return static_cast<size_t>(v);
+  const int shift = HighestBit(v) - kSubBucketBits;
+  return kSubBuckets + (static_cast<size_t>(shift) << kSubBucketBits) +
+         static_cast<size_t>((v >> shift) - kSubBuckets);
+}
+
+int64_t LatencyHistogram::BucketUpperBound(size_t index) {
+  if (index < kSubBuckets) return static_cast<int64_t>(index);
+  const size_t shift = (index - kSubBuckets) >> kSubBucketBits;
+  const uint64_t mantissa = kSubBuckets + ((index - kSubBuckets) & (kSubBuckets - 1));
+  return static_cast<int64_t>(((mantissa + 1) << shift) - 1);
+}
+
+LatencyHistogram::LatencyHistogram()
+    : buckets_(new std::atomic<uint32_t>[kBucketCount]) {
+  for (size_t i = 0; i < kBucketCount; i++) {
+    buckets_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void LatencyHistogram::Record(int64_t value) {
+  if (value < 0) return;
+  Bump(buckets_[BucketIndex(value)]);
+  Bump(sum_, static_cast<uint64_t>(std::min(value, kMaxValue)));
+}
+
+void LatencyHistogram::Read(Snapshot *snapshot) const {
+  snapshot->buckets.resize(kBucketCount);
+  uint64_t count = 0;
+  for (size_t i = 0; i < kBucketCount; i++) {
+    snapshot->buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    count += snapshot->buckets[i];
+  }
+  // Counted from the buckets so percentiles always add up, even if the
+  // writer was halfway through a Record().
+  snapshot->count = count;
+  snapshot->sum = sum_.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::Snapshot::Mean() const {
+  return count != 0 ? static_cast<double>(sum) / count : 0.0;
+}
+
+int64_t LatencyHistogram::Snapshot::ValueAtQuantile(double quantile) const {
+  if (count == 0) return 0;
+  const double clamped = std::min(std::max(quantile, 0.0), 1.0);
+  const uint64_t rank = std::max<uint64_t>(
+      1, static_cast<uint64_t>(clamped * static_cast<double>(count) + 0.5));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets.size(); i++) {
+    seen += buckets[i];
+    if (seen >= rank) return BucketUpperBound(i);
+  }
+  return BucketUpperBound(buckets.size() - 1);
+}
+
+void LatencyHistogram::Snapshot::Subtract(const Snapshot &baseline) {
+  // Unsigned wrap-around keeps the difference right across overflow.
+  count = 0;
+  for (size_t i = 0; i < buckets.size(); i++) {
+    buckets[i] -= baseline.buckets[i];
+    count += buckets[i];
+  }
+  sum -= baseline.sum;
+}
+
+const char *PipelineStageName(PipelineStage stage) {
+  switch (stage) {
+    case PipelineStage::kCapture:
+      return "capture";
+    case PipelineStage::kConvert:
+      return "convert";
+    case PipelineStage::kLockWait:
+      return "lockWait";
+    case PipelineStage::kPresent:
+      return "present";
+    case PipelineStage::kEndToEnd:
+      return "endToEnd";
+  }
+  return "";
+}
+
+PipelineStats::PipelineStats() { Reset(); }
+
+void PipelineStats::OnFrameCaptured(const FrameInfo &info, int64_t arrival) {
+  Bump(captured_);
+  if (have_sequence_ && info.sequence > last_sequence_ + 1) {
+    Bump(dropped_source_, info.sequence - last_sequence_ - 1);
+  }
+  have_sequence_ = true;
+  last_sequence_ = info.sequence;
+
+  const int64_t latency = arrival - info.timestamp;
+  if (info.timestamp != 0 && latency >= 0 &&
+      latency < kMaxPlausibleCapture100ns) {
+    histograms_[static_cast<size_t>(PipelineStage::kCapture)].Record(latency *
+                                                                     100);
+  }
+}
+
+void PipelineStats::OnSourceRestarted() { have_sequence_ = false; }
+
+void PipelineStats::OnPoolExhausted() { Bump(dropped_pool_); }
+
+void PipelineStats::OnSkippedUnconsumed() { Bump(skipped_unconsumed_); }
+
+void PipelineStats::OnPublished() { Bump(published_); }
+
+void PipelineStats::OnNotified() { Bump(notified_); }
+
+void PipelineStats::Record(PipelineStage stage, int64_t nanoseconds) {
+  histograms_[static_cast<size_t>(stage)].Record(nanoseconds);
+}
+
+void PipelineStats::OnPresented(bool fresh, const FrameInfo &info,
+                                int64_t now) {
+  if (!fresh) {
+    Bump(duplicated_);
+    return;
+  }
+  Bump(presented_);
+  if (info.published != 0) {
+    histograms_[static_cast<size_t>(PipelineStage::kPresent)].Record(
+        (now - info.published) * 100);
+  }
+  const int64_t end_to_end = now - info.timestamp;
+  if (info.timestamp != 0 && end_to_end >= 0 &&
+      end_to_end < kMaxPlausibleCapture100ns) {
+    histograms_[static_cast<size_t>(PipelineStage::kEndToEnd)].Record(
+        end_to_end * 100);
+  }
+}
+
+void PipelineStats::ReadTotals(Totals *totals) const {
+  PipelineCounters &c = totals->counters;
+  c.captured = captured_.load(std::memory_order_relaxed);
+  c.published = published_.load(std::memory_order_relaxed);
+  c.presented = presented_.load(std::memory_order_relaxed);
+  c.duplicated = duplicated_.load(std::memory_order_relaxed);
+  c.dropped_source = dropped_source_.load(std::memory_order_relaxed);
+  c.dropped_pool = dropped_pool_.load(std::memory_order_relaxed);
+  c.skipped_unconsumed = skipped_unconsumed_.load(std::memory_order_relaxed);
+  c.notified = notified_.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < kPipelineStageCount; i++) {
+    histograms_[i].Read(&totals->stages[i]);
+  }
+}
+
+void PipelineStats::Read(PipelineStatsSnapshot *snapshot) {
+  std::lock_guard<std::mutex> lock(read_mutex_);
+  const int64_t now = SteadyNow100ns();
+  Totals totals;
+  ReadTotals(&totals);
+
+  PipelineCounters &c = snapshot->counters;
+  const PipelineCounters &base = baseline_.counters;
+  c.captured = totals.counters.captured - base.captured;
+  c.published = totals.counters.published - base.published;
+  c.presented = totals.counters.presented - base.presented;
+  c.duplicated = totals.counters.duplicated - base.duplicated;
+  c.dropped_source = totals.counters.dropped_source - base.dropped_source;
+  c.dropped_pool = totals.counters.dropped_pool - base.dropped_pool;
+  c.skipped_unconsumed =
+      totals.counters.skipped_unconsumed - base.skipped_unconsumed;
+  c.notified = totals.counters.notified - base.notified;
+  for (size_t i = 0; i < kPipelineStageCount; i++) {
+    snapshot->stages[i] = totals.stages[i];
+    snapshot->stages[i].Subtract(baseline_.stages[i]);
+  }
+
+  const double seconds = (now - last_read_time_) / 1e7;
+  snapshot->interval_seconds = seconds;
+  snapshot->capture_fps =
+      seconds > 0 ? (totals.counters.captured - last_read_captured_) / seconds
+                  : 0;
+  snapshot->present_fps =
+      seconds > 0
+          ? (totals.counters.presented - last_read_presented_) / seconds
+          : 0;
+  last_read_time_ = now;
+  last_read_captured_ = totals.counters.captured;
+  last_read_presented_ = totals.counters.presented;
+}
+
+void PipelineStats::Reset() {
+  std::lock_guard<std::mutex> lock(read_mutex_);
+  ReadTotals(&baseline_);
+  last_read_time_ = SteadyNow100ns();
+  last_read_captured_ = baseline_.counters.captured;
+  last_read_presented_ = baseline_.counters.presented;
+}
+
+}  // namespace uvc
@@ -0,0 +1,170 @@
+#ifndef UVC_PIPELINE_STATS_H_
+#define UVC_PIPELINE_STATS_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "frame_pool.h"
+
+namespace uvc {
+
+// Current time of the steady clock in 100 ns units, the unit of
+// FrameInfo::timestamp. On Linux this is CLOCK_MONOTONIC, which V4L2
+// drivers stamp buffers with; on Windows it is QueryPerformanceCounter,
+// which Media Foundation capture timestamps are derived from.
+int64_t SteadyNow100ns();
+
+// Log-linear histogram of durations in nanoseconds with about 3% relative
+// precision, in the spirit of HdrHistogram: 32 linear sub-buckets per power
+// of two, up to kMaxValue (about 18 minutes).
+//
+// Record() is wait-free and meant for a single writer thread; Read() may run
+// concurrently on any thread and sees a slightly stale but consistent-enough
+// copy, which is all a once-a-second stats pull needs.
+class LatencyHistogram {
+ public:
+  static constexpr int kSubBucketBits = 5;
+  static constexpr int64_t kMaxValue = (int64_t{1} << 40) - 1;
+  static constexpr size_t kBucketCount =
+      (40 - kSubBucketBits + 1) << kSubBucketBits;
+
+  // Bucket counts plus count / sum, as read or as a difference of two reads.
+  struct Snapshot {
+    std::vector<uint32_t> buckets = std::vector<uint32_t>(kBucketCount);
+    uint64_t count = 0;
+    uint64_t sum = 0;
+
+    double Mean() const;
+    // Smallest recorded value (bucket upper bound) that at least |quantile|
+    // (0..1) of the samples do not exceed. 0 when empty.
+    int64_t ValueAtQuantile(double quantile) const;
+    int64_t Max() const { return ValueAtQuantile(1.0); }
+    void Subtract(const Snapshot &baseline);
+  };
+
+  static size_t BucketIndex(int64_t value);
+  // Largest value that falls into |index|.
+  static int64_t BucketUpperBound(size_t index);
+
+  LatencyHistogram();
+
+  // Negative durations (clock mismatch) are dropped; larger ones clamp.
+  void Record(int64_t value);
+  void Read(Snapshot *snapshot) const;
+
+ private:
+  std::unique_ptr<std::atomic<uint32_t>[]> buckets_;
+  std::atomic<uint64_t> sum_{0};
+};
+
+// Per-stage timings of the capture path, each a LatencyHistogram.
+enum class PipelineStage {
+  // Sensor timestamp to the capture thread receiving the frame.
+  kCapture,
+  // Unpack / AGC / swizzle into the pooled display frame.
+  kConvert,
+  // Waiting for the lock that guards the latest-frame handles.
+  kLockWait,
+  // Marking the texture available to the engine copying the frame.
+  kPresent,
+  // Sensor timestamp to the engine copying the frame.
+  kEndToEnd,
+};
+constexpr size_t kPipelineStageCount = 5;
+
+// Name used for |stage| in getPipelineStats results.
+const char *PipelineStageName(PipelineStage stage);
+
+struct PipelineCounters {
+  uint64_t captured = 0;       // Frames received from the source.
+  uint64_t published = 0;      // Frames converted and handed to the texture.
+  uint64_t presented = 0;      // Distinct frames the engine copied.
+  uint64_t duplicated = 0;     // Engine copies that found no new frame.
+  uint64_t dropped_source = 0; // Sequence gaps: lost before reaching us.
+  uint64_t dropped_pool = 0;   // No free buffer, frame discarded.
+  // Not converted because the engine had yet to copy the previous frame.
+  uint64_t skipped_unconsumed = 0;
+  // Texture-available notifications sent; published - notified were
+  // coalesced into an outstanding one.
+  uint64_t notified = 0;
+};
+
+struct PipelineStatsSnapshot {
+  PipelineCounters counters;
+  std::array<LatencyHistogram::Snapshot, kPipelineStageCount> stages;
+  // Rates over the time since the previous Read(), or since Reset().
+  double capture_fps = 0;
+  double present_fps = 0;
+  double interval_seconds = 0;
+};
+
+// Telemetry for one capture pipeline. The capture thread and the engine's
+// raster thread record into it without locks; the platform thread pulls
+// snapshots with Read(), which is cheap enough to call every second.
+//
+// Reset() does not touch what the writers own: it stores the current totals
+// as a baseline that later reads subtract.
+class PipelineStats {
+ public:
+  PipelineStats();
+
+  // Capture thread.
+  //
+  // A frame arrived from the source at |arrival| (SteadyNow100ns()). Records
+  // the capture latency when the frame's timestamp is on the same clock, and
+  // counts sequence gaps as source drops. Call OnSourceRestarted() when a new
+  // stream starts so its first sequence number is not taken as a gap.
+  void OnFrameCaptured(const FrameInfo &info, int64_t arrival);
+  void OnSourceRestarted();
+  void OnPoolExhausted();
+  void OnSkippedUnconsumed();
+  void OnPublished();
+  void OnNotified();
+  // |nanoseconds| spent in |stage|; kCapture, kPresent and kEndToEnd are
+  // recorded by the other methods.
+  void Record(PipelineStage stage, int64_t nanoseconds);
+
+  // Raster thread. |fresh| is whether the engine got a new frame; |info|
+  // describes the frame it copies at |now|.
+  void OnPresented(bool fresh, const FrameInfo &info, int64_t now);
+
+  // Any thread.
+  void Read(PipelineStatsSnapshot *snapshot);
+  void Reset();
+
+ private:
+  struct Totals {
+    PipelineCounters counters;
+    std::array<LatencyHistogram::Snapshot, kPipelineStageCount> stages;
+  };
+  void ReadTotals(Totals *totals) const;
+
+  std::array<LatencyHistogram, kPipelineStageCount> histograms_;
+  std::atomic<uint64_t> captured_{0};
+  std::atomic<uint64_t> published_{0};
+  std::atomic<uint64_t> presented_{0};
+  std::atomic<uint64_t> duplicated_{0};
+  std::atomic<uint64_t> dropped_source_{0};
+  std::atomic<uint64_t> dropped_pool_{0};
+  std::atomic<uint64_t> skipped_unconsumed_{0};
+  std::atomic<uint64_t> notified_{0};
+  // Capture thread only.
+  bool have_sequence_ = false;
+  uint64_t last_sequence_ = 0;
+
+  // Guards the reader state below.
+  std::mutex read_mutex_;
+  Totals baseline_;
+  int64_t last_read_time_ = 0;
+  uint64_t last_read_captured_ = 0;
+  uint64_t last_read_presented_ = 0;
+};
+
+}  // namespace uvc
+
+#endif  // UVC_PIPELINE_STATS_H_
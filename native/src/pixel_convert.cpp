@@ -0,0 +1,279 @@
+#include "pixel_convert.h"
+
+#include <cstring>
+
+#if defined(UVC_ARCH_X86)
+#include <immintrin.h>
+#elif defined(UVC_ARCH_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace uvc {
+
+namespace {
+
+// |alpha| is OR-ed into every output pixel: 0 keeps the source alpha,
+// 0xFF000000 forces it opaque.
+using RowFn = void (*)(const uint8_t *src, uint8_t *dst, size_t width,
+                       uint32_t alpha);
+
+// Table-mapping rows: |lut| holds the B, G and R tables described at
+// ConvertBgraToRgbaLut().
+using LutRowFn = void (*)(const uint8_t *src, uint8_t *dst, size_t width,
+                          const uint32_t *lut, uint32_t alpha);
+
+constexpr uint32_t kOpaqueAlpha = 0xFF000000u;
+
+// Swaps bytes 0 and 2 of each little-endian pixel word, leaving G and A.
+inline uint32_t SwapRedBlue(uint32_t v) {
+  return (v & 0xFF00FF00u) | ((v >> 16) & 0xFFu) | ((v & 0xFFu) << 16);
+}
+
+void BgraToRgbaRowScalar(const uint8_t *src, uint8_t *dst, size_t width,
+                         uint32_t alpha) {
+  for (size_t x = 0; x < width; x++) {
+    uint32_t v;
+    std::memcpy(&v, src + x * 4, 4);
+    v = SwapRedBlue(v) | alpha;
+    std::memcpy(dst + x * 4, &v, 4);
+  }
+}
+
+void BgraToRgbaLutRowScalar(const uint8_t *src, uint8_t *dst, size_t width,
+                            const uint32_t *lut, uint32_t alpha) {
+  const uint32_t *lut_b = lut;
+  const uint32_t *lut_g = lut + 256;
+  const uint32_t *lut_r = lut + 512;
+  for (size_t x = 0; x < width; x++) {
+    const uint8_t *p = src + x * 4;
+    const uint32_t v = lut_b[p[0]] | lut_g[p[1]] | lut_r[p[2]] |
+                       (static_cast<uint32_t>(p[3]) << 24) | alpha;
+    std::memcpy(dst + x * 4, &v, 4);
+  }
+}
+
+#if defined(UVC_ARCH_X86)
+UVC_TARGET_SSSE3 void BgraToRgbaRowSsse3(const uint8_t *src, uint8_t *dst,
+                                         size_t width, uint32_t alpha) {
+  const __m128i mask =
+      _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  const __m128i a_or = _mm_set1_epi32(static_cast<int>(alpha));
+  size_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const __m128i *s = reinterpret_cast<const __m128i *>(src + x * 4);
+    __m128i *d = reinterpret_cast<__m128i *>(dst + x * 4);
+    __m128i a = _mm_loadu_si128(s + 0);
+    __m128i b = _mm_loadu_si128(s + 1);
+    __m128i c = _mm_loadu_si128(s + 2);
+    __m128i e = _mm_loadu_si128(s + 3);
+    _mm_storeu_si128(d + 0, _mm_or_si128(_mm_shuffle_epi8(a, mask), a_or));
+    _mm_storeu_si128(d + 1, _mm_or_si128(_mm_shuffle_epi8(b, mask), a_or));
+    _mm_storeu_si128(d + 2, _mm_or_si128(_mm_shuffle_epi8(c, mask), a_or));
+    _mm_storeu_si128(d + 3, _mm_or_si128(_mm_shuffle_epi8(e, mask), a_or));
+  }
+  for (; x + 4 <= width; x += 4) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4),
+                     _mm_or_si128(_mm_shuffle_epi8(a, mask), a_or));
+  }
+  BgraToRgbaRowScalar(src + x * 4, dst + x * 4, width - x, alpha);
+}
+
+UVC_TARGET_AVX2 void BgraToRgbaRowAvx2(const uint8_t *src, uint8_t *dst,
+                                       size_t width, uint32_t alpha) {
+  // vpshufb shuffles within each 128-bit lane, so the mask repeats.
+  const __m256i mask = _mm256_setr_epi8(
+      2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+      2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  const __m256i a_or = _mm256_set1_epi32(static_cast<int>(alpha));
+  size_t x = 0;
+  for (; x + 32 <= width; x += 32) {
+    const __m256i *s = reinterpret_cast<const __m256i *>(src + x * 4);
+    __m256i *d = reinterpret_cast<__m256i *>(dst + x * 4);
+    __m256i a = _mm256_loadu_si256(s + 0);
+    __m256i b = _mm256_loadu_si256(s + 1);
+    __m256i c = _mm256_loadu_si256(s + 2);
+    __m256i e = _mm256_loadu_si256(s + 3);
+    _mm256_storeu_si256(d + 0,
+                        _mm256_or_si256(_mm256_shuffle_epi8(a, mask), a_or));
+    _mm256_storeu_si256(d + 1,
+                        _mm256_or_si256(_mm256_shuffle_epi8(b, mask), a_or));
+    _mm256_storeu_si256(d + 2,
+                        _mm256_or_si256(_mm256_shuffle_epi8(c, mask), a_or));
+    _mm256_storeu_si256(d + 3,
+                        _mm256_or_si256(_mm256_shuffle_epi8(e, mask), a_or));
+  }
+  for (; x + 8 <= width; x += 8) {
+    __m256i a =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x * 4));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x * 4),
+                        _mm256_or_si256(_mm256_shuffle_epi8(a, mask), a_or));
+  }
+  BgraToRgbaRowScalar(src + x * 4, dst + x * 4, width - x, alpha);
+}
+
+// Eight pixels per step: one gather per channel, with the channel's source
+// byte as the index. The tables already place each entry at its RGBA byte,
+// so the three results and the alpha only need OR-ing.
+UVC_TARGET_AVX2 void BgraToRgbaLutRowAvx2(const uint8_t *src, uint8_t *dst,
+                                          size_t width, const uint32_t *lut,
+                                          uint32_t alpha) {
+  const int *lut_b = reinterpret_cast<const int *>(lut);
+  const int *lut_g = lut_b + 256;
+  const int *lut_r = lut_b + 512;
+  const __m256i low_byte = _mm256_set1_epi32(0xFF);
+  const __m256i alpha_mask = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+  const __m256i a_or = _mm256_set1_epi32(static_cast<int>(alpha));
+  size_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const __m256i px =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x * 4));
+    const __m256i b =
+        _mm256_i32gather_epi32(lut_b, _mm256_and_si256(px, low_byte), 4);
+    const __m256i g = _mm256_i32gather_epi32(
+        lut_g, _mm256_and_si256(_mm256_srli_epi32(px, 8), low_byte), 4);
+    const __m256i r = _mm256_i32gather_epi32(
+        lut_r, _mm256_and_si256(_mm256_srli_epi32(px, 16), low_byte), 4);
+    const __m256i a = _mm256_or_si256(_mm256_and_si256(px, alpha_mask), a_or);
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(dst + x * 4),
+        _mm256_or_si256(_mm256_or_si256(b, g), _mm256_or_si256(r, a)));
+  }
+  BgraToRgbaLutRowScalar(src + x * 4, dst + x * 4, width - x, lut, alpha);
+}
+#endif  // UVC_ARCH_X86
+
+#if defined(UVC_ARCH_NEON)
+void BgraToRgbaRowNeon(const uint8_t *src, uint8_t *dst, size_t width,
+                       uint32_t alpha) {
+  const uint8x16_t a_or = vdupq_n_u8(static_cast<uint8_t>(alpha >> 24));
+  size_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint8x16x4_t px = vld4q_u8(src + x * 4);
+    uint8x16_t b = px.val[0];
+    px.val[0] = px.val[2];
+    px.val[2] = b;
+    px.val[3] = vorrq_u8(px.val[3], a_or);
+    vst4q_u8(dst + x * 4, px);
+  }
+  BgraToRgbaRowScalar(src + x * 4, dst + x * 4, width - x, alpha);
+}
+#endif  // UVC_ARCH_NEON
+
+RowFn SelectRowFn(SimdLevel level) {
+  switch (level) {
+#if defined(UVC_ARCH_X86)
+    case SimdLevel::kAvx2:
+      return BgraToRgbaRowAvx2;
+    case SimdLevel::kSsse3:
+      return BgraToRgbaRowSsse3;
+#endif
+#if defined(UVC_ARCH_NEON)
+    case SimdLevel::kNeon:
+      return BgraToRgbaRowNeon;
+#endif
+    default:
+      return BgraToRgbaRowScalar;
+  }
+}
+
+// SSSE3 and NEON have no gather; a 256-entry lookup in byte shuffles costs
+// more than the scalar loads.
+LutRowFn SelectLutRowFn(SimdLevel level) {
+  switch (level) {
+#if defined(UVC_ARCH_X86)
+    case SimdLevel::kAvx2:
+      return BgraToRgbaLutRowAvx2;
+#endif
+    default:
+      return BgraToRgbaLutRowScalar;
+  }
+}
+
+void ConvertRows(RowFn row, const uint8_t *src, ptrdiff_t src_stride,
+                 uint8_t *dst, ptrdiff_t dst_stride, size_t width,
+                 size_t height, uint32_t alpha) {
+  const size_t row_bytes = width * 4;
+  if (src_stride == static_cast<ptrdiff_t>(row_bytes) &&
+      dst_stride == static_cast<ptrdiff_t>(row_bytes)) {
+    // Both images are contiguous: treat them as a single long row.
+    row(src, dst, width * height, alpha);
+    return;
+  }
+  for (size_t y = 0; y < height; y++) {
+    row(src, dst, width, alpha);
+    src += src_stride;
+    dst += dst_stride;
+  }
+}
+
+}  // namespace
+
+void ConvertBgraToRgba(const uint8_t *src, ptrdiff_t src_stride, uint8_t *dst,
+                       ptrdiff_t dst_stride, size_t width, size_t height) {
+  ConvertRows(SelectRowFn(GetSimdLevel()), src, src_stride, dst, dst_stride,
+              width, height, 0);
+}
+
+void ConvertBgraToRgbaWithLevel(SimdLevel level, const uint8_t *src,
+                                ptrdiff_t src_stride, uint8_t *dst,
+                                ptrdiff_t dst_stride, size_t width,
+                                size_t height) {
+  ConvertRows(SelectRowFn(level), src, src_stride, dst, dst_stride, width,
+              height, 0);
+}
+
+void ConvertBgrxToRgba(const uint8_t *src, ptrdiff_t src_stride, uint8_t *dst,
+                       ptrdiff_t dst_stride, size_t width, size_t height) {
+  ConvertRows(SelectRowFn(GetSimdLevel()), src, src_stride, dst, dst_stride,
+              width, height, kOpaqueAlpha);
+}
+
+void ConvertBgrxToRgbaWithLevel(SimdLevel level, const uint8_t *src,
+                                ptrdiff_t src_stride, uint8_t *dst,
+                                ptrdiff_t dst_stride, size_t width,
+                                size_t height) {
+  ConvertRows(SelectRowFn(level), src, src_stride, dst, dst_stride, width,
+              height, kOpaqueAlpha);
+}
+
+void ConvertBgraToRgbaLut(const uint8_t *src, ptrdiff_t src_stride,
+                          uint8_t *dst, ptrdiff_t dst_stride, size_t width,
+                          size_t height, const uint32_t *lut, bool opaque) {
+  ConvertBgraToRgbaLutWithLevel(GetSimdLevel(), src, src_stride, dst,
+                                dst_stride, width, height, lut, opaque);
+}
+
+void ConvertBgraToRgbaLutWithLevel(SimdLevel level, const uint8_t *src,
+                                   ptrdiff_t src_stride, uint8_t *dst,
+                                   ptrdiff_t dst_stride, size_t width,
+                                   size_t height, const uint32_t *lut,
+                                   bool opaque) {
+  const LutRowFn row = SelectLutRowFn(level);
+  const uint32_t alpha = opaque ? kOpaqueAlpha : 0;
+  const size_t row_bytes = width * 4;
+  if (src_stride == static_cast<ptrdiff_t>(row_bytes) &&
+      dst_stride == static_cast<ptrdiff_t>(row_bytes)) {
+    row(src, dst, width * height, lut, alpha);
+    return;
+  }
+  for (size_t y = 0; y < height; y++) {
+    row(src, dst, width, lut, alpha);
+    src += src_stride;
+    dst += dst_stride;
+  }
+}
+
+void ApplyCurveToRgba(uint8_t *rgba, ptrdiff_t stride, size_t width,
+                      size_t height, const uint8_t *curve) {
+  for (size_t y = 0; y < height; y++) {
+    uint8_t *p = rgba + static_cast<ptrdiff_t>(y) * stride;
+    for (size_t x = 0; x < width; x++, p += 4) {
+      p[0] = curve[p[0]];
+      p[1] = curve[p[1]];
+      p[2] = curve[p[2]];
+    }
+  }
+}
+
+}  // namespace uvc
@@ -0,0 +1,65 @@
+#ifndef UVC_PIXEL_CONVERT_H_
+#define UVC_PIXEL_CONVERT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "cpu_features.h"
+
+namespace uvc {
+
+// Converts |height| rows of |width| BGRA pixels (Media Foundation RGB32) to
+// RGBA as expected by FlutterDesktopPixelBuffer.
+//
+// |src| points at the first row of the image and |src_stride| is the signed
+// byte offset from one row to the next, exactly as returned by
+// IMF2DBuffer::Lock2D: positive for top-down buffers, negative for bottom-up
+// buffers whose first image row is the last one in memory. |dst_stride| is
+// usually width * 4. Source and destination must not overlap.
+//
+// Dispatches to the best kernel for GetSimdLevel().
+void ConvertBgraToRgba(const uint8_t *src, ptrdiff_t src_stride, uint8_t *dst,
+                       ptrdiff_t dst_stride, size_t width, size_t height);
+
+// Same conversion, forced onto a specific kernel. Falls back to scalar when
+// |level| is not compiled in for this architecture. Callers must make sure
+// the CPU supports |level|; this exists for tests and benchmarks.
+void ConvertBgraToRgbaWithLevel(SimdLevel level, const uint8_t *src,
+                                ptrdiff_t src_stride, uint8_t *dst,
+                                ptrdiff_t dst_stride, size_t width,
+                                size_t height);
+
+// Same as ConvertBgraToRgba but writes 255 to every alpha byte, for sources
+// whose fourth byte is padding or an alpha the driver leaves at 0 (V4L2
+// XBGR32/ABGR32).
+void ConvertBgrxToRgba(const uint8_t *src, ptrdiff_t src_stride, uint8_t *dst,
+                       ptrdiff_t dst_stride, size_t width, size_t height);
+void ConvertBgrxToRgbaWithLevel(SimdLevel level, const uint8_t *src,
+                                ptrdiff_t src_stride, uint8_t *dst,
+                                ptrdiff_t dst_stride, size_t width,
+                                size_t height);
+
+// Converts like ConvertBgraToRgba(), or ConvertBgrxToRgba() when |opaque|,
+// while mapping B, G and R through |lut| in the same pass: three 256-entry
+// tables for source bytes 0, 1 and 2 whose entries already sit at the
+// channel's RGBA byte (ToneCurve::swizzle_lut()). One lookup per channel and
+// one store per pixel: AVX2 gathers eight pixels' entries at a time, the
+// other levels look them up one by one.
+void ConvertBgraToRgbaLut(const uint8_t *src, ptrdiff_t src_stride,
+                          uint8_t *dst, ptrdiff_t dst_stride, size_t width,
+                          size_t height, const uint32_t *lut, bool opaque);
+void ConvertBgraToRgbaLutWithLevel(SimdLevel level, const uint8_t *src,
+                                   ptrdiff_t src_stride, uint8_t *dst,
+                                   ptrdiff_t dst_stride, size_t width,
+                                   size_t height, const uint32_t *lut,
+                                   bool opaque);
+
+// Maps R, G and B of RGBA pixels through the 256-entry |curve| in place.
+// The converters and the JPEG decoder take the curve themselves; this
+// separate pass is the reference they are tested and benchmarked against.
+void ApplyCurveToRgba(uint8_t *rgba, ptrdiff_t stride, size_t width,
+                      size_t height, const uint8_t *curve);
+
+}  // namespace uvc
+
+#endif  // UVC_PIXEL_CONVERT_H_
@@ -0,0 +1,67 @@
+#include "raw_convert.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace uvc {
+
+int RawBitDepth(RawPacking packing) {
+  switch (packing) {
+    case RawPacking::kY14:
+      return 14;
+    case RawPacking::kY16:
+    case RawPacking::kYuy2Raw16:
+      return 16;
+    case RawPacking::kNone:
+      break;
+  }
+  return 0;
+}
+
+void UnpackRaw16(RawPacking packing, const uint8_t *src, ptrdiff_t src_stride,
+                 uint16_t *dst, size_t width, size_t height) {
+  const size_t row_bytes = width * sizeof(uint16_t);
+  for (size_t y = 0; y < height; y++) {
+    // Every supported packing is little-endian 16-bit, like the host, so
+    // unpacking is a row copy plus an optional mask.
+    std::memcpy(dst, src, row_bytes);
+    if (packing == RawPacking::kY14) {
+      for (size_t x = 0; x < width; x++) dst[x] &= 0x3FFF;
+    }
+    src += src_stride;
+    dst += width;
+  }
+}
+
+Range16 ComputeMinMax16(const uint16_t *src, size_t count) {
+  if (count == 0) return Range16{0, 0};
+  // Separate accumulators keep the loop free of dependencies so compilers
+  // vectorize it into packed min/max instructions.
+  uint16_t lo = 0xFFFF, hi = 0;
+  for (size_t i = 0; i < count; i++) {
+    lo = std::min(lo, src[i]);
+    hi = std::max(hi, src[i]);
+  }
+  return Range16{lo, hi};
+}
+
+void ConvertGray16ToRgba(const uint16_t *src, size_t src_stride_pixels,
+                         uint8_t *dst, ptrdiff_t dst_stride, size_t width,
+                         size_t height, uint16_t low, uint16_t high) {
+  const uint32_t range = high > low ? static_cast<uint32_t>(high - low) : 1;
+  // 16.16 fixed-point factor taking [0, range] onto [0, 255].
+  const uint32_t scale = (255u << 16) / range;
+  for (size_t y = 0; y < height; y++) {
+    const uint16_t *s = src + y * src_stride_pixels;
+    uint8_t *d = dst + static_cast<ptrdiff_t>(y) * dst_stride;
+    for (size_t x = 0; x < width; x++) {
+      uint32_t v = s[x] > low ? static_cast<uint32_t>(s[x] - low) : 0;
+      v = std::min(v, range);
+      const uint32_t grey = std::min<uint32_t>((v * scale + 0x8000) >> 16, 255);
+      const uint32_t rgba = grey | (grey << 8) | (grey << 16) | 0xFF000000u;
+      std::memcpy(d + x * 4, &rgba, 4);
+    }
+  }
+}
+
+}  // namespace uvc
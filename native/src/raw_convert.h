@@ -0,0 +1,49 @@
+#ifndef UVC_RAW_CONVERT_H_
+#define UVC_RAW_CONVERT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace uvc {
+
+// How a camera delivers raw sensor counts.
+enum class RawPacking {
+  kNone,
+  // 'Y16 ' / L16: one little-endian 16-bit count per pixel.
+  kY16,
+  // 'Y14 ': 14 significant bits in a 16-bit little-endian word. The unused
+  // top bits are not guaranteed to be zero and are masked off.
+  kY14,
+  // Thermal cores that reuse the YUY2 subtype as a transport for one 16-bit
+  // little-endian count per pixel instead of luma/chroma pairs.
+  kYuy2Raw16,
+};
+
+// Number of significant bits in the unpacked counts.
+int RawBitDepth(RawPacking packing);
+
+// Copies |height| rows of |width| raw pixels into a tightly packed uint16_t
+// frame. |src_stride| is the signed byte offset between rows, as returned by
+// IMF2DBuffer::Lock2D (negative for bottom-up buffers).
+void UnpackRaw16(RawPacking packing, const uint8_t *src, ptrdiff_t src_stride,
+                 uint16_t *dst, size_t width, size_t height);
+
+// Smallest and largest count in a tightly packed frame of |count| pixels.
+// Returns {0, 0} for an empty frame.
+struct Range16 {
+  uint16_t min;
+  uint16_t max;
+};
+Range16 ComputeMinMax16(const uint16_t *src, size_t count);
+
+// Display stage for raw frames: maps counts linearly so that |low| becomes
+// black and |high| white (values outside are clamped) and writes opaque grey
+// RGBA. |dst_stride| is in bytes. A degenerate window (high <= low) splits
+// at |low|.
+void ConvertGray16ToRgba(const uint16_t *src, size_t src_stride_pixels,
+                         uint8_t *dst, ptrdiff_t dst_stride, size_t width,
+                         size_t height, uint16_t low, uint16_t high);
+
+}  // namespace uvc
+
+#endif  // UVC_RAW_CONVERT_H_
@@ -0,0 +1,181 @@
+#include "replay_source.h"
+
+#include <cstring>
+
+namespace uvc {
+
+const char kRecordingMagic[8] = {'U', 'V', 'C', 'R', 'E', 'C', '1', '\0'};
+
+namespace {
+
+bool Seek(std::FILE *file, uint64_t offset) {
+#if defined(_WIN32)
+  return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+  return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+uint64_t FileSize(std::FILE *file) {
+#if defined(_WIN32)
+  if (_fseeki64(file, 0, SEEK_END) != 0) return 0;
+  const __int64 size = _ftelli64(file);
+#else
+  if (fseeko(file, 0, SEEK_END) != 0) return 0;
+  const off_t size = ftello(file);
+#endif
+  return size > 0 ? static_cast<uint64_t>(size) : 0;
+}
+
+}  // namespace
+
+size_t SourceBytesPerPixel(SourcePixelFormat format) {
+  switch (format) {
+    case SourcePixelFormat::kBgra32:
+      return 4;
+    case SourcePixelFormat::kYuyv:
+    case SourcePixelFormat::kGray16:
+    case SourcePixelFormat::kUyvy:
+      return 2;
+    case SourcePixelFormat::kNv12:
+      return 1;
+    case SourcePixelFormat::kMjpeg:
+      break;
+  }
+  return 0;
+}
+
+size_t SourceFrameRows(SourcePixelFormat format, uint32_t height) {
+  return format == SourcePixelFormat::kNv12 ? height + height / 2 : height;
+}
+
+RecordingWriter::~RecordingWriter() { Close(); }
+
+bool RecordingWriter::Open(const std::string &path, const SourceMode &mode) {
+  Close();
+  // Frames of variable size do not fit the layout.
+  if (SourceBytesPerPixel(mode.format) == 0) return false;
+  file_ = std::fopen(path.c_str(), "wb");
+  if (file_ == nullptr) return false;
+  header_ = RecordingHeader{};
+  std::memcpy(header_.magic, kRecordingMagic, sizeof(header_.magic));
+  header_.version = kRecordingVersion;
+  header_.format = static_cast<uint32_t>(mode.format);
+  header_.width = mode.width;
+  header_.height = mode.height;
+  header_.bit_depth = static_cast<uint32_t>(mode.bit_depth);
+  header_.fps_numerator = mode.fps_numerator;
+  header_.fps_denominator = mode.fps_denominator;
+  failed_ = std::fwrite(&header_, sizeof(header_), 1, file_) != 1;
+  return !failed_;
+}
+
+bool RecordingWriter::Append(const uint8_t *data, ptrdiff_t stride) {
+  if (file_ == nullptr || failed_) return false;
+  const size_t row_bytes =
+      header_.width *
+      SourceBytesPerPixel(static_cast<SourcePixelFormat>(header_.format));
+  const size_t rows = SourceFrameRows(
+      static_cast<SourcePixelFormat>(header_.format), header_.height);
+  for (size_t y = 0; y < rows; y++) {
+    const uint8_t *row = data + static_cast<ptrdiff_t>(y) * stride;
+    if (std::fwrite(row, 1, row_bytes, file_) != row_bytes) {
+      failed_ = true;
+      return false;
+    }
+  }
+  header_.frame_count++;
+  return true;
+}
+
+bool RecordingWriter::Close() {
+  if (file_ == nullptr) return false;
+  if (!failed_) {
+    failed_ = std::fseek(file_, 0, SEEK_SET) != 0 ||
+              std::fwrite(&header_, sizeof(header_), 1, file_) != 1;
+  }
+  failed_ |= std::fclose(file_) != 0;
+  file_ = nullptr;
+  return !failed_;
+}
+
+ReplaySource::ReplaySource(const std::string &path, uint32_t fps, bool loop)
+    : path_(path), fps_(fps), loop_(loop) {}
+
+ReplaySource::~ReplaySource() { Stop(); }
+
+bool ReplaySource::Open() {
+  Stop();
+  file_ = std::fopen(path_.c_str(), "rb");
+  if (file_ == nullptr) return false;
+
+  RecordingHeader header{};
+  const bool valid =
+      std::fread(&header, sizeof(header), 1, file_) == 1 &&
+      std::memcmp(header.magic, kRecordingMagic, sizeof(header.magic)) == 0 &&
+      header.version == kRecordingVersion &&
+      header.format <= static_cast<uint32_t>(SourcePixelFormat::kNv12) &&
+      header.width > 0 && header.height > 0;
+  if (!valid) {
+    Stop();
+    return false;
+  }
+
+  mode_.format = static_cast<SourcePixelFormat>(header.format);
+  mode_.width = header.width;
+  mode_.height = header.height;
+  mode_.bit_depth = static_cast<int>(header.bit_depth);
+  mode_.fps_numerator = fps_ != 0 ? fps_ : header.fps_numerator;
+  mode_.fps_denominator = fps_ != 0 ? 1 : header.fps_denominator;
+  frame_bytes_ = static_cast<size_t>(header.width) *
+                 SourceFrameRows(mode_.format, header.height) *
+                 SourceBytesPerPixel(mode_.format);
+
+  frame_count_ = header.frame_count;
+  if (frame_count_ == 0) {
+    frame_count_ = (FileSize(file_) - sizeof(header)) / frame_bytes_;
+  }
+  position_ = frame_count_;  // Forces a seek to the first frame.
+  frame_.resize(frame_bytes_);
+  SetRate(mode_.fps_numerator, mode_.fps_denominator);
+  return true;
+}
+
+bool ReplaySource::Start() {
+  if (file_ == nullptr && !Open()) return false;
+  if (frame_count_ == 0) return false;
+  return PacedSource::Start();
+}
+
+void ReplaySource::Stop() {
+  if (file_ != nullptr) {
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+SourceStatus ReplaySource::Produce(uint64_t sequence, SourceFrame *frame) {
+  // Frames the consumer was too slow for are skipped in the file too, so
+  // the recording keeps its real-time speed.
+  uint64_t wanted = sequence;
+  if (wanted >= frame_count_) {
+    if (!loop_) return SourceStatus::kEnd;
+    wanted %= frame_count_;
+  }
+  if (wanted != position_ &&
+      !Seek(file_, sizeof(RecordingHeader) + wanted * frame_bytes_)) {
+    return SourceStatus::kError;
+  }
+  if (std::fread(frame_.data(), 1, frame_bytes_, file_) != frame_bytes_) {
+    return SourceStatus::kError;
+  }
+  position_ = wanted + 1;
+
+  frame->data = frame_.data();
+  frame->stride =
+      static_cast<ptrdiff_t>(mode_.width * SourceBytesPerPixel(mode_.format));
+  frame->index = static_cast<uint32_t>(wanted);
+  return SourceStatus::kFrame;
+}
+
+}  // namespace uvc
@@ -0,0 +1,100 @@
+#ifndef UVC_REPLAY_SOURCE_H_
+#define UVC_REPLAY_SOURCE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "paced_source.h"
+
+namespace uvc {
+
+// On-disk layout of a recording (.uvcrec): this header, then frame_count
+// tightly packed frames of width * height pixels in |format| (see
+// SourceFrameRows()). All fields are
+// little-endian.
+struct RecordingHeader {
+  char magic[8];  // kRecordingMagic.
+  uint32_t version;
+  uint32_t format;  // SourcePixelFormat.
+  uint32_t width;
+  uint32_t height;
+  uint32_t bit_depth;
+  uint32_t fps_numerator;
+  uint32_t fps_denominator;
+  uint32_t reserved;
+  // 0 when the writer did not finish; readers then use the file size.
+  uint64_t frame_count;
+};
+static_assert(sizeof(RecordingHeader) == 48, "recording header layout");
+
+extern const char kRecordingMagic[8];
+constexpr uint32_t kRecordingVersion = 1;
+
+// Bytes per pixel of |format|; for kNv12, of its Y plane. 0 for kMjpeg,
+// which cannot be recorded.
+size_t SourceBytesPerPixel(SourcePixelFormat format);
+// Rows of width * SourceBytesPerPixel() bytes in a frame |height| pixels
+// tall: kNv12 carries its UV plane as |height| / 2 more.
+size_t SourceFrameRows(SourcePixelFormat format, uint32_t height);
+
+// Writes frames of one SourceMode to a recording file.
+class RecordingWriter {
+ public:
+  RecordingWriter() = default;
+  ~RecordingWriter();
+  RecordingWriter(const RecordingWriter &) = delete;
+  RecordingWriter &operator=(const RecordingWriter &) = delete;
+
+  bool Open(const std::string &path, const SourceMode &mode);
+  // Appends one frame whose rows are |stride| bytes apart.
+  bool Append(const uint8_t *data, ptrdiff_t stride);
+  // Writes the final frame count. Returns false if any write failed.
+  bool Close();
+
+  uint64_t frame_count() const { return header_.frame_count; }
+
+ private:
+  std::FILE *file_ = nullptr;
+  RecordingHeader header_{};
+  bool failed_ = false;
+};
+
+// Plays a recording back as a FrameSource, paced at the recorded rate
+// unless |fps| overrides it (0 keeps the recorded rate). A finite
+// recording ends with SourceStatus::kEnd unless |loop| is set.
+class ReplaySource : public PacedSource {
+ public:
+  ReplaySource(const std::string &path, uint32_t fps, bool loop);
+  ~ReplaySource() override;
+
+  // Reads the header so mode() is valid before Start(). Returns false if
+  // the file is missing or not a recording.
+  bool Open();
+
+  SourceMode mode() const override { return mode_; }
+  bool Start() override;
+  void Stop() override;
+
+  uint64_t frame_count() const { return frame_count_; }
+
+ protected:
+  SourceStatus Produce(uint64_t sequence, SourceFrame *frame) override;
+
+ private:
+  std::string path_;
+  uint32_t fps_;
+  bool loop_;
+  std::FILE *file_ = nullptr;
+  SourceMode mode_;
+  size_t frame_bytes_ = 0;
+  uint64_t frame_count_ = 0;
+  uint64_t position_ = 0;  // Next frame to read.
+  std::vector<uint8_t> frame_;
+};
+
+}  // namespace uvc
+
+#endif  // UVC_REPLAY_SOURCE_H_
@@ -0,0 +1,388 @@
+#include "roi_engine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+
+#include "cpu_features.h"
+
+#if defined(UVC_ARCH_X86)
+#include <immintrin.h>
+#elif defined(UVC_ARCH_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace uvc {
+
+namespace {
+
+// Values a kernel reduces per call: few enough that each 32-bit lane of the
+// running sum stays below 2^32.
+constexpr size_t kMaxRun = 65536;
+
+struct RunStats {
+  uint16_t min = std::numeric_limits<uint16_t>::max();
+  uint16_t max = 0;
+  uint64_t sum = 0;
+  uint64_t sum_sq = 0;
+};
+
+// Folds |n| values, n <= kMaxRun, into |stats|.
+using RunStatsFn = void (*)(const uint16_t *values, size_t n,
+                            RunStats *stats);
+
+void RunStatsScalar(const uint16_t *values, size_t n, RunStats *stats) {
+  uint16_t min = stats->min;
+  uint16_t max = stats->max;
+  uint64_t sum = 0;
+  uint64_t sum_sq = 0;
+  for (size_t i = 0; i < n; i++) {
+    const uint32_t v = values[i];
+    min = std::min<uint16_t>(min, values[i]);
+    max = std::max<uint16_t>(max, values[i]);
+    sum += v;
+    sum_sq += static_cast<uint64_t>(v * v);
+  }
+  stats->min = min;
+  stats->max = max;
+  stats->sum += sum;
+  stats->sum_sq += sum_sq;
+}
+
+#if defined(UVC_ARCH_X86)
+// SSSE3 has no unsigned 16-bit min/max; the signed ones order values with
+// the top bit flipped the same way.
+UVC_TARGET_SSSE3 void RunStatsSsse3(const uint16_t *values, size_t n,
+                                    RunStats *stats) {
+  const __m128i bias = _mm_set1_epi16(static_cast<int16_t>(0x8000));
+  const __m128i zero = _mm_setzero_si128();
+  __m128i min = _mm_set1_epi16(0x7fff);
+  __m128i max = _mm_set1_epi16(static_cast<int16_t>(0x8000));
+  __m128i sum = zero;
+  __m128i sum_sq = zero;
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(values + i));
+    const __m128i biased = _mm_xor_si128(v, bias);
+    min = _mm_min_epi16(min, biased);
+    max = _mm_max_epi16(max, biased);
+    sum = _mm_add_epi32(sum, _mm_unpacklo_epi16(v, zero));
+    sum = _mm_add_epi32(sum, _mm_unpackhi_epi16(v, zero));
+    const __m128i sq_lo = _mm_mullo_epi16(v, v);
+    const __m128i sq_hi = _mm_mulhi_epu16(v, v);
+    const __m128i sq0 = _mm_unpacklo_epi16(sq_lo, sq_hi);
+    const __m128i sq1 = _mm_unpackhi_epi16(sq_lo, sq_hi);
+    sum_sq = _mm_add_epi64(sum_sq, _mm_unpacklo_epi32(sq0, zero));
+    sum_sq = _mm_add_epi64(sum_sq, _mm_unpackhi_epi32(sq0, zero));
+    sum_sq = _mm_add_epi64(sum_sq, _mm_unpacklo_epi32(sq1, zero));
+    sum_sq = _mm_add_epi64(sum_sq, _mm_unpackhi_epi32(sq1, zero));
+  }
+  alignas(16) uint16_t mins[8];
+  alignas(16) uint16_t maxs[8];
+  alignas(16) uint32_t sums[4];
+  alignas(16) uint64_t sums_sq[2];
+  _mm_store_si128(reinterpret_cast<__m128i *>(mins), _mm_xor_si128(min, bias));
+  _mm_store_si128(reinterpret_cast<__m128i *>(maxs), _mm_xor_si128(max, bias));
+  _mm_store_si128(reinterpret_cast<__m128i *>(sums), sum);
+  _mm_store_si128(reinterpret_cast<__m128i *>(sums_sq), sum_sq);
+  RunStats tail = *stats;
+  for (int l = 0; l < 8; l++) {
+    tail.min = std::min(tail.min, mins[l]);
+    tail.max = std::max(tail.max, maxs[l]);
+  }
+  tail.sum += static_cast<uint64_t>(sums[0]) + sums[1] + sums[2] + sums[3];
+  tail.sum_sq += sums_sq[0] + sums_sq[1];
+  RunStatsScalar(values + i, n - i, &tail);
+  *stats = tail;
+}
+
+UVC_TARGET_AVX2 void RunStatsAvx2(const uint16_t *values, size_t n,
+                                  RunStats *stats) {
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i min = _mm256_set1_epi16(-1);
+  __m256i max = zero;
+  __m256i sum = zero;
+  __m256i sum_sq = zero;
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+    min = _mm256_min_epu16(min, v);
+    max = _mm256_max_epu16(max, v);
+    sum = _mm256_add_epi32(sum, _mm256_unpacklo_epi16(v, zero));
+    sum = _mm256_add_epi32(sum, _mm256_unpackhi_epi16(v, zero));
+    const __m256i sq_lo = _mm256_mullo_epi16(v, v);
+    const __m256i sq_hi = _mm256_mulhi_epu16(v, v);
+    const __m256i sq0 = _mm256_unpacklo_epi16(sq_lo, sq_hi);
+    const __m256i sq1 = _mm256_unpackhi_epi16(sq_lo, sq_hi);
+    sum_sq = _mm256_add_epi64(sum_sq, _mm256_unpacklo_epi32(sq0, zero));
+    sum_sq = _mm256_add_epi64(sum_sq, _mm256_unpackhi_epi32(sq0, zero));
+    sum_sq = _mm256_add_epi64(sum_sq, _mm256_unpacklo_epi32(sq1, zero));
+    sum_sq = _mm256_add_epi64(sum_sq, _mm256_unpackhi_epi32(sq1, zero));
+  }
+  alignas(32) uint16_t mins[16];
+  alignas(32) uint16_t maxs[16];
+  alignas(32) uint32_t sums[8];
+  alignas(32) uint64_t sums_sq[4];
+  _mm256_store_si256(reinterpret_cast<__m256i *>(mins), min);
+  _mm256_store_si256(reinterpret_cast<__m256i *>(maxs), max);
+  _mm256_store_si256(reinterpret_cast<__m256i *>(sums), sum);
+  _mm256_store_si256(reinterpret_cast<__m256i *>(sums_sq), sum_sq);
+  RunStats tail = *stats;
+  for (int l = 0; l < 16; l++) {
+    tail.min = std::min(tail.min, mins[l]);
+    tail.max = std::max(tail.max, maxs[l]);
+  }
+  for (int l = 0; l < 8; l++) tail.sum += sums[l];
+  for (int l = 0; l < 4; l++) tail.sum_sq += sums_sq[l];
+  RunStatsScalar(values + i, n - i, &tail);
+  *stats = tail;
+}
+#endif  // UVC_ARCH_X86
+
+#if defined(UVC_ARCH_NEON)
+void RunStatsNeon(const uint16_t *values, size_t n, RunStats *stats) {
+  uint16x8_t min = vdupq_n_u16(0xffff);
+  uint16x8_t max = vdupq_n_u16(0);
+  uint32x4_t sum = vdupq_n_u32(0);
+  uint64x2_t sum_sq = vdupq_n_u64(0);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const uint16x8_t v = vld1q_u16(values + i);
+    min = vminq_u16(min, v);
+    max = vmaxq_u16(max, v);
+    sum = vpadalq_u16(sum, v);
+    sum_sq = vpadalq_u32(sum_sq, vmull_u16(vget_low_u16(v), vget_low_u16(v)));
+    sum_sq =
+        vpadalq_u32(sum_sq, vmull_u16(vget_high_u16(v), vget_high_u16(v)));
+  }
+  uint16_t mins[8];
+  uint16_t maxs[8];
+  uint32_t sums[4];
+  uint64_t sums_sq[2];
+  vst1q_u16(mins, min);
+  vst1q_u16(maxs, max);
+  vst1q_u32(sums, sum);
+  vst1q_u64(sums_sq, sum_sq);
+  RunStats tail = *stats;
+  for (int l = 0; l < 8; l++) {
+    tail.min = std::min(tail.min, mins[l]);
+    tail.max = std::max(tail.max, maxs[l]);
+  }
+  tail.sum += static_cast<uint64_t>(sums[0]) + sums[1] + sums[2] + sums[3];
+  tail.sum_sq += sums_sq[0] + sums_sq[1];
+  RunStatsScalar(values + i, n - i, &tail);
+  *stats = tail;
+}
+#endif  // UVC_ARCH_NEON
+
+RunStatsFn SelectRunStatsFn(SimdLevel level) {
+  switch (level) {
+#if defined(UVC_ARCH_X86)
+    case SimdLevel::kAvx2:
+      return RunStatsAvx2;
+    case SimdLevel::kSsse3:
+      return RunStatsSsse3;
+#endif
+#if defined(UVC_ARCH_NEON)
+    case SimdLevel::kNeon:
+      return RunStatsNeon;
+#endif
+    default:
+      return RunStatsScalar;
+  }
+}
+
+void ReduceRun(RunStatsFn fn, const uint16_t *values, size_t n,
+               RunStats *stats) {
+  for (size_t i = 0; i < n; i += kMaxRun) {
+    fn(values + i, std::min(kMaxRun, n - i), stats);
+  }
+}
+
+void Finish(const RunStats &run, uint32_t count, RoiStats *stats) {
+  stats->count = count;
+  if (count == 0) return;
+  stats->min = run.min;
+  stats->max = run.max;
+  const double mean = static_cast<double>(run.sum) / count;
+  const double variance =
+      static_cast<double>(run.sum_sq) / count - mean * mean;
+  stats->mean = mean;
+  stats->stddev = variance > 0 ? std::sqrt(variance) : 0.0;
+}
+
+}  // namespace
+
+bool ParseRoiShape(const std::string &name, RoiShape *shape) {
+  if (name == "point") {
+    *shape = RoiShape::kPoint;
+  } else if (name == "rect") {
+    *shape = RoiShape::kRect;
+  } else if (name == "polyline") {
+    *shape = RoiShape::kPolyline;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+size_t WriteRoiRecord(const RoiFrame &frame, TelemetryWriter *writer) {
+  writer->Begin(TelemetryKind::kRoi, frame.sequence, frame.timestamp / 10);
+  writer->PutU32(static_cast<uint32_t>(frame.stats.size()));
+  writer->PutU32(static_cast<uint32_t>(kRoiRecordEntryBytes));
+  for (const RoiStats &s : frame.stats) {
+    writer->PutI32(s.id);
+    writer->PutU32(s.count);
+    writer->PutU16(s.min);
+    writer->PutU16(s.max);
+    writer->PutI32(s.max_x);
+    writer->PutI32(s.max_y);
+    writer->PutU32(0);
+    writer->PutF64(s.mean);
+    writer->PutF64(s.stddev);
+  }
+  return writer->Finish();
+}
+
+bool RoiEngine::SetRois(std::vector<Roi> rois) {
+  if (rois.size() > kMaxRois) return false;
+  for (const Roi &roi : rois) {
+    const size_t points = roi.points.size();
+    switch (roi.shape) {
+      case RoiShape::kPoint:
+        if (points != 1) return false;
+        break;
+      case RoiShape::kRect:
+        if (points != 2) return false;
+        break;
+      case RoiShape::kPolyline:
+        if (points < 2 || points > kMaxPolylinePoints) return false;
+        break;
+    }
+    for (const RoiPoint &p : roi.points) {
+      if (std::abs(p.x) > kMaxCoordinate || std::abs(p.y) > kMaxCoordinate) {
+        return false;
+      }
+    }
+  }
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  pending_rois_ = std::move(rois);
+  config_dirty_.store(true, std::memory_order_release);
+  return true;
+}
+
+std::vector<Roi> RoiEngine::rois() const {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return config_dirty_.load(std::memory_order_acquire) ? pending_rois_
+                                                       : rois_;
+}
+
+bool RoiEngine::Measure(const uint16_t *frame, size_t stride_pixels,
+                        size_t width, size_t height,
+                        std::vector<RoiStats> *stats) {
+  if (config_dirty_.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    rois_ = pending_rois_;
+    config_dirty_.store(false, std::memory_order_relaxed);
+  }
+  if (rois_.empty()) return false;
+  const RunStatsFn reduce = SelectRunStatsFn(GetSimdLevel());
+  const int32_t w = static_cast<int32_t>(width);
+  const int32_t h = static_cast<int32_t>(height);
+  stats->assign(rois_.size(), RoiStats());
+  for (size_t r = 0; r < rois_.size(); r++) {
+    const Roi &roi = rois_[r];
+    RoiStats &out = (*stats)[r];
+    out.id = roi.id;
+    RunStats run;
+    switch (roi.shape) {
+      case RoiShape::kPoint: {
+        const RoiPoint p = roi.points[0];
+        if (p.x < 0 || p.y < 0 || p.x >= w || p.y >= h) break;
+        const uint16_t v = frame[p.y * stride_pixels + p.x];
+        run.min = run.max = v;
+        run.sum = v;
+        run.sum_sq = static_cast<uint64_t>(v) * v;
+        Finish(run, 1, &out);
+        out.max_x = p.x;
+        out.max_y = p.y;
+        break;
+      }
+      case RoiShape::kRect: {
+        const int32_t x0 =
+            std::max(std::min(roi.points[0].x, roi.points[1].x), 0);
+        const int32_t x1 =
+            std::min(std::max(roi.points[0].x, roi.points[1].x), w - 1);
+        const int32_t y0 =
+            std::max(std::min(roi.points[0].y, roi.points[1].y), 0);
+        const int32_t y1 =
+            std::min(std::max(roi.points[0].y, roi.points[1].y), h - 1);
+        if (x0 > x1 || y0 > y1) break;
+        const size_t run_width = static_cast<size_t>(x1 - x0 + 1);
+        // The first row reaching the final maximum holds the hottest pixel;
+        // only that row is searched again.
+        int32_t max_row = y0;
+        for (int32_t y = y0; y <= y1; y++) {
+          const uint16_t previous = run.max;
+          ReduceRun(reduce, frame + y * stride_pixels + x0, run_width, &run);
+          if (run.max > previous || y == y0) max_row = y;
+        }
+        Finish(run, static_cast<uint32_t>(run_width * (y1 - y0 + 1)), &out);
+        const uint16_t *row = frame + max_row * stride_pixels + x0;
+        out.max_x = x0 + static_cast<int32_t>(
+                             std::find(row, row + run_width, run.max) - row);
+        out.max_y = max_row;
+        break;
+      }
+      case RoiShape::kPolyline: {
+        // Bresenham along each segment, leaving out each later segment's
+        // first pixel, which ended the segment before.
+        samples_.clear();
+        sample_points_.clear();
+        for (size_t s = 0; s + 1 < roi.points.size(); s++) {
+          int32_t x = roi.points[s].x;
+          int32_t y = roi.points[s].y;
+          const int32_t x_end = roi.points[s + 1].x;
+          const int32_t y_end = roi.points[s + 1].y;
+          const int32_t dx = std::abs(x_end - x);
+          const int32_t dy = -std::abs(y_end - y);
+          const int32_t step_x = x < x_end ? 1 : -1;
+          const int32_t step_y = y < y_end ? 1 : -1;
+          int32_t error = dx + dy;
+          for (bool first = true;; first = false) {
+            if ((s == 0 || !first) && x >= 0 && y >= 0 && x < w && y < h) {
+              samples_.push_back(frame[y * stride_pixels + x]);
+              sample_points_.push_back({x, y});
+            }
+            if (x == x_end && y == y_end) break;
+            const int32_t twice = 2 * error;
+            if (twice >= dy) {
+              error += dy;
+              x += step_x;
+            }
+            if (twice <= dx) {
+              error += dx;
+              y += step_y;
+            }
+          }
+        }
+        if (samples_.empty()) break;
+        ReduceRun(reduce, samples_.data(), samples_.size(), &run);
+        Finish(run, static_cast<uint32_t>(samples_.size()), &out);
+        const size_t hottest =
+            std::find(samples_.begin(), samples_.end(), run.max) -
+            samples_.begin();
+        out.max_x = sample_points_[hottest].x;
+        out.max_y = sample_points_[hottest].y;
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace uvc
@@ -0,0 +1,126 @@
+#ifndef UVC_ROI_ENGINE_H_
+#define UVC_ROI_ENGINE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "telemetry_record.h"
+
+namespace uvc {
+
+enum class RoiShape {
+  kPoint,     // One pixel: points[0].
+  kRect,      // Two opposite corners, both inside the box.
+  kPolyline,  // The pixels on the segments between consecutive points;
+              // a pixel the line crosses twice counts twice.
+};
+
+// Parses "point", "rect" or "polyline". Returns false for anything else.
+bool ParseRoiShape(const std::string &name, RoiShape *shape);
+
+struct RoiPoint {
+  int32_t x = 0;
+  int32_t y = 0;
+};
+
+// A region of interest on the raw frame, in pixels.
+struct Roi {
+  // Chosen by the caller, reported back with the statistics.
+  int32_t id = 0;
+  RoiShape shape = RoiShape::kPoint;
+  std::vector<RoiPoint> points;
+};
+
+// Statistics of the counts inside one ROI. Pixels of the ROI outside the
+// frame are left out; with none left, everything but |id| is zero.
+struct RoiStats {
+  int32_t id = 0;
+  uint32_t count = 0;
+  uint16_t min = 0;
+  uint16_t max = 0;
+  double mean = 0;
+  double stddev = 0;
+  // The hottest pixel: the first with |max| counts, in row order (along
+  // the line for polylines).
+  int32_t max_x = 0;
+  int32_t max_y = 0;
+};
+
+// The ROI statistics of one frame, in the order the ROIs were set.
+struct RoiFrame {
+  uint64_t sequence = 0;
+  // The frame's timestamp, in 100 ns units.
+  int64_t timestamp = 0;
+  std::vector<RoiStats> stats;
+};
+
+// The TelemetryKind::kRoi payload: u32 ROI count and u32 bytes per ROI,
+// then per ROI
+//    0  i32  id
+//    4  u32  count
+//    8  u16  min
+//   10  u16  max
+//   12  i32  max_x
+//   16  i32  max_y
+//   20  u32  reserved
+//   24  f64  mean
+//   32  f64  stddev
+constexpr size_t kRoiRecordEntryBytes = 40;
+constexpr size_t RoiRecordBytes(size_t rois) {
+  return kTelemetryHeaderBytes + 8 + rois * kRoiRecordEntryBytes;
+}
+
+// Writes |frame| as one kRoi record. Returns its size, or 0 if |writer|'s
+// buffer is smaller than RoiRecordBytes(frame.stats.size()).
+size_t WriteRoiRecord(const RoiFrame &frame, TelemetryWriter *writer);
+
+// Measures ROIs on raw 16-bit frames on the capture thread, so Dart gets a
+// few numbers per frame instead of the frame.
+//
+// Rectangles are reduced row by row with SSSE3/AVX2/NEON kernels (min, max,
+// sum and sum of squares in one pass); polylines are sampled along their
+// segments into a buffer that the same kernels reduce. The hottest pixel
+// is located by rescanning only the rows that raise the maximum.
+//
+// Measure() must be called from one thread; SetRois() may be called from
+// any thread and takes effect on the next frame.
+class RoiEngine {
+ public:
+  static constexpr size_t kMaxRois = 64;
+  static constexpr size_t kMaxPolylinePoints = 64;
+  // Bounds a polyline's length, which is walked pixel by pixel.
+  static constexpr int32_t kMaxCoordinate = 1 << 15;
+
+  RoiEngine() = default;
+  RoiEngine(const RoiEngine &) = delete;
+  RoiEngine &operator=(const RoiEngine &) = delete;
+
+  // Replaces the ROIs. Returns false, changing nothing, if there are more
+  // than kMaxRois, one has the wrong number of points for its shape or a
+  // coordinate beyond +/-kMaxCoordinate.
+  bool SetRois(std::vector<Roi> rois);
+  std::vector<Roi> rois() const;
+
+  // Fills |stats| with one entry per ROI. Returns false, leaving |stats|
+  // alone, while there are no ROIs.
+  bool Measure(const uint16_t *frame, size_t stride_pixels, size_t width,
+               size_t height, std::vector<RoiStats> *stats);
+
+ private:
+  mutable std::mutex config_mutex_;
+  std::vector<Roi> pending_rois_;
+  std::atomic<bool> config_dirty_{false};
+
+  // Owned by the Measure() thread.
+  std::vector<Roi> rois_;
+  std::vector<uint16_t> samples_;
+  std::vector<RoiPoint> sample_points_;
+};
+
+}  // namespace uvc
+
+#endif  // UVC_ROI_ENGINE_H_
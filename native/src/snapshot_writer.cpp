@@ -0,0 +1,158 @@
+#include "snapshot_writer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+#include "image_encode.h"
+
+namespace uvc {
+
+namespace {
+
+int64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Writes |data| to |path| (UTF-8) through a temporary file next to it.
+bool WriteFileAtomically(const std::string &path,
+                         const std::vector<uint8_t> &data) {
+  // u8path, so non-ASCII paths work on Windows too.
+  const std::filesystem::path target = std::filesystem::u8path(path);
+  std::filesystem::path temporary = target;
+  temporary += ".part";
+  std::error_code error;
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    file.write(reinterpret_cast<const char *>(data.data()),
+               static_cast<std::streamsize>(data.size()));
+    file.close();
+    if (!file) {
+      std::filesystem::remove(temporary, error);
+      return false;
+    }
+  }
+  // Replaces an existing file on every platform.
+  std::filesystem::rename(temporary, target, error);
+  if (error) {
+    std::filesystem::remove(temporary, error);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool ParseSnapshotFormat(const std::string &name, SnapshotFormat *format) {
+  if (name == "png") {
+    *format = SnapshotFormat::kPng;
+  } else if (name == "tiff") {
+    *format = SnapshotFormat::kTiff16;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+SnapshotResult WriteSnapshot(const FrameRef &frame, SnapshotFormat format,
+                             const std::string &path) {
+  SnapshotResult result;
+  result.path = path;
+  const PixelFormat expected = format == SnapshotFormat::kPng
+                                   ? PixelFormat::kRgba8
+                                   : PixelFormat::kGray16;
+  if (!frame || frame.format().pixel_format != expected) {
+    result.error = "NO_FRAME";
+    return result;
+  }
+
+  const FrameFormat &layout = frame.format();
+  std::vector<uint8_t> encoded;
+  const int64_t encode_start = NowNs();
+  const bool encoded_ok =
+      format == SnapshotFormat::kPng
+          ? EncodePng(frame.data(), static_cast<ptrdiff_t>(layout.Stride()),
+                      layout.width, layout.height, &encoded)
+          : EncodeTiff16(reinterpret_cast<const uint16_t *>(frame.data()),
+                         layout.width, layout.width, layout.height, &encoded);
+  const int64_t write_start = NowNs();
+  result.encode_ns = write_start - encode_start;
+  if (!encoded_ok) {
+    result.error = "ENCODE_FAILED";
+    return result;
+  }
+  if (!WriteFileAtomically(path, encoded)) {
+    result.error = "WRITE_FAILED: " + path;
+    return result;
+  }
+  result.write_ns = NowNs() - write_start;
+  result.bytes = encoded.size();
+  result.ok = true;
+  return result;
+}
+
+SnapshotWriter::SnapshotWriter(size_t max_pending)
+    : max_pending_(std::max<size_t>(max_pending, 1)) {}
+
+SnapshotWriter::~SnapshotWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    changed_.notify_all();
+  }
+  if (thread_.joinable()) thread_.join();
+}
+
+bool SnapshotWriter::Submit(FrameRef frame, SnapshotFormat format,
+                            std::string path, Callback done) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (pending_ >= max_pending_ || stopping_) return false;
+  Job job;
+  job.frame = std::move(frame);
+  job.format = format;
+  job.path = std::move(path);
+  job.done = std::move(done);
+  job.submitted_ns = NowNs();
+  jobs_.push_back(std::move(job));
+  pending_++;
+  // Started on first use: most sessions never take a snapshot.
+  if (!thread_.joinable()) thread_ = std::thread([this] { Work(); });
+  changed_.notify_all();
+  return true;
+}
+
+void SnapshotWriter::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  changed_.wait(lock, [this] { return pending_ == 0; });
+}
+
+void SnapshotWriter::Work() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    changed_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+    // Queued jobs are finished even when stopping.
+    if (jobs_.empty()) return;
+    Job job = std::move(jobs_.front());
+    jobs_.pop_front();
+    lock.unlock();
+
+    const int64_t start = NowNs();
+    SnapshotResult result = WriteSnapshot(job.frame, job.format, job.path);
+    result.queued_ns = start - job.submitted_ns;
+    // The slab goes back to the pool before the caller hears about it.
+    job.frame = FrameRef();
+    if (job.done) job.done(result);
+
+    lock.lock();
+    pending_--;
+    changed_.notify_all();
+  }
+}
+
+}  // namespace uvc
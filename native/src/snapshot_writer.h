@@ -0,0 +1,94 @@
+#ifndef UVC_SNAPSHOT_WRITER_H_
+#define UVC_SNAPSHOT_WRITER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "frame_pool.h"
+
+namespace uvc {
+
+enum class SnapshotFormat {
+  kPng,     // The displayed kRgba8 frame.
+  kTiff16,  // The raw kGray16 counts behind it.
+};
+
+// Parses "png" or "tiff". Returns false for anything else.
+bool ParseSnapshotFormat(const std::string &name, SnapshotFormat *format);
+
+struct SnapshotResult {
+  bool ok = false;
+  std::string path;
+  // Why it failed, e.g. "WRITE_FAILED: <path>"; empty on success.
+  std::string error;
+  size_t bytes = 0;
+  // Submit() until the worker took the job, encoding, and writing.
+  int64_t queued_ns = 0;
+  int64_t encode_ns = 0;
+  int64_t write_ns = 0;
+};
+
+// Encodes and writes snapshots on a thread of its own, so a 4K PNG never
+// blocks the platform or capture thread.
+//
+// Submit() only stores the frame handle, which keeps the pooled buffer
+// alive without copying it; the pixels are read once, by the encoder. The
+// file is written under a temporary name and renamed into place, so readers
+// never see half of it. |done| is called on the worker thread.
+//
+// Submit() may be called from any thread. The destructor finishes the jobs
+// already queued.
+class SnapshotWriter {
+ public:
+  using Callback = std::function<void(const SnapshotResult &result)>;
+
+  // At most |max_pending| jobs, including the one being written, hold a
+  // frame at a time; more are refused rather than starving the pool.
+  explicit SnapshotWriter(size_t max_pending = 2);
+  ~SnapshotWriter();
+  SnapshotWriter(const SnapshotWriter &) = delete;
+  SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+  // Queues |frame| to be written to |path| as |format|. Returns false, and
+  // does not call |done|, if max_pending jobs are waiting.
+  bool Submit(FrameRef frame, SnapshotFormat format, std::string path,
+              Callback done);
+
+  // Waits until every submitted job has completed.
+  void Flush();
+
+ private:
+  struct Job {
+    FrameRef frame;
+    SnapshotFormat format = SnapshotFormat::kPng;
+    std::string path;
+    Callback done;
+    int64_t submitted_ns = 0;
+  };
+
+  void Work();
+
+  const size_t max_pending_;
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::deque<Job> jobs_;
+  // Jobs queued or being written.
+  size_t pending_ = 0;
+  bool stopping_ = false;
+  std::thread thread_;
+};
+
+// Encodes |frame| as |format| and writes it to |path|; what the worker runs
+// for each job.
+SnapshotResult WriteSnapshot(const FrameRef &frame, SnapshotFormat format,
+                             const std::string &path);
+
+}  // namespace uvc
+
+#endif  // UVC_SNAPSHOT_WRITER_H_
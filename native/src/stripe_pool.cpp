@@ -0,0 +1,71 @@
+#include "stripe_pool.h"
+
+#include <algorithm>
+
+namespace uvc {
+
+size_t DefaultStripeThreads() {
+  const size_t cores = std::thread::hardware_concurrency();
+  return std::min<size_t>(std::max<size_t>(cores, 1), 4);
+}
+
+StripePool::StripePool(size_t threads) {
+  if (threads == 0) threads = DefaultStripeThreads();
+  for (size_t i = 1; i < threads; i++) {
+    workers_.emplace_back([this] { Work(); });
+  }
+}
+
+StripePool::~StripePool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    changed_.notify_all();
+  }
+  for (std::thread &worker : workers_) worker.join();
+}
+
+void StripePool::Run(size_t count, const std::function<void(size_t)> &stripe) {
+  if (workers_.empty() || count <= 1) {
+    for (size_t i = 0; i < count; i++) stripe(i);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stripe_ = &stripe;
+    count_ = count;
+    next_.store(0, std::memory_order_relaxed);
+    busy_ = workers_.size();
+    generation_++;
+    changed_.notify_all();
+  }
+  Drain();
+  // Workers that wake late find no stripes left and report straight back.
+  std::unique_lock<std::mutex> lock(mutex_);
+  changed_.wait(lock, [this] { return busy_ == 0; });
+  stripe_ = nullptr;
+}
+
+void StripePool::Drain() {
+  for (;;) {
+    const size_t i = next_.fetch_add(1, std::memory_order_relaxed);
+    if (i >= count_) return;
+    (*stripe_)(i);
+  }
+}
+
+void StripePool::Work() {
+  uint64_t seen = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    changed_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+    if (stopping_) return;
+    seen = generation_;
+    lock.unlock();
+    Drain();
+    lock.lock();
+    if (--busy_ == 0) changed_.notify_all();
+  }
+}
+
+}  // namespace uvc
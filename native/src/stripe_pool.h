@@ -0,0 +1,59 @@
+#ifndef UVC_STRIPE_POOL_H_
+#define UVC_STRIPE_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace uvc {
+
+// Threads for per-frame kernels that split a frame into stripes of rows: the
+// cores there are, at most four, since a stripe of a 640x512 frame is done
+// in well under the cost of waking more threads.
+size_t DefaultStripeThreads();
+
+// Runs a function over the stripes of a frame on persistent threads, so a
+// kernel can use several cores without starting threads for each frame.
+//
+// The calling thread takes stripes too; a pool of one thread runs
+// everything inline. Run() may be called from one thread at a time.
+class StripePool {
+ public:
+  // |threads| includes the caller; 0 means DefaultStripeThreads().
+  explicit StripePool(size_t threads = 0);
+  ~StripePool();
+  StripePool(const StripePool &) = delete;
+  StripePool &operator=(const StripePool &) = delete;
+
+  size_t threads() const { return workers_.size() + 1; }
+
+  // Calls |stripe|(i) for every i in [0, |count|), each exactly once and
+  // from any of the pool's threads, and returns when all calls have.
+  void Run(size_t count, const std::function<void(size_t)> &stripe);
+
+ private:
+  void Work();
+  // Takes stripes of the current job until none are left.
+  void Drain();
+
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  // Bumped for every job, so a worker wakes once per job.
+  uint64_t generation_ = 0;
+  const std::function<void(size_t)> *stripe_ = nullptr;
+  size_t count_ = 0;
+  std::atomic<size_t> next_{0};
+  // Workers still inside the current job.
+  size_t busy_ = 0;
+  bool stopping_ = false;
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace uvc
+
+#endif  // UVC_STRIPE_POOL_H_
@@ -0,0 +1,179 @@
+#include "synthetic_source.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+namespace uvc {
+
+namespace {
+
+// Extra noise samples so consecutive frames read different noise.
+constexpr size_t kNoiseSlack = 4093;
+
+}  // namespace
+
+SyntheticSource::SyntheticSource(const SyntheticConfig &config)
+    : config_(config) {
+  config_.width = std::max<uint32_t>(config_.width, 2) & ~1u;
+  config_.height = std::max<uint32_t>(config_.height, 1);
+  // Compressed output is not synthesised.
+  if (config_.format == SourcePixelFormat::kMjpeg) {
+    config_.format = SourcePixelFormat::kYuyv;
+  }
+  if (config_.format == SourcePixelFormat::kNv12) {
+    // 4:2:0 chroma covers 2x2 blocks.
+    config_.height = std::max<uint32_t>(config_.height, 2) & ~1u;
+  }
+  config_.fps = std::min(config_.fps, kMaxFps);
+  config_.hot_spots = std::max(config_.hot_spots, 0);
+  if (config_.format != SourcePixelFormat::kGray16) config_.bit_depth = 8;
+  config_.bit_depth = std::min(std::max(config_.bit_depth, 8), 16);
+
+  mode_.format = config_.format;
+  mode_.width = config_.width;
+  mode_.height = config_.height;
+  mode_.bit_depth = config_.bit_depth;
+  mode_.fps_numerator = config_.fps;
+  mode_.fps_denominator = 1;
+  max_count_ = static_cast<uint16_t>((1u << config_.bit_depth) - 1);
+  SetRate(config_.fps, 1);
+}
+
+bool SyntheticSource::Start() {
+  const size_t width = config_.width;
+  const size_t height = config_.height;
+  const size_t pixels = width * height;
+  if (background_.size() != pixels) {
+    // A diagonal gradient from 25% to 40% of full scale.
+    background_.resize(pixels);
+    const float low = 0.25f * max_count_;
+    const float span = 0.15f * max_count_;
+    const float diagonal = static_cast<float>(width + height - 2) + 1.0f;
+    for (size_t y = 0; y < height; y++) {
+      for (size_t x = 0; x < width; x++) {
+        background_[y * width + x] =
+            static_cast<uint16_t>(low + span * (x + y) / diagonal);
+      }
+    }
+
+    noise_.resize(pixels + kNoiseSlack);
+    std::mt19937 rng(config_.seed);
+    std::normal_distribution<float> normal(0.0f,
+                                           static_cast<float>(config_.noise));
+    for (int16_t &n : noise_) {
+      n = static_cast<int16_t>(
+          std::min(std::max(normal(rng), -32768.0f), 32767.0f));
+    }
+    counts_.resize(pixels);
+    if (config_.format == SourcePixelFormat::kBgra32) {
+      pixels_.resize(pixels * 4);
+    } else if (config_.format == SourcePixelFormat::kYuyv ||
+               config_.format == SourcePixelFormat::kUyvy) {
+      pixels_.resize(pixels * 2);
+    } else if (config_.format == SourcePixelFormat::kNv12) {
+      pixels_.resize(pixels + pixels / 2);
+    }
+  }
+  return PacedSource::Start();
+}
+
+void SyntheticSource::RenderCounts(uint64_t sequence) {
+  const int width = static_cast<int>(config_.width);
+  const int height = static_cast<int>(config_.height);
+  const size_t pixels = counts_.size();
+  const int32_t max_count = max_count_;
+
+  // A cheap multiplicative hash spreads the offsets so neighbouring frames
+  // do not show the same noise shifted by a pixel.
+  const int16_t *noise =
+      noise_.data() + (sequence * 2654435761u) % (kNoiseSlack + 1);
+  const uint16_t *background = background_.data();
+  uint16_t *counts = counts_.data();
+  for (size_t i = 0; i < pixels; i++) {
+    const int32_t v = background[i] + noise[i];
+    counts[i] = static_cast<uint16_t>(std::min(std::max(v, 0), max_count));
+  }
+
+  // Hot spots peak at +45% of full scale with a smooth (1 - r^2)^2 falloff.
+  const float t = static_cast<float>(sequence % 1000000) * 0.02f;
+  const float radius = std::max(2.0f, std::min(width, height) / 10.0f);
+  const float amplitude = 0.45f * max_count_;
+  for (int k = 0; k < config_.hot_spots; k++) {
+    const float cx =
+        width * (0.5f + 0.4f * std::sin(t * (1.0f + 0.31f * k) + 1.7f * k));
+    const float cy =
+        height * (0.5f + 0.4f * std::sin(t * (1.3f + 0.17f * k) + 0.9f * k));
+    const int x0 = std::max(0, static_cast<int>(cx - radius));
+    const int x1 = std::min(width - 1, static_cast<int>(cx + radius));
+    const int y0 = std::max(0, static_cast<int>(cy - radius));
+    const int y1 = std::min(height - 1, static_cast<int>(cy + radius));
+    const float inv_r2 = 1.0f / (radius * radius);
+    for (int y = y0; y <= y1; y++) {
+      uint16_t *row = counts + static_cast<size_t>(y) * width;
+      const float dy2 = (y - cy) * (y - cy);
+      for (int x = x0; x <= x1; x++) {
+        const float d2 = ((x - cx) * (x - cx) + dy2) * inv_r2;
+        if (d2 >= 1.0f) continue;
+        const float falloff = (1.0f - d2) * (1.0f - d2);
+        const int32_t v = row[x] + static_cast<int32_t>(amplitude * falloff);
+        row[x] = static_cast<uint16_t>(std::min(v, max_count));
+      }
+    }
+  }
+}
+
+SourceStatus SyntheticSource::Produce(uint64_t sequence, SourceFrame *frame) {
+  RenderCounts(sequence);
+  const size_t pixels = counts_.size();
+  const uint16_t *counts = counts_.data();
+  uint8_t *out = pixels_.data();
+  switch (config_.format) {
+    case SourcePixelFormat::kGray16:
+      frame->data = reinterpret_cast<const uint8_t *>(counts_.data());
+      frame->stride = static_cast<ptrdiff_t>(config_.width) * 2;
+      break;
+    case SourcePixelFormat::kBgra32:
+      for (size_t i = 0; i < pixels; i++) {
+        const uint32_t bgra = 0xFF000000u | counts[i] * 0x010101u;
+        std::memcpy(out + i * 4, &bgra, 4);
+      }
+      frame->data = pixels_.data();
+      frame->stride = static_cast<ptrdiff_t>(config_.width) * 4;
+      break;
+    case SourcePixelFormat::kMjpeg:  // Replaced in the constructor.
+    case SourcePixelFormat::kYuyv:
+      // Grey in BT.601 limited range: Y in 16..235, neutral chroma.
+      for (size_t i = 0; i < pixels; i++) {
+        // 219 / 255 ~= 55 / 64.
+        const uint16_t pair =
+            static_cast<uint16_t>(0x8000 | (16 + ((counts[i] * 55) >> 6)));
+        std::memcpy(out + i * 2, &pair, 2);
+      }
+      frame->data = pixels_.data();
+      frame->stride = static_cast<ptrdiff_t>(config_.width) * 2;
+      break;
+    case SourcePixelFormat::kUyvy:
+      for (size_t i = 0; i < pixels; i++) {
+        const uint16_t pair =
+            static_cast<uint16_t>(0x80 | (16 + ((counts[i] * 55) >> 6)) << 8);
+        std::memcpy(out + i * 2, &pair, 2);
+      }
+      frame->data = pixels_.data();
+      frame->stride = static_cast<ptrdiff_t>(config_.width) * 2;
+      break;
+    case SourcePixelFormat::kNv12:
+      for (size_t i = 0; i < pixels; i++) {
+        out[i] = static_cast<uint8_t>(16 + ((counts[i] * 55) >> 6));
+      }
+      std::memset(out + pixels, 0x80, pixels / 2);
+      frame->data = pixels_.data();
+      frame->stride = static_cast<ptrdiff_t>(config_.width);
+      break;
+  }
+  frame->index = 0;
+  return SourceStatus::kFrame;
+}
+
+}  // namespace uvc
@@ -0,0 +1,65 @@
+#ifndef UVC_SYNTHETIC_SOURCE_H_
+#define UVC_SYNTHETIC_SOURCE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "paced_source.h"
+
+namespace uvc {
+
+struct SyntheticConfig {
+  uint32_t width = 640;  // Rounded down to even for 4:2:2 pairs.
+  uint32_t height = 512;  // Rounded down to even for kNv12.
+  // kGray16 imitates a radiometric thermal core; the other formats a webcam
+  // (kMjpeg is delivered as kYuyv).
+  SourcePixelFormat format = SourcePixelFormat::kGray16;
+  // Significant bits of kGray16 counts (8..16).
+  int bit_depth = 14;
+  // Frames per second, up to kMaxFps; 0 produces frames as fast as they are
+  // consumed.
+  uint32_t fps = 60;
+  // Standard deviation of the per-pixel noise in counts of |bit_depth|.
+  uint32_t noise = 16;
+  // Number of warm blobs drifting across the scene.
+  int hot_spots = 3;
+  uint32_t seed = 1;
+};
+
+// A camera that does not exist: a warm gradient background with Gaussian
+// sensor noise and hot spots moving on Lissajous paths, so AGC and the
+// display path see a changing scene. Frame |n| is a pure function of the
+// config and |n|.
+//
+// Everything random is precomputed by Start(); producing a frame is one add
+// and clamp per pixel plus the hot spots, which keeps 640x512 at 1000 fps
+// well inside one core.
+class SyntheticSource : public PacedSource {
+ public:
+  static constexpr uint32_t kMaxFps = 1000;
+
+  explicit SyntheticSource(const SyntheticConfig &config);
+
+  SourceMode mode() const override { return mode_; }
+  bool Start() override;
+
+ protected:
+  SourceStatus Produce(uint64_t sequence, SourceFrame *frame) override;
+
+ private:
+  void RenderCounts(uint64_t sequence);
+
+  SyntheticConfig config_;
+  SourceMode mode_;
+  uint16_t max_count_ = 0;
+  std::vector<uint16_t> background_;
+  // Noise for one frame plus kNoiseSlack; each frame reads it from a
+  // different offset.
+  std::vector<int16_t> noise_;
+  std::vector<uint16_t> counts_;
+  std::vector<uint8_t> pixels_;  // Output of the 8-bit formats.
+};
+
+}  // namespace uvc
+
+#endif  // UVC_SYNTHETIC_SOURCE_H_
@@ -0,0 +1,105 @@
+#ifndef UVC_TELEMETRY_RECORD_H_
+#define UVC_TELEMETRY_RECORD_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace uvc {
+
+// Fixed-layout binary records for data the runners send to Dart many times a
+// second. Going through the channel codec as one byte blob, a record costs a
+// memcpy on both sides where a map with string keys costs an allocation and
+// a type tag per field. lib/camera/telemetry_record.dart decodes them.
+//
+// Every record starts with a 24-byte header, all fields little-endian:
+//    0  u16  magic, kTelemetryMagic
+//    2  u8   version, kTelemetryVersion
+//    3  u8   kind, a TelemetryKind
+//    4  u32  size of the whole record in bytes, header included
+//    8  u64  source frame sequence
+//   16  i64  source frame timestamp, in microseconds
+// followed by the kind's payload. A decoder skips records of a version or
+// kind it does not know; new fields go at the end of a payload so older
+// decoders can read the fields they know.
+constexpr uint16_t kTelemetryMagic = 0x5455;  // "UT"
+constexpr uint8_t kTelemetryVersion = 1;
+constexpr size_t kTelemetryHeaderBytes = 24;
+
+enum class TelemetryKind : uint8_t {
+  // RoiEngine results, see WriteRoiRecord().
+  kRoi = 1,
+};
+
+// Writes one record into a caller-provided buffer: no allocation, no
+// virtual calls, and nothing written past |capacity|. Begin(), then the
+// payload with the Put methods, then Finish() for the record's size.
+class TelemetryWriter {
+ public:
+  TelemetryWriter(uint8_t *buffer, size_t capacity)
+      : buffer_(buffer), capacity_(capacity) {}
+
+  void Begin(TelemetryKind kind, uint64_t sequence, int64_t timestamp_us) {
+    size_ = 0;
+    overflow_ = false;
+    PutU16(kTelemetryMagic);
+    PutU8(kTelemetryVersion);
+    PutU8(static_cast<uint8_t>(kind));
+    PutU32(0);  // Patched by Finish().
+    PutU64(sequence);
+    PutI64(timestamp_us);
+  }
+
+  void PutU8(uint8_t value) { PutBytes(&value, 1); }
+  void PutU16(uint16_t value) { PutLittleEndian(value, 2); }
+  void PutU32(uint32_t value) { PutLittleEndian(value, 4); }
+  void PutI32(int32_t value) { PutU32(static_cast<uint32_t>(value)); }
+  void PutU64(uint64_t value) { PutLittleEndian(value, 8); }
+  void PutI64(int64_t value) { PutU64(static_cast<uint64_t>(value)); }
+  void PutF64(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    PutU64(bits);
+  }
+
+  // Stores the record size and returns it, or returns 0 if the record did
+  // not fit.
+  size_t Finish() {
+    if (overflow_ || size_ < kTelemetryHeaderBytes) return 0;
+    const size_t size = size_;
+    size_ = 4;
+    PutU32(static_cast<uint32_t>(size));
+    size_ = size;
+    return size;
+  }
+
+  const uint8_t *data() const { return buffer_; }
+  size_t size() const { return size_; }
+
+ private:
+  void PutLittleEndian(uint64_t value, size_t bytes) {
+    uint8_t out[8];
+    for (size_t i = 0; i < bytes; i++) {
+      out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+    PutBytes(out, bytes);
+  }
+
+  void PutBytes(const uint8_t *bytes, size_t count) {
+    if (overflow_ || capacity_ - size_ < count) {
+      overflow_ = true;
+      return;
+    }
+    std::memcpy(buffer_ + size_, bytes, count);
+    size_ += count;
+  }
+
+  uint8_t *buffer_;
+  size_t capacity_;
+  size_t size_ = 0;
+  bool overflow_ = false;
+};
+
+}  // namespace uvc
+
+#endif  // UVC_TELEMETRY_RECORD_H_
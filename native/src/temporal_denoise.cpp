@@ -0,0 +1,234 @@
+#include "temporal_denoise.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "cpu_features.h"
+
+#if defined(UVC_ARCH_X86)
+#include <immintrin.h>
+#elif defined(UVC_ARCH_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace uvc {
+
+namespace {
+
+// Rows below this are not worth a stripe of their own.
+constexpr size_t kMinStripeRows = 32;
+
+// The blend as every kernel evaluates it, in this order:
+//   d = count - average
+//   w = clamp((|d| - low) * inv_range, 0, 1)
+//   average += (min_weight + w * span) * d
+// and the output is the average rounded half up.
+struct BlendParams {
+  float low;
+  float inv_range;
+  float min_weight;
+  float span;
+};
+
+BlendParams MakeBlendParams(const DenoiseConfig &config) {
+  const float min_weight = std::min(std::max(config.min_weight, 0.0f), 1.0f);
+  const float sigma = std::max(config.noise_sigma, 0.0f);
+  const float low = config.motion_low * sigma;
+  // At least one count, so a zero sigma still ramps.
+  const float range = std::max((config.motion_high - config.motion_low) * sigma,
+                               1.0f);
+  return {low, 1.0f / range, min_weight, 1.0f - min_weight};
+}
+
+using DenoiseRowFn = void (*)(uint16_t *frame, float *average, size_t width,
+                              const BlendParams &p);
+
+void DenoiseRowScalar(uint16_t *frame, float *average, size_t width,
+                      const BlendParams &p) {
+  for (size_t x = 0; x < width; x++) {
+    const float d = static_cast<float>(frame[x]) - average[x];
+    const float w =
+        std::min(std::max((std::fabs(d) - p.low) * p.inv_range, 0.0f), 1.0f);
+    const float k = p.min_weight + w * p.span;
+    const float a = average[x] + k * d;
+    average[x] = a;
+    frame[x] = static_cast<uint16_t>(a + 0.5f);
+  }
+}
+
+#if defined(UVC_ARCH_X86)
+// Blends four pixels given as int32 counts; returns the rounded averages.
+UVC_TARGET_SSSE3 inline __m128i Blend4Ssse3(__m128i counts, float *average,
+                                            const BlendParams &p) {
+  const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  const __m128 a = _mm_loadu_ps(average);
+  const __m128 d = _mm_sub_ps(_mm_cvtepi32_ps(counts), a);
+  __m128 w = _mm_mul_ps(_mm_sub_ps(_mm_and_ps(d, abs_mask),
+                                   _mm_set1_ps(p.low)),
+                        _mm_set1_ps(p.inv_range));
+  w = _mm_min_ps(_mm_max_ps(w, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+  const __m128 k =
+      _mm_add_ps(_mm_set1_ps(p.min_weight), _mm_mul_ps(w, _mm_set1_ps(p.span)));
+  const __m128 next = _mm_add_ps(a, _mm_mul_ps(k, d));
+  _mm_storeu_ps(average, next);
+  return _mm_cvttps_epi32(_mm_add_ps(next, _mm_set1_ps(0.5f)));
+}
+
+UVC_TARGET_SSSE3 void DenoiseRowSsse3(uint16_t *frame, float *average,
+                                      size_t width, const BlendParams &p) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i bias32 = _mm_set1_epi32(32768);
+  const __m128i bias16 = _mm_set1_epi16(-32768);
+  size_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const __m128i counts =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(frame + x));
+    const __m128i lo = Blend4Ssse3(_mm_unpacklo_epi16(counts, zero),
+                                   average + x, p);
+    const __m128i hi = Blend4Ssse3(_mm_unpackhi_epi16(counts, zero),
+                                   average + x + 4, p);
+    // No packus_epi32 before SSE4.1: pack signed around 32768 instead.
+    const __m128i packed = _mm_packs_epi32(_mm_sub_epi32(lo, bias32),
+                                           _mm_sub_epi32(hi, bias32));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(frame + x),
+                     _mm_xor_si128(packed, bias16));
+  }
+  DenoiseRowScalar(frame + x, average + x, width - x, p);
+}
+
+UVC_TARGET_AVX2 void DenoiseRowAvx2(uint16_t *frame, float *average,
+                                    size_t width, const BlendParams &p) {
+  const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+  const __m256 low = _mm256_set1_ps(p.low);
+  const __m256 inv_range = _mm256_set1_ps(p.inv_range);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 min_weight = _mm256_set1_ps(p.min_weight);
+  const __m256 span = _mm256_set1_ps(p.span);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  size_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const __m256i counts = _mm256_cvtepu16_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(frame + x)));
+    const __m256 a = _mm256_loadu_ps(average + x);
+    const __m256 d = _mm256_sub_ps(_mm256_cvtepi32_ps(counts), a);
+    __m256 w = _mm256_mul_ps(_mm256_sub_ps(_mm256_and_ps(d, abs_mask), low),
+                             inv_range);
+    w = _mm256_min_ps(_mm256_max_ps(w, _mm256_setzero_ps()), one);
+    const __m256 k = _mm256_add_ps(min_weight, _mm256_mul_ps(w, span));
+    const __m256 next = _mm256_add_ps(a, _mm256_mul_ps(k, d));
+    _mm256_storeu_ps(average + x, next);
+    const __m256i rounded = _mm256_cvttps_epi32(_mm256_add_ps(next, half));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(frame + x),
+                     _mm_packus_epi32(_mm256_castsi256_si128(rounded),
+                                      _mm256_extracti128_si256(rounded, 1)));
+  }
+  DenoiseRowScalar(frame + x, average + x, width - x, p);
+}
+#endif  // UVC_ARCH_X86
+
+#if defined(UVC_ARCH_NEON)
+inline uint32x4_t Blend4Neon(uint32x4_t counts, float *average,
+                             const BlendParams &p) {
+  const float32x4_t a = vld1q_f32(average);
+  const float32x4_t d = vsubq_f32(vcvtq_f32_u32(counts), a);
+  float32x4_t w = vmulq_f32(vsubq_f32(vabsq_f32(d), vdupq_n_f32(p.low)),
+                            vdupq_n_f32(p.inv_range));
+  w = vminq_f32(vmaxq_f32(w, vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+  // Separate multiplies and adds, as in the scalar kernel.
+  const float32x4_t k =
+      vaddq_f32(vdupq_n_f32(p.min_weight), vmulq_f32(w, vdupq_n_f32(p.span)));
+  const float32x4_t next = vaddq_f32(a, vmulq_f32(k, d));
+  vst1q_f32(average, next);
+  return vcvtq_u32_f32(vaddq_f32(next, vdupq_n_f32(0.5f)));
+}
+
+void DenoiseRowNeon(uint16_t *frame, float *average, size_t width,
+                    const BlendParams &p) {
+  size_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const uint16x8_t counts = vld1q_u16(frame + x);
+    const uint32x4_t lo = Blend4Neon(vmovl_u16(vget_low_u16(counts)),
+                                     average + x, p);
+    const uint32x4_t hi = Blend4Neon(vmovl_u16(vget_high_u16(counts)),
+                                     average + x + 4, p);
+    vst1q_u16(frame + x, vcombine_u16(vqmovn_u32(lo), vqmovn_u32(hi)));
+  }
+  DenoiseRowScalar(frame + x, average + x, width - x, p);
+}
+#endif  // UVC_ARCH_NEON
+
+DenoiseRowFn SelectRowFn(SimdLevel level) {
+  switch (level) {
+#if defined(UVC_ARCH_X86)
+    case SimdLevel::kAvx2:
+      return DenoiseRowAvx2;
+    case SimdLevel::kSsse3:
+      return DenoiseRowSsse3;
+#endif
+#if defined(UVC_ARCH_NEON)
+    case SimdLevel::kNeon:
+      return DenoiseRowNeon;
+#endif
+    default:
+      return DenoiseRowScalar;
+  }
+}
+
+}  // namespace
+
+TemporalDenoise::TemporalDenoise(size_t threads) : pool_(threads) {}
+
+void TemporalDenoise::SetConfig(const DenoiseConfig &config) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  pending_config_ = config;
+  config_dirty_.store(true, std::memory_order_release);
+}
+
+DenoiseConfig TemporalDenoise::config() const {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return config_dirty_.load(std::memory_order_acquire) ? pending_config_
+                                                       : config_;
+}
+
+void TemporalDenoise::Reset() { primed_ = false; }
+
+void TemporalDenoise::Process(uint16_t *frame, size_t stride_pixels,
+                              size_t width, size_t height) {
+  if (config_dirty_.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    config_ = pending_config_;
+    config_dirty_.store(false, std::memory_order_relaxed);
+  }
+  if (!config_.enabled) {
+    primed_ = false;
+    return;
+  }
+
+  if (!primed_ || width != width_ || height != height_) {
+    // Only a size change allocates.
+    accumulator_.resize(width * height);
+    width_ = width;
+    height_ = height;
+    for (size_t y = 0; y < height; y++) {
+      std::copy(frame + y * stride_pixels, frame + y * stride_pixels + width,
+                accumulator_.begin() + static_cast<ptrdiff_t>(y * width));
+    }
+    primed_ = true;
+    return;
+  }
+
+  const DenoiseRowFn row = SelectRowFn(GetSimdLevel());
+  const BlendParams params = MakeBlendParams(config_);
+  const size_t stripes = std::max<size_t>(
+      std::min(pool_.threads(), height / kMinStripeRows), 1);
+  float *average = accumulator_.data();
+  pool_.Run(stripes, [&](size_t stripe) {
+    const size_t begin = height * stripe / stripes;
+    const size_t end = height * (stripe + 1) / stripes;
+    for (size_t y = begin; y < end; y++) {
+      row(frame + y * stride_pixels, average + y * width, width, params);
+    }
+  });
+}
+
+}  // namespace uvc
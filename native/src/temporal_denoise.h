@@ -0,0 +1,76 @@
+#ifndef UVC_TEMPORAL_DENOISE_H_
+#define UVC_TEMPORAL_DENOISE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "stripe_pool.h"
+
+namespace uvc {
+
+struct DenoiseConfig {
+  bool enabled = false;
+  // Weight of the newest frame where nothing moves: 1/8 averages about 15
+  // frames, reducing noise by about 2.6x.
+  float min_weight = 0.125f;
+  // Temporal noise of the sensor in counts (one sigma).
+  float noise_sigma = 16.0f;
+  // Where a pixel differs from its average by less than |motion_low|
+  // sigmas it is blended with min_weight; beyond |motion_high| sigmas it
+  // takes the new count outright, so moving edges leave no trail. The
+  // weight ramps linearly in between.
+  float motion_low = 2.0f;
+  float motion_high = 6.0f;
+};
+
+// Recursive temporal noise reduction for raw 16-bit frames.
+//
+// Each pixel keeps a running average in a float accumulator that persists
+// across frames; a new frame is blended into it with a per-pixel weight
+// chosen from how far the pixel moved away from its average, and the
+// rounded average replaces the frame's counts in place. Static areas are
+// averaged over many frames, while changes well above the noise pass
+// straight through instead of ghosting.
+//
+// The kernel has SSSE3, AVX2 and NEON variants and runs on stripes of rows
+// spread over a StripePool. The first frame after Reset(), enabling, or a
+// size change only seeds the accumulator.
+//
+// Process() must be called from one thread; SetConfig() may be called from
+// any thread and takes effect on the next frame.
+class TemporalDenoise {
+ public:
+  // |threads| for the stripes, including the caller; 0 for the default.
+  explicit TemporalDenoise(size_t threads = 0);
+  TemporalDenoise(const TemporalDenoise &) = delete;
+  TemporalDenoise &operator=(const TemporalDenoise &) = delete;
+
+  void SetConfig(const DenoiseConfig &config);
+  DenoiseConfig config() const;
+
+  // Denoises |frame| in place. Does nothing while disabled.
+  void Process(uint16_t *frame, size_t stride_pixels, size_t width,
+               size_t height);
+
+  // Forgets the accumulated frames, e.g. when the scene or camera changes.
+  void Reset();
+
+ private:
+  mutable std::mutex config_mutex_;
+  DenoiseConfig pending_config_;
+  std::atomic<bool> config_dirty_{false};
+
+  DenoiseConfig config_;
+  bool primed_ = false;
+  size_t width_ = 0;
+  size_t height_ = 0;
+  std::vector<float> accumulator_;
+  StripePool pool_;
+};
+
+}  // namespace uvc
+
+#endif  // UVC_TEMPORAL_DENOISE_H_
@@ -0,0 +1,248 @@
+#include "thermal_palette.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+#if defined(UVC_ARCH_X86)
+#include <immintrin.h>
+#endif
+
+namespace uvc {
+
+namespace {
+
+struct ColorStop {
+  float position;
+  uint8_t r, g, b;
+};
+
+struct PaletteDefinition {
+  ThermalPalette palette;
+  const char *name;
+  const ColorStop *stops;
+  size_t stop_count;
+};
+
+constexpr ColorStop kWhiteHotStops[] = {
+    {0.00f, 0, 0, 0},
+    {1.00f, 255, 255, 255},
+};
+
+constexpr ColorStop kBlackHotStops[] = {
+    {0.00f, 255, 255, 255},
+    {1.00f, 0, 0, 0},
+};
+
+constexpr ColorStop kIronbowStops[] = {
+    {0.00f, 0, 0, 0},
+    {0.15f, 30, 0, 100},
+    {0.35f, 130, 0, 155},
+    {0.55f, 210, 40, 90},
+    {0.72f, 245, 110, 10},
+    {0.88f, 255, 200, 30},
+    {1.00f, 255, 255, 230},
+};
+
+constexpr ColorStop kRainbowStops[] = {
+    {0.00f, 20, 0, 80},
+    {0.15f, 0, 0, 255},
+    {0.35f, 0, 200, 255},
+    {0.50f, 0, 220, 60},
+    {0.65f, 240, 240, 0},
+    {0.82f, 255, 120, 0},
+    {1.00f, 255, 0, 0},
+};
+
+constexpr ColorStop kArcticStops[] = {
+    {0.00f, 5, 10, 40},
+    {0.25f, 20, 60, 150},
+    {0.50f, 60, 160, 220},
+    {0.70f, 190, 225, 240},
+    {0.85f, 250, 190, 60},
+    {1.00f, 255, 240, 160},
+};
+
+// Indexed by ThermalPalette.
+constexpr PaletteDefinition kPalettes[kThermalPaletteCount] = {
+    {ThermalPalette::kWhiteHot, "white_hot", kWhiteHotStops,
+     sizeof(kWhiteHotStops) / sizeof(ColorStop)},
+    {ThermalPalette::kBlackHot, "black_hot", kBlackHotStops,
+     sizeof(kBlackHotStops) / sizeof(ColorStop)},
+    {ThermalPalette::kIronbow, "ironbow", kIronbowStops,
+     sizeof(kIronbowStops) / sizeof(ColorStop)},
+    {ThermalPalette::kRainbow, "rainbow", kRainbowStops,
+     sizeof(kRainbowStops) / sizeof(ColorStop)},
+    {ThermalPalette::kArctic, "arctic", kArcticStops,
+     sizeof(kArcticStops) / sizeof(ColorStop)},
+};
+
+// 1.25 MB of zero-initialised storage; a table is only touched once built.
+alignas(64) uint32_t g_tables[kThermalPaletteCount][kPaletteTableSize];
+std::once_flag g_built[kThermalPaletteCount];
+
+uint32_t PackRgba(float r, float g, float b) {
+  const auto channel = [](float v) {
+    return static_cast<uint32_t>(std::lround(std::clamp(v, 0.0f, 255.0f)));
+  };
+  uint8_t bytes[4] = {static_cast<uint8_t>(channel(r)),
+                      static_cast<uint8_t>(channel(g)),
+                      static_cast<uint8_t>(channel(b)), 255};
+  uint32_t pixel;
+  std::memcpy(&pixel, bytes, 4);
+  return pixel;
+}
+
+void BuildTable(const PaletteDefinition &def, uint32_t *table) {
+  size_t segment = 0;
+  for (size_t i = 0; i < kPaletteTableSize; i++) {
+    const float t = static_cast<float>(i) / (kPaletteTableSize - 1);
+    while (segment + 2 < def.stop_count &&
+           t > def.stops[segment + 1].position) {
+      segment++;
+    }
+    const ColorStop &a = def.stops[segment];
+    const ColorStop &b = def.stops[segment + 1];
+    const float span = b.position - a.position;
+    const float f = span > 0 ? std::clamp((t - a.position) / span, 0.0f, 1.0f)
+                             : 0.0f;
+    table[i] = PackRgba(a.r + (b.r - a.r) * f, a.g + (b.g - a.g) * f,
+                        a.b + (b.b - a.b) * f);
+  }
+}
+
+// Window parameters shared by every kernel so they produce identical indices.
+struct Window {
+  uint32_t low;
+  uint32_t upper;  // low + range, may exceed 65535 for a degenerate window.
+  float scale;     // Table steps per count.
+};
+
+Window MakeWindow(uint16_t low, uint16_t high) {
+  const uint32_t range = high > low ? static_cast<uint32_t>(high - low) : 1;
+  return Window{low, low + range,
+                static_cast<float>(kPaletteTableSize - 1) /
+                    static_cast<float>(range)};
+}
+
+inline uint32_t TableIndex(uint32_t v, const Window &w) {
+  v = std::min(std::max(v, w.low), w.upper) - w.low;
+  const uint32_t idx =
+      static_cast<uint32_t>(static_cast<float>(v) * w.scale + 0.5f);
+  return std::min<uint32_t>(idx, kPaletteTableSize - 1);
+}
+
+// Computes a block of indices before doing the loads, so the table lookups
+// are independent of each other and can be issued back to back.
+void ColorizeRowScalar(const uint16_t *src, const uint32_t *table,
+                       uint8_t *dst, size_t width, const Window &w) {
+  constexpr size_t kBlock = 16;
+  uint32_t idx[kBlock];
+  uint32_t px[kBlock];
+  size_t x = 0;
+  for (; x + kBlock <= width; x += kBlock) {
+    for (size_t i = 0; i < kBlock; i++) idx[i] = TableIndex(src[x + i], w);
+    for (size_t i = 0; i < kBlock; i++) px[i] = table[idx[i]];
+    std::memcpy(dst + x * 4, px, sizeof(px));
+  }
+  for (; x < width; x++) {
+    const uint32_t p = table[TableIndex(src[x], w)];
+    std::memcpy(dst + x * 4, &p, 4);
+  }
+}
+
+#if defined(UVC_ARCH_X86)
+UVC_TARGET_AVX2 void ColorizeRowAvx2(const uint16_t *src,
+                                     const uint32_t *table, uint8_t *dst,
+                                     size_t width, const Window &w) {
+  const __m256i low = _mm256_set1_epi32(static_cast<int>(w.low));
+  const __m256i upper = _mm256_set1_epi32(static_cast<int>(w.upper));
+  const __m256i max_index =
+      _mm256_set1_epi32(static_cast<int>(kPaletteTableSize - 1));
+  const __m256 scale = _mm256_set1_ps(w.scale);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  const int *base = reinterpret_cast<const int *>(table);
+  size_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const __m128i raw =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+    __m256i v = _mm256_cvtepu16_epi32(raw);
+    v = _mm256_min_epu32(_mm256_max_epu32(v, low), upper);
+    v = _mm256_sub_epi32(v, low);
+    const __m256 f =
+        _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(v), scale), half);
+    const __m256i idx = _mm256_min_epi32(_mm256_cvttps_epi32(f), max_index);
+    const __m256i px = _mm256_i32gather_epi32(base, idx, 4);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x * 4), px);
+  }
+  ColorizeRowScalar(src + x, table, dst + x * 4, width - x, w);
+}
+#endif  // UVC_ARCH_X86
+
+}  // namespace
+
+const char *ThermalPaletteName(ThermalPalette palette) {
+  return kPalettes[static_cast<int>(palette)].name;
+}
+
+bool ParseThermalPalette(const char *name, ThermalPalette *palette) {
+  for (const auto &def : kPalettes) {
+    if (std::strcmp(def.name, name) == 0) {
+      *palette = def.palette;
+      return true;
+    }
+  }
+  return false;
+}
+
+const uint32_t *GetPaletteTable(ThermalPalette palette) {
+  const int i = static_cast<int>(palette);
+  std::call_once(g_built[i], [i] { BuildTable(kPalettes[i], g_tables[i]); });
+  return g_tables[i];
+}
+
+void ColorizeGray16WithLevel(SimdLevel level, const uint16_t *src,
+                             size_t src_stride_pixels, const uint32_t *table,
+                             uint8_t *dst, ptrdiff_t dst_stride, size_t width,
+                             size_t height, uint16_t low, uint16_t high) {
+  const Window w = MakeWindow(low, high);
+  auto row = ColorizeRowScalar;
+#if defined(UVC_ARCH_X86)
+  if (level == SimdLevel::kAvx2) row = ColorizeRowAvx2;
+#else
+  (void)level;
+#endif
+  for (size_t y = 0; y < height; y++) {
+    row(src + y * src_stride_pixels, table,
+        dst + static_cast<ptrdiff_t>(y) * dst_stride, width, w);
+  }
+}
+
+void ColorizeGray16(const uint16_t *src, size_t src_stride_pixels,
+                    const uint32_t *table, uint8_t *dst, ptrdiff_t dst_stride,
+                    size_t width, size_t height, uint16_t low, uint16_t high) {
+  ColorizeGray16WithLevel(GetSimdLevel(), src, src_stride_pixels, table, dst,
+                          dst_stride, width, height, low, high);
+}
+
+PaletteSelector::PaletteSelector(ThermalPalette initial)
+    : palette_(static_cast<int>(initial)),
+      table_(GetPaletteTable(initial)) {}
+
+void PaletteSelector::Select(ThermalPalette palette) {
+  // Build the table (once) before publishing it.
+  const uint32_t *table = GetPaletteTable(palette);
+  palette_.store(static_cast<int>(palette), std::memory_order_relaxed);
+  table_.store(table, std::memory_order_release);
+}
+
+ThermalPalette PaletteSelector::palette() const {
+  return static_cast<ThermalPalette>(palette_.load(std::memory_order_relaxed));
+}
+
+const uint32_t *PaletteSelector::table() const {
+  return table_.load(std::memory_order_acquire);
+}
+
+}  // namespace uvc
@@ -0,0 +1,68 @@
+#ifndef UVC_THERMAL_PALETTE_H_
+#define UVC_THERMAL_PALETTE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "cpu_features.h"
+
+namespace uvc {
+
+enum class ThermalPalette {
+  kWhiteHot,
+  kBlackHot,
+  kIronbow,
+  kRainbow,
+  kArctic,
+};
+
+constexpr int kThermalPaletteCount = 5;
+constexpr size_t kPaletteTableSize = 65536;
+
+// Name used on the method channel ("white_hot", "ironbow", ...).
+const char *ThermalPaletteName(ThermalPalette palette);
+
+// Parses a channel name. Returns false and leaves |palette| alone if unknown.
+bool ParseThermalPalette(const char *name, ThermalPalette *palette);
+
+// Returns the 64K-entry table of |palette|: entry i is the colour of
+// normalised intensity i / 65535 as an RGBA pixel in memory order (R in the
+// lowest byte on little-endian hosts). The table is 64-byte aligned, built
+// the first time it is requested and immutable afterwards, so the pointer may
+// be shared freely between threads.
+const uint32_t *GetPaletteTable(ThermalPalette palette);
+
+// Colours raw counts through |table|: counts are clamped to [low, high],
+// stretched onto the 16-bit table index and looked up. |dst_stride| is in
+// bytes. A degenerate window (high <= low) splits at |low|.
+void ColorizeGray16(const uint16_t *src, size_t src_stride_pixels,
+                    const uint32_t *table, uint8_t *dst, ptrdiff_t dst_stride,
+                    size_t width, size_t height, uint16_t low, uint16_t high);
+
+// Same, forced onto one kernel (AVX2 gather or blocked scalar). For tests and
+// benchmarks; the caller must make sure the CPU supports |level|.
+void ColorizeGray16WithLevel(SimdLevel level, const uint16_t *src,
+                             size_t src_stride_pixels, const uint32_t *table,
+                             uint8_t *dst, ptrdiff_t dst_stride, size_t width,
+                             size_t height, uint16_t low, uint16_t high);
+
+// The palette in use by a pipeline. Select() may be called from any thread
+// while the capture thread renders: switching is a single atomic pointer
+// store, and a frame in flight finishes with the table it started with.
+class PaletteSelector {
+ public:
+  explicit PaletteSelector(ThermalPalette initial = ThermalPalette::kWhiteHot);
+
+  void Select(ThermalPalette palette);
+  ThermalPalette palette() const;
+  const uint32_t *table() const;
+
+ private:
+  std::atomic<int> palette_;
+  std::atomic<const uint32_t *> table_;
+};
+
+}  // namespace uvc
+
+#endif  // UVC_THERMAL_PALETTE_H_
@@ -0,0 +1,77 @@
+#include "tone_curve.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "thermal_palette.h"
+
+namespace uvc {
+
+bool ToneSettings::IsValid() const {
+  return brightness >= 0 && brightness <= 1 && contrast >= 0 &&
+         contrast <= 1 && gamma >= kMinGamma && gamma <= kMaxGamma;
+}
+
+void BuildToneCurve(const ToneSettings &settings, uint8_t curve[256]) {
+  const double gain = std::exp2((settings.contrast - 0.5) * 4);
+  const double offset = settings.brightness - 0.5;
+  const double exponent = 1 / settings.gamma;
+  for (int v = 0; v < 256; v++) {
+    double y = std::pow(v / 255.0, exponent);
+    y = (y - 0.5) * gain + 0.5 + offset;
+    curve[v] = static_cast<uint8_t>(
+        std::lround(std::min(std::max(y, 0.0), 1.0) * 255));
+  }
+}
+
+ToneCurve::ToneCurve() {
+  for (int v = 0; v < 256; v++) {
+    curve_[v] = static_cast<uint8_t>(v);
+    swizzle_[v] = static_cast<uint32_t>(v) << 16;
+    swizzle_[256 + v] = static_cast<uint32_t>(v) << 8;
+    swizzle_[512 + v] = static_cast<uint32_t>(v);
+  }
+}
+
+void ToneCurve::Set(const ToneSettings &settings) {
+  settings_ = settings;
+  published_.WriteBuffer() = settings;
+  published_.Publish();
+}
+
+bool ToneCurve::Update() {
+  if (published_.Update()) {
+    const ToneSettings &settings = published_.ReadBuffer();
+    BuildToneCurve(settings, curve_);
+    for (int v = 0; v < 256; v++) {
+      swizzle_[v] = static_cast<uint32_t>(curve_[v]) << 16;
+      swizzle_[256 + v] = static_cast<uint32_t>(curve_[v]) << 8;
+      swizzle_[512 + v] = curve_[v];
+    }
+    neutral_ = settings.IsNeutral();
+    palette_stale_ = true;
+  }
+  return !neutral_;
+}
+
+const uint32_t *ToneCurve::Apply(const uint32_t *palette) {
+  if (neutral_) return palette;
+  if (!palette_stale_ && palette == toned_from_) {
+    return palettes_[palette_slot_].get();
+  }
+  palette_slot_ ^= 1;
+  std::unique_ptr<uint32_t[]> &toned = palettes_[palette_slot_];
+  if (!toned) toned.reset(new uint32_t[kPaletteTableSize]);
+  for (size_t i = 0; i < kPaletteTableSize; i++) {
+    const uint32_t c = palette[i];
+    toned[i] = (c & 0xFF000000u) |
+               (static_cast<uint32_t>(curve_[(c >> 16) & 0xFF]) << 16) |
+               (static_cast<uint32_t>(curve_[(c >> 8) & 0xFF]) << 8) |
+               curve_[c & 0xFF];
+  }
+  toned_from_ = palette;
+  palette_stale_ = false;
+  return toned.get();
+}
+
+}  // namespace uvc
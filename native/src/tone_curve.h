@@ -0,0 +1,96 @@
+#ifndef UVC_TONE_CURVE_H_
+#define UVC_TONE_CURVE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "triple_buffer.h"
+
+namespace uvc {
+
+// The preview's brightness, contrast and gamma sliders.
+struct ToneSettings {
+  // 0..1 with 0.5 neutral: shifts the output by up to half the range either
+  // way.
+  double brightness = 0.5;
+  // 0..1 with 0.5 neutral: scales around mid-grey by 1/4 (0) to 4 (1).
+  double contrast = 0.5;
+  // kMinGamma..kMaxGamma with 1 neutral: out = in^(1 / gamma), applied
+  // before contrast and brightness, so gamma > 1 lifts the shadows.
+  double gamma = 1.0;
+
+  static constexpr double kMinGamma = 0.1;
+  static constexpr double kMaxGamma = 10.0;
+
+  bool IsNeutral() const {
+    return brightness == 0.5 && contrast == 0.5 && gamma == 1.0;
+  }
+  // Whether every field is in range.
+  bool IsValid() const;
+};
+
+// Fills |curve| with the 8-bit mapping of |settings|.
+void BuildToneCurve(const ToneSettings &settings, uint8_t curve[256]);
+
+// Display adjustments as lookup tables, so they cost nothing beyond the
+// conversion pass that already touches every pixel: three per-channel
+// tables with the BGRA->RGBA swizzle folded in (ConvertBgraToRgbaLut()), the
+// curve itself for the YUV kernels to map through as they store, and for
+// raw frames a copy of the palette mapped through the curve, which the AGC
+// renders through instead of the palette. MJPEG frames, decoded off the
+// capture thread, carry a copy of the curve to the decoder
+// (MjpegPipeline::Submit()), which maps the rows as it writes them.
+//
+// The platform thread sets the sliders; the capture thread calls Update()
+// at the start of each frame and rebuilds the tables only when the settings
+// changed. They meet in a TripleBuffer, so a slider drag never blocks or is
+// blocked by the capture thread.
+class ToneCurve {
+ public:
+  // Entries in swizzle_lut().
+  static constexpr size_t kSwizzleLutSize = 3 * 256;
+
+  ToneCurve();
+  ToneCurve(const ToneCurve &) = delete;
+  ToneCurve &operator=(const ToneCurve &) = delete;
+
+  // Platform thread: publishes |settings| to the capture thread.
+  void Set(const ToneSettings &settings);
+  // Platform thread: the settings last Set().
+  const ToneSettings &settings() const { return settings_; }
+
+  // Capture thread: takes the newest settings and rebuilds the tables if
+  // they changed. Returns whether the curve is not neutral, i.e. whether
+  // frames need it.
+  bool Update();
+
+  // Capture thread, after Update(). The 256-entry curve.
+  const uint8_t *curve() const { return curve_; }
+  // Entry v of table c is curve[v] at the byte BGRA source byte c (B, G or
+  // R) takes in RGBA output: curve[v] << 16, << 8 and << 0.
+  const uint32_t *swizzle_lut() const { return swizzle_; }
+  // |palette| (a 64K table from GetPaletteTable) with every colour mapped
+  // through the curve, or |palette| itself when the curve is neutral. The
+  // copy is rebuilt when the curve or |palette| changes, and into the other
+  // of two buffers, so a consumer that caches tables by address (AutoGain)
+  // sees the change.
+  const uint32_t *Apply(const uint32_t *palette);
+
+ private:
+  TripleBuffer<ToneSettings> published_;
+  // Platform thread.
+  ToneSettings settings_;
+  // Capture thread.
+  bool neutral_ = true;
+  uint8_t curve_[256];
+  uint32_t swizzle_[kSwizzleLutSize];
+  std::unique_ptr<uint32_t[]> palettes_[2];
+  int palette_slot_ = 0;
+  const uint32_t *toned_from_ = nullptr;
+  bool palette_stale_ = true;
+};
+
+}  // namespace uvc
+
+#endif  // UVC_TONE_CURVE_H_
@@ -0,0 +1,81 @@
+#ifndef UVC_TRIPLE_BUFFER_H_
+#define UVC_TRIPLE_BUFFER_H_
+
+#include <atomic>
+#include <cstdint>
+
+namespace uvc {
+
+// Wait-free single-producer / single-consumer exchange of the newest value.
+//
+// Three slots rotate between the roles "back" (owned by the producer),
+// "middle" (the most recently published value) and "front" (owned by the
+// consumer). The producer fills its back slot and publishes it by swapping it
+// with the middle slot; the consumer takes the middle slot by swapping it
+// with its front slot. Each side touches one shared atomic per operation and
+// never waits for the other, so a slow consumer only ever misses frames and a
+// slow producer only ever makes the consumer see the same frame again.
+//
+// Slots are reused, never reallocated by the exchange itself, which lets
+// callers keep large per-slot buffers and resize them only from the side that
+// currently owns the slot.
+template <typename T>
+class TripleBuffer {
+ public:
+  TripleBuffer() = default;
+  TripleBuffer(const TripleBuffer &) = delete;
+  TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+  // Producer: the slot to fill. Stays owned by the producer until Publish().
+  T &WriteBuffer() { return slots_[back_].value; }
+
+  // Producer: makes the back slot the newest value and takes the previous
+  // middle slot (possibly never seen by the consumer) as the new back slot.
+  void Publish() {
+    const uint8_t previous =
+        middle_.exchange(static_cast<uint8_t>(back_ | kFreshBit),
+                         std::memory_order_acq_rel);
+    back_ = previous & kIndexMask;
+  }
+
+  // Consumer: moves the newest published value into the front slot. Returns
+  // false (and leaves the front slot alone) if nothing was published since
+  // the last call.
+  bool Update() {
+    if ((middle_.load(std::memory_order_relaxed) & kFreshBit) == 0) {
+      return false;
+    }
+    const uint8_t previous =
+        middle_.exchange(front_, std::memory_order_acq_rel);
+    front_ = previous & kIndexMask;
+    return true;
+  }
+
+  // Consumer: the value taken by the last successful Update(). Stays valid
+  // and unchanged until the next Update().
+  const T &ReadBuffer() const { return slots_[front_].value; }
+  T &ReadBuffer() { return slots_[front_].value; }
+
+  // Either side: whether a value is waiting for the consumer.
+  bool HasFresh() const {
+    return (middle_.load(std::memory_order_acquire) & kFreshBit) != 0;
+  }
+
+ private:
+  static constexpr uint8_t kIndexMask = 0x3;
+  static constexpr uint8_t kFreshBit = 0x4;
+
+  // Keeps the producer and consumer slots on separate cache lines.
+  struct alignas(64) Slot {
+    T value{};
+  };
+
+  Slot slots_[3];
+  alignas(64) std::atomic<uint8_t> middle_{1};
+  alignas(64) uint8_t back_ = 0;   // Producer only.
+  alignas(64) uint8_t front_ = 2;  // Consumer only.
+};
+
+}  // namespace uvc
+
+#endif  // UVC_TRIPLE_BUFFER_H_
@@ -0,0 +1,612 @@
+#include "v4l2_device.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/dma-buf.h>
+#include <linux/dma-heap.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace uvc {
+
+namespace {
+
+constexpr char kDmaHeapPath[] = "/dev/dma_heap/system";
+
+int RetryIoctl(int fd, unsigned long request, void *arg) {
+  int r;
+  do {
+    r = ioctl(fd, request, arg);
+  } while (r == -1 && errno == EINTR);
+  return r;
+}
+
+uint32_t DeviceCaps(const v4l2_capability &cap) {
+  return (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps
+                                                   : cap.capabilities;
+}
+
+// Parses N out of "videoN"; -1 for anything else.
+int VideoNodeNumber(const char *name) {
+  if (std::strncmp(name, "video", 5) != 0 || name[5] == '\0') return -1;
+  char *end = nullptr;
+  const long n = std::strtol(name + 5, &end, 10);
+  return *end == '\0' ? static_cast<int>(n) : -1;
+}
+
+// The USB serial number of the device behind /dev/|node|, from sysfs; empty
+// if it has none or is not a USB device. The node's "device" link is the
+// video interface, whose parent is the USB device.
+std::string UsbSerial(const char *node) {
+  std::ifstream file(std::string("/sys/class/video4linux/") + node +
+                     "/device/../serial");
+  std::string serial;
+  std::getline(file, serial);
+  return serial;
+}
+
+void AddIntervals(int fd, uint32_t fourcc, uint32_t width, uint32_t height,
+                  std::vector<V4l2FrameMode> *modes) {
+  const size_t before = modes->size();
+  v4l2_frmivalenum ival{};
+  ival.pixel_format = fourcc;
+  ival.width = width;
+  ival.height = height;
+  for (ival.index = 0; RetryIoctl(fd, VIDIOC_ENUM_FRAMEINTERVALS, &ival) == 0;
+       ival.index++) {
+    // Intervals are seconds per frame; the mode stores frames per second.
+    const v4l2_fract &interval = ival.type == V4L2_FRMIVAL_TYPE_DISCRETE
+                                     ? ival.discrete
+                                     : ival.stepwise.min;
+    modes->push_back(V4l2FrameMode{fourcc, width, height, interval.denominator,
+                                   interval.numerator});
+    if (ival.type != V4L2_FRMIVAL_TYPE_DISCRETE) break;
+  }
+  if (modes->size() == before) {
+    modes->push_back(V4l2FrameMode{fourcc, width, height, 0, 1});
+  }
+}
+
+}  // namespace
+
+std::vector<V4l2DeviceInfo> EnumerateV4l2Devices() {
+  std::vector<std::pair<int, V4l2DeviceInfo>> found;
+  DIR *dir = opendir("/dev");
+  if (!dir) return {};
+  while (const dirent *entry = readdir(dir)) {
+    const int number = VideoNodeNumber(entry->d_name);
+    if (number < 0) continue;
+    const std::string path = std::string("/dev/") + entry->d_name;
+    const int fd = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) continue;
+    v4l2_capability cap{};
+    if (RetryIoctl(fd, VIDIOC_QUERYCAP, &cap) == 0) {
+      const uint32_t caps = DeviceCaps(cap);
+      if ((caps & V4L2_CAP_VIDEO_CAPTURE) && (caps & V4L2_CAP_STREAMING)) {
+        V4l2DeviceInfo info;
+        info.path = path;
+        info.card = reinterpret_cast<const char *>(cap.card);
+        info.driver = reinterpret_cast<const char *>(cap.driver);
+        info.bus_info = reinterpret_cast<const char *>(cap.bus_info);
+        info.serial = UsbSerial(entry->d_name);
+        found.emplace_back(number, std::move(info));
+      }
+    }
+    close(fd);
+  }
+  closedir(dir);
+
+  std::sort(found.begin(), found.end(),
+            [](const auto &a, const auto &b) { return a.first < b.first; });
+  std::vector<V4l2DeviceInfo> devices;
+  for (auto &entry : found) devices.push_back(std::move(entry.second));
+  return devices;
+}
+
+V4l2Conversion ConversionForFourcc(uint32_t fourcc) {
+  switch (fourcc) {
+    case V4L2_PIX_FMT_ABGR32:
+    case V4L2_PIX_FMT_XBGR32:
+    case V4L2_PIX_FMT_BGR32:
+      return V4l2Conversion::kBgra;
+    case V4L2_PIX_FMT_YUYV:
+      return V4l2Conversion::kYuyv;
+    case V4L2_PIX_FMT_UYVY:
+      return V4l2Conversion::kUyvy;
+    case V4L2_PIX_FMT_NV12:
+      return V4l2Conversion::kNv12;
+    case V4L2_PIX_FMT_MJPEG:
+      return V4l2Conversion::kMjpeg;
+    case V4L2_PIX_FMT_Y16:
+    case V4L2_PIX_FMT_Y14:
+      return V4l2Conversion::kRaw16;
+    default:
+      return V4l2Conversion::kUnsupported;
+  }
+}
+
+RawPacking RawPackingForFourcc(uint32_t fourcc) {
+  switch (fourcc) {
+    case V4L2_PIX_FMT_Y16:
+      return RawPacking::kY16;
+    case V4L2_PIX_FMT_Y14:
+      return RawPacking::kY14;
+    case V4L2_PIX_FMT_YUYV:
+      return RawPacking::kYuy2Raw16;
+    default:
+      return RawPacking::kNone;
+  }
+}
+
+VideoSubtype SubtypeForFourcc(uint32_t fourcc) {
+  switch (fourcc) {
+    case V4L2_PIX_FMT_ABGR32:
+    case V4L2_PIX_FMT_XBGR32:
+    case V4L2_PIX_FMT_BGR32:
+      return VideoSubtype::kRgb32;
+    case V4L2_PIX_FMT_YUYV:
+      return VideoSubtype::kYuy2;
+    case V4L2_PIX_FMT_UYVY:
+      return VideoSubtype::kUyvy;
+    case V4L2_PIX_FMT_NV12:
+      return VideoSubtype::kNv12;
+    case V4L2_PIX_FMT_MJPEG:
+      return VideoSubtype::kMjpg;
+    case V4L2_PIX_FMT_Y16:
+      return VideoSubtype::kY16;
+    case V4L2_PIX_FMT_Y14:
+      return VideoSubtype::kY14;
+    default:
+      return VideoSubtype::kUnknown;
+  }
+}
+
+CapabilityIndex IndexV4l2Modes(const std::vector<V4l2FrameMode> &modes) {
+  CapabilityIndex index;
+  for (size_t i = 0; i < modes.size(); i++) {
+    const V4l2FrameMode &mode = modes[i];
+    Capability capability;
+    capability.subtype = SubtypeForFourcc(mode.fourcc);
+    capability.width = mode.width;
+    capability.height = mode.height;
+    capability.rate = FrameRate{mode.fps_numerator, mode.fps_denominator};
+    capability.native_index = static_cast<uint32_t>(i);
+    index.Add(capability);
+  }
+  return index;
+}
+
+bool ChooseV4l2Mode(const std::vector<V4l2FrameMode> &modes, bool raw,
+                    bool raw_yuy2, uint32_t width, uint32_t height,
+                    const FrameRate &rate, V4l2FrameMode *chosen) {
+  FormatRequest request;
+  request.width = width;
+  request.height = height;
+  request.rate = rate;
+  request.raw = raw;
+  request.raw_yuy2 = raw_yuy2;
+  request.direct_subtypes = kV4l2DirectSubtypes;
+  NegotiatedFormat negotiated;
+  if (!NegotiateFormat(IndexV4l2Modes(modes), request, &negotiated)) {
+    return false;
+  }
+  *chosen = modes[negotiated.native.native_index];
+  return true;
+}
+
+V4l2Device::V4l2Device() : wake_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+
+V4l2Device::~V4l2Device() {
+  Close();
+  if (wake_fd_ >= 0) close(wake_fd_);
+}
+
+bool V4l2Device::Open(const std::string &path) {
+  Close();
+  fd_ = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (fd_ < 0) return Fail();
+
+  v4l2_capability cap{};
+  if (Ioctl(VIDIOC_QUERYCAP, &cap) != 0) {
+    Fail();
+    Close();
+    return false;
+  }
+  const uint32_t caps = DeviceCaps(cap);
+  if (!(caps & V4L2_CAP_VIDEO_CAPTURE) || !(caps & V4L2_CAP_STREAMING)) {
+    Close();
+    last_error_ = ENODEV;
+    return false;
+  }
+
+  v4l2_format fmt{};
+  fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  if (Ioctl(VIDIOC_G_FMT, &fmt) == 0) {
+    fourcc_ = fmt.fmt.pix.pixelformat;
+    width_ = fmt.fmt.pix.width;
+    height_ = fmt.fmt.pix.height;
+    bytes_per_line_ = fmt.fmt.pix.bytesperline;
+    size_image_ = fmt.fmt.pix.sizeimage;
+  }
+  return true;
+}
+
+void V4l2Device::Close() {
+  StopStreaming();
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+std::vector<V4l2FrameMode> V4l2Device::EnumerateModes() const {
+  std::vector<V4l2FrameMode> modes;
+  if (fd_ < 0) return modes;
+  v4l2_fmtdesc desc{};
+  desc.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  for (desc.index = 0; Ioctl(VIDIOC_ENUM_FMT, &desc) == 0; desc.index++) {
+    v4l2_frmsizeenum size{};
+    size.pixel_format = desc.pixelformat;
+    for (size.index = 0; Ioctl(VIDIOC_ENUM_FRAMESIZES, &size) == 0;
+         size.index++) {
+      if (size.type == V4L2_FRMSIZE_TYPE_DISCRETE) {
+        AddIntervals(fd_, desc.pixelformat, size.discrete.width,
+                     size.discrete.height, &modes);
+        continue;
+      }
+      AddIntervals(fd_, desc.pixelformat, size.stepwise.min_width,
+                   size.stepwise.min_height, &modes);
+      AddIntervals(fd_, desc.pixelformat, size.stepwise.max_width,
+                   size.stepwise.max_height, &modes);
+      break;
+    }
+  }
+  return modes;
+}
+
+bool V4l2Device::SetFormat(uint32_t fourcc, uint32_t width, uint32_t height,
+                           uint32_t fps_numerator, uint32_t fps_denominator) {
+  v4l2_format fmt{};
+  fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  fmt.fmt.pix.pixelformat = fourcc;
+  fmt.fmt.pix.width = width;
+  fmt.fmt.pix.height = height;
+  fmt.fmt.pix.field = V4L2_FIELD_NONE;
+  if (Ioctl(VIDIOC_S_FMT, &fmt) != 0) return Fail();
+  fourcc_ = fmt.fmt.pix.pixelformat;
+  width_ = fmt.fmt.pix.width;
+  height_ = fmt.fmt.pix.height;
+  bytes_per_line_ = fmt.fmt.pix.bytesperline;
+  size_image_ = fmt.fmt.pix.sizeimage;
+
+  if (fps_numerator != 0) {
+    // Not every driver can change the rate; the format still stands.
+    v4l2_streamparm parm{};
+    parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    parm.parm.capture.timeperframe.numerator = fps_denominator;
+    parm.parm.capture.timeperframe.denominator = fps_numerator;
+    Ioctl(VIDIOC_S_PARM, &parm);
+  }
+  return true;
+}
+
+bool V4l2Device::StartStreaming(V4l2IoMode mode, unsigned buffer_count) {
+  if (fd_ < 0 || streaming_) return false;
+  bool allocated = false;
+  if (mode == V4l2IoMode::kDmabuf) {
+    allocated = AllocateDmabuf(buffer_count);
+    if (!allocated) FreeBuffers();
+  }
+  if (!allocated && !AllocateMmap(buffer_count)) {
+    FreeBuffers();
+    return false;
+  }
+
+  for (uint32_t i = 0; i < buffers_.size(); i++) {
+    V4l2Buffer buffer;
+    buffer.index = i;
+    if (!Requeue(buffer)) {
+      FreeBuffers();
+      return false;
+    }
+  }
+  // Forget a wake-up aimed at the previous session.
+  uint64_t pending;
+  while (read(wake_fd_, &pending, sizeof(pending)) > 0) {
+  }
+  int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  if (Ioctl(VIDIOC_STREAMON, &type) != 0) {
+    Fail();
+    FreeBuffers();
+    return false;
+  }
+  streaming_ = true;
+  return true;
+}
+
+void V4l2Device::StopStreaming() {
+  if (streaming_) {
+    int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    Ioctl(VIDIOC_STREAMOFF, &type);
+    streaming_ = false;
+  }
+  FreeBuffers();
+}
+
+bool V4l2Device::AllocateMmap(unsigned count) {
+  v4l2_requestbuffers req{};
+  req.count = count;
+  req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  req.memory = V4L2_MEMORY_MMAP;
+  if (Ioctl(VIDIOC_REQBUFS, &req) != 0 || req.count == 0) return Fail();
+  io_mode_ = V4l2IoMode::kMmap;
+  buffers_.resize(req.count);
+  for (uint32_t i = 0; i < req.count; i++) {
+    v4l2_buffer buf{};
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = i;
+    if (Ioctl(VIDIOC_QUERYBUF, &buf) != 0) return Fail();
+    void *address =
+        mmap(nullptr, buf.length, PROT_READ, MAP_SHARED, fd_, buf.m.offset);
+    if (address == MAP_FAILED) return Fail();
+    buffers_[i].address = address;
+    buffers_[i].length = buf.length;
+  }
+  return true;
+}
+
+bool V4l2Device::AllocateDmabuf(unsigned count) {
+  const int heap = open(kDmaHeapPath, O_RDONLY | O_CLOEXEC);
+  if (heap < 0) return Fail();
+
+  v4l2_requestbuffers req{};
+  req.count = count;
+  req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  req.memory = V4L2_MEMORY_DMABUF;
+  bool ok = Ioctl(VIDIOC_REQBUFS, &req) == 0 && req.count > 0;
+  if (ok) {
+    io_mode_ = V4l2IoMode::kDmabuf;
+    buffers_.resize(req.count);
+  }
+  for (uint32_t i = 0; ok && i < req.count; i++) {
+    dma_heap_allocation_data alloc{};
+    alloc.len = size_image_;
+    alloc.fd_flags = O_RDWR | O_CLOEXEC;
+    if (RetryIoctl(heap, DMA_HEAP_IOCTL_ALLOC, &alloc) != 0) {
+      ok = false;
+      break;
+    }
+    buffers_[i].dmabuf_fd = static_cast<int>(alloc.fd);
+    buffers_[i].length = size_image_;
+    void *address = mmap(nullptr, size_image_, PROT_READ, MAP_SHARED,
+                         buffers_[i].dmabuf_fd, 0);
+    if (address == MAP_FAILED) {
+      ok = false;
+      break;
+    }
+    buffers_[i].address = address;
+  }
+  if (!ok) Fail();
+  close(heap);
+  return ok;
+}
+
+void V4l2Device::FreeBuffers() {
+  if (buffers_.empty()) return;
+  for (Mapping &mapping : buffers_) {
+    if (mapping.address) munmap(mapping.address, mapping.length);
+    if (mapping.dmabuf_fd >= 0) close(mapping.dmabuf_fd);
+  }
+  buffers_.clear();
+  if (fd_ >= 0) {
+    v4l2_requestbuffers req{};
+    req.count = 0;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = io_mode_ == V4l2IoMode::kDmabuf ? V4L2_MEMORY_DMABUF
+                                                 : V4L2_MEMORY_MMAP;
+    Ioctl(VIDIOC_REQBUFS, &req);
+  }
+}
+
+V4l2Device::WaitResult V4l2Device::Dequeue(int timeout_ms,
+                                           V4l2Buffer *buffer) {
+  if (!streaming_) return WaitResult::kError;
+  pollfd fds[2] = {{fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+  const int ready = poll(fds, 2, timeout_ms);
+  if (ready < 0) {
+    if (errno == EINTR) return WaitResult::kTimeout;
+    Fail();
+    return WaitResult::kError;
+  }
+  if (fds[1].revents & POLLIN) {
+    uint64_t count;
+    while (read(wake_fd_, &count, sizeof(count)) > 0) {
+    }
+    return WaitResult::kInterrupted;
+  }
+  if (ready == 0) return WaitResult::kTimeout;
+  if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+    last_error_ = ENODEV;  // Unplugged.
+    return WaitResult::kError;
+  }
+
+  v4l2_buffer buf{};
+  buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  buf.memory = io_mode_ == V4l2IoMode::kDmabuf ? V4L2_MEMORY_DMABUF
+                                               : V4L2_MEMORY_MMAP;
+  if (Ioctl(VIDIOC_DQBUF, &buf) != 0) {
+    if (errno == EAGAIN) return WaitResult::kTimeout;
+    Fail();
+    return WaitResult::kError;
+  }
+  const Mapping &mapping = buffers_[buf.index];
+  if (mapping.dmabuf_fd >= 0) {
+    dma_buf_sync sync{DMA_BUF_SYNC_START | DMA_BUF_SYNC_READ};
+    RetryIoctl(mapping.dmabuf_fd, DMA_BUF_IOCTL_SYNC, &sync);
+  }
+  buffer->data = static_cast<const uint8_t *>(mapping.address);
+  buffer->bytes_used = buf.bytesused;
+  buffer->index = buf.index;
+  buffer->sequence = buf.sequence;
+  buffer->timestamp_us =
+      static_cast<int64_t>(buf.timestamp.tv_sec) * 1000000 +
+      buf.timestamp.tv_usec;
+  return WaitResult::kFrame;
+}
+
+bool V4l2Device::Requeue(const V4l2Buffer &buffer) {
+  if (buffer.index >= buffers_.size()) {
+    last_error_ = EINVAL;
+    return false;
+  }
+  const Mapping &mapping = buffers_[buffer.index];
+  v4l2_buffer buf{};
+  buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  buf.index = buffer.index;
+  if (io_mode_ == V4l2IoMode::kDmabuf) {
+    if (buffer.data) {
+      dma_buf_sync sync{DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ};
+      RetryIoctl(mapping.dmabuf_fd, DMA_BUF_IOCTL_SYNC, &sync);
+    }
+    buf.memory = V4L2_MEMORY_DMABUF;
+    buf.m.fd = mapping.dmabuf_fd;
+    buf.length = static_cast<uint32_t>(mapping.length);
+  } else {
+    buf.memory = V4L2_MEMORY_MMAP;
+  }
+  if (Ioctl(VIDIOC_QBUF, &buf) != 0) return Fail();
+  return true;
+}
+
+void V4l2Device::Interrupt() {
+  const uint64_t one = 1;
+  if (write(wake_fd_, &one, sizeof(one)) < 0) {
+    // Only fails if the counter would overflow, i.e. a wake-up is pending.
+  }
+}
+
+bool V4l2Device::Fail() {
+  last_error_ = errno;
+  return false;
+}
+
+int V4l2Device::Ioctl(unsigned long request, void *arg) const {
+  return RetryIoctl(fd_, request, arg);
+}
+
+V4l2Source::OpenResult V4l2Source::Open(const std::string &path, bool raw,
+                                        bool raw_yuy2, uint32_t width,
+                                        uint32_t height,
+                                        const FrameRate &rate) {
+  if (!device_.Open(path)) return OpenResult::kOpenFailed;
+
+  const std::vector<V4l2FrameMode> modes = device_.EnumerateModes();
+  FormatRequest request;
+  request.width = width;
+  request.height = height;
+  request.rate = rate;
+  request.raw = raw;
+  request.raw_yuy2 = raw_yuy2;
+  request.direct_subtypes = kV4l2DirectSubtypes;
+  NegotiatedFormat negotiated;
+  if (!NegotiatePreviewFormat(IndexV4l2Modes(modes), request, &negotiated)) {
+    device_.Close();
+    return OpenResult::kUnsupportedFormat;
+  }
+  raw = negotiated.path == FormatPath::kRaw;
+  const V4l2FrameMode &chosen = modes[negotiated.native.native_index];
+  if (!device_.SetFormat(chosen.fourcc, chosen.width, chosen.height,
+                         chosen.fps_numerator, chosen.fps_denominator)) {
+    device_.Close();
+    return OpenResult::kFormatFailed;
+  }
+
+  // The driver may have adjusted the request.
+  const V4l2Conversion conversion = ConversionForFourcc(device_.fourcc());
+  const RawPacking packing =
+      raw ? RawPackingForFourcc(device_.fourcc()) : RawPacking::kNone;
+  if (packing != RawPacking::kNone) {
+    mode_.format = SourcePixelFormat::kGray16;
+    mode_.bit_depth = RawBitDepth(packing);
+  } else if (conversion == V4l2Conversion::kBgra) {
+    mode_.format = SourcePixelFormat::kBgra32;
+    mode_.bit_depth = 8;
+  } else if (conversion == V4l2Conversion::kYuyv) {
+    mode_.format = SourcePixelFormat::kYuyv;
+    mode_.bit_depth = 8;
+  } else if (conversion == V4l2Conversion::kUyvy) {
+    mode_.format = SourcePixelFormat::kUyvy;
+    mode_.bit_depth = 8;
+  } else if (conversion == V4l2Conversion::kNv12) {
+    mode_.format = SourcePixelFormat::kNv12;
+    mode_.bit_depth = 8;
+  } else if (conversion == V4l2Conversion::kMjpeg &&
+             (kV4l2DirectSubtypes & SubtypeBit(VideoSubtype::kMjpg)) != 0) {
+    mode_.format = SourcePixelFormat::kMjpeg;
+    mode_.bit_depth = 8;
+  } else {
+    device_.Close();
+    return OpenResult::kUnsupportedFormat;
+  }
+  mode_.width = device_.width();
+  mode_.height = device_.height();
+  mode_.fps_numerator = chosen.fps_numerator;
+  mode_.fps_denominator = chosen.fps_denominator;
+  return OpenResult::kOk;
+}
+
+bool V4l2Source::Start() {
+  return device_.StartStreaming(V4l2IoMode::kDmabuf);
+}
+
+void V4l2Source::Stop() { device_.Close(); }
+
+SourceStatus V4l2Source::Next(int timeout_ms, SourceFrame *frame) {
+  for (;;) {
+    V4l2Buffer buffer;
+    switch (device_.Dequeue(timeout_ms, &buffer)) {
+      case V4l2Device::WaitResult::kFrame:
+        break;
+      case V4l2Device::WaitResult::kTimeout:
+        return SourceStatus::kTimeout;
+      case V4l2Device::WaitResult::kInterrupted:
+        return SourceStatus::kInterrupted;
+      case V4l2Device::WaitResult::kError:
+        return SourceStatus::kError;
+    }
+    // Compressed frames vary in size; anything else short is corrupt.
+    if (mode_.format == SourcePixelFormat::kMjpeg ? buffer.bytes_used == 0
+                                                  : buffer.bytes_used <
+                                                        device_.size_image()) {
+      device_.Requeue(buffer);
+      continue;
+    }
+    frame->data = buffer.data;
+    frame->size = buffer.bytes_used;
+    frame->stride = device_.bytes_per_line();
+    frame->sequence = buffer.sequence;
+    frame->timestamp = buffer.timestamp_us * 10;
+    frame->index = buffer.index;
+    return SourceStatus::kFrame;
+  }
+}
+
+void V4l2Source::Release(const SourceFrame &frame) {
+  V4l2Buffer buffer;
+  buffer.data = frame.data;
+  buffer.index = frame.index;
+  device_.Requeue(buffer);
+}
+
+}  // namespace uvc
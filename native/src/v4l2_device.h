@@ -0,0 +1,210 @@
+#ifndef UVC_V4L2_DEVICE_H_
+#define UVC_V4L2_DEVICE_H_
+
+// Video4Linux2 capture device used by the Linux runner. Linux only.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "format_negotiation.h"
+#include "frame_source.h"
+#include "raw_convert.h"
+
+namespace uvc {
+
+// A /dev/video* node that can capture video.
+struct V4l2DeviceInfo {
+  std::string path;      // "/dev/video0"
+  std::string card;      // Human-readable name reported by the driver.
+  std::string driver;    // "uvcvideo", "vivid", ...
+  std::string bus_info;  // Stable across reboots for USB devices.
+  std::string serial;    // USB serial number; empty if there is none.
+};
+
+// Capture nodes sorted by their /dev/videoN number. Metadata and output-only
+// nodes (every UVC camera exposes one of each) are skipped.
+std::vector<V4l2DeviceInfo> EnumerateV4l2Devices();
+
+// One format/size/frame-rate combination a device offers. The frame rate is
+// the exact fraction the driver reports, e.g. 30000/1001.
+struct V4l2FrameMode {
+  uint32_t fourcc;
+  uint32_t width;
+  uint32_t height;
+  uint32_t fps_numerator;
+  uint32_t fps_denominator;
+};
+
+// How the decoded frame of a mode is turned into RGBA.
+enum class V4l2Conversion {
+  kUnsupported,
+  kBgra,  // 32-bit B, G, R, A/X in memory: swizzle only.
+  kYuyv,  // 4:2:2 Y0 U Y1 V.
+  kUyvy,  // 4:2:2 U Y0 V Y1.
+  kNv12,  // 4:2:0, Y plane then interleaved UV.
+  kMjpeg, // Motion JPEG, decoded by MjpegPipeline.
+  kRaw16, // 16-bit counts, see RawPackingForFourcc.
+};
+
+V4l2Conversion ConversionForFourcc(uint32_t fourcc);
+RawPacking RawPackingForFourcc(uint32_t fourcc);
+
+VideoSubtype SubtypeForFourcc(uint32_t fourcc);
+
+// Colour subtypes the capture loop converts itself; MJPEG only when built
+// with libjpeg.
+constexpr uint32_t kV4l2DirectSubtypes =
+    SubtypeBit(VideoSubtype::kRgb32) | SubtypeBit(VideoSubtype::kYuy2) |
+    SubtypeBit(VideoSubtype::kUyvy) | SubtypeBit(VideoSubtype::kNv12)
+#if defined(UVC_HAVE_JPEG)
+    | SubtypeBit(VideoSubtype::kMjpg)
+#endif
+    ;
+
+// |modes| as a capability index; native_index is the position in |modes|.
+CapabilityIndex IndexV4l2Modes(const std::vector<V4l2FrameMode> &modes);
+
+// Picks the mode to open with NegotiateFormat(). With |raw| only raw 16-bit
+// formats qualify: 'Y16 ' and 'Y14 ', then YUYV used as a raw transport if
+// |raw_yuy2| (see FormatRequest::raw_yuy2);
+// otherwise BGRA formats are preferred over YUV ones. A mode matching |width| x
+// |height| (0 = any) and then |rate| (unknown = any) outranks the format.
+// Returns false if nothing qualifies.
+bool ChooseV4l2Mode(const std::vector<V4l2FrameMode> &modes, bool raw,
+                    bool raw_yuy2, uint32_t width, uint32_t height,
+                    const FrameRate &rate, V4l2FrameMode *chosen);
+inline bool ChooseV4l2Mode(const std::vector<V4l2FrameMode> &modes, bool raw,
+                           bool raw_yuy2, uint32_t width, uint32_t height,
+                           V4l2FrameMode *chosen) {
+  return ChooseV4l2Mode(modes, raw, raw_yuy2, width, height, FrameRate(),
+                        chosen);
+}
+
+enum class V4l2IoMode {
+  // Driver-allocated buffers mapped into the process.
+  kMmap,
+  // Buffers allocated from the system DMA heap and imported by the driver,
+  // the same memory a GPU or encoder could import without a copy.
+  kDmabuf,
+};
+
+// A dequeued buffer. |data| stays valid until the buffer is requeued.
+struct V4l2Buffer {
+  const uint8_t *data = nullptr;
+  size_t bytes_used = 0;
+  uint32_t index = 0;
+  uint32_t sequence = 0;
+  // Driver timestamp (CLOCK_MONOTONIC on every current driver), microseconds.
+  int64_t timestamp_us = 0;
+};
+
+// Owns one open capture node and its streaming buffers. Methods report
+// failure through their return value; last_error() has the errno.
+//
+// Dequeue() runs on the capture thread. Interrupt() may be called from any
+// thread to wake a Dequeue() blocked in poll().
+class V4l2Device {
+ public:
+  enum class WaitResult { kFrame, kTimeout, kInterrupted, kError };
+
+  V4l2Device();
+  ~V4l2Device();
+  V4l2Device(const V4l2Device &) = delete;
+  V4l2Device &operator=(const V4l2Device &) = delete;
+
+  bool Open(const std::string &path);
+  void Close();
+  bool is_open() const { return fd_ >= 0; }
+
+  // Every discrete mode of the device. Step-wise sizes are reported at their
+  // minimum and maximum; continuous frame intervals at the fastest rate.
+  std::vector<V4l2FrameMode> EnumerateModes() const;
+
+  // Sets the capture format and, if |fps_numerator| is non-zero, the frame
+  // rate. The driver may adjust both; the accessors below report what it
+  // actually chose.
+  bool SetFormat(uint32_t fourcc, uint32_t width, uint32_t height,
+                 uint32_t fps_numerator = 0, uint32_t fps_denominator = 1);
+  uint32_t fourcc() const { return fourcc_; }
+  uint32_t width() const { return width_; }
+  uint32_t height() const { return height_; }
+  uint32_t bytes_per_line() const { return bytes_per_line_; }
+  uint32_t size_image() const { return size_image_; }
+
+  // Allocates |buffer_count| buffers, queues them all and starts streaming.
+  // kDmabuf falls back to kMmap when there is no DMA heap or the driver
+  // cannot import; io_mode() reports which one is in use.
+  bool StartStreaming(V4l2IoMode mode, unsigned buffer_count = 4);
+  void StopStreaming();
+  bool is_streaming() const { return streaming_; }
+  V4l2IoMode io_mode() const { return io_mode_; }
+
+  // Waits up to |timeout_ms| (-1 = forever) for a filled buffer.
+  WaitResult Dequeue(int timeout_ms, V4l2Buffer *buffer);
+  // Hands a buffer from Dequeue() back to the driver.
+  bool Requeue(const V4l2Buffer &buffer);
+
+  void Interrupt();
+
+  int last_error() const { return last_error_; }
+
+ private:
+  struct Mapping {
+    void *address = nullptr;
+    size_t length = 0;
+    int dmabuf_fd = -1;
+  };
+
+  bool AllocateMmap(unsigned count);
+  bool AllocateDmabuf(unsigned count);
+  void FreeBuffers();
+  bool Fail();
+  int Ioctl(unsigned long request, void *arg) const;
+
+  int fd_ = -1;
+  int wake_fd_ = -1;
+  int last_error_ = 0;
+  uint32_t fourcc_ = 0;
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  uint32_t bytes_per_line_ = 0;
+  uint32_t size_image_ = 0;
+  bool streaming_ = false;
+  V4l2IoMode io_mode_ = V4l2IoMode::kMmap;
+  std::vector<Mapping> buffers_;
+};
+
+// A V4l2Device as the capture loop's FrameSource. Open() negotiates the
+// mode with NegotiatePreviewFormat(): with |raw| a 16-bit mode is preferred
+// and the colour path is the fallback, as on Windows; YUYV only counts as
+// 16-bit with |raw_yuy2|. Frames are delivered
+// without a copy; Release() requeues the buffer.
+class V4l2Source : public FrameSource {
+ public:
+  enum class OpenResult { kOk, kOpenFailed, kUnsupportedFormat, kFormatFailed };
+
+  OpenResult Open(const std::string &path, bool raw, bool raw_yuy2,
+                  uint32_t width, uint32_t height,
+                  const FrameRate &rate = FrameRate());
+
+  SourceMode mode() const override { return mode_; }
+  // Streams into DMABUF buffers when possible, MMAP otherwise.
+  bool Start() override;
+  // Stops streaming and closes the device.
+  void Stop() override;
+  SourceStatus Next(int timeout_ms, SourceFrame *frame) override;
+  void Release(const SourceFrame &frame) override;
+  void Interrupt() override { device_.Interrupt(); }
+
+  const V4l2Device &device() const { return device_; }
+
+ private:
+  V4l2Device device_;
+  SourceMode mode_;
+};
+
+}  // namespace uvc
+
+#endif  // UVC_V4L2_DEVICE_H_
@@ -0,0 +1,215 @@
+#include "virtual_camera.h"
+
+#include <cstdlib>
+#include <sstream>
+
+#include "replay_source.h"
+
+namespace uvc {
+
+const char kVirtualCamerasVariable[] = "UVC_VIRTUAL_CAMERAS";
+
+namespace {
+
+std::vector<std::string> Split(const std::string &text, char separator) {
+  std::vector<std::string> parts;
+  size_t begin = 0;
+  for (;;) {
+    const size_t end = text.find(separator, begin);
+    parts.push_back(text.substr(begin, end - begin));
+    if (end == std::string::npos) return parts;
+    begin = end + 1;
+  }
+}
+
+bool ParseNumber(const std::string &text, uint32_t *value) {
+  if (text.empty() || text.size() > 9) return false;
+  uint32_t result = 0;
+  for (char c : text) {
+    if (c < '0' || c > '9') return false;
+    result = result * 10 + static_cast<uint32_t>(c - '0');
+  }
+  *value = result;
+  return true;
+}
+
+bool ParseSize(const std::string &text, uint32_t *width, uint32_t *height) {
+  const size_t x = text.find('x');
+  return x != std::string::npos && ParseNumber(text.substr(0, x), width) &&
+         ParseNumber(text.substr(x + 1), height) && *width > 0 &&
+         *height > 0;
+}
+
+bool ParseSynthetic(const std::vector<std::string> &fields,
+                    SyntheticConfig *config) {
+  for (size_t i = 0; i < fields.size(); i++) {
+    const std::string &field = fields[i];
+    const size_t equals = field.find('=');
+    if (equals == std::string::npos) {
+      // The size is the only positional field.
+      if (i != 0 || !ParseSize(field, &config->width, &config->height)) {
+        return false;
+      }
+      continue;
+    }
+    const std::string key = field.substr(0, equals);
+    const std::string value = field.substr(equals + 1);
+    uint32_t number = 0;
+    if (key == "format") {
+      if (value == "gray16") {
+        config->format = SourcePixelFormat::kGray16;
+      } else if (value == "bgra") {
+        config->format = SourcePixelFormat::kBgra32;
+      } else if (value == "yuyv") {
+        config->format = SourcePixelFormat::kYuyv;
+      } else if (value == "uyvy") {
+        config->format = SourcePixelFormat::kUyvy;
+      } else if (value == "nv12") {
+        config->format = SourcePixelFormat::kNv12;
+      } else {
+        return false;
+      }
+      continue;
+    }
+    if (!ParseNumber(value, &number)) return false;
+    if (key == "bits" && number >= 8 && number <= 16) {
+      config->bit_depth = static_cast<int>(number);
+    } else if (key == "fps" && number <= SyntheticSource::kMaxFps) {
+      config->fps = number;
+    } else if (key == "noise") {
+      config->noise = number;
+    } else if (key == "spots") {
+      config->hot_spots = static_cast<int>(number);
+    } else if (key == "seed") {
+      config->seed = number;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ParseReplay(const std::vector<std::string> &fields,
+                 VirtualCameraSpec *spec) {
+  if (fields.empty() || fields[0].empty()) return false;
+  spec->path = fields[0];
+  for (size_t i = 1; i < fields.size(); i++) {
+    const size_t equals = fields[i].find('=');
+    if (equals == std::string::npos) return false;
+    const std::string key = fields[i].substr(0, equals);
+    uint32_t number = 0;
+    if (!ParseNumber(fields[i].substr(equals + 1), &number)) return false;
+    if (key == "fps") {
+      spec->fps = number;
+    } else if (key == "loop" && number <= 1) {
+      spec->loop = number == 1;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string GetEnvironment(const char *name) {
+#if defined(_MSC_VER)
+  char *value = nullptr;
+  size_t length = 0;
+  std::string result;
+  if (_dupenv_s(&value, &length, name) == 0 && value != nullptr) {
+    result = value;
+  }
+  std::free(value);
+  return result;
+#else
+  const char *value = std::getenv(name);
+  return value != nullptr ? value : "";
+#endif
+}
+
+}  // namespace
+
+bool ParseVirtualCameraSpec(const std::string &text, VirtualCameraSpec *spec) {
+  // Split at the first ':' only; Windows replay paths contain one too.
+  const size_t colon = text.find(':');
+  const std::string kind = text.substr(0, colon);
+  const std::vector<std::string> fields =
+      colon == std::string::npos ? std::vector<std::string>()
+                                 : Split(text.substr(colon + 1), ',');
+  VirtualCameraSpec parsed;
+  if (kind == "synthetic") {
+    parsed.kind = VirtualCameraSpec::Kind::kSynthetic;
+    if (!ParseSynthetic(fields, &parsed.synthetic)) return false;
+  } else if (kind == "replay") {
+    parsed.kind = VirtualCameraSpec::Kind::kReplay;
+    if (!ParseReplay(fields, &parsed)) return false;
+  } else {
+    return false;
+  }
+  *spec = parsed;
+  return true;
+}
+
+std::vector<VirtualCameraSpec> ParseVirtualCameraList(const std::string &text) {
+  std::vector<VirtualCameraSpec> specs;
+  for (const std::string &entry : Split(text, ';')) {
+    VirtualCameraSpec spec;
+    if (!entry.empty() && ParseVirtualCameraSpec(entry, &spec)) {
+      specs.push_back(spec);
+    }
+  }
+  return specs;
+}
+
+std::vector<VirtualCameraSpec> VirtualCamerasFromEnvironment() {
+  return ParseVirtualCameraList(GetEnvironment(kVirtualCamerasVariable));
+}
+
+std::string VirtualCameraName(const VirtualCameraSpec &spec) {
+  std::ostringstream name;
+  if (spec.kind == VirtualCameraSpec::Kind::kReplay) {
+    const size_t slash = spec.path.find_last_of("/\\");
+    name << "Replay "
+         << (slash == std::string::npos ? spec.path
+                                        : spec.path.substr(slash + 1));
+    return name.str();
+  }
+  const SyntheticConfig &config = spec.synthetic;
+  name << "Synthetic " << config.width << "x" << config.height << " ";
+  switch (config.format) {
+    case SourcePixelFormat::kGray16:
+      name << "Y" << config.bit_depth;
+      break;
+    case SourcePixelFormat::kBgra32:
+      name << "BGRA";
+      break;
+    case SourcePixelFormat::kYuyv:
+      name << "YUYV";
+      break;
+    case SourcePixelFormat::kUyvy:
+      name << "UYVY";
+      break;
+    case SourcePixelFormat::kNv12:
+      name << "NV12";
+      break;
+    case SourcePixelFormat::kMjpeg:
+      name << "MJPEG";
+      break;
+  }
+  if (config.fps != 0) {
+    name << " @ " << config.fps << " fps";
+  } else {
+    name << " unpaced";
+  }
+  return name.str();
+}
+
+std::unique_ptr<FrameSource> CreateVirtualCamera(const VirtualCameraSpec &spec) {
+  if (spec.kind == VirtualCameraSpec::Kind::kSynthetic) {
+    return std::make_unique<SyntheticSource>(spec.synthetic);
+  }
+  auto replay = std::make_unique<ReplaySource>(spec.path, spec.fps, spec.loop);
+  if (!replay->Open()) return nullptr;
+  return replay;
+}
+
+}  // namespace uvc
@@ -0,0 +1,50 @@
+#ifndef UVC_VIRTUAL_CAMERA_H_
+#define UVC_VIRTUAL_CAMERA_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "frame_source.h"
+#include "synthetic_source.h"
+
+namespace uvc {
+
+// Environment variable listing the virtual cameras both runners append to
+// enumerateDevices, separated by ';'. Each entry is one of
+//   synthetic[:WxH][,bits=N][,fps=N][,noise=N][,spots=N][,seed=N]
+//             [,format=gray16|bgra|yuyv|uyvy|nv12]
+//   replay:PATH[,fps=N][,loop=0|1]
+// for example "synthetic:640x512,bits=14,fps=1000;replay:/tmp/a.uvcrec".
+// Replay paths cannot contain ','.
+extern const char kVirtualCamerasVariable[];
+
+struct VirtualCameraSpec {
+  enum class Kind { kSynthetic, kReplay };
+  Kind kind = Kind::kSynthetic;
+  SyntheticConfig synthetic;
+  // kReplay only.
+  std::string path;
+  uint32_t fps = 0;  // 0 keeps the recorded rate.
+  bool loop = true;
+};
+
+// Parses one entry. Returns false on unknown kinds, keys or bad numbers.
+bool ParseVirtualCameraSpec(const std::string &text, VirtualCameraSpec *spec);
+
+// Parses a ';'-separated list, skipping empty and invalid entries.
+std::vector<VirtualCameraSpec> ParseVirtualCameraList(const std::string &text);
+
+// The list from kVirtualCamerasVariable, empty when it is not set.
+std::vector<VirtualCameraSpec> VirtualCamerasFromEnvironment();
+
+// Device name for enumerateDevices, e.g. "Synthetic 640x512 Y14 @ 60 fps".
+std::string VirtualCameraName(const VirtualCameraSpec &spec);
+
+// A new, not yet started source for |spec|, or nullptr if a replay file
+// cannot be opened.
+std::unique_ptr<FrameSource> CreateVirtualCamera(const VirtualCameraSpec &spec);
+
+}  // namespace uvc
+
+#endif  // UVC_VIRTUAL_CAMERA_H_
@@ -0,0 +1,642 @@
+#include "yuv_convert.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(UVC_ARCH_X86)
+#include <immintrin.h>
+#elif defined(UVC_ARCH_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace uvc {
+
+namespace {
+
+// Coefficients are Q13: large enough to stay within one step of the exact
+// result, small enough that BT.709 limited-range blue (2.11) fits the int16
+// operands of pmaddwd / vmlal.
+constexpr int kShift = 13;
+constexpr int kRound = 1 << (kShift - 1);
+
+// R = cy * (Y - y_offset) + crv * (V - 128)
+// G = cy * (Y - y_offset) + cgu * (U - 128) + cgv * (V - 128)
+// B = cy * (Y - y_offset) + cbu * (U - 128)
+// All SIMD kernels evaluate exactly these int32 sums, so they match the
+// scalar one bit for bit.
+struct Coefficients {
+  int y_offset;
+  int cy;
+  int crv;
+  int cgu;
+  int cgv;
+  int cbu;
+};
+
+Coefficients MakeCoefficients(YuvColorSpace color_space) {
+  const bool bt709 = color_space.matrix == YuvMatrix::kBt709;
+  const bool limited = color_space.range == YuvRange::kLimited;
+  const double kr = bt709 ? 0.2126 : 0.299;
+  const double kb = bt709 ? 0.0722 : 0.114;
+  const double kg = 1.0 - kr - kb;
+  const double y_gain = limited ? 255.0 / 219.0 : 1.0;
+  const double c_gain = limited ? 255.0 / 224.0 : 1.0;
+  const auto q = [](double v) {
+    return static_cast<int>(std::lround(v * (1 << kShift)));
+  };
+  Coefficients k;
+  k.y_offset = limited ? 16 : 0;
+  k.cy = q(y_gain);
+  k.crv = q(2.0 * (1.0 - kr) * c_gain);
+  k.cgu = q(-2.0 * kb * (1.0 - kb) / kg * c_gain);
+  k.cgv = q(-2.0 * kr * (1.0 - kr) / kg * c_gain);
+  k.cbu = q(2.0 * (1.0 - kb) * c_gain);
+  return k;
+}
+
+// The four combinations, computed once.
+const Coefficients &CoefficientsFor(YuvColorSpace color_space) {
+  static const Coefficients table[4] = {
+      MakeCoefficients({YuvMatrix::kBt601, YuvRange::kLimited}),
+      MakeCoefficients({YuvMatrix::kBt601, YuvRange::kFull}),
+      MakeCoefficients({YuvMatrix::kBt709, YuvRange::kLimited}),
+      MakeCoefficients({YuvMatrix::kBt709, YuvRange::kFull}),
+  };
+  return table[(color_space.matrix == YuvMatrix::kBt709 ? 2 : 0) +
+               (color_space.range == YuvRange::kFull ? 1 : 0)];
+}
+
+inline uint8_t Clamp8(int v) {
+  return static_cast<uint8_t>(std::min(std::max(v, 0), 255));
+}
+
+// The optional tone curve, applied to R, G and B as each block of pixels is
+// stored: |bytes| for the scalar kernels, the same entries zero-extended in
+// |words| for the AVX2 gathers. Null |bytes| means no curve.
+struct Curve {
+  const uint8_t *bytes = nullptr;
+  uint32_t words[256];
+};
+
+inline void YuvToRgba(int y, int u, int v, const Coefficients &k,
+                      const uint8_t *curve, uint8_t *dst) {
+  const int luma = k.cy * (y - k.y_offset) + kRound;
+  u -= 128;
+  v -= 128;
+  uint8_t r = Clamp8((luma + k.crv * v) >> kShift);
+  uint8_t g = Clamp8((luma + k.cgu * u + k.cgv * v) >> kShift);
+  uint8_t b = Clamp8((luma + k.cbu * u) >> kShift);
+  if (curve) {
+    r = curve[r];
+    g = curve[g];
+    b = curve[b];
+  }
+  dst[0] = r;
+  dst[1] = g;
+  dst[2] = b;
+  dst[3] = 255;
+}
+
+// Maps R, G and B of |pixels| just-stored RGBA pixels through |curve|, for
+// the SIMD kernels without a gather; the block is still in L1.
+inline void CurveBlock(uint8_t *dst, size_t pixels, const uint8_t *curve) {
+  for (size_t i = 0; i < pixels; i++, dst += 4) {
+    dst[0] = curve[dst[0]];
+    dst[1] = curve[dst[1]];
+    dst[2] = curve[dst[2]];
+  }
+}
+
+// Row kernels. Packed rows are 4:2:2 with the first Y, U and V of each
+// 4-byte pair at offsets kY, kU and kV; the second Y is at kY + 2.
+using PackedRowFn = void (*)(const uint8_t *src, uint8_t *dst, size_t width,
+                             const Coefficients &k, const Curve &curve);
+using Nv12RowFn = void (*)(const uint8_t *y, const uint8_t *uv, uint8_t *dst,
+                           size_t width, const Coefficients &k,
+                           const Curve &curve);
+
+template <int kY, int kU, int kV>
+void PackedRowScalar(const uint8_t *src, uint8_t *dst, size_t width,
+                     const Coefficients &coefficients, const Curve &curve) {
+  // Local copies: stores through |dst| could alias the references.
+  const Coefficients k = coefficients;
+  const uint8_t *const c = curve.bytes;
+  size_t x = 0;
+  for (; x + 2 <= width; x += 2, src += 4, dst += 8) {
+    YuvToRgba(src[kY], src[kU], src[kV], k, c, dst);
+    YuvToRgba(src[kY + 2], src[kU], src[kV], k, c, dst + 4);
+  }
+  if (x < width) YuvToRgba(src[kY], src[kU], src[kV], k, c, dst);
+}
+
+void Nv12RowScalar(const uint8_t *y, const uint8_t *uv, uint8_t *dst,
+                   size_t width, const Coefficients &coefficients,
+                   const Curve &curve) {
+  const Coefficients k = coefficients;
+  const uint8_t *const c = curve.bytes;
+  size_t x = 0;
+  for (; x + 2 <= width; x += 2) {
+    YuvToRgba(y[x], uv[x], uv[x + 1], k, c, dst + x * 4);
+    YuvToRgba(y[x + 1], uv[x], uv[x + 1], k, c, dst + x * 4 + 4);
+  }
+  if (x < width) YuvToRgba(y[x], uv[x], uv[x + 1], k, c, dst + x * 4);
+}
+
+#if defined(UVC_ARCH_X86)
+// Two int16 lanes of one int32, as pmaddwd pairs them.
+inline int PairWord(int lo, int hi) {
+  return static_cast<int>(static_cast<uint32_t>(static_cast<uint16_t>(lo)) |
+                          static_cast<uint32_t>(static_cast<uint16_t>(hi))
+                              << 16);
+}
+
+struct Ssse3Constants {
+  __m128i y_offset, c_offset, one, round, alpha;
+  __m128i yv_r, yu_g, v1_g, yu_b;
+};
+
+UVC_TARGET_SSSE3 inline Ssse3Constants MakeSsse3Constants(
+    const Coefficients &k) {
+  Ssse3Constants c;
+  c.y_offset = _mm_set1_epi16(static_cast<short>(k.y_offset));
+  c.c_offset = _mm_set1_epi16(128);
+  c.one = _mm_set1_epi16(1);
+  c.round = _mm_set1_epi32(kRound);
+  c.alpha = _mm_set1_epi8(-1);
+  c.yv_r = _mm_set1_epi32(PairWord(k.cy, k.crv));
+  c.yu_g = _mm_set1_epi32(PairWord(k.cy, k.cgu));
+  c.v1_g = _mm_set1_epi32(PairWord(k.cgv, kRound));
+  c.yu_b = _mm_set1_epi32(PairWord(k.cy, k.cbu));
+  return c;
+}
+
+// Converts 8 pixels given as zero-extended 16-bit Y, U and V.
+UVC_TARGET_SSSE3 inline void YuvToRgba8Ssse3(__m128i y, __m128i u, __m128i v,
+                                             const Ssse3Constants &c,
+                                             const uint8_t *curve,
+                                             uint8_t *dst) {
+  y = _mm_sub_epi16(y, c.y_offset);
+  u = _mm_sub_epi16(u, c.c_offset);
+  v = _mm_sub_epi16(v, c.c_offset);
+  const __m128i yu_lo = _mm_unpacklo_epi16(y, u);
+  const __m128i yu_hi = _mm_unpackhi_epi16(y, u);
+  const __m128i yv_lo = _mm_unpacklo_epi16(y, v);
+  const __m128i yv_hi = _mm_unpackhi_epi16(y, v);
+  const __m128i v1_lo = _mm_unpacklo_epi16(v, c.one);
+  const __m128i v1_hi = _mm_unpackhi_epi16(v, c.one);
+  __m128i r = _mm_packs_epi32(
+      _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yv_lo, c.yv_r), c.round),
+                     kShift),
+      _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yv_hi, c.yv_r), c.round),
+                     kShift));
+  __m128i g = _mm_packs_epi32(
+      _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yu_lo, c.yu_g),
+                                   _mm_madd_epi16(v1_lo, c.v1_g)),
+                     kShift),
+      _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yu_hi, c.yu_g),
+                                   _mm_madd_epi16(v1_hi, c.v1_g)),
+                     kShift));
+  __m128i b = _mm_packs_epi32(
+      _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yu_lo, c.yu_b), c.round),
+                     kShift),
+      _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yu_hi, c.yu_b), c.round),
+                     kShift));
+  r = _mm_packus_epi16(r, r);
+  g = _mm_packus_epi16(g, g);
+  b = _mm_packus_epi16(b, b);
+  const __m128i rg = _mm_unpacklo_epi8(r, g);
+  const __m128i ba = _mm_unpacklo_epi8(b, c.alpha);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(dst),
+                   _mm_unpacklo_epi16(rg, ba));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 16),
+                   _mm_unpackhi_epi16(rg, ba));
+  if (curve) CurveBlock(dst, 8, curve);
+}
+
+template <int kY, int kU, int kV>
+UVC_TARGET_SSSE3 void PackedRowSsse3(const uint8_t *src, uint8_t *dst,
+                                     size_t width, const Coefficients &k,
+                                     const Curve &curve) {
+  const Ssse3Constants c = MakeSsse3Constants(k);
+  // pshufb writes zero for -1, which zero-extends each picked byte.
+  const __m128i y_mask =
+      _mm_setr_epi8(kY, -1, kY + 2, -1, kY + 4, -1, kY + 6, -1, kY + 8, -1,
+                    kY + 10, -1, kY + 12, -1, kY + 14, -1);
+  const __m128i u_mask =
+      _mm_setr_epi8(kU, -1, kU, -1, kU + 4, -1, kU + 4, -1, kU + 8, -1,
+                    kU + 8, -1, kU + 12, -1, kU + 12, -1);
+  const __m128i v_mask =
+      _mm_setr_epi8(kV, -1, kV, -1, kV + 4, -1, kV + 4, -1, kV + 8, -1,
+                    kV + 8, -1, kV + 12, -1, kV + 12, -1);
+  size_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const __m128i px =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 2));
+    YuvToRgba8Ssse3(_mm_shuffle_epi8(px, y_mask), _mm_shuffle_epi8(px, u_mask),
+                    _mm_shuffle_epi8(px, v_mask), c, curve.bytes,
+                    dst + x * 4);
+  }
+  PackedRowScalar<kY, kU, kV>(src + x * 2, dst + x * 4, width - x, k, curve);
+}
+
+UVC_TARGET_SSSE3 void Nv12RowSsse3(const uint8_t *y, const uint8_t *uv,
+                                   uint8_t *dst, size_t width,
+                                   const Coefficients &k, const Curve &curve) {
+  const Ssse3Constants c = MakeSsse3Constants(k);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i u_lo = _mm_setr_epi8(0, -1, 0, -1, 2, -1, 2, -1, 4, -1, 4, -1,
+                                     6, -1, 6, -1);
+  const __m128i v_lo = _mm_setr_epi8(1, -1, 1, -1, 3, -1, 3, -1, 5, -1, 5, -1,
+                                     7, -1, 7, -1);
+  const __m128i u_hi = _mm_setr_epi8(8, -1, 8, -1, 10, -1, 10, -1, 12, -1, 12,
+                                     -1, 14, -1, 14, -1);
+  const __m128i v_hi = _mm_setr_epi8(9, -1, 9, -1, 11, -1, 11, -1, 13, -1, 13,
+                                     -1, 15, -1, 15, -1);
+  size_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const __m128i luma =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(y + x));
+    const __m128i chroma =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(uv + x));
+    YuvToRgba8Ssse3(_mm_unpacklo_epi8(luma, zero),
+                    _mm_shuffle_epi8(chroma, u_lo),
+                    _mm_shuffle_epi8(chroma, v_lo), c, curve.bytes,
+                    dst + x * 4);
+    YuvToRgba8Ssse3(_mm_unpackhi_epi8(luma, zero),
+                    _mm_shuffle_epi8(chroma, u_hi),
+                    _mm_shuffle_epi8(chroma, v_hi), c, curve.bytes,
+                    dst + x * 4 + 32);
+  }
+  Nv12RowScalar(y + x, uv + x, dst + x * 4, width - x, k, curve);
+}
+
+struct Avx2Constants {
+  __m256i y_offset, c_offset, one, round, alpha;
+  __m256i yv_r, yu_g, v1_g, yu_b;
+  __m256i low_byte, alpha_word;
+};
+
+UVC_TARGET_AVX2 inline Avx2Constants MakeAvx2Constants(const Coefficients &k) {
+  Avx2Constants c;
+  c.y_offset = _mm256_set1_epi16(static_cast<short>(k.y_offset));
+  c.c_offset = _mm256_set1_epi16(128);
+  c.one = _mm256_set1_epi16(1);
+  c.round = _mm256_set1_epi32(kRound);
+  c.alpha = _mm256_set1_epi8(-1);
+  c.yv_r = _mm256_set1_epi32(PairWord(k.cy, k.crv));
+  c.yu_g = _mm256_set1_epi32(PairWord(k.cy, k.cgu));
+  c.v1_g = _mm256_set1_epi32(PairWord(k.cgv, kRound));
+  c.yu_b = _mm256_set1_epi32(PairWord(k.cy, k.cbu));
+  c.low_byte = _mm256_set1_epi32(0xff);
+  c.alpha_word = _mm256_set1_epi32(static_cast<int>(0xff000000u));
+  return c;
+}
+
+// Maps R, G and B of 8 opaque RGBA pixels through the zero-extended curve
+// |words|: one gather per channel.
+UVC_TARGET_AVX2 inline __m256i CurveRgba8Avx2(__m256i px,
+                                              const uint32_t *words,
+                                              const Avx2Constants &c) {
+  const int *table = reinterpret_cast<const int *>(words);
+  const __m256i r = _mm256_i32gather_epi32(
+      table, _mm256_and_si256(px, c.low_byte), 4);
+  const __m256i g = _mm256_i32gather_epi32(
+      table, _mm256_and_si256(_mm256_srli_epi32(px, 8), c.low_byte), 4);
+  const __m256i b = _mm256_i32gather_epi32(
+      table, _mm256_and_si256(_mm256_srli_epi32(px, 16), c.low_byte), 4);
+  return _mm256_or_si256(
+      _mm256_or_si256(r, _mm256_slli_epi32(g, 8)),
+      _mm256_or_si256(_mm256_slli_epi32(b, 16), c.alpha_word));
+}
+
+// Converts 16 pixels: pixels 0-7 in the low lane of each input, 8-15 in the
+// high lane. Every step but the last works within lanes.
+UVC_TARGET_AVX2 inline void YuvToRgba16Avx2(__m256i y, __m256i u, __m256i v,
+                                            const Avx2Constants &c,
+                                            const uint32_t *curve,
+                                            uint8_t *dst) {
+  y = _mm256_sub_epi16(y, c.y_offset);
+  u = _mm256_sub_epi16(u, c.c_offset);
+  v = _mm256_sub_epi16(v, c.c_offset);
+  const __m256i yu_lo = _mm256_unpacklo_epi16(y, u);
+  const __m256i yu_hi = _mm256_unpackhi_epi16(y, u);
+  const __m256i yv_lo = _mm256_unpacklo_epi16(y, v);
+  const __m256i yv_hi = _mm256_unpackhi_epi16(y, v);
+  const __m256i v1_lo = _mm256_unpacklo_epi16(v, c.one);
+  const __m256i v1_hi = _mm256_unpackhi_epi16(v, c.one);
+  __m256i r = _mm256_packs_epi32(
+      _mm256_srai_epi32(
+          _mm256_add_epi32(_mm256_madd_epi16(yv_lo, c.yv_r), c.round), kShift),
+      _mm256_srai_epi32(
+          _mm256_add_epi32(_mm256_madd_epi16(yv_hi, c.yv_r), c.round),
+          kShift));
+  __m256i g = _mm256_packs_epi32(
+      _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(yu_lo, c.yu_g),
+                                         _mm256_madd_epi16(v1_lo, c.v1_g)),
+                        kShift),
+      _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(yu_hi, c.yu_g),
+                                         _mm256_madd_epi16(v1_hi, c.v1_g)),
+                        kShift));
+  __m256i b = _mm256_packs_epi32(
+      _mm256_srai_epi32(
+          _mm256_add_epi32(_mm256_madd_epi16(yu_lo, c.yu_b), c.round), kShift),
+      _mm256_srai_epi32(
+          _mm256_add_epi32(_mm256_madd_epi16(yu_hi, c.yu_b), c.round),
+          kShift));
+  r = _mm256_packus_epi16(r, r);
+  g = _mm256_packus_epi16(g, g);
+  b = _mm256_packus_epi16(b, b);
+  const __m256i rg = _mm256_unpacklo_epi8(r, g);
+  const __m256i ba = _mm256_unpacklo_epi8(b, c.alpha);
+  // Pixels 0-3 | 8-11 and 4-7 | 12-15.
+  const __m256i lo = _mm256_unpacklo_epi16(rg, ba);
+  const __m256i hi = _mm256_unpackhi_epi16(rg, ba);
+  __m256i first = _mm256_permute2x128_si256(lo, hi, 0x20);
+  __m256i second = _mm256_permute2x128_si256(lo, hi, 0x31);
+  if (curve) {
+    first = CurveRgba8Avx2(first, curve, c);
+    second = CurveRgba8Avx2(second, curve, c);
+  }
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), first);
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 32), second);
+}
+
+template <int kY, int kU, int kV>
+UVC_TARGET_AVX2 void PackedRowAvx2(const uint8_t *src, uint8_t *dst,
+                                   size_t width, const Coefficients &k,
+                                   const Curve &curve) {
+  const Avx2Constants c = MakeAvx2Constants(k);
+  const uint32_t *words = curve.bytes ? curve.words : nullptr;
+  // vpshufb shuffles within each 128-bit lane, so the masks repeat.
+  const __m256i y_mask = _mm256_setr_epi8(
+      kY, -1, kY + 2, -1, kY + 4, -1, kY + 6, -1, kY + 8, -1, kY + 10, -1,
+      kY + 12, -1, kY + 14, -1, kY, -1, kY + 2, -1, kY + 4, -1, kY + 6, -1,
+      kY + 8, -1, kY + 10, -1, kY + 12, -1, kY + 14, -1);
+  const __m256i u_mask = _mm256_setr_epi8(
+      kU, -1, kU, -1, kU + 4, -1, kU + 4, -1, kU + 8, -1, kU + 8, -1, kU + 12,
+      -1, kU + 12, -1, kU, -1, kU, -1, kU + 4, -1, kU + 4, -1, kU + 8, -1,
+      kU + 8, -1, kU + 12, -1, kU + 12, -1);
+  const __m256i v_mask = _mm256_setr_epi8(
+      kV, -1, kV, -1, kV + 4, -1, kV + 4, -1, kV + 8, -1, kV + 8, -1, kV + 12,
+      -1, kV + 12, -1, kV, -1, kV, -1, kV + 4, -1, kV + 4, -1, kV + 8, -1,
+      kV + 8, -1, kV + 12, -1, kV + 12, -1);
+  size_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const __m256i px =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x * 2));
+    YuvToRgba16Avx2(_mm256_shuffle_epi8(px, y_mask),
+                    _mm256_shuffle_epi8(px, u_mask),
+                    _mm256_shuffle_epi8(px, v_mask), c, words, dst + x * 4);
+  }
+  PackedRowScalar<kY, kU, kV>(src + x * 2, dst + x * 4, width - x, k, curve);
+}
+
+UVC_TARGET_AVX2 void Nv12RowAvx2(const uint8_t *y, const uint8_t *uv,
+                                 uint8_t *dst, size_t width,
+                                 const Coefficients &k, const Curve &curve) {
+  const Avx2Constants c = MakeAvx2Constants(k);
+  const uint32_t *words = curve.bytes ? curve.words : nullptr;
+  // The 8 UV pairs of 16 pixels sit in both lanes; the low lane expands
+  // pairs 0-3, the high lane pairs 4-7.
+  const __m256i u_mask = _mm256_setr_epi8(
+      0, -1, 0, -1, 2, -1, 2, -1, 4, -1, 4, -1, 6, -1, 6, -1, 8, -1, 8, -1, 10,
+      -1, 10, -1, 12, -1, 12, -1, 14, -1, 14, -1);
+  const __m256i v_mask = _mm256_setr_epi8(
+      1, -1, 1, -1, 3, -1, 3, -1, 5, -1, 5, -1, 7, -1, 7, -1, 9, -1, 9, -1, 11,
+      -1, 11, -1, 13, -1, 13, -1, 15, -1, 15, -1);
+  size_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const __m256i luma = _mm256_cvtepu8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(y + x)));
+    const __m256i chroma = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(uv + x)));
+    YuvToRgba16Avx2(luma, _mm256_shuffle_epi8(chroma, u_mask),
+                    _mm256_shuffle_epi8(chroma, v_mask), c, words,
+                    dst + x * 4);
+  }
+  Nv12RowScalar(y + x, uv + x, dst + x * 4, width - x, k, curve);
+}
+#endif  // UVC_ARCH_X86
+
+#if defined(UVC_ARCH_NEON)
+// Converts 8 pixels of luma sharing |u| and |v| (already minus 128).
+inline void YuvToRgb8Neon(uint8x8_t y, int16x8_t u, int16x8_t v,
+                          const Coefficients &k, uint8x8_t *r, uint8x8_t *g,
+                          uint8x8_t *b) {
+  const int16x8_t luma = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(y)),
+                                   vdupq_n_s16(static_cast<int16_t>(k.y_offset)));
+  const int32x4_t round = vdupq_n_s32(kRound);
+  const int32x4_t l_lo =
+      vmlal_n_s16(round, vget_low_s16(luma), static_cast<int16_t>(k.cy));
+  const int32x4_t l_hi =
+      vmlal_n_s16(round, vget_high_s16(luma), static_cast<int16_t>(k.cy));
+  const int16_t crv = static_cast<int16_t>(k.crv);
+  const int16_t cgu = static_cast<int16_t>(k.cgu);
+  const int16_t cgv = static_cast<int16_t>(k.cgv);
+  const int16_t cbu = static_cast<int16_t>(k.cbu);
+  const int32x4_t r_lo = vmlal_n_s16(l_lo, vget_low_s16(v), crv);
+  const int32x4_t r_hi = vmlal_n_s16(l_hi, vget_high_s16(v), crv);
+  const int32x4_t g_lo = vmlal_n_s16(vmlal_n_s16(l_lo, vget_low_s16(u), cgu),
+                                     vget_low_s16(v), cgv);
+  const int32x4_t g_hi = vmlal_n_s16(vmlal_n_s16(l_hi, vget_high_s16(u), cgu),
+                                     vget_high_s16(v), cgv);
+  const int32x4_t b_lo = vmlal_n_s16(l_lo, vget_low_s16(u), cbu);
+  const int32x4_t b_hi = vmlal_n_s16(l_hi, vget_high_s16(u), cbu);
+  *r = vqmovun_s16(
+      vcombine_s16(vqshrn_n_s32(r_lo, kShift), vqshrn_n_s32(r_hi, kShift)));
+  *g = vqmovun_s16(
+      vcombine_s16(vqshrn_n_s32(g_lo, kShift), vqshrn_n_s32(g_hi, kShift)));
+  *b = vqmovun_s16(
+      vcombine_s16(vqshrn_n_s32(b_lo, kShift), vqshrn_n_s32(b_hi, kShift)));
+}
+
+// Converts 16 pixels given as their 8 even and 8 odd lumas and the 8 chroma
+// pairs they share.
+inline void YuvPairsToRgba16Neon(uint8x8_t y_even, uint8x8_t y_odd,
+                                 uint8x8_t u8, uint8x8_t v8,
+                                 const Coefficients &k, const uint8_t *curve,
+                                 uint8_t *dst) {
+  const int16x8_t offset = vdupq_n_s16(128);
+  const int16x8_t u = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(u8)), offset);
+  const int16x8_t v = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v8)), offset);
+  uint8x8_t r_even, g_even, b_even, r_odd, g_odd, b_odd;
+  YuvToRgb8Neon(y_even, u, v, k, &r_even, &g_even, &b_even);
+  YuvToRgb8Neon(y_odd, u, v, k, &r_odd, &g_odd, &b_odd);
+  const uint8x8x2_t r = vzip_u8(r_even, r_odd);
+  const uint8x8x2_t g = vzip_u8(g_even, g_odd);
+  const uint8x8x2_t b = vzip_u8(b_even, b_odd);
+  const uint8x8_t alpha = vdup_n_u8(255);
+  uint8x8x4_t out;
+  out.val[0] = r.val[0];
+  out.val[1] = g.val[0];
+  out.val[2] = b.val[0];
+  out.val[3] = alpha;
+  vst4_u8(dst, out);
+  out.val[0] = r.val[1];
+  out.val[1] = g.val[1];
+  out.val[2] = b.val[1];
+  vst4_u8(dst + 32, out);
+  if (curve) CurveBlock(dst, 16, curve);
+}
+
+template <int kY, int kU, int kV>
+void PackedRowNeon(const uint8_t *src, uint8_t *dst, size_t width,
+                   const Coefficients &k, const Curve &curve) {
+  size_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    // Byte i of every 4-byte pair lands in val[i].
+    const uint8x8x4_t px = vld4_u8(src + x * 2);
+    YuvPairsToRgba16Neon(px.val[kY], px.val[kY + 2], px.val[kU], px.val[kV],
+                         k, curve.bytes, dst + x * 4);
+  }
+  PackedRowScalar<kY, kU, kV>(src + x * 2, dst + x * 4, width - x, k, curve);
+}
+
+void Nv12RowNeon(const uint8_t *y, const uint8_t *uv, uint8_t *dst,
+                 size_t width, const Coefficients &k, const Curve &curve) {
+  size_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const uint8x8x2_t luma = vld2_u8(y + x);
+    const uint8x8x2_t chroma = vld2_u8(uv + x);
+    YuvPairsToRgba16Neon(luma.val[0], luma.val[1], chroma.val[0],
+                         chroma.val[1], k, curve.bytes, dst + x * 4);
+  }
+  Nv12RowScalar(y + x, uv + x, dst + x * 4, width - x, k, curve);
+}
+#endif  // UVC_ARCH_NEON
+
+template <int kY, int kU, int kV>
+PackedRowFn SelectPackedRowFn(SimdLevel level) {
+  switch (level) {
+#if defined(UVC_ARCH_X86)
+    case SimdLevel::kAvx2:
+      return PackedRowAvx2<kY, kU, kV>;
+    case SimdLevel::kSsse3:
+      return PackedRowSsse3<kY, kU, kV>;
+#endif
+#if defined(UVC_ARCH_NEON)
+    case SimdLevel::kNeon:
+      return PackedRowNeon<kY, kU, kV>;
+#endif
+    default:
+      return PackedRowScalar<kY, kU, kV>;
+  }
+}
+
+Nv12RowFn SelectNv12RowFn(SimdLevel level) {
+  switch (level) {
+#if defined(UVC_ARCH_X86)
+    case SimdLevel::kAvx2:
+      return Nv12RowAvx2;
+    case SimdLevel::kSsse3:
+      return Nv12RowSsse3;
+#endif
+#if defined(UVC_ARCH_NEON)
+    case SimdLevel::kNeon:
+      return Nv12RowNeon;
+#endif
+    default:
+      return Nv12RowScalar;
+  }
+}
+
+void MakeCurve(const uint8_t *bytes, Curve *curve) {
+  curve->bytes = bytes;
+  if (!bytes) return;
+  for (int i = 0; i < 256; i++) curve->words[i] = bytes[i];
+}
+
+void ConvertPackedRows(PackedRowFn row, const uint8_t *src,
+                       ptrdiff_t src_stride, uint8_t *dst,
+                       ptrdiff_t dst_stride, size_t width, size_t height,
+                       YuvColorSpace color_space, const uint8_t *curve_bytes) {
+  const Coefficients &k = CoefficientsFor(color_space);
+  Curve curve;
+  MakeCurve(curve_bytes, &curve);
+  if (width % 2 == 0 && src_stride == static_cast<ptrdiff_t>(width * 2) &&
+      dst_stride == static_cast<ptrdiff_t>(width * 4)) {
+    // Both images are contiguous and no pair straddles two rows.
+    row(src, dst, width * height, k, curve);
+    return;
+  }
+  for (size_t y = 0; y < height; y++) {
+    row(src, dst, width, k, curve);
+    src += src_stride;
+    dst += dst_stride;
+  }
+}
+
+void ConvertNv12Rows(Nv12RowFn row, const uint8_t *y, ptrdiff_t y_stride,
+                     const uint8_t *uv, ptrdiff_t uv_stride, uint8_t *dst,
+                     ptrdiff_t dst_stride, size_t width, size_t height,
+                     YuvColorSpace color_space, const uint8_t *curve_bytes) {
+  const Coefficients &k = CoefficientsFor(color_space);
+  Curve curve;
+  MakeCurve(curve_bytes, &curve);
+  for (size_t r = 0; r < height; r++) {
+    row(y, uv + static_cast<ptrdiff_t>(r / 2) * uv_stride, dst, width, k,
+        curve);
+    y += y_stride;
+    dst += dst_stride;
+  }
+}
+
+// Byte offsets of Y0, U and V within a 4-byte pair.
+constexpr int kYuyvY = 0, kYuyvU = 1, kYuyvV = 3;
+constexpr int kUyvyY = 1, kUyvyU = 0, kUyvyV = 2;
+
+}  // namespace
+
+void ConvertYuyvToRgba(const uint8_t *src, ptrdiff_t src_stride, uint8_t *dst,
+                       ptrdiff_t dst_stride, size_t width, size_t height,
+                       YuvColorSpace color_space, const uint8_t *curve) {
+  ConvertYuyvToRgbaWithLevel(GetSimdLevel(), src, src_stride, dst, dst_stride,
+                             width, height, color_space, curve);
+}
+
+void ConvertYuyvToRgbaWithLevel(SimdLevel level, const uint8_t *src,
+                                ptrdiff_t src_stride, uint8_t *dst,
+                                ptrdiff_t dst_stride, size_t width,
+                                size_t height, YuvColorSpace color_space,
+                                const uint8_t *curve) {
+  ConvertPackedRows(SelectPackedRowFn<kYuyvY, kYuyvU, kYuyvV>(level), src,
+                    src_stride, dst, dst_stride, width, height, color_space,
+                    curve);
+}
+
+void ConvertUyvyToRgba(const uint8_t *src, ptrdiff_t src_stride, uint8_t *dst,
+                       ptrdiff_t dst_stride, size_t width, size_t height,
+                       YuvColorSpace color_space, const uint8_t *curve) {
+  ConvertUyvyToRgbaWithLevel(GetSimdLevel(), src, src_stride, dst, dst_stride,
+                             width, height, color_space, curve);
+}
+
+void ConvertUyvyToRgbaWithLevel(SimdLevel level, const uint8_t *src,
+                                ptrdiff_t src_stride, uint8_t *dst,
+                                ptrdiff_t dst_stride, size_t width,
+                                size_t height, YuvColorSpace color_space,
+                                const uint8_t *curve) {
+  ConvertPackedRows(SelectPackedRowFn<kUyvyY, kUyvyU, kUyvyV>(level), src,
+                    src_stride, dst, dst_stride, width, height, color_space,
+                    curve);
+}
+
+void ConvertNv12ToRgba(const uint8_t *y, ptrdiff_t y_stride, const uint8_t *uv,
+                       ptrdiff_t uv_stride, uint8_t *dst, ptrdiff_t dst_stride,
+                       size_t width, size_t height,
+                       YuvColorSpace color_space, const uint8_t *curve) {
+  ConvertNv12ToRgbaWithLevel(GetSimdLevel(), y, y_stride, uv, uv_stride, dst,
+                             dst_stride, width, height, color_space, curve);
+}
+
+void ConvertNv12ToRgbaWithLevel(SimdLevel level, const uint8_t *y,
+                                ptrdiff_t y_stride, const uint8_t *uv,
+                                ptrdiff_t uv_stride, uint8_t *dst,
+                                ptrdiff_t dst_stride, size_t width,
+                                size_t height, YuvColorSpace color_space,
+                                const uint8_t *curve) {
+  ConvertNv12Rows(SelectNv12RowFn(level), y, y_stride, uv, uv_stride, dst,
+                  dst_stride, width, height, color_space, curve);
+}
+
+}  // namespace uvc
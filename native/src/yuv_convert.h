@@ -0,0 +1,83 @@
+#ifndef UVC_YUV_CONVERT_H_
+#define UVC_YUV_CONVERT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "cpu_features.h"
+
+namespace uvc {
+
+// YCbCr to RGB matrix.
+enum class YuvMatrix {
+  kBt601,  // SD; the default of UVC webcams.
+  kBt709,  // HD.
+};
+
+enum class YuvRange {
+  kLimited,  // Y in 16..235, Cb/Cr in 16..240 ("video" or "TV" range).
+  kFull,     // All of 0..255 ("PC" range, JPEG).
+};
+
+struct YuvColorSpace {
+  YuvMatrix matrix = YuvMatrix::kBt601;
+  YuvRange range = YuvRange::kLimited;
+};
+
+// The YUV to RGBA converters below write opaque RGBA straight into |dst|.
+// They compute in 13-bit fixed point, within one step of the exact
+// conversion, and every SIMD kernel produces the same bytes as the scalar
+// one. |*_stride| are signed byte offsets between rows, as in
+// ConvertBgraToRgba(); source and destination must not overlap.
+//
+// A non-null |curve| (256 entries, ToneCurve::curve()) maps R, G and B as
+// each block of pixels is stored, so a toned frame costs no second pass.
+//
+// Each dispatches to the best kernel for GetSimdLevel(); the WithLevel
+// variants force a specific one, for tests and benchmarks, as in
+// pixel_convert.h.
+
+// Packed 4:2:2 Y0 U Y1 V (V4L2 'YUYV', Media Foundation YUY2). For an odd
+// |width| the last pixel uses the chroma of its incomplete pair.
+void ConvertYuyvToRgba(const uint8_t *src, ptrdiff_t src_stride, uint8_t *dst,
+                       ptrdiff_t dst_stride, size_t width, size_t height,
+                       YuvColorSpace color_space = YuvColorSpace(),
+                       const uint8_t *curve = nullptr);
+void ConvertYuyvToRgbaWithLevel(SimdLevel level, const uint8_t *src,
+                                ptrdiff_t src_stride, uint8_t *dst,
+                                ptrdiff_t dst_stride, size_t width,
+                                size_t height,
+                                YuvColorSpace color_space = YuvColorSpace(),
+                       const uint8_t *curve = nullptr);
+
+// Packed 4:2:2 U Y0 V Y1 (UYVY), otherwise as ConvertYuyvToRgba().
+void ConvertUyvyToRgba(const uint8_t *src, ptrdiff_t src_stride, uint8_t *dst,
+                       ptrdiff_t dst_stride, size_t width, size_t height,
+                       YuvColorSpace color_space = YuvColorSpace(),
+                       const uint8_t *curve = nullptr);
+void ConvertUyvyToRgbaWithLevel(SimdLevel level, const uint8_t *src,
+                                ptrdiff_t src_stride, uint8_t *dst,
+                                ptrdiff_t dst_stride, size_t width,
+                                size_t height,
+                                YuvColorSpace color_space = YuvColorSpace(),
+                       const uint8_t *curve = nullptr);
+
+// 4:2:0 NV12: a plane of Y, then a half-height plane of interleaved U V
+// pairs, one per 2x2 block. In a single Media Foundation buffer the UV plane
+// starts |height| rows after |y| with the same stride.
+void ConvertNv12ToRgba(const uint8_t *y, ptrdiff_t y_stride, const uint8_t *uv,
+                       ptrdiff_t uv_stride, uint8_t *dst, ptrdiff_t dst_stride,
+                       size_t width, size_t height,
+                       YuvColorSpace color_space = YuvColorSpace(),
+                       const uint8_t *curve = nullptr);
+void ConvertNv12ToRgbaWithLevel(SimdLevel level, const uint8_t *y,
+                                ptrdiff_t y_stride, const uint8_t *uv,
+                                ptrdiff_t uv_stride, uint8_t *dst,
+                                ptrdiff_t dst_stride, size_t width,
+                                size_t height,
+                                YuvColorSpace color_space = YuvColorSpace(),
+                       const uint8_t *curve = nullptr);
+
+}  // namespace uvc
+
+#endif  // UVC_YUV_CONVERT_H_
@@ -0,0 +1,202 @@
+#include "agc.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "thermal_palette.h"
+
+namespace uvc {
+namespace {
+
+constexpr size_t kWidth = 64;
+constexpr size_t kHeight = 48;
+
+uint8_t RedAt(const std::vector<uint8_t> &rgba, size_t pixel) {
+  return rgba[pixel * 4];
+}
+
+AgcConfig ConfigFor(AgcMode mode, float smoothing = 1.0f) {
+  AgcConfig config;
+  config.mode = mode;
+  config.smoothing = smoothing;
+  return config;
+}
+
+TEST(AgcTest, ModeNamesRoundTrip) {
+  for (AgcMode mode :
+       {AgcMode::kLinear, AgcMode::kPercentile, AgcMode::kPlateau}) {
+    AgcMode parsed = AgcMode::kLinear;
+    ASSERT_TRUE(ParseAgcMode(AgcModeName(mode), &parsed));
+    EXPECT_EQ(parsed, mode);
+  }
+  AgcMode untouched = AgcMode::kPercentile;
+  EXPECT_FALSE(ParseAgcMode("gamma", &untouched));
+  EXPECT_EQ(untouched, AgcMode::kPercentile);
+}
+
+TEST(AgcTest, HistogramIsGatheredWhileRendering) {
+  std::mt19937 rng(7);
+  std::vector<uint16_t> src(kWidth * kHeight);
+  for (auto &v : src) v = static_cast<uint16_t>(rng());
+  std::vector<uint32_t> expected(AutoGain::kBins, 0);
+  for (uint16_t v : src) expected[v >> AutoGain::kBinShift]++;
+
+  AutoGain agc;
+  std::vector<uint8_t> dst(kWidth * kHeight * 4);
+  agc.Process(src.data(), kWidth, kWidth, kHeight,
+              GetPaletteTable(ThermalPalette::kWhiteHot), dst.data(),
+              kWidth * 4);
+  EXPECT_EQ(std::memcmp(agc.histogram(), expected.data(),
+                        AutoGain::kBins * sizeof(uint32_t)),
+            0);
+}
+
+TEST(AgcTest, LinearStretchesSceneRangeOntoPalette) {
+  std::vector<uint16_t> src(kWidth * kHeight);
+  for (size_t i = 0; i < src.size(); i++) {
+    src[i] = static_cast<uint16_t>(8000 + (i % 400) * 4);
+  }
+  AutoGain agc;
+  agc.SetConfig(ConfigFor(AgcMode::kLinear));
+  std::vector<uint8_t> dst(src.size() * 4);
+  agc.Process(src.data(), kWidth, kWidth, kHeight,
+              GetPaletteTable(ThermalPalette::kWhiteHot), dst.data(),
+              kWidth * 4);
+
+  EXPECT_EQ(agc.stats().scene_min, 8000);
+  EXPECT_EQ(agc.stats().scene_max, 8000 + 399 * 4 + 3);
+  EXPECT_EQ(RedAt(dst, 0), 0);      // Coldest pixel.
+  EXPECT_EQ(RedAt(dst, 399), 255);  // Hottest pixel.
+  const int mid = RedAt(dst, 200);
+  EXPECT_NEAR(mid, 128, 2);
+}
+
+TEST(AgcTest, PercentileIgnoresASingleHotPixel) {
+  std::vector<uint16_t> src(kWidth * kHeight);
+  for (size_t i = 0; i < src.size(); i++) {
+    src[i] = static_cast<uint16_t>(8000 + (i % 400) * 4);
+  }
+  src[17] = 60000;  // A soldering iron in the corner of the scene.
+  std::vector<uint8_t> linear(src.size() * 4), percentile(src.size() * 4);
+
+  AutoGain linear_agc;
+  linear_agc.SetConfig(ConfigFor(AgcMode::kLinear));
+  linear_agc.Process(src.data(), kWidth, kWidth, kHeight,
+                     GetPaletteTable(ThermalPalette::kWhiteHot), linear.data(),
+                     kWidth * 4);
+  AutoGain percentile_agc;
+  percentile_agc.SetConfig(ConfigFor(AgcMode::kPercentile));
+  percentile_agc.Process(src.data(), kWidth, kWidth, kHeight,
+                         GetPaletteTable(ThermalPalette::kWhiteHot),
+                         percentile.data(), kWidth * 4);
+
+  // Linear spends the palette on the outlier and crushes the scene...
+  EXPECT_LT(RedAt(linear, 399), 20);
+  // ...percentile keeps the scene spread out and saturates the outlier.
+  EXPECT_GT(RedAt(percentile, 399), 240);
+  EXPECT_EQ(RedAt(percentile, 17), 255);
+}
+
+TEST(AgcTest, PlateauGivesSmallHotObjectMorePaletteThanLinear) {
+  // 95% cold background around 8000, 5% hot object spread over 12000..12400,
+  // nothing in between.
+  std::mt19937 rng(3);
+  std::vector<uint16_t> src(kWidth * kHeight);
+  for (size_t i = 0; i < src.size(); i++) {
+    src[i] = (i % 20 == 0) ? static_cast<uint16_t>(12000 + rng() % 400)
+                           : static_cast<uint16_t>(7990 + rng() % 20);
+  }
+  const uint32_t *palette = GetPaletteTable(ThermalPalette::kWhiteHot);
+  std::vector<uint8_t> dst(src.size() * 4);
+  AutoGain plateau, linear;
+  plateau.SetConfig(ConfigFor(AgcMode::kPlateau));
+  linear.SetConfig(ConfigFor(AgcMode::kLinear));
+  plateau.Process(src.data(), kWidth, kWidth, kHeight, palette, dst.data(),
+                  kWidth * 4);
+  linear.Process(src.data(), kWidth, kWidth, kHeight, palette, dst.data(),
+                 kWidth * 4);
+
+  // The empty gap costs plateau AGC no palette, so the object's 400 counts
+  // cover at least twice the share linear AGC gives them...
+  const auto span = [](const AutoGain &agc, uint16_t lo, uint16_t hi) {
+    return agc.MappingAt(hi >> AutoGain::kBinShift) -
+           agc.MappingAt(lo >> AutoGain::kBinShift);
+  };
+  EXPECT_GT(span(plateau, 12000, 12399), 2 * span(linear, 12000, 12399));
+  // ...and the background, despite holding 95% of the pixels, is clipped at
+  // the plateau instead of taking the whole palette.
+  EXPECT_LT(span(plateau, 7990, 8009), 0.9f);
+  EXPECT_GT(span(plateau, 7990, 8009), 10 * span(linear, 7990, 8009));
+}
+
+TEST(AgcTest, SmoothingLagsAndSnapFollows) {
+  std::vector<uint16_t> cold(kWidth * kHeight), warm(kWidth * kHeight);
+  for (size_t i = 0; i < cold.size(); i++) {
+    cold[i] = static_cast<uint16_t>(1000 + (i % 100) * 10);
+    warm[i] = static_cast<uint16_t>(3000 + (i % 100) * 10);
+  }
+  const uint32_t *palette = GetPaletteTable(ThermalPalette::kWhiteHot);
+  std::vector<uint8_t> dst(cold.size() * 4);
+  const size_t probe = 3500 >> AutoGain::kBinShift;
+
+  AutoGain slow;
+  slow.SetConfig(ConfigFor(AgcMode::kLinear, 0.25f));
+  slow.Process(cold.data(), kWidth, kWidth, kHeight, palette, dst.data(),
+               kWidth * 4);
+  EXPECT_FLOAT_EQ(slow.MappingAt(probe), 1.0f);  // Above the cold scene.
+  slow.Process(warm.data(), kWidth, kWidth, kHeight, palette, dst.data(),
+               kWidth * 4);
+  // Target is 500/990; a quarter of the way there from 1.
+  const float target = 500.0f / 990.0f;
+  EXPECT_NEAR(slow.MappingAt(probe), 1.0f + 0.25f * (target - 1.0f), 0.01f);
+
+  AutoGain fast;
+  fast.SetConfig(ConfigFor(AgcMode::kLinear, 1.0f));
+  fast.Process(cold.data(), kWidth, kWidth, kHeight, palette, dst.data(),
+               kWidth * 4);
+  fast.Process(warm.data(), kWidth, kWidth, kHeight, palette, dst.data(),
+               kWidth * 4);
+  EXPECT_NEAR(fast.MappingAt(probe), target, 0.01f);
+}
+
+TEST(AgcTest, StaticSceneStopsRewritingTheLut) {
+  std::mt19937 rng(11);
+  std::vector<uint16_t> src(kWidth * kHeight);
+  for (auto &v : src) v = static_cast<uint16_t>(9000 + rng() % 2000);
+  const uint32_t *palette = GetPaletteTable(ThermalPalette::kIronbow);
+  std::vector<uint8_t> dst(src.size() * 4);
+
+  AutoGain agc;
+  agc.Process(src.data(), kWidth, kWidth, kHeight, palette, dst.data(),
+              kWidth * 4);
+  for (int i = 0; i < 5; i++) {
+    agc.Process(src.data(), kWidth, kWidth, kHeight, palette, dst.data(),
+                kWidth * 4);
+  }
+  EXPECT_EQ(agc.stats().updated_bins, 0u);
+}
+
+TEST(AgcTest, PaletteChangeRewritesEveryBinBeforeRendering) {
+  std::vector<uint16_t> src(kWidth * kHeight);
+  for (size_t i = 0; i < src.size(); i++) {
+    src[i] = static_cast<uint16_t>(8000 + (i % 400) * 4);
+  }
+  std::vector<uint8_t> dst(src.size() * 4);
+  AutoGain agc;
+  agc.SetConfig(ConfigFor(AgcMode::kLinear));
+  agc.Process(src.data(), kWidth, kWidth, kHeight,
+              GetPaletteTable(ThermalPalette::kWhiteHot), dst.data(),
+              kWidth * 4);
+  agc.Process(src.data(), kWidth, kWidth, kHeight,
+              GetPaletteTable(ThermalPalette::kBlackHot), dst.data(),
+              kWidth * 4);
+  EXPECT_EQ(RedAt(dst, 0), 255);  // Coldest is white in black-hot.
+  EXPECT_EQ(RedAt(dst, 399), 0);
+}
+
+}  // namespace
+}  // namespace uvc
@@ -0,0 +1,255 @@
+#include "bad_pixels.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#include "cpu_features.h"
+#include "test_temp_path.h"
+
+namespace uvc {
+namespace {
+
+constexpr uint32_t kWidth = 80;
+constexpr uint32_t kHeight = 60;
+
+std::vector<SimdLevel> SupportedLevels() {
+  std::vector<SimdLevel> levels = {SimdLevel::kScalar};
+  const SimdLevel detected = DetectSimdLevel();
+  if (detected == SimdLevel::kNeon) {
+    levels.push_back(SimdLevel::kNeon);
+  } else {
+    for (int l = 1; l <= static_cast<int>(detected); l++) {
+      levels.push_back(static_cast<SimdLevel>(l));
+    }
+  }
+  return levels;
+}
+
+uint32_t Index(uint32_t x, uint32_t y) { return y * kWidth + x; }
+
+// A noisy gradient seen through a sensor with a dead pixel, a stuck one and
+// a hot one, the last two next to each other.
+class Sensor {
+ public:
+  static constexpr uint32_t kDead = 10 * kWidth + 10;
+  static constexpr uint32_t kStuck = 30 * kWidth + 40;
+  static constexpr uint32_t kHot = 30 * kWidth + 41;
+
+  std::vector<uint16_t> Frame() {
+    std::normal_distribution<float> noise(0.0f, 4.0f);
+    std::vector<uint16_t> frame(kWidth * kHeight);
+    for (uint32_t y = 0; y < kHeight; y++) {
+      for (uint32_t x = 0; x < kWidth; x++) {
+        frame[Index(x, y)] =
+            static_cast<uint16_t>(3000 + 20 * x + 5 * y + noise(rng_));
+      }
+    }
+    frame[kDead] = 0;
+    frame[kStuck] = 4321;
+    frame[kHot] += 300;
+    return frame;
+  }
+
+ private:
+  std::mt19937 rng_{7};
+};
+
+// The upper median of the good pixels of the 3x3 ring, or of the 5x5 ring
+// when there are none.
+uint16_t ExpectedReplacement(const std::vector<uint16_t> &frame, size_t stride,
+                             const BadPixelMap &map, uint32_t x, uint32_t y) {
+  for (int radius = 1; radius <= 2; radius++) {
+    std::vector<uint16_t> good;
+    for (int dy = -radius; dy <= radius; dy++) {
+      for (int dx = -radius; dx <= radius; dx++) {
+        if (std::max(std::abs(dx), std::abs(dy)) != radius) continue;
+        const int nx = static_cast<int>(x) + dx;
+        const int ny = static_cast<int>(y) + dy;
+        if (nx < 0 || ny < 0 || nx >= static_cast<int>(map.width()) ||
+            ny >= static_cast<int>(map.height()) || map.Contains(nx, ny)) {
+          continue;
+        }
+        good.push_back(frame[ny * stride + nx]);
+      }
+    }
+    // The map takes at most eight; the tests keep to fewer.
+    EXPECT_LE(good.size(), BadPixelMap::kNeighbours);
+    if (!good.empty()) {
+      std::sort(good.begin(), good.end());
+      return good[good.size() / 2];
+    }
+  }
+  return frame[y * stride + x];
+}
+
+class BadPixelsTest : public ::testing::Test {
+ protected:
+  void TearDown() override {
+    SetMaxSimdLevel(SimdLevel::kNeon);
+    std::remove(path_.c_str());
+  }
+
+  std::string path_ = TestTempPath(".uvcbpm");
+};
+
+TEST_F(BadPixelsTest, DetectsDeadStuckAndHotPixels) {
+  Sensor sensor;
+  BadPixelDetector detector(kWidth, kHeight);
+  for (int i = 0; i < 16; i++) {
+    const std::vector<uint16_t> frame = sensor.Frame();
+    detector.Add(frame.data(), kWidth);
+  }
+  EXPECT_EQ(detector.frames(), 16u);
+  const std::vector<uint32_t> bad = detector.Detect(6.0f);
+  EXPECT_EQ(bad, (std::vector<uint32_t>{Sensor::kDead, Sensor::kStuck,
+                                        Sensor::kHot}));
+}
+
+TEST_F(BadPixelsTest, ReplacesWithTheMedianOfGoodNeighbours) {
+  Sensor sensor;
+  // Isolated, in a pair, on the border, in the corner, and a 3x3 cluster
+  // in the other corner whose centre has only the 5x5 ring to go by.
+  std::vector<uint32_t> indices = {Sensor::kDead, Sensor::kStuck, Sensor::kHot,
+                                   Index(0, 20), Index(kWidth - 1, 0)};
+  for (uint32_t y = 0; y <= 2; y++) {
+    for (uint32_t x = 0; x <= 2; x++) indices.push_back(Index(x, y));
+  }
+  const BadPixelMap map(kWidth, kHeight, indices);
+  EXPECT_EQ(map.size(), indices.size());
+  EXPECT_TRUE(std::is_sorted(map.indices().begin(), map.indices().end()));
+
+  const std::vector<uint16_t> input = sensor.Frame();
+  for (SimdLevel level : SupportedLevels()) {
+    SetMaxSimdLevel(level);
+    std::vector<uint16_t> frame = input;
+    map.Apply(frame.data(), kWidth);
+    for (size_t i = 0; i < frame.size(); i++) {
+      const uint32_t x = static_cast<uint32_t>(i % kWidth);
+      const uint32_t y = static_cast<uint32_t>(i / kWidth);
+      const uint16_t expected =
+          map.Contains(x, y) ? ExpectedReplacement(input, kWidth, map, x, y)
+                             : input[i];
+      ASSERT_EQ(frame[i], expected)
+          << SimdLevelName(level) << " at " << x << "," << y;
+    }
+    // Nothing bright is left.
+    EXPECT_LT(frame[Sensor::kHot], input[Sensor::kHot] - 200);
+    EXPECT_GT(frame[Sensor::kDead], 3000);
+  }
+}
+
+TEST_F(BadPixelsTest, SimdLevelsMatchScalar) {
+  // More bad pixels than one batch, on padded rows.
+  constexpr size_t kStride = kWidth + 13;
+  std::mt19937 rng(9);
+  std::uniform_int_distribution<uint32_t> pixel(0, kWidth * kHeight - 1);
+  std::uniform_int_distribution<int> count(0, 65535);
+  std::vector<uint32_t> indices(700);
+  for (uint32_t &index : indices) index = pixel(rng);
+  const BadPixelMap map(kWidth, kHeight, indices);
+  std::vector<uint16_t> input(kStride * kHeight);
+  for (uint16_t &v : input) v = static_cast<uint16_t>(count(rng));
+
+  std::vector<uint16_t> reference;
+  for (SimdLevel level : SupportedLevels()) {
+    SetMaxSimdLevel(level);
+    std::vector<uint16_t> frame = input;
+    map.Apply(frame.data(), kStride);
+    if (level == SimdLevel::kScalar) {
+      reference = frame;
+      continue;
+    }
+    ASSERT_EQ(frame, reference) << SimdLevelName(level);
+  }
+}
+
+TEST_F(BadPixelsTest, SavedMapLoadsBack) {
+  const BadPixelMap map(kWidth, kHeight,
+                        {Index(5, 5), Index(1, 2), kWidth * kHeight + 3});
+  EXPECT_EQ(map.indices(), (std::vector<uint32_t>{Index(1, 2), Index(5, 5)}));
+  ASSERT_TRUE(map.Save(path_));
+
+  std::string error;
+  std::shared_ptr<const BadPixelMap> loaded = BadPixelMap::Load(path_, &error);
+  ASSERT_NE(loaded, nullptr) << error;
+  EXPECT_EQ(loaded->width(), kWidth);
+  EXPECT_EQ(loaded->height(), kHeight);
+  EXPECT_EQ(loaded->indices(), map.indices());
+
+  std::ofstream(path_, std::ios::binary | std::ios::trunc).write("UVCBPM1", 8);
+  EXPECT_EQ(BadPixelMap::Load(path_, &error), nullptr);
+  EXPECT_EQ(error, "INVALID_FILE: truncated header");
+  BadPixelCorrector corrector;
+  EXPECT_FALSE(corrector.LoadMap(path_ + ".missing", &error));
+  EXPECT_EQ(corrector.map(), nullptr);
+
+  EXPECT_EQ(BadPixelMapFileName("Lepton 3.5-0x1A2B"),
+            "badpixels-lepton_3.5-0x1a2b.uvcbpm");
+  EXPECT_EQ(BadPixelMapFileName("\\\\?\\usb#vid_1e4e&pid_0100"),
+            "badpixels-____usb_vid_1e4e_pid_0100.uvcbpm");
+}
+
+TEST_F(BadPixelsTest, ScansWhileFramesKeepComing) {
+  Sensor sensor;
+  BadPixelCorrector corrector;
+  corrector.SetEnabled(true);
+  BadPixelResult result;
+  ASSERT_TRUE(corrector.Scan(8, 6.0f, kWidth, kHeight, path_,
+                             [&](const BadPixelResult &r) { result = r; }));
+  EXPECT_FALSE(corrector.Scan(8, 6.0f, kWidth, kHeight, "", nullptr));
+  // Two frames more than the scan needs.
+  for (int i = 0; i < 10; i++) {
+    std::vector<uint16_t> frame = sensor.Frame();
+    corrector.Process(frame.data(), kWidth, kWidth, kHeight);
+  }
+  corrector.Flush();
+  ASSERT_TRUE(result.ok) << result.error;
+  EXPECT_EQ(result.frames, 8u);
+  EXPECT_EQ(result.count, 3u);
+  EXPECT_EQ(result.path, path_);
+
+  std::vector<uint16_t> frame = sensor.Frame();
+  const uint16_t hot = frame[Sensor::kHot];
+  corrector.Process(frame.data(), kWidth, kWidth, kHeight);
+  EXPECT_LT(frame[Sensor::kHot], hot - 200);
+  EXPECT_GT(frame[Sensor::kDead], 3000);
+
+  // The saved map starts the next session without a scan.
+  BadPixelCorrector next;
+  std::string error;
+  ASSERT_TRUE(next.LoadMap(path_, &error)) << error;
+  EXPECT_EQ(next.map()->size(), 3u);
+}
+
+TEST_F(BadPixelsTest, ScanFailsWhenTheFramesStop) {
+  BadPixelCorrector corrector;
+  BadPixelResult result;
+  ASSERT_TRUE(corrector.Scan(4, 6.0f, kWidth, kHeight, "",
+                             [&](const BadPixelResult &r) { result = r; }));
+  std::vector<uint16_t> frame(kWidth * kHeight, 1000);
+  corrector.Process(frame.data(), kWidth, kWidth, kHeight);
+  std::vector<uint16_t> small(32 * 16, 1000);
+  corrector.Process(small.data(), 32, 32, 16);
+  corrector.Flush();
+  EXPECT_FALSE(result.ok);
+  EXPECT_EQ(result.error, "SIZE_CHANGED");
+  EXPECT_EQ(result.frames, 1u);
+
+  ASSERT_TRUE(corrector.Scan(4, 6.0f, kWidth, kHeight, "",
+                             [&](const BadPixelResult &r) { result = r; }));
+  corrector.Process(frame.data(), kWidth, kWidth, kHeight);
+  corrector.Reset();
+  corrector.Flush();
+  EXPECT_EQ(result.error, "SCAN_STOPPED");
+  EXPECT_FALSE(corrector.Scan(0, 6.0f, kWidth, kHeight, "", nullptr));
+  EXPECT_FALSE(corrector.Scan(4, 0.0f, kWidth, kHeight, "", nullptr));
+}
+
+}  // namespace
+}  // namespace uvc
@@ -0,0 +1,218 @@
+#include "burst_recorder.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "replay_source.h"
+#include "test_temp_path.h"
+
+namespace uvc {
+namespace {
+
+constexpr uint32_t kWidth = 8;
+constexpr uint32_t kHeight = 4;
+constexpr size_t kFrameBytes = kWidth * kHeight * 2;  // 64, one cache line.
+constexpr int64_t kFrameInterval = 10;
+
+SourceMode Gray16Mode() {
+  SourceMode mode;
+  mode.format = SourcePixelFormat::kGray16;
+  mode.width = kWidth;
+  mode.height = kHeight;
+  mode.bit_depth = 14;
+  mode.fps_numerator = 60;
+  return mode;
+}
+
+class BurstRecorderTest : public ::testing::Test {
+ protected:
+  void TearDown() override { std::remove(path_.c_str()); }
+
+  // Records frames |first| up to |last|, each filled with its number and
+  // stamped |number| * kFrameInterval. Rows are padded, as from a camera.
+  void RecordFrames(BurstRecorder *recorder, int first, int last) {
+    std::vector<uint16_t> pixels(kWidth * 2 * kHeight);
+    for (int number = first; number <= last; number++) {
+      std::fill(pixels.begin(), pixels.end(), static_cast<uint16_t>(number));
+      SourceFrame frame;
+      frame.data = reinterpret_cast<const uint8_t *>(pixels.data());
+      frame.stride = kWidth * 2 * 2;
+      frame.sequence = static_cast<uint64_t>(number);
+      frame.timestamp = number * kFrameInterval;
+      recorder->Record(frame);
+    }
+  }
+
+  // The first pixel of each frame in the recording at |path_|.
+  std::vector<int> RecordedFrames() {
+    std::ifstream file(path_, std::ios::binary);
+    const std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)),
+                                     std::istreambuf_iterator<char>());
+    RecordingHeader header{};
+    EXPECT_GE(bytes.size(), sizeof(header));
+    if (bytes.size() < sizeof(header)) return {};
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    EXPECT_EQ(header.format,
+              static_cast<uint32_t>(SourcePixelFormat::kGray16));
+    EXPECT_EQ(header.bit_depth, 14u);
+    EXPECT_EQ(bytes.size(), sizeof(header) + header.frame_count * kFrameBytes);
+    std::vector<int> frames;
+    for (uint64_t i = 0; i < header.frame_count; i++) {
+      uint16_t value = 0;
+      std::memcpy(&value, &bytes[sizeof(header) + i * kFrameBytes],
+                  sizeof(value));
+      frames.push_back(value);
+    }
+    return frames;
+  }
+
+  std::string path_ = TestTempPath(".uvcrec");
+};
+
+TEST_F(BurstRecorderTest, SavesTheWindowAroundTheTrigger) {
+  BurstRecorder recorder;
+  ASSERT_TRUE(recorder.Configure(Gray16Mode(), 20 * kFrameBytes,
+                                 BurstEviction::kOldest));
+  EXPECT_EQ(recorder.Stats().capacity, 20u);
+  RecordFrames(&recorder, 0, 29);
+
+  BurstResult result;
+  // 50 before and 30 after a trigger between frames 29 and 30.
+  ASSERT_TRUE(recorder.Trigger(295, 50, 30, path_,
+                               [&](const BurstResult &r) { result = r; }));
+  EXPECT_FALSE(recorder.Trigger(295, 50, 30, path_, nullptr));
+  RecordFrames(&recorder, 30, 40);
+  recorder.Flush();
+
+  ASSERT_TRUE(result.ok) << result.error;
+  EXPECT_EQ(result.frames, 8u);
+  EXPECT_EQ(result.pre_frames, 5u);
+  EXPECT_EQ(result.first_offset, -45);
+  EXPECT_EQ(result.last_offset, 25);
+  EXPECT_FALSE(result.truncated);
+  EXPECT_EQ(RecordedFrames(),
+            (std::vector<int>{25, 26, 27, 28, 29, 30, 31, 32}));
+
+  const BurstRecorderStats stats = recorder.Stats();
+  EXPECT_EQ(stats.recorded, 41u);
+  EXPECT_EQ(stats.dropped, 0u);
+  EXPECT_EQ(stats.bursts, 1u);
+}
+
+TEST_F(BurstRecorderTest, RecordingContinuesWhileABurstIsPinned) {
+  BurstRecorder recorder;
+  ASSERT_TRUE(recorder.Configure(Gray16Mode(), 16 * kFrameBytes,
+                                 BurstEviction::kOldest));
+  RecordFrames(&recorder, 0, 15);
+  // A window larger than the ring keeps the newest three quarters of it.
+  BurstResult result;
+  ASSERT_TRUE(recorder.Trigger(1000, 1000, 0, path_,
+                               [&](const BurstResult &r) { result = r; }));
+  RecordFrames(&recorder, 16, 200);
+  recorder.Flush();
+
+  ASSERT_TRUE(result.ok) << result.error;
+  EXPECT_TRUE(result.truncated);
+  EXPECT_EQ(result.frames, 12u);
+  const std::vector<int> frames = RecordedFrames();
+  ASSERT_EQ(frames.size(), 12u);
+  EXPECT_EQ(frames.front(), 4);
+  EXPECT_EQ(frames.back(), 15);
+  const BurstRecorderStats stats = recorder.Stats();
+  EXPECT_EQ(stats.recorded, 201u);
+  EXPECT_EQ(stats.dropped, 0u);
+
+  // The next burst sees the history recorded meanwhile.
+  ASSERT_TRUE(recorder.Trigger(2005, 30, 0, path_,
+                               [&](const BurstResult &r) { result = r; }));
+  recorder.Flush();
+  EXPECT_EQ(RecordedFrames(), (std::vector<int>{198, 199, 200}));
+}
+
+TEST_F(BurstRecorderTest, ThinningReachesFurtherBack) {
+  int64_t first_offset[2] = {};
+  const BurstEviction evictions[] = {BurstEviction::kOldest,
+                                     BurstEviction::kThinOlder};
+  for (int i = 0; i < 2; i++) {
+    BurstRecorder recorder;
+    ASSERT_TRUE(
+        recorder.Configure(Gray16Mode(), 16 * kFrameBytes, evictions[i]));
+    RecordFrames(&recorder, 0, 99);
+    BurstResult result;
+    ASSERT_TRUE(recorder.Trigger(995, 995, 0, path_,
+                                 [&](const BurstResult &r) { result = r; }));
+    recorder.Flush();
+    ASSERT_TRUE(result.ok) << result.error;
+    first_offset[i] = result.first_offset;
+
+    // Still in recording order, and the newest frames are all there.
+    const std::vector<int> frames = RecordedFrames();
+    ASSERT_EQ(frames.size(), 12u);
+    for (size_t f = 1; f < frames.size(); f++) {
+      EXPECT_LT(frames[f - 1], frames[f]);
+    }
+    EXPECT_EQ(frames.back(), 99);
+    EXPECT_EQ(frames[frames.size() - 6], 94);
+  }
+  EXPECT_EQ(first_offset[0], -(995 - 880));
+  EXPECT_LT(first_offset[1], first_offset[0]);
+}
+
+TEST_F(BurstRecorderTest, ResetEndsAPendingWindow) {
+  BurstRecorder recorder;
+  ASSERT_TRUE(recorder.Configure(Gray16Mode(), 16 * kFrameBytes,
+                                 BurstEviction::kOldest));
+  RecordFrames(&recorder, 0, 9);
+  BurstResult result;
+  ASSERT_TRUE(recorder.Trigger(95, 20, 1000, path_,
+                               [&](const BurstResult &r) { result = r; }));
+  RecordFrames(&recorder, 10, 11);
+  recorder.Reset();
+
+  EXPECT_FALSE(recorder.configured());
+  ASSERT_TRUE(result.ok) << result.error;
+  EXPECT_TRUE(result.truncated);
+  EXPECT_EQ(RecordedFrames(), (std::vector<int>{8, 9, 10, 11}));
+  EXPECT_FALSE(recorder.Trigger(200, 20, 0, path_, nullptr));
+}
+
+TEST_F(BurstRecorderTest, RejectsWhatCannotBeRecorded) {
+  BurstRecorder recorder;
+  EXPECT_FALSE(recorder.Trigger(0, 10, 0, path_, nullptr));
+  EXPECT_FALSE(recorder.Configure(Gray16Mode(), 7 * kFrameBytes,
+                                  BurstEviction::kOldest));
+  SourceMode mjpeg = Gray16Mode();
+  mjpeg.format = SourcePixelFormat::kMjpeg;
+  EXPECT_FALSE(recorder.Configure(mjpeg, 1 << 20, BurstEviction::kOldest));
+  EXPECT_FALSE(recorder.configured());
+
+  ASSERT_TRUE(recorder.Configure(Gray16Mode(), 8 * kFrameBytes,
+                                 BurstEviction::kOldest));
+  RecordFrames(&recorder, 0, 3);
+  BurstResult result;
+  ASSERT_TRUE(recorder.Trigger(35, 10, 0, "/nonexistent/dir/burst.uvcrec",
+                               [&](const BurstResult &r) { result = r; }));
+  recorder.Flush();
+  EXPECT_FALSE(result.ok);
+  EXPECT_EQ(result.error, "WRITE_FAILED: /nonexistent/dir/burst.uvcrec");
+  EXPECT_EQ(recorder.Stats().bursts, 1u);
+}
+
+TEST(BurstEvictionTest, Parses) {
+  BurstEviction eviction = BurstEviction::kOldest;
+  EXPECT_TRUE(ParseBurstEviction("thin", &eviction));
+  EXPECT_EQ(eviction, BurstEviction::kThinOlder);
+  EXPECT_TRUE(ParseBurstEviction("oldest", &eviction));
+  EXPECT_EQ(eviction, BurstEviction::kOldest);
+  EXPECT_FALSE(ParseBurstEviction("newest", &eviction));
+}
+
+}  // namespace
+}  // namespace uvc
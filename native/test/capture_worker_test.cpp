@@ -0,0 +1,206 @@
+#include "capture_worker.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#include "frame_source.h"
+
+namespace uvc {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using std::chrono::milliseconds;
+
+// A camera that never delivers on its own: Next() blocks until a test
+// pushes a frame or Interrupt() is called, like a V4L2 read on a stalled
+// device. Interrupt() is sticky until Start(), as in the real sources.
+class BlockingSource : public FrameSource {
+ public:
+  SourceMode mode() const override { return SourceMode(); }
+
+  bool Start() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    interrupted_ = false;
+    return true;
+  }
+  void Stop() override {}
+
+  SourceStatus Next(int timeout_ms, SourceFrame *frame) override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    blocked_++;
+    changed_.notify_all();
+    const auto ready = [this] { return interrupted_ || queued_ > 0; };
+    if (timeout_ms < 0) {
+      changed_.wait(lock, ready);
+    } else if (!changed_.wait_for(lock, milliseconds(timeout_ms), ready)) {
+      return SourceStatus::kTimeout;
+    }
+    if (interrupted_) return SourceStatus::kInterrupted;
+    queued_--;
+    frame->sequence = ++sequence_;
+    return SourceStatus::kFrame;
+  }
+  void Release(const SourceFrame &) override {}
+
+  void Interrupt() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    interrupted_ = true;
+    changed_.notify_all();
+  }
+
+  void Push() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queued_++;
+    changed_.notify_all();
+  }
+
+  // Waits until a reader has entered Next() |count| times in total.
+  bool WaitUntilBlocked(int count) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return changed_.wait_for(lock, milliseconds(2000),
+                             [&] { return blocked_ >= count; });
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  bool interrupted_ = false;
+  int queued_ = 0;
+  int blocked_ = 0;
+  uint64_t sequence_ = 0;
+};
+
+// The capture loop shape both runners use.
+void ReadUntilStopped(CaptureWorker &worker, FrameSource &source,
+                      std::atomic<uint64_t> &frames) {
+  while (!worker.stop_requested()) {
+    SourceFrame frame;
+    const SourceStatus status = source.Next(-1, &frame);
+    if (status == SourceStatus::kError || status == SourceStatus::kEnd) break;
+    if (status != SourceStatus::kFrame) continue;
+    frames.fetch_add(1);
+    source.Release(frame);
+  }
+}
+
+double ElapsedMs(Clock::time_point since) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - since)
+      .count();
+}
+
+TEST(CaptureWorkerTest, StopWakesBlockedReadPromptly) {
+  BlockingSource source;
+  source.Start();
+  std::atomic<uint64_t> frames{0};
+  CaptureWorker worker;
+  ASSERT_TRUE(worker.Start([&] { ReadUntilStopped(worker, source, frames); },
+                           [&] { source.Interrupt(); }));
+  source.Push();
+  ASSERT_TRUE(source.WaitUntilBlocked(2));
+  EXPECT_EQ(frames.load(), 1u);
+
+  const auto start = Clock::now();
+  EXPECT_TRUE(worker.Stop(milliseconds(1000)));
+  const double stop_ms = ElapsedMs(start);
+  EXPECT_FALSE(worker.running());
+  // Woken rather than left to a read timeout: a blocked read here never
+  // times out, so anything but a wake-up would hit the 1 s deadline. The
+  // bound leaves room for scheduler delays on a loaded machine.
+  EXPECT_LT(stop_ms, 500.0);
+}
+
+TEST(CaptureWorkerTest, RestartsAfterStop) {
+  BlockingSource source;
+  std::atomic<uint64_t> frames{0};
+  CaptureWorker worker;
+  const auto body = [&] { ReadUntilStopped(worker, source, frames); };
+  const auto wake = [&] { source.Interrupt(); };
+
+  double worst_restart_ms = 0;
+  for (int run = 1; run <= 20; run++) {
+    // A resolution change: stop, reopen the source, start, first frame.
+    const auto start = Clock::now();
+    ASSERT_TRUE(worker.Stop(milliseconds(1000)));
+    source.Start();
+    ASSERT_TRUE(worker.Start(body, wake));
+    source.Push();
+    ASSERT_TRUE(source.WaitUntilBlocked(2 * run));
+    worst_restart_ms = std::max(worst_restart_ms, ElapsedMs(start));
+    EXPECT_EQ(frames.load(), static_cast<uint64_t>(run));
+  }
+  EXPECT_TRUE(worker.Stop(milliseconds(1000)));
+  EXPECT_LT(worst_restart_ms, 500.0);
+}
+
+TEST(CaptureWorkerTest, JoinTimesOutWhileBodyIgnoresStop) {
+  // No wake function: the read only returns when a frame arrives.
+  BlockingSource source;
+  source.Start();
+  std::atomic<uint64_t> frames{0};
+  CaptureWorker worker;
+  ASSERT_TRUE(
+      worker.Start([&] { ReadUntilStopped(worker, source, frames); }));
+  ASSERT_TRUE(source.WaitUntilBlocked(1));
+
+  const auto start = Clock::now();
+  EXPECT_FALSE(worker.Stop(milliseconds(30)));
+  EXPECT_GE(ElapsedMs(start), 25.0);
+  EXPECT_TRUE(worker.running());
+  // Still running, so it cannot be started twice.
+  EXPECT_FALSE(worker.Start([] {}));
+
+  source.Push();
+  EXPECT_TRUE(worker.Join(milliseconds(1000)));
+  EXPECT_FALSE(worker.running());
+}
+
+TEST(CaptureWorkerTest, BodyThatEndsOnItsOwnJoinsImmediately) {
+  CaptureWorker worker;
+  std::atomic<bool> ran{false};
+  ASSERT_TRUE(worker.Start([&] { ran = true; }));
+  EXPECT_TRUE(worker.Join(milliseconds(1000)));
+  EXPECT_TRUE(ran.load());
+  // A finished run can be restarted without an explicit stop.
+  ASSERT_TRUE(worker.Start([] {}));
+  worker.Join();
+  EXPECT_FALSE(worker.running());
+}
+
+TEST(CaptureWorkerTest, WaitForStopReturnsEarlyOnStop) {
+  CaptureWorker worker;
+  std::atomic<bool> stopped{false};
+  ASSERT_TRUE(worker.Start(
+      [&] { stopped = worker.WaitForStop(milliseconds(10000)); }));
+  const auto start = Clock::now();
+  EXPECT_TRUE(worker.Stop(milliseconds(1000)));
+  EXPECT_LT(ElapsedMs(start), 50.0);
+  EXPECT_TRUE(stopped.load());
+
+  // Without a stop it sleeps the full timeout.
+  ASSERT_TRUE(
+      worker.Start([&] { stopped = worker.WaitForStop(milliseconds(5)); }));
+  worker.Join();
+  EXPECT_FALSE(stopped.load());
+}
+
+TEST(CaptureWorkerTest, DestructorStopsRunningWorker) {
+  BlockingSource source;
+  source.Start();
+  std::atomic<uint64_t> frames{0};
+  {
+    CaptureWorker worker;
+    ASSERT_TRUE(worker.Start([&] { ReadUntilStopped(worker, source, frames); },
+                             [&] { source.Interrupt(); }));
+    ASSERT_TRUE(source.WaitUntilBlocked(1));
+  }
+  SUCCEED();
+}
+
+}  // namespace
+}  // namespace uvc
@@ -0,0 +1,161 @@
+#include "device_registry.h"
+
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace uvc {
+namespace {
+
+// Stands in for Media Foundation / V4L2: the test edits |devices| to plug
+// and unplug cameras and sees how often the registry asks.
+class MockEnumerator : public DeviceEnumerator {
+ public:
+  struct State {
+    std::vector<std::string> devices;
+    bool fail = false;
+    int calls = 0;
+    int live_handles = 0;
+    // Runs inside Enumerate(), to simulate notifications mid-enumeration.
+    std::function<void()> during;
+  };
+
+  explicit MockEnumerator(State *state) : state_(state) {}
+
+  bool Enumerate(std::vector<DeviceEntry> *devices) override {
+    state_->calls++;
+    if (state_->during) state_->during();
+    if (state_->fail) return false;
+    for (const std::string &name : state_->devices) {
+      DeviceEntry entry;
+      entry.name = name;
+      entry.id = "\\\\?\\usb#" + name;
+      State *state = state_;
+      state->live_handles++;
+      entry.handle = std::shared_ptr<void>(new int(0), [state](void *p) {
+        state->live_handles--;
+        delete static_cast<int *>(p);
+      });
+      devices->push_back(entry);
+    }
+    return true;
+  }
+
+ private:
+  State *state_;
+};
+
+TEST(DeviceRegistryTest, EnumeratesOnceUntilInvalidated) {
+  MockEnumerator::State state;
+  state.devices = {"Lepton", "Webcam"};
+  DeviceRegistry registry(std::make_unique<MockEnumerator>(&state));
+
+  std::shared_ptr<const DeviceSnapshot> first = registry.Get();
+  for (int i = 0; i < 100; i++) {
+    // Polling status, as the preview page does every two seconds.
+    EXPECT_EQ(registry.Get(), first);
+  }
+  EXPECT_EQ(state.calls, 1);
+  EXPECT_EQ(registry.enumerations(), 1u);
+  ASSERT_TRUE(first->ok);
+  ASSERT_EQ(first->devices.size(), 2u);
+  EXPECT_EQ(first->devices[1].name, "Webcam");
+
+  // Hot-plug: the device arrives, the window gets WM_DEVICECHANGE.
+  state.devices.push_back("Boson");
+  registry.Invalidate();
+  registry.Invalidate();  // Several notifications per device are common.
+  std::shared_ptr<const DeviceSnapshot> second = registry.Get();
+  EXPECT_EQ(state.calls, 2);
+  ASSERT_EQ(second->devices.size(), 3u);
+  EXPECT_GT(second->generation, first->generation);
+  // The earlier snapshot is untouched for whoever still holds it.
+  EXPECT_EQ(first->devices.size(), 2u);
+}
+
+TEST(DeviceRegistryTest, FindsDevicesById) {
+  MockEnumerator::State state;
+  state.devices = {"Lepton", "Webcam"};
+  DeviceRegistry registry(std::make_unique<MockEnumerator>(&state));
+  std::shared_ptr<const DeviceSnapshot> snapshot = registry.Get();
+  const DeviceEntry *entry = snapshot->Find("\\\\?\\usb#Webcam");
+  ASSERT_NE(entry, nullptr);
+  EXPECT_EQ(entry->name, "Webcam");
+  EXPECT_EQ(snapshot->Find("\\\\?\\usb#Boson"), nullptr);
+}
+
+TEST(DeviceRegistryTest, RetriesFailedEnumeration) {
+  MockEnumerator::State state;
+  state.devices = {"Lepton"};
+  state.fail = true;
+  DeviceRegistry registry(std::make_unique<MockEnumerator>(&state));
+
+  std::shared_ptr<const DeviceSnapshot> failed = registry.Get();
+  EXPECT_FALSE(failed->ok);
+  EXPECT_TRUE(failed->devices.empty());
+
+  state.fail = false;
+  std::shared_ptr<const DeviceSnapshot> snapshot = registry.Get();
+  EXPECT_TRUE(snapshot->ok);
+  EXPECT_EQ(snapshot->devices.size(), 1u);
+  registry.Get();
+  EXPECT_EQ(state.calls, 2);
+}
+
+TEST(DeviceRegistryTest, NotificationDuringEnumerationIsNotLost) {
+  MockEnumerator::State state;
+  state.devices = {"Lepton"};
+  DeviceRegistry registry(std::make_unique<MockEnumerator>(&state));
+  // The device list changes while the first enumeration runs.
+  state.during = [&] {
+    state.during = nullptr;
+    state.devices.push_back("Webcam");
+    registry.Invalidate();
+  };
+  registry.Get();
+  EXPECT_EQ(registry.Get()->devices.size(), 2u);
+  EXPECT_EQ(state.calls, 2);
+  registry.Get();
+  EXPECT_EQ(state.calls, 2);
+}
+
+TEST(DeviceRegistryTest, ReleasesHandlesWithTheLastSnapshot) {
+  MockEnumerator::State state;
+  state.devices = {"Lepton", "Webcam"};
+  {
+    DeviceRegistry registry(std::make_unique<MockEnumerator>(&state));
+    std::shared_ptr<const DeviceSnapshot> held = registry.Get();
+    EXPECT_EQ(state.live_handles, 2);
+
+    registry.Invalidate();
+    registry.Get();
+    // |held| keeps its handles; the registry holds the new ones.
+    EXPECT_EQ(state.live_handles, 4);
+    held.reset();
+    EXPECT_EQ(state.live_handles, 2);
+  }
+  EXPECT_EQ(state.live_handles, 0);
+}
+
+TEST(DeviceRegistryTest, ConcurrentReadersShareOneEnumeration) {
+  MockEnumerator::State state;
+  state.devices = {"Lepton"};
+  DeviceRegistry registry(std::make_unique<MockEnumerator>(&state));
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 4; t++) {
+    readers.emplace_back([&] {
+      for (int i = 0; i < 1000; i++) {
+        EXPECT_EQ(registry.Get()->devices.size(), 1u);
+      }
+    });
+  }
+  for (std::thread &reader : readers) reader.join();
+  EXPECT_EQ(state.calls, 1);
+}
+
+}  // namespace
+}  // namespace uvc
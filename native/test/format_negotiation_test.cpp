@@ -0,0 +1,269 @@
+#include "format_negotiation.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace uvc {
+namespace {
+
+Capability Cap(VideoSubtype subtype, uint32_t w, uint32_t h, uint32_t num,
+               uint32_t den = 1) {
+  Capability capability;
+  capability.subtype = subtype;
+  capability.width = w;
+  capability.height = h;
+  capability.rate = FrameRate{num, den};
+  return capability;
+}
+
+CapabilityIndex Index(const std::vector<Capability> &capabilities) {
+  CapabilityIndex index;
+  uint32_t native_index = 0;
+  for (Capability capability : capabilities) {
+    capability.native_index = native_index++;
+    index.Add(capability);
+  }
+  return index;
+}
+
+// What the Windows runner offers: YUY2 and RGB32 converted in the capture
+// loop, anything else through the video processor.
+FormatRequest Colour(uint32_t w = 0, uint32_t h = 0, FrameRate rate = {}) {
+  FormatRequest request;
+  request.width = w;
+  request.height = h;
+  request.rate = rate;
+  request.direct_subtypes =
+      SubtypeBit(VideoSubtype::kYuy2) | SubtypeBit(VideoSubtype::kRgb32);
+  request.processor = true;
+  return request;
+}
+
+// A typical webcam: MJPG for the large sizes, YUY2 and NV12 for the rest.
+const std::vector<Capability> kWebcam = {
+    Cap(VideoSubtype::kMjpg, 1920, 1080, 30),
+    Cap(VideoSubtype::kMjpg, 1280, 720, 30),
+    Cap(VideoSubtype::kNv12, 1280, 720, 10),
+    Cap(VideoSubtype::kYuy2, 1280, 720, 10),
+    Cap(VideoSubtype::kYuy2, 640, 480, 30),
+    Cap(VideoSubtype::kYuy2, 640, 480, 15),
+    Cap(VideoSubtype::kNv12, 640, 480, 30000, 1001),
+};
+
+TEST(FrameRateTest, ComparesExactRatios) {
+  EXPECT_EQ((FrameRate{60, 1}), (FrameRate{120, 2}));
+  EXPECT_NE((FrameRate{30, 1}), (FrameRate{30000, 1001}));
+  EXPECT_NE((FrameRate{30, 1}), FrameRate());
+  EXPECT_EQ(FrameRate(), (FrameRate{0, 1}));
+  const FrameRate reduced = FrameRate{10000000, 333333}.Reduced();
+  EXPECT_EQ(reduced.numerator, 10000000u);
+  EXPECT_EQ((FrameRate{50, 2}.Reduced().numerator), 25u);
+  EXPECT_DOUBLE_EQ((FrameRate{30000, 1001}.ToDouble()), 30000.0 / 1001);
+}
+
+TEST(CapabilityIndexTest, FoldsDuplicateKeysKeepingTheFirst) {
+  CapabilityIndex index;
+  Capability first = Cap(VideoSubtype::kYuy2, 640, 480, 30);
+  first.native_index = 4;
+  EXPECT_TRUE(index.Add(first));
+  // The same mode listed again, e.g. once per colour space.
+  Capability again = Cap(VideoSubtype::kYuy2, 640, 480, 60, 2);
+  again.native_index = 9;
+  EXPECT_FALSE(index.Add(again));
+  // Differs only in the exact rate.
+  EXPECT_TRUE(index.Add(Cap(VideoSubtype::kYuy2, 640, 480, 30000, 1001)));
+  EXPECT_TRUE(index.Add(Cap(VideoSubtype::kNv12, 640, 480, 30)));
+  ASSERT_EQ(index.size(), 3u);
+  EXPECT_EQ(index.capabilities()[0].native_index, 4u);
+}
+
+TEST(CapabilityIndexTest, ListsSizesInFirstSeenOrder) {
+  const CapabilityIndex index = Index(kWebcam);
+  const std::vector<std::pair<uint32_t, uint32_t>> sizes = index.Sizes();
+  ASSERT_EQ(sizes.size(), 3u);
+  EXPECT_EQ(sizes[0], std::make_pair(1920u, 1080u));
+  EXPECT_EQ(sizes[1], std::make_pair(1280u, 720u));
+  EXPECT_EQ(sizes[2], std::make_pair(640u, 480u));
+}
+
+TEST(FormatNegotiationTest, CostsFollowThePolicy) {
+  EXPECT_LT(FormatCost(VideoSubtype::kY16, FormatPath::kRaw),
+            FormatCost(VideoSubtype::kYuy2, FormatPath::kRaw));
+  EXPECT_LT(FormatCost(VideoSubtype::kRgb32, FormatPath::kDirect),
+            FormatCost(VideoSubtype::kNv12, FormatPath::kDirect));
+  EXPECT_EQ(FormatCost(VideoSubtype::kNv12, FormatPath::kDirect),
+            FormatCost(VideoSubtype::kYuy2, FormatPath::kDirect));
+  EXPECT_LT(FormatCost(VideoSubtype::kYuy2, FormatPath::kDirect),
+            FormatCost(VideoSubtype::kMjpg, FormatPath::kDirect));
+  EXPECT_LT(FormatCost(VideoSubtype::kMjpg, FormatPath::kDirect),
+            FormatCost(VideoSubtype::kMjpg, FormatPath::kProcessor));
+}
+
+TEST(FormatNegotiationTest, PrefersTheCheapestTypeAtTheRequestedSize) {
+  const CapabilityIndex index = Index(kWebcam);
+  NegotiatedFormat result;
+  // 640x480: YUY2 is converted in-loop, NV12 would need the processor.
+  ASSERT_TRUE(NegotiateFormat(index, Colour(640, 480), &result));
+  EXPECT_EQ(result.native.subtype, VideoSubtype::kYuy2);
+  EXPECT_EQ(result.path, FormatPath::kDirect);
+  EXPECT_EQ(result.native.rate, (FrameRate{30, 1}));
+
+  // Once NV12 is converted in-loop too, the tie goes to the first listed.
+  FormatRequest request = Colour(1280, 720);
+  request.direct_subtypes |= SubtypeBit(VideoSubtype::kNv12);
+  ASSERT_TRUE(NegotiateFormat(index, request, &result));
+  EXPECT_EQ(result.native.subtype, VideoSubtype::kNv12);
+  EXPECT_EQ(result.native.native_index, 2u);
+
+  // 1920x1080 is MJPG only, decoded by the processor.
+  ASSERT_TRUE(NegotiateFormat(index, Colour(1920, 1080), &result));
+  EXPECT_EQ(result.native.subtype, VideoSubtype::kMjpg);
+  EXPECT_EQ(result.path, FormatPath::kProcessor);
+}
+
+TEST(FormatNegotiationTest, ExactRateOutranksConversionCost) {
+  const CapabilityIndex index = Index(kWebcam);
+  NegotiatedFormat result;
+  // 720p30 needs MJPG; the cheaper YUY2 only does 10 fps there.
+  ASSERT_TRUE(
+      NegotiateFormat(index, Colour(1280, 720, FrameRate{30, 1}), &result));
+  EXPECT_EQ(result.native.subtype, VideoSubtype::kMjpg);
+  // NTSC rates are matched exactly, not rounded to 30.
+  ASSERT_TRUE(NegotiateFormat(index, Colour(640, 480, FrameRate{30000, 1001}),
+                              &result));
+  EXPECT_EQ(result.native.subtype, VideoSubtype::kNv12);
+  EXPECT_EQ(result.native.rate.numerator, 30000u);
+  EXPECT_EQ(result.native.rate.denominator, 1001u);
+  // Without an exact match, the cheapest type at the nearest rate.
+  ASSERT_TRUE(
+      NegotiateFormat(index, Colour(640, 480, FrameRate{20, 1}), &result));
+  EXPECT_EQ(result.native.subtype, VideoSubtype::kYuy2);
+  EXPECT_EQ(result.native.rate, (FrameRate{15, 1}));
+}
+
+TEST(FormatNegotiationTest, SizeOutranksRateAndUnknownSizesFallBack) {
+  const CapabilityIndex index = Index(kWebcam);
+  NegotiatedFormat result;
+  ASSERT_TRUE(
+      NegotiateFormat(index, Colour(1280, 720, FrameRate{15, 1}), &result));
+  EXPECT_EQ(result.native.width, 1280u);
+  EXPECT_EQ(result.native.subtype, VideoSubtype::kYuy2);
+  // A size the camera lacks still opens: cheapest first, then largest.
+  ASSERT_TRUE(NegotiateFormat(index, Colour(800, 600), &result));
+  EXPECT_EQ(result.native.subtype, VideoSubtype::kYuy2);
+  EXPECT_EQ(result.native.width, 1280u);
+}
+
+TEST(FormatNegotiationTest, RawPrefersY16ThenYuy2Transport) {
+  const CapabilityIndex index = Index({
+      Cap(VideoSubtype::kYuy2, 256, 384, 25),
+      Cap(VideoSubtype::kRgb32, 256, 192, 25),
+      Cap(VideoSubtype::kY16, 256, 192, 9),
+      Cap(VideoSubtype::kY16, 256, 192, 25),
+  });
+  FormatRequest request;
+  request.raw = true;
+  request.raw_yuy2 = true;
+  NegotiatedFormat result;
+  ASSERT_TRUE(NegotiateFormat(index, request, &result));
+  EXPECT_EQ(result.native.subtype, VideoSubtype::kY16);
+  EXPECT_EQ(result.path, FormatPath::kRaw);
+  EXPECT_EQ(result.native.rate, (FrameRate{25, 1}));
+  // The YUY2 transport when it is the only one at the requested size.
+  request.width = 256;
+  request.height = 384;
+  ASSERT_TRUE(NegotiateFormat(index, request, &result));
+  EXPECT_EQ(result.native.subtype, VideoSubtype::kYuy2);
+  EXPECT_EQ(result.path, FormatPath::kRaw);
+}
+
+TEST(FormatNegotiationTest, Yuy2IsColourUnlessTheCallerSaysItIsRaw) {
+  // A colour webcam offering nothing but YUY2.
+  const CapabilityIndex index = Index({
+      Cap(VideoSubtype::kYuy2, 640, 480, 30),
+      Cap(VideoSubtype::kYuy2, 320, 240, 30),
+  });
+  FormatRequest request = Colour(640, 480);
+  request.raw = true;
+  NegotiatedFormat result;
+  EXPECT_FALSE(NegotiateFormat(index, request, &result));
+  ASSERT_TRUE(NegotiatePreviewFormat(index, request, &result));
+  EXPECT_EQ(result.native.subtype, VideoSubtype::kYuy2);
+  EXPECT_EQ(result.path, FormatPath::kDirect);
+
+  request.raw_yuy2 = true;
+  ASSERT_TRUE(NegotiatePreviewFormat(index, request, &result));
+  EXPECT_EQ(result.path, FormatPath::kRaw);
+  EXPECT_EQ(result.native.width, 640u);
+}
+
+TEST(FormatNegotiationTest, RawAndColourTypesDoNotMix) {
+  NegotiatedFormat result;
+  FormatRequest raw;
+  raw.raw = true;
+  EXPECT_FALSE(NegotiateFormat(
+      Index({Cap(VideoSubtype::kRgb32, 640, 480, 30),
+             Cap(VideoSubtype::kMjpg, 640, 480, 30)}),
+      raw, &result));
+  // Counts shown as colour would be noise, even through the processor.
+  EXPECT_FALSE(NegotiateFormat(Index({Cap(VideoSubtype::kY16, 160, 120, 9)}),
+                               Colour(), &result));
+}
+
+TEST(FormatNegotiationTest, PreviewFallsBackFromRawToColourPerSize) {
+  const CapabilityIndex index = Index({
+      Cap(VideoSubtype::kY16, 160, 120, 9),
+      Cap(VideoSubtype::kRgb32, 640, 480, 30),
+  });
+  FormatRequest request = Colour();
+  request.raw = true;
+  NegotiatedFormat result;
+  ASSERT_TRUE(NegotiatePreviewFormat(index, request, &result));
+  EXPECT_EQ(result.path, FormatPath::kRaw);
+  // No counts at 640x480: colour there rather than raw at another size.
+  request.width = 640;
+  request.height = 480;
+  ASSERT_TRUE(NegotiatePreviewFormat(index, request, &result));
+  EXPECT_EQ(result.path, FormatPath::kDirect);
+  EXPECT_EQ(result.native.subtype, VideoSubtype::kRgb32);
+  // Raw of another size still beats having nothing to show.
+  request.direct_subtypes = 0;
+  request.processor = false;
+  ASSERT_TRUE(NegotiatePreviewFormat(index, request, &result));
+  EXPECT_EQ(result.path, FormatPath::kRaw);
+  request.raw = false;
+  EXPECT_FALSE(NegotiatePreviewFormat(index, request, &result));
+}
+
+TEST(FormatNegotiationTest, WithoutAProcessorOnlyDirectTypesQualify) {
+  const CapabilityIndex index = Index({
+      Cap(VideoSubtype::kMjpg, 1920, 1080, 30),
+      Cap(VideoSubtype::kUnknown, 640, 480, 30),
+  });
+  FormatRequest request = Colour();
+  request.processor = false;
+  NegotiatedFormat result;
+  EXPECT_FALSE(NegotiateFormat(index, request, &result));
+  // The processor takes MJPG but never a type nobody recognised.
+  ASSERT_TRUE(NegotiateFormat(index, Colour(640, 480), &result));
+  EXPECT_EQ(result.native.subtype, VideoSubtype::kMjpg);
+}
+
+TEST(FormatNegotiationTest, DescribesFixedModeSources) {
+  SourceMode mode;
+  mode.format = SourcePixelFormat::kGray16;
+  mode.bit_depth = 14;
+  mode.width = 160;
+  mode.height = 120;
+  mode.fps_numerator = 9;
+  const Capability capability = CapabilityForMode(mode);
+  EXPECT_EQ(capability.subtype, VideoSubtype::kY14);
+  EXPECT_STREQ(VideoSubtypeName(capability.subtype), "Y14");
+  EXPECT_EQ(capability.rate, (FrameRate{9, 1}));
+  mode.format = SourcePixelFormat::kYuyv;
+  EXPECT_STREQ(VideoSubtypeName(CapabilityForMode(mode).subtype), "YUY2");
+}
+
+}  // namespace
+}  // namespace uvc
@@ -0,0 +1,83 @@
+#include "frame_notifier.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "triple_buffer.h"
+
+namespace uvc {
+namespace {
+
+TEST(FrameNotifierTest, NotifiesOncePerConsumedFrame) {
+  FrameNotifier notifier;
+  EXPECT_FALSE(notifier.Pending());
+  EXPECT_TRUE(notifier.Publish());
+  EXPECT_TRUE(notifier.Pending());
+  // The engine has not copied yet: these ride on the first notification.
+  EXPECT_FALSE(notifier.Publish());
+  EXPECT_FALSE(notifier.Publish());
+
+  notifier.Consume();
+  EXPECT_FALSE(notifier.Pending());
+  EXPECT_TRUE(notifier.Publish());
+}
+
+TEST(FrameNotifierTest, ResetForgetsOutstandingNotification) {
+  FrameNotifier notifier;
+  EXPECT_TRUE(notifier.Publish());
+  notifier.Reset();
+  EXPECT_FALSE(notifier.Pending());
+  EXPECT_TRUE(notifier.Publish());
+}
+
+// Simulates the engine: it copies only when notified. Whatever the
+// interleaving, the last published frame must end up copied, and there are
+// never more notifications than copies.
+TEST(FrameNotifierTest, StressLastFrameIsAlwaysShown) {
+  constexpr uint64_t kFrames = 100000;
+  TripleBuffer<uint64_t> buffer;
+  FrameNotifier notifier;
+  std::atomic<uint64_t> notifications{0};
+  std::atomic<bool> producer_done{false};
+
+  std::thread producer([&] {
+    for (uint64_t sequence = 1; sequence <= kFrames; sequence++) {
+      buffer.WriteBuffer() = sequence;
+      buffer.Publish();
+      if (notifier.Publish()) {
+        notifications.fetch_add(1, std::memory_order_release);
+      }
+    }
+    producer_done.store(true, std::memory_order_release);
+  });
+
+  uint64_t copies = 0;
+  uint64_t last_seen = 0;
+  uint64_t regressions = 0;
+  for (;;) {
+    const bool done = producer_done.load(std::memory_order_acquire);
+    if (notifications.load(std::memory_order_acquire) > copies) {
+      copies++;
+      notifier.Consume();
+      buffer.Update();
+      if (buffer.ReadBuffer() < last_seen) regressions++;
+      last_seen = buffer.ReadBuffer();
+    } else if (done) {
+      break;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+
+  EXPECT_EQ(last_seen, kFrames) << "the final frame was never announced";
+  EXPECT_EQ(regressions, 0u);
+  EXPECT_EQ(notifications.load(), copies);
+  EXPECT_LE(copies, kFrames);
+}
+
+}  // namespace
+}  // namespace uvc
@@ -0,0 +1,157 @@
+#include "frame_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace uvc {
+namespace {
+
+FrameFormat Rgba(uint32_t width, uint32_t height) {
+  FrameFormat format;
+  format.pixel_format = PixelFormat::kRgba8;
+  format.width = width;
+  format.height = height;
+  return format;
+}
+
+TEST(FramePoolTest, UnconfiguredPoolHandsOutNothing) {
+  FramePool pool;
+  EXPECT_FALSE(pool.Acquire());
+  EXPECT_EQ(pool.Stats().exhausted, 1u);
+}
+
+TEST(FramePoolTest, FramesAreAlignedAndSized) {
+  FramePool pool;
+  ASSERT_TRUE(pool.Configure(Rgba(321, 17), 3, 3));
+  std::vector<FrameRef> frames;
+  for (int i = 0; i < 3; i++) {
+    frames.push_back(pool.Acquire());
+    ASSERT_TRUE(frames.back());
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(frames.back().data()) %
+                  FramePool::kAlignment,
+              0u);
+    EXPECT_EQ(frames.back().size(), 321u * 17u * 4u);
+    EXPECT_EQ(frames.back().format(), Rgba(321, 17));
+  }
+}
+
+TEST(FramePoolTest, CopiesShareOneBuffer) {
+  FramePool pool;
+  ASSERT_TRUE(pool.Configure(Rgba(8, 8), 1, 1));
+  FrameRef producer = pool.Acquire();
+  producer.data()[0] = 42;
+  producer.info().sequence = 9;
+
+  FrameRef texture = producer;
+  FrameRef snapshot = texture;
+  EXPECT_EQ(producer.use_count(), 3u);
+  EXPECT_EQ(snapshot.data(), producer.data());
+  EXPECT_EQ(snapshot.data()[0], 42);
+  EXPECT_EQ(snapshot.info().sequence, 9u);
+
+  producer.reset();
+  texture.reset();
+  EXPECT_EQ(snapshot.use_count(), 1u);
+  EXPECT_EQ(pool.Stats().in_use, 1u);
+  snapshot.reset();
+  EXPECT_EQ(pool.Stats().in_use, 0u);
+}
+
+TEST(FramePoolTest, SteadyStateRecyclesWithoutAllocating) {
+  FramePool pool;
+  ASSERT_TRUE(pool.Configure(Rgba(64, 48), 4, 4));
+  const uint64_t allocations = pool.Stats().allocations;
+  const uint8_t *first = nullptr;
+  {
+    FrameRef frame = pool.Acquire();
+    first = frame.data();
+  }
+  for (int i = 0; i < 1000; i++) {
+    FrameRef a = pool.Acquire();
+    FrameRef b = pool.Acquire();
+    ASSERT_TRUE(a && b);
+  }
+  FrameRef again = pool.Acquire();
+  EXPECT_EQ(again.data(), first) << "most recently released slab is reused";
+  EXPECT_EQ(pool.Stats().allocations, allocations);
+  EXPECT_EQ(pool.Stats().high_water, 2u);
+}
+
+TEST(FramePoolTest, GrowsToMaxThenReportsExhaustion) {
+  FramePool pool;
+  ASSERT_TRUE(pool.Configure(Rgba(4, 4), 1, 3));
+  FrameRef a = pool.Acquire();
+  FrameRef b = pool.Acquire();
+  FrameRef c = pool.Acquire();
+  FrameRef d = pool.Acquire();
+  EXPECT_TRUE(a && b && c);
+  EXPECT_FALSE(d);
+  const FramePoolStats stats = pool.Stats();
+  EXPECT_EQ(stats.slab_count, 3u);
+  EXPECT_EQ(stats.high_water, 3u);
+  EXPECT_EQ(stats.allocations, 3u);
+  EXPECT_EQ(stats.exhausted, 1u);
+  EXPECT_EQ(stats.slab_bytes, 4u * 4u * 4u);
+}
+
+TEST(FramePoolTest, ReconfigureKeepsOldFramesValid) {
+  FramePool pool;
+  ASSERT_TRUE(pool.Configure(Rgba(16, 16), 2, 2));
+  FrameRef old_frame = pool.Acquire();
+  old_frame.data()[0] = 7;
+
+  ASSERT_TRUE(pool.Configure(Rgba(32, 8), 2, 2));
+  EXPECT_EQ(old_frame.format(), Rgba(16, 16));
+  EXPECT_EQ(old_frame.data()[0], 7);
+  EXPECT_EQ(pool.Stats().in_use, 0u);
+
+  old_frame.reset();  // Freed, not recycled into the new format.
+  EXPECT_EQ(pool.Stats().slab_count, 2u);
+  FrameRef fresh = pool.Acquire();
+  EXPECT_EQ(fresh.format(), Rgba(32, 8));
+}
+
+TEST(FramePoolTest, HandlesOutliveThePool) {
+  FrameRef survivor;
+  {
+    auto pool = std::make_unique<FramePool>();
+    ASSERT_TRUE(pool->Configure(Rgba(10, 10), 2, 2));
+    survivor = pool->Acquire();
+    survivor.data()[399] = 1;
+  }
+  EXPECT_EQ(survivor.data()[399], 1);
+  survivor.reset();  // Must free the slab and the shared core cleanly.
+}
+
+TEST(FramePoolTest, ConcurrentProducersAndConsumers) {
+  FramePool pool;
+  ASSERT_TRUE(pool.Configure(Rgba(32, 32), 8, 8));
+  std::atomic<uint64_t> delivered{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&pool, &delivered] {
+      for (int i = 0; i < 20000; i++) {
+        FrameRef frame = pool.Acquire();
+        if (!frame) continue;
+        FrameRef shared = frame;
+        frame.reset();
+        shared.data()[0] = static_cast<uint8_t>(i);
+        delivered.fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+  }
+  for (auto &t : threads) t.join();
+  const FramePoolStats stats = pool.Stats();
+  EXPECT_EQ(stats.in_use, 0u);
+  EXPECT_LE(stats.high_water, 8u);
+  EXPECT_EQ(stats.allocations, 8u);
+  EXPECT_EQ(delivered.load() + stats.exhausted, 80000u);
+}
+
+}  // namespace
+}  // namespace uvc
@@ -0,0 +1,295 @@
+#include "frame_ring.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "frame_pool.h"
+
+namespace uvc {
+namespace {
+
+FrameFormat Format(PixelFormat pixel_format, uint32_t width, uint32_t height) {
+  FrameFormat format;
+  format.pixel_format = pixel_format;
+  format.width = width;
+  format.height = height;
+  return format;
+}
+
+FrameRingConfig Enabled(uint32_t slots) {
+  FrameRingConfig config;
+  config.enabled = true;
+  config.slots = slots;
+  return config;
+}
+
+// A frame whose every byte is the low byte of |sequence|, 30 fps apart.
+FrameRef Frame(FramePool &pool, uint64_t sequence) {
+  FrameRef frame = pool.Acquire();
+  std::memset(frame.data(), static_cast<int>(sequence & 0xff), frame.size());
+  frame.info().sequence = sequence;
+  frame.info().timestamp = static_cast<int64_t>(sequence) * 333333;
+  return frame;
+}
+
+class FrameRingTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(pool_.Configure(Format(PixelFormat::kRgba8, 16, 8), 2, 4));
+  }
+
+  FramePool pool_;
+};
+
+TEST_F(FrameRingTest, ReadersSeeTheLastSlotsWorthOfFrames) {
+  FrameRing ring;
+  EXPECT_FALSE(ring.Write(Frame(pool_, 0)));
+  ASSERT_TRUE(ring.Configure(Enabled(3), Format(PixelFormat::kRgba8, 16, 8)));
+  ASSERT_NE(ring.memory(), nullptr);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(ring.memory()) % 64, 0u);
+
+  FrameRingReader reader(ring.memory());
+  ASSERT_TRUE(reader.valid());
+  FrameRingFrame frame;
+  EXPECT_EQ(reader.ReadLatest(&frame), FrameRingRead::kEmpty);
+  for (uint64_t s = 10; s < 15; s++) EXPECT_TRUE(ring.Write(Frame(pool_, s)));
+
+  EXPECT_EQ(reader.written(), 5u);
+  EXPECT_EQ(reader.header().width, 16u);
+  EXPECT_EQ(reader.header().stride, 64u);
+  EXPECT_EQ(reader.Read(1, &frame), FrameRingRead::kOverwritten);
+  for (uint64_t i = 2; i < 5; i++) {
+    ASSERT_EQ(reader.Read(i, &frame), FrameRingRead::kOk);
+    EXPECT_EQ(frame.frame, i);
+    EXPECT_EQ(frame.sequence, 10 + i);
+    EXPECT_EQ(frame.timestamp, static_cast<int64_t>(10 + i) * 333333);
+    EXPECT_EQ(frame.pixels, std::vector<uint8_t>(16 * 8 * 4, 10 + i));
+  }
+  EXPECT_EQ(reader.Read(5, &frame), FrameRingRead::kEmpty);
+  ASSERT_EQ(reader.ReadLatest(&frame), FrameRingRead::kOk);
+  EXPECT_EQ(frame.sequence, 14u);
+  // Frames of another size are not written.
+  FramePool other;
+  ASSERT_TRUE(other.Configure(Format(PixelFormat::kRgba8, 8, 8), 1, 1));
+  EXPECT_FALSE(ring.Write(Frame(other, 20)));
+}
+
+TEST_F(FrameRingTest, CReaderCopiesIntoTheCallersBuffer) {
+  FrameRing ring;
+  ASSERT_TRUE(ring.Configure(Enabled(2), Format(PixelFormat::kRgba8, 16, 8)));
+  std::vector<uint8_t> pixels(16 * 8 * 4);
+  int64_t meta[3] = {-1, -1, -1};
+  EXPECT_EQ(UvcFrameRingRead(ring.memory(), 0, pixels.data(), pixels.size(),
+                             meta),
+            static_cast<int32_t>(FrameRingRead::kEmpty));
+  for (uint64_t s = 7; s < 10; s++) ASSERT_TRUE(ring.Write(Frame(pool_, s)));
+
+  ASSERT_EQ(UvcFrameRingRead(ring.memory(), 2, pixels.data(), pixels.size(),
+                             meta),
+            static_cast<int32_t>(FrameRingRead::kOk));
+  EXPECT_EQ(meta[0], 2);
+  EXPECT_EQ(meta[1], 9);
+  EXPECT_EQ(meta[2], 9 * 333333);
+  EXPECT_EQ(pixels, std::vector<uint8_t>(pixels.size(), 9));
+  EXPECT_EQ(UvcFrameRingRead(ring.memory(), 0, pixels.data(), pixels.size(),
+                             meta),
+            static_cast<int32_t>(FrameRingRead::kOverwritten));
+  // A buffer that cannot hold the frame is refused.
+  EXPECT_EQ(UvcFrameRingRead(ring.memory(), 2, pixels.data(),
+                             pixels.size() - 1, meta),
+            static_cast<int32_t>(FrameRingRead::kInvalid));
+}
+
+TEST_F(FrameRingTest, ConcurrentReaderNeverSeesATornFrame) {
+  FrameRing ring;
+  ASSERT_TRUE(ring.Configure(Enabled(2), Format(PixelFormat::kRgba8, 16, 8)));
+  // The writer keeps overwriting both slots until the reader has checked
+  // enough frames, however the two threads get scheduled.
+  std::atomic<bool> done{false};
+  std::atomic<uint64_t> last_written{0};
+  std::thread writer([&] {
+    for (uint64_t s = 0; !done; s++) {
+      ring.Write(Frame(pool_, s));
+      last_written = s;
+    }
+  });
+
+  FrameRingReader reader(ring.memory());
+  FrameRingFrame frame;
+  uint64_t consistent = 0;
+  uint64_t last = 0;
+  while (consistent < 2000) {
+    if (reader.ReadLatest(&frame) != FrameRingRead::kOk) continue;
+    consistent++;
+    ASSERT_EQ(frame.pixels,
+              std::vector<uint8_t>(frame.pixels.size(), frame.sequence & 0xff));
+    ASSERT_GE(frame.sequence, last);
+    last = frame.sequence;
+  }
+  done = true;
+  writer.join();
+  ASSERT_EQ(reader.ReadLatest(&frame), FrameRingRead::kOk);
+  EXPECT_EQ(frame.sequence, last_written.load());
+}
+
+TEST_F(FrameRingTest, DecimatesByCountAndRate) {
+  FrameRing ring;
+  FrameRingConfig config = Enabled(4);
+  config.every_nth = 3;
+  ASSERT_TRUE(ring.Configure(config, Format(PixelFormat::kRgba8, 16, 8)));
+  std::vector<uint64_t> written;
+  for (uint64_t s = 0; s < 9; s++) {
+    if (ring.Write(Frame(pool_, s))) written.push_back(s);
+  }
+  EXPECT_EQ(written, (std::vector<uint64_t>{0, 3, 6}));
+
+  // 30 fps in, at most 10 out.
+  ring.SetDecimation(1, 10.0);
+  written.clear();
+  for (uint64_t s = 9; s < 21; s++) {
+    if (ring.Write(Frame(pool_, s))) written.push_back(s);
+  }
+  EXPECT_EQ(written, (std::vector<uint64_t>{9, 12, 15, 18}));
+
+  // A gap restarts the cadence instead of letting frames through to catch
+  // up.
+  written.clear();
+  for (uint64_t s : {40, 41, 42, 43}) {
+    if (ring.Write(Frame(pool_, s))) written.push_back(s);
+  }
+  EXPECT_EQ(written, (std::vector<uint64_t>{40, 43}));
+}
+
+TEST_F(FrameRingTest, DownscalesRgbaAndCounts) {
+  FrameRing ring;
+  FrameRingConfig config = Enabled(2);
+  config.downscale = 2;
+  ASSERT_TRUE(ring.Configure(config, Format(PixelFormat::kRgba8, 16, 8)));
+  FrameRef rgba = pool_.Acquire();
+  for (size_t i = 0; i < rgba.size(); i++) {
+    const size_t x = (i / 4) % 16;
+    const size_t y = i / 64;
+    rgba.data()[i] = static_cast<uint8_t>(10 * (i % 4) + x + y % 2 + y / 2);
+  }
+  ASSERT_TRUE(ring.Write(rgba));
+  FrameRingReader reader(ring.memory());
+  EXPECT_EQ(reader.header().width, 8u);
+  EXPECT_EQ(reader.header().height, 4u);
+  FrameRingFrame frame;
+  ASSERT_EQ(reader.ReadLatest(&frame), FrameRingRead::kOk);
+  ASSERT_EQ(frame.pixels.size(), 8u * 4u * 4u);
+  for (size_t by = 0; by < 4; by++) {
+    for (size_t bx = 0; bx < 8; bx++) {
+      for (size_t c = 0; c < 4; c++) {
+        // 10c + (2bx + 2bx + 1) / 2 + (0 + 1) / 2 + by, rounded.
+        EXPECT_EQ(frame.pixels[(by * 8 + bx) * 4 + c],
+                  10 * c + 2 * bx + by + 1)
+            << bx << "," << by << "," << c;
+      }
+    }
+  }
+
+  FramePool raw_pool;
+  const FrameFormat raw = Format(PixelFormat::kGray16, 8, 8);
+  ASSERT_TRUE(raw_pool.Configure(raw, 1, 1));
+  config.downscale = 4;
+  ASSERT_TRUE(ring.Configure(config, raw));
+  FrameRef counts = raw_pool.Acquire();
+  uint16_t *values = reinterpret_cast<uint16_t *>(counts.data());
+  for (size_t i = 0; i < 64; i++) values[i] = static_cast<uint16_t>(60000 + i);
+  ASSERT_TRUE(ring.Write(counts));
+  FrameRingReader raw_reader(ring.memory());
+  EXPECT_EQ(raw_reader.header().pixel_format,
+            static_cast<uint32_t>(PixelFormat::kGray16));
+  ASSERT_EQ(raw_reader.ReadLatest(&frame), FrameRingRead::kOk);
+  uint16_t out[4];
+  ASSERT_EQ(frame.pixels.size(), sizeof(out));
+  std::memcpy(out, frame.pixels.data(), sizeof(out));
+  // The mean of rows 0-3, columns 0-3 is 60000 + 1.5 * 8 + 1.5, and so on.
+  EXPECT_EQ(out[0], 60014);
+  EXPECT_EQ(out[1], 60018);
+  EXPECT_EQ(out[2], 60046);
+  EXPECT_EQ(out[3], 60050);
+}
+
+TEST_F(FrameRingTest, ReconfiguringKeepsOrRetiresTheRing) {
+  FrameRing ring;
+  const FrameFormat format = Format(PixelFormat::kRgba8, 16, 8);
+  ASSERT_TRUE(ring.Configure(Enabled(3), format));
+  const uint8_t *first = ring.memory();
+  ASSERT_TRUE(ring.Write(Frame(pool_, 1)));
+
+  // Restarting with the same layout keeps the ring and its count.
+  ring.Close();
+  FrameRingReader reader(first);
+  EXPECT_TRUE(reader.closed());
+  EXPECT_EQ(ring.memory(), nullptr);
+  ASSERT_TRUE(ring.Configure(Enabled(3), format));
+  EXPECT_EQ(ring.memory(), first);
+  EXPECT_FALSE(reader.closed());
+  EXPECT_EQ(reader.written(), 1u);
+
+  // Another layout gets a new ring; the old one stays readable, closed.
+  ASSERT_TRUE(ring.Configure(Enabled(5), format));
+  EXPECT_NE(ring.memory(), first);
+  EXPECT_TRUE(reader.closed());
+  FrameRingFrame frame;
+  EXPECT_EQ(reader.ReadLatest(&frame), FrameRingRead::kOk);
+
+  FrameRingConfig bad = Enabled(3);
+  bad.downscale = 3;
+  EXPECT_FALSE(ring.Configure(bad, format));
+  EXPECT_EQ(ring.memory(), nullptr);
+  EXPECT_FALSE(ring.Configure(FrameRingConfig(), format));
+  EXPECT_FALSE(ring.Configure(Enabled(FrameRing::kMaxSlots + 1), format));
+  const char junk[64] = "UVCRINK";
+  EXPECT_FALSE(
+      FrameRingReader(reinterpret_cast<const uint8_t *>(junk)).valid());
+}
+
+TEST_F(FrameRingTest, ReconfiguringReusesRetiredBlocks) {
+  FrameRing ring;
+  const FrameFormat format = Format(PixelFormat::kRgba8, 16, 8);
+  ASSERT_TRUE(ring.Configure(Enabled(3), format));
+  const uint8_t *small = ring.memory();
+  ASSERT_TRUE(ring.Configure(Enabled(5), format));
+  const uint8_t *large = ring.memory();
+
+  // Switching back and forth lays each ring out in the block retired the
+  // time before, leaving the one just closed readable.
+  for (int round = 0; round < 20; round++) {
+    const bool odd = round % 2 != 0;
+    const uint8_t *closed = ring.memory();
+    ASSERT_TRUE(ring.Configure(Enabled(odd ? 5 : 3), format));
+    EXPECT_EQ(ring.memory(), odd ? large : small);
+    EXPECT_EQ(ring.block_count(), 2u);
+    ASSERT_TRUE(ring.Write(Frame(pool_, round)));
+    FrameRingReader reader(ring.memory());
+    EXPECT_EQ(reader.written(), 1u);
+    EXPECT_EQ(reader.header().slot_count, odd ? 5u : 3u);
+    EXPECT_TRUE(FrameRingReader(closed).closed());
+  }
+
+  // A smaller ring fits in a retired block...
+  ASSERT_TRUE(ring.Configure(Enabled(2), format));
+  EXPECT_EQ(ring.memory(), small);
+  EXPECT_EQ(ring.size(), FrameRingReader(small).header().slots_offset +
+                             3u * FrameRingReader(small).header().slot_bytes);
+  // ...and growing past every block frees the least recently used beyond
+  // kMaxBlocks.
+  for (uint32_t slots = 6; slots <= 20; slots++) {
+    const uint8_t *closed = ring.memory();
+    ASSERT_TRUE(ring.Configure(Enabled(slots), format));
+    EXPECT_LE(ring.block_count(), FrameRing::kMaxBlocks);
+    EXPECT_TRUE(FrameRingReader(closed).closed());
+    ASSERT_TRUE(ring.Write(Frame(pool_, slots)));
+  }
+}
+
+}  // namespace
+}  // namespace uvc
@@ -0,0 +1,339 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "replay_source.h"
+#include "synthetic_source.h"
+#include "test_temp_path.h"
+#include "virtual_camera.h"
+
+namespace uvc {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+SyntheticConfig SmallConfig() {
+  SyntheticConfig config;
+  config.width = 64;
+  config.height = 48;
+  config.fps = 0;
+  return config;
+}
+
+// The steady clock in SourceFrame::timestamp units.
+int64_t Now100ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             Clock::now().time_since_epoch())
+             .count() /
+         100;
+}
+
+const uint16_t *Counts(const SourceFrame &frame) {
+  return reinterpret_cast<const uint16_t *>(frame.data);
+}
+
+TEST(SyntheticSourceTest, CountsStayWithinBitDepth) {
+  for (int bits : {8, 12, 14, 16}) {
+    SyntheticConfig config = SmallConfig();
+    config.bit_depth = bits;
+    config.noise = 1u << (bits - 4);
+    SyntheticSource source(config);
+    ASSERT_TRUE(source.Start());
+    EXPECT_EQ(source.mode().format, SourcePixelFormat::kGray16);
+    EXPECT_EQ(source.mode().bit_depth, bits);
+
+    SourceFrame frame;
+    ASSERT_EQ(source.Next(0, &frame), SourceStatus::kFrame);
+    EXPECT_EQ(frame.stride, 64 * 2);
+    uint32_t max = 0;
+    for (size_t i = 0; i < 64 * 48; i++) {
+      max = std::max<uint32_t>(max, Counts(frame)[i]);
+    }
+    EXPECT_LT(max, 1u << bits) << bits;
+    EXPECT_GT(max, 1u << (bits - 2)) << bits;
+  }
+}
+
+TEST(SyntheticSourceTest, FramesAreDeterministicAndMoving) {
+  SyntheticSource a(SmallConfig());
+  SyntheticSource b(SmallConfig());
+  ASSERT_TRUE(a.Start());
+  ASSERT_TRUE(b.Start());
+  SourceFrame fa, fb;
+  ASSERT_EQ(a.Next(0, &fa), SourceStatus::kFrame);
+  ASSERT_EQ(b.Next(0, &fb), SourceStatus::kFrame);
+  EXPECT_EQ(std::memcmp(fa.data, fb.data, 64 * 48 * 2), 0);
+
+  const std::vector<uint16_t> first(Counts(fa), Counts(fa) + 64 * 48);
+  ASSERT_EQ(a.Next(0, &fa), SourceStatus::kFrame);
+  EXPECT_EQ(fa.sequence, 1u);
+  EXPECT_NE(std::memcmp(first.data(), fa.data, first.size() * 2), 0);
+}
+
+TEST(SyntheticSourceTest, ColourFormats) {
+  SyntheticConfig config = SmallConfig();
+  config.format = SourcePixelFormat::kBgra32;
+  config.bit_depth = 14;  // Ignored for colour output.
+  SyntheticSource bgra(config);
+  EXPECT_EQ(bgra.mode().bit_depth, 8);
+  ASSERT_TRUE(bgra.Start());
+  SourceFrame frame;
+  ASSERT_EQ(bgra.Next(0, &frame), SourceStatus::kFrame);
+  EXPECT_EQ(frame.stride, 64 * 4);
+  EXPECT_EQ(frame.data[3], 0xFF);
+  EXPECT_EQ(frame.data[0], frame.data[2]);
+
+  config.format = SourcePixelFormat::kYuyv;
+  SyntheticSource yuyv(config);
+  ASSERT_TRUE(yuyv.Start());
+  ASSERT_EQ(yuyv.Next(0, &frame), SourceStatus::kFrame);
+  EXPECT_EQ(frame.stride, 64 * 2);
+  EXPECT_GE(frame.data[0], 16);
+  EXPECT_LE(frame.data[0], 235);
+  EXPECT_EQ(frame.data[1], 128);
+
+  config.format = SourcePixelFormat::kUyvy;
+  SyntheticSource uyvy(config);
+  ASSERT_TRUE(uyvy.Start());
+  ASSERT_EQ(uyvy.Next(0, &frame), SourceStatus::kFrame);
+  EXPECT_EQ(frame.stride, 64 * 2);
+  EXPECT_EQ(frame.data[0], 128);
+  EXPECT_GE(frame.data[1], 16);
+  EXPECT_LE(frame.data[1], 235);
+
+  config.format = SourcePixelFormat::kNv12;
+  config.height = 47;
+  SyntheticSource nv12(config);
+  EXPECT_EQ(nv12.mode().height, 46u);
+  ASSERT_TRUE(nv12.Start());
+  ASSERT_EQ(nv12.Next(0, &frame), SourceStatus::kFrame);
+  EXPECT_EQ(frame.stride, 64);
+  EXPECT_GE(frame.data[0], 16);
+  EXPECT_LE(frame.data[0], 235);
+  // The UV plane follows the last Y row.
+  EXPECT_EQ(frame.data[64 * 46], 128);
+  EXPECT_EQ(frame.data[64 * 46 + 64 * 23 - 1], 128);
+}
+
+TEST(SyntheticSourceTest, PacesFramesAndTimestampsThem) {
+  SyntheticConfig config = SmallConfig();
+  config.fps = 200;
+  SyntheticSource source(config);
+  ASSERT_TRUE(source.Start());
+  SourceFrame frame;
+  ASSERT_EQ(source.Next(1000, &frame), SourceStatus::kFrame);
+  const uint64_t first_sequence = frame.sequence;
+  const int64_t first_timestamp = frame.timestamp;
+  for (int i = 1; i < 10; i++) {
+    ASSERT_EQ(source.Next(1000, &frame), SourceStatus::kFrame);
+    // Stamped with the due time: whole 5 ms periods after the first frame,
+    // however late this process got to it, and never delivered early.
+    EXPECT_EQ(frame.timestamp - first_timestamp,
+              static_cast<int64_t>(frame.sequence - first_sequence) * 50000);
+    EXPECT_GE(Now100ns(), frame.timestamp);
+  }
+  EXPECT_GE(frame.sequence - first_sequence, 9u);
+  // A short timeout expires before the next frame is due. Only checkable if
+  // the call returned before that; a frame returned instead proves it was.
+  const SourceStatus status = source.Next(0, &frame);
+  if (Now100ns() < first_timestamp + static_cast<int64_t>(
+                                         frame.sequence - first_sequence + 1) *
+                                         50000) {
+    EXPECT_EQ(status, SourceStatus::kTimeout);
+  }
+}
+
+TEST(SyntheticSourceTest, SlowConsumerSeesSequenceGaps) {
+  SyntheticConfig config = SmallConfig();
+  config.fps = 1000;
+  SyntheticSource source(config);
+  ASSERT_TRUE(source.Start());
+  SourceFrame frame;
+  ASSERT_EQ(source.Next(1000, &frame), SourceStatus::kFrame);
+  const uint64_t first_sequence = frame.sequence;
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ASSERT_EQ(source.Next(1000, &frame), SourceStatus::kFrame);
+  EXPECT_GE(frame.sequence - first_sequence, 15u);
+}
+
+TEST(SyntheticSourceTest, InterruptWakesBlockedNext) {
+  SyntheticConfig config = SmallConfig();
+  config.fps = 1;
+  SyntheticSource source(config);
+  ASSERT_TRUE(source.Start());
+  SourceFrame frame;
+  ASSERT_EQ(source.Next(-1, &frame), SourceStatus::kFrame);
+
+  std::thread waker([&source] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    source.Interrupt();
+  });
+  const auto start = Clock::now();
+  EXPECT_EQ(source.Next(-1, &frame), SourceStatus::kInterrupted);
+  EXPECT_LT(Clock::now() - start, std::chrono::milliseconds(500));
+  waker.join();
+
+  // An interrupt before Next() is not lost either.
+  source.Interrupt();
+  EXPECT_EQ(source.Next(-1, &frame), SourceStatus::kInterrupted);
+}
+
+class ReplaySourceTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = TestTempPath(".uvcrec");
+  }
+  void TearDown() override { std::remove(path_.c_str()); }
+
+  // Records |frames| synthetic frames.
+  void Record(int frames) {
+    SyntheticConfig config = SmallConfig();
+    config.fps = 30;
+    SyntheticSource source(config);
+    ASSERT_TRUE(source.Start());
+    RecordingWriter writer;
+    ASSERT_TRUE(writer.Open(path_, source.mode()));
+    SourceFrame frame;
+    for (int i = 0; i < frames; i++) {
+      // Unpaced in the test; the recording still says 30 fps.
+      ASSERT_NE(source.Next(1000, &frame), SourceStatus::kError);
+      ASSERT_TRUE(writer.Append(frame.data, frame.stride));
+      recorded_.emplace_back(Counts(frame), Counts(frame) + 64 * 48);
+    }
+    EXPECT_EQ(writer.frame_count(), static_cast<uint64_t>(frames));
+    ASSERT_TRUE(writer.Close());
+  }
+
+  std::string path_;
+  std::vector<std::vector<uint16_t>> recorded_;
+};
+
+TEST_F(ReplaySourceTest, RoundTripsFramesAndMode) {
+  Record(3);
+  ReplaySource replay(path_, 0, false);
+  ASSERT_TRUE(replay.Open());
+  EXPECT_EQ(replay.frame_count(), 3u);
+  const SourceMode mode = replay.mode();
+  EXPECT_EQ(mode.format, SourcePixelFormat::kGray16);
+  EXPECT_EQ(mode.width, 64u);
+  EXPECT_EQ(mode.height, 48u);
+  EXPECT_EQ(mode.bit_depth, 14);
+  EXPECT_EQ(mode.fps_numerator, 30u);
+
+  ReplaySource unpaced(path_, 0, false);
+  ASSERT_TRUE(unpaced.Open());
+  ASSERT_TRUE(unpaced.Start());
+  SourceFrame frame;
+  for (size_t i = 0; i < 3; i++) {
+    ASSERT_EQ(unpaced.Next(1000, &frame), SourceStatus::kFrame);
+    EXPECT_EQ(std::memcmp(frame.data, recorded_[i].data(), 64 * 48 * 2), 0)
+        << i;
+  }
+  EXPECT_EQ(unpaced.Next(1000, &frame), SourceStatus::kEnd);
+}
+
+TEST_F(ReplaySourceTest, LoopsAndOverridesRate) {
+  Record(2);
+  ReplaySource replay(path_, 1000, true);
+  ASSERT_TRUE(replay.Start());
+  EXPECT_EQ(replay.mode().fps_numerator, 1000u);
+  SourceFrame frame;
+  for (int i = 0; i < 5; i++) {
+    ASSERT_EQ(replay.Next(1000, &frame), SourceStatus::kFrame);
+    EXPECT_EQ(frame.index, frame.sequence % 2);
+    EXPECT_EQ(std::memcmp(frame.data, recorded_[frame.index].data(),
+                          64 * 48 * 2),
+              0);
+  }
+}
+
+TEST_F(ReplaySourceTest, RoundTripsNv12Planes) {
+  SyntheticConfig config = SmallConfig();
+  config.format = SourcePixelFormat::kNv12;
+  SyntheticSource source(config);
+  ASSERT_TRUE(source.Start());
+  RecordingWriter writer;
+  ASSERT_TRUE(writer.Open(path_, source.mode()));
+  SourceFrame frame;
+  ASSERT_EQ(source.Next(1000, &frame), SourceStatus::kFrame);
+  const std::vector<uint8_t> recorded(frame.data, frame.data + 64 * 72);
+  ASSERT_TRUE(writer.Append(frame.data, frame.stride));
+  ASSERT_TRUE(writer.Close());
+
+  ReplaySource replay(path_, 0, false);
+  ASSERT_TRUE(replay.Start());
+  EXPECT_EQ(replay.mode().format, SourcePixelFormat::kNv12);
+  EXPECT_EQ(replay.frame_count(), 1u);
+  ASSERT_EQ(replay.Next(1000, &frame), SourceStatus::kFrame);
+  EXPECT_EQ(frame.stride, 64);
+  EXPECT_EQ(std::memcmp(frame.data, recorded.data(), recorded.size()), 0);
+}
+
+TEST_F(ReplaySourceTest, RejectsOtherFiles) {
+  std::FILE *file = std::fopen(path_.c_str(), "wb");
+  ASSERT_NE(file, nullptr);
+  std::fputs("not a recording, but long enough to hold a header.", file);
+  std::fclose(file);
+  ReplaySource replay(path_, 0, true);
+  EXPECT_FALSE(replay.Open());
+  EXPECT_FALSE(replay.Start());
+  ReplaySource missing(path_ + ".missing", 0, true);
+  EXPECT_FALSE(missing.Start());
+}
+
+TEST(VirtualCameraTest, ParsesSyntheticSpecs) {
+  VirtualCameraSpec spec;
+  ASSERT_TRUE(ParseVirtualCameraSpec(
+      "synthetic:320x256,bits=12,fps=1000,noise=4,spots=1", &spec));
+  EXPECT_EQ(spec.kind, VirtualCameraSpec::Kind::kSynthetic);
+  EXPECT_EQ(spec.synthetic.width, 320u);
+  EXPECT_EQ(spec.synthetic.height, 256u);
+  EXPECT_EQ(spec.synthetic.bit_depth, 12);
+  EXPECT_EQ(spec.synthetic.fps, 1000u);
+  EXPECT_EQ(spec.synthetic.noise, 4u);
+  EXPECT_EQ(spec.synthetic.hot_spots, 1);
+  EXPECT_EQ(VirtualCameraName(spec), "Synthetic 320x256 Y12 @ 1000 fps");
+
+  ASSERT_TRUE(ParseVirtualCameraSpec("synthetic", &spec));
+  EXPECT_EQ(spec.synthetic.width, 640u);
+  ASSERT_TRUE(ParseVirtualCameraSpec("synthetic:format=yuyv,fps=0", &spec));
+  EXPECT_EQ(VirtualCameraName(spec), "Synthetic 640x512 YUYV unpaced");
+
+  EXPECT_FALSE(ParseVirtualCameraSpec("synthetic:fps=1001", &spec));
+  EXPECT_FALSE(ParseVirtualCameraSpec("synthetic:bits=20", &spec));
+  EXPECT_FALSE(ParseVirtualCameraSpec("synthetic:fps=1,640x512", &spec));
+  EXPECT_FALSE(ParseVirtualCameraSpec("synthetic:colour=red", &spec));
+  EXPECT_FALSE(ParseVirtualCameraSpec("webcam", &spec));
+}
+
+TEST(VirtualCameraTest, ParsesReplaySpecsAndLists) {
+  VirtualCameraSpec spec;
+  ASSERT_TRUE(ParseVirtualCameraSpec("replay:C:\\rec\\a.uvcrec,loop=0", &spec));
+  EXPECT_EQ(spec.kind, VirtualCameraSpec::Kind::kReplay);
+  EXPECT_EQ(spec.path, "C:\\rec\\a.uvcrec");
+  EXPECT_FALSE(spec.loop);
+  EXPECT_EQ(VirtualCameraName(spec), "Replay a.uvcrec");
+  EXPECT_FALSE(ParseVirtualCameraSpec("replay:", &spec));
+
+  const std::vector<VirtualCameraSpec> list = ParseVirtualCameraList(
+      "synthetic:160x120;;bogus;replay:/tmp/b.uvcrec,fps=5");
+  ASSERT_EQ(list.size(), 2u);
+  EXPECT_EQ(list[0].synthetic.width, 160u);
+  EXPECT_EQ(list[1].path, "/tmp/b.uvcrec");
+  EXPECT_EQ(list[1].fps, 5u);
+
+  EXPECT_EQ(CreateVirtualCamera(list[1]), nullptr);  // No such file.
+  std::unique_ptr<FrameSource> synthetic = CreateVirtualCamera(list[0]);
+  ASSERT_NE(synthetic, nullptr);
+  EXPECT_EQ(synthetic->mode().width, 160u);
+}
+
+}  // namespace
+}  // namespace uvc
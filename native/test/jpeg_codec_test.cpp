@@ -0,0 +1,182 @@
+#include "jpeg_codec.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "pixel_convert.h"
+
+namespace uvc {
+namespace {
+
+// A smooth colour gradient, which JPEG reproduces closely.
+std::vector<uint8_t> Gradient(uint32_t width, uint32_t height) {
+  std::vector<uint8_t> rgba(width * height * 4);
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      uint8_t *p = &rgba[(y * width + x) * 4];
+      p[0] = static_cast<uint8_t>(x * 255 / (width - 1));
+      p[1] = static_cast<uint8_t>(y * 255 / (height - 1));
+      p[2] = static_cast<uint8_t>(255 - (x + y) * 255 / (width + height - 2));
+      p[3] = 255;
+    }
+  }
+  return rgba;
+}
+
+int MaxError(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b) {
+  int max_error = 0;
+  for (size_t i = 0; i < a.size(); i++) {
+    max_error = std::max(max_error, std::abs(a[i] - b[i]));
+  }
+  return max_error;
+}
+
+TEST(JpegCodecTest, ScaleCoversTheTarget) {
+  EXPECT_EQ(JpegScaleEighths(1920, 1080, 0, 0), 8);
+  EXPECT_EQ(JpegScaleEighths(1920, 1080, 640, 360), 3);
+  EXPECT_EQ(JpegScaleEighths(1920, 1080, 960, 540), 4);
+  EXPECT_EQ(JpegScaleEighths(1920, 1080, 961, 540), 5);
+  EXPECT_EQ(JpegScaleEighths(640, 480, 1280, 960), 8);
+  EXPECT_EQ(JpegScaledSize(1920, 3), 720u);
+  // libjpeg rounds up.
+  EXPECT_EQ(JpegScaledSize(1080, 3), 405u);
+  EXPECT_EQ(JpegScaledSize(1, 1), 1u);
+}
+
+TEST(JpegCodecTest, RoundTripsAtFullAndReducedScale) {
+  const std::vector<uint8_t> rgba = Gradient(64, 48);
+  std::vector<uint8_t> jpeg;
+  ASSERT_TRUE(EncodeJpeg(rgba.data(), 64 * 4, 64, 48, 95, &jpeg));
+
+  JpegDecoder decoder;
+  uint32_t width = 0, height = 0;
+  ASSERT_TRUE(decoder.ReadSize(jpeg.data(), jpeg.size(), &width, &height));
+  EXPECT_EQ(width, 64u);
+  EXPECT_EQ(height, 48u);
+
+  for (const bool fast : {false, true}) {
+    JpegDecodeOptions options;
+    options.fast = fast;
+    std::vector<uint8_t> decoded(rgba.size());
+    ASSERT_TRUE(decoder.Decode(jpeg.data(), jpeg.size(), options,
+                               decoded.data(), 64 * 4, 64, 48));
+    EXPECT_LE(MaxError(decoded, rgba), 16) << fast;
+  }
+
+  // Half size: compare with a 2x2 box filter of the source.
+  JpegDecodeOptions half;
+  half.target_width = 32;
+  half.target_height = 24;
+  std::vector<uint8_t> decoded(32 * 24 * 4);
+  ASSERT_TRUE(decoder.Decode(jpeg.data(), jpeg.size(), half, decoded.data(),
+                             32 * 4, 32, 24));
+  std::vector<uint8_t> expected(decoded.size());
+  for (uint32_t y = 0; y < 24; y++) {
+    for (uint32_t x = 0; x < 32; x++) {
+      for (int c = 0; c < 4; c++) {
+        int sum = 0;
+        for (int i = 0; i < 4; i++) {
+          sum += rgba[((2 * y + i / 2) * 64 + 2 * x + i % 2) * 4 + c];
+        }
+        expected[(y * 32 + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+      }
+    }
+  }
+  EXPECT_LE(MaxError(decoded, expected), 16);
+
+  // The caller's size must match the scaled output.
+  EXPECT_FALSE(decoder.Decode(jpeg.data(), jpeg.size(), half, decoded.data(),
+                              32 * 4, 32, 23));
+}
+
+TEST(JpegCodecTest, MapsRowsThroughTheCurve) {
+  const std::vector<uint8_t> rgba = Gradient(64, 48);
+  std::vector<uint8_t> jpeg;
+  ASSERT_TRUE(EncodeJpeg(rgba.data(), 64 * 4, 64, 48, 95, &jpeg));
+  uint8_t curve[256];
+  for (int i = 0; i < 256; i++) curve[i] = static_cast<uint8_t>(255 - i / 2);
+
+  JpegDecoder decoder;
+  JpegDecodeOptions options;
+  std::vector<uint8_t> expected(rgba.size());
+  ASSERT_TRUE(decoder.Decode(jpeg.data(), jpeg.size(), options,
+                             expected.data(), 64 * 4, 64, 48));
+  ApplyCurveToRgba(expected.data(), 64 * 4, 64, 48, curve);
+  options.curve = curve;
+  std::vector<uint8_t> toned(rgba.size());
+  ASSERT_TRUE(decoder.Decode(jpeg.data(), jpeg.size(), options, toned.data(),
+                             64 * 4, 64, 48));
+  EXPECT_EQ(toned, expected);
+}
+
+TEST(JpegCodecTest, DecodesFramesWithoutHuffmanTables) {
+  const std::vector<uint8_t> rgba = Gradient(32, 32);
+  std::vector<uint8_t> jpeg;
+  ASSERT_TRUE(EncodeJpeg(rgba.data(), 32 * 4, 32, 32, 90, &jpeg));
+  // Cut out the DHT segments, as UVC MJPEG cameras do.
+  std::vector<uint8_t> stripped(jpeg.begin(), jpeg.begin() + 2);
+  size_t i = 2;
+  while (i + 4 <= jpeg.size()) {
+    const uint8_t marker = jpeg[i + 1];
+    const size_t length = (jpeg[i + 2] << 8) | jpeg[i + 3];
+    if (marker == 0xDA) break;  // Scan data follows.
+    if (marker != 0xC4) {
+      stripped.insert(stripped.end(), jpeg.begin() + i,
+                      jpeg.begin() + i + 2 + length);
+    }
+    i += 2 + length;
+  }
+  ASSERT_LT(stripped.size() + (jpeg.size() - i), jpeg.size());
+  stripped.insert(stripped.end(), jpeg.begin() + i, jpeg.end());
+
+  JpegDecoder decoder;
+  std::vector<uint8_t> decoded(rgba.size());
+  ASSERT_TRUE(decoder.Decode(stripped.data(), stripped.size(),
+                             JpegDecodeOptions(), decoded.data(), 32 * 4, 32,
+                             32));
+  EXPECT_LE(MaxError(decoded, rgba), 24);
+}
+
+TEST(JpegCodecTest, RejectsOtherData) {
+  const std::vector<uint8_t> garbage(1000, 0x5A);
+  JpegDecoder decoder;
+  uint32_t width = 0, height = 0;
+  EXPECT_FALSE(
+      decoder.ReadSize(garbage.data(), garbage.size(), &width, &height));
+  std::vector<uint8_t> decoded(16 * 16 * 4);
+  EXPECT_FALSE(decoder.Decode(garbage.data(), garbage.size(),
+                              JpegDecodeOptions(), decoded.data(), 16 * 4, 16,
+                              16));
+
+  // The decoder recovers for the next frame.
+  const std::vector<uint8_t> rgba = Gradient(16, 16);
+  std::vector<uint8_t> jpeg;
+  ASSERT_TRUE(EncodeJpeg(rgba.data(), 16 * 4, 16, 16, 90, &jpeg));
+  EXPECT_TRUE(decoder.Decode(jpeg.data(), jpeg.size(), JpegDecodeOptions(),
+                             decoded.data(), 16 * 4, 16, 16));
+}
+
+TEST(JpegCodecTest, SplitsMjpegStreams) {
+  const std::vector<uint8_t> rgba = Gradient(16, 16);
+  std::vector<uint8_t> a, b;
+  ASSERT_TRUE(EncodeJpeg(rgba.data(), 16 * 4, 16, 16, 90, &a));
+  ASSERT_TRUE(EncodeJpeg(rgba.data(), 16 * 4, 16, 16, 50, &b));
+  std::vector<uint8_t> stream = {0x00, 0xFF, 0x12};  // Leading junk.
+  stream.insert(stream.end(), a.begin(), a.end());
+  stream.insert(stream.end(), b.begin(), b.end());
+  stream.insert(stream.end(), a.begin(), a.begin() + a.size() / 2);
+
+  const auto frames = SplitMjpegStream(stream.data(), stream.size());
+  ASSERT_EQ(frames.size(), 2u);
+  EXPECT_EQ(frames[0].first, 3u);
+  EXPECT_EQ(frames[0].second, a.size());
+  EXPECT_EQ(frames[1].first, 3u + a.size());
+  EXPECT_EQ(frames[1].second, b.size());
+}
+
+}  // namespace
+}  // namespace uvc
@@ -0,0 +1,89 @@
+#include "latest_frames.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+
+#include "frame_notifier.h"
+#include "frame_pool.h"
+#include "pipeline_stats.h"
+
+namespace uvc {
+namespace {
+
+FrameFormat Format(PixelFormat pixel_format) {
+  FrameFormat format;
+  format.pixel_format = pixel_format;
+  format.width = 8;
+  format.height = 4;
+  return format;
+}
+
+// The runners' capture step in miniature: the counts are corrected for
+// every frame, the display conversion only while the engine has copied the
+// last one.
+class LatestFramesTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(display_pool_.Configure(Format(PixelFormat::kRgba8), 2, 3));
+    // Few slabs, so counts the snapshot no longer holds must be released.
+    ASSERT_TRUE(raw_pool_.Configure(Format(PixelFormat::kGray16), 2, 2));
+  }
+
+  void Capture(uint64_t sequence) {
+    FrameRef raw = raw_pool_.Acquire();
+    ASSERT_TRUE(raw);
+    std::memset(raw.data(), static_cast<int>(sequence), raw.size());
+    raw.info().sequence = sequence;
+    if (skip_unconsumed_ && notifier_.Pending()) {
+      latest_.PublishCounts(std::move(raw));
+      return;
+    }
+    FrameRef frame = display_pool_.Acquire();
+    ASSERT_TRUE(frame);
+    frame.info().sequence = sequence;
+    latest_.Publish(std::move(frame), std::move(raw));
+    notifier_.Publish();
+  }
+
+  FramePool display_pool_;
+  FramePool raw_pool_;
+  FrameNotifier notifier_;
+  bool skip_unconsumed_ = true;
+  PipelineStats stats_;
+  LatestFrames latest_{&stats_};
+};
+
+TEST_F(LatestFramesTest, SnapshotsOfSkippedFramesGetTheNewestCounts) {
+  EXPECT_FALSE(latest_.frame());
+  EXPECT_FALSE(latest_.counts());
+  Capture(1);
+  ASSERT_TRUE(notifier_.Pending());
+  for (uint64_t s = 2; s <= 6; s++) Capture(s);
+
+  // The display frame waits for the engine; a tiff16 snapshot does not.
+  const FrameRef counts = latest_.counts();
+  ASSERT_TRUE(counts);
+  EXPECT_EQ(counts.info().sequence, 6u);
+  EXPECT_EQ(counts.data()[0], 6);
+  EXPECT_EQ(latest_.frame().info().sequence, 1u);
+
+  notifier_.Consume();
+  Capture(7);
+  EXPECT_EQ(latest_.frame().info().sequence, 7u);
+  EXPECT_EQ(latest_.counts().info().sequence, 7u);
+}
+
+TEST_F(LatestFramesTest, RecordsTheLockWait) {
+  Capture(1);
+  Capture(2);
+  PipelineStatsSnapshot snapshot;
+  stats_.Read(&snapshot);
+  EXPECT_EQ(
+      snapshot.stages[static_cast<size_t>(PipelineStage::kLockWait)].count,
+      2u);
+}
+
+}  // namespace
+}  // namespace uvc
@@ -0,0 +1,204 @@
+#include "mjpeg_pipeline.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace uvc {
+namespace {
+
+std::vector<uint8_t> EncodeTestFrame(uint32_t width, uint32_t height) {
+  std::vector<uint8_t> rgba(width * height * 4);
+  for (size_t i = 0; i < rgba.size(); i++) {
+    rgba[i] = static_cast<uint8_t>(i * 7);
+  }
+  std::vector<uint8_t> jpeg;
+  EncodeJpeg(rgba.data(), width * 4, width, height, 80, &jpeg);
+  return jpeg;
+}
+
+class MjpegPipelineTest : public ::testing::Test {
+ protected:
+  void Configure(uint32_t width, uint32_t height, size_t max_slabs) {
+    FrameFormat format;
+    format.width = width;
+    format.height = height;
+    ASSERT_TRUE(pool_.Configure(format, 2, max_slabs));
+  }
+
+  void Start(const MjpegPipelineOptions &options) {
+    ASSERT_TRUE(pipeline_.Start(options, &pool_, [this](FrameRef frame) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      frames_.push_back(std::move(frame));
+    }));
+  }
+
+  // Sequence numbers of the delivered frames.
+  std::vector<uint64_t> Delivered() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<uint64_t> sequences;
+    for (const FrameRef &frame : frames_) {
+      sequences.push_back(frame.info().sequence);
+    }
+    return sequences;
+  }
+
+  void Submit(const std::vector<uint8_t> &jpeg, uint64_t sequence,
+              const uint8_t *curve = nullptr) {
+    FrameInfo info;
+    info.sequence = sequence;
+    ASSERT_TRUE(pipeline_.Submit(jpeg.data(), jpeg.size(), info, curve));
+  }
+
+  FramePool pool_;
+  MjpegPipeline pipeline_;
+  std::mutex mutex_;
+  std::vector<FrameRef> frames_;
+};
+
+TEST_F(MjpegPipelineTest, DeliversEveryFrameInOrder) {
+  const std::vector<uint8_t> jpeg = EncodeTestFrame(64, 48);
+  Configure(64, 48, 200);
+  MjpegPipelineOptions options;
+  options.workers = 3;
+  options.max_queued = 100;
+  Start(options);
+  EXPECT_EQ(pipeline_.workers(), 3);
+  for (uint64_t i = 0; i < 100; i++) Submit(jpeg, i);
+  pipeline_.Flush();
+
+  std::vector<uint64_t> expected(100);
+  for (uint64_t i = 0; i < 100; i++) expected[i] = i;
+  EXPECT_EQ(Delivered(), expected);
+  const MjpegPipelineStats stats = pipeline_.Stats();
+  EXPECT_EQ(stats.submitted, 100u);
+  EXPECT_EQ(stats.decoded, 100u);
+  EXPECT_EQ(stats.dropped_stale, 0u);
+  EXPECT_EQ(frames_.back().format().width, 64u);
+}
+
+TEST_F(MjpegPipelineTest, TonesEachFrameWithItsOwnCurve) {
+  const std::vector<uint8_t> jpeg = EncodeTestFrame(64, 48);
+  Configure(64, 48, 8);
+  MjpegPipelineOptions options;
+  options.workers = 2;
+  options.max_queued = 4;
+  Start(options);
+  uint8_t curve[256];
+  for (int i = 0; i < 256; i++) curve[i] = static_cast<uint8_t>(255 - i);
+  Submit(jpeg, 0, curve);
+  // The pipeline keeps its own copy of the curve.
+  curve[0] = 0;
+  Submit(jpeg, 1);
+  pipeline_.Flush();
+
+  ASSERT_EQ(Delivered(), (std::vector<uint64_t>{0, 1}));
+  const uint8_t *toned = frames_[0].data();
+  const uint8_t *plain = frames_[1].data();
+  for (size_t i = 0; i < 64 * 48 * 4; i++) {
+    ASSERT_EQ(toned[i], i % 4 == 3 ? 255 : 255 - plain[i]) << i;
+  }
+}
+
+TEST_F(MjpegPipelineTest, DropsStaleFramesWhenDecodingFallsBehind) {
+  const std::vector<uint8_t> jpeg = EncodeTestFrame(256, 192);
+  Configure(256, 192, 300);
+  MjpegPipelineOptions options;
+  options.workers = 1;
+  options.max_queued = 1;
+  Start(options);
+  for (uint64_t i = 0; i < 200; i++) Submit(jpeg, i);
+  pipeline_.Flush();
+
+  const std::vector<uint64_t> delivered = Delivered();
+  ASSERT_FALSE(delivered.empty());
+  for (size_t i = 1; i < delivered.size(); i++) {
+    EXPECT_LT(delivered[i - 1], delivered[i]);
+  }
+  // Only older frames give way; the newest is always shown.
+  EXPECT_EQ(delivered.back(), 199u);
+  const MjpegPipelineStats stats = pipeline_.Stats();
+  EXPECT_GT(stats.dropped_stale, 0u);
+  EXPECT_EQ(stats.decoded + stats.dropped_stale, stats.submitted);
+  EXPECT_EQ(stats.decoded, delivered.size());
+}
+
+TEST_F(MjpegPipelineTest, DecodesDownscaledForSmallerTextures) {
+  const std::vector<uint8_t> jpeg = EncodeTestFrame(640, 480);
+  MjpegPipelineOptions options;
+  options.decode.target_width = 200;
+  options.decode.target_height = 150;
+  uint32_t width = 0, height = 0;
+  MjpegOutputSize(640, 480, options.decode, &width, &height);
+  EXPECT_EQ(width, 240u);
+  EXPECT_EQ(height, 180u);
+  Configure(width, height, 4);
+  Start(options);
+  Submit(jpeg, 1);
+  pipeline_.Flush();
+  ASSERT_EQ(frames_.size(), 1u);
+  EXPECT_EQ(frames_[0].format().width, 240u);
+  EXPECT_EQ(frames_[0].data()[3], 255);
+}
+
+TEST_F(MjpegPipelineTest, SkipsCorruptFramesAndKeepsOrder) {
+  const std::vector<uint8_t> jpeg = EncodeTestFrame(64, 48);
+  const std::vector<uint8_t> garbage(500, 0x42);
+  const std::vector<uint8_t> wrong_size = EncodeTestFrame(32, 32);
+  Configure(64, 48, 16);
+  MjpegPipelineOptions options;
+  options.workers = 2;
+  options.max_queued = 8;
+  Start(options);
+  Submit(jpeg, 0);
+  Submit(garbage, 1);
+  Submit(wrong_size, 2);
+  Submit(jpeg, 3);
+  pipeline_.Flush();
+  EXPECT_EQ(Delivered(), (std::vector<uint64_t>{0, 3}));
+  EXPECT_EQ(pipeline_.Stats().failed, 2u);
+}
+
+TEST_F(MjpegPipelineTest, DropsFramesWhenThePoolIsExhausted) {
+  const std::vector<uint8_t> jpeg = EncodeTestFrame(64, 48);
+  Configure(64, 48, 2);
+  MjpegPipelineOptions options;
+  options.workers = 1;
+  options.max_queued = 4;
+  Start(options);
+  // The callback keeps every frame, so the third finds no free slab.
+  for (uint64_t i = 0; i < 3; i++) Submit(jpeg, i);
+  pipeline_.Flush();
+  EXPECT_EQ(Delivered(), (std::vector<uint64_t>{0, 1}));
+  EXPECT_EQ(pipeline_.Stats().pool_exhausted, 1u);
+}
+
+TEST_F(MjpegPipelineTest, StopsAndRestarts) {
+  const std::vector<uint8_t> jpeg = EncodeTestFrame(64, 48);
+  Configure(64, 48, 64);
+  MjpegPipelineOptions options;
+  options.workers = 2;
+  options.max_queued = 16;
+  Start(options);
+  for (uint64_t i = 0; i < 16; i++) Submit(jpeg, i);
+  pipeline_.Stop();
+  EXPECT_FALSE(pipeline_.running());
+  FrameInfo info;
+  EXPECT_FALSE(pipeline_.Submit(jpeg.data(), jpeg.size(), info));
+  // Frames still queued are discarded.
+  const MjpegPipelineStats stopped = pipeline_.Stats();
+  EXPECT_EQ(stopped.submitted, 16u);
+  EXPECT_LE(stopped.decoded, 16u);
+  EXPECT_EQ(Delivered().size(), stopped.decoded);
+
+  frames_.clear();
+  Start(options);
+  Submit(jpeg, 100);
+  pipeline_.Flush();
+  EXPECT_EQ(Delivered(), (std::vector<uint64_t>{100}));
+}
+
+}  // namespace
+}  // namespace uvc
@@ -0,0 +1,351 @@
+#include "nuc.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#include "cpu_features.h"
+#include "nuc_tables.h"
+#include "test_temp_path.h"
+
+namespace uvc {
+namespace {
+
+constexpr uint32_t kWidth = 96;
+constexpr uint32_t kHeight = 64;
+
+std::vector<SimdLevel> SupportedLevels() {
+  std::vector<SimdLevel> levels = {SimdLevel::kScalar};
+  const SimdLevel detected = DetectSimdLevel();
+  if (detected == SimdLevel::kNeon) {
+    levels.push_back(SimdLevel::kNeon);
+  } else {
+    for (int l = 1; l <= static_cast<int>(detected); l++) {
+      levels.push_back(static_cast<SimdLevel>(l));
+    }
+  }
+  return levels;
+}
+
+// A sensor whose pixels respond to scene temperature |t| with their own
+// gain and offset, plus a few bright columns.
+class FixedPattern {
+ public:
+  FixedPattern() : gain_(kWidth * kHeight), offset_(kWidth * kHeight) {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> gain(0.8f, 1.2f);
+    std::uniform_real_distribution<float> offset(-300.0f, 300.0f);
+    for (size_t i = 0; i < gain_.size(); i++) {
+      gain_[i] = gain(rng);
+      offset_[i] = offset(rng) + (i % kWidth % 7 == 3 ? 200.0f : 0.0f);
+    }
+  }
+
+  std::vector<uint16_t> Frame(float t) const {
+    std::vector<uint16_t> frame(gain_.size());
+    for (size_t i = 0; i < frame.size(); i++) {
+      frame[i] = static_cast<uint16_t>(std::lround(gain_[i] * t + offset_[i]));
+    }
+    return frame;
+  }
+
+ private:
+  std::vector<float> gain_;
+  std::vector<float> offset_;
+};
+
+double StdDev(const std::vector<uint16_t> &frame) {
+  double sum = 0, squared = 0;
+  for (uint16_t v : frame) {
+    sum += v;
+    squared += static_cast<double>(v) * v;
+  }
+  const double mean = sum / frame.size();
+  return std::sqrt(std::max(squared / frame.size() - mean * mean, 0.0));
+}
+
+std::vector<float> ToFloat(const std::vector<uint16_t> &frame) {
+  return std::vector<float>(frame.begin(), frame.end());
+}
+
+NucConfig Enabled(bool shutterless) {
+  NucConfig config;
+  config.enabled = true;
+  config.shutterless = shutterless;
+  return config;
+}
+
+class NucTest : public ::testing::Test {
+ protected:
+  void TearDown() override {
+    SetMaxSimdLevel(SimdLevel::kNeon);
+    std::remove(path_.c_str());
+  }
+
+  std::string path_ = TestTempPath(".uvcnuc");
+};
+
+TEST_F(NucTest, TwoPointCalibrationFlattensTheFixedPattern) {
+  const FixedPattern sensor;
+  const std::vector<float> cold = ToFloat(sensor.Frame(4000));
+  const std::vector<float> hot = ToFloat(sensor.Frame(9000));
+  std::shared_ptr<const NucTables> tables =
+      ComputeTwoPointNuc(cold.data(), hot.data(), kWidth, kHeight);
+  ASSERT_NE(tables, nullptr);
+  EXPECT_EQ(ComputeTwoPointNuc(hot.data(), cold.data(), kWidth, kHeight),
+            nullptr);
+
+  NucEngine nuc;
+  nuc.SetConfig(Enabled(false));
+  nuc.SetTables(tables);
+  // A temperature between and one outside the references.
+  for (float t : {6000.0f, 11000.0f}) {
+    std::vector<uint16_t> frame = sensor.Frame(t);
+    EXPECT_GT(StdDev(frame), 100.0);
+    nuc.Process(frame.data(), kWidth, kWidth, kHeight);
+    EXPECT_LT(StdDev(frame), 1.0) << t;
+  }
+}
+
+TEST_F(NucTest, OnePointRefreshKeepsTheGains) {
+  const FixedPattern sensor;
+  const std::vector<float> cold = ToFloat(sensor.Frame(4000));
+  const std::vector<float> hot = ToFloat(sensor.Frame(9000));
+  std::shared_ptr<const NucTables> two_point =
+      ComputeTwoPointNuc(cold.data(), hot.data(), kWidth, kHeight);
+  // Every offset drifts by 50 counts; a flat field brings them back.
+  std::vector<uint16_t> flat = sensor.Frame(7000);
+  for (uint16_t &v : flat) v += 50;
+  const std::vector<float> flat_mean = ToFloat(flat);
+  std::shared_ptr<const NucTables> refreshed = ComputeOnePointNuc(
+      flat_mean.data(), two_point.get(), kWidth, kHeight);
+  ASSERT_NE(refreshed, nullptr);
+  for (size_t i = 0; i < kWidth * kHeight; i++) {
+    ASSERT_EQ(refreshed->gain()[i], two_point->gain()[i]);
+  }
+  NucEngine nuc;
+  nuc.SetConfig(Enabled(false));
+  nuc.SetTables(refreshed);
+  std::vector<uint16_t> frame = sensor.Frame(5000);
+  for (uint16_t &v : frame) v += 50;
+  nuc.Process(frame.data(), kWidth, kWidth, kHeight);
+  EXPECT_LT(StdDev(frame), 1.0);
+}
+
+TEST_F(NucTest, SimdLevelsMatchScalar) {
+  // Odd width: every kernel ends in its scalar tail.
+  constexpr uint32_t kOddWidth = 67;
+  constexpr uint32_t kRows = 5;
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<float> gain(0.25f, 4.0f);
+  std::uniform_real_distribution<float> offset(-20000.0f, 20000.0f);
+  std::uniform_int_distribution<int> count(0, 65535);
+  std::vector<float> gains(kOddWidth * kRows), offsets(kOddWidth * kRows);
+  std::vector<uint16_t> input(kOddWidth * kRows);
+  for (size_t i = 0; i < input.size(); i++) {
+    gains[i] = gain(rng);
+    offsets[i] = offset(rng);
+    input[i] = static_cast<uint16_t>(count(rng));
+  }
+  auto tables = std::make_shared<const NucTables>(kOddWidth, kRows, gains,
+                                                  offsets);
+
+  std::vector<uint16_t> reference;
+  for (SimdLevel level : SupportedLevels()) {
+    SetMaxSimdLevel(level);
+    NucEngine nuc(1);
+    nuc.SetConfig(Enabled(false));
+    nuc.SetTables(tables);
+    std::vector<uint16_t> frame = input;
+    nuc.Process(frame.data(), kOddWidth, kOddWidth, kRows);
+    if (level == SimdLevel::kScalar) {
+      reference = frame;
+      continue;
+    }
+    for (size_t i = 0; i < frame.size(); i++) {
+      // The scalar kernel may be compiled with fused multiply-adds.
+      ASSERT_LE(std::abs(frame[i] - reference[i]), 1)
+          << SimdLevelName(level) << " pixel " << i;
+    }
+  }
+}
+
+TEST_F(NucTest, SavedTablesMapBack) {
+  const FixedPattern sensor;
+  const std::vector<float> cold = ToFloat(sensor.Frame(4000));
+  const std::vector<float> hot = ToFloat(sensor.Frame(9000));
+  std::shared_ptr<const NucTables> tables =
+      ComputeTwoPointNuc(cold.data(), hot.data(), kWidth, kHeight);
+  ASSERT_TRUE(tables->Save(path_));
+
+  std::string error;
+  std::shared_ptr<const NucTables> mapped = NucTables::Map(path_, &error);
+  ASSERT_NE(mapped, nullptr) << error;
+  EXPECT_TRUE(mapped->mapped());
+  EXPECT_EQ(mapped->width(), kWidth);
+  EXPECT_EQ(mapped->height(), kHeight);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(mapped->gain()) % 64, 0u);
+  for (size_t i = 0; i < kWidth * kHeight; i++) {
+    ASSERT_EQ(mapped->gain()[i], tables->gain()[i]);
+    ASSERT_EQ(mapped->offset()[i], tables->offset()[i]);
+  }
+
+  // Cut off in the middle of the offsets.
+  std::ifstream in(path_, std::ios::binary);
+  std::vector<char> bytes((std::istreambuf_iterator<char>(in)),
+                          std::istreambuf_iterator<char>());
+  in.close();
+  bytes.resize(bytes.size() - 100);
+  std::ofstream(path_, std::ios::binary | std::ios::trunc)
+      .write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+  EXPECT_EQ(NucTables::Map(path_, &error), nullptr);
+  EXPECT_EQ(error, "INVALID_FILE: tables outside the file");
+  EXPECT_EQ(NucTables::Map(path_ + ".missing", &error), nullptr);
+
+  NucEngine nuc;
+  EXPECT_FALSE(nuc.LoadTables(path_, &error));
+  EXPECT_EQ(nuc.tables(), nullptr);
+}
+
+TEST_F(NucTest, CalibratesWhileFramesKeepComing) {
+  const FixedPattern sensor;
+  NucEngine nuc;
+  nuc.SetConfig(Enabled(false));
+  NucReference reference;
+  ASSERT_TRUE(ParseNucReference("cold", &reference));
+  EXPECT_FALSE(ParseNucReference("warm", &reference));
+
+  for (float t : {4000.0f, 9000.0f}) {
+    NucResult captured;
+    ASSERT_TRUE(nuc.CaptureReference(
+        t < 5000 ? NucReference::kCold : NucReference::kHot, 4, kWidth,
+        kHeight, [&](const NucResult &r) { captured = r; }));
+    EXPECT_FALSE(nuc.ComputeTables(path_, nullptr));
+    // Two frames more than the capture needs.
+    for (int i = 0; i < 6; i++) {
+      std::vector<uint16_t> frame = sensor.Frame(t);
+      nuc.Process(frame.data(), kWidth, kWidth, kHeight);
+    }
+    nuc.Flush();
+    ASSERT_TRUE(captured.ok) << captured.error;
+    EXPECT_EQ(captured.frames, 4u);
+    EXPECT_NEAR(captured.mean, t, t * 0.05);
+  }
+
+  NucResult computed;
+  ASSERT_TRUE(nuc.ComputeTables(path_,
+                                [&](const NucResult &r) { computed = r; }));
+  nuc.Flush();
+  ASSERT_TRUE(computed.ok) << computed.error;
+  EXPECT_TRUE(computed.two_point);
+  EXPECT_EQ(computed.path, path_);
+  ASSERT_NE(nuc.tables(), nullptr);
+  std::vector<uint16_t> frame = sensor.Frame(6000);
+  nuc.Process(frame.data(), kWidth, kWidth, kHeight);
+  EXPECT_LT(StdDev(frame), 1.0);
+
+  // The references were used up.
+  ASSERT_TRUE(nuc.ComputeTables("", [&](const NucResult &r) { computed = r; }));
+  nuc.Flush();
+  EXPECT_EQ(computed.error, "NO_REFERENCE");
+
+  // The saved tables start the next session without a calibration.
+  NucEngine next;
+  std::string error;
+  ASSERT_TRUE(next.LoadTables(path_, &error)) << error;
+  next.SetConfig(Enabled(false));
+  frame = sensor.Frame(6000);
+  next.Process(frame.data(), kWidth, kWidth, kHeight);
+  EXPECT_LT(StdDev(frame), 1.0);
+}
+
+TEST_F(NucTest, CaptureFailsWhenTheFramesStop) {
+  NucEngine nuc;
+  NucResult result;
+  ASSERT_TRUE(nuc.CaptureReference(NucReference::kCold, 4, kWidth, kHeight,
+                                   [&](const NucResult &r) { result = r; }));
+  std::vector<uint16_t> frame(kWidth * kHeight, 1000);
+  nuc.Process(frame.data(), kWidth, kWidth, kHeight);
+  // Frames of another size.
+  std::vector<uint16_t> small(32 * 16, 1000);
+  nuc.Process(small.data(), 32, 32, 16);
+  nuc.Flush();
+  EXPECT_FALSE(result.ok);
+  EXPECT_EQ(result.error, "SIZE_CHANGED");
+  EXPECT_EQ(result.frames, 1u);
+  // Disabled, so nothing was corrected.
+  EXPECT_EQ(frame, std::vector<uint16_t>(kWidth * kHeight, 1000));
+
+  ASSERT_TRUE(nuc.CaptureReference(NucReference::kHot, 4, kWidth, kHeight,
+                                   [&](const NucResult &r) { result = r; }));
+  nuc.Process(frame.data(), kWidth, kWidth, kHeight);
+  nuc.Reset();
+  nuc.Flush();
+  EXPECT_EQ(result.error, "CAPTURE_STOPPED");
+  EXPECT_FALSE(nuc.CaptureReference(NucReference::kHot, 0, kWidth, kHeight,
+                                    nullptr));
+}
+
+TEST_F(NucTest, ShutterlessUpdateRemovesColumnStripes) {
+  // A scene with a smooth gradient and a strong vertical edge, seen through
+  // column stripes the tables do not know about.
+  std::vector<uint16_t> scene(kWidth * kHeight);
+  std::vector<float> stripes(kWidth, 0.0f);
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<float> stripe(-20.0f, 20.0f);
+  for (float &s : stripes) s = stripe(rng);
+  for (uint32_t y = 0; y < kHeight; y++) {
+    for (uint32_t x = 0; x < kWidth; x++) {
+      scene[y * kWidth + x] =
+          static_cast<uint16_t>(5000 + 3 * x + y + (x >= 60 ? 2000 : 0));
+    }
+  }
+  auto striped = [&] {
+    std::vector<uint16_t> frame = scene;
+    for (size_t i = 0; i < frame.size(); i++) {
+      frame[i] = static_cast<uint16_t>(
+          std::lround(frame[i] + stripes[i % kWidth]));
+    }
+    return frame;
+  };
+  // Column error against the scene, less its moving average over nine
+  // columns: stripes, not shading.
+  auto column_error = [&](const std::vector<uint16_t> &frame) {
+    std::vector<double> columns(kWidth, 0.0);
+    for (size_t i = 0; i < frame.size(); i++) {
+      columns[i % kWidth] +=
+          (static_cast<double>(frame[i]) - scene[i]) / kHeight;
+    }
+    double worst = 0;
+    for (int x = 0; x < static_cast<int>(kWidth); x++) {
+      double local = 0;
+      int n = 0;
+      for (int k = std::max(x - 4, 0);
+           k <= std::min(x + 4, static_cast<int>(kWidth) - 1); k++, n++) {
+        local += columns[k];
+      }
+      worst = std::max(worst, std::fabs(columns[x] - local / n));
+    }
+    return worst;
+  };
+
+  NucEngine nuc;
+  nuc.SetConfig(Enabled(true));
+  nuc.SetTables(NucTables::Identity(kWidth, kHeight));
+  const double before = column_error(striped());
+  std::vector<uint16_t> frame;
+  for (int i = 0; i < 300; i++) {
+    frame = striped();
+    nuc.Process(frame.data(), kWidth, kWidth, kHeight);
+  }
+  EXPECT_GT(before, 15.0);
+  EXPECT_LT(column_error(frame), before / 4) << "before " << before;
+}
+
+}  // namespace
+}  // namespace uvc
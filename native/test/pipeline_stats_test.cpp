@@ -0,0 +1,139 @@
+#include "pipeline_stats.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+namespace uvc {
+namespace {
+
+constexpr size_t Stage(PipelineStage stage) {
+  return static_cast<size_t>(stage);
+}
+
+TEST(LatencyHistogramTest, BucketsKeepThreePercentPrecision) {
+  EXPECT_EQ(LatencyHistogram::BucketIndex(0), 0u);
+  EXPECT_EQ(LatencyHistogram::BucketIndex(31), 31u);
+  size_t previous = 0;
+  for (int64_t v = 1; v < LatencyHistogram::kMaxValue; v += 1 + v / 7) {
+    const size_t index = LatencyHistogram::BucketIndex(v);
+    ASSERT_LT(index, LatencyHistogram::kBucketCount);
+    ASSERT_GE(index, previous);
+    previous = index;
+    const int64_t upper = LatencyHistogram::BucketUpperBound(index);
+    ASSERT_GE(upper, v);
+    ASSERT_LE(upper - v, v / 32 + 1) << v;
+  }
+  EXPECT_EQ(LatencyHistogram::BucketIndex(int64_t{1} << 50),
+            LatencyHistogram::kBucketCount - 1);
+}
+
+TEST(LatencyHistogramTest, QuantilesOfUniformSamples) {
+  LatencyHistogram histogram;
+  for (int64_t v = 1; v <= 1000; v++) histogram.Record(v * 1000);
+  histogram.Record(-5);  // Dropped.
+  LatencyHistogram::Snapshot snapshot;
+  histogram.Read(&snapshot);
+  EXPECT_EQ(snapshot.count, 1000u);
+  EXPECT_NEAR(snapshot.Mean(), 500500.0, 1.0);
+  EXPECT_NEAR(static_cast<double>(snapshot.ValueAtQuantile(0.5)), 500000,
+              500000 / 32.0);
+  EXPECT_NEAR(static_cast<double>(snapshot.ValueAtQuantile(0.99)), 990000,
+              990000 / 32.0);
+  EXPECT_GE(snapshot.Max(), 1000000);
+  EXPECT_LE(snapshot.Max(), 1000000 + 1000000 / 32);
+
+  LatencyHistogram::Snapshot empty;
+  EXPECT_EQ(empty.ValueAtQuantile(0.5), 0);
+  EXPECT_EQ(empty.Mean(), 0.0);
+}
+
+TEST(PipelineStatsTest, CountsSequenceGapsAndPoolDrops) {
+  PipelineStats stats;
+  FrameInfo info;
+  for (uint64_t sequence : {10u, 11u, 14u, 15u}) {
+    info.sequence = sequence;
+    stats.OnFrameCaptured(info, SteadyNow100ns());
+  }
+  // A restarted stream begins at a new sequence without counting a gap.
+  stats.OnSourceRestarted();
+  info.sequence = 0;
+  stats.OnFrameCaptured(info, SteadyNow100ns());
+  stats.OnPoolExhausted();
+  stats.OnSkippedUnconsumed();
+  stats.OnNotified();
+
+  PipelineStatsSnapshot snapshot;
+  stats.Read(&snapshot);
+  EXPECT_EQ(snapshot.counters.captured, 5u);
+  EXPECT_EQ(snapshot.counters.dropped_source, 2u);
+  EXPECT_EQ(snapshot.counters.dropped_pool, 1u);
+  EXPECT_EQ(snapshot.counters.skipped_unconsumed, 1u);
+  EXPECT_EQ(snapshot.counters.notified, 1u);
+}
+
+TEST(PipelineStatsTest, RecordsLatenciesOnTheSteadyClock) {
+  PipelineStats stats;
+  const int64_t now = SteadyNow100ns();
+  FrameInfo info;
+  info.timestamp = now - 20000;  // Captured 2 ms ago.
+  stats.OnFrameCaptured(info, now);
+  FrameInfo other_clock;
+  other_clock.sequence = 1;
+  other_clock.timestamp = 5000;  // Rebased to the stream start: ignored.
+  stats.OnFrameCaptured(other_clock, now);
+
+  stats.Record(PipelineStage::kConvert, 300000);
+  info.published = now + 10000;
+  stats.OnPresented(true, info, now + 15000);
+  stats.OnPresented(false, info, now + 16000);
+
+  PipelineStatsSnapshot snapshot;
+  stats.Read(&snapshot);
+  const auto &capture = snapshot.stages[Stage(PipelineStage::kCapture)];
+  ASSERT_EQ(capture.count, 1u);
+  EXPECT_NEAR(static_cast<double>(capture.Max()), 2e6, 2e6 / 32);
+  EXPECT_EQ(snapshot.stages[Stage(PipelineStage::kConvert)].count, 1u);
+  const auto &present = snapshot.stages[Stage(PipelineStage::kPresent)];
+  EXPECT_NEAR(static_cast<double>(present.Max()), 5e5, 5e5 / 32);
+  const auto &end_to_end = snapshot.stages[Stage(PipelineStage::kEndToEnd)];
+  EXPECT_NEAR(static_cast<double>(end_to_end.Max()), 3.5e6, 3.5e6 / 32);
+  EXPECT_EQ(snapshot.counters.presented, 1u);
+  EXPECT_EQ(snapshot.counters.duplicated, 1u);
+}
+
+TEST(PipelineStatsTest, ResetStartsFromZeroAndRatesCoverTheInterval) {
+  PipelineStats stats;
+  FrameInfo info;
+  for (int i = 0; i < 10; i++) {
+    info.sequence = i;
+    stats.OnFrameCaptured(info, 0);
+    stats.Record(PipelineStage::kConvert, 1000);
+  }
+  stats.Reset();
+  PipelineStatsSnapshot snapshot;
+  stats.Read(&snapshot);
+  EXPECT_EQ(snapshot.counters.captured, 0u);
+  EXPECT_EQ(snapshot.stages[Stage(PipelineStage::kConvert)].count, 0u);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  for (int i = 10; i < 20; i++) {
+    info.sequence = i;
+    stats.OnFrameCaptured(info, 0);
+  }
+  stats.Read(&snapshot);
+  EXPECT_EQ(snapshot.counters.captured, 10u);
+  EXPECT_EQ(snapshot.counters.dropped_source, 0u);
+  EXPECT_GT(snapshot.interval_seconds, 0.015);
+  EXPECT_GT(snapshot.capture_fps, 0.0);
+  EXPECT_LT(snapshot.capture_fps, 10 / 0.015);
+}
+
+TEST(PipelineStatsTest, PipelineStageNames) {
+  EXPECT_STREQ(PipelineStageName(PipelineStage::kLockWait), "lockWait");
+  EXPECT_STREQ(PipelineStageName(PipelineStage::kEndToEnd), "endToEnd");
+}
+
+}  // namespace
+}  // namespace uvc
@@ -0,0 +1,192 @@
+#include "pixel_convert.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace uvc {
+namespace {
+
+// Byte-for-byte copy of the loop ReadSampleLoop used before the kernels
+// existed, kept as the reference every variant must match.
+void ReferenceBgraToRgba(const uint8_t *src, ptrdiff_t src_stride,
+                         uint8_t *dst, size_t width, size_t height) {
+  for (size_t y = 0; y < height; y++) {
+    for (size_t x = 0; x < width; x++) {
+      dst[x * 4 + 0] = src[x * 4 + 2];
+      dst[x * 4 + 1] = src[x * 4 + 1];
+      dst[x * 4 + 2] = src[x * 4 + 0];
+      dst[x * 4 + 3] = src[x * 4 + 3];
+    }
+    src += src_stride;
+    dst += width * 4;
+  }
+}
+
+std::vector<SimdLevel> SupportedLevels() {
+  std::vector<SimdLevel> levels = {SimdLevel::kScalar};
+  const SimdLevel detected = DetectSimdLevel();
+  if (detected == SimdLevel::kNeon) {
+    levels.push_back(SimdLevel::kNeon);
+  } else {
+    for (int l = 1; l <= static_cast<int>(detected); l++) {
+      levels.push_back(static_cast<SimdLevel>(l));
+    }
+  }
+  return levels;
+}
+
+std::vector<uint8_t> RandomBytes(size_t size, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::vector<uint8_t> bytes(size);
+  for (auto &b : bytes) b = static_cast<uint8_t>(rng());
+  return bytes;
+}
+
+class PixelConvertTest : public ::testing::TestWithParam<SimdLevel> {};
+
+TEST_P(PixelConvertTest, MatchesReferenceForOddWidths) {
+  const size_t height = 5;
+  for (size_t width = 1; width <= 75; width++) {
+    const auto src = RandomBytes(width * height * 4, static_cast<uint32_t>(width));
+    std::vector<uint8_t> expected(width * height * 4);
+    std::vector<uint8_t> actual(width * height * 4, 0xCD);
+
+    ReferenceBgraToRgba(src.data(), width * 4, expected.data(), width, height);
+    ConvertBgraToRgbaWithLevel(GetParam(), src.data(), width * 4,
+                               actual.data(), width * 4, width, height);
+    ASSERT_EQ(expected, actual) << "width " << width;
+  }
+}
+
+TEST_P(PixelConvertTest, HonoursPaddedPositiveStride) {
+  const size_t width = 41, height = 7;
+  const ptrdiff_t stride = 41 * 4 + 28;
+  const auto src = RandomBytes(stride * height, 7);
+  std::vector<uint8_t> expected(width * height * 4);
+  std::vector<uint8_t> actual(width * height * 4);
+
+  ReferenceBgraToRgba(src.data(), stride, expected.data(), width, height);
+  ConvertBgraToRgbaWithLevel(GetParam(), src.data(), stride, actual.data(),
+                             width * 4, width, height);
+  EXPECT_EQ(expected, actual);
+}
+
+TEST_P(PixelConvertTest, WalksBottomUpBufferWithNegativeStride) {
+  // Lock2D on a bottom-up buffer returns the last row in memory as scanline
+  // 0 together with a negative pitch.
+  const size_t width = 37, height = 6;
+  const ptrdiff_t pitch = 37 * 4 + 12;
+  const auto memory = RandomBytes(pitch * height, 11);
+  const uint8_t *scanline0 = memory.data() + pitch * (height - 1);
+
+  std::vector<uint8_t> expected(width * height * 4);
+  std::vector<uint8_t> actual(width * height * 4);
+  ReferenceBgraToRgba(scanline0, -pitch, expected.data(), width, height);
+  ConvertBgraToRgbaWithLevel(GetParam(), scanline0, -pitch, actual.data(),
+                             width * 4, width, height);
+  EXPECT_EQ(expected, actual);
+
+  // The first output row must come from the highest address.
+  EXPECT_EQ(actual[0], scanline0[2]);
+  EXPECT_EQ(actual[2], scanline0[0]);
+}
+
+TEST_P(PixelConvertTest, WritesIntoPaddedDestination) {
+  const size_t width = 19, height = 4;
+  const ptrdiff_t dst_stride = 19 * 4 + 8;
+  const auto src = RandomBytes(width * height * 4, 3);
+  std::vector<uint8_t> actual(dst_stride * height, 0xEE);
+  ConvertBgraToRgbaWithLevel(GetParam(), src.data(), width * 4,
+                             actual.data(), dst_stride, width, height);
+  for (size_t y = 0; y < height; y++) {
+    for (size_t x = 0; x < width; x++) {
+      const uint8_t *s = &src[(y * width + x) * 4];
+      const uint8_t *d = &actual[y * dst_stride + x * 4];
+      ASSERT_EQ(d[0], s[2]);
+      ASSERT_EQ(d[1], s[1]);
+      ASSERT_EQ(d[2], s[0]);
+      ASSERT_EQ(d[3], s[3]);
+    }
+    for (ptrdiff_t p = width * 4; p < dst_stride; p++) {
+      ASSERT_EQ(actual[y * dst_stride + p], 0xEE) << "padding overwritten";
+    }
+  }
+}
+
+TEST_P(PixelConvertTest, BgrxVariantForcesOpaqueAlpha) {
+  for (size_t width : {1, 15, 33, 100}) {
+    const size_t height = 3;
+    const auto src = RandomBytes(width * height * 4, 5);
+    std::vector<uint8_t> expected(width * height * 4);
+    std::vector<uint8_t> actual(width * height * 4);
+    ReferenceBgraToRgba(src.data(), width * 4, expected.data(), width, height);
+    for (size_t i = 3; i < expected.size(); i += 4) expected[i] = 255;
+    ConvertBgrxToRgbaWithLevel(GetParam(), src.data(), width * 4,
+                               actual.data(), width * 4, width, height);
+    ASSERT_EQ(expected, actual) << "width " << width;
+  }
+}
+
+TEST_P(PixelConvertTest, LutVariantMatchesScalar) {
+  // Arbitrary tables; the entries need not sit in one byte each.
+  std::vector<uint32_t> lut(3 * 256);
+  std::mt19937 rng(9);
+  for (auto &v : lut) v = rng() & 0x00FFFFFFu;
+  for (size_t width : {1, 7, 8, 15, 33, 100}) {
+    const size_t height = 3;
+    const ptrdiff_t stride = static_cast<ptrdiff_t>(width * 4);
+    const auto src = RandomBytes(width * height * 4, 6);
+    for (bool opaque : {false, true}) {
+      std::vector<uint8_t> expected(width * height * 4);
+      std::vector<uint8_t> actual(width * height * 4);
+      ConvertBgraToRgbaLutWithLevel(SimdLevel::kScalar, src.data(), stride,
+                                    expected.data(), stride, width, height,
+                                    lut.data(), opaque);
+      ConvertBgraToRgbaLutWithLevel(GetParam(), src.data(), stride,
+                                    actual.data(), stride, width, height,
+                                    lut.data(), opaque);
+      ASSERT_EQ(expected, actual) << "width " << width << " opaque "
+                                  << opaque;
+      // Row by row, as for a padded or bottom-up buffer.
+      std::fill(actual.begin(), actual.end(), 0);
+      ConvertBgraToRgbaLutWithLevel(
+          GetParam(), src.data() + (height - 1) * stride, -stride,
+          actual.data() + (height - 1) * stride, -stride, width, height,
+          lut.data(), opaque);
+      ASSERT_EQ(expected, actual) << "width " << width << " opaque "
+                                  << opaque;
+    }
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    AllLevels, PixelConvertTest, ::testing::ValuesIn(SupportedLevels()),
+    [](const ::testing::TestParamInfo<SimdLevel> &info) {
+      return std::string(SimdLevelName(info.param));
+    });
+
+TEST(PixelConvertDispatchTest, DefaultDispatchMatchesScalar) {
+  const size_t width = 640, height = 8;
+  const auto src = RandomBytes(width * height * 4, 42);
+  std::vector<uint8_t> scalar(width * height * 4);
+  std::vector<uint8_t> dispatched(width * height * 4);
+  ConvertBgraToRgbaWithLevel(SimdLevel::kScalar, src.data(), width * 4,
+                             scalar.data(), width * 4, width, height);
+  ConvertBgraToRgba(src.data(), width * 4, dispatched.data(), width * 4,
+                    width, height);
+  EXPECT_EQ(scalar, dispatched);
+}
+
+TEST(PixelConvertDispatchTest, MaxLevelCapsDispatch) {
+  SetMaxSimdLevel(SimdLevel::kScalar);
+  EXPECT_EQ(GetSimdLevel(), SimdLevel::kScalar);
+  SetMaxSimdLevel(SimdLevel::kNeon);
+  EXPECT_EQ(GetSimdLevel(), DetectSimdLevel());
+}
+
+}  // namespace
+}  // namespace uvc
@@ -0,0 +1,121 @@
+#include "raw_convert.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace uvc {
+namespace {
+
+// A synthetic 14-bit IR scene: a horizontal ramp with a hot spot.
+std::vector<uint16_t> SyntheticFrame(size_t width, size_t height) {
+  std::vector<uint16_t> frame(width * height);
+  for (size_t y = 0; y < height; y++) {
+    for (size_t x = 0; x < width; x++) {
+      frame[y * width + x] = static_cast<uint16_t>(7000 + x * 4);
+    }
+  }
+  frame[(height / 2) * width + width / 2] = 12000;
+  return frame;
+}
+
+TEST(RawConvertTest, BitDepths) {
+  EXPECT_EQ(RawBitDepth(RawPacking::kY16), 16);
+  EXPECT_EQ(RawBitDepth(RawPacking::kY14), 14);
+  EXPECT_EQ(RawBitDepth(RawPacking::kYuy2Raw16), 16);
+  EXPECT_EQ(RawBitDepth(RawPacking::kNone), 0);
+}
+
+TEST(RawConvertTest, UnpackY16HonoursPaddedStride) {
+  const size_t width = 13, height = 4;
+  const ptrdiff_t stride = 13 * 2 + 6;
+  std::vector<uint8_t> src(stride * height, 0xAB);
+  for (size_t y = 0; y < height; y++) {
+    for (size_t x = 0; x < width; x++) {
+      const uint16_t v = static_cast<uint16_t>(y * 1000 + x);
+      std::memcpy(&src[y * stride + x * 2], &v, 2);
+    }
+  }
+  std::vector<uint16_t> dst(width * height);
+  UnpackRaw16(RawPacking::kY16, src.data(), stride, dst.data(), width, height);
+  for (size_t y = 0; y < height; y++) {
+    for (size_t x = 0; x < width; x++) {
+      ASSERT_EQ(dst[y * width + x], y * 1000 + x);
+    }
+  }
+}
+
+TEST(RawConvertTest, UnpackBottomUpWithNegativeStride) {
+  const size_t width = 4, height = 3;
+  std::vector<uint16_t> memory = {0, 1, 2, 3, 10, 11, 12, 13, 20, 21, 22, 23};
+  const uint8_t *scanline0 =
+      reinterpret_cast<const uint8_t *>(memory.data() + width * (height - 1));
+  std::vector<uint16_t> dst(width * height);
+  UnpackRaw16(RawPacking::kY16, scanline0, -static_cast<ptrdiff_t>(width * 2),
+              dst.data(), width, height);
+  EXPECT_EQ(dst, (std::vector<uint16_t>{20, 21, 22, 23, 10, 11, 12, 13, 0, 1,
+                                        2, 3}));
+}
+
+TEST(RawConvertTest, UnpackY14MasksUnusedBits) {
+  std::vector<uint16_t> src = {0xC000 | 0x1234, 0x3FFF, 0xFFFF};
+  std::vector<uint16_t> dst(3);
+  UnpackRaw16(RawPacking::kY14, reinterpret_cast<const uint8_t *>(src.data()),
+              6, dst.data(), 3, 1);
+  EXPECT_EQ(dst, (std::vector<uint16_t>{0x1234, 0x3FFF, 0x3FFF}));
+}
+
+TEST(RawConvertTest, MinMaxFindsHotSpot) {
+  const auto frame = SyntheticFrame(160, 120);
+  const Range16 range = ComputeMinMax16(frame.data(), frame.size());
+  EXPECT_EQ(range.min, 7000);
+  EXPECT_EQ(range.max, 12000);
+  const Range16 empty = ComputeMinMax16(frame.data(), 0);
+  EXPECT_EQ(empty.min, 0);
+  EXPECT_EQ(empty.max, 0);
+}
+
+TEST(RawConvertTest, WindowMapsEndpointsAndClamps) {
+  const std::vector<uint16_t> src = {0, 1000, 1500, 2000, 65535};
+  std::vector<uint8_t> dst(src.size() * 4);
+  ConvertGray16ToRgba(src.data(), src.size(), dst.data(), dst.size(),
+                      src.size(), 1, 1000, 2000);
+  const uint8_t expected_grey[] = {0, 0, 127, 255, 255};
+  for (size_t i = 0; i < src.size(); i++) {
+    EXPECT_EQ(dst[i * 4 + 0], expected_grey[i]) << i;
+    EXPECT_EQ(dst[i * 4 + 1], expected_grey[i]) << i;
+    EXPECT_EQ(dst[i * 4 + 2], expected_grey[i]) << i;
+    EXPECT_EQ(dst[i * 4 + 3], 255) << i;
+  }
+}
+
+TEST(RawConvertTest, DegenerateWindowThresholds) {
+  const std::vector<uint16_t> src = {499, 500, 501};
+  std::vector<uint8_t> dst(src.size() * 4);
+  ConvertGray16ToRgba(src.data(), src.size(), dst.data(), dst.size(),
+                      src.size(), 1, 500, 500);
+  EXPECT_EQ(dst[0], 0);
+  EXPECT_EQ(dst[4], 0);
+  EXPECT_EQ(dst[8], 255);
+}
+
+TEST(RawConvertTest, AutoWindowedFrameUsesFullGreyRange) {
+  const size_t width = 160, height = 120;
+  const auto frame = SyntheticFrame(width, height);
+  const Range16 range = ComputeMinMax16(frame.data(), frame.size());
+  std::vector<uint8_t> rgba(width * height * 4);
+  ConvertGray16ToRgba(frame.data(), width, rgba.data(), width * 4, width,
+                      height, range.min, range.max);
+  EXPECT_EQ(rgba[0], 0);
+  const size_t hot = ((height / 2) * width + width / 2) * 4;
+  EXPECT_EQ(rgba[hot], 255);
+  // The ramp is monotonic, so the output must be too.
+  for (size_t x = 1; x < width; x++) {
+    ASSERT_GE(rgba[x * 4], rgba[(x - 1) * 4]);
+  }
+}
+
+}  // namespace
+}  // namespace uvc
@@ -0,0 +1,222 @@
+#include "roi_engine.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "cpu_features.h"
+
+namespace uvc {
+namespace {
+
+constexpr size_t kWidth = 100;
+constexpr size_t kHeight = 70;
+constexpr size_t kStride = kWidth + 7;
+
+std::vector<SimdLevel> SupportedLevels() {
+  std::vector<SimdLevel> levels = {SimdLevel::kScalar};
+  const SimdLevel detected = DetectSimdLevel();
+  if (detected == SimdLevel::kNeon) {
+    levels.push_back(SimdLevel::kNeon);
+  } else {
+    for (int l = 1; l <= static_cast<int>(detected); l++) {
+      levels.push_back(static_cast<SimdLevel>(l));
+    }
+  }
+  return levels;
+}
+
+std::vector<uint16_t> RandomFrame(uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> count(0, 65535);
+  std::vector<uint16_t> frame(kStride * kHeight);
+  for (uint16_t &v : frame) v = static_cast<uint16_t>(count(rng));
+  return frame;
+}
+
+Roi Rect(int32_t id, int32_t x0, int32_t y0, int32_t x1, int32_t y1) {
+  return Roi{id, RoiShape::kRect, {{x0, y0}, {x1, y1}}};
+}
+
+// Straightforward statistics of the pixels of |frame| at |points|.
+RoiStats Reference(const std::vector<uint16_t> &frame,
+                   const std::vector<RoiPoint> &points) {
+  RoiStats stats;
+  stats.count = static_cast<uint32_t>(points.size());
+  stats.min = 65535;
+  double sum = 0;
+  for (size_t i = 0; i < points.size(); i++) {
+    const RoiPoint &p = points[i];
+    const uint16_t v = frame[p.y * kStride + p.x];
+    stats.min = std::min(stats.min, v);
+    if (v > stats.max || i == 0) {
+      stats.max = v;
+      stats.max_x = p.x;
+      stats.max_y = p.y;
+    }
+    sum += v;
+  }
+  stats.mean = sum / points.size();
+  double squares = 0;
+  for (const RoiPoint &p : points) {
+    const double d = frame[p.y * kStride + p.x] - stats.mean;
+    squares += d * d;
+  }
+  stats.stddev = std::sqrt(squares / points.size());
+  return stats;
+}
+
+void ExpectStats(const RoiStats &actual, const RoiStats &expected) {
+  EXPECT_EQ(actual.count, expected.count);
+  EXPECT_EQ(actual.min, expected.min);
+  EXPECT_EQ(actual.max, expected.max);
+  EXPECT_NEAR(actual.mean, expected.mean, 1e-6);
+  EXPECT_NEAR(actual.stddev, expected.stddev, 1e-3);
+  EXPECT_EQ(actual.max_x, expected.max_x);
+  EXPECT_EQ(actual.max_y, expected.max_y);
+}
+
+class RoiEngineTest : public ::testing::Test {
+ protected:
+  void TearDown() override { SetMaxSimdLevel(SimdLevel::kNeon); }
+};
+
+TEST_F(RoiEngineTest, RectMatchesReferenceAtEveryLevel) {
+  const std::vector<uint16_t> frame = RandomFrame(3);
+  RoiEngine engine;
+  // Corners in either order, and one sticking out of the frame.
+  ASSERT_TRUE(engine.SetRois({Rect(7, 3, 4, 60, 50), Rect(8, 90, 65, 80, 10),
+                              Rect(9, -5, -5, 200, 200)}));
+  std::vector<RoiPoint> inner;
+  for (int32_t y = 4; y <= 50; y++) {
+    for (int32_t x = 3; x <= 60; x++) inner.push_back({x, y});
+  }
+  std::vector<RoiPoint> reversed;
+  for (int32_t y = 10; y <= 65; y++) {
+    for (int32_t x = 80; x <= 90; x++) reversed.push_back({x, y});
+  }
+  std::vector<RoiPoint> whole;
+  for (int32_t y = 0; y < static_cast<int32_t>(kHeight); y++) {
+    for (int32_t x = 0; x < static_cast<int32_t>(kWidth); x++) {
+      whole.push_back({x, y});
+    }
+  }
+  for (SimdLevel level : SupportedLevels()) {
+    SCOPED_TRACE(SimdLevelName(level));
+    SetMaxSimdLevel(level);
+    std::vector<RoiStats> stats;
+    ASSERT_TRUE(engine.Measure(frame.data(), kStride, kWidth, kHeight, &stats));
+    ASSERT_EQ(stats.size(), 3u);
+    EXPECT_EQ(stats[0].id, 7);
+    ExpectStats(stats[0], Reference(frame, inner));
+    ExpectStats(stats[1], Reference(frame, reversed));
+    ExpectStats(stats[2], Reference(frame, whole));
+  }
+}
+
+TEST_F(RoiEngineTest, FindsTheFirstHottestPixel) {
+  std::vector<uint16_t> frame(kStride * kHeight, 1000);
+  frame[40 * kStride + 30] = 5000;
+  frame[20 * kStride + 70] = 5000;
+  frame[20 * kStride + 75] = 5000;
+  RoiEngine engine;
+  ASSERT_TRUE(engine.SetRois({Rect(1, 0, 0, kWidth - 1, kHeight - 1),
+                              Rect(2, 0, 30, 50, 60)}));
+  for (SimdLevel level : SupportedLevels()) {
+    SetMaxSimdLevel(level);
+    std::vector<RoiStats> stats;
+    ASSERT_TRUE(engine.Measure(frame.data(), kStride, kWidth, kHeight, &stats));
+    EXPECT_EQ(stats[0].max, 5000);
+    EXPECT_EQ(stats[0].max_x, 70);
+    EXPECT_EQ(stats[0].max_y, 20);
+    EXPECT_EQ(stats[1].max_x, 30);
+    EXPECT_EQ(stats[1].max_y, 40);
+    EXPECT_EQ(stats[1].min, 1000);
+  }
+}
+
+TEST_F(RoiEngineTest, PointsAndPolylines) {
+  const std::vector<uint16_t> frame = RandomFrame(5);
+  RoiEngine engine;
+  const Roi point{1, RoiShape::kPoint, {{12, 34}}};
+  const Roi outside{2, RoiShape::kPoint, {{-1, 34}}};
+  // An L with a diagonal tail that leaves the frame.
+  const Roi line{3, RoiShape::kPolyline, {{5, 5}, {40, 5}, {40, 30}, {0, 70}}};
+  ASSERT_TRUE(engine.SetRois({point, outside, line}));
+
+  std::vector<RoiPoint> path;
+  for (int32_t x = 5; x <= 40; x++) path.push_back({x, 5});
+  for (int32_t y = 6; y <= 30; y++) path.push_back({40, y});
+  // 40 across and 40 down: a true diagonal, cut at the bottom edge.
+  for (int32_t i = 1; i <= 40; i++) {
+    if (30 + i < static_cast<int32_t>(kHeight)) path.push_back({40 - i, 30 + i});
+  }
+  for (SimdLevel level : SupportedLevels()) {
+    SCOPED_TRACE(SimdLevelName(level));
+    SetMaxSimdLevel(level);
+    std::vector<RoiStats> stats;
+    ASSERT_TRUE(engine.Measure(frame.data(), kStride, kWidth, kHeight, &stats));
+    ASSERT_EQ(stats.size(), 3u);
+    ExpectStats(stats[0], Reference(frame, {{12, 34}}));
+    EXPECT_EQ(stats[1].id, 2);
+    EXPECT_EQ(stats[1].count, 0u);
+    EXPECT_EQ(stats[1].mean, 0.0);
+    ExpectStats(stats[2], Reference(frame, path));
+  }
+}
+
+TEST_F(RoiEngineTest, RejectsMalformedRoisAndPacksStats) {
+  RoiEngine engine;
+  std::vector<RoiStats> stats;
+  std::vector<uint16_t> frame(kStride * kHeight, 100);
+  EXPECT_FALSE(engine.Measure(frame.data(), kStride, kWidth, kHeight, &stats));
+
+  EXPECT_FALSE(engine.SetRois({Roi{1, RoiShape::kRect, {{0, 0}}}}));
+  EXPECT_FALSE(engine.SetRois({Roi{1, RoiShape::kPolyline, {{0, 0}}}}));
+  EXPECT_FALSE(engine.SetRois(
+      {Roi{1, RoiShape::kPoint, {{RoiEngine::kMaxCoordinate + 1, 0}}}}));
+  EXPECT_FALSE(engine.SetRois(
+      std::vector<Roi>(RoiEngine::kMaxRois + 1, Rect(1, 0, 0, 1, 1))));
+  EXPECT_TRUE(engine.rois().empty());
+
+  RoiShape shape;
+  ASSERT_TRUE(ParseRoiShape("polyline", &shape));
+  EXPECT_EQ(shape, RoiShape::kPolyline);
+  EXPECT_FALSE(ParseRoiShape("circle", &shape));
+
+  ASSERT_TRUE(engine.SetRois({Rect(4, 0, 0, 1, 1)}));
+  EXPECT_EQ(engine.rois().size(), 1u);
+  RoiFrame roi_frame;
+  roi_frame.sequence = 9;
+  roi_frame.timestamp = 12345670;
+  ASSERT_TRUE(engine.Measure(frame.data(), kStride, kWidth, kHeight,
+                             &roi_frame.stats));
+  uint8_t record[RoiRecordBytes(1)];
+  TelemetryWriter writer(record, sizeof(record));
+  ASSERT_EQ(WriteRoiRecord(roi_frame, &writer), sizeof(record));
+  EXPECT_EQ(record[3], static_cast<uint8_t>(TelemetryKind::kRoi));
+  EXPECT_EQ(record[16], 0x87);  // 1234567 us = 0x12d687.
+  EXPECT_EQ(record[kTelemetryHeaderBytes], 1);
+  EXPECT_EQ(record[kTelemetryHeaderBytes + 4], kRoiRecordEntryBytes);
+  const uint8_t *entry = record + kTelemetryHeaderBytes + 8;
+  EXPECT_EQ(entry[0], 4);      // id
+  EXPECT_EQ(entry[4], 4);      // count
+  EXPECT_EQ(entry[8], 100);    // min
+  EXPECT_EQ(entry[10], 100);   // max
+  double mean;
+  std::memcpy(&mean, entry + 24, sizeof(mean));
+  EXPECT_EQ(mean, 100.0);
+  TelemetryWriter small(record, sizeof(record) - 1);
+  EXPECT_EQ(WriteRoiRecord(roi_frame, &small), 0u);
+
+  ASSERT_TRUE(engine.SetRois({}));
+  EXPECT_FALSE(engine.Measure(frame.data(), kStride, kWidth, kHeight, &stats));
+}
+
+}  // namespace
+}  // namespace uvc
@@ -0,0 +1,298 @@
+#include "snapshot_writer.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "image_encode.h"
+
+#if defined(UVC_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+namespace uvc {
+namespace {
+
+uint32_t Be32(const uint8_t *p) {
+  return (uint32_t{p[0]} << 24) | (uint32_t{p[1]} << 16) |
+         (uint32_t{p[2]} << 8) | p[3];
+}
+
+uint32_t Le32(const uint8_t *p) {
+  return p[0] | (uint32_t{p[1]} << 8) | (uint32_t{p[2]} << 16) |
+         (uint32_t{p[3]} << 24);
+}
+
+uint16_t Le16(const uint8_t *p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+// Inflates a zlib stream of |expected_size| bytes.
+std::vector<uint8_t> Inflate(const std::vector<uint8_t> &zlib,
+                             size_t expected_size) {
+  std::vector<uint8_t> raw(expected_size);
+#if defined(UVC_HAVE_ZLIB)
+  uLongf size = static_cast<uLongf>(raw.size());
+  EXPECT_EQ(uncompress(raw.data(), &size, zlib.data(),
+                       static_cast<uLong>(zlib.size())),
+            Z_OK);
+  raw.resize(size);
+#else
+  // Stored blocks only.
+  size_t in = 2, out = 0;
+  for (bool final = false; !final && in + 5 <= zlib.size();) {
+    final = zlib[in] & 1;
+    EXPECT_EQ(zlib[in] & 6, 0);
+    const size_t length = Le16(&zlib[in + 1]);
+    in += 5;
+    std::memcpy(raw.data() + out, &zlib[in], length);
+    in += length;
+    out += length;
+  }
+  raw.resize(out);
+#endif
+  return raw;
+}
+
+// Decodes the RGBA PNGs EncodePng() writes, checking every chunk CRC.
+bool DecodePng(const std::vector<uint8_t> &png, uint32_t *width,
+               uint32_t *height, std::vector<uint8_t> *rgba) {
+  if (png.size() < 8 || std::memcmp(png.data(), "\x89PNG\r\n\x1a\n", 8)) {
+    return false;
+  }
+  std::vector<uint8_t> zlib;
+  bool ended = false;
+  for (size_t i = 8; i + 12 <= png.size() && !ended;) {
+    const uint32_t length = Be32(&png[i]);
+    const std::string type(reinterpret_cast<const char *>(&png[i + 4]), 4);
+    const uint8_t *data = &png[i + 8];
+#if defined(UVC_HAVE_ZLIB)
+    EXPECT_EQ(Be32(data + length),
+              crc32(0, &png[i + 4], static_cast<uInt>(length + 4)))
+        << type;
+#endif
+    if (type == "IHDR") {
+      *width = Be32(data);
+      *height = Be32(data + 4);
+      EXPECT_EQ(data[8], 8);
+      EXPECT_EQ(data[9], 6);
+    } else if (type == "IDAT") {
+      zlib.insert(zlib.end(), data, data + length);
+    } else if (type == "IEND") {
+      ended = true;
+    }
+    i += 12 + length;
+  }
+  if (!ended) return false;
+
+  const size_t row_size = *width * 4;
+  const std::vector<uint8_t> raw = Inflate(zlib, (row_size + 1) * *height);
+  if (raw.size() != (row_size + 1) * *height) return false;
+  rgba->assign(row_size * *height, 0);
+  for (uint32_t y = 0; y < *height; y++) {
+    const uint8_t *src = &raw[y * (row_size + 1)];
+    uint8_t *dst = &(*rgba)[y * row_size];
+    EXPECT_EQ(src[0], 2);  // Up.
+    for (size_t x = 0; x < row_size; x++) {
+      dst[x] = static_cast<uint8_t>(src[x + 1] +
+                                    (y > 0 ? dst[x - row_size] : 0));
+    }
+  }
+  return true;
+}
+
+std::vector<uint8_t> ReadFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file),
+                              std::istreambuf_iterator<char>());
+}
+
+TEST(ImageEncodeTest, PngRoundTrips) {
+  const uint32_t width = 37, height = 23;
+  // A wider stride than the image, to check only the pixels are encoded.
+  const ptrdiff_t stride = width * 4 + 12;
+  std::vector<uint8_t> image(stride * height, 0xEE);
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width * 4; x++) {
+      image[y * stride + x] = static_cast<uint8_t>(x * 7 + y * 13);
+    }
+  }
+  std::vector<uint8_t> png;
+  ASSERT_TRUE(EncodePng(image.data(), stride, width, height, &png));
+
+  uint32_t decoded_width = 0, decoded_height = 0;
+  std::vector<uint8_t> decoded;
+  ASSERT_TRUE(DecodePng(png, &decoded_width, &decoded_height, &decoded));
+  EXPECT_EQ(decoded_width, width);
+  EXPECT_EQ(decoded_height, height);
+  for (uint32_t y = 0; y < height; y++) {
+    ASSERT_EQ(std::memcmp(&decoded[y * width * 4], &image[y * stride],
+                          width * 4),
+              0)
+        << y;
+  }
+  EXPECT_FALSE(EncodePng(image.data(), stride, 0, height, &png));
+}
+
+TEST(ImageEncodeTest, Tiff16KeepsEveryCount) {
+  const uint32_t width = 5, height = 3;
+  std::vector<uint16_t> counts(8 * height);
+  for (size_t i = 0; i < counts.size(); i++) {
+    counts[i] = static_cast<uint16_t>(i * 4099);
+  }
+  std::vector<uint8_t> tiff;
+  ASSERT_TRUE(EncodeTiff16(counts.data(), 8, width, height, &tiff));
+
+  ASSERT_EQ(std::memcmp(tiff.data(), "II*\0", 4), 0);
+  const uint32_t ifd = Le32(&tiff[4]);
+  const uint16_t entry_count = Le16(&tiff[ifd]);
+  uint32_t tags[512] = {};
+  uint16_t previous_tag = 0;
+  for (uint16_t i = 0; i < entry_count; i++) {
+    const uint8_t *entry = &tiff[ifd + 2 + i * 12];
+    const uint16_t tag = Le16(entry);
+    EXPECT_GT(tag, previous_tag);
+    previous_tag = tag;
+    const uint32_t value = Le16(entry + 2) == 3 ? Le16(entry + 8)
+                                                 : Le32(entry + 8);
+    if (tag < 512) tags[tag] = value;
+  }
+  EXPECT_EQ(tags[256], width);
+  EXPECT_EQ(tags[257], height);
+  EXPECT_EQ(tags[258], 16u);
+  EXPECT_EQ(tags[259], 1u);
+  EXPECT_EQ(tags[279], width * height * 2);
+  ASSERT_EQ(tags[273] + tags[279], tiff.size());
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      EXPECT_EQ(Le16(&tiff[tags[273] + (y * width + x) * 2]),
+                counts[y * 8 + x]);
+    }
+  }
+}
+
+class SnapshotWriterTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    FrameFormat format;
+    format.width = 64;
+    format.height = 48;
+    ASSERT_TRUE(rgba_pool_.Configure(format, 2, 2));
+    format.pixel_format = PixelFormat::kGray16;
+    ASSERT_TRUE(raw_pool_.Configure(format, 1, 1));
+  }
+
+  void TearDown() override {
+    for (const std::string &path : paths_) std::remove(path.c_str());
+  }
+
+  std::string Path(const std::string &name) {
+    paths_.push_back(::testing::TempDir() + name);
+    return paths_.back();
+  }
+
+  FramePool rgba_pool_;
+  FramePool raw_pool_;
+  std::vector<std::string> paths_;
+};
+
+TEST_F(SnapshotWriterTest, WritesPngAndTiff) {
+  FrameRef frame = rgba_pool_.Acquire();
+  for (size_t i = 0; i < frame.size(); i++) {
+    frame.data()[i] = static_cast<uint8_t>(i);
+  }
+  FrameRef raw = raw_pool_.Acquire();
+  std::memset(raw.data(), 0xAB, raw.size());
+
+  SnapshotWriter writer;
+  std::vector<SnapshotResult> results(2);
+  ASSERT_TRUE(writer.Submit(frame, SnapshotFormat::kPng,
+                            Path("snapshot_test.png"),
+                            [&](const SnapshotResult &r) { results[0] = r; }));
+  ASSERT_TRUE(writer.Submit(raw, SnapshotFormat::kTiff16,
+                            Path("snapshot_test.tiff"),
+                            [&](const SnapshotResult &r) { results[1] = r; }));
+  raw.reset();
+  writer.Flush();
+
+  for (const SnapshotResult &result : results) {
+    EXPECT_TRUE(result.ok) << result.error;
+    EXPECT_TRUE(result.error.empty());
+    EXPECT_GT(result.encode_ns, 0);
+    EXPECT_GE(result.queued_ns, 0);
+    EXPECT_EQ(ReadFile(result.path).size(), result.bytes);
+  }
+  uint32_t width = 0, height = 0;
+  std::vector<uint8_t> decoded;
+  ASSERT_TRUE(DecodePng(ReadFile(results[0].path), &width, &height, &decoded));
+  EXPECT_EQ(width, 64u);
+  EXPECT_EQ(std::memcmp(decoded.data(), frame.data(), frame.size()), 0);
+  EXPECT_EQ(ReadFile(results[1].path).size(), 146u + 64 * 48 * 2);
+  EXPECT_EQ(std::fopen((results[0].path + ".part").c_str(), "rb"), nullptr);
+
+  // Both slabs are back in their pools.
+  EXPECT_EQ(frame.use_count(), 1u);
+  EXPECT_EQ(raw_pool_.Stats().in_use, 0u);
+}
+
+TEST_F(SnapshotWriterTest, RefusesJobsBeyondTheLimit) {
+  SnapshotWriter writer(1);
+  std::atomic<int> done{0};
+  // Blocks the worker until released, so the next job has to wait.
+  std::mutex gate;
+  gate.lock();
+  ASSERT_TRUE(writer.Submit(rgba_pool_.Acquire(), SnapshotFormat::kPng,
+                            Path("snapshot_limit.png"),
+                            [&](const SnapshotResult &) {
+                              std::lock_guard<std::mutex> lock(gate);
+                              done++;
+                            }));
+  EXPECT_FALSE(writer.Submit(rgba_pool_.Acquire(), SnapshotFormat::kPng,
+                             Path("snapshot_refused.png"),
+                             [&](const SnapshotResult &) { done++; }));
+  gate.unlock();
+  writer.Flush();
+  EXPECT_EQ(done, 1);
+  EXPECT_TRUE(writer.Submit(rgba_pool_.Acquire(), SnapshotFormat::kPng,
+                            Path("snapshot_limit.png"), nullptr));
+}
+
+TEST_F(SnapshotWriterTest, ReportsMissingFramesAndUnwritablePaths) {
+  SnapshotWriter writer;
+  std::vector<SnapshotResult> results(3);
+  writer.Submit(FrameRef(), SnapshotFormat::kPng, Path("snapshot_none.png"),
+                [&](const SnapshotResult &r) { results[0] = r; });
+  // A colour frame cannot be written as raw counts.
+  writer.Submit(rgba_pool_.Acquire(), SnapshotFormat::kTiff16,
+                Path("snapshot_wrong.tiff"),
+                [&](const SnapshotResult &r) { results[1] = r; });
+  writer.Flush();
+  writer.Submit(rgba_pool_.Acquire(), SnapshotFormat::kPng,
+                ::testing::TempDir() + "missing_dir/snapshot.png",
+                [&](const SnapshotResult &r) { results[2] = r; });
+  writer.Flush();
+  EXPECT_EQ(results[0].error, "NO_FRAME");
+  EXPECT_EQ(results[1].error, "NO_FRAME");
+  EXPECT_EQ(results[2].error.rfind("WRITE_FAILED", 0), 0u);
+  for (const SnapshotResult &result : results) EXPECT_FALSE(result.ok);
+}
+
+TEST(SnapshotFormatTest, Parses) {
+  SnapshotFormat format;
+  ASSERT_TRUE(ParseSnapshotFormat("tiff", &format));
+  EXPECT_EQ(format, SnapshotFormat::kTiff16);
+  ASSERT_TRUE(ParseSnapshotFormat("png", &format));
+  EXPECT_EQ(format, SnapshotFormat::kPng);
+  EXPECT_FALSE(ParseSnapshotFormat("bmp", &format));
+}
+
+}  // namespace
+}  // namespace uvc
@@ -0,0 +1,67 @@
+#include "telemetry_record.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace uvc {
+namespace {
+
+uint64_t ReadLittleEndian(const uint8_t *bytes, size_t count) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < count; i++) {
+    value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+  }
+  return value;
+}
+
+TEST(TelemetryWriterTest, WritesTheHeaderAndLittleEndianFields) {
+  uint8_t buffer[64];
+  std::memset(buffer, 0xcc, sizeof(buffer));
+  TelemetryWriter writer(buffer, sizeof(buffer));
+  writer.Begin(TelemetryKind::kRoi, 0x0102030405060708u, -2);
+  writer.PutU16(0xbeef);
+  writer.PutI32(-3);
+  writer.PutF64(1.5);
+  ASSERT_EQ(writer.Finish(), kTelemetryHeaderBytes + 14);
+
+  EXPECT_EQ(ReadLittleEndian(buffer, 2), kTelemetryMagic);
+  EXPECT_EQ(buffer[2], kTelemetryVersion);
+  EXPECT_EQ(buffer[3], static_cast<uint8_t>(TelemetryKind::kRoi));
+  EXPECT_EQ(ReadLittleEndian(buffer + 4, 4), kTelemetryHeaderBytes + 14);
+  EXPECT_EQ(ReadLittleEndian(buffer + 8, 8), 0x0102030405060708u);
+  EXPECT_EQ(static_cast<int64_t>(ReadLittleEndian(buffer + 16, 8)), -2);
+  const uint8_t *payload = buffer + kTelemetryHeaderBytes;
+  EXPECT_EQ(ReadLittleEndian(payload, 2), 0xbeefu);
+  EXPECT_EQ(static_cast<int32_t>(ReadLittleEndian(payload + 2, 4)), -3);
+  const uint64_t bits = ReadLittleEndian(payload + 6, 8);
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  EXPECT_EQ(value, 1.5);
+  EXPECT_EQ(buffer[kTelemetryHeaderBytes + 14], 0xcc);
+}
+
+TEST(TelemetryWriterTest, OverflowWritesNothingPastTheBuffer) {
+  std::vector<uint8_t> buffer(kTelemetryHeaderBytes + 4 + 1, 0xcc);
+  TelemetryWriter writer(buffer.data(), kTelemetryHeaderBytes + 4);
+  writer.Begin(TelemetryKind::kRoi, 1, 1);
+  writer.PutU32(7);
+  writer.PutU8(1);
+  writer.PutU8(2);
+  EXPECT_EQ(writer.Finish(), 0u);
+  EXPECT_EQ(buffer.back(), 0xcc);
+
+  // The same writer starts over cleanly.
+  writer.Begin(TelemetryKind::kRoi, 1, 1);
+  writer.PutU32(7);
+  EXPECT_EQ(writer.Finish(), kTelemetryHeaderBytes + 4);
+
+  TelemetryWriter tiny(buffer.data(), kTelemetryHeaderBytes - 1);
+  tiny.Begin(TelemetryKind::kRoi, 1, 1);
+  EXPECT_EQ(tiny.Finish(), 0u);
+}
+
+}  // namespace
+}  // namespace uvc
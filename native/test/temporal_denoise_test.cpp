@@ -0,0 +1,231 @@
+#include "temporal_denoise.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "cpu_features.h"
+#include "stripe_pool.h"
+
+namespace uvc {
+namespace {
+
+constexpr size_t kWidth = 160;
+constexpr size_t kHeight = 128;
+constexpr float kSigma = 16.0f;
+
+std::vector<SimdLevel> SupportedLevels() {
+  std::vector<SimdLevel> levels = {SimdLevel::kScalar};
+  const SimdLevel detected = DetectSimdLevel();
+  if (detected == SimdLevel::kNeon) {
+    levels.push_back(SimdLevel::kNeon);
+  } else {
+    for (int l = 1; l <= static_cast<int>(detected); l++) {
+      levels.push_back(static_cast<SimdLevel>(l));
+    }
+  }
+  return levels;
+}
+
+DenoiseConfig Enabled() {
+  DenoiseConfig config;
+  config.enabled = true;
+  config.noise_sigma = kSigma;
+  return config;
+}
+
+// A 14-bit scene: a gradient with a warm disc, no noise.
+std::vector<uint16_t> CleanScene(size_t width, size_t height) {
+  std::vector<uint16_t> scene(width * height);
+  for (size_t y = 0; y < height; y++) {
+    for (size_t x = 0; x < width; x++) {
+      const double dx = static_cast<double>(x) - width / 2.0;
+      const double dy = static_cast<double>(y) - height / 2.0;
+      const bool disc = dx * dx + dy * dy < 400;
+      scene[y * width + x] =
+          static_cast<uint16_t>(6000 + x * 4 + y * 2 + (disc ? 1500 : 0));
+    }
+  }
+  return scene;
+}
+
+std::vector<uint16_t> AddNoise(const std::vector<uint16_t> &clean,
+                               std::mt19937 *rng) {
+  std::normal_distribution<float> noise(0.0f, kSigma);
+  std::vector<uint16_t> noisy(clean.size());
+  for (size_t i = 0; i < clean.size(); i++) {
+    noisy[i] = static_cast<uint16_t>(
+        std::lround(std::min(std::max(clean[i] + noise(*rng), 0.0f),
+                             16383.0f)));
+  }
+  return noisy;
+}
+
+double Psnr(const std::vector<uint16_t> &image,
+            const std::vector<uint16_t> &reference) {
+  double squared = 0;
+  for (size_t i = 0; i < image.size(); i++) {
+    const double e = static_cast<double>(image[i]) - reference[i];
+    squared += e * e;
+  }
+  const double mse = squared / image.size();
+  return 10.0 * std::log10(16383.0 * 16383.0 / mse);
+}
+
+class TemporalDenoiseTest : public ::testing::Test {
+ protected:
+  void TearDown() override { SetMaxSimdLevel(SimdLevel::kNeon); }
+};
+
+TEST_F(TemporalDenoiseTest, ReducesNoiseOnAStaticScene) {
+  const std::vector<uint16_t> clean = CleanScene(kWidth, kHeight);
+  std::mt19937 rng(7);
+  TemporalDenoise denoise;
+  denoise.SetConfig(Enabled());
+  double input_psnr = 0, output_psnr = 0;
+  for (int frame = 0; frame < 40; frame++) {
+    std::vector<uint16_t> counts = AddNoise(clean, &rng);
+    input_psnr = Psnr(counts, clean);
+    denoise.Process(counts.data(), kWidth, kWidth, kHeight);
+    output_psnr = Psnr(counts, clean);
+  }
+  // min_weight 1/8 alone would settle at 1/15 of the input's noise
+  // variance, 11.8 dB; the few pixels whose noise reaches the motion ramp
+  // are blended harder, which leaves about 10 dB.
+  EXPECT_GT(output_psnr - input_psnr, 8.0)
+      << "input " << input_psnr << " dB, output " << output_psnr << " dB";
+}
+
+TEST_F(TemporalDenoiseTest, MovingObjectsLeaveNoTrail) {
+  std::mt19937 rng(3);
+  TemporalDenoise denoise;
+  denoise.SetConfig(Enabled());
+  // A hot square crossing a flat background, 8 pixels per frame.
+  constexpr int kStep = 8;
+  constexpr int kSize = 24;
+  int worst_trail = 0, worst_object = 0;
+  for (int frame = 0; frame < 14; frame++) {
+    std::vector<uint16_t> clean(kWidth * kHeight, 4000);
+    const int left = frame * kStep;
+    for (size_t y = 40; y < 40 + kSize; y++) {
+      for (int x = left; x < left + kSize; x++) clean[y * kWidth + x] = 7000;
+    }
+    std::vector<uint16_t> counts = AddNoise(clean, &rng);
+    denoise.Process(counts.data(), kWidth, kWidth, kHeight);
+    if (frame < 4) continue;
+    // Where the square was on the last frame, and where it is now.
+    for (size_t y = 40; y < 40 + kSize; y++) {
+      for (int x = left - kStep; x < left; x++) {
+        worst_trail = std::max(worst_trail, counts[y * kWidth + x] - 4000);
+      }
+      for (int x = left; x < left + kSize; x++) {
+        worst_object = std::max(worst_object, 7000 - counts[y * kWidth + x]);
+      }
+    }
+  }
+  EXPECT_LT(worst_trail, 5 * kSigma);
+  EXPECT_LT(worst_object, 5 * kSigma);
+}
+
+TEST_F(TemporalDenoiseTest, SimdLevelsMatchScalar) {
+  // Odd width: every kernel ends in its scalar tail.
+  constexpr size_t kOddWidth = 67;
+  constexpr size_t kStride = 72;
+  const std::vector<uint16_t> clean = CleanScene(kStride, 9);
+  std::vector<std::vector<uint16_t>> inputs;
+  std::mt19937 rng(11);
+  for (int frame = 0; frame < 6; frame++) {
+    std::vector<uint16_t> noisy = AddNoise(clean, &rng);
+    // Motion on every frame, and counts at the top of the range.
+    noisy[frame * 5] = 16383;
+    noisy[kStride + frame] = 65535;
+    inputs.push_back(noisy);
+  }
+
+  std::vector<std::vector<uint16_t>> reference;
+  for (SimdLevel level : SupportedLevels()) {
+    SetMaxSimdLevel(level);
+    TemporalDenoise denoise(1);
+    denoise.SetConfig(Enabled());
+    std::vector<std::vector<uint16_t>> outputs = inputs;
+    for (auto &counts : outputs) {
+      denoise.Process(counts.data(), kStride, kOddWidth, 9);
+    }
+    if (level == SimdLevel::kScalar) {
+      reference = outputs;
+      continue;
+    }
+    for (size_t f = 0; f < outputs.size(); f++) {
+      for (size_t i = 0; i < outputs[f].size(); i++) {
+        // The scalar kernel may be compiled with fused multiply-adds.
+        ASSERT_LE(std::abs(outputs[f][i] - reference[f][i]), 1)
+            << SimdLevelName(level) << " frame " << f << " pixel " << i;
+      }
+    }
+  }
+}
+
+TEST_F(TemporalDenoiseTest, StripesMatchOneThread) {
+  const std::vector<uint16_t> clean = CleanScene(kWidth, kHeight);
+  std::mt19937 rng(5);
+  TemporalDenoise single(1), striped(4);
+  single.SetConfig(Enabled());
+  striped.SetConfig(Enabled());
+  for (int frame = 0; frame < 5; frame++) {
+    std::vector<uint16_t> a = AddNoise(clean, &rng);
+    std::vector<uint16_t> b = a;
+    single.Process(a.data(), kWidth, kWidth, kHeight);
+    striped.Process(b.data(), kWidth, kWidth, kHeight);
+    ASSERT_EQ(a, b) << "frame " << frame;
+  }
+}
+
+TEST_F(TemporalDenoiseTest, SeedsOnTheFirstFrameAndPassesThroughWhenOff) {
+  std::mt19937 rng(9);
+  const std::vector<uint16_t> clean = CleanScene(kWidth, kHeight);
+  TemporalDenoise denoise;
+  std::vector<uint16_t> counts = AddNoise(clean, &rng);
+  std::vector<uint16_t> original = counts;
+  denoise.Process(counts.data(), kWidth, kWidth, kHeight);
+  EXPECT_EQ(counts, original);
+
+  denoise.SetConfig(Enabled());
+  EXPECT_TRUE(denoise.config().enabled);
+  denoise.Process(counts.data(), kWidth, kWidth, kHeight);
+  EXPECT_EQ(counts, original);
+  counts = AddNoise(clean, &rng);
+  original = counts;
+  denoise.Process(counts.data(), kWidth, kWidth, kHeight);
+  EXPECT_NE(counts, original);
+
+  // A new size starts over.
+  counts.resize(64 * 32);
+  original = counts;
+  denoise.Process(counts.data(), 64, 64, 32);
+  EXPECT_EQ(counts, original);
+}
+
+TEST(StripePoolTest, RunsEveryStripeOnce) {
+  for (size_t threads : {1, 3}) {
+    StripePool pool(threads);
+    EXPECT_EQ(pool.threads(), threads);
+    for (size_t count : {0, 1, 2, 7, 64}) {
+      std::vector<std::atomic<int>> calls(count);
+      for (int round = 0; round < 3; round++) {
+        pool.Run(count, [&](size_t i) { calls[i]++; });
+      }
+      for (size_t i = 0; i < count; i++) {
+        EXPECT_EQ(calls[i].load(), 3) << threads << " threads, " << count;
+      }
+    }
+  }
+}
+
+}  // namespace
+}  // namespace uvc
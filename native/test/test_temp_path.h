@@ -0,0 +1,23 @@
+#ifndef UVC_TEST_TEMP_PATH_H_
+#define UVC_TEST_TEMP_PATH_H_
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace uvc {
+
+// A file in the test temp directory named after the running test, e.g.
+// "ReplaySourceTest_LoopsAndOverridesRate.uvcrec" for ".uvcrec". ctest runs
+// each test as its own process, in parallel with -j, so fixtures that wrote
+// and removed one shared file would clobber each other's.
+inline std::string TestTempPath(const char *suffix) {
+  const ::testing::TestInfo *info =
+      ::testing::UnitTest::GetInstance()->current_test_info();
+  return ::testing::TempDir() + info->test_suite_name() + "_" + info->name() +
+         suffix;
+}
+
+}  // namespace uvc
+
+#endif  // UVC_TEST_TEMP_PATH_H_
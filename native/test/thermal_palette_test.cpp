@@ -0,0 +1,128 @@
+#include "thermal_palette.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace uvc {
+namespace {
+
+struct Rgba {
+  uint8_t r, g, b, a;
+};
+
+Rgba Unpack(uint32_t pixel) {
+  Rgba c;
+  std::memcpy(&c, &pixel, 4);
+  return c;
+}
+
+const ThermalPalette kAllPalettes[] = {
+    ThermalPalette::kWhiteHot, ThermalPalette::kBlackHot,
+    ThermalPalette::kIronbow, ThermalPalette::kRainbow,
+    ThermalPalette::kArctic};
+
+TEST(ThermalPaletteTest, NamesRoundTrip) {
+  for (ThermalPalette p : kAllPalettes) {
+    ThermalPalette parsed = ThermalPalette::kWhiteHot;
+    ASSERT_TRUE(ParseThermalPalette(ThermalPaletteName(p), &parsed));
+    EXPECT_EQ(parsed, p);
+  }
+  ThermalPalette untouched = ThermalPalette::kArctic;
+  EXPECT_FALSE(ParseThermalPalette("sepia", &untouched));
+  EXPECT_EQ(untouched, ThermalPalette::kArctic);
+}
+
+TEST(ThermalPaletteTest, TablesAreAlignedOpaqueAndStable) {
+  for (ThermalPalette p : kAllPalettes) {
+    const uint32_t *table = GetPaletteTable(p);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(table) % 64, 0u);
+    EXPECT_EQ(table, GetPaletteTable(p)) << "built once";
+    for (size_t i = 0; i < kPaletteTableSize; i += 97) {
+      ASSERT_EQ(Unpack(table[i]).a, 255);
+    }
+  }
+}
+
+TEST(ThermalPaletteTest, WhiteHotAndBlackHotAreMonotonicGreyRamps) {
+  const uint32_t *white = GetPaletteTable(ThermalPalette::kWhiteHot);
+  const uint32_t *black = GetPaletteTable(ThermalPalette::kBlackHot);
+  EXPECT_EQ(Unpack(white[0]).r, 0);
+  EXPECT_EQ(Unpack(white[65535]).r, 255);
+  EXPECT_EQ(Unpack(black[0]).r, 255);
+  EXPECT_EQ(Unpack(black[65535]).r, 0);
+  for (size_t i = 1; i < kPaletteTableSize; i++) {
+    const Rgba w = Unpack(white[i]);
+    ASSERT_EQ(w.r, w.g);
+    ASSERT_EQ(w.g, w.b);
+    ASSERT_GE(w.r, Unpack(white[i - 1]).r);
+    ASSERT_LE(Unpack(black[i]).r, Unpack(black[i - 1]).r);
+  }
+}
+
+TEST(ThermalPaletteTest, IronbowRunsFromBlackToNearWhite) {
+  const uint32_t *iron = GetPaletteTable(ThermalPalette::kIronbow);
+  const Rgba cold = Unpack(iron[0]);
+  const Rgba hot = Unpack(iron[65535]);
+  EXPECT_EQ(cold.r + cold.g + cold.b, 0);
+  EXPECT_GT(hot.r + hot.g + hot.b, 700);
+}
+
+TEST(ThermalPaletteTest, WindowEndpointsHitTableEnds) {
+  const uint32_t *table = GetPaletteTable(ThermalPalette::kRainbow);
+  const std::vector<uint16_t> src = {0, 1000, 3000, 5000, 65535};
+  std::vector<uint32_t> dst(src.size());
+  ColorizeGray16(src.data(), src.size(),
+                 table, reinterpret_cast<uint8_t *>(dst.data()),
+                 dst.size() * 4, src.size(), 1, 1000, 5000);
+  EXPECT_EQ(dst[0], table[0]);
+  EXPECT_EQ(dst[1], table[0]);
+  EXPECT_EQ(dst[2], table[32768]);
+  EXPECT_EQ(dst[3], table[65535]);
+  EXPECT_EQ(dst[4], table[65535]);
+}
+
+TEST(ThermalPaletteTest, Avx2GatherMatchesBlockedScalar) {
+  if (DetectSimdLevel() != SimdLevel::kAvx2) {
+    GTEST_SKIP() << "AVX2 not available";
+  }
+  std::mt19937 rng(5);
+  const size_t width = 203, height = 9;
+  std::vector<uint16_t> src(width * height);
+  for (auto &v : src) v = static_cast<uint16_t>(rng());
+  const uint16_t windows[][2] = {
+      {0, 65535}, {7000, 9000}, {30000, 30001}, {500, 500}, {9000, 100}};
+  for (ThermalPalette p : kAllPalettes) {
+    for (const auto &w : windows) {
+      std::vector<uint32_t> scalar(width * height), avx2(width * height);
+      ColorizeGray16WithLevel(SimdLevel::kScalar, src.data(), width,
+                              GetPaletteTable(p),
+                              reinterpret_cast<uint8_t *>(scalar.data()),
+                              width * 4, width, height, w[0], w[1]);
+      ColorizeGray16WithLevel(SimdLevel::kAvx2, src.data(), width,
+                              GetPaletteTable(p),
+                              reinterpret_cast<uint8_t *>(avx2.data()),
+                              width * 4, width, height, w[0], w[1]);
+      ASSERT_EQ(scalar, avx2) << ThermalPaletteName(p) << " " << w[0] << ".."
+                              << w[1];
+    }
+  }
+}
+
+TEST(ThermalPaletteTest, SelectorSwapsTablePointer) {
+  PaletteSelector selector;
+  EXPECT_EQ(selector.palette(), ThermalPalette::kWhiteHot);
+  EXPECT_EQ(selector.table(), GetPaletteTable(ThermalPalette::kWhiteHot));
+
+  std::thread ui([&] { selector.Select(ThermalPalette::kIronbow); });
+  ui.join();
+  EXPECT_EQ(selector.palette(), ThermalPalette::kIronbow);
+  EXPECT_EQ(selector.table(), GetPaletteTable(ThermalPalette::kIronbow));
+}
+
+}  // namespace
+}  // namespace uvc
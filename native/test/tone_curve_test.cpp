@@ -0,0 +1,130 @@
+#include "tone_curve.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "pixel_convert.h"
+#include "thermal_palette.h"
+
+namespace uvc {
+namespace {
+
+ToneSettings Settings(double brightness, double contrast, double gamma) {
+  ToneSettings settings;
+  settings.brightness = brightness;
+  settings.contrast = contrast;
+  settings.gamma = gamma;
+  return settings;
+}
+
+TEST(ToneCurveTest, BuildsTheCurveOfEachSlider) {
+  uint8_t curve[256];
+  BuildToneCurve(ToneSettings(), curve);
+  for (int v = 0; v < 256; v++) EXPECT_EQ(curve[v], v);
+
+  // Brightness shifts, clamping at the ends.
+  BuildToneCurve(Settings(0.75, 0.5, 1.0), curve);
+  EXPECT_EQ(curve[0], 64);
+  EXPECT_EQ(curve[100], 164);
+  EXPECT_EQ(curve[200], 255);
+
+  // Contrast scales around mid-grey, by 1/4 at 0 and 4 at 1.
+  BuildToneCurve(Settings(0.5, 0.0, 1.0), curve);
+  EXPECT_EQ(curve[0], 96);
+  EXPECT_EQ(curve[128], 128);
+  EXPECT_EQ(curve[255], 159);
+  BuildToneCurve(Settings(0.5, 1.0, 1.0), curve);
+  EXPECT_EQ(curve[95], 0);
+  EXPECT_EQ(curve[160], 255);
+
+  // Gamma 2 is a square root.
+  BuildToneCurve(Settings(0.5, 0.5, 2.0), curve);
+  EXPECT_EQ(curve[0], 0);
+  EXPECT_EQ(curve[64], 128);
+  EXPECT_EQ(curve[255], 255);
+
+  EXPECT_TRUE(Settings(1, 0, 0.1).IsValid());
+  EXPECT_FALSE(Settings(1.1, 0.5, 1).IsValid());
+  EXPECT_FALSE(Settings(0.5, -0.1, 1).IsValid());
+  EXPECT_FALSE(Settings(0.5, 0.5, 0).IsValid());
+}
+
+TEST(ToneCurveTest, SwizzleLutMatchesConvertingThenMapping) {
+  constexpr size_t kWidth = 37;
+  constexpr size_t kHeight = 5;
+  std::vector<uint8_t> bgra(kWidth * kHeight * 4);
+  for (size_t i = 0; i < bgra.size(); i++) {
+    bgra[i] = static_cast<uint8_t>(i * 151 + 7);
+  }
+  ToneCurve tone;
+  EXPECT_FALSE(tone.Update());
+  tone.Set(Settings(0.6, 0.7, 1.8));
+  ASSERT_TRUE(tone.Update());
+  const ptrdiff_t stride = kWidth * 4;
+
+  for (bool opaque : {false, true}) {
+    std::vector<uint8_t> expected(bgra.size());
+    if (opaque) {
+      ConvertBgrxToRgbaWithLevel(SimdLevel::kScalar, bgra.data(), stride,
+                                 expected.data(), stride, kWidth, kHeight);
+    } else {
+      ConvertBgraToRgbaWithLevel(SimdLevel::kScalar, bgra.data(), stride,
+                                 expected.data(), stride, kWidth, kHeight);
+    }
+    ApplyCurveToRgba(expected.data(), stride, kWidth, kHeight, tone.curve());
+
+    // Bottom-up source, written into a padded destination.
+    std::vector<uint8_t> actual(kHeight * (stride + 8), 0xcc);
+    ConvertBgraToRgbaLut(bgra.data() + (kHeight - 1) * stride, -stride,
+                         actual.data(), stride + 8, kWidth, kHeight,
+                         tone.swizzle_lut(), opaque);
+    for (size_t y = 0; y < kHeight; y++) {
+      const uint8_t *row = actual.data() + y * (stride + 8);
+      EXPECT_EQ(std::vector<uint8_t>(row, row + stride),
+                std::vector<uint8_t>(
+                    expected.begin() + (kHeight - 1 - y) * stride,
+                    expected.begin() + (kHeight - y) * stride))
+          << "row " << y << (opaque ? " opaque" : "");
+      EXPECT_EQ(row[stride], 0xcc);
+    }
+  }
+}
+
+TEST(ToneCurveTest, TonesThePaletteIntoAlternatingTables) {
+  ToneCurve tone;
+  const uint32_t *white_hot = GetPaletteTable(ThermalPalette::kWhiteHot);
+  ASSERT_FALSE(tone.Update());
+  EXPECT_EQ(tone.Apply(white_hot), white_hot);
+
+  tone.Set(Settings(0.5, 0.5, 2.0));
+  ASSERT_TRUE(tone.Update());
+  const uint32_t *first = tone.Apply(white_hot);
+  ASSERT_NE(first, white_hot);
+  for (size_t i : {size_t{0}, size_t{12345}, kPaletteTableSize - 1}) {
+    const uint32_t c = white_hot[i];
+    const uint32_t t = first[i];
+    EXPECT_EQ(t >> 24, c >> 24);
+    EXPECT_EQ(t & 0xFF, tone.curve()[c & 0xFF]);
+    EXPECT_EQ((t >> 8) & 0xFF, tone.curve()[(c >> 8) & 0xFF]);
+    EXPECT_EQ((t >> 16) & 0xFF, tone.curve()[(c >> 16) & 0xFF]);
+  }
+  // Unchanged settings and palette reuse the table; either changing moves
+  // to the other one.
+  EXPECT_TRUE(tone.Update());
+  EXPECT_EQ(tone.Apply(white_hot), first);
+  const uint32_t *ironbow = GetPaletteTable(ThermalPalette::kIronbow);
+  EXPECT_NE(tone.Apply(ironbow), first);
+  tone.Set(Settings(0.4, 0.5, 2.0));
+  EXPECT_EQ(tone.settings().brightness, 0.4);
+  ASSERT_TRUE(tone.Update());
+  EXPECT_EQ(tone.Apply(ironbow), first);
+
+  tone.Set(ToneSettings());
+  EXPECT_FALSE(tone.Update());
+  EXPECT_EQ(tone.Apply(white_hot), white_hot);
+}
+
+}  // namespace
+}  // namespace uvc
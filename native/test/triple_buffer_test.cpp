@@ -0,0 +1,101 @@
+#include "triple_buffer.h"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace uvc {
+namespace {
+
+// Large enough that a torn read would be caught between the first and the
+// last element.
+struct Payload {
+  uint64_t sequence = 0;
+  std::array<uint64_t, 512> words{};
+};
+
+TEST(TripleBufferTest, UpdateWithoutPublishReturnsFalse) {
+  TripleBuffer<int> buffer;
+  EXPECT_FALSE(buffer.HasFresh());
+  EXPECT_FALSE(buffer.Update());
+}
+
+TEST(TripleBufferTest, ConsumerSeesNewestPublishedValue) {
+  TripleBuffer<int> buffer;
+  buffer.WriteBuffer() = 1;
+  buffer.Publish();
+  buffer.WriteBuffer() = 2;
+  buffer.Publish();
+  EXPECT_TRUE(buffer.HasFresh());
+  ASSERT_TRUE(buffer.Update());
+  EXPECT_EQ(buffer.ReadBuffer(), 2);
+  EXPECT_FALSE(buffer.Update());
+  EXPECT_EQ(buffer.ReadBuffer(), 2);
+}
+
+TEST(TripleBufferTest, FrontSlotIsStableWhileProducerRuns) {
+  TripleBuffer<int> buffer;
+  buffer.WriteBuffer() = 7;
+  buffer.Publish();
+  ASSERT_TRUE(buffer.Update());
+  const int *front = &buffer.ReadBuffer();
+  for (int i = 0; i < 10; i++) {
+    // The producer may never be handed the consumer's slot.
+    EXPECT_NE(&buffer.WriteBuffer(), front);
+    buffer.WriteBuffer() = 100 + i;
+    buffer.Publish();
+  }
+  EXPECT_EQ(*front, 7);
+  ASSERT_TRUE(buffer.Update());
+  EXPECT_EQ(buffer.ReadBuffer(), 109);
+}
+
+TEST(TripleBufferTest, StressProducerAndConsumerThreads) {
+  constexpr uint64_t kFrames = 200000;
+  TripleBuffer<Payload> buffer;
+  std::atomic<bool> producer_done{false};
+
+  std::thread producer([&] {
+    for (uint64_t seq = 1; seq <= kFrames; seq++) {
+      Payload &slot = buffer.WriteBuffer();
+      slot.sequence = seq;
+      for (auto &w : slot.words) w = seq;
+      buffer.Publish();
+    }
+    producer_done.store(true, std::memory_order_release);
+  });
+
+  uint64_t last_seen = 0;
+  uint64_t updates = 0;
+  uint64_t torn = 0;
+  uint64_t regressions = 0;
+  for (;;) {
+    const bool done = producer_done.load(std::memory_order_acquire);
+    if (buffer.Update()) {
+      const Payload &frame = buffer.ReadBuffer();
+      for (const auto &w : frame.words) {
+        if (w != frame.sequence) {
+          torn++;
+          break;
+        }
+      }
+      if (frame.sequence <= last_seen) regressions++;
+      last_seen = frame.sequence;
+      updates++;
+    } else if (done) {
+      break;
+    }
+  }
+  producer.join();
+
+  EXPECT_EQ(torn, 0u);
+  EXPECT_EQ(regressions, 0u);
+  EXPECT_EQ(last_seen, kFrames) << "the final frame must always be delivered";
+  EXPECT_GT(updates, 0u);
+}
+
+}  // namespace
+}  // namespace uvc
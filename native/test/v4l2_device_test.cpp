@@ -0,0 +1,162 @@
+#include "v4l2_device.h"
+
+#include <gtest/gtest.h>
+#include <linux/videodev2.h>
+
+#include <cerrno>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace uvc {
+namespace {
+
+V4l2FrameMode Mode(uint32_t fourcc, uint32_t w, uint32_t h, uint32_t fps) {
+  return V4l2FrameMode{fourcc, w, h, fps, 1};
+}
+
+TEST(V4l2ModeTest, FourccMapping) {
+  EXPECT_EQ(ConversionForFourcc(V4L2_PIX_FMT_XBGR32), V4l2Conversion::kBgra);
+  EXPECT_EQ(ConversionForFourcc(V4L2_PIX_FMT_YUYV), V4l2Conversion::kYuyv);
+  EXPECT_EQ(ConversionForFourcc(V4L2_PIX_FMT_UYVY), V4l2Conversion::kUyvy);
+  EXPECT_EQ(ConversionForFourcc(V4L2_PIX_FMT_NV12), V4l2Conversion::kNv12);
+  EXPECT_EQ(ConversionForFourcc(V4L2_PIX_FMT_Y16), V4l2Conversion::kRaw16);
+  EXPECT_EQ(ConversionForFourcc(V4L2_PIX_FMT_MJPEG), V4l2Conversion::kMjpeg);
+  EXPECT_EQ(ConversionForFourcc(V4L2_PIX_FMT_H264),
+            V4l2Conversion::kUnsupported);
+  EXPECT_EQ(RawPackingForFourcc(V4L2_PIX_FMT_Y14), RawPacking::kY14);
+  EXPECT_EQ(RawPackingForFourcc(V4L2_PIX_FMT_YUYV), RawPacking::kYuy2Raw16);
+  EXPECT_EQ(RawPackingForFourcc(V4L2_PIX_FMT_XBGR32), RawPacking::kNone);
+}
+
+TEST(V4l2ModeTest, ColourPrefersBgraThenSizeThenRate) {
+  const std::vector<V4l2FrameMode> modes = {
+      Mode(V4L2_PIX_FMT_MJPEG, 1920, 1080, 30),
+      Mode(V4L2_PIX_FMT_YUYV, 1280, 720, 10),
+      Mode(V4L2_PIX_FMT_XBGR32, 640, 480, 30),
+      Mode(V4L2_PIX_FMT_XBGR32, 640, 480, 60),
+      Mode(V4L2_PIX_FMT_XBGR32, 320, 240, 60),
+  };
+  V4l2FrameMode chosen{};
+  ASSERT_TRUE(ChooseV4l2Mode(modes, false, false, 0, 0, &chosen));
+  EXPECT_EQ(chosen.fourcc, static_cast<uint32_t>(V4L2_PIX_FMT_XBGR32));
+  EXPECT_EQ(chosen.width, 640u);
+  EXPECT_EQ(chosen.fps_numerator, 60u);
+
+  // An explicit size outranks the format preference.
+  ASSERT_TRUE(ChooseV4l2Mode(modes, false, false, 1280, 720, &chosen));
+  EXPECT_EQ(chosen.fourcc, static_cast<uint32_t>(V4L2_PIX_FMT_YUYV));
+}
+
+TEST(V4l2ModeTest, RawPrefersTrue16BitOverYuyvTransport) {
+  const std::vector<V4l2FrameMode> modes = {
+      Mode(V4L2_PIX_FMT_YUYV, 256, 384, 25),
+      Mode(V4L2_PIX_FMT_Y16, 256, 192, 25),
+      Mode(V4L2_PIX_FMT_XBGR32, 256, 192, 25),
+  };
+  V4l2FrameMode chosen{};
+  ASSERT_TRUE(ChooseV4l2Mode(modes, true, true, 0, 0, &chosen));
+  EXPECT_EQ(chosen.fourcc, static_cast<uint32_t>(V4L2_PIX_FMT_Y16));
+  // The transport only when it is the one at the requested size, and only
+  // when the caller says the YUYV carries counts.
+  ASSERT_TRUE(ChooseV4l2Mode(modes, true, true, 256, 384, &chosen));
+  EXPECT_EQ(chosen.fourcc, static_cast<uint32_t>(V4L2_PIX_FMT_YUYV));
+  ASSERT_TRUE(ChooseV4l2Mode(modes, true, false, 256, 384, &chosen));
+  EXPECT_EQ(chosen.fourcc, static_cast<uint32_t>(V4L2_PIX_FMT_Y16));
+  EXPECT_FALSE(ChooseV4l2Mode({Mode(V4L2_PIX_FMT_XBGR32, 640, 480, 30)}, true,
+                              true, 0, 0, &chosen));
+}
+
+TEST(V4l2DeviceTest, OpenRejectsMissingAndNonVideoNodes) {
+  V4l2Device device;
+  EXPECT_FALSE(device.Open("/dev/does-not-exist"));
+  EXPECT_EQ(device.last_error(), ENOENT);
+  EXPECT_FALSE(device.Open("/dev/null"));
+  EXPECT_FALSE(device.is_open());
+}
+
+// The remaining tests need the vivid virtual capture driver:
+//   sudo modprobe vivid n_devs=1 node_types=0x1
+class VividTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    for (const V4l2DeviceInfo &info : EnumerateV4l2Devices()) {
+      if (info.driver == "vivid") {
+        path_ = info.path;
+        break;
+      }
+    }
+    if (path_.empty()) GTEST_SKIP() << "vivid is not loaded";
+    ASSERT_TRUE(device_.Open(path_)) << device_.last_error();
+    ASSERT_TRUE(device_.SetFormat(V4L2_PIX_FMT_XBGR32, 640, 360));
+  }
+
+  // Streams |frames| frames and checks their sequence numbers and sizes.
+  void StreamFrames(int frames) {
+    uint32_t last_sequence = 0;
+    for (int i = 0; i < frames; i++) {
+      V4l2Buffer buffer;
+      ASSERT_EQ(device_.Dequeue(2000, &buffer),
+                V4l2Device::WaitResult::kFrame);
+      ASSERT_NE(buffer.data, nullptr);
+      EXPECT_EQ(buffer.bytes_used, device_.size_image());
+      if (i > 0) EXPECT_GT(buffer.sequence, last_sequence);
+      last_sequence = buffer.sequence;
+      ASSERT_TRUE(device_.Requeue(buffer));
+    }
+  }
+
+  std::string path_;
+  V4l2Device device_;
+};
+
+TEST_F(VividTest, ListsModesIncludingBgraAndY16) {
+  bool bgra = false, y16 = false;
+  for (const V4l2FrameMode &mode : device_.EnumerateModes()) {
+    bgra |= mode.fourcc == V4L2_PIX_FMT_XBGR32;
+    y16 |= mode.fourcc == V4L2_PIX_FMT_Y16;
+    EXPECT_GT(mode.width, 0u);
+  }
+  EXPECT_TRUE(bgra);
+  EXPECT_TRUE(y16);
+}
+
+TEST_F(VividTest, StreamsWithMmapBuffers) {
+  ASSERT_TRUE(device_.StartStreaming(V4l2IoMode::kMmap));
+  EXPECT_EQ(device_.io_mode(), V4l2IoMode::kMmap);
+  StreamFrames(10);
+  device_.StopStreaming();
+  // Restartable on the same handle.
+  ASSERT_TRUE(device_.StartStreaming(V4l2IoMode::kMmap));
+  StreamFrames(3);
+}
+
+TEST_F(VividTest, StreamsWithDmabufOrFallsBackToMmap) {
+  ASSERT_TRUE(device_.StartStreaming(V4l2IoMode::kDmabuf));
+  StreamFrames(10);
+}
+
+TEST_F(VividTest, InterruptWakesBlockedDequeue) {
+  ASSERT_TRUE(device_.StartStreaming(V4l2IoMode::kMmap));
+  // Hold every buffer so the next Dequeue() can only block.
+  std::vector<V4l2Buffer> held;
+  for (;;) {
+    V4l2Buffer buffer;
+    if (device_.Dequeue(500, &buffer) != V4l2Device::WaitResult::kFrame) break;
+    held.push_back(buffer);
+  }
+  std::thread waker([this] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    device_.Interrupt();
+  });
+  const auto start = std::chrono::steady_clock::now();
+  V4l2Buffer buffer;
+  EXPECT_EQ(device_.Dequeue(5000, &buffer),
+            V4l2Device::WaitResult::kInterrupted);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+  waker.join();
+  for (const V4l2Buffer &b : held) device_.Requeue(b);
+}
+
+}  // namespace
+}  // namespace uvc
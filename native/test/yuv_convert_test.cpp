@@ -0,0 +1,331 @@
+#include "yuv_convert.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "pixel_convert.h"
+
+namespace uvc {
+namespace {
+
+// Straight from the definitions: normalise Y'CbCr, apply the matrix,
+// round to nearest. Floating point, so independent of the fixed-point
+// kernels.
+void ReferenceYuvToRgb(int y, int u, int v, YuvColorSpace cs, uint8_t *rgb) {
+  const bool bt709 = cs.matrix == YuvMatrix::kBt709;
+  const bool limited = cs.range == YuvRange::kLimited;
+  const double kr = bt709 ? 0.2126 : 0.299;
+  const double kb = bt709 ? 0.0722 : 0.114;
+  const double kg = 1.0 - kr - kb;
+  const double ey = limited ? (y - 16) / 219.0 : y / 255.0;
+  const double pb = (u - 128) / (limited ? 224.0 : 255.0);
+  const double pr = (v - 128) / (limited ? 224.0 : 255.0);
+  const double r = ey + 2 * (1 - kr) * pr;
+  const double g =
+      ey - 2 * kb * (1 - kb) / kg * pb - 2 * kr * (1 - kr) / kg * pr;
+  const double b = ey + 2 * (1 - kb) * pb;
+  const double rgb_f[3] = {r, g, b};
+  for (int i = 0; i < 3; i++) {
+    rgb[i] = static_cast<uint8_t>(
+        std::min(255.0, std::max(0.0, std::round(rgb_f[i] * 255.0))));
+  }
+}
+
+std::vector<SimdLevel> SupportedLevels() {
+  std::vector<SimdLevel> levels = {SimdLevel::kScalar};
+  const SimdLevel detected = DetectSimdLevel();
+  if (detected == SimdLevel::kNeon) {
+    levels.push_back(SimdLevel::kNeon);
+  } else {
+    for (int l = 1; l <= static_cast<int>(detected); l++) {
+      levels.push_back(static_cast<SimdLevel>(l));
+    }
+  }
+  return levels;
+}
+
+std::vector<uint8_t> RandomBytes(size_t size, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::vector<uint8_t> bytes(size);
+  for (auto &b : bytes) b = static_cast<uint8_t>(rng());
+  return bytes;
+}
+
+const YuvColorSpace kColorSpaces[] = {
+    {YuvMatrix::kBt601, YuvRange::kLimited},
+    {YuvMatrix::kBt601, YuvRange::kFull},
+    {YuvMatrix::kBt709, YuvRange::kLimited},
+    {YuvMatrix::kBt709, YuvRange::kFull},
+};
+
+// Largest per-channel difference from the reference, given the Y, U, V of
+// every output pixel.
+int MaxReferenceError(const std::vector<uint8_t> &rgba,
+                      const std::vector<int> &yuv, YuvColorSpace cs) {
+  int worst = 0;
+  for (size_t i = 0; i < rgba.size() / 4; i++) {
+    uint8_t expected[3];
+    ReferenceYuvToRgb(yuv[i * 3], yuv[i * 3 + 1], yuv[i * 3 + 2], cs,
+                      expected);
+    for (int c = 0; c < 3; c++) {
+      worst = std::max(worst, std::abs(rgba[i * 4 + c] - expected[c]));
+    }
+    if (rgba[i * 4 + 3] != 255) return 256;
+  }
+  return worst;
+}
+
+// One YUYV pair per colour, both pixels the same.
+std::vector<uint8_t> Pair(uint8_t y, uint8_t u, uint8_t v) {
+  return {y, u, y, v};
+}
+
+TEST(YuvConvertTest, LimitedRangeEndpointsAndPrimaries) {
+  struct Case {
+    uint8_t y, u, v;
+    uint8_t r, g, b;
+  };
+  const Case cases[] = {
+      {16, 128, 128, 0, 0, 0},        // Black.
+      {235, 128, 128, 255, 255, 255},  // White.
+      {81, 90, 240, 255, 0, 0},        // BT.601 red.
+      {145, 54, 34, 0, 255, 0},        // BT.601 green.
+      {41, 240, 110, 0, 0, 255},       // BT.601 blue.
+  };
+  for (const Case &c : cases) {
+    const auto src = Pair(c.y, c.u, c.v);
+    uint8_t dst[8];
+    ConvertYuyvToRgba(src.data(), 4, dst, 8, 2, 1);
+    EXPECT_NEAR(dst[0], c.r, 2) << int(c.y);
+    EXPECT_NEAR(dst[1], c.g, 2) << int(c.y);
+    EXPECT_NEAR(dst[2], c.b, 2) << int(c.y);
+    EXPECT_EQ(dst[3], 255);
+    EXPECT_EQ(0, std::memcmp(dst, dst + 4, 4)) << "same chroma, same luma";
+  }
+}
+
+TEST(YuvConvertTest, HonoursStridesAndOddWidth) {
+  // Three pixels: a full pair and a half pair, in rows padded to 8 bytes.
+  const std::vector<uint8_t> src = {16, 128, 235, 128, 235, 128, 0, 128,
+                                    235, 128, 16, 128, 16, 128, 0, 128};
+  std::vector<uint8_t> dst(2 * 16, 0xEE);
+  ConvertYuyvToRgba(src.data(), 8, dst.data(), 16, 3, 2);
+  EXPECT_EQ(dst[0], 0);
+  EXPECT_EQ(dst[4], 255);
+  EXPECT_EQ(dst[8], 255);
+  EXPECT_EQ(dst[12], 0xEE) << "past the last pixel";
+  EXPECT_EQ(dst[16], 255);
+  EXPECT_EQ(dst[20], 0);
+  EXPECT_EQ(dst[24], 0);
+}
+
+TEST(YuvConvertTest, Bt709AndFullRangePrimaries) {
+  uint8_t dst[8];
+  // BT.709 limited-range 75% colour bars would hide rounding; use 100% red.
+  const auto red709 = Pair(63, 102, 240);
+  ConvertYuyvToRgba(red709.data(), 4, dst, 8, 2, 1,
+                    {YuvMatrix::kBt709, YuvRange::kLimited});
+  EXPECT_NEAR(dst[0], 255, 1);
+  EXPECT_NEAR(dst[1], 0, 1);
+  EXPECT_NEAR(dst[2], 0, 1);
+  // JPEG (BT.601 full range) red, and full-range black and white.
+  const auto red_jpeg = Pair(76, 85, 255);
+  ConvertYuyvToRgba(red_jpeg.data(), 4, dst, 8, 2, 1,
+                    {YuvMatrix::kBt601, YuvRange::kFull});
+  EXPECT_NEAR(dst[0], 254, 2);
+  EXPECT_NEAR(dst[1], 0, 1);
+  EXPECT_NEAR(dst[2], 0, 1);
+  const std::vector<uint8_t> grey = {0, 128, 255, 128};
+  ConvertYuyvToRgba(grey.data(), 4, dst, 8, 2, 1,
+                    {YuvMatrix::kBt709, YuvRange::kFull});
+  EXPECT_EQ(dst[0], 0);
+  EXPECT_EQ(dst[2], 0);
+  EXPECT_EQ(dst[4], 255);
+  EXPECT_EQ(dst[6], 255);
+}
+
+class YuvKernelTest : public ::testing::TestWithParam<SimdLevel> {};
+
+TEST_P(YuvKernelTest, PackedMatchesReferenceAndScalar) {
+  const size_t height = 3;
+  for (const YuvColorSpace &cs : kColorSpaces) {
+    for (size_t width = 1; width <= 70; width++) {
+      const size_t pairs = (width + 1) / 2;
+      const auto yuyv = RandomBytes(pairs * 4 * height,
+                                    static_cast<uint32_t>(width));
+      // The same pixels as UYVY.
+      std::vector<uint8_t> uyvy(yuyv.size());
+      for (size_t i = 0; i < yuyv.size(); i += 4) {
+        uyvy[i] = yuyv[i + 1];
+        uyvy[i + 1] = yuyv[i];
+        uyvy[i + 2] = yuyv[i + 3];
+        uyvy[i + 3] = yuyv[i + 2];
+      }
+      std::vector<int> yuv;
+      for (size_t r = 0; r < height; r++) {
+        const uint8_t *s = yuyv.data() + r * pairs * 4;
+        for (size_t x = 0; x < width; x++) {
+          const uint8_t *pair = s + (x / 2) * 4;
+          yuv.insert(yuv.end(), {pair[(x % 2) * 2], pair[1], pair[3]});
+        }
+      }
+      const ptrdiff_t src_stride = static_cast<ptrdiff_t>(pairs * 4);
+      const ptrdiff_t dst_stride = static_cast<ptrdiff_t>(width * 4);
+      std::vector<uint8_t> scalar(width * height * 4);
+      ConvertYuyvToRgbaWithLevel(SimdLevel::kScalar, yuyv.data(), src_stride,
+                                 scalar.data(), dst_stride, width, height, cs);
+      ASSERT_LE(MaxReferenceError(scalar, yuv, cs), 1) << "width " << width;
+
+      std::vector<uint8_t> actual(width * height * 4, 0xCD);
+      ConvertYuyvToRgbaWithLevel(GetParam(), yuyv.data(), src_stride,
+                                 actual.data(), dst_stride, width, height, cs);
+      ASSERT_EQ(scalar, actual) << "YUYV width " << width;
+      std::fill(actual.begin(), actual.end(), 0xCD);
+      ConvertUyvyToRgbaWithLevel(GetParam(), uyvy.data(), src_stride,
+                                 actual.data(), dst_stride, width, height, cs);
+      ASSERT_EQ(scalar, actual) << "UYVY width " << width;
+    }
+  }
+}
+
+TEST_P(YuvKernelTest, Nv12MatchesReferenceAndScalar) {
+  for (const YuvColorSpace &cs : kColorSpaces) {
+    for (size_t width = 1; width <= 70; width++) {
+      // Odd heights give the last luma row a chroma row of its own.
+      const size_t height = 1 + width % 4;
+      const size_t chroma_width = (width + 1) / 2 * 2;
+      const ptrdiff_t y_stride = static_cast<ptrdiff_t>(width + 5);
+      const ptrdiff_t uv_stride = static_cast<ptrdiff_t>(chroma_width + 3);
+      const auto luma = RandomBytes(y_stride * height,
+                                    static_cast<uint32_t>(width));
+      const auto chroma = RandomBytes(uv_stride * ((height + 1) / 2),
+                                      static_cast<uint32_t>(width + 1000));
+      std::vector<int> yuv;
+      for (size_t r = 0; r < height; r++) {
+        const uint8_t *uv = chroma.data() + (r / 2) * uv_stride;
+        for (size_t x = 0; x < width; x++) {
+          yuv.insert(yuv.end(), {luma[r * y_stride + x], uv[x / 2 * 2],
+                                 uv[x / 2 * 2 + 1]});
+        }
+      }
+      const ptrdiff_t dst_stride = static_cast<ptrdiff_t>(width * 4);
+      std::vector<uint8_t> scalar(width * height * 4);
+      ConvertNv12ToRgbaWithLevel(SimdLevel::kScalar, luma.data(), y_stride,
+                                 chroma.data(), uv_stride, scalar.data(),
+                                 dst_stride, width, height, cs);
+      ASSERT_LE(MaxReferenceError(scalar, yuv, cs), 1) << "width " << width;
+
+      std::vector<uint8_t> actual(width * height * 4, 0xCD);
+      ConvertNv12ToRgbaWithLevel(GetParam(), luma.data(), y_stride,
+                                 chroma.data(), uv_stride, actual.data(),
+                                 dst_stride, width, height, cs);
+      ASSERT_EQ(scalar, actual) << "width " << width;
+    }
+  }
+}
+
+TEST_P(YuvKernelTest, SaturatesOutOfGamutInput) {
+  // Every Y with extreme chroma: the int16 packing must clamp, not wrap.
+  std::vector<uint8_t> yuyv;
+  for (int y = 0; y < 256; y += 2) {
+    for (int c : {0, 255}) {
+      yuyv.insert(yuyv.end(), {static_cast<uint8_t>(y),
+                               static_cast<uint8_t>(c),
+                               static_cast<uint8_t>(y + 1),
+                               static_cast<uint8_t>(255 - c)});
+    }
+  }
+  const size_t width = yuyv.size() / 2;
+  for (const YuvColorSpace &cs : kColorSpaces) {
+    std::vector<uint8_t> scalar(width * 4);
+    std::vector<uint8_t> actual(width * 4);
+    ConvertYuyvToRgbaWithLevel(SimdLevel::kScalar, yuyv.data(), 0,
+                               scalar.data(), 0, width, 1, cs);
+    ConvertYuyvToRgbaWithLevel(GetParam(), yuyv.data(), 0, actual.data(), 0,
+                               width, 1, cs);
+    EXPECT_EQ(scalar, actual);
+  }
+}
+
+TEST_P(YuvKernelTest, WalksBottomUpBufferWithNegativeStride) {
+  const size_t width = 37, height = 6;
+  const ptrdiff_t stride = 19 * 4;
+  const auto src = RandomBytes(stride * height, 11);
+  std::vector<uint8_t> expected(width * height * 4);
+  std::vector<uint8_t> actual(width * height * 4);
+  const uint8_t *last_row = src.data() + stride * (height - 1);
+  ConvertYuyvToRgbaWithLevel(SimdLevel::kScalar, last_row, -stride,
+                             expected.data(), width * 4, width, height);
+  ConvertYuyvToRgbaWithLevel(GetParam(), last_row, -stride, actual.data(),
+                             width * 4, width, height);
+  EXPECT_EQ(expected, actual);
+  for (size_t r = 0; r < height; r++) {
+    std::vector<uint8_t> row(width * 4);
+    ConvertYuyvToRgbaWithLevel(SimdLevel::kScalar,
+                               src.data() + stride * (height - 1 - r), stride,
+                               row.data(), width * 4, width, 1);
+    EXPECT_TRUE(std::equal(row.begin(), row.end(),
+                           expected.begin() + r * width * 4));
+  }
+}
+
+TEST_P(YuvKernelTest, CurveMatchesASecondPass) {
+  const auto curve = RandomBytes(256, 7);
+  for (size_t width = 1; width <= 70; width++) {
+    const size_t height = 3;
+    const size_t pairs = (width + 1) / 2;
+    const ptrdiff_t packed_stride = static_cast<ptrdiff_t>(pairs * 4);
+    const ptrdiff_t dst_stride = static_cast<ptrdiff_t>(width * 4);
+    const auto packed = RandomBytes(packed_stride * height,
+                                    static_cast<uint32_t>(width));
+    std::vector<uint8_t> expected(width * height * 4);
+    std::vector<uint8_t> actual(width * height * 4, 0xCD);
+    ConvertYuyvToRgbaWithLevel(SimdLevel::kScalar, packed.data(),
+                               packed_stride, expected.data(), dst_stride,
+                               width, height);
+    ApplyCurveToRgba(expected.data(), dst_stride, width, height, curve.data());
+    ConvertYuyvToRgbaWithLevel(GetParam(), packed.data(), packed_stride,
+                               actual.data(), dst_stride, width, height,
+                               YuvColorSpace(), curve.data());
+    ASSERT_EQ(expected, actual) << "YUYV width " << width;
+
+    ConvertUyvyToRgbaWithLevel(SimdLevel::kScalar, packed.data(),
+                               packed_stride, expected.data(), dst_stride,
+                               width, height);
+    ApplyCurveToRgba(expected.data(), dst_stride, width, height, curve.data());
+    std::fill(actual.begin(), actual.end(), 0xCD);
+    ConvertUyvyToRgbaWithLevel(GetParam(), packed.data(), packed_stride,
+                               actual.data(), dst_stride, width, height,
+                               YuvColorSpace(), curve.data());
+    ASSERT_EQ(expected, actual) << "UYVY width " << width;
+
+    // The first row's bytes double as the UV plane.
+    const ptrdiff_t y_stride = static_cast<ptrdiff_t>(width + 1);
+    ConvertNv12ToRgbaWithLevel(SimdLevel::kScalar, packed.data(), y_stride,
+                               packed.data(), packed_stride, expected.data(),
+                               dst_stride, width, height);
+    ApplyCurveToRgba(expected.data(), dst_stride, width, height, curve.data());
+    std::fill(actual.begin(), actual.end(), 0xCD);
+    ConvertNv12ToRgbaWithLevel(GetParam(), packed.data(), y_stride,
+                               packed.data(), packed_stride, actual.data(),
+                               dst_stride, width, height, YuvColorSpace(),
+                               curve.data());
+    ASSERT_EQ(expected, actual) << "NV12 width " << width;
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    AllLevels, YuvKernelTest, ::testing::ValuesIn(SupportedLevels()),
+    [](const ::testing::TestParamInfo<SimdLevel> &info) {
+      return std::string(SimdLevelName(info.param));
+    });
+
+}  // namespace
+}  // namespace uvc
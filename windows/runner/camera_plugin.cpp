@@ -1,12 +1,34 @@
 #include "camera_plugin.h"
 
 #include <windows.h>
+#include <dbt.h>
 #include <mfapi.h>
 #include <mfidl.h>
 #include <mfreadwrite.h>
 #include <shlwapi.h>
-#include <thread>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
 #include <iostream>
+#include <utility>
+
+#include "agc.h"
+#include "bad_pixels.h"
+#include "burst_recorder.h"
+#include "capture_worker.h"
+#include "format_negotiation.h"
+#include "frame_ring.h"
+#include "nuc.h"
+#include "pipeline_stats.h"
+#include "pixel_convert.h"
+#include "raw_convert.h"
+#include "roi_engine.h"
+#include "replay_source.h"
+#include "temporal_denoise.h"
+#include "thermal_palette.h"
+#include "tone_curve.h"
+#include "virtual_camera.h"
+#include "yuv_convert.h"
 
 #pragma comment(lib, "mf.lib")
 #pragma comment(lib, "mfplat.lib")
@@ -22,6 +44,247 @@ template <class T> void SafeRelease(T **ppT) {
     }
 }
 
+// FOURCC subtypes used by radiometric cameras that mfapi.h does not declare.
+// Media Foundation video subtypes are the FOURCC in Data1 of a fixed GUID.
+static GUID FourccSubtype(DWORD fourcc) {
+    GUID subtype = {fourcc, 0x0000, 0x0010, {0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71}};
+    return subtype;
+}
+
+static uvc::VideoSubtype VideoSubtypeFromGuid(const GUID &subtype) {
+    if (IsEqualGUID(subtype, FourccSubtype(MAKEFOURCC('Y', '1', '6', ' '))) ||
+        IsEqualGUID(subtype, MFVideoFormat_L16)) {
+        return uvc::VideoSubtype::kY16;
+    }
+    if (IsEqualGUID(subtype, FourccSubtype(MAKEFOURCC('Y', '1', '4', ' ')))) {
+        return uvc::VideoSubtype::kY14;
+    }
+    if (IsEqualGUID(subtype, MFVideoFormat_NV12)) {
+        return uvc::VideoSubtype::kNv12;
+    }
+    if (IsEqualGUID(subtype, MFVideoFormat_YUY2)) {
+        return uvc::VideoSubtype::kYuy2;
+    }
+    if (IsEqualGUID(subtype, MFVideoFormat_UYVY)) {
+        return uvc::VideoSubtype::kUyvy;
+    }
+    if (IsEqualGUID(subtype, MFVideoFormat_MJPG)) {
+        return uvc::VideoSubtype::kMjpg;
+    }
+    if (IsEqualGUID(subtype, MFVideoFormat_RGB32)) {
+        return uvc::VideoSubtype::kRgb32;
+    }
+    return uvc::VideoSubtype::kUnknown;
+}
+
+// Layout of a colour subtype converted in the capture loop.
+static uvc::SourcePixelFormat SourceFormatForSubtype(uvc::VideoSubtype subtype) {
+    switch (subtype) {
+    case uvc::VideoSubtype::kYuy2:
+        return uvc::SourcePixelFormat::kYuyv;
+    case uvc::VideoSubtype::kUyvy:
+        return uvc::SourcePixelFormat::kUyvy;
+    case uvc::VideoSubtype::kNv12:
+        return uvc::SourcePixelFormat::kNv12;
+    case uvc::VideoSubtype::kMjpg:
+        return uvc::SourcePixelFormat::kMjpeg;
+    default:
+        return uvc::SourcePixelFormat::kBgra32;
+    }
+}
+
+// |raw_yuy2|: whether the camera's YUY2 carries counts rather than colour,
+// see uvc::FormatRequest::raw_yuy2.
+static uvc::RawPacking RawPackingForSubtype(uvc::VideoSubtype subtype, bool raw_yuy2) {
+    switch (subtype) {
+    case uvc::VideoSubtype::kY16:
+        return uvc::RawPacking::kY16;
+    case uvc::VideoSubtype::kY14:
+        return uvc::RawPacking::kY14;
+    case uvc::VideoSubtype::kYuy2:
+        return raw_yuy2 ? uvc::RawPacking::kYuy2Raw16 : uvc::RawPacking::kNone;
+    default:
+        return uvc::RawPacking::kNone;
+    }
+}
+
+// Adds video type |pType| to |capabilities|; |native_index| is its index in
+// the stream's native type list.
+static void AddCapability(uvc::CapabilityIndex *capabilities, IMFMediaType *pType, DWORD native_index) {
+    GUID major_type = GUID_NULL, subtype = GUID_NULL;
+    pType->GetMajorType(&major_type);
+    pType->GetGUID(MF_MT_SUBTYPE, &subtype);
+    if (!IsEqualGUID(major_type, MFMediaType_Video)) {
+        return;
+    }
+    uvc::Capability capability;
+    capability.subtype = VideoSubtypeFromGuid(subtype);
+    MFGetAttributeSize(pType, MF_MT_FRAME_SIZE, &capability.width, &capability.height);
+    MFGetAttributeRatio(pType, MF_MT_FRAME_RATE, &capability.rate.numerator, &capability.rate.denominator);
+    capability.native_index = native_index;
+    if (capability.width > 0 && capability.height > 0) {
+        capabilities->Add(capability);
+    }
+}
+
+// Picks the native type for a preview, see uvc::NegotiatePreviewFormat().
+// NV12, YUY2, UYVY and RGB32 are converted in the capture loop, and MJPG
+// decoded by mjpeg_ when built with libjpeg; anything else goes through the
+// video processor.
+static bool NegotiateMediaType(const uvc::CapabilityIndex &capabilities, bool raw_mode, bool raw_yuy2, UINT32 width,
+                               UINT32 height, const uvc::FrameRate &rate, uvc::NegotiatedFormat *format) {
+    uvc::FormatRequest request;
+    request.width = width;
+    request.height = height;
+    request.rate = rate;
+    request.raw = raw_mode;
+    request.raw_yuy2 = raw_yuy2;
+    request.direct_subtypes = uvc::SubtypeBit(uvc::VideoSubtype::kNv12) | uvc::SubtypeBit(uvc::VideoSubtype::kYuy2) |
+                              uvc::SubtypeBit(uvc::VideoSubtype::kUyvy) | uvc::SubtypeBit(uvc::VideoSubtype::kRgb32);
+#if defined(UVC_HAVE_JPEG)
+    request.direct_subtypes |= uvc::SubtypeBit(uvc::VideoSubtype::kMjpg);
+#endif
+    request.processor = true;
+    return uvc::NegotiatePreviewFormat(capabilities, request, format);
+}
+
+// One getSupportedResolutions entry. frameRate is the rounded rate for
+// older callers; fpsNumerator / fpsDenominator are exact.
+static flutter::EncodableValue ResolutionValue(const uvc::Capability &capability) {
+    const uvc::FrameRate rate = capability.rate.known() ? capability.rate.Reduced() : uvc::FrameRate{30, 1};
+    flutter::EncodableMap resMap;
+    resMap[flutter::EncodableValue("width")] = flutter::EncodableValue((int)capability.width);
+    resMap[flutter::EncodableValue("height")] = flutter::EncodableValue((int)capability.height);
+    resMap[flutter::EncodableValue("frameRate")] = flutter::EncodableValue((int)(rate.ToDouble() + 0.5));
+    resMap[flutter::EncodableValue("fpsNumerator")] = flutter::EncodableValue((int)rate.numerator);
+    resMap[flutter::EncodableValue("fpsDenominator")] = flutter::EncodableValue((int)rate.denominator);
+    resMap[flutter::EncodableValue("subtype")] = flutter::EncodableValue(std::string(uvc::VideoSubtypeName(capability.subtype)));
+    return flutter::EncodableValue(resMap);
+}
+
+// Posted to the top-level window when a worker queued a platform task.
+static constexpr UINT kPlatformTaskMessage = WM_APP + 0x51;
+
+// How long CloseDevice() waits for the capture thread before reporting it.
+static constexpr std::chrono::milliseconds kStopTimeout(500);
+
+// KSCATEGORY_CAPTURE, the device interface class of video capture devices.
+// Registering for it makes Windows send WM_DEVICECHANGE arrival and removal
+// messages for cameras.
+static const GUID kCaptureInterfaceClass = {0x65e8773d, 0x8f56, 0x11d0, {0xa3, 0xb9, 0x00, 0xa0, 0xc9, 0x22, 0x31, 0x96}};
+
+static std::string Utf8FromWide(const WCHAR *text, UINT32 length) {
+    int size_needed = WideCharToMultiByte(CP_UTF8, 0, text, (int)length, nullptr, 0, nullptr, nullptr);
+    std::string utf8(size_needed, 0);
+    WideCharToMultiByte(CP_UTF8, 0, text, (int)length, &utf8[0], size_needed, nullptr, nullptr);
+    return utf8;
+}
+
+static std::string AllocatedString(IMFActivate *activate, REFGUID key) {
+    WCHAR *value = nullptr;
+    UINT32 length = 0;
+    std::string utf8;
+    if (SUCCEEDED(activate->GetAllocatedString(key, &value, &length)) && value) {
+        utf8 = Utf8FromWide(value, length);
+        CoTaskMemFree(value);
+    }
+    return utf8;
+}
+
+// Lists the Media Foundation video capture devices for the device registry.
+// Each entry keeps a reference to the device's IMFActivate.
+class MediaFoundationEnumerator : public uvc::DeviceEnumerator {
+public:
+    bool Enumerate(std::vector<uvc::DeviceEntry> *devices) override {
+        IMFAttributes *pAttributes = nullptr;
+        IMFActivate **ppDevices = nullptr;
+        UINT32 count = 0;
+
+        HRESULT hr = MFCreateAttributes(&pAttributes, 1);
+        if (SUCCEEDED(hr)) {
+            hr = pAttributes->SetGUID(
+                MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE,
+                MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID
+            );
+        }
+
+        if (SUCCEEDED(hr)) {
+            hr = MFEnumDeviceSources(pAttributes, &ppDevices, &count);
+        }
+
+        if (SUCCEEDED(hr)) {
+            for (UINT32 i = 0; i < count; i++) {
+                uvc::DeviceEntry entry;
+                entry.name = AllocatedString(ppDevices[i], MF_DEVSOURCE_ATTRIBUTE_FRIENDLY_NAME);
+                entry.id = AllocatedString(ppDevices[i], MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_SYMBOLIC_LINK);
+                if (entry.name.empty()) {
+                    // Still listed, so indices match what OpenDevice() opens.
+                    entry.name = "Camera " + std::to_string(i + 1);
+                }
+                // The entry takes over the enumeration's reference.
+                entry.handle = std::shared_ptr<void>(ppDevices[i], [](void *activate) {
+                    static_cast<IMFActivate *>(activate)->Release();
+                });
+                devices->push_back(std::move(entry));
+            }
+            CoTaskMemFree(ppDevices);
+        }
+
+        SafeRelease(&pAttributes);
+        return SUCCEEDED(hr);
+    }
+};
+
+// An integer argument as the standard codec decodes it: int32 or int64.
+static bool IntValue(const flutter::EncodableValue &value, int64_t *out) {
+    if (const auto *value32 = std::get_if<int32_t>(&value)) {
+        *out = *value32;
+    } else if (const auto *value64 = std::get_if<int64_t>(&value)) {
+        *out = *value64;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// The ROIs of a setRois call: a list of {id, shape, points}, with the
+// points as a flat [x0, y0, x1, y1, ...] list. False on a malformed entry.
+static bool ParseRois(const flutter::EncodableList &list, std::vector<uvc::Roi> *rois) {
+    for (size_t i = 0; i < list.size(); i++) {
+        const auto *entry = std::get_if<flutter::EncodableMap>(&list[i]);
+        if (!entry) {
+            return false;
+        }
+        uvc::Roi roi;
+        int64_t id = static_cast<int64_t>(i);
+        auto id_it = entry->find(flutter::EncodableValue("id"));
+        if (id_it != entry->end()) {
+            IntValue(id_it->second, &id);
+        }
+        roi.id = static_cast<int32_t>(id);
+        auto shape_it = entry->find(flutter::EncodableValue("shape"));
+        auto points_it = entry->find(flutter::EncodableValue("points"));
+        const auto *shape = shape_it != entry->end() ? std::get_if<std::string>(&shape_it->second) : nullptr;
+        const auto *points = points_it != entry->end() ? std::get_if<flutter::EncodableList>(&points_it->second) : nullptr;
+        if (!shape || !points || !uvc::ParseRoiShape(*shape, &roi.shape) || points->size() % 2 != 0) {
+            return false;
+        }
+        for (size_t j = 0; j < points->size(); j += 2) {
+            int64_t x = 0, y = 0;
+            if (!IntValue((*points)[j], &x) || !IntValue((*points)[j + 1], &y)) {
+                return false;
+            }
+            roi.points.push_back({static_cast<int32_t>(x), static_cast<int32_t>(y)});
+        }
+        rois->push_back(std::move(roi));
+    }
+    return true;
+}
+
+static int64_t ElapsedNs(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
 void CameraPlugin::RegisterWithRegistrar(flutter::PluginRegistrarWindows *registrar) {
   auto plugin = std::make_unique<CameraPlugin>(registrar);
 
@@ -36,23 +299,76 @@ void CameraPlugin::RegisterWithRegistrar(flutter::PluginRegistrarWindows *regist
         plugin_ptr->HandleMethodCall(call, std::move(result));
       });
 
+  auto roi_channel =
+      std::make_unique<flutter::EventChannel<flutter::EncodableValue>>(
+          registrar->messenger(),
+          "com.example.uvc_viewer/roi",
+          &flutter::StandardMethodCodec::GetInstance());
+  roi_channel->SetStreamHandler(
+      std::make_unique<flutter::StreamHandlerFunctions<flutter::EncodableValue>>(
+          [plugin_ptr = plugin.get()](const flutter::EncodableValue *arguments,
+                                      std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> &&events)
+              -> std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> {
+            plugin_ptr->OnRoiListen(std::move(events));
+            return nullptr;
+          },
+          [plugin_ptr = plugin.get()](const flutter::EncodableValue *arguments)
+              -> std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> {
+            plugin_ptr->OnRoiCancel();
+            return nullptr;
+          }));
+
   registrar->AddPlugin(std::move(plugin));
 }
 
 CameraPlugin::CameraPlugin(flutter::PluginRegistrarWindows *registrar)
     : registrar_(registrar), 
-      texture_registrar_(registrar->texture_registrar()) {
+      texture_registrar_(registrar->texture_registrar()),
+      devices_(std::make_unique<uvc::DeviceRegistry>(std::make_unique<MediaFoundationEnumerator>())),
+      virtual_cameras_(uvc::VirtualCamerasFromEnvironment()) {
     InitializeMediaFoundation();
     memset(&flutter_pixel_buffer_, 0, sizeof(flutter_pixel_buffer_));
+    window_proc_id_ = registrar->RegisterTopLevelWindowProcDelegate(
+        [this](HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam) {
+            return HandleWindowProc(hwnd, message, wparam, lparam);
+        });
 }
 
 CameraPlugin::~CameraPlugin() {
-    is_reading_ = false;
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    registrar_->UnregisterTopLevelWindowProcDelegate(window_proc_id_);
+    if (device_notify_) {
+        UnregisterDeviceNotification(device_notify_);
+    }
     CloseDevice(nullptr);
+    // The cached activation objects must go before Media Foundation does.
+    devices_.reset();
     MFShutdown();
 }
 
+std::optional<LRESULT> CameraPlugin::HandleWindowProc(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam) {
+    // Camera arrival and removal are only reported to windows that asked.
+    // The plugin is registered before its view is parented, so this is the
+    // first point at which the top-level window is known.
+    if (!device_notify_) {
+        DEV_BROADCAST_DEVICEINTERFACE filter = {};
+        filter.dbcc_size = sizeof(filter);
+        filter.dbcc_devicetype = DBT_DEVTYP_DEVICEINTERFACE;
+        filter.dbcc_classguid = kCaptureInterfaceClass;
+        device_notify_ = RegisterDeviceNotification(hwnd, &filter, DEVICE_NOTIFY_WINDOW_HANDLE);
+    }
+    if (message == WM_DEVICECHANGE &&
+        (wparam == DBT_DEVICEARRIVAL || wparam == DBT_DEVICEREMOVECOMPLETE)) {
+        // Enumerated again on the next lookup. Not handled, so the window
+        // still forwards the event to Dart.
+        devices_->Invalidate();
+    }
+    if (message == kPlatformTaskMessage) {
+        RunPlatformTasks();
+        return 0;
+    }
+    return std::nullopt;
+}
+
 HRESULT CameraPlugin::InitializeMediaFoundation() {
     return MFStartup(MF_VERSION);
 }
@@ -75,78 +391,199 @@ void CameraPlugin::HandleMethodCall(
     GetSupportedResolutions(args, std::move(result));
   } else if (method_call.method_name().compare("capturePhoto") == 0) {
     CapturePhoto(std::move(result));
-  } else if (method_call.method_name().compare("setBrightness") == 0) {
-      result->Success();
-  } else if (method_call.method_name().compare("setContrast") == 0) {
-      result->Success();
+  } else if (method_call.method_name().compare("captureToFile") == 0) {
+    const auto *args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    CaptureToFile(args, std::move(result));
+  } else if (method_call.method_name().compare("captureBurst") == 0) {
+    const auto *args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    CaptureBurst(args, std::move(result));
+  } else if (method_call.method_name().compare("setPalette") == 0) {
+    const auto *args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    SetPalette(args, std::move(result));
+  } else if (method_call.method_name().compare("setAgc") == 0) {
+    const auto *args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    SetAgc(args, std::move(result));
+  } else if (method_call.method_name().compare("setDenoise") == 0) {
+    const auto *args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    SetDenoise(args, std::move(result));
+  } else if (method_call.method_name().compare("setNuc") == 0) {
+    const auto *args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    SetNuc(args, std::move(result));
+  } else if (method_call.method_name().compare("captureNucReference") == 0) {
+    const auto *args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    CaptureNucReference(args, std::move(result));
+  } else if (method_call.method_name().compare("computeNuc") == 0) {
+    const auto *args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    ComputeNuc(args, std::move(result));
+  } else if (method_call.method_name().compare("loadNuc") == 0) {
+    const auto *args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    LoadNuc(args, std::move(result));
+  } else if (method_call.method_name().compare("setBadPixels") == 0) {
+    const auto *args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    SetBadPixels(args, std::move(result));
+  } else if (method_call.method_name().compare("scanBadPixels") == 0) {
+    const auto *args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    ScanBadPixels(args, std::move(result));
+  } else if (method_call.method_name().compare("setRois") == 0) {
+    const auto *args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    SetRois(args, std::move(result));
+  } else if (method_call.method_name().compare("setFrameStream") == 0) {
+    const auto *args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    SetFrameStream(args, std::move(result));
+  } else if (method_call.method_name().compare("getFrameRing") == 0) {
+    GetFrameRing(std::move(result));
+  } else if (method_call.method_name().compare("getPipelineStats") == 0) {
+    const auto *args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    GetPipelineStats(args, std::move(result));
+  } else if (method_call.method_name().compare("setBrightness") == 0 ||
+             method_call.method_name().compare("setContrast") == 0 ||
+             method_call.method_name().compare("setGamma") == 0) {
+    const auto *args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    SetTone(method_call.method_name(), args, std::move(result));
   } else {
     result->NotImplemented();
   }
 }
 
 void CameraPlugin::EnumerateDevices(std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
-    IMFAttributes *pAttributes = nullptr;
-    IMFActivate **ppDevices = nullptr;
-    UINT32 count = 0;
-
-    HRESULT hr = MFCreateAttributes(&pAttributes, 1);
-    if (SUCCEEDED(hr)) {
-        hr = pAttributes->SetGUID(
-            MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE,
-            MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID
-        );
+    const std::shared_ptr<const uvc::DeviceSnapshot> snapshot = devices_->Get();
+    if (!snapshot->ok) {
+        result->Error("ENUM_FAILED", "Failed to enumerate devices");
+        return;
     }
 
-    if (SUCCEEDED(hr)) {
-        hr = MFEnumDeviceSources(pAttributes, &ppDevices, &count);
+    flutter::EncodableList devices;
+    for (const uvc::DeviceEntry &entry : snapshot->devices) {
+        devices.push_back(flutter::EncodableValue(entry.name));
     }
-
-    if (SUCCEEDED(hr)) {
-        flutter::EncodableList devices;
-        for (UINT32 i = 0; i < count; i++) {
-            WCHAR *szFriendlyName = nullptr;
-            UINT32 cchName;
-            hr = ppDevices[i]->GetAllocatedString(
-                MF_DEVSOURCE_ATTRIBUTE_FRIENDLY_NAME,
-                &szFriendlyName, 
-                &cchName
-            );
-
-            if (SUCCEEDED(hr) && szFriendlyName) {
-                int size_needed = WideCharToMultiByte(CP_UTF8, 0, szFriendlyName, (int)cchName, nullptr, 0, nullptr, nullptr);
-                std::string strTo(size_needed, 0);
-                WideCharToMultiByte(CP_UTF8, 0, szFriendlyName, (int)cchName, &strTo[0], size_needed, nullptr, nullptr);
-                devices.push_back(flutter::EncodableValue(strTo));
-                CoTaskMemFree(szFriendlyName);
-            }
-            SafeRelease(&ppDevices[i]);
-        }
-        CoTaskMemFree(ppDevices);
-        result->Success(devices);
-    } else {
-        result->Error("ENUM_FAILED", "Failed to enumerate devices");
+    // Virtual cameras follow the real ones, see OpenDevice().
+    for (const uvc::VirtualCameraSpec &spec : virtual_cameras_) {
+        devices.push_back(flutter::EncodableValue(uvc::VirtualCameraName(spec)));
     }
-    
-    SafeRelease(&pAttributes);
+    result->Success(devices);
 }
 
 void CameraPlugin::StartPreview(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
     int index = 0;
+    bool raw_mode = false;
+    // Whether the camera's YUY2 carries counts; colour webcams offer YUY2
+    // too, so raw mode leaves it to the colour path unless told otherwise.
+    bool raw_yuy2 = false;
+    bool skip_unconsumed = false;
+    // Pre-trigger history for captureBurst; 0 keeps none.
+    int64_t burst_buffer_mb = 0;
+    uvc::BurstEviction burst_eviction = uvc::BurstEviction::kOldest;
+    UINT32 width = 0, height = 0;
+    UINT32 max_preview_width = 0, max_preview_height = 0;
+    uvc::FrameRate rate;
     if (args) {
         auto index_it = args->find(flutter::EncodableValue("index"));
         if (index_it != args->end()) {
             index = std::get<int>(index_it->second);
         }
+        auto raw_it = args->find(flutter::EncodableValue("rawMode"));
+        if (raw_it != args->end() && std::holds_alternative<bool>(raw_it->second)) {
+            raw_mode = std::get<bool>(raw_it->second);
+        }
+        auto raw_yuy2_it = args->find(flutter::EncodableValue("rawYuy2"));
+        if (raw_yuy2_it != args->end() && std::holds_alternative<bool>(raw_yuy2_it->second)) {
+            raw_yuy2 = std::get<bool>(raw_yuy2_it->second);
+        }
+        auto skip_it = args->find(flutter::EncodableValue("skipUnconsumed"));
+        if (skip_it != args->end() && std::holds_alternative<bool>(skip_it->second)) {
+            skip_unconsumed = std::get<bool>(skip_it->second);
+        }
+        auto burst_it = args->find(flutter::EncodableValue("burstBufferMb"));
+        if (burst_it != args->end()) {
+            burst_buffer_mb = burst_it->second.LongValue();
+        }
+        auto eviction_it = args->find(flutter::EncodableValue("burstEviction"));
+        if (eviction_it != args->end() && std::holds_alternative<std::string>(eviction_it->second) &&
+            !uvc::ParseBurstEviction(std::get<std::string>(eviction_it->second), &burst_eviction)) {
+            result->Error("INVALID_ARGUMENT", "Unknown burst eviction policy");
+            return;
+        }
+        auto width_it = args->find(flutter::EncodableValue("width"));
+        auto height_it = args->find(flutter::EncodableValue("height"));
+        if (width_it != args->end() && height_it != args->end()) {
+            width = static_cast<UINT32>(std::get<int>(width_it->second));
+            height = static_cast<UINT32>(std::get<int>(height_it->second));
+        }
+        auto max_width_it = args->find(flutter::EncodableValue("maxPreviewWidth"));
+        auto max_height_it = args->find(flutter::EncodableValue("maxPreviewHeight"));
+        if (max_width_it != args->end() && max_height_it != args->end()) {
+            max_preview_width = static_cast<UINT32>(std::get<int>(max_width_it->second));
+            max_preview_height = static_cast<UINT32>(std::get<int>(max_height_it->second));
+        }
+        auto fps_num_it = args->find(flutter::EncodableValue("fpsNumerator"));
+        auto fps_den_it = args->find(flutter::EncodableValue("fpsDenominator"));
+        if (fps_num_it != args->end() && fps_den_it != args->end()) {
+            rate.numerator = static_cast<uint32_t>(fps_num_it->second.LongValue());
+            rate.denominator = static_cast<uint32_t>(fps_den_it->second.LongValue());
+        }
     }
 
     CloseDevice(nullptr);
 
-    HRESULT hr = OpenDevice(index);
+    HRESULT hr = OpenDevice(index, raw_mode, raw_yuy2, width, height, rate);
     if(FAILED(hr)) {
         result->Error("OPEN_FAILED", "Failed to open device");
         return;
     }
 
+    // Three frames can sit in preview_frames_, one is being converted and the
+    // rest absorb snapshots holding on to a frame.
+    uvc::FrameFormat format;
+    format.pixel_format = uvc::PixelFormat::kRgba8;
+    format.width = static_cast<uint32_t>(video_width_);
+    format.height = static_cast<uint32_t>(video_height_);
+#if defined(UVC_HAVE_JPEG)
+    // MJPEG is decoded at the smallest 1/8 scale that covers the preview.
+    uvc::MjpegPipelineOptions mjpeg_options;
+    if (pixel_format_ == uvc::SourcePixelFormat::kMjpeg) {
+        mjpeg_options.decode.target_width = max_preview_width;
+        mjpeg_options.decode.target_height = max_preview_height;
+        uvc::MjpegOutputSize(format.width, format.height, mjpeg_options.decode, &format.width, &format.height);
+    }
+#else
+    (void)max_preview_width;
+    (void)max_preview_height;
+#endif
+    bool pools_ready = frame_pool_.Configure(format, 5, 8);
+    if (pools_ready && raw_packing_ != uvc::RawPacking::kNone) {
+        // Raw frames are only held by the capture thread and latest_.
+        format.pixel_format = uvc::PixelFormat::kGray16;
+        pools_ready = raw_pool_.Configure(format, 3, 6);
+    }
+    if (!pools_ready) {
+        CloseDevice(nullptr);
+        result->Error("OUT_OF_MEMORY", "Failed to allocate frame buffers");
+        return;
+    }
+    // Both wait for a burst still being written from the previous session.
+    const uvc::SourceMode burst_mode = BurstMode();
+    if (burst_buffer_mb <= 0 || burst_mode.format == uvc::SourcePixelFormat::kMjpeg) {
+        burst_.Reset();
+    } else if (!burst_.Configure(burst_mode, static_cast<size_t>(burst_buffer_mb) << 20, burst_eviction)) {
+        std::cerr << "No burst buffer: " << burst_buffer_mb << " MB hold fewer than "
+                  << uvc::BurstRecorder::kMinFrames << " frames of " << video_width_ << "x" << video_height_ << std::endl;
+    }
+    // The frame stream carries the counts only when asked to in raw mode.
+    uvc::FrameFormat ring_format = format;
+    if (!frame_ring_config_.raw || raw_packing_ == uvc::RawPacking::kNone) {
+        ring_format.pixel_format = uvc::PixelFormat::kRgba8;
+    }
+    frame_ring_.Configure(frame_ring_config_, ring_format);
+    // Another device's map would replace good pixels.
+    LoadBadPixelMap();
+    // A new device or mode has a different scene range.
+    agc_.Reset();
+    denoise_.Reset();
+    stats_.Reset();
+    stats_.OnSourceRestarted();
+    notifier_.Reset();
+    skip_unconsumed_ = skip_unconsumed;
+
     // Create texture variant with callback
     texture_variant_ = std::make_unique<flutter::TextureVariant>(
         flutter::PixelBufferTexture([this](size_t width, size_t height) -> const FlutterDesktopPixelBuffer* {
@@ -154,58 +591,119 @@ void CameraPlugin::StartPreview(const flutter::EncodableMap *args, std::unique_p
         })
     );
     texture_id_ = texture_registrar_->RegisterTexture(texture_variant_.get());
-    
-    is_reading_ = true;
-    std::thread([this]() {
-        this->ReadSampleLoop();
-    }).detach();
+
+#if defined(UVC_HAVE_JPEG)
+    if (pixel_format_ == uvc::SourcePixelFormat::kMjpeg) {
+        mjpeg_.Start(mjpeg_options, &frame_pool_, [this](uvc::FrameRef frame) {
+            PublishConverted(std::move(frame), uvc::FrameRef());
+        });
+    }
+#endif
+    if (frame_source_) {
+        capture_worker_.Start([this]() { this->ReadSourceLoop(); },
+                              [this]() { frame_source_->Interrupt(); });
+    } else {
+        // A synchronous ReadSample() cannot be cancelled; shutting the media
+        // source down makes it fail at once, and CloseDevice() releases the
+        // source right after anyway.
+        capture_worker_.Start([this]() { this->ReadSampleLoop(); },
+                              [this]() { media_source_->Shutdown(); });
+    }
 
     result->Success(flutter::EncodableValue(texture_id_));
 }
 
-HRESULT CameraPlugin::OpenDevice(int index) {
-    IMFAttributes *pAttributes = nullptr;
-    IMFActivate **ppDevices = nullptr;
-    UINT32 count = 0;
-    HRESULT hr = S_OK;
+HRESULT CameraPlugin::OpenDevice(int index, bool raw_mode, bool raw_yuy2, UINT32 width, UINT32 height,
+                                 const uvc::FrameRate &rate) {
+    raw_packing_ = uvc::RawPacking::kNone;
+    pixel_format_ = uvc::SourcePixelFormat::kBgra32;
+    frame_rate_ = uvc::FrameRate();
+    bad_pixel_key_.clear();
 
-    hr = MFCreateAttributes(&pAttributes, 1);
-    
-    if (SUCCEEDED(hr)) {
-        hr = pAttributes->SetGUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE, MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID);
-    }
-    
-    if (SUCCEEDED(hr)) {
-        hr = MFEnumDeviceSources(pAttributes, &ppDevices, &count);
-    }
+    const std::shared_ptr<const uvc::DeviceSnapshot> devices = devices_->Get();
+    const UINT32 count = static_cast<UINT32>(devices->devices.size());
+    HRESULT hr = devices->ok ? S_OK : E_FAIL;
 
-    if (SUCCEEDED(hr) && (UINT32)index < count) {
-        hr = ppDevices[index]->ActivateObject(IID_PPV_ARGS(&media_source_));
-    } else if ((UINT32)index >= count) {
-        hr = E_FAIL;
+    if (SUCCEEDED(hr) && index >= 0 && (UINT32)index < count) {
+        IMFActivate *activate = static_cast<IMFActivate *>(devices->devices[index].handle.get());
+        hr = activate->ActivateObject(IID_PPV_ARGS(&media_source_));
+        if (SUCCEEDED(hr)) {
+            // Kept so CloseDevice() can shut the source down through it; a
+            // cached activation object hands out the same source until then.
+            device_activate_ = activate;
+            device_activate_->AddRef();
+            open_device_id_ = devices->devices[index].id;
+            bad_pixel_key_ = open_device_id_;
+        }
+    } else if (SUCCEEDED(hr)) {
+        // Virtual cameras are numbered after the Media Foundation devices.
+        hr = index >= 0 ? OpenVirtualCamera(static_cast<size_t>(index) - count) : E_FAIL;
     }
 
-    if (SUCCEEDED(hr)) {
+    if (SUCCEEDED(hr) && media_source_) {
+        // Processing only engages for an output type the camera does not
+        // deliver natively, see kProcessor below.
         IMFAttributes *pReaderAttributes = nullptr;
         MFCreateAttributes(&pReaderAttributes, 1);
         pReaderAttributes->SetUINT32(MF_SOURCE_READER_ENABLE_VIDEO_PROCESSING, 1);
-        
+
         hr = MFCreateSourceReaderFromMediaSource(media_source_, pReaderAttributes, &source_reader_);
         SafeRelease(&pReaderAttributes);
+
+        uvc::CapabilityIndex capabilities;
+        for (DWORD i = 0; SUCCEEDED(hr); i++) {
+            IMFMediaType *pType = nullptr;
+            if (FAILED(source_reader_->GetNativeMediaType((DWORD)MF_SOURCE_READER_FIRST_VIDEO_STREAM, i, &pType))) {
+                break;  // MF_E_NO_MORE_TYPES
+            }
+            AddCapability(&capabilities, pType, i);
+            SafeRelease(&pType);
+        }
+
+        uvc::NegotiatedFormat format;
+        if (SUCCEEDED(hr) && !NegotiateMediaType(capabilities, raw_mode, raw_yuy2, width, height, rate, &format)) {
+            hr = MF_E_INVALIDMEDIATYPE;
+        }
+        if (SUCCEEDED(hr)) {
+            IMFMediaType *pNativeType = nullptr;
+            hr = source_reader_->GetNativeMediaType((DWORD)MF_SOURCE_READER_FIRST_VIDEO_STREAM,
+                                                    format.native.native_index, &pNativeType);
+            if (SUCCEEDED(hr)) {
+                hr = source_reader_->SetCurrentMediaType((DWORD)MF_SOURCE_READER_FIRST_VIDEO_STREAM, nullptr, pNativeType);
+            }
+            SafeRelease(&pNativeType);
+        }
+        if (SUCCEEDED(hr) && format.path == uvc::FormatPath::kProcessor) {
+            // Same size and rate as the native type, so the reader keeps it
+            // and only inserts the decoder / colour converter.
+            IMFMediaType *pType = nullptr;
+            MFCreateMediaType(&pType);
+            pType->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video);
+            pType->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_RGB32);
+            MFSetAttributeSize(pType, MF_MT_FRAME_SIZE, format.native.width, format.native.height);
+            if (format.native.rate.known()) {
+                MFSetAttributeRatio(pType, MF_MT_FRAME_RATE, format.native.rate.numerator, format.native.rate.denominator);
+            }
+            hr = source_reader_->SetCurrentMediaType((DWORD)MF_SOURCE_READER_FIRST_VIDEO_STREAM, nullptr, pType);
+            SafeRelease(&pType);
+        }
+        if (SUCCEEDED(hr)) {
+            frame_rate_ = format.native.rate;
+            switch (format.path) {
+            case uvc::FormatPath::kRaw:
+                raw_packing_ = RawPackingForSubtype(format.native.subtype, raw_yuy2);
+                break;
+            case uvc::FormatPath::kDirect:
+                pixel_format_ = SourceFormatForSubtype(format.native.subtype);
+                break;
+            case uvc::FormatPath::kProcessor:
+                break;
+            }
+        }
     }
-    
-    if (SUCCEEDED(hr)) {
-        IMFMediaType *pType = nullptr;
-        MFCreateMediaType(&pType);
-        pType->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video);
-        pType->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_RGB32);
-        
-        hr = source_reader_->SetCurrentMediaType((DWORD)MF_SOURCE_READER_FIRST_VIDEO_STREAM, nullptr, pType);
-        SafeRelease(&pType);
-    }
-    
+
     // Get the actual media type to determine video dimensions
-    if (SUCCEEDED(hr)) {
+    if (SUCCEEDED(hr) && source_reader_) {
         IMFMediaType *pCurrentType = nullptr;
         hr = source_reader_->GetCurrentMediaType((DWORD)MF_SOURCE_READER_FIRST_VIDEO_STREAM, &pCurrentType);
         if (SUCCEEDED(hr) && pCurrentType) {
@@ -219,18 +717,51 @@ HRESULT CameraPlugin::OpenDevice(int index) {
         }
     }
 
-    // Clean up enumeration
-    for (UINT32 i = 0; i < count; i++) {
-        SafeRelease(&ppDevices[i]);
-    }
-    CoTaskMemFree(ppDevices);
-    SafeRelease(&pAttributes);
-
     return hr;
 }
 
+HRESULT CameraPlugin::OpenVirtualCamera(size_t index) {
+    if (index >= virtual_cameras_.size()) {
+        return E_FAIL;
+    }
+    std::unique_ptr<uvc::FrameSource> source = uvc::CreateVirtualCamera(virtual_cameras_[index]);
+    if (!source || !source->Start()) {
+        return E_FAIL;
+    }
+    // 16-bit virtual cameras always go through the raw path and AGC.
+    const uvc::SourceMode mode = source->mode();
+    raw_packing_ = uvc::RawPackingForMode(mode);
+    pixel_format_ = mode.format;
+    frame_rate_ = uvc::FrameRate{mode.fps_numerator, mode.fps_denominator};
+    video_width_ = mode.width;
+    video_height_ = mode.height;
+    bad_pixel_key_ = uvc::VirtualCameraName(virtual_cameras_[index]);
+    frame_source_ = std::move(source);
+    return S_OK;
+}
+
 void CameraPlugin::CloseDevice(std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
-    is_reading_ = false;
+    // The capture thread must be gone before the reader or source it uses is
+    // released. Waking it is immediate, so the deadline only catches a
+    // driver call that is stuck.
+    if (!capture_worker_.Stop(kStopTimeout)) {
+        std::cerr << "Capture thread did not stop within " << kStopTimeout.count() << " ms" << std::endl;
+        capture_worker_.Join();
+    }
+#if defined(UVC_HAVE_JPEG)
+    // Frames being decoded still reach the texture, so it goes after this.
+    mjpeg_.Stop();
+#endif
+    frame_ring_.Close();
+    // A burst waiting for frames after its trigger gets no more, nor does a
+    // NUC reference capture or a bad-pixel scan.
+    burst_.EndWindow();
+    nuc_.Reset();
+    bad_pixels_.Reset();
+    if (frame_source_) {
+        frame_source_->Stop();
+        frame_source_.reset();
+    }
 
     if (texture_id_ != -1 && texture_registrar_) {
         texture_registrar_->UnregisterTexture(texture_id_);
@@ -240,6 +771,12 @@ void CameraPlugin::CloseDevice(std::unique_ptr<flutter::MethodResult<flutter::En
     
     SafeRelease(&source_reader_);
     SafeRelease(&media_source_);
+    if (device_activate_) {
+        device_activate_->ShutdownObject();
+        SafeRelease(&device_activate_);
+    }
+    open_device_id_.clear();
+    bad_pixel_key_.clear();
 
     if (result) {
         result->Success();
@@ -247,7 +784,9 @@ void CameraPlugin::CloseDevice(std::unique_ptr<flutter::MethodResult<flutter::En
 }
 
 void CameraPlugin::ReadSampleLoop() {
-    while (is_reading_ && source_reader_) {
+    // Media Foundation has no frame counter; samples are numbered here.
+    uint64_t sequence = 0;
+    while (!capture_worker_.stop_requested() && source_reader_) {
         IMFSample *pSample = nullptr;
         DWORD streamIndex, flags;
         LONGLONG llTimeStamp;
@@ -264,6 +803,10 @@ void CameraPlugin::ReadSampleLoop() {
         if (FAILED(hr)) {
             break;
         }
+        // A stream tick marks a gap where the camera delivered no sample.
+        if (flags & MF_SOURCE_READERF_STREAMTICK) {
+            sequence++;
+        }
 
         if (pSample) {
             IMFMediaBuffer *pBuffer = nullptr;
@@ -271,12 +814,14 @@ void CameraPlugin::ReadSampleLoop() {
             
             if (SUCCEEDED(hr) && pBuffer) {
                 BYTE *pData = nullptr;
-                DWORD cbMaxLength, cbCurrentLength;
+                DWORD cbMaxLength = 0, cbCurrentLength = 0;
                 LONG lPitch = 0;
                 
-                // Try to get 2D buffer interface for stride information
+                // Try to get 2D buffer interface for stride information;
+                // compressed frames are read by length instead.
                 IMF2DBuffer *p2DBuffer = nullptr;
-                hr = pBuffer->QueryInterface(IID_PPV_ARGS(&p2DBuffer));
+                hr = pixel_format_ == uvc::SourcePixelFormat::kMjpeg ? E_NOINTERFACE
+                                                                     : pBuffer->QueryInterface(IID_PPV_ARGS(&p2DBuffer));
                 
                 if (SUCCEEDED(hr) && p2DBuffer) {
                     BYTE *pScanline0 = nullptr;
@@ -288,40 +833,32 @@ void CameraPlugin::ReadSampleLoop() {
                     // Fallback to regular Lock
                     hr = pBuffer->Lock(&pData, &cbMaxLength, &cbCurrentLength);
                     // Assume default pitch if not available
-                    lPitch = static_cast<LONG>(video_width_ * 4); 
+                    size_t bytes_per_pixel =
+                        raw_packing_ != uvc::RawPacking::kNone ? 2 : uvc::SourceBytesPerPixel(pixel_format_);
+                    lPitch = static_cast<LONG>(video_width_ * bytes_per_pixel);
                 }
 
                 if (SUCCEEDED(hr) && pData) {
-                    std::lock_guard<std::mutex> lock(mutex_);
-                    
-                    size_t expected_size = video_width_ * video_height_ * 4;
-                    if (buffer_size_ != expected_size) {
-                        buffer_size_ = expected_size;
-                        pixel_buffer_ = std::make_unique<uint8_t[]>(buffer_size_);
-                    }
-
-                    // Handle stride (pitch) mismatch
-                    // Usually pitch can be negative (bottom-up) or positive (top-down)
-                    // We need abs(pitch) for copying
-                    LONG absPitch = lPitch > 0 ? lPitch : -lPitch;
-                    size_t rowBytes = video_width_ * 4;
-                    
-                    // Copy data and convert BGRA to RGBA
-                    uint8_t* src = pData;
-                    uint8_t* dst = pixel_buffer_.get();
-                    for (size_t y = 0; y < video_height_; y++) {
-                        for (size_t x = 0; x < video_width_; x++) {
-                            size_t srcIdx = x * 4;
-                            size_t dstIdx = x * 4;
-                            // BGRA -> RGBA: swap B and R
-                            dst[dstIdx + 0] = src[srcIdx + 2]; // R <- B
-                            dst[dstIdx + 1] = src[srcIdx + 1]; // G <- G
-                            dst[dstIdx + 2] = src[srcIdx + 0]; // B <- R
-                            dst[dstIdx + 3] = src[srcIdx + 3]; // A <- A
-                        }
-                        dst += rowBytes;
-                        src += absPitch;
+                    uvc::FrameInfo info;
+                    info.sequence = ++sequence;
+                    info.timestamp = llTimeStamp;
+                    stats_.OnFrameCaptured(info, uvc::SteadyNow100ns());
+#if defined(UVC_HAVE_JPEG)
+                    if (pixel_format_ != uvc::SourcePixelFormat::kMjpeg) {
+                        PublishFrame(pData, lPitch, info);
+                    } else if (SkipDisplay()) {
+                        stats_.OnSkippedUnconsumed();
+                    } else {
+                        // Copied out for the decode workers, which publish.
+                        // The curve goes with the frame; the decoder maps
+                        // the rows as it writes them.
+                        const bool toned = tone_.Update();
+                        mjpeg_.Submit(pData, cbCurrentLength, info,
+                                      toned ? tone_.curve() : nullptr);
                     }
+#else
+                    PublishFrame(pData, lPitch, info);
+#endif
 
                     if (p2DBuffer) {
                         p2DBuffer->Unlock2D();
@@ -330,25 +867,166 @@ void CameraPlugin::ReadSampleLoop() {
                         pBuffer->Unlock();
                     }
                 }
-                
+
                 pBuffer->Release();
-                
-                if (texture_registrar_ && texture_id_ != -1) {
-                    texture_registrar_->MarkTextureFrameAvailable(texture_id_);
-                }
             }
             pSample->Release();
         }
     }
 }
 
+void CameraPlugin::ReadSourceLoop() {
+    while (!capture_worker_.stop_requested()) {
+        uvc::SourceFrame source_frame;
+        const uvc::SourceStatus status = frame_source_->Next(-1, &source_frame);
+        if (status == uvc::SourceStatus::kError || status == uvc::SourceStatus::kEnd) {
+            break;
+        }
+        if (status != uvc::SourceStatus::kFrame) {
+            continue;
+        }
+        uvc::FrameInfo info;
+        info.sequence = source_frame.sequence;
+        info.timestamp = source_frame.timestamp;
+        stats_.OnFrameCaptured(info, uvc::SteadyNow100ns());
+        PublishFrame(source_frame.data, source_frame.stride, info);
+        frame_source_->Release(source_frame);
+    }
+}
+
+void CameraPlugin::PublishFrame(const uint8_t *data, ptrdiff_t pitch, const uvc::FrameInfo &info) {
+    // Every captured frame, also those the preview skips. Media Foundation
+    // timestamps are not on the steady clock captureBurst triggers on.
+    uvc::SourceFrame burst_frame;
+    burst_frame.data = data;
+    burst_frame.stride = pitch;
+    burst_frame.sequence = info.sequence;
+    burst_frame.timestamp = uvc::SteadyNow100ns();
+    burst_.Record(burst_frame);
+
+    // An empty handle means every slab is still referenced; the frame is
+    // dropped rather than waiting for one.
+    const auto convert_start = std::chrono::steady_clock::now();
+    uvc::FrameRef raw_frame;
+    if (raw_packing_ != uvc::RawPacking::kNone) {
+        raw_frame = raw_pool_.Acquire();
+        if (!raw_frame) {
+            stats_.OnPoolExhausted();
+            return;
+        }
+        CorrectCounts(data, pitch, raw_frame);
+        raw_frame.info() = info;
+        MeasureRois(raw_frame);
+        // A raw-mode ring takes the counts, whether or not they are shown.
+        frame_ring_.Write(raw_frame);
+    }
+
+    // The engine has yet to copy the last frame; converting this one for
+    // display would at best replace it unseen. The counts above are still
+    // corrected and measured: temporal denoise and the ROI stream need
+    // every frame.
+    if (SkipDisplay()) {
+        // Snapshots of the counts still move on with the ROI stream.
+        if (raw_frame) {
+            latest_.PublishCounts(std::move(raw_frame));
+        }
+        stats_.OnSkippedUnconsumed();
+        return;
+    }
+
+    uvc::FrameRef frame = frame_pool_.Acquire();
+    if (!frame) {
+        stats_.OnPoolExhausted();
+        return;
+    }
+    const ptrdiff_t stride = static_cast<ptrdiff_t>(frame.format().Stride());
+    const bool toned = tone_.Update();
+    // The YUV kernels map through the curve as they store.
+    const uint8_t *curve = toned ? tone_.curve() : nullptr;
+    if (raw_frame) {
+        // The tone curve is folded into the palette, so it costs no extra
+        // pass.
+        agc_.Process(reinterpret_cast<const uint16_t *>(raw_frame.data()), frame.format().width,
+                     frame.format().width, frame.format().height, tone_.Apply(palette_.table()),
+                     frame.data(), stride);
+    } else if (pixel_format_ == uvc::SourcePixelFormat::kYuyv) {
+        uvc::ConvertYuyvToRgba(data, pitch, frame.data(), stride,
+                               frame.format().width, frame.format().height,
+                               uvc::YuvColorSpace(), curve);
+    } else if (pixel_format_ == uvc::SourcePixelFormat::kUyvy) {
+        uvc::ConvertUyvyToRgba(data, pitch, frame.data(), stride,
+                               frame.format().width, frame.format().height,
+                               uvc::YuvColorSpace(), curve);
+    } else if (pixel_format_ == uvc::SourcePixelFormat::kNv12) {
+        // The UV plane follows the Y plane in the same buffer.
+        const uint8_t *uv = data + pitch * static_cast<ptrdiff_t>(frame.format().height);
+        uvc::ConvertNv12ToRgba(data, pitch, uv, pitch, frame.data(), stride,
+                               frame.format().width, frame.format().height,
+                               uvc::YuvColorSpace(), curve);
+    } else {
+        // |pitch| is signed: negative for bottom-up buffers, in which case
+        // scanline 0 is the last row in memory.
+        if (toned) {
+            uvc::ConvertBgraToRgbaLut(data, pitch, frame.data(), stride,
+                                      frame.format().width, frame.format().height,
+                                      tone_.swizzle_lut(), false);
+        } else {
+            uvc::ConvertBgraToRgba(data, pitch, frame.data(), stride,
+                                   frame.format().width, frame.format().height);
+        }
+    }
+    stats_.Record(uvc::PipelineStage::kConvert, ElapsedNs(convert_start));
+    frame.info() = info;
+    PublishConverted(std::move(frame), std::move(raw_frame));
+}
+
+bool CameraPlugin::SkipDisplay() const {
+    return skip_unconsumed_ && notifier_.Pending() &&
+           (!frame_ring_.memory() || frame_ring_.source().pixel_format == uvc::PixelFormat::kGray16);
+}
+
+void CameraPlugin::PublishConverted(uvc::FrameRef frame, uvc::FrameRef raw_frame) {
+    frame.info().published = uvc::SteadyNow100ns();
+    // Written unless the ring is in raw mode and took the counts already.
+    frame_ring_.Write(frame);
+    latest_.Publish(frame, std::move(raw_frame));
+    // Overwriting the back slot returns the frame it held (published but
+    // never shown) to the pool.
+    preview_frames_.WriteBuffer() = std::move(frame);
+    preview_frames_.Publish();
+    stats_.OnPublished();
+
+    // Frames published while a notification is outstanding are taken by
+    // the copy it triggers; the engine is told again once it has copied.
+    if (notifier_.Publish() && texture_registrar_ && texture_id_ != -1) {
+        texture_registrar_->MarkTextureFrameAvailable(texture_id_);
+        stats_.OnNotified();
+    }
+}
+
+void CameraPlugin::CorrectCounts(const uint8_t *data, ptrdiff_t pitch, uvc::FrameRef &raw_frame) {
+    const uvc::FrameFormat &format = raw_frame.format();
+    uint16_t *counts = reinterpret_cast<uint16_t *>(raw_frame.data());
+    uvc::UnpackRaw16(raw_packing_, data, pitch, counts, format.width, format.height);
+    // In place, so snapshots of the raw counts are corrected and denoised too.
+    nuc_.Process(counts, format.width, format.width, format.height);
+    bad_pixels_.Process(counts, format.width, format.width, format.height);
+    denoise_.Process(counts, format.width, format.width, format.height);
+}
+
 const FlutterDesktopPixelBuffer *CameraPlugin::CopyPixelBuffer(size_t width, size_t height) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (!pixel_buffer_) return nullptr;
+    // Only the raster thread consumes preview_frames_, so no lock is needed.
+    // The previous front frame is only released here, after the engine has
+    // finished uploading it.
+    notifier_.Consume();
+    const bool fresh = preview_frames_.Update();
+    const uvc::FrameRef &frame = preview_frames_.ReadBuffer();
+    if (!frame) return nullptr;
+    stats_.OnPresented(fresh, frame.info(), uvc::SteadyNow100ns());
     
-    flutter_pixel_buffer_.buffer = pixel_buffer_.get();
-    flutter_pixel_buffer_.width = video_width_;
-    flutter_pixel_buffer_.height = video_height_;
+    flutter_pixel_buffer_.buffer = frame.data();
+    flutter_pixel_buffer_.width = frame.format().width;
+    flutter_pixel_buffer_.height = frame.format().height;
     
     return &flutter_pixel_buffer_;
 }
@@ -362,104 +1040,81 @@ void CameraPlugin::GetDeviceStatus(const flutter::EncodableMap *args, std::uniqu
         }
     }
 
-    IMFAttributes *pAttributes = nullptr;
-    IMFActivate **ppDevices = nullptr;
-    UINT32 count = 0;
-
-    HRESULT hr = MFCreateAttributes(&pAttributes, 1);
-    if (SUCCEEDED(hr)) {
-        hr = pAttributes->SetGUID(
-            MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE,
-            MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID
-        );
-    }
-
-    if (SUCCEEDED(hr)) {
-        hr = MFEnumDeviceSources(pAttributes, &ppDevices, &count);
-    }
-
+    // A cached lookup: the list is only enumerated again after a hot-plug
+    // notification, so polling this is cheap.
+    const std::shared_ptr<const uvc::DeviceSnapshot> devices = devices_->Get();
+    const size_t count = devices->devices.size();
     flutter::EncodableMap statusMap;
-    
-    if (SUCCEEDED(hr)) {
-        bool isConnected = (UINT32)index < count;
-        bool isAvailable = false;
-        std::string deviceName;
 
-        if (isConnected) {
-            // Try to get the device name to verify it's still accessible
-            WCHAR *szFriendlyName = nullptr;
-            UINT32 cchName;
-            HRESULT nameHr = ppDevices[index]->GetAllocatedString(
-                MF_DEVSOURCE_ATTRIBUTE_FRIENDLY_NAME,
-                &szFriendlyName,
-                &cchName
-            );
-            
-            if (SUCCEEDED(nameHr) && szFriendlyName) {
-                isAvailable = true;
-                int size_needed = WideCharToMultiByte(CP_UTF8, 0, szFriendlyName, (int)cchName, nullptr, 0, nullptr, nullptr);
-                deviceName.resize(size_needed);
-                WideCharToMultiByte(CP_UTF8, 0, szFriendlyName, (int)cchName, &deviceName[0], size_needed, nullptr, nullptr);
-                CoTaskMemFree(szFriendlyName);
-            }
+    if (devices->ok) {
+        bool isConnected = false;
+        std::string deviceName;
+        if (index >= 0 && static_cast<size_t>(index) < count) {
+            isConnected = true;
+            deviceName = devices->devices[index].name;
+        } else if (index >= 0 && static_cast<size_t>(index) - count < virtual_cameras_.size()) {
+            isConnected = true;
+            deviceName = uvc::VirtualCameraName(virtual_cameras_[index - count]);
         }
 
         statusMap[flutter::EncodableValue("isConnected")] = flutter::EncodableValue(isConnected);
-        statusMap[flutter::EncodableValue("isAvailable")] = flutter::EncodableValue(isAvailable);
-        statusMap[flutter::EncodableValue("deviceCount")] = flutter::EncodableValue((int)count);
+        statusMap[flutter::EncodableValue("isAvailable")] = flutter::EncodableValue(isConnected);
+        statusMap[flutter::EncodableValue("deviceCount")] = flutter::EncodableValue((int)(count + virtual_cameras_.size()));
         if (!deviceName.empty()) {
             statusMap[flutter::EncodableValue("deviceName")] = flutter::EncodableValue(deviceName);
         }
-
-        // Clean up device list
-        for (UINT32 i = 0; i < count; i++) {
-            SafeRelease(&ppDevices[i]);
-        }
-        CoTaskMemFree(ppDevices);
     } else {
         statusMap[flutter::EncodableValue("isConnected")] = flutter::EncodableValue(false);
         statusMap[flutter::EncodableValue("isAvailable")] = flutter::EncodableValue(false);
         statusMap[flutter::EncodableValue("error")] = flutter::EncodableValue("Failed to enumerate devices");
     }
 
-    SafeRelease(&pAttributes);
     result->Success(flutter::EncodableValue(statusMap));
 }
 
 void CameraPlugin::GetSupportedResolutions(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
     int index = 0;
+    bool raw_mode = false;
+    bool raw_yuy2 = false;
     if (args) {
         auto index_it = args->find(flutter::EncodableValue("index"));
         if (index_it != args->end()) {
             index = std::get<int>(index_it->second);
         }
+        auto raw_it = args->find(flutter::EncodableValue("rawMode"));
+        if (raw_it != args->end() && std::holds_alternative<bool>(raw_it->second)) {
+            raw_mode = std::get<bool>(raw_it->second);
+        }
+        auto raw_yuy2_it = args->find(flutter::EncodableValue("rawYuy2"));
+        if (raw_yuy2_it != args->end() && std::holds_alternative<bool>(raw_yuy2_it->second)) {
+            raw_yuy2 = std::get<bool>(raw_yuy2_it->second);
+        }
     }
 
-    IMFAttributes *pAttributes = nullptr;
-    IMFActivate **ppDevices = nullptr;
-    UINT32 count = 0;
+    const std::shared_ptr<const uvc::DeviceSnapshot> devices = devices_->Get();
+    const UINT32 count = static_cast<UINT32>(devices->devices.size());
     flutter::EncodableList resolutions;
+    HRESULT hr = devices->ok ? S_OK : E_FAIL;
 
-    HRESULT hr = MFCreateAttributes(&pAttributes, 1);
-    if (SUCCEEDED(hr)) {
-        hr = pAttributes->SetGUID(
-            MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE,
-            MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID
-        );
-    }
-
-    if (SUCCEEDED(hr)) {
-        hr = MFEnumDeviceSources(pAttributes, &ppDevices, &count);
-    }
-
-    if (SUCCEEDED(hr) && (UINT32)index < count) {
+    if (SUCCEEDED(hr) && index >= 0 && (UINT32)index < count) {
+        IMFActivate *activate = static_cast<IMFActivate *>(devices->devices[index].handle.get());
+        // The open device is queried through its running source; activating
+        // it again would hand out that same source, which must not be shut
+        // down here.
+        const bool is_open = media_source_ && devices->devices[index].id == open_device_id_;
         IMFMediaSource *pSource = nullptr;
-        hr = ppDevices[index]->ActivateObject(IID_PPV_ARGS(&pSource));
+        if (is_open) {
+            pSource = media_source_;
+            pSource->AddRef();
+        } else {
+            hr = activate->ActivateObject(IID_PPV_ARGS(&pSource));
+        }
         
         if (SUCCEEDED(hr)) {
             IMFPresentationDescriptor *pPD = nullptr;
             hr = pSource->CreatePresentationDescriptor(&pPD);
             
+            uvc::CapabilityIndex capabilities;
             if (SUCCEEDED(hr)) {
                 DWORD streamCount = 0;
                 pPD->GetStreamDescriptorCount(&streamCount);
@@ -480,44 +1135,8 @@ void CameraPlugin::GetSupportedResolutions(const flutter::EncodableMap *args, st
                             for (DWORD j = 0; j < typeCount; j++) {
                                 IMFMediaType *pType = nullptr;
                                 pHandler->GetMediaTypeByIndex(j, &pType);
-                                
                                 if (pType) {
-                                    GUID majorType;
-                                    pType->GetMajorType(&majorType);
-                                    
-                                    if (IsEqualGUID(majorType, MFMediaType_Video)) {
-                                        UINT32 width = 0, height = 0;
-                                        MFGetAttributeSize(pType, MF_MT_FRAME_SIZE, &width, &height);
-                                        
-                                        UINT32 numerator = 0, denominator = 1;
-                                        MFGetAttributeRatio(pType, MF_MT_FRAME_RATE, &numerator, &denominator);
-                                        int frameRate = denominator > 0 ? (int)(numerator / denominator) : 30;
-                                        
-                                        if (width > 0 && height > 0) {
-                                            flutter::EncodableMap resMap;
-                                            resMap[flutter::EncodableValue("width")] = flutter::EncodableValue((int)width);
-                                            resMap[flutter::EncodableValue("height")] = flutter::EncodableValue((int)height);
-                                            resMap[flutter::EncodableValue("frameRate")] = flutter::EncodableValue(frameRate);
-                                            
-                                            // Avoid duplicates
-                                            bool exists = false;
-                                            for (const auto& r : resolutions) {
-                                                const auto& m = std::get<flutter::EncodableMap>(r);
-                                                auto w_it = m.find(flutter::EncodableValue("width"));
-                                                auto h_it = m.find(flutter::EncodableValue("height"));
-                                                if (w_it != m.end() && h_it != m.end()) {
-                                                    if (std::get<int>(w_it->second) == (int)width && 
-                                                        std::get<int>(h_it->second) == (int)height) {
-                                                        exists = true;
-                                                        break;
-                                                    }
-                                                }
-                                            }
-                                            if (!exists) {
-                                                resolutions.push_back(flutter::EncodableValue(resMap));
-                                            }
-                                        }
-                                    }
+                                    AddCapability(&capabilities, pType, j);
                                     pType->Release();
                                 }
                             }
@@ -528,31 +1147,692 @@ void CameraPlugin::GetSupportedResolutions(const flutter::EncodableMap *args, st
                 }
                 pPD->Release();
             }
-            pSource->Shutdown();
             pSource->Release();
+            if (!is_open) {
+                activate->ShutdownObject();
+            }
+
+            // Each size is reported with the type and exact rate
+            // startPreview would open for it.
+            for (const auto &size : capabilities.Sizes()) {
+                uvc::NegotiatedFormat format;
+                if (NegotiateMediaType(capabilities, raw_mode, raw_yuy2, size.first, size.second, uvc::FrameRate(),
+                                       &format) &&
+                    format.native.width == size.first && format.native.height == size.second) {
+                    resolutions.push_back(ResolutionValue(format.native));
+                }
+            }
         }
     }
 
-    // Clean up
-    for (UINT32 i = 0; i < count; i++) {
-        SafeRelease(&ppDevices[i]);
+    if (SUCCEEDED(hr) && index >= 0 && (UINT32)index >= count) {
+        // A virtual camera has exactly one mode.
+        const size_t virtual_index = static_cast<size_t>(index) - count;
+        std::unique_ptr<uvc::FrameSource> source =
+            virtual_index < virtual_cameras_.size() ? uvc::CreateVirtualCamera(virtual_cameras_[virtual_index]) : nullptr;
+        if (source) {
+            resolutions.push_back(ResolutionValue(uvc::CapabilityForMode(source->mode())));
+        }
     }
-    CoTaskMemFree(ppDevices);
-    SafeRelease(&pAttributes);
 
     result->Success(flutter::EncodableValue(resolutions));
 }
 
+void CameraPlugin::SetPalette(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+    const std::string *name = nullptr;
+    if (args) {
+        auto palette_it = args->find(flutter::EncodableValue("palette"));
+        if (palette_it != args->end()) {
+            name = std::get_if<std::string>(&palette_it->second);
+        }
+    }
+
+    uvc::ThermalPalette palette;
+    if (!name || !uvc::ParseThermalPalette(name->c_str(), &palette)) {
+        result->Error("INVALID_PALETTE", "Unknown palette");
+        return;
+    }
+
+    // Takes effect from the next raw frame; the capture thread is not paused.
+    palette_.Select(palette);
+    result->Success();
+}
+
+void CameraPlugin::SetTone(const std::string &method, const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+    double value = -1;
+    if (args) {
+        auto value_it = args->find(flutter::EncodableValue("value"));
+        if (value_it != args->end()) {
+            if (const auto *number = std::get_if<double>(&value_it->second)) {
+                value = *number;
+            }
+        }
+    }
+
+    uvc::ToneSettings settings = tone_.settings();
+    if (method == "setBrightness") {
+        settings.brightness = value;
+    } else if (method == "setContrast") {
+        settings.contrast = value;
+    } else {
+        settings.gamma = value;
+    }
+    if (!settings.IsValid()) {
+        result->Error("INVALID_ARGUMENT", "value out of range");
+        return;
+    }
+    // Taken up by the capture thread at its next frame, without a lock.
+    tone_.Set(settings);
+    result->Success();
+}
+
+void CameraPlugin::SetAgc(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+    // Keys that are absent keep their current value.
+    uvc::AgcConfig config = agc_.config();
+    if (args) {
+        auto mode_it = args->find(flutter::EncodableValue("mode"));
+        if (mode_it != args->end()) {
+            const auto *name = std::get_if<std::string>(&mode_it->second);
+            if (!name || !uvc::ParseAgcMode(name->c_str(), &config.mode)) {
+                result->Error("INVALID_AGC_MODE", "Unknown AGC mode");
+                return;
+            }
+        }
+        const std::pair<const char *, float *> values[] = {
+            {"smoothing", &config.smoothing},
+            {"plateau", &config.plateau},
+            {"clipLow", &config.clip_low},
+            {"clipHigh", &config.clip_high},
+        };
+        for (const auto &value : values) {
+            auto it = args->find(flutter::EncodableValue(value.first));
+            if (it != args->end()) {
+                if (const auto *number = std::get_if<double>(&it->second)) {
+                    *value.second = static_cast<float>(*number);
+                }
+            }
+        }
+    }
+
+    agc_.SetConfig(config);
+    result->Success();
+}
+
+void CameraPlugin::SetDenoise(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+    // Keys that are absent keep their current value.
+    uvc::DenoiseConfig config = denoise_.config();
+    if (args) {
+        auto enabled_it = args->find(flutter::EncodableValue("enabled"));
+        if (enabled_it != args->end() && std::holds_alternative<bool>(enabled_it->second)) {
+            config.enabled = std::get<bool>(enabled_it->second);
+        }
+        const std::pair<const char *, float *> values[] = {
+            {"minWeight", &config.min_weight},
+            {"noiseSigma", &config.noise_sigma},
+            {"motionLow", &config.motion_low},
+            {"motionHigh", &config.motion_high},
+        };
+        for (const auto &value : values) {
+            auto it = args->find(flutter::EncodableValue(value.first));
+            if (it != args->end()) {
+                if (const auto *number = std::get_if<double>(&it->second)) {
+                    *value.second = static_cast<float>(*number);
+                }
+            }
+        }
+    }
+
+    denoise_.SetConfig(config);
+    result->Success();
+}
+
+void CameraPlugin::SetNuc(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+    // Keys that are absent keep their current value.
+    uvc::NucConfig config = nuc_.config();
+    if (args) {
+        const std::pair<const char *, bool *> flags[] = {
+            {"enabled", &config.enabled},
+            {"shutterless", &config.shutterless},
+        };
+        for (const auto &flag : flags) {
+            auto it = args->find(flutter::EncodableValue(flag.first));
+            if (it != args->end() && std::holds_alternative<bool>(it->second)) {
+                *flag.second = std::get<bool>(it->second);
+            }
+        }
+        const std::pair<const char *, float *> values[] = {
+            {"shutterlessRate", &config.shutterless_rate},
+            {"shutterlessGate", &config.shutterless_gate},
+        };
+        for (const auto &value : values) {
+            auto it = args->find(flutter::EncodableValue(value.first));
+            if (it != args->end()) {
+                if (const auto *number = std::get_if<double>(&it->second)) {
+                    *value.second = static_cast<float>(*number);
+                }
+            }
+        }
+    }
+
+    nuc_.SetConfig(config);
+    result->Success();
+}
+
+void CameraPlugin::CaptureNucReference(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+    uvc::NucReference reference;
+    bool level_ok = false;
+    int64_t frames = 32;
+    if (args) {
+        auto level_it = args->find(flutter::EncodableValue("level"));
+        if (level_it != args->end() && std::holds_alternative<std::string>(level_it->second)) {
+            level_ok = uvc::ParseNucReference(std::get<std::string>(level_it->second), &reference);
+        }
+        auto frames_it = args->find(flutter::EncodableValue("frames"));
+        if (frames_it != args->end()) {
+            if (const auto *value = std::get_if<int32_t>(&frames_it->second)) {
+                frames = *value;
+            } else if (const auto *value64 = std::get_if<int64_t>(&frames_it->second)) {
+                frames = *value64;
+            }
+        }
+    }
+    if (!level_ok) {
+        result->Error("INVALID_ARGUMENT", "level must be 'cold' or 'hot'");
+        return;
+    }
+    if (frames <= 0 || frames > static_cast<int64_t>(uvc::NucEngine::kMaxReferenceFrames)) {
+        result->Error("INVALID_ARGUMENT", "frames out of range");
+        return;
+    }
+    if (!capture_worker_.running() || raw_packing_ == uvc::RawPacking::kNone) {
+        result->Error("NOT_RAW", "Calibration needs a raw preview");
+        return;
+    }
+
+    const HWND window = GetAncestor(registrar_->GetView()->GetNativeWindow(), GA_ROOT);
+    std::shared_ptr<flutter::MethodResult<flutter::EncodableValue>> pending(std::move(result));
+    const bool started = nuc_.CaptureReference(
+        reference, static_cast<size_t>(frames), static_cast<uint32_t>(video_width_), static_cast<uint32_t>(video_height_),
+        [this, window, pending](const uvc::NucResult &nuc) {
+            PostPlatformTask(window, [pending, nuc]() { SendNucResult(*pending, nuc); });
+        });
+    if (!started) {
+        pending->Error("BUSY", "A NUC capture or computation is running");
+    }
+}
+
+void CameraPlugin::ComputeNuc(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+    std::string path;
+    if (args) {
+        auto path_it = args->find(flutter::EncodableValue("path"));
+        if (path_it != args->end() && std::holds_alternative<std::string>(path_it->second)) {
+            path = std::get<std::string>(path_it->second);
+        }
+    }
+
+    const HWND window = GetAncestor(registrar_->GetView()->GetNativeWindow(), GA_ROOT);
+    std::shared_ptr<flutter::MethodResult<flutter::EncodableValue>> pending(std::move(result));
+    const bool started = nuc_.ComputeTables(path, [this, window, pending](const uvc::NucResult &nuc) {
+        PostPlatformTask(window, [pending, nuc]() { SendNucResult(*pending, nuc); });
+    });
+    if (!started) {
+        pending->Error("BUSY", "A NUC capture or computation is running");
+    }
+}
+
+void CameraPlugin::LoadNuc(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+    std::string path;
+    if (args) {
+        auto path_it = args->find(flutter::EncodableValue("path"));
+        if (path_it != args->end() && std::holds_alternative<std::string>(path_it->second)) {
+            path = std::get<std::string>(path_it->second);
+        }
+    }
+    if (path.empty()) {
+        result->Error("INVALID_ARGUMENT", "A path is required");
+        return;
+    }
+    std::string error;
+    if (!nuc_.LoadTables(path, &error)) {
+        result->Error("LOAD_FAILED", error);
+        return;
+    }
+    result->Success();
+}
+
+void CameraPlugin::SetBadPixels(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+    if (args) {
+        auto enabled_it = args->find(flutter::EncodableValue("enabled"));
+        if (enabled_it != args->end() && std::holds_alternative<bool>(enabled_it->second)) {
+            bad_pixels_.SetEnabled(std::get<bool>(enabled_it->second));
+        }
+        auto directory_it = args->find(flutter::EncodableValue("directory"));
+        if (directory_it != args->end() && std::holds_alternative<std::string>(directory_it->second)) {
+            bad_pixel_dir_ = std::get<std::string>(directory_it->second);
+            if (capture_worker_.running()) {
+                LoadBadPixelMap();
+            }
+        }
+    }
+    result->Success();
+}
+
+void CameraPlugin::ScanBadPixels(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+    int64_t frames = 32;
+    double k_sigma = 6.0;
+    if (args) {
+        auto frames_it = args->find(flutter::EncodableValue("frames"));
+        if (frames_it != args->end()) {
+            if (const auto *value = std::get_if<int32_t>(&frames_it->second)) {
+                frames = *value;
+            } else if (const auto *value64 = std::get_if<int64_t>(&frames_it->second)) {
+                frames = *value64;
+            }
+        }
+        auto sigma_it = args->find(flutter::EncodableValue("kSigma"));
+        if (sigma_it != args->end()) {
+            if (const auto *value = std::get_if<double>(&sigma_it->second)) {
+                k_sigma = *value;
+            }
+        }
+    }
+    if (frames <= 0 || frames > static_cast<int64_t>(uvc::BadPixelCorrector::kMaxScanFrames) || !(k_sigma > 0)) {
+        result->Error("INVALID_ARGUMENT", "frames or kSigma out of range");
+        return;
+    }
+    if (!capture_worker_.running() || raw_packing_ == uvc::RawPacking::kNone) {
+        result->Error("NOT_RAW", "Scanning needs a raw preview");
+        return;
+    }
+
+    const HWND window = GetAncestor(registrar_->GetView()->GetNativeWindow(), GA_ROOT);
+    std::shared_ptr<flutter::MethodResult<flutter::EncodableValue>> pending(std::move(result));
+    const bool started = bad_pixels_.Scan(
+        static_cast<size_t>(frames), static_cast<float>(k_sigma), static_cast<uint32_t>(video_width_),
+        static_cast<uint32_t>(video_height_), BadPixelMapPath(),
+        [this, window, pending](const uvc::BadPixelResult &scan) {
+            PostPlatformTask(window, [pending, scan]() { SendBadPixelResult(*pending, scan); });
+        });
+    if (!started) {
+        pending->Error("BUSY", "A bad-pixel scan is running");
+    }
+}
+
+std::string CameraPlugin::BadPixelMapPath() const {
+    if (bad_pixel_dir_.empty() || bad_pixel_key_.empty()) {
+        return std::string();
+    }
+    return bad_pixel_dir_ + "\\" + uvc::BadPixelMapFileName(bad_pixel_key_);
+}
+
+void CameraPlugin::LoadBadPixelMap() {
+    bad_pixels_.SetMap(nullptr);
+    const std::string path = BadPixelMapPath();
+    if (path.empty()) {
+        return;
+    }
+    // u8path, so non-ASCII directories work.
+    std::error_code exists_error;
+    if (!std::filesystem::exists(std::filesystem::u8path(path), exists_error)) {
+        return;
+    }
+    std::string error;
+    if (!bad_pixels_.LoadMap(path, &error)) {
+        std::cerr << "Ignoring bad-pixel map: " << error << std::endl;
+    }
+}
+
+void CameraPlugin::SetRois(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+    const flutter::EncodableList *list = nullptr;
+    if (args) {
+        auto rois_it = args->find(flutter::EncodableValue("rois"));
+        if (rois_it != args->end()) {
+            list = std::get_if<flutter::EncodableList>(&rois_it->second);
+        }
+    }
+    std::vector<uvc::Roi> rois;
+    if (!list || !ParseRois(*list, &rois)) {
+        result->Error("INVALID_ARGUMENT", "Malformed ROI list");
+        return;
+    }
+    if (!rois_.SetRois(std::move(rois))) {
+        result->Error("INVALID_ARGUMENT", "Too many ROIs or points");
+        return;
+    }
+    result->Success();
+}
+
+void CameraPlugin::OnRoiListen(std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> &&sink) {
+    roi_sink_ = std::move(sink);
+    roi_window_ = GetAncestor(registrar_->GetView()->GetNativeWindow(), GA_ROOT);
+    roi_listening_.store(true, std::memory_order_release);
+}
+
+void CameraPlugin::OnRoiCancel() {
+    roi_listening_.store(false, std::memory_order_relaxed);
+    roi_sink_.reset();
+}
+
+void CameraPlugin::MeasureRois(const uvc::FrameRef &raw_frame) {
+    if (!roi_listening_.load(std::memory_order_acquire)) {
+        return;
+    }
+    uvc::RoiFrame &roi_frame = roi_frames_.WriteBuffer();
+    const uvc::FrameFormat &format = raw_frame.format();
+    if (!rois_.Measure(reinterpret_cast<const uint16_t *>(raw_frame.data()), format.width, format.width,
+                       format.height, &roi_frame.stats)) {
+        return;
+    }
+    roi_frame.sequence = raw_frame.info().sequence;
+    roi_frame.timestamp = raw_frame.info().timestamp;
+    roi_frames_.Publish();
+    if (roi_notifier_.Publish()) {
+        PostPlatformTask(roi_window_, [this]() { SendRoiFrame(); });
+    }
+}
+
+void CameraPlugin::SendRoiFrame() {
+    roi_notifier_.Consume();
+    if (!roi_frames_.Update() || !roi_sink_) {
+        return;
+    }
+    uvc::TelemetryWriter writer(roi_record_.data(), roi_record_.size());
+    const size_t size = uvc::WriteRoiRecord(roi_frames_.ReadBuffer(), &writer);
+    if (size == 0) {
+        return;
+    }
+    roi_sink_->Success(flutter::EncodableValue(std::vector<uint8_t>(roi_record_.begin(), roi_record_.begin() + size)));
+}
+
+void CameraPlugin::SetFrameStream(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+    uvc::FrameRingConfig config = frame_ring_config_;
+    if (args) {
+        auto enabled_it = args->find(flutter::EncodableValue("enabled"));
+        if (enabled_it != args->end() && std::holds_alternative<bool>(enabled_it->second)) {
+            config.enabled = std::get<bool>(enabled_it->second);
+        }
+        auto raw_it = args->find(flutter::EncodableValue("raw"));
+        if (raw_it != args->end() && std::holds_alternative<bool>(raw_it->second)) {
+            config.raw = std::get<bool>(raw_it->second);
+        }
+        const std::pair<const char *, uint32_t *> counts[] = {
+            {"slots", &config.slots},
+            {"everyNth", &config.every_nth},
+            {"downscale", &config.downscale},
+        };
+        for (const auto &count : counts) {
+            auto it = args->find(flutter::EncodableValue(count.first));
+            int64_t value = 0;
+            if (it != args->end() && IntValue(it->second, &value)) {
+                *count.second = static_cast<uint32_t>(std::clamp<int64_t>(value, 0, UINT32_MAX));
+            }
+        }
+        auto fps_it = args->find(flutter::EncodableValue("maxFps"));
+        if (fps_it != args->end()) {
+            if (const auto *value = std::get_if<double>(&fps_it->second)) {
+                config.max_fps = *value;
+            }
+        }
+    }
+    if (config.slots == 0 || config.slots > uvc::FrameRing::kMaxSlots ||
+        (config.downscale != 1 && config.downscale != 2 && config.downscale != 4) ||
+        config.every_nth == 0 || !(config.max_fps >= 0)) {
+        result->Error("INVALID_ARGUMENT", "slots, everyNth, maxFps or downscale out of range");
+        return;
+    }
+    frame_ring_config_ = config;
+    frame_ring_.SetDecimation(config.every_nth, config.max_fps);
+    result->Success();
+}
+
+void CameraPlugin::GetFrameRing(std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+    if (!frame_ring_.memory()) {
+        result->Success();
+        return;
+    }
+    flutter::EncodableMap ring;
+    ring[flutter::EncodableValue("address")] =
+        flutter::EncodableValue(static_cast<int64_t>(reinterpret_cast<uintptr_t>(frame_ring_.memory())));
+    ring[flutter::EncodableValue("bytes")] = flutter::EncodableValue(static_cast<int64_t>(frame_ring_.size()));
+    ring[flutter::EncodableValue("read")] =
+        flutter::EncodableValue(static_cast<int64_t>(reinterpret_cast<uintptr_t>(&UvcFrameRingRead)));
+    result->Success(flutter::EncodableValue(ring));
+}
+
+void CameraPlugin::GetPipelineStats(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+    uvc::PipelineStatsSnapshot snapshot;
+    stats_.Read(&snapshot);
+    if (args) {
+        auto reset_it = args->find(flutter::EncodableValue("reset"));
+        if (reset_it != args->end()) {
+            const auto *reset = std::get_if<bool>(&reset_it->second);
+            if (reset && *reset) {
+                stats_.Reset();
+            }
+        }
+    }
+
+    const uvc::PipelineCounters &counters = snapshot.counters;
+    flutter::EncodableMap statsMap;
+    statsMap[flutter::EncodableValue("intervalSeconds")] = flutter::EncodableValue(snapshot.interval_seconds);
+    statsMap[flutter::EncodableValue("captureFps")] = flutter::EncodableValue(snapshot.capture_fps);
+    statsMap[flutter::EncodableValue("presentFps")] = flutter::EncodableValue(snapshot.present_fps);
+    const std::pair<const char *, uint64_t> values[] = {
+        {"captured", counters.captured},
+        {"published", counters.published},
+        {"notified", counters.notified},
+        {"skippedUnconsumed", counters.skipped_unconsumed},
+        {"presented", counters.presented},
+        {"duplicated", counters.duplicated},
+        {"droppedSource", counters.dropped_source},
+        {"droppedPool", counters.dropped_pool},
+    };
+    for (const auto &value : values) {
+        statsMap[flutter::EncodableValue(value.first)] = flutter::EncodableValue(static_cast<int64_t>(value.second));
+    }
+
+    // Latencies in microseconds, per stage.
+    flutter::EncodableMap stagesMap;
+    for (size_t i = 0; i < uvc::kPipelineStageCount; i++) {
+        const uvc::LatencyHistogram::Snapshot &histogram = snapshot.stages[i];
+        const std::pair<const char *, double> percentiles[] = {
+            {"meanUs", histogram.Mean()},
+            {"p50Us", static_cast<double>(histogram.ValueAtQuantile(0.5))},
+            {"p90Us", static_cast<double>(histogram.ValueAtQuantile(0.9))},
+            {"p99Us", static_cast<double>(histogram.ValueAtQuantile(0.99))},
+            {"p999Us", static_cast<double>(histogram.ValueAtQuantile(0.999))},
+            {"maxUs", static_cast<double>(histogram.Max())},
+        };
+        flutter::EncodableMap stageMap;
+        stageMap[flutter::EncodableValue("count")] = flutter::EncodableValue(static_cast<int64_t>(histogram.count));
+        for (const auto &percentile : percentiles) {
+            stageMap[flutter::EncodableValue(percentile.first)] = flutter::EncodableValue(percentile.second / 1e3);
+        }
+        stagesMap[flutter::EncodableValue(uvc::PipelineStageName(static_cast<uvc::PipelineStage>(i)))] =
+            flutter::EncodableValue(stageMap);
+    }
+    statsMap[flutter::EncodableValue("stages")] = flutter::EncodableValue(stagesMap);
+    result->Success(flutter::EncodableValue(statsMap));
+}
+
 void CameraPlugin::CapturePhoto(std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    const uvc::FrameRef frame = latest_.frame();
     
-    if (!pixel_buffer_ || buffer_size_ == 0) {
+    if (!frame) {
         result->Error("NO_FRAME", "No frame available to capture");
         return;
     }
     
-    // Copy current frame data
-    std::vector<uint8_t> photoData(pixel_buffer_.get(), pixel_buffer_.get() + buffer_size_);
+    // The handle keeps the frame alive, so the copy the method codec needs
+    // happens without blocking the capture thread.
+    std::vector<uint8_t> photoData(frame.data(), frame.data() + frame.size());
     
     result->Success(flutter::EncodableValue(photoData));
 }
+
+void CameraPlugin::CaptureToFile(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+    std::string path;
+    uvc::SnapshotFormat format = uvc::SnapshotFormat::kPng;
+    if (args) {
+        auto path_it = args->find(flutter::EncodableValue("path"));
+        if (path_it != args->end() && std::holds_alternative<std::string>(path_it->second)) {
+            path = std::get<std::string>(path_it->second);
+        }
+        auto format_it = args->find(flutter::EncodableValue("format"));
+        if (format_it != args->end() && std::holds_alternative<std::string>(format_it->second) &&
+            !uvc::ParseSnapshotFormat(std::get<std::string>(format_it->second), &format)) {
+            result->Error("INVALID_FORMAT", "Unknown snapshot format");
+            return;
+        }
+    }
+    if (path.empty()) {
+        result->Error("INVALID_ARGUMENT", "A path is required");
+        return;
+    }
+
+    // Only the handle is taken; the worker reads the pixels.
+    uvc::FrameRef frame = format == uvc::SnapshotFormat::kTiff16 ? latest_.counts() : latest_.frame();
+    if (!frame) {
+        result->Error("NO_FRAME", "No frame available to capture");
+        return;
+    }
+
+    const HWND window = GetAncestor(registrar_->GetView()->GetNativeWindow(), GA_ROOT);
+    std::shared_ptr<flutter::MethodResult<flutter::EncodableValue>> pending(std::move(result));
+    const bool queued = snapshots_.Submit(
+        std::move(frame), format, path, [this, window, pending](const uvc::SnapshotResult &snapshot) {
+            PostPlatformTask(window, [pending, snapshot]() { SendSnapshotResult(*pending, snapshot); });
+        });
+    if (!queued) {
+        pending->Error("BUSY", "Earlier snapshots are still being written");
+    }
+}
+
+void CameraPlugin::CaptureBurst(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+    std::string path;
+    double pre_seconds = 2.0, post_seconds = 0.0;
+    if (args) {
+        auto path_it = args->find(flutter::EncodableValue("path"));
+        if (path_it != args->end() && std::holds_alternative<std::string>(path_it->second)) {
+            path = std::get<std::string>(path_it->second);
+        }
+        auto pre_it = args->find(flutter::EncodableValue("preSeconds"));
+        if (pre_it != args->end() && std::holds_alternative<double>(pre_it->second)) {
+            pre_seconds = std::get<double>(pre_it->second);
+        }
+        auto post_it = args->find(flutter::EncodableValue("postSeconds"));
+        if (post_it != args->end() && std::holds_alternative<double>(post_it->second)) {
+            post_seconds = std::get<double>(post_it->second);
+        }
+    }
+    if (path.empty()) {
+        result->Error("INVALID_ARGUMENT", "A path is required");
+        return;
+    }
+    if (!burst_.configured()) {
+        result->Error("NO_BUFFER", "Preview was started without burstBufferMb");
+        return;
+    }
+
+    const HWND window = GetAncestor(registrar_->GetView()->GetNativeWindow(), GA_ROOT);
+    std::shared_ptr<flutter::MethodResult<flutter::EncodableValue>> pending(std::move(result));
+    const bool started = burst_.Trigger(
+        uvc::SteadyNow100ns(), static_cast<int64_t>(pre_seconds * 1e7), static_cast<int64_t>(post_seconds * 1e7), path,
+        [this, window, pending](const uvc::BurstResult &burst) {
+            PostPlatformTask(window, [pending, burst]() { SendBurstResult(*pending, burst); });
+        });
+    if (!started) {
+        pending->Error("BUSY", "The previous burst is still being written");
+    }
+}
+
+uvc::SourceMode CameraPlugin::BurstMode() const {
+    uvc::SourceMode mode;
+    mode.format = raw_packing_ != uvc::RawPacking::kNone ? uvc::SourcePixelFormat::kGray16 : pixel_format_;
+    mode.width = static_cast<uint32_t>(video_width_);
+    mode.height = static_cast<uint32_t>(video_height_);
+    mode.bit_depth = raw_packing_ == uvc::RawPacking::kY14 ? 14 : raw_packing_ == uvc::RawPacking::kY16 ? 16 : 8;
+    if (frame_rate_.known()) {
+        mode.fps_numerator = frame_rate_.numerator;
+        mode.fps_denominator = frame_rate_.denominator;
+    }
+    return mode;
+}
+
+void CameraPlugin::SendSnapshotResult(flutter::MethodResult<flutter::EncodableValue> &result, const uvc::SnapshotResult &snapshot) {
+    if (!snapshot.ok) {
+        result.Error("WRITE_FAILED", snapshot.error);
+        return;
+    }
+    // Timings in microseconds, like getPipelineStats.
+    flutter::EncodableMap resultMap;
+    resultMap[flutter::EncodableValue("path")] = flutter::EncodableValue(snapshot.path);
+    resultMap[flutter::EncodableValue("bytes")] = flutter::EncodableValue(static_cast<int64_t>(snapshot.bytes));
+    resultMap[flutter::EncodableValue("queuedUs")] = flutter::EncodableValue(snapshot.queued_ns / 1e3);
+    resultMap[flutter::EncodableValue("encodeUs")] = flutter::EncodableValue(snapshot.encode_ns / 1e3);
+    resultMap[flutter::EncodableValue("writeUs")] = flutter::EncodableValue(snapshot.write_ns / 1e3);
+    result.Success(flutter::EncodableValue(resultMap));
+}
+
+void CameraPlugin::SendBurstResult(flutter::MethodResult<flutter::EncodableValue> &result, const uvc::BurstResult &burst) {
+    if (!burst.ok) {
+        result.Error("WRITE_FAILED", burst.error);
+        return;
+    }
+    // Offsets from the trigger in milliseconds.
+    flutter::EncodableMap resultMap;
+    resultMap[flutter::EncodableValue("path")] = flutter::EncodableValue(burst.path);
+    resultMap[flutter::EncodableValue("frames")] = flutter::EncodableValue(static_cast<int64_t>(burst.frames));
+    resultMap[flutter::EncodableValue("preFrames")] = flutter::EncodableValue(static_cast<int64_t>(burst.pre_frames));
+    resultMap[flutter::EncodableValue("firstOffsetMs")] = flutter::EncodableValue(burst.first_offset / 1e4);
+    resultMap[flutter::EncodableValue("lastOffsetMs")] = flutter::EncodableValue(burst.last_offset / 1e4);
+    resultMap[flutter::EncodableValue("truncated")] = flutter::EncodableValue(burst.truncated);
+    resultMap[flutter::EncodableValue("writeUs")] = flutter::EncodableValue(burst.write_ns / 1e3);
+    result.Success(flutter::EncodableValue(resultMap));
+}
+
+void CameraPlugin::SendNucResult(flutter::MethodResult<flutter::EncodableValue> &result, const uvc::NucResult &nuc) {
+    if (!nuc.ok) {
+        result.Error("NUC_FAILED", nuc.error);
+        return;
+    }
+    flutter::EncodableMap resultMap;
+    resultMap[flutter::EncodableValue("frames")] = flutter::EncodableValue(static_cast<int64_t>(nuc.frames));
+    resultMap[flutter::EncodableValue("mean")] = flutter::EncodableValue(static_cast<double>(nuc.mean));
+    resultMap[flutter::EncodableValue("twoPoint")] = flutter::EncodableValue(nuc.two_point);
+    resultMap[flutter::EncodableValue("path")] = flutter::EncodableValue(nuc.path);
+    resultMap[flutter::EncodableValue("computeUs")] = flutter::EncodableValue(nuc.compute_ns / 1e3);
+    result.Success(flutter::EncodableValue(resultMap));
+}
+
+void CameraPlugin::SendBadPixelResult(flutter::MethodResult<flutter::EncodableValue> &result, const uvc::BadPixelResult &scan) {
+    if (!scan.ok) {
+        result.Error("BAD_PIXELS_FAILED", scan.error);
+        return;
+    }
+    flutter::EncodableMap resultMap;
+    resultMap[flutter::EncodableValue("count")] = flutter::EncodableValue(static_cast<int64_t>(scan.count));
+    resultMap[flutter::EncodableValue("frames")] = flutter::EncodableValue(static_cast<int64_t>(scan.frames));
+    resultMap[flutter::EncodableValue("path")] = flutter::EncodableValue(scan.path);
+    resultMap[flutter::EncodableValue("detectUs")] = flutter::EncodableValue(scan.detect_ns / 1e3);
+    result.Success(flutter::EncodableValue(resultMap));
+}
+
+void CameraPlugin::PostPlatformTask(HWND window, std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(platform_tasks_mutex_);
+        platform_tasks_.push_back(std::move(task));
+    }
+    PostMessage(window, kPlatformTaskMessage, 0, 0);
+}
+
+void CameraPlugin::RunPlatformTasks() {
+    std::vector<std::function<void()>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(platform_tasks_mutex_);
+        tasks.swap(platform_tasks_);
+    }
+    for (const auto &task : tasks) {
+        task();
+    }
+}
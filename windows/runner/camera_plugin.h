@@ -1,20 +1,51 @@
 #ifndef CAMERA_PLUGIN_H_
 #define CAMERA_PLUGIN_H_
 
+#include <flutter/event_channel.h>
+#include <flutter/event_stream_handler_functions.h>
 #include <flutter/method_channel.h>
 #include <flutter/plugin_registrar_windows.h>
 #include <flutter/standard_method_codec.h>
 #include <flutter/texture_registrar.h>
 
+#include <dbt.h>
 #include <mfapi.h>
 #include <mfidl.h>
 #include <mfreadwrite.h>
 #include <shlwapi.h>
+#include <array>
+#include <atomic>
 #include <vector>
 #include <string>
 #include <memory>
 #include <mutex>
 #include <functional>
+#include <optional>
+
+#include "agc.h"
+#include "bad_pixels.h"
+#include "burst_recorder.h"
+#include "capture_worker.h"
+#include "device_registry.h"
+#include "format_negotiation.h"
+#include "frame_notifier.h"
+#include "frame_pool.h"
+#include "frame_ring.h"
+#include "frame_source.h"
+#include "latest_frames.h"
+#if defined(UVC_HAVE_JPEG)
+#include "mjpeg_pipeline.h"
+#endif
+#include "nuc.h"
+#include "pipeline_stats.h"
+#include "raw_convert.h"
+#include "roi_engine.h"
+#include "snapshot_writer.h"
+#include "temporal_denoise.h"
+#include "thermal_palette.h"
+#include "tone_curve.h"
+#include "triple_buffer.h"
+#include "virtual_camera.h"
 
 class CameraPlugin : public flutter::Plugin {
  public:
@@ -38,24 +69,197 @@ class CameraPlugin : public flutter::Plugin {
   void GetDeviceStatus(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
   void GetSupportedResolutions(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
   void CapturePhoto(std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  // Queues the latest frame (png) or raw counts (tiff) for snapshots_ and
+  // answers once the file is written, from a platform task.
+  void CaptureToFile(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  // Saves the preSeconds before now and the postSeconds after it from
+  // burst_ as a recording, answering once the file is written.
+  void CaptureBurst(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  // The layout frames reach PublishFrame() in, as burst_ records them.
+  uvc::SourceMode BurstMode() const;
+  static void SendSnapshotResult(flutter::MethodResult<flutter::EncodableValue> &result, const uvc::SnapshotResult &snapshot);
+  static void SendBurstResult(flutter::MethodResult<flutter::EncodableValue> &result, const uvc::BurstResult &burst);
+  // Any thread: runs |task| on the platform thread, which method results
+  // must be answered on, by posting kPlatformTaskMessage to |window|.
+  void PostPlatformTask(HWND window, std::function<void()> task);
+  // Platform thread: runs the tasks posted so far.
+  void RunPlatformTasks();
+  void SetPalette(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  // setBrightness, setContrast and setGamma: one slider's {value}.
+  void SetTone(const std::string &method, const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void SetAgc(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void SetDenoise(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void SetNuc(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  // Averages the next raw frames as the cold or hot flat field; computeNuc
+  // turns the references into tables, saves them and switches to them. Both
+  // answer from a platform task once nuc_'s calibration thread is done.
+  void CaptureNucReference(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  void ComputeNuc(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  // Maps tables saved by computeNuc; nothing is recomputed.
+  void LoadNuc(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  static void SendNucResult(flutter::MethodResult<flutter::EncodableValue> &result, const uvc::NucResult &nuc);
+  // Turns bad-pixel replacement on or off; a "directory" argument is where
+  // each device's map is kept and loaded from on every startPreview.
+  void SetBadPixels(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  // Detects bad pixels over the next raw frames and saves the map; answers
+  // from a platform task once bad_pixels_' detection thread is done.
+  void ScanBadPixels(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  static void SendBadPixelResult(flutter::MethodResult<flutter::EncodableValue> &result, const uvc::BadPixelResult &scan);
+  // The open device's map in bad_pixel_dir_; empty without a directory.
+  std::string BadPixelMapPath() const;
+  // Loads the open device's saved map, or clears the map if it has none.
+  void LoadBadPixelMap();
+  // Replaces the ROIs measured on each raw frame while Dart listens to the
+  // roi event channel.
+  void SetRois(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  // Platform thread: the roi event channel's listener came or went.
+  void OnRoiListen(std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> &&sink);
+  void OnRoiCancel();
+  // Capture thread: measures the ROIs on the corrected counts and posts
+  // SendRoiFrame(), at most one post outstanding as for the texture.
+  void MeasureRois(const uvc::FrameRef &raw_frame);
+  // Platform thread: sends the newest ROI frame as one binary kRoi
+  // telemetry record (see telemetry_record.h).
+  void SendRoiFrame();
+  // Configures the frame ring Dart reads through dart:ffi: its layout at the
+  // next startPreview, its decimation at once.
+  void SetFrameStream(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  // The active frame ring's address and size, and the address of the
+  // function Dart reads it through (UvcFrameRingRead), or null.
+  void GetFrameRing(std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+  // Counters and per-stage latency percentiles since the last reset; with
+  // "reset": true a new measurement window starts after the read.
+  void GetPipelineStats(const flutter::EncodableMap *args, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+
+  // Top-level window messages: invalidates the device list on hot-plug and
+  // runs platform tasks posted by workers.
+  std::optional<LRESULT> HandleWindowProc(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam);
 
   // WMF helpers
   HRESULT InitializeMediaFoundation();
-  HRESULT OpenDevice(int index);
+  // Opens device |index| with the native type uvc::NegotiateFormat() picks
+  // for |width| x |height| at |rate| (0 / unknown = any). With |raw_mode| it
+  // asks for a 16-bit type, YUY2 included only with |raw_yuy2|; otherwise,
+  // or if there is none, it reads YUY2 or RGB32 as delivered and anything
+  // else through the video processor. Indices past the Media Foundation
+  // devices select a virtual camera.
+  HRESULT OpenDevice(int index, bool raw_mode, bool raw_yuy2, UINT32 width, UINT32 height,
+                     const uvc::FrameRate &rate);
+  HRESULT OpenVirtualCamera(size_t index);
   void ReadSampleLoop();
+  void ReadSourceLoop();
+  // Converts one captured frame into pooled buffers, publishes it to the
+  // texture and snapshots, and signals the engine. Shared by both loops.
+  void PublishFrame(const uint8_t *data, ptrdiff_t pitch, const uvc::FrameInfo &info);
+  // Whether skipUnconsumed holds this frame back from display conversion:
+  // the engine has yet to copy the last frame, and no frame ring waits for
+  // the displayed frames.
+  bool SkipDisplay() const;
+  // Hands a converted frame to the texture and snapshots. Called from the
+  // capture thread, or for MJPEG from one decode worker at a time.
+  void PublishConverted(uvc::FrameRef frame, uvc::FrameRef raw_frame);
+  // Unpacks the counts into |raw_frame| and runs NUC, bad-pixel
+  // replacement and denoise on them.
+  void CorrectCounts(const uint8_t *data, ptrdiff_t pitch, uvc::FrameRef &raw_frame);
 
   flutter::PluginRegistrarWindows *registrar_;
   flutter::TextureRegistrar *texture_registrar_;
   std::unique_ptr<flutter::TextureVariant> texture_variant_;
   int64_t texture_id_ = -1;
+
+  // Media Foundation devices, enumerated once and again only after a
+  // WM_DEVICECHANGE arrival or removal. Virtual cameras are numbered after
+  // them and fixed for the process lifetime.
+  std::unique_ptr<uvc::DeviceRegistry> devices_;
+  std::vector<uvc::VirtualCameraSpec> virtual_cameras_;
+  int window_proc_id_ = -1;
+  HDEVNOTIFY device_notify_ = nullptr;
   
   // Camera State
   IMFSourceReader *source_reader_ = nullptr;
   IMFMediaSource* media_source_ = nullptr;
-  bool is_reading_ = false;
-  std::mutex mutex_;
-  std::unique_ptr<uint8_t[]> pixel_buffer_;
-  size_t buffer_size_ = 0;
+  // The registry's activation object media_source_ came from.
+  IMFActivate *device_activate_ = nullptr;
+  std::string open_device_id_;
+  // Names the open device's bad-pixel map: the symbolic link, whose
+  // instance part carries the serial number, or the virtual camera's name.
+  std::string bad_pixel_key_;
+  std::string bad_pixel_dir_;
+  // Runs ReadSampleLoop() or ReadSourceLoop(); CloseDevice() wakes and joins
+  // it before releasing what the loop reads from.
+  uvc::CaptureWorker capture_worker_;
+  // Virtual camera state.
+  std::unique_ptr<uvc::FrameSource> frame_source_;
+  // Layout of non-raw frames: the camera's NV12, YUY2, UYVY, RGB32 or MJPG,
+  // RGB32 from the video processor, or whatever a virtual camera delivers.
+  uvc::SourcePixelFormat pixel_format_ = uvc::SourcePixelFormat::kBgra32;
+  // The negotiated rate; unknown for the video processor and unpaced
+  // virtual cameras.
+  uvc::FrameRate frame_rate_;
+#if defined(UVC_HAVE_JPEG)
+  // Decodes MJPG samples into frame_pool_; started and stopped with the
+  // capture thread.
+  uvc::MjpegPipeline mjpeg_;
+#endif
+
+  // Converted RGBA frames come from frame_pool_ and are shared by handle:
+  // the texture reads them through preview_frames_, snapshots through
+  // latest_, without copying pixels.
+  uvc::FramePool frame_pool_;
+  uvc::TripleBuffer<uvc::FrameRef> preview_frames_;
+  // At most one MarkTextureFrameAvailable() is outstanding at a time.
+  uvc::FrameNotifier notifier_;
+  // startPreview's skipUnconsumed: while the engine has not copied the last
+  // frame, new ones are not converted for display.
+  bool skip_unconsumed_ = false;
+  // Raw mode only: the 16-bit counts frames are rendered from.
+  uvc::RawPacking raw_packing_ = uvc::RawPacking::kNone;
+  uvc::FramePool raw_pool_;
+  // Recent frames (or counts) for Dart to read in place, written by
+  // whichever thread publishes; laid out by StartPreview() from
+  // frame_ring_config_.
+  uvc::FrameRingConfig frame_ring_config_;
+  uvc::FrameRing frame_ring_;
+  // Work posted by the snapshot and burst workers, such as answering a
+  // method call, waiting for the platform thread; see PostPlatformTask().
+  std::mutex platform_tasks_mutex_;
+  std::vector<std::function<void()>> platform_tasks_;
+  // Declared after what their callbacks use, so they are destroyed, and
+  // their workers joined, first. burst_ keeps the last frames the capture
+  // thread read, for captureBurst. nuc_ corrects raw counts first thing on
+  // the capture thread and calibrates on a thread of its own; bad_pixels_
+  // replaces dead and stuck pixels right after it and detects them on its
+  // own thread too.
+  uvc::BurstRecorder burst_;
+  uvc::NucEngine nuc_;
+  uvc::BadPixelCorrector bad_pixels_;
+  uvc::SnapshotWriter snapshots_;
+  // Palette raw frames are rendered with; switched from the platform thread.
+  uvc::PaletteSelector palette_;
+  // Maps raw counts onto the palette; owned by the capture thread, configured
+  // from the platform thread through SetConfig().
+  uvc::AutoGain agc_;
+  // Brightness, contrast and gamma, set on the platform thread and taken up
+  // by the capture thread before each conversion.
+  uvc::ToneCurve tone_;
+  // Temporal noise reduction on the raw counts ahead of agc_; owned by the
+  // capture thread, configured from the platform thread.
+  uvc::TemporalDenoise denoise_;
+  // Measured on the corrected counts while Dart listens; the newest frame's
+  // statistics wait in roi_frames_ for the platform thread. roi_window_ is
+  // set before roi_listening_, which publishes it to the capture thread.
+  uvc::RoiEngine rois_;
+  std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> roi_sink_;
+  HWND roi_window_ = nullptr;
+  std::atomic<bool> roi_listening_{false};
+  uvc::TripleBuffer<uvc::RoiFrame> roi_frames_;
+  uvc::FrameNotifier roi_notifier_;
+  std::array<uint8_t, uvc::RoiRecordBytes(uvc::RoiEngine::kMaxRois)> roi_record_;
+  // Recorded into by the capture and raster threads without locks, read by
+  // GetPipelineStats().
+  uvc::PipelineStats stats_;
+  // The newest frame and counts for capturePhoto and captureToFile.
+  uvc::LatestFrames latest_{&stats_};
   size_t video_width_ = 640;
   size_t video_height_ = 480;
   FlutterDesktopPixelBuffer flutter_pixel_buffer_;